@@ -0,0 +1,87 @@
+#ifndef ALARM_SYNTH_H
+#define ALARM_SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYNTH_RATE 44100        // Rendered straight at the I2S rate
+#define SYNTH_VOICES 4          // Notes sounding at once (chords, tails)
+#define SYNTH_TABLE_BITS 8      // 256-entry wavetables
+#define SYNTH_ENV_ONE (1 << 24)  // Envelope full scale
+
+enum SynthWave : uint8_t { SYNTH_SINE, SYNTH_SOFT_SQUARE, SYNTH_ORGAN };
+
+// One sequencer step. note is a MIDI number (69 = A4), 0 a rest; a note
+// with steps 0 sounds together with the next one (chords).
+struct SynthNote {
+  uint8_t note;
+  uint8_t steps;
+};
+
+// A looping alarm melody: instrument (wave and ADSR) plus its notes
+struct SynthTune {
+  const char* name;
+  SynthWave wave;
+  uint16_t stepMs;     // Length of one step
+  uint8_t gatePct;     // Share of its steps a note is held before release
+  uint16_t attackMs;
+  uint16_t decayMs;
+  uint8_t sustainPct;  // Level held after decay
+  uint16_t releaseMs;
+  int16_t level;       // Q15 output level of one voice
+  const SynthNote* notes;
+  uint8_t count;
+};
+
+extern const SynthTune synthTunes[];
+extern const uint8_t synthTuneCount;
+const SynthTune* synthTune(const char* name);  // nullptr if unknown
+
+// Alarm melodies rendered from wavetables with ADSR envelopes, for when
+// there is no file to play; integer only
+class AlarmSynth {
+ public:
+  AlarmSynth();
+
+  // Loop tune until stop(), or until the loop running at maxMs ends
+  // (0: no limit)
+  void start(const SynthTune* tune, uint32_t maxMs);
+  // Release the sounding notes and start no new ones; render() ends once
+  // they have faded
+  void stop();
+  bool running() const { return tune != nullptr; }
+
+  // Interleaved stereo; fewer frames than asked once the tune has ended
+  uint32_t render(int16_t* stereo, uint32_t frames);
+
+  uint64_t frames() const { return frameCount; }
+
+ private:
+  enum Stage : uint8_t { OFF, ATTACK, DECAY, SUSTAIN, RELEASE };
+
+  struct Voice {
+    uint32_t phase;
+    uint32_t step;     // Phase increment per frame
+    int32_t env;       // 0..SYNTH_ENV_ONE
+    int32_t envStep;   // Per frame, for the current stage
+    uint32_t gateLeft;  // Frames until release
+    Stage stage;
+  };
+
+  const SynthTune* tune;
+  const int16_t* table;
+  Voice voices[SYNTH_VOICES];
+  uint8_t next;        // Note index in the tune
+  uint32_t stepLeft;   // Frames until the next step
+  bool ending;         // No new notes; done once the voices are silent
+  uint64_t frameCount;
+  uint64_t maxFrames;
+  int32_t attackStep, decayStep, sustain;
+  uint32_t releaseFrames;
+
+  void nextStep();
+  void noteOn(uint8_t note, uint32_t gate);
+  int32_t voiceSample(Voice& v);
+};
+
+#endif  // ALARM_SYNTH_H
@@ -0,0 +1,32 @@
+#ifndef AUDIO_GENERATOR_SYNTH_H
+#define AUDIO_GENERATOR_SYNTH_H
+
+#include <Arduino.h>
+
+#include "AudioGenerator.h"
+#include "alarm_synth.h"
+
+#define SYNTH_RENDER_FRAMES 288  // Rendered at a time
+#define SYNTH_LOOP_FRAMES 1152   // Per loop(), as much as one MP3 frame
+
+// AlarmSynth behind the generator interface, so a tone plays through the
+// same decode bursts, PCM ring and DSP chain as an MP3 and the rest of the
+// player cannot tell the difference. There is no file source: begin()
+// takes nullptr for it.
+class AudioGeneratorSynth : public AudioGenerator {
+ public:
+  explicit AudioGeneratorSynth(AlarmSynth* synth);
+
+  bool begin(AudioFileSource* source, AudioOutput* output) override;
+  bool loop() override;
+  bool stop() override;
+  bool isRunning() override { return running; }
+
+ private:
+  AlarmSynth* synth;
+  int16_t buf[2 * SYNTH_RENDER_FRAMES];
+  uint32_t pos;    // Next frame of buf to offer
+  uint32_t count;  // Frames in buf
+};
+
+#endif  // AUDIO_GENERATOR_SYNTH_H
@@ -0,0 +1,39 @@
+#ifndef AUDIO_GENERATOR_TRANSCODED_H
+#define AUDIO_GENERATOR_TRANSCODED_H
+
+#include <Arduino.h>
+
+#include "AudioGenerator.h"
+#include "transcode.h"
+
+#define TRANSCODED_LOOP_FRAMES 1152  // Per loop(), as much as one MP3 frame
+
+// Plays a transcoded sidecar (PCM or IMA ADPCM WAV) through the same
+// decode bursts, PCM ring and DSP chain as the MP3 it was made from, at a
+// fraction of the CPU. Blocks are read one at a time into a caller buffer
+// (the MP3 decoder's workspace, idle meanwhile). Starts at any frame.
+class AudioGeneratorTranscoded : public AudioGenerator {
+ public:
+  // info from transcodeParse(); buffer holds at least info.blockBytes
+  AudioGeneratorTranscoded(const TranscodeInfo& info, uint32_t startFrame,
+                           uint8_t* buffer, size_t len);
+
+  bool begin(AudioFileSource* source, AudioOutput* output) override;
+  bool loop() override;
+  bool stop() override;
+  bool isRunning() override { return running; }
+
+ private:
+  bool readBlock();
+
+  TranscodeInfo info;
+  TranscodeDecoder decoder;
+  uint8_t* buffer;
+  size_t len;
+  uint32_t startFrame;
+  uint32_t frame;      // Frame of the file in lastSample / next to decode
+  uint32_t nextBlock;  // Block readBlock() reads
+  bool pending;        // lastSample was refused, offer it again
+};
+
+#endif  // AUDIO_GENERATOR_TRANSCODED_H
@@ -7,13 +7,26 @@
 #include <SPI.h>
 #include <driver/i2s.h>
 
-#include "AudioFileSourceID3.h"
 #include "AudioFileSourceSD.h"
 #include "AudioGeneratorMP3.h"
 #include "AudioGeneratorWAV.h"
 #include "AudioOutputI2S.h"
+#include "audio_generator_synth.h"
+#include "audio_generator_transcoded.h"
+#include "audio_output_loudness.h"
+#include "audio_output_ring.h"
+#include "audio_output_transcode.h"
+#include "buffer_pool.h"
+#include "dsp_chain.h"
+#include "event_bus.h"
+#include "latency_profile.h"
+#include "mp3_index.h"
 #include "mqtt_manager.h"
+#include "pcm_ring.h"
 #include "sd_manager.h"
+#include "spectrum.h"
+#include "sync_playback.h"
+#include "transcode.h"
 
 // Forward declarations
 class PubSubClient;
@@ -23,6 +36,29 @@ class PubSubClient;
 #define I2S_LRC 25
 #define I2S_DOUT 27
 
+// Last position of an interrupted track: "<file>|<ms>"
+#define RESUME_FILE "/resume.dat"
+#define RESUME_SAVE_INTERVAL_MS 10000  // Bounds what a power loss rewinds
+
+// Built-in alarm tones (see synthTunes): played for "tone:<name>", and
+// instead of a file that cannot be played, so an alarm always sounds
+#define AUDIO_TONE_PREFIX "tone:"
+#define AUDIO_FALLBACK_TONE "beep"
+#define AUDIO_TONE_MAX_MS (10 * 60 * 1000UL)  // Unattended alarm gives up
+
+// A playFileAt() that comes in after its start decodes from where the
+// others will be this much later, time enough to open the file
+#define AUDIO_SYNC_JOIN_MS 500
+
+// Background loudness pass: decoded samples per decode period (one frame)
+#define LOUDNESS_BURST_SAMPLES 1152
+
+// Background transcoding job: frames per decode period, like the loudness
+// pass, and how many MP3 frames before its restart point a resumed job may
+// look for one that needs no bit reservoir
+#define TRANSCODE_BURST_FRAMES 1152
+#define TRANSCODE_RESUME_MAX_BACK 64
+
 // SD Card Configuration
 #define SD_CS 5
 #define SD_MOSI 23
@@ -32,29 +68,112 @@ class PubSubClient;
 class AudioManager {
  private:
   AudioOutputI2S* out;
+  uint8_t dmaBuffers;  // DMA descriptors out was built with
+  AudioOutputRing* ringOut;  // What the decoder writes into
+  AudioOutputLoudness* meterOut;  // Decoder sink of the loudness pass
+  AudioOutputTranscode* transcodeOut;  // Decoder sink of the transcode job
   AudioFileSourceSD* file;
-  AudioFileSourceID3* id3;
   AudioGeneratorMP3* mp3;
+  AudioGeneratorSynth* synth;
+  AudioGeneratorTranscoded* transcoded;  // Sidecar of the current MP3
+  AudioGenerator* generator;  // What playback decodes from
 
   bool initialized;
   bool isPlaying;
+  volatile bool draining;  // Decoder finished, PCM ring still playing out
   float currentVolume;
+  float trackGain;  // Loudness normalization of the current track
 
   MQTTManager* mqttManager;  // For status reporting
   SDManager* sdManager;      // For file operations
+  EventBus* eventBus;        // Playback/download state changes
+  BufferPool* bufferPool;    // Download transfer buffers
+  SyncClock* syncClock;      // Shared time base for playFileAt()
+  portMUX_TYPE* syncClockLock;
 
   // NEW: Mutex for thread safety
   SemaphoreHandle_t audioMutex;
 
+  // Current track: seek table and playback position
+  bool indexed;          // trackIndex describes currentFile
+  String currentFile;
+  uint32_t playStartMs;  // Track time of the first frame decoded
+  uint32_t playBase;     // PCM ring consumer count at that frame
+  unsigned long lastResumeSave;
+  uint32_t playRequestUs;  // micros() at playMP3, until the first frame
+  bool awaitingFirstFrame;
+
+  // Decode cost of the current track, for comparing MP3 and its sidecar
+  const char* decodeVariant;  // "mp3", "pcm", "ima_adpcm" or "tone"
+  uint64_t decodeUs;          // In generator loop() (includes the DSP chain)
+  uint32_t decodeFrames;      // Frames it put into the PCM ring
+
+  // Exact index scans for the job task, so no whole-file read ever runs
+  // in the decode task or under audioMutex
+  String indexQueue;       // Next MP3 to scan
+  uint32_t indexRequests;  // A request during a scan is not lost
+
+  // Background loudness pass, while nothing plays or downloads
+  String loudnessFile;   // Next or current file to measure
+  String loudnessAfter;  // Replaced by queueLoudness(), measured next
+  bool analyzing;        // Decoder chain belongs to the pass
+
+  // Background transcoding into a cheap-to-play sidecar, after the
+  // loudness pass; resumes from its .part file when interrupted
+  String transcodeFile;  // Next or current MP3 to transcode
+  bool transcoding;      // Decoder chain belongs to the job
+  File transcodeDst;     // The .part being written
+  uint8_t* transcodeBlock;  // Pool block the encoder fills
+  uint32_t transcodeStartMs;
+
   // Download state
+  String downloadUrl;     // Queued for the job task, empty when none
+  String downloadTarget;  // SD path it goes to
   bool receivingFile;
   size_t expectedSize;
   size_t receivedSize;
   unsigned long lastChunkTime;
   String recvFilename;
-  bool downloadingInProgress;
+  volatile bool downloadingInProgress;  // Read by the sensor task
 
   void cleanup();
+  void releaseDecoder();
+
+  // I2S output sized by the active latency profile; rebuilt between tracks
+  void createOutput(uint32_t rate);
+  void rebuildOutput();
+  void syncDmaBuffers();
+  void applyLatencyProfile();
+  void holdOutput();
+  void releaseOutput();
+  void pumpRing();
+  uint32_t pumpFrames(uint32_t max);
+  uint32_t skipFrames(uint32_t max);
+  void pumpSynced();
+  int64_t sharedTimeUs(int64_t localUs, int32_t* skewPpb);
+  void disarmSync();
+  void publishState(AudioState state);
+
+  // Seek index sidecar (<file>.idx) of an MP3
+  bool loadIndex(const char* filename, Mp3Index& out);
+  bool buildIndex(const char* filename, Mp3Index& out, bool fullScan);
+  bool saveIndex(const char* filename, const Mp3Index& index);
+  uint32_t frameOffset(const char* filename, const Mp3Index& index,
+                       uint32_t frame);
+  void saveResumePoint();
+
+  void applyGain();
+  void loudnessPass();
+  void startLoudnessPass();
+  void finishLoudnessPass();
+  void interruptLoudness();
+  void nextLoudnessFile();
+  void transcodePass();
+  void startTranscodePass();
+  void finishTranscodePass();
+  void interruptTranscode();
+  // Sidecar header of an MP3 that is current (made from this MP3)
+  bool loadTranscoded(const char* filename, TranscodeInfo& out);
 
   // Internal handler for audio chunks
   bool handleAudioRequest(MQTTManager& mqtt, byte* payload,
@@ -70,11 +189,61 @@ class AudioManager {
   // Stop and cleanup
   void end();
 
-  // Play audio file from SD card
-  bool playFile(const char* filename);
+  // Play audio file from SD card, optionally from startMs into the track.
+  // "tone:<name>" plays a built-in tone; a file that cannot be played
+  // falls back to AUDIO_FALLBACK_TONE.
+  bool playFile(const char* filename, uint32_t startMs = 0);
+
+  // Play a file so that its first frame reaches the DAC at startUnixMs on
+  // the time base shared with the other gateways, to the sample. Started
+  // late, it seeks to where the others are.
+  bool playFileAt(const char* filename, int64_t startUnixMs);
 
   // Play MP3 file from SD card
-  bool playMP3(const char* filename);
+  bool playMP3(const char* filename, uint32_t startMs = 0);
+
+  // Play a built-in alarm tone: no SD access and no decoder, so it starts
+  // within one decode period. Loops until stop() or AUDIO_TONE_MAX_MS.
+  bool playTone(const char* name);
+
+  // Restart the current track at ms (frame accurate with a scanned index)
+  bool seek(uint32_t ms);
+
+  // Continue the track that was stopped or cut off by a power loss
+  bool resume();
+
+  // Position and length of the current track, 0 when unknown
+  uint32_t positionMs();
+  uint32_t durationMs();
+
+  // Scan every frame of an MP3 and store its exact seek index
+  bool indexFile(const char* filename);
+
+  // Leave the scan to backgroundJobs(); the loudness pass and transcoding
+  // wait for it
+  void queueIndex(const char* filename);
+
+  // From the low-priority job task: runs a queued download, then a queued
+  // index scan, both without the audio lock, so playback and the decoder
+  // preempt them and the MQTT task keeps serving the broker
+  void backgroundJobs();
+
+  // Measure an MP3's loudness in the background and store its playback
+  // gain in the index (restarts if playback interrupts it)
+  void queueLoudness(const char* filename);
+
+  // Decode the MP3 once in the background into a sidecar (PCM for short
+  // tones, IMA ADPCM otherwise) that playback prefers; pauses for playback
+  // and downloads and continues where it stopped
+  void queueTranscode(const char* filename);
+
+  // Which variant of the current track plays and what decoding it costs
+  // (share of one core), plus the transcoding job, as JSON
+  size_t decodeStatsJson(char* buf, size_t len);
+
+  // Duration, frames, index kind, title/artist and loudness of an MP3 as
+  // JSON
+  size_t fileInfoJson(const char* filename, char* buf, size_t len);
 
   // Play file from SD card (alias for playFile)
   bool playFileFromSD(const char* filename);
@@ -82,13 +251,45 @@ class AudioManager {
   // Stop currently playing audio
   void stop();
 
-  // Update - call this in loop() to keep audio playing
+  // Update - call this in loop() to keep audio playing. Decodes a burst
+  // into the PCM ring whenever it is below the refill mark.
   void loop();
 
+  // I2S writer stage: moves frames from the PCM ring into the I2S DMA
+  // buffers until they are full. Called from the high-priority output task;
+  // lock-free, never waits on the decoder.
+  void pumpOutput();
+
+  // Output buffering: the requested profile, and whether underruns may
+  // move to deeper ones. The ring depth changes at once, the I2S DMA
+  // buffers with the next track.
+  void setLatencyProfile(LatencyProfile profile, bool automatic = true);
+  // Active and requested profile, DMA and ring depth, switches as JSON
+  size_t latencyStatsJson(char* buf, size_t len);
+
+  // Shared clock (role, skew, beacon error) and scheduled playout
+  // (position error, trim, repeated and dropped frames) as JSON
+  size_t syncStatsJson(char* buf, size_t len);
+
+  // PCM ring fill level, underruns and decode burst stats as JSON
+  size_t pcmStatsJson(char* buf, size_t len);
+  uint32_t pcmUnderruns();
+
+  // SPECTRUM_BARS levels (0..255) of what the speaker is playing. The FFT
+  // runs in the calling task; true when the levels are from a new capture.
+  bool spectrumLevels(uint8_t* levels);
+
   // Volume control (0.0 to 1.0)
-  void setVolume(float volume);
+  void setVolume(float volume, bool quiet = false);
   float getVolume();
 
+  // Output DSP: speaker high-pass (0 = off), EQ bands, limiter ceiling
+  void setHighPass(float hz);
+  bool setEqBand(int band, DspBandType type, float hz, float gainDb, float q);
+  void setLimiter(float ceilingDbfs);
+  // Cycles per frame of each DSP stage, CPU share, limiter activity as JSON
+  size_t dspStatsJson(char* buf, size_t len);
+
   // Check if audio is currently playing
   bool playing();
 
@@ -108,6 +309,15 @@ class AudioManager {
   // Set SD manager for file operations
   void setSDManager(SDManager* sd);
 
+  // Set event bus for playback/download state events
+  void setEventBus(EventBus* bus);
+
+  // Set the pool downloads take their socket/SD buffer from
+  void setBufferPool(BufferPool* pool);
+
+  // Set the shared time base (updated by ESP-NOW beacons under lock)
+  void setSyncClock(SyncClock* clock, portMUX_TYPE* lock);
+
   // Check if audio file is currently downloading
   bool isDownloading();
 
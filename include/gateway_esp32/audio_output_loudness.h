@@ -0,0 +1,29 @@
+#ifndef AUDIO_OUTPUT_LOUDNESS_H
+#define AUDIO_OUTPUT_LOUDNESS_H
+
+#include <Arduino.h>
+
+#include "AudioOutput.h"
+#include "loudness.h"
+
+// AudioOutput for the background loudness pass: decoded samples go into
+// the meter and nowhere else. It accepts a quota of samples per decoder
+// loop(), then refuses, so the pass decodes in bursts as short as
+// playback does and leaves the audio task's period alone.
+class AudioOutputLoudness : public AudioOutput {
+ public:
+  explicit AudioOutputLoudness(LoudnessMeter* meter);
+
+  bool SetRate(int hz) override;
+  bool begin() override;
+  bool ConsumeSample(int16_t sample[2]) override;
+  bool stop() override;
+
+  void setQuota(uint32_t samples) { quota = samples; }
+
+ private:
+  LoudnessMeter* meter;
+  uint32_t quota;
+};
+
+#endif  // AUDIO_OUTPUT_LOUDNESS_H
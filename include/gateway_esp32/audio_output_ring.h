@@ -0,0 +1,51 @@
+#ifndef AUDIO_OUTPUT_RING_H
+#define AUDIO_OUTPUT_RING_H
+
+#include <Arduino.h>
+
+#include "AudioOutput.h"
+#include "dsp_chain.h"
+#include "pcm_ring.h"
+#include "resampler.h"
+
+// AudioOutput the MP3 generator decodes into. Samples go to the PCM ring
+// instead of straight to I2S, and ConsumeSample() returning false when the
+// ring is full ends the generator's loop(), so each loop() is one decode
+// burst. Every track is converted to RESAMPLER_OUTPUT_RATE on the way in,
+// so the real output (fed from the ring by the I2S writer task) keeps one
+// clock; only a rate without a resampler table still reaches its SetRate().
+// Resampled frames are gathered into DSP_BLOCK_FRAMES blocks and run
+// through the DSP chain (gain, high-pass, EQ, limiter) before they enter
+// the ring, so the writer task stays a plain copy.
+class AudioOutputRing : public AudioOutput {
+ public:
+  AudioOutputRing(PcmRing* ring, Resampler* resampler, DspChain* dsp,
+                  AudioOutput* sink);
+
+  bool SetRate(int hz) override;
+  bool SetBitsPerSample(int bits) override;
+  bool SetChannels(int channels) override;
+  bool begin() override;
+  bool ConsumeSample(int16_t sample[2]) override;
+  bool stop() override;
+
+  // Decoder finished: push the partial block and the limiter's look-ahead
+  // into the ring (ConsumeSample keeps room for both)
+  void drain();
+
+  // Rate of the frames in the ring (the output's rate)
+  uint32_t rate() const { return sinkRate; }
+
+ private:
+  PcmRing* ring;
+  Resampler* resampler;
+  DspChain* dsp;
+  AudioOutput* sink;
+  uint32_t sinkRate;
+  int16_t block[2 * DSP_MAX_FRAMES];
+  uint32_t staged;  // Frames in block
+
+  void flushBlock();
+};
+
+#endif  // AUDIO_OUTPUT_RING_H
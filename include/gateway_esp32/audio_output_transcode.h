@@ -0,0 +1,33 @@
+#ifndef AUDIO_OUTPUT_TRANSCODE_H
+#define AUDIO_OUTPUT_TRANSCODE_H
+
+#include <Arduino.h>
+
+#include "AudioOutput.h"
+#include "transcode.h"
+
+// AudioOutput for the background transcoding job: decoded frames go into
+// the encoder's block and nowhere else. Like the loudness sink it takes a
+// quota of frames per decoder loop(), and it refuses while a full block
+// waits to be written, so the decoder holds that frame until there is
+// room. A resumed job first drops the frames its restart point decodes
+// again.
+class AudioOutputTranscode : public AudioOutput {
+ public:
+  explicit AudioOutputTranscode(TranscodeEncoder* encoder);
+
+  bool SetRate(int hz) override;
+  bool begin() override;
+  bool ConsumeSample(int16_t sample[2]) override;
+  bool stop() override;
+
+  void setQuota(uint32_t frames) { quota = frames; }
+  void setSkip(uint32_t frames) { skip = frames; }
+
+ private:
+  TranscodeEncoder* encoder;
+  uint32_t quota;
+  uint32_t skip;
+};
+
+#endif  // AUDIO_OUTPUT_TRANSCODE_H
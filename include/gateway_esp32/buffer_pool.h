@@ -0,0 +1,68 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define BUFFER_POOL_BLOCK_SIZE 4096  // One flash sector, eight SD sectors
+#define BUFFER_POOL_BLOCKS 6         // OTA ring (4), download (1), spare (1)
+#define BUFFER_POOL_ALIGN 64         // Covers the cache line on target and host
+
+// Fixed-size transfer buffers shared by the stages that move bulk data:
+// socket reads for audio downloads and OTA, SD writes, and audio output.
+// The region is taken once in begin() from DMA-capable internal RAM
+// (heap_caps) on the ESP32, or as an aligned block on the host, so a block
+// handed from one stage to the next never needs to be copied into a
+// driver's bounce buffer. Acquire and release are lock-free and safe from
+// any task; a block belongs to whoever acquired it until it is released.
+class BufferPool {
+ public:
+  BufferPool();
+
+  // Allocate the region; false if the heap could not provide it
+  bool begin();
+
+  // A free block, or nullptr when the pool is exhausted (counted)
+  uint8_t* acquire();
+
+  // All n blocks or none, for stages that need a whole ring at once
+  bool acquire(uint8_t** blocks, int n);
+
+  void release(uint8_t* block);
+
+  bool owns(const void* p) const;
+
+  // Whether a driver could transfer directly from/to p
+  bool isDmaCapable(const void* p) const;
+
+  // Record a transfer handed to a DMA driver; counts a bounce copy when the
+  // buffer is not DMA-capable
+  void noteTransfer(const void* p);
+
+  int inUse() const;
+  int peakInUse() const { return peak.load(std::memory_order_relaxed); }
+  uint32_t exhausted() const { return exhaustedCount; }
+  uint32_t transfers() const { return transferCount; }
+  uint32_t bounceCopies() const { return bounceCount; }
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len) const;
+
+ private:
+  uint8_t* region;
+  std::atomic<uint32_t> freeMask;  // Bit per free block
+  std::atomic<int> peak;
+  volatile uint32_t exhaustedCount;
+  volatile uint32_t transferCount;
+  volatile uint32_t bounceCount;
+
+  void updatePeak();
+};
+
+static_assert(BUFFER_POOL_BLOCKS <= 32, "freeMask has one bit per block");
+static_assert(BUFFER_POOL_BLOCK_SIZE % BUFFER_POOL_ALIGN == 0,
+              "blocks must stay aligned");
+
+#endif  // BUFFER_POOL_H
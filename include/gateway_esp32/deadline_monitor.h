@@ -0,0 +1,113 @@
+#ifndef DEADLINE_MONITOR_H
+#define DEADLINE_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define DEADLINE_MAX_TASKS 6
+#define DEADLINE_LOG_PER_TASK 4  // Unpublished violations kept per task
+#define DEADLINE_CONTEXT_LEN 64
+
+// One iteration that overran its budget or missed its deadline
+struct DeadlineViolation {
+  uint8_t task;
+  uint32_t startUs;
+  uint32_t execUs;      // start -> end
+  uint32_t responseUs;  // release -> end; the deadline is one period
+  uint32_t lateUs;      // release -> start
+  // Other monitored tasks that ran during the iteration, with what they
+  // were doing, plus whatever the platform hook adds (e.g. the task on the
+  // other core)
+  char others[DEADLINE_CONTEXT_LEN];
+};
+
+struct DeadlineTaskStats {
+  const char* name;
+  uint32_t periodUs;
+  uint32_t budgetUs;
+  uint32_t iterations;
+  uint32_t overruns;        // Execution longer than the budget
+  uint32_t deadlineMisses;  // Finished more than one period after release
+  uint32_t skippedReleases;  // Started so late that whole periods were lost
+  uint32_t execMaxUs;
+  uint32_t responseMaxUs;  // Worst-case response time
+  uint32_t lastExecUs;
+};
+
+// Deadline monitor for periodic tasks: each iteration is bracketed with
+// begin()/end(), which never block, and violations are drained with
+// pollViolation()
+class DeadlineMonitor {
+ public:
+  typedef uint32_t (*ClockFn)();
+  // Appends platform context for a violation of task `self` into buf
+  typedef void (*ContextFn)(int self, char* buf, size_t len);
+
+  explicit DeadlineMonitor(ClockFn clock, ContextFn context = nullptr);
+
+  // Returns a task id, or -1 when full. Call before the tasks start.
+  int registerTask(const char* name, uint32_t periodUs, uint32_t budgetUs);
+
+  void begin(int id);
+  void end(int id);
+
+  // What the task is doing right now (a string literal or other storage
+  // that stays valid), shown in other tasks' violations. nullptr clears it;
+  // the last label of an iteration is kept until the next begin() so a
+  // short stage that delayed someone else is still named afterwards.
+  void setContext(int id, const char* context);
+
+  // Oldest unpublished violation of any task; false when there is none
+  bool pollViolation(DeadlineViolation& out);
+  uint32_t lostViolations() const { return lost; }
+
+  int taskCount() const { return count; }
+  DeadlineTaskStats stats(int id) const;
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len) const;
+  size_t violationToJson(const DeadlineViolation& v, char* buf,
+                         size_t len) const;
+
+ private:
+  struct Task {
+    DeadlineTaskStats s;
+    uint32_t releaseUs;  // Ideal release of the current iteration
+    uint32_t startUs;
+    volatile uint32_t lastEndUs;
+    volatile bool running;
+    volatile bool started;  // At least one iteration so far
+    const char* volatile context;
+    const char* volatile lastContext;  // Latest context of this iteration
+
+    // Single-producer log, written by the task, read by pollViolation()
+    DeadlineViolation log[DEADLINE_LOG_PER_TASK];
+    std::atomic<uint32_t> logHead;
+    std::atomic<uint32_t> logTail;
+  };
+
+  ClockFn clock;
+  ContextFn contextHook;
+  Task tasks[DEADLINE_MAX_TASKS];
+  int count;
+  volatile uint32_t lost;
+
+  void record(int id, uint32_t execUs, uint32_t responseUs, uint32_t lateUs);
+};
+
+// begin() on construction, end() when the scope closes
+class IterationScope {
+ public:
+  IterationScope(DeadlineMonitor& monitor, int id) : m(monitor), id(id) {
+    m.begin(id);
+  }
+  ~IterationScope() { m.end(id); }
+
+ private:
+  DeadlineMonitor& m;
+  int id;
+};
+
+#endif  // DEADLINE_MONITOR_H
@@ -0,0 +1,93 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming applier for binary delta images ("SADL" format).
+//
+// A delta rebuilds the target firmware from the running image plus literal
+// bytes. It is consumed in arbitrary slices as it arrives from the network
+// and produces the target in order, so it can feed esp_ota_write directly.
+// Memory use is fixed: the header, one opcode and a small copy buffer.
+//
+// Layout (little-endian):
+//   header  "SADL" | version u8 | 3 reserved | sourceSize u32 | targetSize u32
+//           | sourceSha256[32] | targetSha256[32]
+//   ops     0x01 COPY   srcOffset u32, length u32   (bytes from running image)
+//           0x02 INSERT length u32, <length bytes>  (literal bytes)
+//           0x00 END
+//
+// scripts/ota_delta.py creates deltas and contains a reference applier.
+
+#define DELTA_MAGIC "SADL"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 80
+#define DELTA_COPY_BUFFER 512
+
+enum DeltaOp : uint8_t { DELTA_OP_END = 0, DELTA_OP_COPY = 1, DELTA_OP_INSERT = 2 };
+
+struct DeltaHeader {
+  uint8_t version;
+  uint32_t sourceSize;
+  uint32_t targetSize;
+  uint8_t sourceSha256[32];
+  uint8_t targetSha256[32];
+};
+
+class DeltaPatcher {
+ public:
+  // Reads from the running image / appends to the target, false on I/O error
+  typedef bool (*ReadFn)(void* ctx, uint32_t offset, uint8_t* dst, size_t len);
+  typedef bool (*WriteFn)(void* ctx, const uint8_t* data, size_t len);
+
+  DeltaPatcher(ReadFn read, WriteFn write, void* ctx);
+
+  // Forget any partial patch and wait for a new header
+  void reset();
+
+  // True if the data starts with the delta magic
+  static bool isDelta(const uint8_t* data, size_t len);
+
+  // Consume the next slice of the patch. Returns false on a malformed patch
+  // or a failed read/write; the patcher then stays in the error state.
+  bool feed(const uint8_t* data, size_t len);
+
+  bool headerReady() const { return state > STATE_HEADER; }
+  bool finished() const { return state == STATE_DONE; }
+  bool failed() const { return state == STATE_ERROR; }
+  const DeltaHeader& header() const { return hdr; }
+  uint32_t written() const { return outputBytes; }
+  const char* error() const { return errorMsg; }
+
+ private:
+  enum State : uint8_t {
+    STATE_HEADER,
+    STATE_OPCODE,
+    STATE_ARGS,
+    STATE_INSERT,
+    STATE_DONE,
+    STATE_ERROR
+  };
+
+  ReadFn readSource;
+  WriteFn writeTarget;
+  void* ctx;
+
+  State state;
+  DeltaHeader hdr;
+  uint8_t pending[DELTA_HEADER_SIZE];  // Header or opcode arguments
+  size_t pendingLen;
+  size_t pendingNeed;
+  uint8_t op;
+  uint32_t insertRemaining;
+  uint32_t outputBytes;
+  const char* errorMsg;
+  uint8_t copyBuf[DELTA_COPY_BUFFER];
+
+  bool parseHeader();
+  bool runCopy(uint32_t offset, uint32_t length);
+  bool fail(const char* msg);
+};
+
+#endif  // DELTA_PATCH_H
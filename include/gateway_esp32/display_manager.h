@@ -10,6 +10,8 @@ class SensorManager;
 class SDManager;
 class AudioManager;
 #include "../shared/sensor_data.h"
+#include "event_bus.h"
+#include "spectrum.h"
 
 // Display configuration
 #define SCREEN_WIDTH 128
@@ -37,7 +39,9 @@ class DisplayManager {
   void setSensorManager(SensorManager* sensorMgr);
   void setSDManager(SDManager* sdMgr);
   void setAudioManager(AudioManager* audioMgr);
-  void setRemoteSensorData(SensorData* remoteData);
+
+  // Subscribe to sensor, audio and network events (call during setup)
+  void setEventBus(EventBus* bus);
 
   // Startup screen
   void showStartup();
@@ -52,7 +56,17 @@ class DisplayManager {
   SensorManager* sensorManager;
   SDManager* sdManager;
   AudioManager* audioManager;
-  SensorData* remoteSensorData;
+
+  // State kept up to date from the event bus
+  EventBus* eventBus;
+  int subscriberId;
+  SensorData remoteData;
+  bool remoteDataValid;
+  AudioState audioState;
+  NetworkStateEvent networkState;
+  uint8_t spectrumBars[SPECTRUM_BARS];
+
+  void drainEvents();
 
   // Private drawing methods
   void drawPageSensors();
@@ -0,0 +1,122 @@
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define DSP_BANDS 4              // EQ biquads after the high-pass
+#define DSP_BLOCK_FRAMES 64      // Frames the decoder side hands over
+#define DSP_MAX_FRAMES 72        // Largest block process() takes
+#define DSP_LOOKAHEAD_FRAMES 64  // Limiter delay, ~1.5 ms at 44.1 kHz
+#define DSP_DEFAULT_HPF_HZ 120.0f     // Below what the speaker can move
+#define DSP_DEFAULT_LIMIT_DBFS -1.0f  // Limiter ceiling
+#define DSP_RELEASE_MS 80.0f          // Limiter recovery to unity gain
+
+enum DspStage : uint8_t {
+  DSP_STAGE_GAIN,
+  DSP_STAGE_HIGH_PASS,
+  DSP_STAGE_EQ,
+  DSP_STAGE_LIMITER,
+  DSP_STAGE_COUNT
+};
+
+enum DspBandType : uint8_t {
+  DSP_BAND_OFF,
+  DSP_BAND_PEAK,
+  DSP_BAND_LOW_SHELF,
+  DSP_BAND_HIGH_SHELF
+};
+
+// Direct form II biquad, coef = {b0, b1, b2, a1, a2}, w = {w0, w1}
+// (esp-dsp's dsps_biquad_f32 on the ESP32 unless DSP_NO_ESP_DSP)
+void dspBiquad(const float* in, float* out, int len, const float* coef,
+               float* w);
+
+// Output stage between the resampler and the PCM ring: gain, speaker
+// high-pass, DSP_BANDS EQ bands and a look-ahead peak limiter
+class DspChain {
+ public:
+  typedef uint32_t (*CycleFn)();
+
+  explicit DspChain(CycleFn cycles = nullptr);
+
+  // ===== Settings (any task) =====
+  void setRate(uint32_t hz);
+  void setGain(float linear);
+  void setHighPass(float hz);  // 0 turns it off
+  bool setBand(int band, DspBandType type, float hz, float gainDb, float q);
+  void setLimiter(float ceilingDbfs);
+  float gain() const { return cfg.gain; }
+
+  // ===== Audio (one task) =====
+  // Clear filter state and the limiter delay (new track, flush)
+  void reset();
+  // In place; frames <= DSP_MAX_FRAMES. Output lags input by
+  // DSP_LOOKAHEAD_FRAMES.
+  void process(int16_t* stereo, uint32_t frames);
+  // End of stream: the DSP_LOOKAHEAD_FRAMES still in the limiter
+  uint32_t tail(int16_t* stereo);
+
+  // ===== Status =====
+  // Cycles per frame of each stage, limiter activity; JSON for MQTT,
+  // returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len, uint32_t cpuHz) const;
+  uint64_t stageCycles(int stage) const { return cyclesTotal[stage]; }
+  uint64_t frames() const { return frameCount; }
+  uint32_t limited() const { return limitedFrames; }
+  float minLimiterGain() const { return limiterMin; }
+
+ private:
+  struct Band {
+    DspBandType type;
+    float hz, gainDb, q;
+  };
+  struct Config {
+    float gain;
+    float hpfHz;
+    float ceiling;  // Linear
+    Band bands[DSP_BANDS];
+  };
+
+  CycleFn cycles;
+  uint32_t rate;
+  Config cfg;
+  std::atomic<bool> dirty;
+
+  // Applied coefficients and state, audio task only
+  float gainNow;
+  float hpf[5];
+  bool hpfOn;
+  float eq[DSP_BANDS][5];
+  int eqCount;
+  float w[2][1 + DSP_BANDS][2];  // Per channel, per biquad
+  float ceilingNow;
+  float releaseStep;
+
+  // Limiter: delay line, sliding minimum of the required gain (monotonic
+  // queue), then a moving average over the look-ahead
+  float delay[2][DSP_LOOKAHEAD_FRAMES];
+  float minValue[DSP_LOOKAHEAD_FRAMES + 1];
+  uint32_t minIndex[DSP_LOOKAHEAD_FRAMES + 1];
+  uint32_t minHead, minCount;
+  float avg[DSP_LOOKAHEAD_FRAMES];
+  float avgSum;
+  float held;  // Required gain after the release limit
+  uint32_t pos;
+  uint32_t n;  // Frames through the limiter since reset
+
+  float left[DSP_MAX_FRAMES];
+  float right[DSP_MAX_FRAMES];
+
+  uint64_t cyclesTotal[DSP_STAGE_COUNT];
+  uint64_t frameCount;
+  uint32_t limitedFrames;
+  float limiterMin;
+
+  void applyConfig();
+  void limit(uint32_t frames);
+};
+
+#endif  // DSP_CHAIN_H
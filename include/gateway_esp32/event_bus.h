@@ -0,0 +1,139 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "../shared/sensor_data.h"
+
+#define EVENT_BUS_CAPACITY 32  // Slots in the shared ring, power of two
+#define EVENT_BUS_MAX_SUBSCRIBERS 8
+
+// ============================================================================
+// Event types
+// ============================================================================
+// Small PODs only: an event is copied into the ring once by the publisher and
+// read in place by every subscriber.
+
+enum EventType : uint8_t {
+  EVENT_SENSOR_SAMPLE,  // Remote node sample accepted over ESP-NOW
+  EVENT_AUDIO_STATE,    // Playback / download state changed
+  EVENT_NETWORK_STATE,  // WiFi or broker connectivity changed
+  EVENT_TYPE_COUNT
+};
+
+#define EVENT_MASK(type) (1u << (type))
+
+enum AudioState : uint8_t {
+  AUDIO_STATE_IDLE,
+  AUDIO_STATE_PLAYING,
+  AUDIO_STATE_DOWNLOADING
+};
+
+struct SensorSampleEvent {
+  SensorData data;
+  uint8_t node;  // Mesh origin id of the sample
+};
+
+struct AudioStateEvent {
+  AudioState state;
+  float volume;
+};
+
+struct NetworkStateEvent {
+  bool wifiConnected;
+  bool mqttConnected;
+  int8_t rssi;
+};
+
+template <typename T>
+struct EventTypeOf;
+template <>
+struct EventTypeOf<SensorSampleEvent> {
+  static const EventType value = EVENT_SENSOR_SAMPLE;
+};
+template <>
+struct EventTypeOf<AudioStateEvent> {
+  static const EventType value = EVENT_AUDIO_STATE;
+};
+template <>
+struct EventTypeOf<NetworkStateEvent> {
+  static const EventType value = EVENT_NETWORK_STATE;
+};
+
+struct Event {
+  EventType type;
+  uint32_t seq;  // Position on the bus, increases by one per publish
+  union {
+    SensorSampleEvent sensor;
+    AudioStateEvent audio;
+    NetworkStateEvent network;
+  };
+
+  // Typed access, nullptr if the event holds another type
+  template <typename T>
+  const T* as() const {
+    return type == EventTypeOf<T>::value ? reinterpret_cast<const T*>(&sensor)
+                                         : nullptr;
+  }
+};
+
+// ============================================================================
+// EventBus
+// ============================================================================
+// Multi-producer broadcast ring. Publishers claim a slot with one atomic
+// increment and never block, so they are safe to call from the ESP-NOW
+// callback. Each subscriber owns a cursor into the ring and a type filter,
+// which gives it a private queue over the shared, preallocated slots. A
+// subscriber that falls more than EVENT_BUS_CAPACITY events behind skips
+// ahead and counts what it lost instead of holding up the publishers.
+class EventBus {
+ public:
+  EventBus();
+
+  // Returns a subscriber id, or -1 when all slots are taken. Safe to call
+  // from any task; the subscriber sees events published from now on.
+  int subscribe(uint32_t typeMask);
+
+  template <typename T>
+  void publish(const T& payload) {
+    uint32_t pos = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[pos & (EVENT_BUS_CAPACITY - 1)];
+
+    // Per-slot sequence lock: odd while being written
+    slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event.type = EventTypeOf<T>::value;
+    slot.event.seq = pos;
+    memcpy((void*)&slot.event.sensor, &payload, sizeof(T));
+    slot.seq.store(2 * pos + 2, std::memory_order_release);
+  }
+
+  // Next event for the subscriber, false when it is caught up
+  bool poll(int subscriber, Event& out);
+
+  uint32_t dropped(int subscriber) const;
+  uint32_t published() const { return head.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    Event event;
+  };
+
+  struct Subscriber {
+    uint32_t cursor;
+    uint32_t mask;
+    uint32_t dropped;
+    std::atomic<bool> active;
+  };
+
+  Slot slots[EVENT_BUS_CAPACITY];
+  std::atomic<uint32_t> head;
+  Subscriber subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+  std::atomic<uint8_t> nextSubscriber;
+};
+
+#endif  // EVENT_BUS_H
@@ -0,0 +1,64 @@
+#ifndef LATENCY_PROFILE_H
+#define LATENCY_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define I2S_DMA_BUF_FRAMES 128  // Per DMA buffer, fixed by AudioOutputI2S
+
+// Automatic switching: one profile deeper per underrun and hold-off, one
+// step back after a quiet spell (doubled each time a step back fails)
+#define LATENCY_SWITCH_HOLD_MS 2000
+#define LATENCY_RELAX_MS (5 * 60 * 1000UL)
+#define LATENCY_RELAX_MAX_MS (60 * 60 * 1000UL)
+
+// Output buffering, shallow to deep: a live stream wants the first, an
+// alarm during heavy WiFi traffic the last
+enum LatencyProfile : uint8_t {
+  LATENCY_LOW,
+  LATENCY_BALANCED,
+  LATENCY_ROBUST,
+  LATENCY_PROFILE_COUNT
+};
+
+struct LatencyProfileSpec {
+  const char* name;
+  uint8_t dmaBuffers;   // I2S DMA descriptors of I2S_DMA_BUF_FRAMES each
+  uint16_t ringFrames;  // PCM ring depth the decoder fills up to
+};
+
+const LatencyProfileSpec& latencyProfileSpec(LatencyProfile profile);
+// "low", "balanced" or "robust"; false for anything else
+bool latencyProfileByName(const char* name, LatencyProfile* out);
+// Audio buffered between the decoder and the DAC when both stages are full
+uint32_t latencyProfileMs(LatencyProfile profile, uint32_t rateHz);
+
+// Picks the active profile from the PCM ring's underruns, never shallower
+// than the requested one
+class LatencyGovernor {
+ public:
+  LatencyGovernor();
+
+  void configure(LatencyProfile requested, bool automatic);
+  // underruns: running count; true when active() changed
+  bool update(uint32_t underruns, uint32_t nowMs);
+
+  LatencyProfile active() const { return current; }
+  LatencyProfile requested() const { return floor; }
+  bool automatic() const { return autoSwitch; }
+  uint32_t switches() const { return switchCount; }
+
+ private:
+  LatencyProfile floor;
+  LatencyProfile current;
+  bool autoSwitch;
+  bool started;
+  bool relaxed;  // Last switch was a step back
+  uint32_t relaxMs;
+  uint32_t lastUnderruns;
+  uint32_t lastSwitchMs;
+  uint32_t lastUnderrunMs;
+  uint32_t switchCount;
+};
+
+#endif  // LATENCY_PROFILE_H
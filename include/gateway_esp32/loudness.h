@@ -0,0 +1,64 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOUDNESS_TARGET_LUFS -16.0f  // Level every track is normalized to
+#define LOUDNESS_MAX_GAIN_DB 12.0f   // AudioOutput gain stops at 4.0
+#define LOUDNESS_MIN_GAIN_DB -20.0f
+#define LOUDNESS_FLOOR_LUFS -70.0f   // Absolute gate of BS.1770
+#define LOUDNESS_BIN_LU 0.25f        // Histogram resolution of block levels
+#define LOUDNESS_BINS 300            // -70 .. +5 LUFS
+
+// Integrated loudness after ITU-R BS.1770 / EBU R128, with the gated blocks
+// kept as a 0.25 LU histogram so memory is fixed whatever the track length
+class LoudnessMeter {
+ public:
+  LoudnessMeter();
+
+  // Start a new measurement
+  void reset();
+  // Sample rate of what follows; filter state is kept across changes
+  void setRate(uint32_t rateHz);
+
+  void addFrame(int16_t left, int16_t right);
+  void add(const int16_t* stereo, uint32_t frames);
+
+  // LOUDNESS_FLOOR_LUFS when nothing passed the gates (silence, < 400 ms)
+  float integratedLufs() const;
+  float peak() const { return samplePeak; }  // 0..1 of full scale
+  uint32_t blocks() const { return blockCount; }
+  uint64_t frames() const { return frameCount; }
+
+  // Gain reaching targetLufs, clamped to the output's range and lowered so
+  // the sample peak does not clip
+  float gainDb(float targetLufs) const;
+
+ private:
+  struct Biquad {
+    float b0, b1, b2, a1, a2;
+  };
+
+  Biquad shelf;  // Stage 1: head-related high shelf
+  Biquad highPass;  // Stage 2: RLB high-pass
+  float state[2][4];  // Per channel: two transposed direct form II stages
+
+  uint32_t rate;
+  uint32_t hopFrames;  // 100 ms
+  uint32_t hopFill;
+  float hopEnergy;    // Sum of squares of the current 100 ms
+  float hops[4];      // Mean square of the last four 100 ms hops
+  uint32_t hopTotal;
+
+  uint32_t binCount[LOUDNESS_BINS];
+  float binEnergy[LOUDNESS_BINS];
+  uint32_t blockCount;
+  uint64_t frameCount;
+  float samplePeak;
+
+  float filter(int channel, float x);
+  void endHop();
+};
+
+#endif  // LOUDNESS_H
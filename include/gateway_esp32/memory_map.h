@@ -0,0 +1,42 @@
+// Static RAM budget of the gateway, one line per source file that owns
+// long-lived storage. Each file checks its static allocations against its
+// line with static_assert, and scripts/ram_report.py prints the linked sizes
+// next to these budgets after every build.
+//
+// Still on the heap: the WiFi/lwIP stack, File handles inside the SD
+// library, HTTPClient's internal Strings, the SSD1306 frame buffer,
+// PubSubClient packet buffer, the DMA transfer pool in buffer_pool.h, the
+// microphone's I2S DMA buffers (8 KB, sensor_manager.h), and the libmad
+// workspace and PCM ring (about 60 KB, audio_manager.cpp) (all allocated
+// once at startup), and the transient OTA task stacks
+// (created only for the duration of a transfer).
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#define RAM_BUDGET_RTOS_TASKS (50 * 1024)     // Stacks, TCBs, queues, deadlines
+#define RAM_BUDGET_AUDIO_MANAGER (16 * 1024)  // Decoder slots, index, DSP
+#define RAM_BUDGET_OTA_MANAGER (1 * 1024)     // Ring queues (blocks: pool)
+#define RAM_BUDGET_RULE_MANAGER (8 * 1024)    // Rule task stack + input queue
+#define RAM_BUDGET_MAIN (13 * 1024)           // Managers, MQTT arena, outbox
+#define RAM_BUDGET_WIFI_ESPNOW_MANAGER (2 * 1024)  // Mesh, analytics, clock
+#define RAM_BUDGET_SENSOR_MANAGER (6 * 1024)  // Noise monitor and its FFT
+
+// .data and .bss share dram0_0_seg (about 124 KB) with the Arduino core,
+// ESP-IDF, WiFi and lwIP, so the budgets together stay well below it
+#define RAM_STATIC_LIMIT (96 * 1024)
+static_assert(RAM_BUDGET_RTOS_TASKS + RAM_BUDGET_AUDIO_MANAGER +
+                      RAM_BUDGET_OTA_MANAGER + RAM_BUDGET_RULE_MANAGER +
+                      RAM_BUDGET_MAIN + RAM_BUDGET_WIFI_ESPNOW_MANAGER +
+                      RAM_BUDGET_SENSOR_MANAGER <=
+                  RAM_STATIC_LIMIT,
+              "Static RAM budgets exceed RAM_STATIC_LIMIT");
+
+// Storage for an object constructed in place with placement new, so the
+// object's lifetime can follow playback without using the heap
+template <typename T>
+struct StaticSlot {
+  alignas(T) unsigned char bytes[sizeof(T)];
+  void* get() { return bytes; }
+};
+
+#endif  // MEMORY_MAP_H
@@ -0,0 +1,43 @@
+#ifndef MESH_STATS_H
+#define MESH_STATS_H
+
+#include <Arduino.h>
+
+#include "../shared/espnow_mesh.h"
+
+#define MESH_STATS_MAX_ORIGINS 64  // Node ids tracked for sequence gaps
+
+// Per-hop delivery statistics for frames arriving over the ESP-NOW mesh.
+// Frames are bucketed by how many transmissions they took to arrive, so
+// bucket 1 is direct traffic and bucket N went through N-1 relays.
+struct MeshHopStats {
+  uint32_t received;
+  uint32_t lost;           // Sequence gaps seen on frames in this bucket
+  uint32_t delaySumMs;     // Relay residence time, summed over frames
+  uint16_t delayMaxMs;
+};
+
+class MeshStats {
+ public:
+  MeshStats();
+
+  // Record a data frame accepted by the gateway (called from ESP-NOW rx)
+  void record(const MeshHeader& header);
+  void recordDuplicate();
+  void recordLegacy();
+
+  // Serialize as JSON into buf, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len);
+
+  void reset();
+
+ private:
+  MeshHopStats hops[MESH_MAX_HOPS + 1];  // Index = hop count, 0 unused
+  uint16_t lastSeq[MESH_STATS_MAX_ORIGINS];
+  bool seenOrigin[MESH_STATS_MAX_ORIGINS];
+  uint32_t duplicates;
+  uint32_t legacyFrames;
+  portMUX_TYPE lock;
+};
+
+#endif  // MESH_STATS_H
@@ -0,0 +1,47 @@
+#ifndef MESSAGE_ARENA_H
+#define MESSAGE_ARENA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MESSAGE_ARENA_SIZE 1024  // Scratch bytes per dispatched MQTT message
+#define MESSAGE_ARENA_ALIGN 4
+
+// Bump allocator for the lifetime of one MQTT message, reset after every
+// dispatch (requests that do not fit fall back to malloc and are counted)
+class MessageArena {
+ public:
+  MessageArena();
+  ~MessageArena();
+
+  // Uninitialized storage, nullptr only if the heap fallback also fails
+  void* alloc(size_t size);
+
+  // NUL-terminated copy of len bytes (payloads are not terminated)
+  char* copy(const char* data, size_t len);
+
+  // printf into the arena
+  char* format(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  char* vformat(const char* fmt, va_list args);
+
+  // Release everything allocated since the last reset
+  void reset();
+
+  size_t used() const { return offset; }
+  size_t highWater() const { return peak; }
+  uint32_t fallbacks() const { return fallbackCount; }
+
+ private:
+  struct Fallback {
+    Fallback* next;
+  };
+
+  uint8_t buffer[MESSAGE_ARENA_SIZE] __attribute__((aligned(8)));
+  size_t offset;
+  size_t peak;
+  Fallback* fallbackList;
+  uint32_t fallbackCount;
+};
+
+#endif  // MESSAGE_ARENA_H
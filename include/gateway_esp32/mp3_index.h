@@ -0,0 +1,139 @@
+#ifndef MP3_INDEX_H
+#define MP3_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MP3_INDEX_MAGIC 0x58444933u  // "3IDX"
+#define MP3_INDEX_VERSION 3
+#define MP3_INDEX_ENTRIES 512  // Seek points per file (2 KB of offsets)
+#define MP3_INDEX_SUFFIX ".idx"  // Sidecar next to the MP3 on the SD card
+#define MP3_TAG_TEXT_LEN 40      // Title/artist kept from the ID3v2 tag (UTF-8)
+
+// Flags
+#define MP3_INDEX_EXACT 0x01  // Every frame header scanned
+#define MP3_INDEX_VBR 0x02
+#define MP3_INDEX_XING 0x04  // Xing/Info header present
+#define MP3_INDEX_VBRI 0x08  // Fraunhofer VBRI header present
+#define MP3_INDEX_LOUDNESS 0x10  // loudness/gain measured (background pass)
+
+// One MPEG audio Layer III frame header
+struct Mp3FrameHeader {
+  uint32_t sampleRate;
+  uint32_t bitrate;  // bits per second
+  uint16_t samplesPerFrame;
+  uint16_t frameBytes;
+  uint8_t channels;
+  uint8_t mpeg1;  // MPEG-1 (vs 2 / 2.5), decides side info length
+};
+
+// Parse the 4 header bytes at h; false if they are not a Layer III header
+bool parseMp3Header(const uint8_t* h, Mp3FrameHeader& out);
+
+// Length of an ID3v2 tag starting at h (10 bytes available), 0 if none
+uint32_t id3v2TagSize(const uint8_t* h);
+
+// Fixed-size header of the index, stored first in the sidecar file
+struct Mp3IndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t entries;     // Used entries of offsets[]
+  uint32_t fileSize;    // Size of the MP3 when indexed, for staleness checks
+  uint32_t audioStart;  // First audio frame (after ID3v2 and Xing/VBRI)
+  uint32_t audioEnd;    // End of the last frame (before ID3v1/APE tags)
+  uint32_t totalFrames;
+  uint32_t framesPerEntry;
+  uint32_t sampleRate;
+  uint32_t bitrate;  // Average, bits per second
+  uint16_t samplesPerFrame;
+  uint8_t channels;
+  uint8_t flags;  // MP3_INDEX_*
+  int16_t loudness;  // Integrated loudness, LUFS x 100
+  int16_t gain;      // Playback gain to the normalization target, dB x 100
+  char title[MP3_TAG_TEXT_LEN];   // TIT2, "" if absent
+  char artist[MP3_TAG_TEXT_LEN];  // TPE1, "" if absent
+};
+
+// Seek table of one MP3: offsets[i] is where frame i * framesPerEntry
+// starts, so time -> entry is a division and the exact frame is at most
+// framesPerEntry - 1 header hops further. Plain data, saved to the
+// sidecar as header + the used offsets.
+struct Mp3Index {
+  Mp3IndexHeader h;
+  uint32_t offsets[MP3_INDEX_ENTRIES];
+
+  bool valid() const;
+  uint32_t durationMs() const;
+  uint32_t frameForMs(uint32_t ms) const;
+  uint32_t msForFrame(uint32_t frame) const;
+  // Playback position of a byte offset, interpolated inside its entry
+  uint32_t msForOffset(uint32_t offset) const;
+  // Bytes to write for the sidecar (header + used offsets)
+  size_t storedSize() const;
+};
+
+// Builds and uses Mp3Index through a caller-supplied reader, so the same
+// code runs against an SD File on the gateway and a memory image on the
+// host. All reads go through one scratch buffer (a pool block on target).
+class Mp3Indexer {
+ public:
+  // Read up to len bytes at offset; returns bytes read
+  typedef size_t (*ReadFn)(void* ctx, uint32_t offset, uint8_t* buf,
+                           size_t len);
+
+  Mp3Indexer(ReadFn read, void* ctx, uint32_t fileSize, uint8_t* scratch,
+             size_t scratchLen);
+
+  // fullScan walks every frame header (exact table, the whole file is
+  // read once). Without it only the start of the file is read: the table
+  // comes from VBRI, Xing or the CBR frame size and is approximate.
+  // ID3v2 tags are stepped over by their declared sizes; only the title
+  // and artist frames are read.
+  bool build(Mp3Index& out, bool fullScan);
+
+  // Byte offset of frame `frame`; exact with a scanned index
+  uint32_t frameOffset(const Mp3Index& index, uint32_t frame);
+
+  // Latest frame in [frame - maxBack, frame] whose main data starts in the
+  // frame itself (main_data_begin 0): a decoder started there needs no
+  // bit reservoir from earlier frames, so it puts out every frame from
+  // there on. UINT32_MAX if there is none; *offset gets its position.
+  // Needs a scanned index.
+  uint32_t selfContainedFrame(const Mp3Index& index, uint32_t frame,
+                              uint32_t maxBack, uint32_t* offset);
+
+  uint32_t bytesRead() const { return readBytes; }
+
+ private:
+  // Xing/Info or VBRI contents of the first frame
+  struct VbrInfo {
+    uint32_t frames;
+    uint32_t bytes;
+    bool xingToc;
+    uint8_t toc[100];  // Xing: byte position (1/256) at each percent
+    // VBRI: byte size of each run of vbriFramesPerEntry frames
+    uint16_t vbriEntries;
+    uint16_t vbriScale;
+    uint16_t vbriEntrySize;
+    uint16_t vbriFramesPerEntry;
+  };
+
+  ReadFn readFn;
+  void* ctx;
+  uint32_t fileSize;
+  uint8_t* buf;
+  size_t cap;
+  uint32_t base;  // File offset of buf[0]
+  size_t len;     // Valid bytes in buf
+  uint32_t readBytes;
+
+  const uint8_t* at(uint32_t offset, size_t n);
+  bool headerAt(uint32_t offset, Mp3FrameHeader& out);
+  uint32_t sync(uint32_t offset, uint32_t limit, Mp3FrameHeader& out);
+  void readTags(uint32_t tag, uint32_t tagLen, Mp3IndexHeader& h);
+  void scan(uint32_t start, Mp3Index& out);
+  void estimate(uint32_t first, const Mp3FrameHeader& fh, const VbrInfo& v,
+                Mp3Index& out);
+};
+
+#endif  // MP3_INDEX_H
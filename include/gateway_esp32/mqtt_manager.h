@@ -3,10 +3,26 @@
 
 #include <Arduino.h>
 #include <PubSubClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 
 #include <vector>
 
 #include "../shared/mqtt_handler.h"
+#include "message_arena.h"
+
+#define MQTT_OUTBOX_SLOTS 3            // Publishes waiting for the MQTT task
+#define MQTT_OUTBOX_TOPIC_SIZE 64
+#define MQTT_OUTBOX_PAYLOAD_SIZE 256   // Rule status JSON, OTA reports
+
+// A publish from another task, copied so the caller's buffers can go
+struct MqttOutboxMessage {
+  char topic[MQTT_OUTBOX_TOPIC_SIZE];
+  char payload[MQTT_OUTBOX_PAYLOAD_SIZE];
+  uint16_t length;
+  bool retain;
+};
 
 class MQTTManager {
  private:
@@ -19,8 +35,35 @@ class MQTTManager {
   bool firstConnection;
   unsigned long lastReconnectAttempt;
 
+  // Per-message scratch memory, reset after every dispatch
+  MessageArena arena;
+
+  // Dispatch measurements
+  uint32_t dispatchCount;
+  uint32_t dispatchUsTotal;
+  uint32_t dispatchUsMax;
+
+  // PubSubClient has no lock, so only the task that called claimClient()
+  // touches it. Other tasks' publishes wait here until flushOutbox().
+  TaskHandle_t owner;
+  volatile bool connectedState;
+  QueueHandle_t outbox;
+  StaticQueue_t outboxStruct;
+  uint8_t outboxStorage[MQTT_OUTBOX_SLOTS * sizeof(MqttOutboxMessage)];
+  uint32_t outboxDrops;
+
+  // True when the caller may use the client directly
+  bool ownsClient() const;
+
+  // Copy a publish into the outbox, false when it cannot be sent later
+  bool enqueue(const char* topic, const byte* payload, unsigned int length,
+               bool retain);
+
   // Wildcard matching helper
-  bool topicMatches(const String& pattern, const String& topic);
+  static bool topicMatches(const char* pattern, const char* topic);
+
+  // Reset the arena and record the dispatch time
+  void finishDispatch(uint32_t startUs);
 
   // Static callback bridge (required by PubSubClient)
   static void globalCallback(char* topic, byte* payload, unsigned int length);
@@ -37,6 +80,12 @@ class MQTTManager {
   // Loop - call this in main loop() to maintain connection
   void loop();
 
+  // Make the calling task the only user of the client. Publishes from any
+  // other task are queued and sent by flushOutbox() in the owner's loop.
+  void claimClient();
+  void flushOutbox();
+  uint32_t getOutboxDrops() const { return outboxDrops; }
+
   // Register a handler for a topic pattern
   void registerHandler(const String& topicPattern, MQTTHandlerFunc callback,
                        const String& name = "", uint8_t priority = 100);
@@ -52,6 +101,17 @@ class MQTTManager {
   // Manual message dispatch (useful for testing)
   void dispatch(const char* topic, byte* payload, unsigned int length);
 
+  // Scratch memory for the message being handled. Valid until the handler
+  // returns; use it instead of String for parsing and building replies.
+  MessageArena& scratch() { return arena; }
+
+  // Dispatch statistics (all handlers, including the audio chunk fast path)
+  uint32_t getDispatchCount() const { return dispatchCount; }
+  uint32_t getDispatchAvgUs() const {
+    return dispatchCount ? dispatchUsTotal / dispatchCount : 0;
+  }
+  uint32_t getDispatchMaxUs() const { return dispatchUsMax; }
+
   // Subscribe/Unsubscribe to topics
   bool subscribe(const String& topic);
   bool unsubscribe(const String& topic);
@@ -62,10 +122,11 @@ class MQTTManager {
   // Publish helpers - handlers can call these
   bool publish(const String& topic, const String& message, bool retain = false);
   bool publish(const String& topic, const char* message, bool retain = false);
+  bool publish(const char* topic, const char* message, bool retain = false);
   bool publish(const String& topic, byte* payload, unsigned int length,
                bool retain = false);
 
-  // Connection status
+  // Connection status (as of the owner's last loop() for other tasks)
   bool isConnected() const;
 
   // Reconnect if disconnected (called internally by loop())
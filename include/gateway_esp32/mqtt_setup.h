@@ -1,9 +1,15 @@
 #ifndef MQTT_SETUP_H
 #define MQTT_SETUP_H
 
+#include <stdint.h>
+
+#include "../shared/sensor_data.h"
+
 // Function declarations for MQTT setup
 void setupMQTT();
 void setupMQTTHandlers();
-void publishRemoteSensorData();
+void publishRemoteSensorData(const SensorData& data, uint8_t nodeId);
+void publishGatewayAnalytics();
+void publishMeshStats();
 
 #endif  // MQTT_SETUP_H
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef NODE_OTA_MANAGER_H
+#define NODE_OTA_MANAGER_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "../shared/node_ota.h"
+#include "mqtt_manager.h"
+#include "sd_manager.h"
+
+// Transfer pacing and retry limits
+#define NODE_OTA_CHUNK_GAP_MS 3     // Between broadcast chunks
+#define NODE_OTA_POLL_WAIT_MS 150   // Time nodes get to answer a poll
+#define NODE_OTA_JOIN_WAIT_MS 1500  // Time nodes get to answer the announce
+#define NODE_OTA_MAX_SILENT 10      // Polls a node may miss before it is dropped
+#define NODE_OTA_ABORT_REPEATS 3    // Broadcasts are not acked
+#define NODE_OTA_STACK_SIZE 6144
+
+// Distributes a sensor node firmware image from the SD card to every node in
+// ESP-NOW range at once. Runs in its own task for the duration of a transfer.
+class NodeOtaManager {
+ public:
+  NodeOtaManager();
+
+  void setSDManager(SDManager* sd);
+  void setMQTTManager(MQTTManager* mqtt);
+
+  // Register "smartalarm/node_ota" (payload: image path on SD)
+  void registerMQTTHandlers(MQTTManager& mqtt);
+
+  // Start a transfer in the background, false if one is already running
+  bool start(const char* filename);
+  bool isActive() const { return active; }
+
+  // Status frames from nodes, called from the ESP-NOW receive callback
+  void onStatus(const uint8_t* mac, const NodeOtaStatus& status);
+
+ private:
+  struct Participant {
+    uint8_t mac[6];
+    uint8_t nodeId;
+    uint8_t state;
+    uint16_t windowStart;
+    uint16_t missingMask;
+    uint8_t silentPolls;
+    bool replied;
+    bool used;
+  };
+
+  SDManager* sdManager;
+  MQTTManager* mqttManager;
+
+  volatile bool active;
+  String imagePath;
+  uint8_t sessionId;
+  uint32_t imageSize;
+  uint16_t chunkCount;
+  uint8_t imageHash[NODE_OTA_HASH_SIZE];
+
+  Participant nodes[NODE_OTA_MAX_NODES];
+  portMUX_TYPE lock;
+
+  static void taskEntry(void* parameter);
+  void run();
+
+  bool hashImage(File& f);
+  void sendControl(NodeOtaFrameType type, uint16_t windowStart = 0);
+  void sendAbort();
+  bool sendChunks(File& f, uint16_t windowStart, uint16_t mask);
+  uint16_t pollWindow(uint16_t windowStart, uint16_t* behind);
+  int countNodes(uint8_t state);
+  void report(const char* fmt, ...);
+};
+
+#endif  // NODE_OTA_MANAGER_H
@@ -0,0 +1,102 @@
+#ifndef NOISE_MONITOR_H
+#define NOISE_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spectrum.h"
+
+#define NOISE_RATE_HZ 16000
+#define NOISE_PERIOD_MS 10000  // One measurement window every 10 s
+#define NOISE_SETTLE_MS 100    // INMP441 wake-up once its clock runs (83 ms)
+#define NOISE_BLOCK SPECTRUM_FFT_SIZE  // Samples per transform
+#define NOISE_WINDOW_FRAMES (16 * NOISE_BLOCK)  // 256 ms measured
+#define NOISE_BANDS 4  // < 250 Hz, 250 Hz-1 kHz, 1-4 kHz, 4-8 kHz
+#define NOISE_SPL_OFFSET_DB 120  // INMP441: -26 dBFS at 94 dB SPL
+
+// Levels of one measurement window, in 1/8 dB relative to a full-scale
+// 24-bit sine (add NOISE_SPL_OFFSET_DB for dB SPL)
+struct NoiseLevels {
+  int32_t rmsDb8;
+  int32_t peakDb8;  // Sample peak
+  int32_t bandDb8[NOISE_BANDS];
+  uint32_t frames;
+};
+
+// RMS, peak and band energies of 24-bit microphone samples, integer only
+class NoiseAnalyzer {
+ public:
+  NoiseAnalyzer();
+
+  void reset();
+  // Mono samples, 24-bit range; a partial block is kept for the next call
+  void add(const int32_t* samples, uint32_t count);
+  // Levels of everything added since reset() (whole blocks only)
+  NoiseLevels levels() const;
+  uint32_t count() const { return frames + fill; }  // Samples added
+
+ private:
+  int16_t twiddle[SPECTRUM_FFT_SIZE];
+  int16_t window[SPECTRUM_FFT_SIZE];
+  int16_t scaled[SPECTRUM_FFT_SIZE];
+  int32_t re[SPECTRUM_BINS];
+  int32_t im[SPECTRUM_BINS];
+  int32_t block[NOISE_BLOCK];
+  uint32_t fill;
+
+  uint64_t energy;  // Sum of squares of the whole blocks
+  uint64_t bandEnergy[NOISE_BANDS];
+  int32_t peak;
+  uint32_t frames;  // Samples in whole blocks
+
+  void analyzeBlock();
+};
+
+// Duty-cycled room noise measurement for the sensor task: the microphone
+// is powered for one window every NOISE_PERIOD_MS, and poll() never blocks
+class NoiseMonitor {
+ public:
+  // Samples buffered so far, up to max, without waiting; 24-bit range
+  typedef size_t (*ReadFn)(void* ctx, int32_t* samples, size_t max);
+  typedef void (*PowerFn)(void* ctx, bool on);
+  typedef uint32_t (*ClockFn)();  // Microseconds, for the CPU duty cycle
+
+  NoiseMonitor(ReadFn read, PowerFn power, ClockFn clockUs, void* ctx);
+
+  // True when a window just finished: levels() has it
+  bool poll(uint32_t nowMs);
+  const NoiseLevels& levels() const { return last; }
+  bool measuring() const { return state != IDLE; }
+
+  uint32_t windows() const { return windowCount; }
+  // Shares of the time since the first poll: CPU inside poll(), and the
+  // microphone powered
+  float cpuDuty(uint32_t nowMs) const;
+  float micDuty(uint32_t nowMs) const;
+
+  // JSON for MQTT (levels in dB SPL), returns bytes written (0 if it did
+  // not fit)
+  size_t toJson(char* buf, size_t len, uint32_t nowMs) const;
+
+ private:
+  enum : uint8_t { IDLE, SETTLING, MEASURING };
+
+  ReadFn readFn;
+  PowerFn powerFn;
+  ClockFn clockFn;
+  void* ctx;
+
+  NoiseAnalyzer analyzer;
+  NoiseLevels last;
+  int32_t chunk[NOISE_BLOCK];
+  uint8_t state;
+  bool started;
+  uint32_t firstMs;
+  uint32_t windowStartMs;  // Power-up of the current or last window
+  uint32_t phaseStartMs;
+  uint32_t windowCount;
+  uint64_t busyUs;
+  uint64_t micOnMs;
+};
+
+#endif  // NOISE_MONITOR_H
@@ -0,0 +1,103 @@
+#ifndef OTA_MANAGER_H
+#define OTA_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <mbedtls/sha256.h>
+
+#include "buffer_pool.h"
+#include "delta_patch.h"
+#include "mqtt_manager.h"
+
+// Download ring between the HTTP reader and the flash writer, borrowed from
+// the buffer pool for the duration of an update
+#define OTA_RING_BLOCKS 4
+#define OTA_RING_BLOCK_SIZE BUFFER_POOL_BLOCK_SIZE
+#define OTA_STACK_SIZE 8192
+
+// A freshly booted image must reach the broker within this time or the
+// bootloader is told to roll back to the previous one
+#define OTA_BOOT_CONFIRM_TIMEOUT_MS 300000
+
+// Streaming firmware update for the gateway itself. The image (or a delta
+// against the running image, see delta_patch.h) is written to the inactive
+// OTA partition while it downloads; nothing is staged on SD or in RAM.
+class OtaManager {
+ public:
+  OtaManager();
+
+  void setMQTTManager(MQTTManager* mqtt);
+  void setBufferPool(BufferPool* pool);
+
+  // Register "smartalarm/gateway/ota" (payload: url or url|sha256-hex)
+  void registerMQTTHandlers(MQTTManager& mqtt);
+
+  // Start a background update. expectedSha256 (32 bytes) is optional for
+  // full images; deltas carry their own source and target hashes.
+  bool start(const char* url, const uint8_t* expectedSha256 = nullptr);
+  bool isActive() const { return active; }
+
+  // Call periodically after boot: confirms a new image once healthy, or
+  // rolls back if it does not become healthy in time
+  void bootHealthTick(bool healthy);
+
+ private:
+  MQTTManager* mqttManager;
+  BufferPool* bufferPool;
+  volatile bool active;
+  bool bootChecked;
+
+  String url;
+  uint8_t expectedSha[32];
+  bool haveExpectedSha;
+
+  // Ring of pool blocks: block indices travel through the two queues
+  uint8_t* ring[OTA_RING_BLOCKS];
+  uint16_t ringLen[OTA_RING_BLOCKS];
+  QueueHandle_t freeBlocks;
+  QueueHandle_t fullBlocks;
+  static uint8_t freeBlocksStorage[OTA_RING_BLOCKS];
+  static uint8_t fullBlocksStorage[OTA_RING_BLOCKS + 1];
+  static StaticQueue_t freeBlocksStruct;
+  static StaticQueue_t fullBlocksStruct;
+
+  // Writer state
+  const esp_partition_t* running;
+  const esp_partition_t* target;
+  esp_ota_handle_t otaHandle;
+  bool isDelta;
+  bool writerStarted;
+  volatile bool writerFailed;
+  DeltaPatcher patcher;
+  mbedtls_sha256_context sha;
+  int32_t contentLength;
+  uint32_t downloaded;
+  uint32_t imageBytes;
+  unsigned long startMs;
+  unsigned long downloadMs;
+  unsigned long applyMs;
+  int lastPct;
+
+  void releaseRing();
+
+  static void downloadTaskEntry(void* parameter);
+  static void writerTaskEntry(void* parameter);
+  void downloadLoop();
+  bool writerLoop();
+
+  bool beginImage(const uint8_t* first, size_t len);
+  bool writeImage(const uint8_t* data, size_t len);
+  bool verifySource(const DeltaHeader& header);
+  bool finishImage();
+  void abortImage();
+
+  static bool readSourceCb(void* ctx, uint32_t offset, uint8_t* dst,
+                           size_t len);
+  static bool writeTargetCb(void* ctx, const uint8_t* data, size_t len);
+
+  void report(const char* fmt, ...);
+};
+
+#endif  // OTA_MANAGER_H
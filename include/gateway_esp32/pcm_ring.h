@@ -0,0 +1,89 @@
+#ifndef PCM_RING_H
+#define PCM_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define PCM_RING_FRAMES 8192  // Stereo 16-bit frames: ~186 ms at 44.1 kHz
+#define PCM_RING_MIN_DEPTH 512  // Room for a DSP block and the limiter tail
+
+// Decode-ahead buffer between the MP3 decoder and the I2S writer
+// (one producer, one consumer, lock-free; frames are left | right << 16)
+class PcmRing {
+ public:
+  PcmRing();
+
+  // ===== Producer (decoder) =====
+  bool writeFrame(int16_t left, int16_t right);  // false when full
+  uint32_t write(const int16_t* stereo, uint32_t frames);
+  uint32_t written() const { return head.load(std::memory_order_relaxed); }
+  // Fill limit from now on (clamped to PCM_RING_MIN_DEPTH..PCM_RING_FRAMES);
+  // frames above a lowered depth still play out
+  void setDepth(uint32_t frames);
+  uint32_t space() const;
+  uint32_t refillMark() const { return depth * 3 / 4; }  // Decode below
+  // Frames decoded and microseconds spent in one decoder pass
+  void noteBurst(uint32_t frames, uint32_t us);
+  // Drop everything written so far; the consumer applies it on its next
+  // read, so frames written after flush() are kept
+  void flush();
+  // End of stream: what is buffered plays out, and running dry is no
+  // longer an underrun
+  void finish();
+
+  // ===== Consumer (I2S writer) =====
+  // Contiguous readable frames starting at *frames (up to the wrap point).
+  // After a flush nothing is readable until the ring reaches its refill
+  // mark or the stream finishes, so a decoder stall right at the start
+  // cannot cut the first frames off from the rest.
+  uint32_t peek(const uint32_t** frames);
+  void consume(uint32_t frames);
+  uint32_t read(int16_t* stereo, uint32_t frames);
+  // Ring found empty; counts an underrun once per starvation episode, and
+  // only once the stream has filled the ring to its refill mark (before
+  // that the output just took the first frames into its DMA buffers) and
+  // until its finish()
+  void noteStarved();
+
+  // ===== Status =====
+  uint32_t fill() const;
+  // Frames handed to the output since boot (wraps); position tracking
+  uint32_t consumed() const { return tail.load(std::memory_order_acquire); }
+  uint32_t capacity() const { return depth; }
+  uint32_t fillMin() const { return lowWater; }  // While streaming
+  uint32_t underruns() const { return underrunCount; }
+  uint32_t bursts() const { return burstCount; }
+  uint32_t burstFramesMax() const { return burstFramesPeak; }
+  uint32_t burstUsMax() const { return burstUsPeak; }
+  uint32_t burstUsAvg() const;
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len, uint32_t rateHz) const;
+
+ private:
+  uint32_t frames[PCM_RING_FRAMES];
+  std::atomic<uint32_t> head;  // Written by the producer only
+  std::atomic<uint32_t> tail;  // Written by the consumer only
+  std::atomic<uint32_t> discardTo;
+  std::atomic<bool> discard;
+  uint32_t depth;  // Producer side only
+  volatile bool primed;   // Streaming: filled since the last flush/finish
+  volatile bool draining; // Finished: the rest plays out unprimed
+  volatile bool starved;  // Inside an underrun episode
+
+  volatile uint32_t lowWater;
+  volatile uint32_t underrunCount;
+  volatile uint32_t burstCount;
+  volatile uint32_t burstFramesPeak;
+  volatile uint32_t burstUsPeak;
+  volatile uint64_t burstUsTotal;
+
+  void applyDiscard();
+};
+
+static_assert((PCM_RING_FRAMES & (PCM_RING_FRAMES - 1)) == 0,
+              "PCM_RING_FRAMES must be a power of two");
+
+#endif  // PCM_RING_H
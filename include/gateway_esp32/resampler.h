@@ -0,0 +1,43 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESAMPLER_OUTPUT_RATE 44100  // The only rate I2S runs at
+#define RESAMPLER_TAPS 32            // Filter taps per polyphase branch
+#define RESAMPLER_MAX_OUT 6          // Output frames per input (8 kHz in)
+
+// Fixed-point polyphase converter from any MPEG audio rate (8-48 kHz) to
+// RESAMPLER_OUTPUT_RATE, with Q15 Kaiser-windowed sinc tables
+class Resampler {
+ public:
+  Resampler();
+
+  // False if there is no table for this rate (the caller then has to run
+  // the output at hz). Clears the filter history when the rate changes.
+  bool setInputRate(uint32_t hz);
+  uint32_t inputRate() const { return inRate; }
+  bool passthrough() const { return !coefs; }
+
+  // Outputs the next push can emit at most
+  uint32_t maxOutputs() const { return coefs ? (up + down - 1) / down : 1; }
+
+  // One stereo input frame in, interleaved stereo frames out; returns how
+  // many frames were written (out holds RESAMPLER_MAX_OUT frames)
+  uint32_t push(int16_t left, int16_t right, int16_t* out);
+
+  void reset();
+
+ private:
+  const int16_t* coefs;  // [up][RESAMPLER_TAPS], oldest input first
+  uint32_t inRate;
+  uint16_t up;
+  uint16_t down;
+  uint16_t phase;
+  uint8_t pos;
+  // History twice over, so every window is contiguous
+  int16_t history[2][2 * RESAMPLER_TAPS];
+};
+
+#endif  // RESAMPLER_H
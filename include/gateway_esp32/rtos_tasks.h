@@ -6,29 +6,20 @@
 #include <freertos/queue.h>
 #include <freertos/task.h>
 
-// Task priorities (higher = more important)
-#define PRIORITY_AUDIO_DECODE 2    // High: decode audio for playback
-#define PRIORITY_AUDIO_ENCODE 2    // High: encode audio for streaming
-#define PRIORITY_WEBSOCKET 2       // High: WebSocket I/O
-#define PRIORITY_MQTT 1            // Normal: MQTT communication
-#define PRIORITY_SENSOR_READ 1     // Normal: sensor reading
-#define PRIORITY_DISPLAY 1         // Normal: display updates
-#define PRIORITY_SENSOR_PUBLISH 1  // Normal: sensor publishing
-
-// Stack sizes (in words, not bytes!) - Reduced to prevent power issues
-#define STACK_SIZE_AUDIO 10240    // Audio processing
-#define STACK_SIZE_NETWORK 10240  // WebSocket/MQTT networking
-#define STACK_SIZE_SENSOR 8192    // Sensors
-#define STACK_SIZE_DISPLAY 8192   // Display
+#include "deadline_monitor.h"
+#include "task_config.h"
 
 // Queue sizes for audio streaming
 #define AUDIO_TX_QUEUE_SIZE 5  // Outgoing audio packets (reduced)
 #define AUDIO_RX_QUEUE_SIZE 5  // Incoming audio packets (reduced)
 #define MQTT_QUEUE_SIZE 3      // MQTT messages (reduced)
+#define RTOS_QUEUE_ITEM_SIZE sizeof(void*)  // Queues carry message pointers
 
 // Task handles (for suspend/resume control)
+extern TaskHandle_t audioOutputTaskHandle;
 extern TaskHandle_t audioDecodeTaskHandle;
 extern TaskHandle_t audioEncodeTaskHandle;
+extern TaskHandle_t audioJobTaskHandle;
 extern TaskHandle_t websocketTaskHandle;
 extern TaskHandle_t mqttTaskHandle;
 extern TaskHandle_t sensorTaskHandle;
@@ -39,9 +30,15 @@ extern QueueHandle_t audioTxQueue;  // Local mic → WebSocket → Server
 extern QueueHandle_t audioRxQueue;  // Server → WebSocket → Speaker
 extern QueueHandle_t mqttQueue;     // MQTT messages
 
+// Per-iteration timing of the periodic tasks; violations are published on
+// MQTT_TOPIC_DEADLINES by the MQTT task
+extern DeadlineMonitor deadlineMonitor;
+
 // Task functions
-void audioDecodeTask(void* parameter);  // Decode incoming audio & play
+void audioOutputTask(void* parameter);  // Feed I2S from the PCM ring
+void audioDecodeTask(void* parameter);  // Decode audio into the PCM ring
 void audioEncodeTask(void* parameter);  // Encode mic input for streaming
+void audioJobTask(void* parameter);     // Downloads and index scans
 void mqttTask(void* parameter);         // Handle MQTT communication
 void sensorTask(void* parameter);       // Read sensors periodically
 void displayTask(void* parameter);      // Update display periodically
@@ -0,0 +1,130 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Local automations evaluated on the gateway instead of on the server.
+// Each rule is one line of text:
+//
+//   <name>: <condition> -> <action>
+//
+//   early:   time >= 06:20 && outside_temp < 5 -> play /alarm.mp3
+//   sunrise: light > 200 && time >= 06:00      -> fadein /birds.mp3 30
+//
+// An action fires when its condition turns from false to true.
+
+#define RULE_MAX_RULES 16
+#define RULE_CODE_SIZE 512   // Bytecode shared by all rules
+#define RULE_STACK_DEPTH 8   // Evaluation stack, checked at compile time
+#define RULE_NAME_LEN 16
+#define RULE_ARG_LEN 32
+
+enum RuleInput : uint8_t {
+  RULE_IN_OUTSIDE_TEMP,
+  RULE_IN_OUTSIDE_HUMIDITY,
+  RULE_IN_PRESSURE,
+  RULE_IN_UV,
+  RULE_IN_DEW_POINT,
+  RULE_IN_LIGHT,
+  RULE_IN_TIME,     // Minutes since local midnight, HH:MM literals compare
+  RULE_IN_WEEKDAY,  // 0 = Sunday
+  RULE_IN_PLAYING,  // 1 while audio is playing
+  RULE_IN_NOISE,    // Room noise, dB SPL, every NOISE_PERIOD_MS
+  RULE_IN_COUNT
+};
+
+enum RuleOp : uint8_t {
+  RULE_OP_CONST = 1,  // + 4-byte float
+  RULE_OP_LOAD,       // + 1-byte RuleInput
+  RULE_OP_ADD,
+  RULE_OP_SUB,
+  RULE_OP_MUL,
+  RULE_OP_DIV,
+  RULE_OP_NEG,
+  RULE_OP_LT,
+  RULE_OP_LE,
+  RULE_OP_GT,
+  RULE_OP_GE,
+  RULE_OP_EQ,
+  RULE_OP_NE,
+  RULE_OP_AND,
+  RULE_OP_OR,
+  RULE_OP_NOT
+};
+
+enum RuleActionType : uint8_t {
+  RULE_ACTION_PLAY,     // play <file>
+  RULE_ACTION_FADEIN,   // fadein <file> <seconds>
+  RULE_ACTION_STOP,     // stop
+  RULE_ACTION_VOLUME,   // volume <0.0-1.0>
+  RULE_ACTION_PUBLISH   // publish <text>, sent to the rules event topic
+};
+
+struct Rule {
+  char name[RULE_NAME_LEN];
+  uint16_t codeOffset;
+  uint16_t codeLength;
+  uint16_t inputMask;  // Bit per RuleInput read by the condition
+  bool lastResult;
+  RuleActionType action;
+  float actionValue;
+  char actionArg[RULE_ARG_LEN];
+  uint32_t fireCount;
+};
+
+class RuleEngine {
+ public:
+  typedef void (*ActionCallback)(const Rule& rule, void* context);
+
+  RuleEngine();
+
+  void clear();
+
+  // Compile one rule line, false with a message in err on failure
+  bool addRule(const char* line, char* err, size_t errLen);
+
+  // Replace the rule set with newline-separated rules. Blank lines and lines
+  // starting with '#' are skipped. On error the engine is left empty.
+  bool load(const char* text, char* err, size_t errLen);
+
+  void setActionCallback(ActionCallback callback, void* context);
+
+  // Update an input; dependent rules are marked for evaluation if it changed
+  void setInput(RuleInput input, float value);
+  float getInput(RuleInput input) const { return inputs[input]; }
+
+  // Evaluate the marked rules (or all of them), firing actions on rising
+  // edges. Returns the number of rules evaluated.
+  int evaluate();
+  int evaluateAll();
+
+  // Evaluate every rule without firing, so rules that are already true wait
+  // for their next rising edge (used after loading a new rule set)
+  void prime();
+
+  uint8_t ruleCount() const { return count; }
+  const Rule& rule(uint8_t index) const { return rules[index]; }
+  uint16_t codeSize() const { return codeUsed; }
+
+  static int inputFromName(const char* name, size_t len);
+  static const char* inputName(RuleInput input);
+
+ private:
+  Rule rules[RULE_MAX_RULES];
+  uint8_t count;
+  uint8_t code[RULE_CODE_SIZE];
+  uint16_t codeUsed;
+
+  float inputs[RULE_IN_COUNT];
+  uint16_t dependents[RULE_IN_COUNT];  // Bit per rule reading the input
+  uint16_t dirty;                      // Bit per rule to evaluate
+
+  ActionCallback callback;
+  void* callbackContext;
+
+  bool run(const Rule& r) const;
+  void evaluateRule(uint8_t index);
+};
+
+#endif  // RULE_ENGINE_H
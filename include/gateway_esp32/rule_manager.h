@@ -0,0 +1,90 @@
+#ifndef RULE_MANAGER_H
+#define RULE_MANAGER_H
+
+#include <Arduino.h>
+
+#include "audio_manager.h"
+#include "mqtt_manager.h"
+#include "rule_engine.h"
+#include "sd_manager.h"
+
+#define RULES_FILE "/rules.txt"
+#define RULE_QUEUE_LENGTH 16
+#define RULE_TICK_MS 1000      // Clock and playback state refresh
+#define RULE_FADE_STEP_MS 250  // Volume ramp granularity for fadein
+#define RULE_STACK_SIZE 6144  // Actions start playback and publish
+
+// Runs the local automations: sensor and timer inputs are queued from any
+// task, and a dedicated task evaluates the affected rules and carries out
+// their actions without a round trip through the broker.
+class RuleManager {
+ public:
+  RuleManager();
+
+  void setSDManager(SDManager* sd);
+  void setMQTTManager(MQTTManager* mqtt);
+  void setAudioManager(AudioManager* audio);
+
+  // Load RULES_FILE, start the clock (NTP) and the rule task
+  bool begin();
+
+  // Register "smartalarm/rules" (payload: rule text, or "status")
+  void registerMQTTHandlers(MQTTManager& mqtt);
+
+  // Queue an input change; never blocks, drops the event when the queue is full
+  void post(RuleInput input, float value);
+
+ private:
+  struct InputEvent {
+    RuleInput input;
+    float value;
+    uint32_t postedUs;
+  };
+
+  SDManager* sdManager;
+  MQTTManager* mqttManager;
+  AudioManager* audioManager;
+
+  RuleEngine engine;
+  RuleEngine staging;  // Compiled off to the side, swapped in under the mutex
+  SemaphoreHandle_t engineMutex;
+  QueueHandle_t queue;
+
+  // Task and queue storage, linked in rather than taken from the heap
+  static StackType_t taskStack[RULE_STACK_SIZE];
+  static StaticTask_t taskTcb;
+  static uint8_t queueStorage[RULE_QUEUE_LENGTH * sizeof(InputEvent)];
+  static StaticQueue_t queueStruct;
+  static StaticSemaphore_t mutexStruct;
+
+  // Fade-in in progress
+  bool fading;
+  float fadeTarget;
+  uint32_t fadeStartMs;
+  uint32_t fadeDurationMs;
+
+  // Measurements
+  uint32_t eventCount;
+  uint32_t evaluatedCount;
+  uint32_t firedCount;
+  uint32_t droppedCount;
+  uint32_t evalUsSum;
+  uint32_t evalUsMax;
+  uint32_t latencyUsLast;
+  uint32_t latencyUsMax;
+  uint32_t currentEventUs;
+
+  static void taskEntry(void* parameter);
+  void run();
+  void apply(const InputEvent& event);
+  void tick();
+  void tickFade();
+
+  static void onAction(const Rule& rule, void* context);
+  void execute(const Rule& rule);
+
+  bool loadRules(const char* text, bool save);
+  void publishStatus();
+};
+
+#endif  // RULE_MANAGER_H
@@ -6,6 +6,8 @@
 #include <SD.h>
 #include <SPI.h>
 
+#include "buffer_pool.h"
+
 // SD Card Pins
 #define SD_CS_PIN 5
 #define SD_MOSI_PIN 23
@@ -25,17 +27,31 @@ class SDManager {
   bool writeChunk(const uint8_t* data, size_t len);
   void closeFile();
 
+  // Small files written in one go (index sidecars, resume point)
+  bool writeFile(const char* filename, const uint8_t* data, size_t len);
+
+  // File Reading (caller closes the returned File)
+  File openForRead(const char* filename);
+  // Read/write at any offset, created if missing (caller closes it)
+  File openForUpdate(const char* filename);
+
   // File Management
-  String listAudioFiles();  // Returns comma-separated list of MP3/WAV files
+  // Comma-separated list of MP3/WAV files (not the transcoded sidecars)
+  String listAudioFiles();
   bool exists(const char* filename);
   void remove(const char* filename);
+  bool rename(const char* from, const char* to);  // Replaces `to`
   size_t getFileSize(const char* filename);
 
   // Info
   void printCardInfo();
 
+  // Transfer buffer pool, used to count writes that need a bounce copy
+  void setBufferPool(BufferPool* pool);
+
  private:
   bool _ready;
+  BufferPool* _pool;
   File _file;               // Current active file for writing
   size_t _bytesSinceFlush;  // For efficient flushing
 };
@@ -0,0 +1,122 @@
+#ifndef SENSOR_ANALYTICS_H
+#define SENSOR_ANALYTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../shared/sensor_data.h"
+
+#define ANALYTICS_EWMA_ALPHA 0.1f   // ~10-sample smoothing
+#define ANALYTICS_WARMUP 20         // Samples before anomalies are flagged
+#define ANALYTICS_Z_THRESHOLD 3.5f  // Robust z-score (Iglewicz & Hoaglin)
+#define ANALYTICS_ROBUST_STEP 0.02f // Median/MAD tracking rate
+
+// Remote nodes with their own baselines; a node beyond these takes over the
+// slot of the one heard least recently
+#define ANALYTICS_MAX_NODES 3
+#define ANALYTICS_LEGACY_NODE 0xFF  // Direct frames, no mesh origin id
+
+// Pressure history: 10-minute averages over the last 3 hours
+#define PRESSURE_BUCKET_MS 600000UL
+#define PRESSURE_SLOTS 19  // 18 intervals = 3 h between oldest and newest
+
+// Running statistics for one signal, O(1) time and memory per sample
+struct SignalStats {
+  uint32_t count;
+  float last;
+  float ewma;
+  float mean;    // Welford
+  float m2;      // Welford sum of squared deviations
+  float median;  // Streaming median estimate
+  float mad;     // Streaming median absolute deviation
+  float z;       // Robust z-score of the last sample
+  bool anomaly;
+
+  void update(float x);
+  float variance() const { return count > 1 ? m2 / (count - 1) : 0.0f; }
+  float stddev() const;
+};
+
+enum PressureTendency : uint8_t {
+  TENDENCY_UNKNOWN,  // Less than 3 h of history
+  TENDENCY_FALLING_FAST,
+  TENDENCY_FALLING,
+  TENDENCY_STEADY,
+  TENDENCY_RISING,
+  TENDENCY_RISING_FAST
+};
+
+// Derived metrics computed in the gateway's sensor ingest path so consumers
+// no longer recompute them from broker history.
+class SensorAnalytics {
+ public:
+  enum Signal : uint8_t {
+    SIG_TEMPERATURE,
+    SIG_HUMIDITY,
+    SIG_PRESSURE,
+    SIG_UV,
+    SIG_LIGHT,
+    SIG_NOISE,  // Gateway microphone, dB SPL
+    SIG_COUNT
+  };
+
+  SensorAnalytics();
+
+  // Remote node sample: temperature, humidity, pressure, UV and derived
+  void updateRemote(const SensorData& data, uint32_t nowMs);
+
+  // Single signal (e.g. the gateway's own light sensor or microphone)
+  void update(Signal signal, float value);
+
+  const SignalStats& stats(Signal signal) const { return signals[signal]; }
+  float getDewPoint() const { return dewPoint; }
+  float getHeatIndex() const { return heatIndex; }
+  PressureTendency getTendency(float* deltaHpa = nullptr) const;
+  bool anyAnomaly() const;
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len) const;
+
+  static float computeDewPoint(float tempC, float humidity);
+  static float computeHeatIndex(float tempC, float humidity);
+  static const char* tendencyName(PressureTendency t);
+
+ private:
+  SignalStats signals[SIG_COUNT];
+  float dewPoint;
+  float heatIndex;
+
+  float pressureSlots[PRESSURE_SLOTS];
+  uint8_t slotHead;
+  uint8_t slotsFilled;
+  uint32_t bucketStartMs;
+  float bucketSum;
+  uint16_t bucketCount;
+
+  void updatePressureHistory(float hpa, uint32_t nowMs);
+};
+
+// Analytics of the remote nodes keyed by node id, so one node's readings
+// never feed another's baselines, dew point or pressure tendency.
+class NodeAnalyticsTable {
+ public:
+  NodeAnalyticsTable();
+
+  // The node's analytics; a node without a slot starts from scratch in a
+  // free one, or in the one heard least recently
+  SensorAnalytics& forNode(uint8_t nodeId, uint32_t nowMs);
+
+  // nullptr if the node has no slot
+  const SensorAnalytics* find(uint8_t nodeId) const;
+
+ private:
+  struct Slot {
+    bool used;
+    uint8_t nodeId;
+    uint32_t lastMs;
+    SensorAnalytics analytics;
+  };
+  Slot slots[ANALYTICS_MAX_NODES];
+};
+
+#endif  // SENSOR_ANALYTICS_H
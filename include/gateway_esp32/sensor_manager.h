@@ -5,6 +5,15 @@
 #include <BH1750.h>
 #include <TCA9548A.h>
 
+// INMP441 microphone for ambient noise (L/R tied low: left channel). Port 0
+// drives the speaker.
+#define MIC_I2S_PORT I2S_NUM_1
+#define MIC_SCK_PIN 32
+#define MIC_WS_PIN 33
+#define MIC_SD_PIN 34  // Input-only pin
+#define MIC_DMA_BUFFERS 8
+#define MIC_DMA_FRAMES 256  // 8 x 256 x 4 bytes of DMA, 128 ms at 16 kHz
+
 class SensorManager {
  public:
   // Constructor
@@ -29,6 +38,15 @@ class SensorManager {
   // MQTT Publishing
   void publishToMQTT(class MQTTManager& mqtt, const char* lightTopic);
 
+  // Ambient noise: one short window every NOISE_PERIOD_MS (noise_monitor.h),
+  // the microphone's clock stopped in between. pollNoise() is called every
+  // sensor task period and returns true when a window just finished.
+  bool beginNoise();
+  bool pollNoise(uint32_t nowMs);
+  bool isNoiseValid() const;
+  float getNoiseLevel() const;  // dB SPL of the last window
+  void publishNoise(class MQTTManager& mqtt, const char* noiseTopic);
+
  private:
   BH1750 lightSensor;
   TCA9548A* tca;
@@ -41,6 +59,8 @@ class SensorManager {
   // State tracking
   unsigned long lastReadTime;
   bool lightValid;
+  bool micReady;
+  bool noiseValid;
 };
 
 #endif  // SENSOR_MANAGER_H
@@ -0,0 +1,63 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define SPECTRUM_FFT_SIZE 256  // Real samples per transform
+#define SPECTRUM_BINS (SPECTRUM_FFT_SIZE / 2 + 1)
+#define SPECTRUM_BARS 8
+#define SPECTRUM_RANGE_DB 60  // Level 0 is this far below full scale
+#define SPECTRUM_FALL 24      // Level a bar drops per update at most
+
+// Fixed-point real FFT of SPECTRUM_FFT_SIZE Q15 samples: a complex radix-2
+// FFT of half the size over even/odd pairs, then the split into the real
+// spectrum. Every stage halves, so bins 0..N/2 come out as X[k] / N in
+// re/im (int32, |X[k] / N| <= 32768). twiddle holds sin(2 pi i / N) in Q15
+// for i in 0..N-1 (spectrumTables() fills it). Integer only: the same
+// result on the host and the ESP32.
+void spectrumFft(const int16_t* in, const int16_t* twiddle, int32_t* re,
+                 int32_t* im);
+void spectrumTables(int16_t* twiddle, int16_t* window);  // Hann window
+// 10 log10(power) in 1/8 dB from an integer log2 with a linear fraction,
+// good to ~0.5 dB; INT32_MIN / 2 for 0
+int32_t spectrumPowerDb8(uint64_t power);
+
+// Spectrum bars for the display: the I2S writer captures one block while
+// armed, and the caller of update() does the transform at its own rate
+class Spectrum {
+ public:
+  Spectrum();
+
+  // ===== Capture (I2S writer) =====
+  bool capturing() const {
+    return state.load(std::memory_order_acquire) == CAPTURING;
+  }
+  // Packed frames as in PcmRing (left | right << 16)
+  void capture(const uint32_t* frames, uint32_t count);
+
+  // ===== Display =====
+  // Transform the finished capture into bar levels (0..255) and arm the
+  // next one. False when no capture has finished since the last call;
+  // levels then only fall.
+  bool update(uint8_t* levels);
+  // Bar i covers bins [bandStart(i), bandStart(i + 1))
+  static uint32_t bandStart(int bar);
+
+ private:
+  enum : uint8_t { IDLE, CAPTURING, READY };
+
+  std::atomic<uint8_t> state;
+  uint32_t fill;
+  int16_t samples[SPECTRUM_FFT_SIZE];
+
+  int16_t twiddle[SPECTRUM_FFT_SIZE];
+  int16_t window[SPECTRUM_FFT_SIZE];
+  int32_t re[SPECTRUM_BINS];
+  int32_t im[SPECTRUM_BINS];
+  uint8_t bars[SPECTRUM_BARS];
+};
+
+#endif  // SPECTRUM_H
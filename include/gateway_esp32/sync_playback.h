@@ -0,0 +1,178 @@
+#ifndef SYNC_PLAYBACK_H
+#define SYNC_PLAYBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// Shared time base
+// ============================================================================
+#define SYNC_MAGIC 0xA9  // Distinct from MESH_MAGIC and NODE_OTA_MAGIC
+#define SYNC_VERSION 1
+#define SYNC_BEACON_INTERVAL_MS 1000
+#define SYNC_FILTER_BEACONS 4  // The least delayed of each group steers
+#define SYNC_STEP_US 2000      // Filtered errors beyond this are stepped
+#define SYNC_LOCK_UPDATES 2    // Updates after a step before a follower locks
+#define SYNC_SPIKE_US 250      // Locked: errors beyond this are suspect...
+#define SYNC_SPIKE_GROUPS 3    // ...until this many groups in a row agree
+#define SYNC_MASTER_TIMEOUT_MS 5000  // No beacon this long: take over
+#define SYNC_AIR_US 600        // esp_now_send() to the receive callback
+#define SYNC_UTC_SLEW_PPM 5    // Master follows SNTP no faster than this
+#define SYNC_UTC_STEP_US 1000000  // ...unless it is this far off
+
+#pragma pack(push, 1)
+typedef struct {
+  uint8_t magic;  // SYNC_MAGIC
+  uint8_t version;
+  uint16_t seq;
+  int64_t sharedUs;  // Master's shared time when sent
+} SyncBeacon;  // Total: 12 bytes
+#pragma pack(pop)
+
+inline bool syncIsBeacon(const uint8_t* data, int len) {
+  return len == (int)sizeof(SyncBeacon) && data[0] == SYNC_MAGIC &&
+         data[1] == SYNC_VERSION;
+}
+
+// Time base shared by the gateways of an installation, in microseconds of
+// UTC: the master broadcasts it over ESP-NOW and the others track it with a
+// phase and frequency loop on the least delayed beacons
+class SyncClock {
+ public:
+  SyncClock();
+
+  void begin(const uint8_t* ownMac);
+
+  // Periodic, with the local clock and SNTP time (0 when not set). True
+  // when this gateway is master and *out is a beacon to broadcast now.
+  bool tick(int64_t localUs, int64_t utcUs, SyncBeacon* out);
+  // A beacon from another gateway, stamped on arrival
+  void onBeacon(const uint8_t* mac, const SyncBeacon& beacon, int64_t localUs);
+
+  int64_t toShared(int64_t localUs) const;
+
+  bool isMaster() const { return role == ROLE_MASTER; }
+  // A master with a time, or a locked follower: scheduled starts line up
+  bool synced() const;
+  // Rate of the shared clock against the local clock, SNTP slew included
+  int32_t skewPpb() const { return skew + slew; }
+  int32_t lastErrorUs() const { return lastError; }
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len) const;
+
+ private:
+  enum : uint8_t { ROLE_FREE, ROLE_FOLLOWER, ROLE_MASTER };
+
+  uint8_t mac[6];
+  uint8_t masterMac[6];
+  uint8_t role;
+  bool started;
+  bool hasTime;  // The mapping has been set (from SNTP or a master)
+  uint8_t lockCount;
+  uint8_t spikeCount;  // Groups in a row off by more than usual...
+  int32_t spikeError;  // ...and by about this much
+
+  // shared = local + offset + (local - anchor) * skew / 1e9
+  int64_t anchorUs;
+  int64_t offsetUs;
+  int32_t skew;  // ppb
+  int32_t slew;  // ppb, toward SNTP time over the last interval
+
+  int64_t lastBeaconUs;  // Local arrival of the master's last beacon
+  int64_t lastTickUs;
+  int64_t lastUpdateUs;  // End of the group of the last update
+  uint16_t seq;
+  uint8_t filterCount;
+  int32_t filterBest;
+  int64_t filterBestUs;
+  int32_t lastError;
+  uint32_t beaconCount;
+  uint32_t stepCount;
+
+  void reanchor(int64_t localUs);
+  void discipline(int64_t errorUs, int64_t localUs, int64_t endUs);
+  void follow(const uint8_t* master);
+};
+
+// ============================================================================
+// Scheduled playout
+// ============================================================================
+#define SYNC_TRIM_MAX_PPM 100      // One frame in 10000 repeated or dropped
+#define SYNC_TRIM_HORIZON_MS 2000  // Position errors are trimmed over this
+#define SYNC_RESYNC_MS 10          // Further off (an underrun): jump
+#define SYNC_ALIGN_BUFFERS 2       // Align this close to the start
+#define SYNC_DRY_GUARD_FRAMES 8    // DMA (nearly) empty this close to a
+                                   // buffer boundary: wait a pass
+
+// What the I2S writer does next
+enum SyncAction : uint8_t {
+  SYNC_COPY,     // Copy up to n frames from the PCM ring
+  SYNC_SILENCE,  // Write n frames of silence
+  SYNC_SKIP,     // Drop n frames from the PCM ring
+  SYNC_REPEAT,   // Write the next ring frame without consuming it
+  SYNC_DROP,     // Consume the next ring frame without writing it
+  SYNC_WAIT,     // Write nothing until the next pass
+};
+
+// Keeps the track's position at the DAC on the shared time base: a silent
+// lead-in counted to the sample, then single frames repeated or dropped
+// (at most SYNC_TRIM_MAX_PPM)
+class SyncPlayout {
+ public:
+  SyncPlayout();
+
+  // startUs on the shared time base; the DMA holds queueFrames in buffers
+  // of bufferFrames
+  void arm(int64_t startUs, uint32_t rateHz, uint32_t bufferFrames,
+           uint32_t queueFrames);
+  void disarm();
+  bool active() const { return state != IDLE; }
+  bool prerolling() const { return state == PREROLL; }
+
+  // Pre-roll, with the DMA full of silence: time to align
+  bool alignDue(int64_t sharedUs) const;
+  // Right after a blocking write of one buffer of silence returned. False:
+  // write another; true: aligned, next() has the plan.
+  bool align(int64_t sharedUs, int64_t localUs);
+
+  // Playing: once per writer pass, before next()
+  void update(int64_t sharedUs, int64_t localUs, int32_t skewPpb);
+  SyncAction next(uint32_t* frames) const;
+  void done(SyncAction action, uint32_t frames);
+
+  int32_t errorFrames() const { return error; }  // + ahead, - behind
+  int32_t trimPpm() const { return trim; }
+
+  // JSON for MQTT, returns bytes written (0 if it did not fit)
+  size_t toJson(char* buf, size_t len) const;
+
+ private:
+  enum : uint8_t { IDLE, PREROLL, PLAYING };
+
+  uint8_t state;
+  int64_t startUs;
+  uint32_t rate;
+  uint32_t bufferFrames;
+  uint32_t queueFrames;
+
+  int64_t refUs;       // Local time the DAC played frame 0 of written
+  uint64_t written;    // Frames handed to the DMA since refUs's frame
+  int64_t track;       // Track frames consumed from the ring
+  uint32_t silence;    // Planned silence
+  uint32_t skip;       // Planned ring frames to drop
+  int32_t error;
+  int32_t trim;        // ppm, + repeat (ahead), - drop (behind)
+  uint32_t untilTrim;  // Frames copied before the next trim frame
+  bool waiting;        // Unsure which buffer the next write lands in
+
+  uint32_t lateFrames;
+  uint32_t dryFrames;  // Played by the DAC with the DMA empty
+  uint32_t repeats;
+  uint32_t drops;
+  uint32_t resyncs;
+
+  int64_t framesAt(int64_t us) const;
+};
+
+#endif  // SYNC_PLAYBACK_H
@@ -0,0 +1,45 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+// Priorities, stacks and timing of the gateway's FreeRTOS tasks. Kept apart
+// from rtos_tasks.h so host simulations schedule with the same numbers.
+
+// Task priorities (higher = more important)
+#define PRIORITY_AUDIO_OUTPUT 3    // Critical: keeps the I2S DMA fed
+#define PRIORITY_AUDIO_DECODE 2    // High: decode audio for playback
+#define PRIORITY_AUDIO_ENCODE 2    // High: encode audio for streaming
+#define PRIORITY_AUDIO_JOBS 1      // Normal: downloads, index scans
+#define PRIORITY_WEBSOCKET 2       // High: WebSocket I/O
+#define PRIORITY_MQTT 1            // Normal: MQTT communication
+#define PRIORITY_SENSOR_READ 1     // Normal: sensor reading
+#define PRIORITY_DISPLAY 1         // Normal: display updates
+#define PRIORITY_SENSOR_PUBLISH 1  // Normal: sensor publishing
+
+// Stack sizes in bytes (ESP-IDF StackType_t is one byte). Stacks are static
+// arrays, see memory_map.h for the budget they are checked against.
+#define STACK_SIZE_AUDIO 10240        // Audio processing
+#define STACK_SIZE_AUDIO_OUTPUT 3072  // PCM ring -> I2S writer
+#define STACK_SIZE_AUDIO_ENCODE 4096  // Heap, once the mic pipeline exists
+#define STACK_SIZE_AUDIO_JOBS 6144    // HTTP downloads and SD scans
+#define STACK_SIZE_NETWORK 8192       // WebSocket/MQTT networking
+#define STACK_SIZE_SENSOR 8192        // Sensors
+#define STACK_SIZE_DISPLAY 8192       // Display
+
+// Task periods and execution budgets checked by the deadline monitor
+#define PERIOD_AUDIO_OUTPUT_MS 5     // Well inside the ~23 ms of I2S DMA
+#define BUDGET_AUDIO_OUTPUT_US 2000
+#define PERIOD_AUDIO_DECODE_MS 10    // Refills the PCM ring in bursts
+#define BUDGET_AUDIO_DECODE_US 8000  // One burst: two to three MP3 frames
+#define PERIOD_MQTT_MS 100           // 10Hz network loop
+#define BUDGET_MQTT_US 50000         // Handlers may block on SD/TCP briefly
+#define PERIOD_SENSOR_MS 50
+#define BUDGET_SENSOR_US 50000
+#define PERIOD_DISPLAY_MS 200  // 5 FPS
+#define BUDGET_DISPLAY_US 100000
+#define PERIOD_AUDIO_JOBS_MS 100  // Not monitored: a job takes seconds
+
+// Sensor task cadence within its period
+#define SENSOR_READ_INTERVAL_MS 2000
+#define SENSOR_PUBLISH_INTERVAL_MS 10000
+
+#endif  // TASK_CONFIG_H
@@ -0,0 +1,109 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRANSCODE_SUFFIX ".wav"        // Sidecar next to the MP3: x.mp3.wav
+#define TRANSCODE_PART_SUFFIX ".part"  // x.mp3.wav.part while it is written
+#define TRANSCODE_BLOCK_BYTES 2048     // ADPCM block; unit of every SD write
+#define TRANSCODE_PCM_MAX_MS 8000      // Shorter tracks are kept as PCM
+#define TRANSCODE_HEADER_MAX 96        // Bytes to read to parse a sidecar
+
+// WAVE format tags
+enum TranscodeFormat : uint16_t {
+  TRANSCODE_PCM = 0x0001,
+  TRANSCODE_IMA_ADPCM = 0x0011,
+};
+
+// Layout of a transcoded sidecar: a plain WAV file (16-bit PCM or 4-bit
+// IMA ADPCM) with a fact chunk for the frame count and an "srcb" chunk
+// holding the size of the MP3 it was decoded from, so a replaced MP3
+// makes it stale.
+struct TranscodeInfo {
+  uint16_t format;  // TranscodeFormat
+  uint16_t channels;
+  uint32_t rate;
+  uint32_t blockBytes;       // Bytes per block (ADPCM block, or PCM run)
+  uint32_t samplesPerBlock;  // Frames per block
+  uint32_t frames;           // Frames of audio (the fact chunk)
+  uint32_t sourceBytes;      // Size of the MP3
+  uint32_t dataStart;        // File offset of the first block
+  uint32_t dataBytes;
+};
+
+// Block geometry for format/channels/rate; frames and dataBytes start at 0
+void transcodeSetup(TranscodeInfo& info, uint16_t format, uint16_t channels,
+                    uint32_t rate, uint32_t sourceBytes);
+// RIFF header for info into out (TRANSCODE_HEADER_MAX bytes); sets
+// info.dataStart and returns the header length
+size_t transcodeHeader(TranscodeInfo& info, uint8_t* out);
+// Header of a sidecar (the first len bytes of it); false unless it is a
+// format this player decodes
+bool transcodeParse(const uint8_t* buf, size_t len, TranscodeInfo& out);
+const char* transcodeFormatName(uint16_t format);
+
+// IMA ADPCM predictor state of one channel
+struct ImaChannel {
+  int32_t predictor;
+  int32_t index;
+};
+
+// Encodes decoded frames into blocks of a sidecar, one frame at a time;
+// the only buffer is the block being filled
+class TranscodeEncoder {
+ public:
+  TranscodeEncoder();
+
+  // block: info.blockBytes the caller writes out once ready() is non-zero.
+  // framesDone continues a file at a block boundary; pass its last block
+  // as previous so the ADPCM step sizes carry on as if never interrupted.
+  void begin(const TranscodeInfo& info, uint8_t* block,
+             uint32_t framesDone = 0, const uint8_t* previous = nullptr);
+
+  // One frame; false while a full block waits for next()
+  bool add(int16_t left, int16_t right);
+  // Bytes of the finished block, 0 while it fills
+  size_t ready() const {
+    return pos == info.samplesPerBlock ? info.blockBytes : 0;
+  }
+  // The block was written: start the next
+  void next();
+  // Close the partial last block: bytes to write, 0 if there is none.
+  // written() then has the final frame count and data size.
+  size_t finish();
+
+  // info with frames and dataBytes of the blocks finished so far
+  const TranscodeInfo& written() const { return infoOut; }
+
+ private:
+  TranscodeInfo info;
+  TranscodeInfo infoOut;  // frames / dataBytes written so far
+  uint8_t* block;
+  uint32_t pos;  // Frames in block
+  ImaChannel state[2];
+};
+
+// Decodes the blocks of a sidecar frame by frame, stereo out. Needs no
+// buffer besides the block itself.
+class TranscodeDecoder {
+ public:
+  TranscodeDecoder();
+
+  void begin(const TranscodeInfo& info);
+  // Next block (bytes may be short for the last one)
+  void block(const uint8_t* data, size_t bytes);
+  // Next frame of the block; false once it is used up
+  bool next(int16_t* left, int16_t* right);
+
+  const ImaChannel& channel(int c) const { return state[c]; }
+
+ private:
+  TranscodeInfo info;
+  const uint8_t* data;
+  uint32_t frames;  // Frames in the current block
+  uint32_t pos;
+  ImaChannel state[2];
+};
+
+#endif  // TRANSCODE_H
@@ -0,0 +1,86 @@
+#ifndef VOICE_ACTIVITY_H
+#define VOICE_ACTIVITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spectrum.h"
+
+#define VAD_RATE_HZ 16000
+#define VAD_FRAME_SAMPLES 320     // 20 ms: one encoder frame
+#define VAD_BANDS 6               // Octaves from 62 Hz to 8 kHz
+#define VAD_SNR_DB 3              // Mean band SNR of a voice frame whose...
+#define VAD_FLATNESS_DB 2         // ...flatness differs this much from noise
+#define VAD_STEADY_SNR_DB 6       // ...or shaped like the noise
+#define VAD_LOUD_DB 15            // Active whatever the spectrum looks like
+#define VAD_FLOOR_DBFS -70        // Never active below this level
+#define VAD_HANGOVER_FRAMES 10    // Kept after a talk spurt (200 ms)
+#define VAD_BLIP_HANGOVER_FRAMES 2  // Kept after a run shorter than below
+#define VAD_MIN_RUN_FRAMES 3      // Active run that counts as a talk spurt
+#define VAD_MAX_RUN_FRAMES 250    // Active this long without a break: noise
+#define VAD_SID_INTERVAL_FRAMES 25  // Comfort noise refresh while silent
+#define VAD_SID_DRIFT_DB 3        // Or as soon as the noise moves this far
+#define VAD_SID_BYTES (1 + VAD_BANDS)
+
+// What the encode task does with a frame
+enum VadDecision : uint8_t {
+  VAD_SPEECH,    // Encode and send
+  VAD_HANGOVER,  // Encode and send: the quiet tail of a talk spurt
+  VAD_SID,       // Send the comfort noise descriptor instead
+  VAD_SILENT,    // Send nothing
+};
+
+// Voice activity detector gating microphone frames before they are encoded:
+// band energies and spectral flatness against a tracked noise floor, with a
+// hangover after speech and comfort noise descriptors while silent
+class VoiceActivity {
+ public:
+  VoiceActivity();
+
+  // Forget the noise estimate; the next frame starts a new one
+  void reset();
+  // One frame of VAD_FRAME_SAMPLES mono samples at VAD_RATE_HZ
+  VadDecision process(const int16_t* pcm);
+
+  // Comfort noise descriptor, laid out as RFC 3389: noise level in -dBov
+  // (0..127), then the noise level of each band in -dB below the
+  // strongest. Returns VAD_SID_BYTES.
+  size_t descriptor(uint8_t* out) const;
+
+  // Last frame's features, 1/8 dB
+  int32_t levelDb8() const { return frameDb8; }  // dBFS
+  int32_t noiseDb8() const { return noiseFloorDb8; }
+  int32_t snrDb8() const { return bandSnrDb8; }  // Mean over the bands
+  int32_t flatnessDb8() const { return flatDb8; }
+  int32_t noiseFlatnessDb8() const { return noiseFlatDb8; }
+  bool active() const { return lastActive; }
+
+ private:
+  int16_t twiddle[SPECTRUM_FFT_SIZE];
+  int16_t window[SPECTRUM_FFT_SIZE];
+  int16_t samples[SPECTRUM_FFT_SIZE];
+  int32_t re[SPECTRUM_BINS];
+  int32_t im[SPECTRUM_BINS];
+
+  bool started;
+  bool lastActive;
+  int32_t frameDb8;
+  int32_t flatDb8;
+  int32_t bandSnrDb8;
+  int32_t bandDb8[VAD_BANDS];  // This frame
+  int32_t noiseFloorDb8;
+  int32_t noiseFlatDb8;
+  int32_t noiseBandDb8[VAD_BANDS];
+  uint32_t run;       // Consecutive active frames
+  uint32_t loudRun;   // Consecutive frames above VAD_LOUD_DB
+  uint32_t hangover;  // Frames still sent after the last active one
+  uint32_t sinceSid;  // Frames since the last descriptor
+  uint32_t riseCount;
+  int32_t sidNoiseDb8;
+  bool silent;
+
+  void analyze(const int16_t* pcm);
+  void trackNoise(int32_t shift);
+};
+
+#endif  // VOICE_ACTIVITY_H
@@ -8,5 +8,7 @@
 void setupWiFi();
 void setupESPNow();
 void maintainWiFi();
+void meshBeaconTick();  // Broadcast route beacons for relaying nodes
+void syncBeaconTick();  // Playback time base: take over or beacon as master
 
 #endif  // WIFI_ESPNOW_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef OTA_RECEIVER_H
+#define OTA_RECEIVER_H
+
+#include <Arduino.h>
+#include <bearssl/bearssl_hash.h>
+
+#include "../shared/node_ota.h"
+
+// Receives a firmware image broadcast by the gateway (see node_ota.h) and
+// writes it straight into the OTA flash region through Updater. Chunks are
+// buffered one window at a time so the flash is always written in order.
+class OtaReceiver {
+ public:
+  OtaReceiver();
+
+  void begin(uint8_t nodeId, const uint8_t* gatewayMac);
+
+  // Called from the ESP-NOW receive callback
+  void onFrame(const uint8_t* data, uint8_t len);
+
+  // Called from loop(): flash writes, hashing and status replies
+  void loop();
+
+  // True while a transfer is running; the node should stay responsive
+  bool isActive() const { return state == NODE_OTA_RECEIVING; }
+
+ private:
+  uint8_t nodeId;
+  uint8_t gateway[6];
+
+  uint8_t state;
+  uint8_t session;
+  uint32_t imageSize;
+  uint16_t chunkCount;
+  uint8_t expectedHash[NODE_OTA_HASH_SIZE];
+  br_sha256_context sha;
+  volatile uint32_t lastFrameMs;  // Last frame of the running session
+
+  // Current window, filled by the receive callback
+  uint8_t window[NODE_OTA_WINDOW][NODE_OTA_CHUNK_SIZE];
+  volatile uint16_t windowStart;
+  volatile uint16_t receivedMask;
+
+  // Requests raised by the callback, handled in loop()
+  NodeOtaAnnounce pendingAnnounce;
+  volatile bool announcePending;
+  volatile bool pollPending;
+  volatile uint16_t pollWindow;
+  volatile bool commitPending;
+  volatile bool abortPending;
+
+  void handleAnnounce();
+  void flushWindow();
+  void handleCommit();
+  void sendStatus();
+  void abandon(const char* reason);
+  void fail(const char* reason);
+};
+
+#endif  // OTA_RECEIVER_H
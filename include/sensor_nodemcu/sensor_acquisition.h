@@ -0,0 +1,99 @@
+#ifndef SENSOR_ACQUISITION_H
+#define SENSOR_ACQUISITION_H
+
+#include <Arduino.h>
+
+// BMP180 (I2C)
+#define BMP180_ADDRESS 0x77
+#define BMP180_OSS 3          // Ultra high resolution, same as before
+#define BMP180_TEMP_WAIT_US 4500
+#define BMP180_PRES_WAIT_US 25500
+
+// DHT22 edge capture
+#define DHT_START_LOW_US 1100  // Host start signal
+#define DHT_CAPTURE_TIMEOUT_US 8000
+#define DHT_MAX_EDGES 90       // 3 preamble + 80 bit + 1 release edges
+#define DHT_RESPONSE_MIN_US 65  // Response pulses are 80 us, bit lows 50 us
+
+// UV oversampling: spread over the BMP conversion, ESP8266 WiFi dislikes
+// back-to-back analogRead() calls
+#define UV_OVERSAMPLE 16
+#define UV_SAMPLE_SPACING_US 1000
+
+// Per-sample timings in microseconds, measured from start()
+struct AcquisitionTimings {
+  uint32_t dhtUs;
+  uint32_t bmpUs;
+  uint32_t uvUs;
+  uint32_t totalUs;
+};
+
+// Cooperative acquisition of one sensor sample. start() kicks off the DHT22
+// start signal, the BMP180 temperature conversion and UV oversampling; poll()
+// advances all three without blocking, so the BMP conversion delays overlap
+// with the DHT transfer (timed by pin-change interrupts) and the ADC reads.
+class SensorAcquisition {
+ public:
+  SensorAcquisition();
+
+  // I2C must already be running (Wire.begin)
+  bool begin(uint8_t dhtPin, uint8_t uvPin);
+
+  void start();
+  bool busy() const { return running; }
+
+  // Advance the sample, returns true once when all sensors are done
+  bool poll();
+
+  // Results of the last completed sample
+  bool dhtValid() const { return dhtOk; }
+  bool bmpValid() const { return bmpOk; }
+  float getTemperature() const { return temperature; }
+  float getHumidity() const { return humidity; }
+  float getPressure() const { return pressure; }  // hPa
+  float getUvVoltage() const { return uvVoltage; }
+  const AcquisitionTimings& getTimings() const { return timings; }
+
+ private:
+  enum DhtState : uint8_t { DHT_IDLE, DHT_START_LOW, DHT_CAPTURE, DHT_DONE };
+  enum BmpState : uint8_t { BMP_IDLE, BMP_WAIT_TEMP, BMP_WAIT_PRES, BMP_DONE };
+
+  uint8_t dhtPin;
+  uint8_t uvPin;
+  bool bmpPresent;
+
+  // BMP180 calibration (datasheet names)
+  int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
+  uint16_t ac4, ac5, ac6;
+
+  bool running;
+  uint32_t startUs;
+  DhtState dhtState;
+  uint32_t dhtStateUs;
+  BmpState bmpState;
+  uint32_t bmpStateUs;
+  int32_t rawTemp;
+  uint8_t uvCount;
+  uint32_t uvSum;
+  uint32_t uvLastUs;
+
+  bool dhtOk;
+  bool bmpOk;
+  float temperature;
+  float humidity;
+  float pressure;
+  float uvVoltage;
+  AcquisitionTimings timings;
+
+  void pollDht(uint32_t now);
+  void pollBmp(uint32_t now);
+  void pollUv(uint32_t now);
+  int dhtFirstBitEdge(uint8_t n);
+  bool decodeDht();
+
+  bool bmpWrite(uint8_t reg, uint8_t value);
+  bool bmpRead(uint8_t reg, uint8_t* buf, uint8_t len);
+  float bmpCompensate(int32_t up);
+};
+
+#endif  // SENSOR_ACQUISITION_H
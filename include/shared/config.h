@@ -22,4 +22,8 @@ static const char* MQTT_SERVER = "broker.hivemq.com";
 static const int MQTT_PORT = 1883;
 static const char* MQTT_CLIENT_ID = "SmartAlarmClock";
 
+// Local time for rules (POSIX TZ string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3")
+static const char* NTP_SERVER = "pool.ntp.org";
+static const char* TIMEZONE = "UTC0";
+
 #endif  // SMARTALARM_CONFIG_H
@@ -0,0 +1,271 @@
+// Multi-hop ESP-NOW framing shared by the sensor nodes and the gateway
+#ifndef ESPNOW_MESH_H
+#define ESPNOW_MESH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sensor_data.h"
+
+// ============================================================================
+// Protocol constants
+// ============================================================================
+#define MESH_MAGIC 0xA7
+#define MESH_VERSION 1
+#define MESH_GATEWAY_ID 0      // Node id advertised by the gateway
+#define MESH_MAX_HOPS 4        // Transmissions allowed from origin to gateway
+#define MESH_DEDUP_SLOTS 32    // (origin, seq) pairs remembered per device
+#define MESH_MAX_NEIGHBORS 8   // Candidate parents tracked per node
+#define MESH_BEACON_INTERVAL 10000   // ms between route beacons
+#define MESH_NEIGHBOR_TIMEOUT 35000  // ms, roughly three missed beacons
+#define MESH_MIN_RSSI -88      // Links weaker than this are never chosen
+#define MESH_ETX_SCALE 100     // ETX values are fixed point, x100
+#define MESH_ETX_UNREACHABLE 0xFFFF
+
+enum MeshFrameType : uint8_t { MESH_FRAME_DATA = 1, MESH_FRAME_BEACON = 2 };
+
+// ============================================================================
+// Wire format
+// ============================================================================
+#pragma pack(push, 1)
+typedef struct {
+  uint8_t magic;          // MESH_MAGIC, tells mesh frames from legacy ones
+  uint8_t version;        // MESH_VERSION
+  uint8_t type;           // MeshFrameType
+  uint8_t originId;       // Node that produced the payload
+  uint16_t seq;           // Per-origin sequence number
+  uint8_t hopCount;       // Transmissions so far (origin sends with 1)
+  uint8_t hopLimit;       // Frame is not forwarded once hopCount reaches it
+  uint16_t relayDelayMs;  // Store-and-forward residence time, summed
+  uint8_t senderId;       // Last transmitter
+  uint8_t reserved;
+} MeshHeader;  // Total: 12 bytes
+
+typedef struct {
+  MeshHeader header;
+  SensorData data;
+} MeshDataFrame;  // Total: 50 bytes
+
+typedef struct {
+  MeshHeader header;
+  uint16_t pathEtx;       // Sender's ETX to the gateway (x100)
+  uint8_t hopsToGateway;  // Sender's hop distance (gateway = 0)
+} MeshBeaconFrame;  // Total: 15 bytes
+#pragma pack(pop)
+
+inline void meshInitHeader(MeshHeader& h, MeshFrameType type, uint8_t origin,
+                           uint16_t seq) {
+  h.magic = MESH_MAGIC;
+  h.version = MESH_VERSION;
+  h.type = type;
+  h.originId = origin;
+  h.seq = seq;
+  h.hopCount = 1;
+  h.hopLimit = MESH_MAX_HOPS;
+  h.relayDelayMs = 0;
+  h.senderId = origin;
+  h.reserved = 0;
+}
+
+inline bool meshIsValid(const uint8_t* data, int len) {
+  if (len < (int)sizeof(MeshHeader)) return false;
+  const MeshHeader* h = (const MeshHeader*)data;
+  if (h->magic != MESH_MAGIC || h->version != MESH_VERSION) return false;
+  if (h->type == MESH_FRAME_DATA) return len == (int)sizeof(MeshDataFrame);
+  if (h->type == MESH_FRAME_BEACON) return len == (int)sizeof(MeshBeaconFrame);
+  return false;
+}
+
+// ============================================================================
+// Duplicate suppression by (origin, seq)
+// ============================================================================
+// A frame can reach a relay or the gateway over more than one path, and a
+// lost MAC ack makes the sender retransmit. Both cases are filtered here.
+class MeshDedupCache {
+ public:
+  MeshDedupCache() : next(0) { memset(slots, 0xFF, sizeof(slots)); }
+
+  // Returns true if (origin, seq) was already seen, otherwise remembers it
+  bool checkAndInsert(uint8_t origin, uint16_t seq) {
+    uint32_t key = ((uint32_t)origin << 16) | seq;
+    for (int i = 0; i < MESH_DEDUP_SLOTS; i++) {
+      if (slots[i] == key) return true;
+    }
+    slots[next] = key;
+    next = (next + 1) % MESH_DEDUP_SLOTS;
+    return false;
+  }
+
+ private:
+  uint32_t slots[MESH_DEDUP_SLOTS];
+  uint8_t next;
+};
+
+// ============================================================================
+// Loss accounting by origin sequence number
+// ============================================================================
+#define MESH_SEQ_REORDER 32   // Frames this far behind the newest are late
+#define MESH_SEQ_REBOOT 1000  // Jumps this far ahead mean the node rebooted
+
+// Frames lost between the newest frame seen from an origin (*lastSeq) and
+// seq, which then becomes the newest. Frames of one origin overtake each
+// other when they take different relay paths; a late frame is not a loss
+// and leaves *lastSeq where it is, so the next frame in order does not
+// count the late one's successors again. Any other jump resynchronizes.
+inline uint16_t meshSeqLost(uint16_t* lastSeq, uint16_t seq) {
+  int16_t ahead = (int16_t)(seq - *lastSeq);
+  if (ahead <= 0 && ahead > -MESH_SEQ_REORDER) return 0;  // Late or repeat
+  *lastSeq = seq;
+  if (ahead <= 0 || ahead >= MESH_SEQ_REBOOT) return 0;
+  return (uint16_t)(ahead - 1);
+}
+
+// ============================================================================
+// Neighbor table and parent selection
+// ============================================================================
+struct MeshNeighbor {
+  uint8_t mac[6];
+  uint8_t nodeId;
+  uint8_t hopsToGateway;
+  uint16_t pathEtx;       // Advertised ETX to the gateway (x100)
+  uint16_t lastSeq;       // Last beacon sequence number heard
+  uint8_t prr;            // Packet reception ratio EWMA, 0-255
+  int8_t rssi;            // dBm, 0 when the radio did not report it
+  uint32_t lastHeardMs;
+  bool used;
+};
+
+class MeshNeighborTable {
+ public:
+  MeshNeighborTable() { memset(entries, 0, sizeof(entries)); }
+
+  // Update from a received beacon. Missed beacon sequence numbers count as
+  // failed receptions, so the PRR estimate also tracks the forward link.
+  void onBeacon(const uint8_t* mac, const MeshBeaconFrame& b, int8_t rssi,
+                uint32_t nowMs) {
+    MeshNeighbor* n = find(mac);
+    if (!n) {
+      n = allocate(nowMs);
+      memcpy(n->mac, mac, 6);
+      n->used = true;
+      n->prr = 192;  // Optimistic start (75%) so new links get a chance
+      n->lastSeq = b.header.seq - 1;
+    }
+
+    uint16_t missed = (uint16_t)(b.header.seq - n->lastSeq - 1);
+    if (missed > 8) missed = 8;  // Reboot or long outage, do not over-punish
+    for (uint16_t i = 0; i < missed; i++) updatePrr(n, false);
+    updatePrr(n, true);
+
+    n->nodeId = b.header.senderId;
+    n->hopsToGateway = b.hopsToGateway;
+    n->pathEtx = b.pathEtx;
+    n->lastSeq = b.header.seq;
+    if (rssi != 0) n->rssi = rssi;
+    n->lastHeardMs = nowMs;
+  }
+
+  // Unicast MAC-level result towards a neighbor (ESP-NOW send callback)
+  void onSendResult(const uint8_t* mac, bool delivered) {
+    MeshNeighbor* n = find(mac);
+    if (n) updatePrr(n, delivered);
+  }
+
+  // Set the RSSI for a neighbor when it is known out of band
+  void setRssi(const uint8_t* mac, int8_t rssi) {
+    MeshNeighbor* n = find(mac);
+    if (n) n->rssi = rssi;
+  }
+
+  void expire(uint32_t nowMs) {
+    for (int i = 0; i < MESH_MAX_NEIGHBORS; i++) {
+      if (entries[i].used &&
+          nowMs - entries[i].lastHeardMs > MESH_NEIGHBOR_TIMEOUT) {
+        entries[i].used = false;
+      }
+    }
+  }
+
+  // Link ETX = 1 / (df * dr), with df == dr assumed from the beacon PRR
+  static uint16_t linkEtx(const MeshNeighbor& n) {
+    if (n.prr < 16) return MESH_ETX_UNREACHABLE;
+    uint32_t p = n.prr;
+    uint32_t etx = (uint32_t)MESH_ETX_SCALE * 255 * 255 / (p * p);
+    return etx > 0xFFFE ? 0xFFFE : (uint16_t)etx;
+  }
+
+  // Total cost through a neighbor, MESH_ETX_UNREACHABLE if unusable
+  static uint16_t pathCost(const MeshNeighbor& n) {
+    if (!n.used || n.pathEtx == MESH_ETX_UNREACHABLE) {
+      return MESH_ETX_UNREACHABLE;
+    }
+    if (n.hopsToGateway + 1 > MESH_MAX_HOPS) return MESH_ETX_UNREACHABLE;
+    if (n.rssi != 0 && n.rssi < MESH_MIN_RSSI) return MESH_ETX_UNREACHABLE;
+    uint16_t link = linkEtx(n);
+    if (link == MESH_ETX_UNREACHABLE) return MESH_ETX_UNREACHABLE;
+    uint32_t cost = (uint32_t)n.pathEtx + link;
+    return cost >= MESH_ETX_UNREACHABLE ? MESH_ETX_UNREACHABLE - 1
+                                        : (uint16_t)cost;
+  }
+
+  // Best parent by lowest path ETX; stronger RSSI breaks ties within 0.1 ETX.
+  // Returns nullptr when no neighbor offers a usable route.
+  const MeshNeighbor* bestParent(uint8_t selfId) const {
+    const MeshNeighbor* best = nullptr;
+    uint16_t bestCost = MESH_ETX_UNREACHABLE;
+    for (int i = 0; i < MESH_MAX_NEIGHBORS; i++) {
+      const MeshNeighbor& n = entries[i];
+      if (!n.used || n.nodeId == selfId) continue;
+      uint16_t cost = pathCost(n);
+      if (cost == MESH_ETX_UNREACHABLE) continue;
+      bool better = !best || cost + 10 < bestCost;
+      bool tie = best && cost <= bestCost + 10 && cost + 10 >= bestCost;
+      if (better || (tie && n.rssi > best->rssi)) {
+        best = &n;
+        bestCost = cost;
+      }
+    }
+    return best;
+  }
+
+  const MeshNeighbor* find(const uint8_t* mac) const {
+    for (int i = 0; i < MESH_MAX_NEIGHBORS; i++) {
+      if (entries[i].used && memcmp(entries[i].mac, mac, 6) == 0) {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  MeshNeighbor entries[MESH_MAX_NEIGHBORS];
+
+  MeshNeighbor* find(const uint8_t* mac) {
+    return const_cast<MeshNeighbor*>(
+        static_cast<const MeshNeighborTable*>(this)->find(mac));
+  }
+
+  // Free slot, or the least recently heard neighbor when the table is full
+  MeshNeighbor* allocate(uint32_t nowMs) {
+    MeshNeighbor* oldest = &entries[0];
+    for (int i = 0; i < MESH_MAX_NEIGHBORS; i++) {
+      if (!entries[i].used) {
+        memset(&entries[i], 0, sizeof(MeshNeighbor));
+        return &entries[i];
+      }
+      if (nowMs - entries[i].lastHeardMs > nowMs - oldest->lastHeardMs) {
+        oldest = &entries[i];
+      }
+    }
+    memset(oldest, 0, sizeof(MeshNeighbor));
+    return oldest;
+  }
+
+  // EWMA with alpha = 1/8
+  static void updatePrr(MeshNeighbor* n, bool ok) {
+    int32_t target = ok ? 255 : 0;
+    n->prr = (uint8_t)(n->prr + (target - (int32_t)n->prr) / 8);
+  }
+};
+
+#endif  // ESPNOW_MESH_H
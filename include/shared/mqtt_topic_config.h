@@ -1,51 +1,61 @@
 // MQTT Topic Configuration
 // Centralized definitions for all MQTT topics used in the Smart Alarm Clock
-// system
+// system. Plain C strings, so host simulations publish on the same topics.
 #ifndef MQTT_TOPIC_CONFIG_H
 #define MQTT_TOPIC_CONFIG_H
 
-#include <Arduino.h>
-
 // ============================================================================
 // GATEWAY SENSORS (ESP32) - Local/Inside Sensors
 // ============================================================================
-static const char* MQTT_TOPIC_GATEWAY_TEMP =
+static const char* const MQTT_TOPIC_GATEWAY_TEMP =
     "smartalarm/gateway/temperature/inside";
-static const char* MQTT_TOPIC_GATEWAY_HUMIDITY =
+static const char* const MQTT_TOPIC_GATEWAY_HUMIDITY =
     "smartalarm/gateway/humidity/inside";
-static const char* MQTT_TOPIC_GATEWAY_LIGHT = "smartalarm/gateway/light/inside";
-static const char* MQTT_TOPIC_STATUS = "smartalarm/gateway/status";
+static const char* const MQTT_TOPIC_GATEWAY_LIGHT =
+    "smartalarm/gateway/light/inside";
+static const char* const MQTT_TOPIC_GATEWAY_NOISE =
+    "smartalarm/gateway/noise/inside";
+static const char* const MQTT_TOPIC_GATEWAY_ANALYTICS =
+    "smartalarm/gateway/analytics/inside";  // Light and noise stats
+static const char* const MQTT_TOPIC_STATUS = "smartalarm/gateway/status";
 
 // ============================================================================
 // REMOTE SENSORS (NodeMCU) - Outside Sensors
 // ============================================================================
-static const char* MQTT_TOPIC_REMOTE_TEMP =
+static const char* const MQTT_TOPIC_REMOTE_TEMP =
     "smartalarm/sensor/temperature/outside";
-static const char* MQTT_TOPIC_REMOTE_HUMIDITY =
+static const char* const MQTT_TOPIC_REMOTE_HUMIDITY =
     "smartalarm/sensor/humidity/outside";
-static const char* MQTT_TOPIC_REMOTE_PRESSURE =
+static const char* const MQTT_TOPIC_REMOTE_PRESSURE =
     "smartalarm/sensor/pressure/outside";
-static const char* MQTT_TOPIC_REMOTE_UV = "smartalarm/sensor/uvindex/outside";
-static const char* MQTT_TOPIC_REMOTE_BATTERY =
+static const char* const MQTT_TOPIC_REMOTE_UV =
+    "smartalarm/sensor/uvindex/outside";
+static const char* const MQTT_TOPIC_REMOTE_BATTERY =
     "smartalarm/sensor/battery/outside";
-static const char* MQTT_TOPIC_REMOTE_STATUS = "smartalarm/sensor/status";
+static const char* const MQTT_TOPIC_REMOTE_STATUS = "smartalarm/sensor/status";
+static const char* const MQTT_TOPIC_REMOTE_ANALYTICS =
+    "smartalarm/sensor/analytics/outside";  // Smoothed stats, dew point, trend
+static const char* const MQTT_TOPIC_MESH_STATS =
+    "smartalarm/gateway/mesh";  // Per-hop latency/loss of relayed frames
+static const char* const MQTT_TOPIC_DEADLINES =
+    "smartalarm/gateway/deadlines";  // Task deadline violations and stats
 
 // ============================================================================
 // AUDIO UPLOAD TOPICS (Gateway <-> Uploader Communication)
 // ============================================================================
-static const char* MQTT_TOPIC_AUDIO_REQUEST =
+static const char* const MQTT_TOPIC_AUDIO_REQUEST =
     "esp32/audio_request";  // uploader -> gateway (REQUEST_FREE_SPACE)
-static const char* MQTT_TOPIC_AUDIO_CHUNK =
+static const char* const MQTT_TOPIC_AUDIO_CHUNK =
     "esp32/audio_chunk";  // uploader -> gateway (START/CHUNK/END)
-static const char* MQTT_TOPIC_AUDIO_RESPONSE =
+static const char* const MQTT_TOPIC_AUDIO_RESPONSE =
     "esp32/audio_response";  // gateway -> uploader (FREE:xxx)
-static const char* MQTT_TOPIC_AUDIO_ACK =
+static const char* const MQTT_TOPIC_AUDIO_ACK =
     "esp32/audio_ack";  // gateway -> uploader (ACK:<chunk_index>)
 
 // ============================================================================
 // AUDIO STATUS TOPICS (Gateway -> Server)
 // ============================================================================
-static const char* MQTT_TOPIC_AUDIO_STATUS =
+static const char* const MQTT_TOPIC_AUDIO_STATUS =
     "esp32/audio_status";  // gateway -> server (playing/finished)
 
 #endif  // MQTT_TOPIC_CONFIG_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+// Sensor node firmware updates over ESP-NOW.
+// The gateway broadcasts the image in fixed-size chunks grouped into windows;
+// after each window it polls and every node answers with a bitmap of the
+// chunks it is still missing, so one transmission serves all nodes and only
+// the union of the gaps is repeated.
+#ifndef NODE_OTA_H
+#define NODE_OTA_H
+
+#include <stdint.h>
+
+#define NODE_OTA_MAGIC 0xA8     // Distinct from MESH_MAGIC
+#define NODE_OTA_CHUNK_SIZE 240
+#define NODE_OTA_WINDOW 16      // Chunks per window, one bit each in the ack
+#define NODE_OTA_HASH_SIZE 32   // SHA-256
+#define NODE_OTA_MAX_NODES 16   // Nodes served by a single session
+
+// A receiving node that hears nothing of its session for this long drops
+// it; the gateway never goes quiet for more than a few seconds
+#define NODE_OTA_SILENCE_MS 10000
+
+enum NodeOtaFrameType : uint8_t {
+  NODE_OTA_ANNOUNCE = 1,  // gateway -> nodes: image size and hash
+  NODE_OTA_CHUNK = 2,     // gateway -> nodes: one chunk of the image
+  NODE_OTA_POLL = 3,      // gateway -> nodes: report missing chunks
+  NODE_OTA_STATUS = 4,    // node -> gateway: selective ack / final state
+  NODE_OTA_COMMIT = 5,    // gateway -> nodes: verify hash and reboot
+  NODE_OTA_ABORT = 6      // gateway -> nodes: drop the session
+};
+
+enum NodeOtaState : uint8_t {
+  NODE_OTA_IDLE = 0,
+  NODE_OTA_RECEIVING = 1,
+  NODE_OTA_VERIFIED = 2,  // Hash matched, rebooting into the new image
+  NODE_OTA_FAILED = 3     // Flash error or hash mismatch
+};
+
+#pragma pack(push, 1)
+typedef struct {
+  uint8_t magic;      // NODE_OTA_MAGIC
+  uint8_t type;       // NodeOtaFrameType
+  uint8_t sessionId;  // Changes with every image the gateway sends
+  uint8_t reserved;
+} NodeOtaHeader;  // Total: 4 bytes
+
+typedef struct {
+  NodeOtaHeader header;
+  uint32_t imageSize;
+  uint16_t chunkCount;
+  uint8_t sha256[NODE_OTA_HASH_SIZE];
+} NodeOtaAnnounce;  // Total: 42 bytes
+
+typedef struct {
+  NodeOtaHeader header;
+  uint16_t index;
+  uint8_t length;  // NODE_OTA_CHUNK_SIZE except for the last chunk
+  uint8_t reserved;
+  uint8_t data[NODE_OTA_CHUNK_SIZE];
+} NodeOtaChunk;  // Total: 248 bytes (ESP-NOW limit is 250)
+
+typedef struct {
+  NodeOtaHeader header;
+  uint16_t windowStart;  // First chunk index of the window being polled
+} NodeOtaPoll;  // Total: 6 bytes
+
+typedef struct {
+  NodeOtaHeader header;
+  uint8_t nodeId;
+  uint8_t state;         // NodeOtaState
+  uint16_t windowStart;  // Node's current window (ahead = already complete)
+  uint16_t missingMask;  // Bit i set = chunk windowStart + i still missing
+} NodeOtaStatus;  // Total: 10 bytes
+#pragma pack(pop)
+
+inline bool nodeOtaIsFrame(const uint8_t* data, int len) {
+  return len >= (int)sizeof(NodeOtaHeader) && data[0] == NODE_OTA_MAGIC;
+}
+
+inline uint16_t nodeOtaChunkCount(uint32_t imageSize) {
+  return (uint16_t)((imageSize + NODE_OTA_CHUNK_SIZE - 1) /
+                    NODE_OTA_CHUNK_SIZE);
+}
+
+// Mask of the chunks that actually exist in the window at windowStart
+inline uint16_t nodeOtaWindowMask(uint16_t windowStart, uint16_t chunkCount) {
+  uint16_t remaining = chunkCount - windowStart;
+  if (remaining >= NODE_OTA_WINDOW) return 0xFFFF;
+  return (uint16_t)((1u << remaining) - 1);
+}
+
+#endif  // NODE_OTA_H
@@ -1,7 +1,7 @@
 #ifndef SENSOR_DATA_H
 #define SENSOR_DATA_H
 
-#include <Arduino.h>
+#include <stdint.h>
 
 // Data packet structure sent from Sensor Node to Gateway
 // Using pragma pack to ensure same size on ESP8266 and ESP32
@@ -18,10 +18,14 @@ typedef struct {
 } SensorData;            // Total: 38 bytes
 #pragma pack(pop)
 
-// Device identifiers
+// Device identifiers (override per node with -D SENSOR_NODE_ID=<n>)
+#ifndef SENSOR_NODE_ID
 #define SENSOR_NODE_ID 1
+#endif
 
 // Device names
+#ifndef SENSOR_NODE_NAME
 #define SENSOR_NODE_NAME "SensorNode01"
+#endif
 
 #endif  // SENSOR_DATA_H
@@ -0,0 +1,188 @@
+// Host test and benchmark of the gateway's alarm synthesizer
+// (include/gateway_esp32/alarm_synth.h).
+//
+// Golden output: every built-in tune is rendered for 3 seconds and the PCM
+// hashed (FNV-1a 64); the hashes are fixed below, so any change to the
+// tables, envelopes or sequencer shows up. Rendering is integer only, so
+// the ESP32 produces the same samples. The same renders are repeated in
+// odd chunk sizes (the I2S path pulls whatever fits) and must match, and a
+// stop() must fade out and end within the tune's release. Then the cost
+// per second of audio is measured: ns and TSC cycles, and as a share of
+// the ESP32 at 240 MHz.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/alarm_synth_bench
+//       scripts/alarm_synth_bench.cpp src/gateway_esp32/alarm_synth.cpp
+//   /tmp/alarm_synth_bench          # check against the golden hashes
+//   /tmp/alarm_synth_bench --print  # print hashes after an intended change
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "include/gateway_esp32/alarm_synth.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define GOLDEN_SECONDS 3
+#define COST_SECONDS 60
+
+struct Golden {
+  const char* tune;
+  uint64_t hash;
+};
+
+static const Golden golden[] = {
+    {"beep", 0x64465890690ace01ull},
+    {"chime", 0xa33d652b5fbb89e5ull},
+    {"rise", 0xa5b544ff1fd9d3b1ull},
+};
+
+static uint64_t fnv1a(const int16_t* pcm, size_t samples, uint64_t h) {
+  const uint8_t* p = (const uint8_t*)pcm;
+  for (size_t i = 0; i < samples * 2; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+// Render frames in chunks of the given sizes (cycled); hash and peak
+static uint64_t renderHash(const SynthTune* t, uint32_t frames,
+                           const std::vector<uint32_t>& chunks, int* peak) {
+  AlarmSynth synth;
+  synth.start(t, 0);
+  std::vector<int16_t> pcm(2 * frames);
+  uint32_t done = 0;
+  for (size_t c = 0; done < frames; c++) {
+    uint32_t n = chunks[c % chunks.size()];
+    if (n > frames - done) n = frames - done;
+    done += synth.render(&pcm[2 * done], n);
+  }
+  *peak = 0;
+  for (int16_t s : pcm) {
+    int a = s < 0 ? -s : s;
+    if (a > *peak) *peak = a;
+  }
+  return fnv1a(pcm.data(), pcm.size(), 0xcbf29ce484222325ull);
+}
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+static bool checkGolden(bool print) {
+  bool ok = true;
+  const uint32_t frames = GOLDEN_SECONDS * SYNTH_RATE;
+  printf("Golden output (%d s per tune):\n", GOLDEN_SECONDS);
+  for (const Golden& g : golden) {
+    const SynthTune* t = synthTune(g.tune);
+    if (!t) {
+      printf("  %-6s missing\n", g.tune);
+      ok = false;
+      continue;
+    }
+    int peak;
+    uint64_t h = renderHash(t, frames, {1024}, &peak);
+    int peakOdd;
+    uint64_t odd = renderHash(t, frames, {1, 37, 441, 64, 1000}, &peakOdd);
+    bool match = print || h == g.hash;
+    bool chunked = odd == h;
+    printf("  %-6s 0x%016llxull  peak %5d  %s  chunks %s\n", g.tune,
+           (unsigned long long)h, peak, match ? "ok" : "FAIL",
+           chunked ? "ok" : "FAIL");
+    ok &= match && chunked && peak > 0;
+  }
+  return ok;
+}
+
+static bool checkStop() {
+  bool ok = true;
+  printf("\nstop() rings out:\n");
+  for (uint8_t i = 0; i < synthTuneCount; i++) {
+    const SynthTune* t = &synthTunes[i];
+    AlarmSynth synth;
+    synth.start(t, 0);
+    int16_t buf[2 * 512];
+    uint32_t before = SYNTH_RATE / 2;  // Mid-note
+    while (before) before -= synth.render(buf, before < 512 ? before : 512);
+    synth.stop();
+    uint32_t tail = 0, n;
+    while ((n = synth.render(buf, 512)) > 0) tail += n;
+    uint32_t limit = (uint32_t)((uint64_t)t->releaseMs * SYNTH_RATE / 1000) +
+                     2 * 512;
+    bool pass = !synth.running() && tail <= limit;
+    printf("  %-6s %5u frames of tail (release %u ms)  %s\n", t->name, tail,
+           t->releaseMs, pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+
+  // maxMs: the loop running at the limit still finishes
+  AlarmSynth synth;
+  synth.start(synthTune("beep"), 1500);
+  int16_t buf[2 * 512];
+  uint64_t total = 0;
+  uint32_t n;
+  while ((n = synth.render(buf, 512)) > 0 && total < 60ull * SYNTH_RATE) {
+    total += n;
+  }
+  double seconds = (double)total / SYNTH_RATE;
+  bool pass = !synth.running() && seconds >= 1.5 && seconds < 3.0;
+  printf("  maxMs 1500 ended after %.2f s  %s\n", seconds, pass ? "ok" : "FAIL");
+  return ok && pass;
+}
+
+// ============================================================================
+// COST
+// ============================================================================
+static void cost() {
+  printf("\nCost per second of audio (%d s rendered per tune):\n",
+         COST_SECONDS);
+  std::vector<int16_t> buf(2 * 1024);
+  for (uint8_t i = 0; i < synthTuneCount; i++) {
+    AlarmSynth synth;
+    synth.start(&synthTunes[i], 0);
+    const uint32_t frames = COST_SECONDS * SYNTH_RATE;
+    uint32_t done = 0;
+    volatile int16_t sink = 0;
+    auto t0 = Clock::now();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    while (done < frames) {
+      done += synth.render(buf.data(), 1024);
+      sink = buf[0];
+    }
+#ifdef HAVE_TSC
+    uint64_t cycles = __rdtsc() - c0;
+#endif
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0)
+                    .count();
+    (void)sink;
+    printf("  %-6s %8.0f ns", synthTunes[i].name, ns / COST_SECONDS);
+#ifdef HAVE_TSC
+    double perSecond = (double)cycles / COST_SECONDS;
+    printf(", %9.0f TSC cycles (%.2f%% of a 240 MHz core)", perSecond,
+           100.0 * perSecond / 240e6);
+#endif
+    printf("\n");
+  }
+  printf("state: %zu bytes, tables in flash\n", sizeof(AlarmSynth));
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+int main(int argc, char** argv) {
+  bool print = argc > 1 && strcmp(argv[1], "--print") == 0;
+  bool ok = checkGolden(print);
+  ok &= checkStop();
+  cost();
+  printf("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+// Host benchmark for the gateway's transfer buffer pool
+// (include/gateway_esp32/buffer_pool.h).
+//
+// Models the download path: a "socket" thread reads data in random-sized
+// chunks, a "SD" thread writes it out, and buffers travel between them
+// through a bounded queue. Two variants are compared:
+//   malloc - a heap buffer per chunk; the SD stage has to copy it into an
+//            aligned DMA buffer first (a bounce copy), as the SD/SPI driver
+//            does for buffers outside DMA-capable RAM
+//   pool   - the socket stage fills pool blocks and hands the pointer on;
+//            the SD stage transfers straight from the block
+// An OTA session holding four blocks runs alongside to exercise
+// multi-block acquire. Prints throughput, pool occupancy, exhaustion and
+// bounce-copy counts, and checks that no block is ever owned twice.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -pthread -I. -o /tmp/pool_bench
+//       scripts/buffer_pool_bench.cpp src/gateway_esp32/buffer_pool.cpp
+//   /tmp/pool_bench [megabytes]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+#include "include/gateway_esp32/buffer_pool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Chunk {
+  uint8_t* data;
+  size_t len;
+};
+
+// Bounded queue standing in for a FreeRTOS queue of pointers
+class ChunkQueue {
+ public:
+  explicit ChunkQueue(size_t depth) : depth(depth) {}
+  void push(Chunk c) {
+    std::unique_lock<std::mutex> lock(m);
+    notFull.wait(lock, [&] { return q.size() < depth; });
+    q.push_back(c);
+    notEmpty.notify_one();
+  }
+  Chunk pop() {
+    std::unique_lock<std::mutex> lock(m);
+    notEmpty.wait(lock, [&] { return !q.empty(); });
+    Chunk c = q.front();
+    q.pop_front();
+    notFull.notify_one();
+    return c;
+  }
+
+ private:
+  size_t depth;
+  std::deque<Chunk> q;
+  std::mutex m;
+  std::condition_variable notEmpty, notFull;
+};
+
+static volatile uint32_t sinkSum = 0;
+static uint8_t* sdDmaBuffer;  // The driver's own bounce buffer
+
+// "SD write": checksum a few bytes of what the DMA engine would read
+static void sdTransfer(const uint8_t* p, size_t len) {
+  sinkSum += p[0] + p[len / 2] + p[len - 1];
+}
+
+static void fillFromSocket(uint8_t* dst, size_t len, uint8_t seed) {
+  memset(dst, seed, len);
+}
+
+struct Result {
+  double seconds;
+  uint64_t bytes;
+  uint64_t bounces;
+  uint64_t bytesCopied;
+};
+
+static Result runMalloc(uint64_t total) {
+  ChunkQueue queue(3);
+  std::atomic<uint64_t> copied(0), bounces(0);
+  auto t0 = Clock::now();
+
+  std::thread sd([&] {
+    for (;;) {
+      Chunk c = queue.pop();
+      if (!c.data) break;
+      // Heap memory is not DMA-capable: copy into the driver buffer
+      memcpy(sdDmaBuffer, c.data, c.len);
+      bounces++;
+      copied += c.len;
+      sdTransfer(sdDmaBuffer, c.len);
+      free(c.data);
+    }
+  });
+
+  std::mt19937 rng(85);
+  std::uniform_int_distribution<size_t> chunk(512, 1460);
+  uint64_t sent = 0;
+  while (sent < total) {
+    size_t len = chunk(rng);
+    uint8_t* buf = (uint8_t*)malloc(len);
+    fillFromSocket(buf, len, (uint8_t)sent);
+    queue.push({buf, len});
+    sent += len;
+  }
+  queue.push({nullptr, 0});
+  sd.join();
+
+  double s = std::chrono::duration<double>(Clock::now() - t0).count();
+  return {s, sent, bounces.load(), copied.load()};
+}
+
+static Result runPool(BufferPool& pool, uint64_t total) {
+  ChunkQueue queue(3);
+  // Ownership check: every block handed out must be free beforehand
+  std::mutex ownedLock;
+  std::set<uint8_t*> owned;
+  int doubleOwned = 0;
+  auto claim = [&](uint8_t* p) {
+    std::lock_guard<std::mutex> lock(ownedLock);
+    if (!owned.insert(p).second) doubleOwned++;
+  };
+  auto unclaim = [&](uint8_t* p) {
+    std::lock_guard<std::mutex> lock(ownedLock);
+    owned.erase(p);
+  };
+
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> otaSessions(0);
+
+  // OTA session: takes the whole ring, holds it briefly, gives it back
+  std::thread ota([&] {
+    uint8_t* ring[4];
+    while (!stop) {
+      if (pool.acquire(ring, 4)) {
+        for (auto* b : ring) claim(b);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        for (auto* b : ring) {
+          unclaim(b);
+          pool.release(b);
+        }
+        otaSessions++;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  });
+
+  auto t0 = Clock::now();
+  std::thread sd([&] {
+    for (;;) {
+      Chunk c = queue.pop();
+      if (!c.data) break;
+      pool.noteTransfer(c.data);
+      sdTransfer(c.data, c.len);
+      unclaim(c.data);
+      pool.release(c.data);
+    }
+  });
+
+  std::mt19937 rng(85);
+  std::uniform_int_distribution<size_t> chunk(512, 1460);
+  uint64_t sent = 0;
+  while (sent < total) {
+    uint8_t* block = pool.acquire();
+    if (!block) {
+      std::this_thread::yield();
+      continue;
+    }
+    claim(block);
+    // Fill the whole block from socket reads before handing it on
+    size_t fill = 0;
+    while (fill < BUFFER_POOL_BLOCK_SIZE && sent + fill < total) {
+      size_t len = chunk(rng);
+      if (len > BUFFER_POOL_BLOCK_SIZE - fill) {
+        len = BUFFER_POOL_BLOCK_SIZE - fill;
+      }
+      fillFromSocket(block + fill, len, (uint8_t)(sent + fill));
+      fill += len;
+    }
+    queue.push({block, fill});
+    sent += fill;
+  }
+  queue.push({nullptr, 0});
+  sd.join();
+  double s = std::chrono::duration<double>(Clock::now() - t0).count();
+  stop = true;
+  ota.join();
+
+  printf("  OTA sessions alongside: %llu, double-owned blocks: %d\n",
+         (unsigned long long)otaSessions.load(), doubleOwned);
+  return {s, sent, pool.bounceCopies(), 0};
+}
+
+int main(int argc, char** argv) {
+  double mb = argc > 1 ? atof(argv[1]) : 256.0;
+  uint64_t total = (uint64_t)(mb * 1024 * 1024);
+  sdDmaBuffer = (uint8_t*)aligned_alloc(BUFFER_POOL_ALIGN, 4096);
+
+  BufferPool pool;
+  if (!pool.begin()) {
+    printf("pool allocation failed\n");
+    return 1;
+  }
+
+  printf("Streaming %.0f MB, pool %d x %d B, host cores: %u\n\n", mb,
+         BUFFER_POOL_BLOCKS, BUFFER_POOL_BLOCK_SIZE,
+         std::thread::hardware_concurrency());
+
+  Result m = runMalloc(total);
+  printf("malloc: %7.1f MB/s  bounce copies %llu (%.1f MB copied)\n",
+         m.bytes / m.seconds / 1048576.0, (unsigned long long)m.bounces,
+         m.bytesCopied / 1048576.0);
+
+  Result p = runPool(pool, total);
+  printf("pool:   %7.1f MB/s  bounce copies %llu, transfers %u\n",
+         p.bytes / p.seconds / 1048576.0, (unsigned long long)p.bounces,
+         pool.transfers());
+
+  char json[192];
+  pool.toJson(json, sizeof(json));
+  printf("\n%s\n", json);
+  return pool.inUse() == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Host mode for the gateway's task deadline monitor
+// (include/gateway_esp32/deadline_monitor.h).
+//
+// Runs the same monitor code with std::thread standing in for the FreeRTOS
+// tasks: an audio decode thread (10 ms period, 6 ms budget) and an MQTT
+// thread (100 ms period, 50 ms budget), each sleeping on a fixed release
+// grid like vTaskDelayUntil (late iterations run back to back). Faults are
+// injected on a schedule:
+//   decode spike - a decode iteration runs 8 ms (budget overrun)
+//   SD contention - an MQTT handler holds the shared SD lock for 25 ms
+//                   while audio needs it (audio misses, MQTT is named)
+//   blocking handler - an MQTT iteration runs 180 ms (overrun and missed
+//                      deadline; the following release starts late)
+// A third thread drains violations the way the MQTT task publishes them.
+// Prints each violation, the per-task JSON, and how many injected faults
+// were caught.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -pthread -I. -o /tmp/deadline_sim
+//       scripts/deadline_monitor_sim.cpp src/gateway_esp32/deadline_monitor.cpp
+//   /tmp/deadline_sim [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "include/gateway_esp32/deadline_monitor.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const Clock::time_point epoch = Clock::now();
+
+static uint32_t hostClockUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             Clock::now() - epoch)
+      .count();
+}
+
+// Stands in for "task on the other core": the WiFi driver thread's state
+static std::atomic<const char*> otherCore("idle");
+static void hostContext(int, char* buf, size_t len) {
+  snprintf(buf, len, "core0:%s", otherCore.load());
+}
+
+static DeadlineMonitor monitor(hostClockUs, hostContext);
+static std::mutex sdLock;  // Shared SD card, as on the gateway
+static std::atomic<bool> running(true);
+
+static std::atomic<int> injectedAudio(0), injectedMqtt(0);
+
+static void spin(std::chrono::microseconds d) {
+  auto until = Clock::now() + d;
+  while (Clock::now() < until) {
+  }
+}
+
+static void audioThread(int id) {
+  auto release = Clock::now();
+  for (uint32_t i = 1; running; i++) {
+    monitor.begin(id);
+    {
+      // Every decode reads its frame from SD
+      std::lock_guard<std::mutex> lock(sdLock);
+      spin(std::chrono::microseconds(i % 150 == 0 ? 8000 : 1500));
+    }
+    if (i % 150 == 0) injectedAudio++;
+    monitor.end(id);
+
+    release += std::chrono::milliseconds(10);
+    std::this_thread::sleep_until(release);  // Catches up like vTaskDelayUntil
+  }
+}
+
+static void mqttThread(int id) {
+  auto release = Clock::now();
+  for (uint32_t i = 1; running; i++) {
+    monitor.begin(id);
+    monitor.setContext(id, "loop");
+    spin(std::chrono::microseconds(2000));
+
+    if (i % 13 == 0) {
+      // Upload chunk: hold the SD card long enough to starve decode
+      monitor.setContext(id, "sd_write");
+      std::lock_guard<std::mutex> lock(sdLock);
+      std::this_thread::sleep_for(std::chrono::milliseconds(25));
+      injectedAudio++;
+    }
+    if (i % 29 == 0) {
+      monitor.setContext(id, "ota");
+      otherCore = "wifi_rx";
+      std::this_thread::sleep_for(std::chrono::milliseconds(180));
+      otherCore = "idle";
+      injectedMqtt++;
+    }
+    monitor.setContext(id, nullptr);
+    monitor.end(id);
+
+    release += std::chrono::milliseconds(100);
+    std::this_thread::sleep_until(release);  // Catches up like vTaskDelayUntil
+  }
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 6.0;
+
+  int audio = monitor.registerTask("AudioDecode", 10000, 6000);
+  int mqtt = monitor.registerTask("MQTT", 100000, 50000);
+
+  printf("Deadline monitor under std::thread for %.0f s, host cores: %u\n\n",
+         seconds, std::thread::hardware_concurrency());
+
+  std::thread a(audioThread, audio);
+  std::thread m(mqttThread, mqtt);
+
+  // Publisher: drains violations like publishDeadlineViolations()
+  int caught[2] = {0, 0};
+  int withContext = 0;
+  char json[256];
+  auto stopAt = Clock::now() + std::chrono::duration<double>(seconds);
+  auto drain = [&] {
+    DeadlineViolation v;
+    while (monitor.pollViolation(v)) {
+      caught[v.task == audio ? 0 : 1]++;
+      if (v.task == audio && strstr(v.others, "MQTT:sd_write")) withContext++;
+      bool show = caught[0] + caught[1] <= 12;
+      if (show && monitor.violationToJson(v, json, sizeof(json))) {
+        printf("  %s\n", json);
+      }
+    }
+  };
+  while (Clock::now() < stopAt) {
+    drain();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  running = false;
+  a.join();
+  m.join();
+  drain();
+
+  char stats[896];
+  monitor.toJson(stats, sizeof(stats));
+  printf("\n%s\n\n", stats);
+
+  DeadlineTaskStats as = monitor.stats(audio), ms = monitor.stats(mqtt);
+  printf("AudioDecode: %u faults injected, %u violations (%u overruns, %u "
+         "misses), %d blamed on MQTT:sd_write, WCRT %u us\n",
+         injectedAudio.load(), caught[0], as.overruns, as.deadlineMisses,
+         withContext, as.responseMaxUs);
+  printf("MQTT:        %u faults injected, %u violations (%u overruns, %u "
+         "misses, %u skipped releases), WCRT %u us\n",
+         injectedMqtt.load(), caught[1], ms.overruns, ms.deadlineMisses,
+         ms.skippedReleases, ms.responseMaxUs);
+  printf("Lost violations: %u\n", monitor.lostViolations());
+
+  bool ok = caught[0] + (int)monitor.lostViolations() >= injectedAudio &&
+            caught[1] >= injectedMqtt && withContext > 0;
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
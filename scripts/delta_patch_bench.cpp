@@ -0,0 +1,390 @@
+// Host test of the gateway's delta OTA applier (DeltaPatcher) against
+// patches made by scripts/ota_delta.py.
+//
+// The patch goes through the same checks as OtaManager: the header's source
+// size and SHA-256 against the running image, DeltaPatcher::feed() on every
+// slice as it arrives, finished() at the end of the download, and the
+// SHA-256 of the written target against the header. Each patch is fed whole,
+// byte by byte and in random TCP-sized slices, and the output must match the
+// new image byte for byte. Then it must be rejected when truncated at every
+// stage, with a bad magic or version, a bad opcode, a copy outside the
+// source, a literal byte changed, trailing data, or against another source
+// image; and no random single-byte corruption may produce a wrong image.
+//
+// Without arguments the bench writes synthetic firmware-like image pairs to
+// /tmp and runs ota_delta.py on them (python3 on the PATH); with arguments it
+// tests a patch made from real images.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/delta_patch_bench
+//       scripts/delta_patch_bench.cpp src/gateway_esp32/delta_patch.cpp
+//   /tmp/delta_patch_bench
+//   /tmp/delta_patch_bench old.bin new.bin update.sadl
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/gateway_esp32/delta_patch.h"
+
+typedef std::vector<uint8_t> Bytes;
+typedef std::chrono::steady_clock Clock;
+
+#define FUZZ_RUNS 500
+
+// ============================================================================
+// SHA-256 (FIPS 180-4), standing in for mbedtls on the host
+// ============================================================================
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static void sha256Block(uint32_t* h, const uint8_t* p) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+           (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5],
+           g = h[6], k = h[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                  ((e & f) ^ (~e & g)) + K256[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                  ((a & b) ^ (a & c) ^ (b & c));
+    k = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
+  }
+  h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e, h[5] += f, h[6] += g,
+      h[7] += k;
+}
+
+static void sha256(const uint8_t* data, size_t len, uint8_t out[32]) {
+  uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  size_t full = len / 64 * 64;
+  for (size_t i = 0; i < full; i += 64) sha256Block(h, data + i);
+  uint8_t tail[128] = {0};
+  size_t rest = len - full;
+  memcpy(tail, data + full, rest);
+  tail[rest] = 0x80;
+  size_t tailLen = rest < 56 ? 64 : 128;
+  uint64_t bits = (uint64_t)len * 8;
+  for (int i = 0; i < 8; i++) {
+    tail[tailLen - 1 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  for (size_t i = 0; i < tailLen; i += 64) sha256Block(h, tail + i);
+  for (int i = 0; i < 8; i++) {
+    out[4 * i] = h[i] >> 24, out[4 * i + 1] = h[i] >> 16,
+    out[4 * i + 2] = h[i] >> 8, out[4 * i + 3] = h[i];
+  }
+}
+
+// ============================================================================
+// APPLY, AS OtaManager DOES
+// ============================================================================
+struct Target {
+  const Bytes* source;
+  Bytes out;
+  size_t limit;  // Partition size
+};
+
+static bool readSource(void* ctx, uint32_t offset, uint8_t* dst, size_t len) {
+  const Target* t = (const Target*)ctx;
+  if (offset + len > t->source->size()) return false;
+  memcpy(dst, t->source->data() + offset, len);
+  return true;
+}
+
+static bool writeTarget(void* ctx, const uint8_t* data, size_t len) {
+  Target* t = (Target*)ctx;
+  if (t->out.size() + len > t->limit) return false;
+  t->out.insert(t->out.end(), data, data + len);
+  return true;
+}
+
+// Slice sizes: 0 feeds the patch whole, 1 byte by byte, otherwise random
+// sizes up to that many bytes. Returns why it was rejected, or nullptr.
+static const char* apply(const Bytes& source, const Bytes& patch, Bytes* out,
+                         size_t maxSlice, std::mt19937& rng) {
+  Target t = {&source, Bytes(), source.size() * 2 + 65536};
+  DeltaPatcher patcher(readSource, writeTarget, &t);
+
+  // beginImage(): the header arrives in the first block
+  if (patch.size() < DELTA_HEADER_SIZE ||
+      !DeltaPatcher::isDelta(patch.data(), 4) ||
+      !patcher.feed(patch.data(), DELTA_HEADER_SIZE)) {
+    return "bad header";
+  }
+  // verifySource()
+  const DeltaHeader& h = patcher.header();
+  uint8_t digest[32];
+  if (h.sourceSize > source.size()) return "source too small";
+  sha256(source.data(), h.sourceSize, digest);
+  if (memcmp(digest, h.sourceSha256, 32) != 0) return "source mismatch";
+
+  size_t pos = DELTA_HEADER_SIZE;
+  while (pos < patch.size()) {
+    size_t n = patch.size() - pos;
+    if (maxSlice == 1) {
+      n = 1;
+    } else if (maxSlice > 1) {
+      n = std::min(n, (size_t)(1 + rng() % maxSlice));
+    }
+    if (!patcher.feed(patch.data() + pos, n)) return patcher.error();
+    pos += n;
+  }
+  if (!patcher.finished()) return "truncated";
+  sha256(t.out.data(), t.out.size(), digest);
+  if (memcmp(digest, h.targetSha256, 32) != 0) return "target hash mismatch";
+  if (out) out->swap(t.out);
+  return nullptr;
+}
+
+// ============================================================================
+// IMAGES AND PATCHES
+// ============================================================================
+static bool readFile(const char* path, Bytes& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[65536];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const char* path, const Bytes& data) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+// Firmware-like pair, as ota_delta.py's selftest builds them: repetitive
+// code words, then insertions, deletions and patches
+static void syntheticPair(std::mt19937& rng, size_t size, int edits, Bytes& old,
+                          Bytes& updated) {
+  std::vector<uint32_t> words(2048);
+  for (uint32_t& w : words) w = rng();
+  old.clear();
+  while (old.size() < size) {
+    uint32_t w = words[rng() % words.size()];
+    old.insert(old.end(), (uint8_t*)&w, (uint8_t*)&w + 4);
+  }
+  updated = old;
+  for (int i = 0; i < edits; i++) {
+    size_t pos = rng() % updated.size();
+    uint32_t kind = rng() % 10;
+    size_t n = 4 + rng() % 252;
+    if (kind < 4) {
+      Bytes ins(n);
+      for (uint8_t& b : ins) b = (uint8_t)rng();
+      updated.insert(updated.begin() + pos, ins.begin(), ins.end());
+    } else if (kind < 7) {
+      updated.erase(updated.begin() + pos,
+                    updated.begin() + std::min(pos + n, updated.size()));
+    } else {
+      for (size_t j = pos; j < std::min(pos + n % 64, updated.size()); j++) {
+        updated[j] = (uint8_t)rng();
+      }
+    }
+  }
+}
+
+static bool makePatch(const char* oldPath, const char* newPath,
+                      const char* patchPath) {
+  std::string cmd = std::string("python3 scripts/ota_delta.py make ") +
+                    oldPath + " " + newPath + " " + patchPath + " > /dev/null";
+  return system(cmd.c_str()) == 0;
+}
+
+static uint32_t le32(const Bytes& p, size_t at) {
+  return p[at] | p[at + 1] << 8 | p[at + 2] << 16 | (uint32_t)p[at + 3] << 24;
+}
+
+static void put32(Bytes& p, size_t at, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+// Offsets of each opcode in a well-formed patch
+static std::vector<size_t> opOffsets(const Bytes& p) {
+  std::vector<size_t> ops;
+  size_t pos = DELTA_HEADER_SIZE;
+  while (pos < p.size()) {
+    ops.push_back(pos);
+    uint8_t op = p[pos];
+    if (op == DELTA_OP_END) break;
+    pos += op == DELTA_OP_COPY ? 9 : 5 + le32(p, pos + 1);
+  }
+  return ops;
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+static bool expectRejected(const char* name, const Bytes& source,
+                           const Bytes& patch, std::mt19937& rng) {
+  const char* why = apply(source, patch, nullptr, 700, rng);
+  printf("  %-34s %s\n", name, why ? why : "ACCEPTED  FAIL");
+  return why != nullptr;
+}
+
+static bool testPatch(const char* label, const Bytes& old, const Bytes& updated,
+                      const Bytes& patch, std::mt19937& rng) {
+  bool ok = true;
+  std::vector<size_t> ops = opOffsets(patch);
+  size_t copies = 0;
+  for (size_t at : ops) copies += patch[at] == DELTA_OP_COPY;
+  printf("\n%s: %zu -> %zu bytes, patch %zu bytes (%.1f%%), %zu ops, "
+         "%zu copies\n",
+         label, old.size(), updated.size(), patch.size(),
+         100.0 * patch.size() / updated.size(), ops.size(), copies);
+
+  const size_t slicings[] = {0, 1, 1460, 4096};
+  const char* slicingNames[] = {"whole", "byte by byte", "1-1460 bytes",
+                                "1-4096 bytes"};
+  for (int s = 0; s < 4; s++) {
+    Bytes out;
+    Clock::time_point t0 = Clock::now();
+    const char* why = apply(old, patch, &out, slicings[s], rng);
+    double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    bool same = !why && out == updated;
+    printf("  %-34s %s (%.1f ms)\n", slicingNames[s],
+           why ? why : same ? "identical" : "DIFFERENT", ms);
+    ok &= same;
+  }
+
+  // Truncated after the header, inside an op's arguments, inside a literal
+  // run, and right before END
+  size_t cuts[] = {DELTA_HEADER_SIZE, ops.size() > 1 ? ops[0] + 3 : 0, 0,
+                   patch.size() - 1};
+  for (size_t at : ops) {
+    if (patch[at] == DELTA_OP_INSERT && le32(patch, at + 1) > 2) {
+      cuts[2] = at + 5 + le32(patch, at + 1) / 2;
+      break;
+    }
+  }
+  const char* cutNames[] = {"truncated after the header",
+                            "truncated inside op arguments",
+                            "truncated inside literal bytes",
+                            "truncated before END"};
+  for (int i = 0; i < 4; i++) {
+    if (cuts[i] == 0) continue;
+    ok &= expectRejected(cutNames[i], old,
+                         Bytes(patch.begin(), patch.begin() + cuts[i]), rng);
+  }
+
+  Bytes p = patch;
+  p[0] = 'X';
+  ok &= expectRejected("bad magic", old, p, rng);
+  p = patch;
+  p[4] = DELTA_VERSION + 1;
+  ok &= expectRejected("unsupported version", old, p, rng);
+  if (ops.size() > 1) {
+    p = patch;
+    p[ops[0]] = 0x7F;
+    ok &= expectRejected("bad opcode", old, p, rng);
+  }
+  for (size_t at : ops) {
+    if (patch[at] != DELTA_OP_COPY) continue;
+    p = patch;
+    put32(p, at + 1, (uint32_t)old.size() - 8);  // 8 bytes in, length beyond
+    ok &= expectRejected("copy outside the source", old, p, rng);
+    break;
+  }
+  for (size_t at : ops) {
+    if (patch[at] != DELTA_OP_INSERT) continue;
+    p = patch;
+    p[at + 5] ^= 0x01;
+    ok &= expectRejected("literal byte changed", old, p, rng);
+    break;
+  }
+  p = patch;
+  p.push_back(0);
+  ok &= expectRejected("data after END", old, p, rng);
+  Bytes other = old;
+  other[other.size() / 2] ^= 0x01;
+  ok &= expectRejected("another source image", other, patch, rng);
+
+  // Random single-byte corruption must never yield a wrong image. The
+  // reserved header bytes are not checked, so those still apply correctly.
+  uint32_t rejected = 0, correct = 0, wrong = 0;
+  for (int i = 0; i < FUZZ_RUNS; i++) {
+    p = patch;
+    size_t at = rng() % p.size();
+    p[at] ^= (uint8_t)(1 + rng() % 255);
+    Bytes out;
+    if (apply(old, p, &out, 1460, rng)) {
+      rejected++;
+    } else if (out == updated) {
+      correct++;
+    } else {
+      wrong++;
+    }
+  }
+  printf("  %-34s %u rejected, %u still correct, %u wrong%s\n",
+         "random byte corrupted", rejected, correct, wrong,
+         wrong ? "  FAIL" : "");
+  ok &= wrong == 0;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::mt19937 rng(78);
+  bool ok = true;
+
+  if (argc == 4) {
+    Bytes old, updated, patch;
+    if (!readFile(argv[1], old) || !readFile(argv[2], updated) ||
+        !readFile(argv[3], patch)) {
+      printf("Cannot read the images or the patch\n");
+      return 1;
+    }
+    ok = testPatch(argv[3], old, updated, patch, rng);
+  } else {
+    printf("Synthetic images, patches made by ota_delta.py\n");
+    const int edits[] = {0, 10, 100, 1000};
+    for (int e : edits) {
+      Bytes old, updated, patch;
+      syntheticPair(rng, 512 * 1024, e, old, updated);
+      if (!writeFile("/tmp/delta_bench_old.bin", old) ||
+          !writeFile("/tmp/delta_bench_new.bin", updated) ||
+          !makePatch("/tmp/delta_bench_old.bin", "/tmp/delta_bench_new.bin",
+                     "/tmp/delta_bench.sadl") ||
+          !readFile("/tmp/delta_bench.sadl", patch)) {
+        printf("ota_delta.py make failed\n");
+        return 1;
+      }
+      char label[32];
+      snprintf(label, sizeof(label), "%d edits", e);
+      ok &= testPatch(label, old, updated, patch, rng);
+    }
+  }
+
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
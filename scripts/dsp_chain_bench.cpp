@@ -0,0 +1,285 @@
+// Host benchmark of the gateway's output DSP chain
+// (include/gateway_esp32/dsp_chain.h): gain, speaker high-pass, EQ and
+// look-ahead limiter between the resampler and the PCM ring.
+//
+// Checks:
+//   - the portable biquad kernel is bit-identical to esp-dsp's ANSI
+//     dsps_biquad_f32 (copied below) over a second of noise
+//   - high-pass and EQ magnitude at a few frequencies against the design
+//   - a bass-heavy alarm at 0 dBFS with +12 dB of track gain and a bass
+//     boost: nothing leaves the limiter above its ceiling, and the limiter
+//     delay is exactly DSP_LOOKAHEAD_FRAMES
+// and reports TSC cycles per frame of each stage (the counter the device
+// reads with ESP.getCycleCount() behind the "dsp" command) against the
+// 5.4 k cycles per frame a 240 MHz core has at 44.1 kHz.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/dsp_chain_bench
+//       scripts/dsp_chain_bench.cpp src/gateway_esp32/dsp_chain.cpp
+//   /tmp/dsp_chain_bench
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "include/gateway_esp32/dsp_chain.h"
+
+#define RATE 44100
+#define ESP32_CYCLES_PER_FRAME (240e6 / RATE)
+#define RESPONSE_TOLERANCE_DB 0.1
+
+#ifdef HAVE_TSC
+static uint32_t tsc() { return (uint32_t)__rdtsc(); }
+#else
+static uint32_t tsc() { return 0; }
+#endif
+
+// ============================================================================
+// REFERENCE KERNEL - esp-dsp dsps_biquad_f32_ansi()
+// ============================================================================
+__attribute__((optimize("fp-contract=off"))) static void espDspAnsi(
+    const float* input, float* output, int len, const float* coef, float* w) {
+  for (int i = 0; i < len; i++) {
+    float d0 = input[i] - coef[3] * w[0] - coef[4] * w[1];
+    output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+    w[1] = w[0];
+    w[0] = d0;
+  }
+}
+
+static bool bitExact() {
+  std::mt19937 rng(92);
+  std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+  std::vector<float> in(RATE), a(RATE), b(RATE);
+  for (float& x : in) x = u(rng);
+  // A high-Q low-frequency section: the most rounding-sensitive kind
+  const float coef[5] = {1.0007f, -1.9968f, 0.9961f, -1.9968f, 0.9968f};
+  float wa[2] = {0, 0}, wb[2] = {0, 0};
+  for (int at = 0; at < RATE; at += DSP_BLOCK_FRAMES) {
+    int n = RATE - at < DSP_BLOCK_FRAMES ? RATE - at : DSP_BLOCK_FRAMES;
+    espDspAnsi(&in[at], &a[at], n, coef, wa);
+    dspBiquad(&in[at], &b[at], n, coef, wb);
+  }
+  bool same = memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+  printf("Kernel vs esp-dsp ANSI: %s\n", same ? "bit-identical" : "DIFFERS");
+  return same;
+}
+
+// ============================================================================
+// RUNNING THE CHAIN
+// ============================================================================
+// Stereo in, stereo out including the limiter tail, in decoder-sized blocks
+static std::vector<int16_t> run(DspChain& dsp, const std::vector<int16_t>& in) {
+  std::vector<int16_t> out;
+  out.reserve(in.size() + 2 * DSP_LOOKAHEAD_FRAMES);
+  int16_t block[2 * DSP_MAX_FRAMES];
+  size_t frames = in.size() / 2;
+  for (size_t at = 0; at < frames; at += DSP_BLOCK_FRAMES) {
+    uint32_t n = (uint32_t)std::min<size_t>(DSP_BLOCK_FRAMES, frames - at);
+    memcpy(block, &in[2 * at], n * 2 * sizeof(int16_t));
+    dsp.process(block, n);
+    out.insert(out.end(), block, block + 2 * n);
+  }
+  uint32_t n = dsp.tail(block);
+  out.insert(out.end(), block, block + 2 * n);
+  return out;
+}
+
+static std::vector<int16_t> sine(double hz, double dbfs, double seconds) {
+  std::vector<int16_t> pcm;
+  double amp = pow(10.0, dbfs / 20.0) * 32767.0;
+  for (size_t i = 0; i < (size_t)(RATE * seconds); i++) {
+    int16_t v = (int16_t)lrint(amp * sin(2 * M_PI * hz * i / RATE));
+    pcm.push_back(v);
+    pcm.push_back(v);
+  }
+  return pcm;
+}
+
+static double rms(const std::vector<int16_t>& pcm, size_t from, size_t to) {
+  double sum = 0;
+  for (size_t i = from; i < to; i++) sum += (double)pcm[2 * i] * pcm[2 * i];
+  return sqrt(sum / (to - from));
+}
+
+// Steady-state gain at hz in dB, limiter out of the way (-20 dBFS in)
+static double response(DspChain& dsp, double hz) {
+  dsp.reset();
+  std::vector<int16_t> in = sine(hz, -20.0, 1.0);
+  std::vector<int16_t> out = run(dsp, in);
+  size_t from = RATE / 2, to = RATE;  // After the filters have settled
+  return 20.0 * log10(rms(out, from + DSP_LOOKAHEAD_FRAMES,
+                          to + DSP_LOOKAHEAD_FRAMES) /
+                      rms(in, from, to));
+}
+
+// Second-order Butterworth high-pass magnitude, the expected values
+static double expectHighPass(double hz, double fc) {
+  double r = hz / fc;
+  return -10.0 * log10(1.0 + 1.0 / (r * r * r * r));
+}
+
+static bool checkResponse() {
+  struct Case {
+    const char* what;
+    double hz, expect;
+    double tolerance;
+  };
+  DspChain dsp;
+  dsp.setLimiter(0);
+  dsp.setHighPass(120);
+  // Bilinear warping is negligible this far below Nyquist
+  const Case hpf[] = {{"HPF 120 Hz", 40, expectHighPass(40, 120), 0.1},
+                      {"HPF 120 Hz", 120, -3.01, 0.05},
+                      {"HPF 120 Hz", 1000, expectHighPass(1000, 120), 0.05}};
+  bool ok = true;
+  for (const Case& c : hpf) {
+    double got = response(dsp, c.hz);
+    bool pass = fabs(got - c.expect) <= c.tolerance;
+    printf("  %-22s %6.0f Hz  %+7.2f dB (expect %+7.2f) %s\n", c.what, c.hz,
+           got, c.expect, pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+
+  dsp.setHighPass(0);
+  dsp.setBand(0, DSP_BAND_PEAK, 1000, 6.0f, 1.0f);
+  dsp.setBand(1, DSP_BAND_LOW_SHELF, 200, -4.0f, 0.707f);
+  dsp.setBand(2, DSP_BAND_HIGH_SHELF, 8000, 3.0f, 0.707f);
+  // Each band at its own frequency, the others far enough away to be flat
+  const Case eq[] = {{"peak +6 dB", 1000, 6.0, RESPONSE_TOLERANCE_DB},
+                     {"low shelf -4 dB", 30, -4.0, RESPONSE_TOLERANCE_DB},
+                     {"high shelf +3 dB", 19000, 3.0, 0.25}};
+  for (const Case& c : eq) {
+    double got = response(dsp, c.hz);
+    bool pass = fabs(got - c.expect) <= c.tolerance;
+    printf("  %-22s %6.0f Hz  %+7.2f dB (expect %+7.2f) %s\n", c.what, c.hz,
+           got, c.expect, pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+  return ok;
+}
+
+// ============================================================================
+// LIMITER
+// ============================================================================
+// Alarm-like: 80 Hz + 160 Hz bass pulse and a 2 kHz beep, bursts at 0 dBFS
+static std::vector<int16_t> alarm(double seconds) {
+  std::vector<int16_t> pcm;
+  for (size_t i = 0; i < (size_t)(RATE * seconds); i++) {
+    double t = (double)i / RATE;
+    bool on = fmod(t, 0.5) < 0.3;
+    double v = on ? 0.5 * sin(2 * M_PI * 80 * t) +
+                        0.25 * sin(2 * M_PI * 160 * t) +
+                        0.25 * sin(2 * M_PI * 2000 * t)
+                  : 0.0;
+    int16_t s = (int16_t)lrint(v * 32767.0);
+    pcm.push_back(s);
+    pcm.push_back(s);
+  }
+  return pcm;
+}
+
+static bool checkLimiter() {
+  const float ceilingDb = DSP_DEFAULT_LIMIT_DBFS;
+  const double ceiling = pow(10.0, ceilingDb / 20.0) * 32768.0;
+  std::vector<int16_t> in = alarm(5.0);
+
+  bool ok = true;
+  for (int limited = 0; limited < 2; limited++) {
+    DspChain dsp;
+    dsp.setGain(4.0f);  // +12 dB, the most loudness normalization applies
+    dsp.setBand(0, DSP_BAND_LOW_SHELF, 250, 4.0f, 0.707f);
+    dsp.setLimiter(limited ? ceilingDb : 0.0f);
+    std::vector<int16_t> out = run(dsp, in);
+
+    if (!limited) {
+      // Reduced at a 0 dBFS ceiling = would have clipped without a limiter
+      printf("  without limiter: %u of %llu frames would clip\n",
+             (unsigned)dsp.limited(), (unsigned long long)dsp.frames());
+      continue;
+    }
+    int peak = 0;
+    size_t over = 0;
+    for (int16_t s : out) {
+      peak = std::max(peak, abs((int)s));
+      if (abs((int)s) > ceiling + 1) over++;  // Rounding may add an LSB
+    }
+    printf("  ceiling %+.1f dBFS: peak %+.2f dBFS, %zu samples over, "
+           "%u frames reduced (max %.1f dB)\n",
+           ceilingDb, 20.0 * log10(peak / 32768.0), over,
+           (unsigned)dsp.limited(), -20.0 * log10(dsp.minLimiterGain()));
+    ok &= over == 0;
+  }
+
+  // A lone impulse comes out DSP_LOOKAHEAD_FRAMES later, unchanged
+  DspChain dsp;
+  dsp.setHighPass(0);
+  std::vector<int16_t> pulse(2 * 1000, 0);
+  pulse[2 * 100] = pulse[2 * 100 + 1] = 1000;
+  std::vector<int16_t> out = run(dsp, pulse);
+  size_t at = 0;
+  for (size_t i = 0; i < out.size() / 2; i++) {
+    if (out[2 * i]) at = i;
+  }
+  bool aligned = at == 100 + DSP_LOOKAHEAD_FRAMES && out[2 * at] == 1000 &&
+                 out.size() / 2 == 1000 + DSP_LOOKAHEAD_FRAMES;
+  printf("  impulse delay %zu frames (expect %d), %s\n", at - 100,
+         DSP_LOOKAHEAD_FRAMES, aligned ? "ok" : "FAIL");
+  return ok && aligned;
+}
+
+// ============================================================================
+// CPU PER STAGE
+// ============================================================================
+static void cost() {
+  std::mt19937 rng(44);
+  std::uniform_int_distribution<int> u(-12000, 12000);
+  std::vector<int16_t> in(2 * RATE * 30);  // 30 s
+  for (int16_t& s : in) s = (int16_t)u(rng);
+
+  DspChain dsp(tsc);
+  dsp.setGain(2.0f);
+  dsp.setHighPass(120);
+  dsp.setBand(0, DSP_BAND_LOW_SHELF, 250, -3.0f, 0.707f);
+  dsp.setBand(1, DSP_BAND_PEAK, 1000, 2.0f, 1.0f);
+  dsp.setBand(2, DSP_BAND_PEAK, 3000, 3.0f, 1.4f);
+  dsp.setBand(3, DSP_BAND_HIGH_SHELF, 8000, -2.0f, 0.707f);
+  run(dsp, in);
+
+  static const char* names[DSP_STAGE_COUNT] = {"gain + convert", "high-pass",
+                                               "EQ (4 bands)", "limiter"};
+  double total = 0;
+  printf("\nCycles per stereo frame (host TSC, 64-frame blocks):\n");
+  for (int s = 0; s < DSP_STAGE_COUNT; s++) {
+    double c = (double)dsp.stageCycles(s) / dsp.frames();
+    total += c;
+    printf("  %-15s %7.1f\n", names[s], c);
+  }
+  printf("  %-15s %7.1f  (%.2f%% of the %.0f a 240 MHz core has per frame)\n",
+         "total", total, 100.0 * total / ESP32_CYCLES_PER_FRAME,
+         ESP32_CYCLES_PER_FRAME);
+
+  char json[320];
+  if (dsp.toJson(json, sizeof(json), 240000000)) printf("\n%s\n", json);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+int main() {
+  bool ok = bitExact();
+  printf("\nFrequency response:\n");
+  ok &= checkResponse();
+  printf("\nLimiter:\n");
+  ok &= checkLimiter();
+  cost();
+  printf("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
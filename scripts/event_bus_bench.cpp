@@ -0,0 +1,140 @@
+// Host benchmark for the gateway's event bus
+// (include/gateway_esp32/event_bus.h).
+//
+// Two producer threads publish sensor and audio events while 1-8 subscriber
+// threads poll the bus. Reports delivered throughput, publish-to-receive
+// latency and events lost by subscribers that fell behind, first with the
+// producers running flat out and then paced at 10k events/s each. Results
+// depend heavily on the number of host cores (printed first).
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -pthread -I. -o /tmp/event_bench
+//       scripts/event_bus_bench.cpp src/gateway_esp32/event_bus.cpp
+//   /tmp/event_bench [events_per_producer]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "include/gateway_esp32/event_bus.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+struct Result {
+  double seconds;
+  uint64_t published;
+  uint64_t delivered;
+  uint64_t dropped;
+  std::vector<int64_t> latencies;
+};
+
+static Result runOnce(int subscribers, int perProducer, int paceUs) {
+  const int producers = 2;
+  EventBus* bus = new EventBus();
+  // Publish time per (producer, index), carried in the sample itself
+  std::vector<std::vector<int64_t>> times(producers,
+                                          std::vector<int64_t>(perProducer));
+
+  std::vector<int> ids;
+  for (int i = 0; i < subscribers; i++) {
+    ids.push_back(bus->subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE) |
+                                 EVENT_MASK(EVENT_AUDIO_STATE)));
+  }
+
+  std::atomic<bool> done(false);
+  std::vector<uint64_t> delivered(subscribers, 0);
+  std::vector<std::vector<int64_t>> latencies(subscribers);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < subscribers; i++) {
+    threads.emplace_back([&, i]() {
+      Event e;
+      latencies[i].reserve(2 * perProducer);
+      for (;;) {
+        if (bus->poll(ids[i], e)) {
+          if (const SensorSampleEvent* s = e.as<SensorSampleEvent>()) {
+            int64_t t = times[s->data.sensorId][s->data.timestamp];
+            latencies[i].push_back(nowNs() - t);
+          }
+          delivered[i]++;
+        } else if (done.load()) {
+          if (!bus->poll(ids[i], e)) break;
+          delivered[i]++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  auto start = Clock::now();
+  std::vector<std::thread> writers;
+  for (int p = 0; p < producers; p++) {
+    writers.emplace_back([&, p]() {
+      SensorSampleEvent sample = {};
+      AudioStateEvent audio = {AUDIO_STATE_PLAYING, 0.5f};
+      sample.data.sensorId = p;
+      for (int n = 0; n < perProducer; n++) {
+        if (paceUs) {
+          std::this_thread::sleep_for(std::chrono::microseconds(paceUs));
+        }
+        sample.data.timestamp = n;
+        times[p][n] = nowNs();
+        bus->publish(sample);
+        if (p == 1 && n % 16 == 0) bus->publish(audio);
+      }
+    });
+  }
+  for (auto& t : writers) t.join();
+  done = true;
+  for (auto& t : threads) t.join();
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  Result r = {seconds, bus->published(), 0, 0, {}};
+  for (int i = 0; i < subscribers; i++) {
+    r.delivered += delivered[i];
+    r.dropped += bus->dropped(ids[i]);
+    r.latencies.insert(r.latencies.end(), latencies[i].begin(),
+                       latencies[i].end());
+  }
+  delete bus;
+  return r;
+}
+
+static void report(const char* mode, int subscribers, const Result& r) {
+  std::vector<int64_t> l = r.latencies;
+  std::sort(l.begin(), l.end());
+  int64_t p50 = l.empty() ? 0 : l[l.size() / 2];
+  int64_t p99 = l.empty() ? 0 : l[l.size() * 99 / 100];
+  printf("%-8s %4d %10.2f %10.2f %10.2f %10lld %10lld\n", mode, subscribers,
+         r.published / r.seconds / 1e6, r.delivered / r.seconds / 1e6,
+         100.0 * r.dropped / std::max<uint64_t>(r.delivered + r.dropped, 1),
+         (long long)p50, (long long)p99);
+}
+
+int main(int argc, char** argv) {
+  int perProducer = argc > 1 ? atoi(argv[1]) : 200000;
+  printf("Event size %zu bytes, ring %d slots (%zu bytes), %u hw threads\n\n",
+         sizeof(Event), EVENT_BUS_CAPACITY, sizeof(EventBus),
+         std::thread::hardware_concurrency());
+  printf("%-8s %4s %10s %10s %10s %10s %10s\n", "mode", "subs", "pub Mev/s",
+         "rx Mev/s", "lost %", "p50 ns", "p99 ns");
+  for (int subs : {1, 2, 4, 8}) {
+    report("flat", subs, runOnce(subs, perProducer, 0));
+  }
+  for (int subs : {1, 2, 4, 8}) {
+    report("paced", subs, runOnce(subs, perProducer / 100, 100));
+  }
+  return 0;
+}
@@ -0,0 +1,2154 @@
+// Host simulation of the whole gateway in deterministic virtual time.
+//
+// The tasks of rtos_tasks.cpp (AudioOutput, AudioDecode, AudioJobs,
+// Sensors, Display, MQTT), the rule task, Arduino's loop() and the WiFi
+// task that runs the ESP-NOW receive callback are scheduled on two virtual
+// cores with the firmware's pinning, priorities and release grids
+// (task_config.h): fixed-priority preemption, 1 ms round-robin between
+// equal priorities, vTaskDelayUntil catch-up, and mutexes with priority
+// inheritance. An iteration is a sequence of steps with modeled costs (CPU
+// time, blocking waits, audioMutex, the SD volume lock, the I2C bus lock,
+// the MQTT client), and the portable gateway code runs for real inside
+// them: DeadlineMonitor on the virtual clock with the other core's task as
+// context, PcmRing, LatencyGovernor, BufferPool, EventBus, SensorAnalytics,
+// RuleEngine and MeshDedupCache. The Arduino-bound managers are modeled by
+// what they do to the schedule: which locks they take, what they wait for,
+// what they cost.
+//
+// Simulated peers, each drawing from its own random stream:
+//   ESP-NOW - three sensor nodes every 5 s, one behind a relay, with lost
+//             frames and relayed duplicates
+//   network - an MQTT broker with outages and a 15 s keepalive, socket
+//             writes that now and then stall behind WiFi retries, a
+//             dashboard polling the status topics, play and download
+//             commands, and an HTTP server with varying throughput
+//   SD card - 4 MHz SPI transfers polled by the CPU, busy time after
+//             writes, flushes and closes with a long tail, and the driver's
+//             500 ms select timeout ("Select Failed")
+//   I2C     - OLED frames and BH1750 reads sharing one bus, with NACKs and
+//             rare stuck-bus timeouts
+//
+// The MQTT client has no lock on the device, so only the MQTT task uses it
+// and the other tasks' publishes wait in MQTTManager's outbox; downloads
+// run in AudioJobs. The sim records every time a task enters the client
+// while another task is inside, every broker keepalive expiry, every Select
+// Failed with the task and what left the card busy, and every AudioDecode
+// iteration held up beyond its own SD reads, with what it waited for.
+// Metric topics are published through the real toJson() of each module, so
+// they read exactly like the device's; -v prints every publish with its
+// virtual time. Everything follows from the seed: the same build and seed
+// give the same trace digest.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/gateway_sim scripts/gateway_sim.cpp
+//       src/gateway_esp32/deadline_monitor.cpp src/gateway_esp32/pcm_ring.cpp
+//       src/gateway_esp32/latency_profile.cpp src/gateway_esp32/buffer_pool.cpp
+//       src/gateway_esp32/event_bus.cpp src/gateway_esp32/sensor_analytics.cpp
+//       src/gateway_esp32/rule_engine.cpp
+//   /tmp/gateway_sim [seed] [hours] [-v]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "include/gateway_esp32/buffer_pool.h"
+#include "include/gateway_esp32/deadline_monitor.h"
+#include "include/gateway_esp32/event_bus.h"
+#include "include/gateway_esp32/latency_profile.h"
+#include "include/gateway_esp32/pcm_ring.h"
+#include "include/gateway_esp32/rule_engine.h"
+#include "include/gateway_esp32/sensor_analytics.h"
+#include "include/gateway_esp32/task_config.h"
+#include "include/shared/espnow_mesh.h"
+#include "include/shared/mqtt_topic_config.h"
+
+// ============================================================================
+// Modeled costs (estimates, not measurements; see scripts/README.md)
+// ============================================================================
+#define TICK_US 1000  // configTICK_RATE_HZ 1000
+#define RATE_HZ 44100
+
+#define OUTPUT_IDLE_US 12     // pumpOutput() with the ring empty
+#define OUTPUT_PASS_US 40     // ...plus per frame into the DMA
+#define OUTPUT_FRAME_NS 60
+#define DECODE_PASS_US 30     // audio.loop() without a burst
+#define MP3_FRAME_SAMPLES 1152
+#define MP3_FRAME_BYTES 418   // 128 kbit/s at 44.1 kHz
+#define MP3_DECODE_US 2800    // One frame, +-15%
+#define PLAY_SETUP_US 3000    // Decoder and output chain set up
+#define MQTT_LOOP_US 80       // client->loop() with nothing to read
+#define MQTT_DISPATCH_US 150  // Topic match and handler lookup
+#define PUBLISH_US 60         // ...plus a byte per PUBLISH_BYTES_PER_US
+#define PUBLISH_BYTES_PER_US 8
+#define ESPNOW_RX_US 400      // Receive callback including its logging
+#define RULE_EVAL_US 30
+#define DISPLAY_DRAW_US 3000
+#define SENSOR_PASS_US 40
+#define NOISE_POLL_US 1200    // Polls while a window is measured
+#define NOISE_MEASURE_MS 356  // Settle plus the 256 ms window
+#define LOOP_US 60            // maintainWiFi() and the beacon ticks
+#define LOOP_PERIOD_MS 100
+
+// SD card on SPI; transfers and busy-waiting spin on the CPU
+#define SD_SPI_HZ 4000000  // SDManager mounts at 4 MHz
+#define SD_CMD_US 150
+#define SD_SELECT_TIMEOUT_US 500000  // The driver gives up: Select Failed
+#define SD_COOLDOWN_MS 500           // SDManager::closeFile()
+#define SD_FLUSH_BYTES 32768         // SDManager auto-flush
+
+// I2C, interrupt driven: the task sleeps while bytes move
+#define I2C_HZ 400000
+#define I2C_CHUNK 32  // Wire buffer; the OLED frame goes in chunks
+#define I2C_TIMEOUT_US 50000
+#define OLED_FRAME_BYTES 1024
+#define I2C_NACK_CHANCE 0.0005
+#define I2C_STUCK_CHANCE 0.00001
+
+// Network
+#define MQTT_KEEPALIVE_MS 15000  // PubSubClient default
+#define MQTT_RECONNECT_MS 5000   // MQTTManager::loop()
+#define TCP_CONNECT_TIMEOUT_MS 3000
+#define HTTP_TIMEOUT_MS 10000    // downloadFile()
+#define NODE_COUNT 3
+#define NODE_SEND_MS 5000        // SENSOR_READ_INTERVAL of the node firmware
+#define MONITOR_POLL_MS 300000   // Dashboard asking for the status topics
+
+#define DOWNLOAD_BLOCK BUFFER_POOL_BLOCK_SIZE
+#define RESUME_SAVE_MS 10000     // RESUME_SAVE_INTERVAL_MS
+#define RULE_QUEUE_LEN 16        // RULE_QUEUE_LENGTH
+#define OUTBOX_SLOTS 3           // MQTT_OUTBOX_SLOTS
+#define OUTBOX_TOPIC 64          // MQTT_OUTBOX_TOPIC_SIZE
+#define OUTBOX_PAYLOAD 256       // MQTT_OUTBOX_PAYLOAD_SIZE
+#define OUTBOX_SEND_US 20        // Copy and xQueueSend()
+#define RULE_TICK_MS 1000
+#define RULE_FADE_STEP_MS 250
+
+// Pass criteria: regression limits around the current tree, not targets
+#define MAX_GAPS_PER_HOUR 15.0  // Output ran dry while a track played
+#define MAX_FIRST_AUDIO_MS 400  // p99 command (or rule) to first audio
+#define MAX_COMMAND_MS 1500     // p99 broker to handler
+#define MIN_DOWNLOAD_KBS 60     // Mean over successful downloads
+#define MAX_DECODE_STALLS_PER_HOUR 80.0  // AudioDecode waiting for others
+
+static const int64_t NEVER = INT64_MAX;
+static int64_t now = 0;  // Virtual time, us since midnight of day one
+
+// ============================================================================
+// Randomness: one stream per peer, so a change in one model does not
+// reshuffle the others
+// ============================================================================
+struct Rng {
+  uint64_t s;
+  void seed(uint64_t seed, uint64_t stream) {
+    s = seed * 0x9E3779B97F4A7C15ULL + stream * 0xD1B54A32D192ED03ULL;
+  }
+  uint64_t next() {  // splitmix64
+    uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+  bool chance(double p) { return uniform() < p; }
+  int64_t between(int64_t lo, int64_t hi) {
+    return lo + (int64_t)(uniform() * (double)(hi - lo));
+  }
+  int64_t exponential(double mean) {
+    return (int64_t)(-log(1.0 - uniform()) * mean);
+  }
+};
+
+static Rng rngCpu, rngSd, rngI2c, rngNet, rngNodes, rngUser;
+
+static const char* clockText(int64_t us) {
+  static char buf[4][24];
+  static int slot = 0;
+  char* b = buf[slot++ & 3];
+  int64_t ms = us / 1000;
+  int64_t day = ms / 86400000;
+  ms %= 86400000;
+  int n = 0;
+  if (day > 0) n = snprintf(b, 24, "d%d ", (int)day + 1);
+  snprintf(b + n, 24 - n, "%02d:%02d:%02d.%03d", (int)(ms / 3600000),
+           (int)(ms / 60000 % 60), (int)(ms / 1000 % 60), (int)(ms % 1000));
+  return b;
+}
+
+// Varies a modeled cost by +-spread
+static int64_t jitter(int64_t us, double spread) {
+  return (int64_t)(us * (1.0 + spread * (2.0 * rngCpu.uniform() - 1.0)));
+}
+
+// ============================================================================
+// Scheduler
+// ============================================================================
+struct Task;
+typedef void (*StepFn)(Task& t, int32_t arg);
+typedef size_t (*PayloadFn)(char* buf, size_t len);
+
+enum StepKind : uint8_t {
+  STEP_CPU,      // Run for us
+  STEP_SLEEP,    // Blocked for us (delay(), network, interrupt-driven I/O)
+  STEP_LOCK,     // Take mutex, giving up after us (-1: forever); sets ok
+  STEP_UNLOCK,
+  STEP_WAIT,     // Wait for a notification (queue), at most us
+  STEP_CALL,     // fn(task, arg) at this point; it may insert steps
+  STEP_PUBLISH,  // mqtt.publish(topic, text or payload())
+  STEP_ENTER,    // Start using the MQTT client (text: what for)
+  STEP_LEAVE,
+  STEP_CONTEXT,  // deadlineMonitor.setContext(text)
+};
+
+struct Mutex {
+  const char* name;
+  Task* owner;
+  int depth;
+};
+
+struct Step {
+  StepKind kind;
+  int64_t us;
+  int32_t arg;
+  Mutex* mutex;
+  StepFn fn;
+  const char* topic;
+  const char* text;
+  PayloadFn payload;
+};
+
+enum TaskState : uint8_t {
+  TASK_READY,
+  TASK_DELAYED,  // Until wakeUs
+  TASK_BLOCKED,  // On a mutex, until wakeUs at most
+  TASK_WAITING,  // For notify(), until wakeUs at most
+};
+
+struct Task {
+  const char* name;
+  int core;
+  int prio;
+  int64_t periodUs;        // Release grid; 0 for event-driven tasks
+  void (*plan)(Task& t);   // Queues the steps of one iteration
+  int deadline;            // DeadlineMonitor id, -1 when not monitored
+
+  std::vector<Step> steps;
+  size_t pc;
+  bool needPlan;
+  TaskState state;
+  int64_t wakeUs;
+  int64_t releaseUs;
+  int64_t left;  // Of the current CPU step
+  Mutex* blockedOn;
+  bool ok;       // Result of the last lock or I/O
+  bool notified;
+  uint64_t rr;   // Round-robin order among equal priorities
+  int64_t cpuUs;
+  const char* doing;  // Shown in contention reports
+  char scratch[512];
+};
+
+static Task* tasks[10];
+static int taskCount = 0;
+static Task* running[2];
+static uint64_t rrCounter = 0;
+static int blockedCount = 0;
+
+// Steps are inserted at the task's program counter, so a CALL expands in
+// place like the function it stands for
+struct Plan {
+  Task& t;
+  size_t at;
+  explicit Plan(Task& task) : t(task), at(task.pc) {}
+  Plan& add(StepKind kind, int64_t us = 0, int32_t arg = 0,
+            Mutex* m = nullptr, StepFn fn = nullptr,
+            const char* topic = nullptr, const char* text = nullptr,
+            PayloadFn payload = nullptr) {
+    Step s = {kind, us, arg, m, fn, topic, text, payload};
+    t.steps.insert(t.steps.begin() + at++, s);
+    return *this;
+  }
+  Plan& cpu(int64_t us) { return add(STEP_CPU, us); }
+  Plan& sleep(int64_t us) { return add(STEP_SLEEP, us); }
+  Plan& lock(Mutex& m, int64_t timeoutUs = -1) {
+    return add(STEP_LOCK, timeoutUs, 0, &m);
+  }
+  Plan& unlock(Mutex& m) { return add(STEP_UNLOCK, 0, 0, &m); }
+  Plan& wait(int64_t us) { return add(STEP_WAIT, us); }
+  Plan& call(StepFn fn, int32_t arg = 0) {
+    return add(STEP_CALL, 0, arg, nullptr, fn);
+  }
+  Plan& publish(const char* topic, const char* text) {
+    return add(STEP_PUBLISH, 0, 0, nullptr, nullptr, topic, text);
+  }
+  Plan& publish(const char* topic, PayloadFn payload) {
+    return add(STEP_PUBLISH, 0, 0, nullptr, nullptr, topic, nullptr, payload);
+  }
+  Plan& enter(const char* what) {
+    return add(STEP_ENTER, 0, 0, nullptr, nullptr, nullptr, what);
+  }
+  Plan& leave() { return add(STEP_LEAVE); }
+  Plan& context(const char* what) {
+    return add(STEP_CONTEXT, 0, 0, nullptr, nullptr, nullptr, what);
+  }
+};
+
+static void addTask(Task& t, const char* name, int core, int prio,
+                    int64_t periodUs, void (*plan)(Task&)) {
+  t.name = name;
+  t.core = core;
+  t.prio = prio;
+  t.periodUs = periodUs;
+  t.plan = plan;
+  t.deadline = -1;
+  t.pc = 0;
+  t.needPlan = true;
+  t.state = TASK_READY;
+  t.wakeUs = NEVER;
+  t.releaseUs = 0;
+  t.left = 0;
+  t.blockedOn = nullptr;
+  t.ok = true;
+  t.notified = false;
+  t.rr = ++rrCounter;
+  t.cpuUs = 0;
+  t.doing = "";
+  tasks[taskCount++] = &t;
+}
+
+static void makeReady(Task& t) {
+  if (t.state == TASK_BLOCKED) blockedCount--;
+  t.state = TASK_READY;
+  t.wakeUs = NEVER;
+  t.rr = ++rrCounter;  // Behind the running task of the same priority
+}
+
+static void notify(Task& t) {
+  t.notified = true;
+  if (t.state == TASK_WAITING) makeReady(t);
+}
+
+// Priority inheritance: a mutex owner runs at its highest waiter's priority
+static int effectivePrio(const Task* t) {
+  int p = t->prio;
+  if (blockedCount == 0) return p;
+  for (int i = 0; i < taskCount; i++) {
+    const Task* w = tasks[i];
+    if (w->state == TASK_BLOCKED && w->blockedOn->owner == t) {
+      p = std::max(p, effectivePrio(w));
+    }
+  }
+  return p;
+}
+
+static Task* pick(int core) {
+  Task* best = nullptr;
+  int bestPrio = -1;
+  for (int i = 0; i < taskCount; i++) {
+    Task* t = tasks[i];
+    if (t->core != core || t->state != TASK_READY) continue;
+    int p = effectivePrio(t);
+    if (p > bestPrio || (p == bestPrio && t->rr < best->rr)) {
+      best = t;
+      bestPrio = p;
+    }
+  }
+  return best;
+}
+
+static bool sharesSlice(const Task* r) {
+  int p = effectivePrio(r);
+  for (int i = 0; i < taskCount; i++) {
+    const Task* t = tasks[i];
+    if (t != r && t->core == r->core && t->state == TASK_READY &&
+        effectivePrio(t) == p) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void take(Mutex& m, Task& t) {
+  m.owner = &t;
+  m.depth = 1;
+}
+
+static void give(Mutex& m) {
+  if (--m.depth > 0) return;
+  m.owner = nullptr;
+  Task* next = nullptr;  // Highest priority waiter, longest waiting first
+  for (int i = 0; i < taskCount; i++) {
+    Task* w = tasks[i];
+    if (w->state == TASK_BLOCKED && w->blockedOn == &m &&
+        (!next || w->prio > next->prio ||
+         (w->prio == next->prio && w->rr < next->rr))) {
+      next = w;
+    }
+  }
+  if (next) {
+    take(m, *next);
+    next->ok = true;
+    makeReady(*next);
+  }
+}
+
+static void executeStep(Task& t, const Step& s);
+
+static void finishIteration(Task& t) {
+  t.steps.clear();
+  t.pc = 0;
+  t.needPlan = true;
+  if (t.periodUs == 0) return;  // Its last step already waited
+  // vTaskDelayUntil(): late releases run back to back
+  t.releaseUs += t.periodUs;
+  if (t.releaseUs > now) {
+    t.state = TASK_DELAYED;
+    t.wakeUs = t.releaseUs;
+  }
+}
+
+// One instantaneous step of the task running on its core
+static void stepTask(Task& t) {
+  if (t.needPlan) {
+    t.needPlan = false;
+    t.plan(t);
+    return;
+  }
+  if (t.pc >= t.steps.size()) {
+    finishIteration(t);
+    return;
+  }
+  Step s = t.steps[t.pc++];
+  executeStep(t, s);
+}
+
+// ============================================================================
+// Gateway state shared by the models
+// ============================================================================
+static uint32_t simClockUs() { return (uint32_t)now; }
+static void simContext(int self, char* buf, size_t len);
+
+static DeadlineMonitor deadlineMonitor(simClockUs, simContext);
+static PcmRing pcmRing;
+static LatencyGovernor latencyGovernor;
+static BufferPool bufferPool;
+static EventBus eventBus;
+static SensorAnalytics sensorAnalytics;
+static NodeAnalyticsTable remoteAnalytics;
+static RuleEngine ruleEngine;
+static MeshDedupCache meshDedup;
+
+static Mutex audioMutex = {"audioMutex", nullptr, 0};
+static Mutex sdLock = {"sd", nullptr, 0};
+static Mutex i2cLock = {"i2c", nullptr, 0};
+
+static Task outputTask, decodeTask, jobTask, sensorTask, displayTask,
+    mqttTask, ruleTask, loopTask, wifiTask;
+
+static void simContext(int self, char* buf, size_t len) {
+  int core = 0;
+  for (int i = 0; i < taskCount; i++) {
+    if (tasks[i]->deadline == self) core = tasks[i]->core;
+  }
+  int other = core ? 0 : 1;
+  snprintf(buf, len, "core%d:%s", other,
+           running[other] ? running[other]->name : "IDLE");
+}
+
+// ============================================================================
+// Findings and statistics
+// ============================================================================
+struct Samples {
+  std::vector<int64_t> v;
+  void add(int64_t x) { v.push_back(x); }
+  int64_t pct(double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[i];
+  }
+  int64_t max() {
+    return v.empty() ? 0 : *std::max_element(v.begin(), v.end());
+  }
+  size_t size() const { return v.size(); }
+};
+
+// A kind of finding, counted per distinct description, first time kept
+struct Finding {
+  char what[96];
+  uint32_t count;
+  int64_t firstUs;
+};
+
+struct Findings {
+  std::vector<Finding> list;
+  uint32_t total = 0;
+  void add(const char* what) {
+    total++;
+    for (Finding& f : list) {
+      if (strcmp(f.what, what) == 0) {
+        f.count++;
+        return;
+      }
+    }
+    Finding f;
+    snprintf(f.what, sizeof(f.what), "%s", what);
+    f.count = 1;
+    f.firstUs = now;
+    list.push_back(f);
+  }
+  void print(const char* indent) {
+    std::sort(list.begin(), list.end(), [](const Finding& a, const Finding& b) {
+      return a.count != b.count ? a.count > b.count : a.firstUs < b.firstUs;
+    });
+    for (const Finding& f : list) {
+      printf("%s%6u  %-60s first %s\n", indent, f.count, f.what,
+             clockText(f.firstUs));
+    }
+  }
+};
+
+static Findings clientOverlaps, selectFailures, i2cErrors, outputGaps;
+static Findings decodeStalls;
+static uint32_t decodeStallsByOthers = 0;
+
+// One AudioDecode iteration. Its own SD reads take longer than the budget
+// at 4 MHz, so only the time beyond them counts as a stall.
+struct DecodeIteration {
+  int64_t beginUs;
+  int64_t sdUs;        // Its own transfers
+  int64_t waitUs;      // Longest wait, for the card or audioMutex...
+  const char* holder;  // ...the task behind it...
+  char why[96];        // ...and what it waited for
+} decodeIter;
+static bool verbose = false;
+static uint64_t digest = 1469598103934665603ULL;  // FNV-1a of all publishes
+
+static void digestBytes(const void* p, size_t n) {
+  const uint8_t* b = (const uint8_t*)p;
+  for (size_t i = 0; i < n; i++) {
+    digest = (digest ^ b[i]) * 1099511628211ULL;
+  }
+}
+
+// ============================================================================
+// MQTT broker and client
+// ============================================================================
+enum CommandType : uint8_t { CMD_PLAY, CMD_DOWNLOAD, CMD_STATUS };
+
+struct Command {
+  CommandType type;
+  int32_t arg;  // Play: seconds; download: bytes; status: which topic
+  int64_t sentUs;
+};
+
+static const char* const STATUS_QUERIES[] = {"deadlines", "pcm", "buffers"};
+
+struct Broker {
+  bool networkUp = true;
+  bool connected = true;  // Client session
+  int64_t lastFromClientUs = 0;
+  int64_t lastReconnectUs = 0;
+  std::deque<Command> inbox;  // Arrived at the client's socket
+
+  uint32_t publishes = 0, publishFailed = 0, socketStalls = 0;
+  uint32_t keepaliveDrops = 0, outages = 0, reconnects = 0;
+  uint32_t reconnectFailures = 0, commandsLost = 0;
+  int64_t silentMaxUs = 0;
+  Samples commandUs;
+} broker;
+
+struct ClientUser {
+  Task* task;
+  const char* what;
+};
+static ClientUser clientUsers[4];
+static int clientUserCount = 0;
+
+static void clientEnter(Task& t, const char* what) {
+  for (int i = 0; i < clientUserCount; i++) {
+    if (clientUsers[i].task == &t) continue;
+    char line[96];
+    snprintf(line, sizeof(line), "%s/%s while %s/%s", t.name, what,
+             clientUsers[i].task->name, clientUsers[i].what);
+    clientOverlaps.add(line);
+  }
+  clientUsers[clientUserCount++] = {&t, what};
+}
+
+static void clientLeave(Task& t) {
+  for (int i = clientUserCount - 1; i >= 0; i--) {
+    if (clientUsers[i].task == &t) {
+      clientUsers[i] = clientUsers[--clientUserCount];
+      return;
+    }
+  }
+}
+
+static void brokerHeard() {
+  int64_t quiet = now - broker.lastFromClientUs;
+  if (quiet > broker.silentMaxUs) broker.silentMaxUs = quiet;
+  broker.lastFromClientUs = now;
+}
+
+// The broker drops a client it has not heard from for 1.5 keepalives
+static void brokerCheckKeepalive() {
+  if (broker.connected &&
+      now - broker.lastFromClientUs > MQTT_KEEPALIVE_MS * 1500LL) {
+    broker.connected = false;
+    broker.keepaliveDrops++;
+  }
+}
+
+static int64_t socketWriteUs() {
+  if (rngNet.chance(0.002)) {
+    broker.socketStalls++;
+    return rngNet.between(20000, 250000);  // WiFi retries, TCP window
+  }
+  return rngNet.between(100, 600);
+}
+
+static const char* lastMetric[6];
+static char lastMetricJson[6][1024];
+static const char* const METRIC_TOPICS[6] = {
+    MQTT_TOPIC_DEADLINES, "smartalarm/status/pcm", "smartalarm/status/buffers",
+    MQTT_TOPIC_REMOTE_ANALYTICS, "smartalarm/rules/fired", nullptr};
+
+static void recordPublish(const char* topic, const char* payload) {
+  digestBytes(&now, sizeof(now));
+  digestBytes(topic, strlen(topic));
+  digestBytes(payload, strlen(payload));
+  if (verbose) printf("%s %s %s\n", clockText(now), topic, payload);
+  for (int i = 0; METRIC_TOPICS[i]; i++) {
+    if (strcmp(topic, METRIC_TOPICS[i]) == 0) {
+      lastMetric[i] = METRIC_TOPICS[i];
+      snprintf(lastMetricJson[i], sizeof(lastMetricJson[i]), "%s", payload);
+    }
+  }
+}
+
+// MQTTManager's outbox: publishes from other tasks wait for the MQTT task
+struct OutboxMessage {
+  char topic[OUTBOX_TOPIC];
+  char payload[OUTBOX_PAYLOAD + 1];
+};
+
+struct Outbox {
+  std::deque<OutboxMessage> queue;
+  bool connected = false;  // connectedState, as of the last mqtt.loop()
+  OutboxMessage sending;
+  uint32_t queued = 0, dropped = 0, droppedConnected = 0;
+} outbox;
+
+static void outboxPost(Task& t, const Step& s) {
+  char buf[1024];
+  const char* payload = s.text;
+  if (!payload) {
+    if (s.payload(buf, sizeof(buf)) == 0) return;
+    payload = buf;
+  }
+  Plan(t).cpu(OUTBOX_SEND_US);
+  if (!outbox.connected || strlen(s.topic) >= OUTBOX_TOPIC ||
+      strlen(payload) > OUTBOX_PAYLOAD || outbox.queue.size() >= OUTBOX_SLOTS) {
+    outbox.dropped++;
+    if (outbox.connected) outbox.droppedConnected++;
+    return;
+  }
+  OutboxMessage m;
+  snprintf(m.topic, sizeof(m.topic), "%s", s.topic);
+  snprintf(m.payload, sizeof(m.payload), "%s", payload);
+  outbox.queue.push_back(m);
+  outbox.queued++;
+}
+
+static void doPublish(Task& t, const Step& s) {
+  if (&t != &mqttTask) {
+    outboxPost(t, s);
+    return;
+  }
+  brokerCheckKeepalive();
+  if (!broker.connected) {
+    broker.publishFailed++;
+    Plan(t).cpu(5);  // client->connected() is false
+    return;
+  }
+  char buf[1024];
+  const char* payload = s.text;
+  if (!payload) {
+    if (s.payload(buf, sizeof(buf)) == 0) return;
+    payload = buf;
+  }
+  recordPublish(s.topic, payload);
+  broker.publishes++;
+  brokerHeard();
+  size_t bytes = strlen(s.topic) + strlen(payload) + 5;
+  Plan(t)
+      .enter("publish")
+      .cpu(PUBLISH_US + (int64_t)bytes / PUBLISH_BYTES_PER_US)
+      .sleep(socketWriteUs())
+      .leave();
+}
+
+// ============================================================================
+// SD card
+// ============================================================================
+enum SdOp : uint8_t { SD_OPEN, SD_CREATE, SD_READ, SD_WRITE, SD_FLUSH,
+                      SD_CLOSE, SD_REMOVE };
+static const char* const SD_OP_NAMES[] = {"open", "create", "read", "write",
+                                          "flush", "close", "remove"};
+
+struct SdCard {
+  int64_t busyUntil = 0;
+  const char* busyTask = "";
+  SdOp busyOp = SD_READ;
+  uint64_t ops = 0, bytes = 0;
+  int64_t waitMaxUs = 0;
+  Task* waiter = nullptr;  // Last task that found the card busy...
+  int64_t waitEndUs = 0;   // ...until then
+  char waitWhy[96];
+} sd;
+
+static int64_t sdBusyAfter(SdOp op) {
+  switch (op) {
+    case SD_WRITE:
+      return rngSd.between(300, 1500);
+    case SD_FLUSH:  // FAT and directory entry
+      if (rngSd.chance(0.01)) return rngSd.between(100000, 400000);
+      return rngSd.between(2000, 15000);
+    case SD_CLOSE:
+      if (rngSd.chance(0.02)) return rngSd.between(150000, 800000);
+      return rngSd.between(5000, 40000);
+    case SD_CREATE:
+    case SD_REMOVE:
+      return rngSd.between(2000, 10000);
+    default:
+      return 0;
+  }
+}
+
+// The operation is in the low nibble of arg, the bytes above it
+static void sdBegin(Task& t, int32_t arg) {
+  SdOp op = (SdOp)(arg & 0xF);
+  int32_t bytes = arg >> 4;
+  int64_t wait = sd.busyUntil > now ? sd.busyUntil - now : 0;
+  if (wait > SD_SELECT_TIMEOUT_US) {
+    char line[96];
+    snprintf(line, sizeof(line), "%s %s, card busy after %s's %s", t.name,
+             SD_OP_NAMES[op], sd.busyTask, SD_OP_NAMES[sd.busyOp]);
+    selectFailures.add(line);
+    sd.waiter = &t;
+    sd.waitEndUs = now + SD_SELECT_TIMEOUT_US;
+    snprintf(sd.waitWhy, sizeof(sd.waitWhy), "%s Select Failed after %s's %s",
+             t.name, sd.busyTask, SD_OP_NAMES[sd.busyOp]);
+    t.ok = false;
+    Plan(t).cpu(SD_SELECT_TIMEOUT_US);
+    return;
+  }
+  if (wait > sd.waitMaxUs) sd.waitMaxUs = wait;
+  if (wait > 0) {
+    sd.waiter = &t;
+    sd.waitEndUs = now + wait;
+    snprintf(sd.waitWhy, sizeof(sd.waitWhy),
+             "%s waiting, card busy after %s's %s", t.name, sd.busyTask,
+             SD_OP_NAMES[sd.busyOp]);
+  }
+  int64_t sectors = (bytes + 511) / 512;
+  if (op == SD_OPEN || op == SD_CREATE || op == SD_REMOVE) sectors = 2;
+  if (op == SD_FLUSH || op == SD_CLOSE) sectors = 3;
+  int64_t transfer =
+      SD_CMD_US + sectors * (512 * 8 * 1000000LL / SD_SPI_HZ + 20);
+  sd.ops++;
+  sd.bytes += bytes;
+  if (&t == &decodeTask) {
+    decodeIter.sdUs += transfer;
+    if (wait > decodeIter.waitUs) {
+      decodeIter.waitUs = wait;
+      decodeIter.holder = sd.busyTask;
+      snprintf(decodeIter.why, sizeof(decodeIter.why),
+               "card busy after %s's %s", sd.busyTask, SD_OP_NAMES[sd.busyOp]);
+    }
+  }
+  t.ok = true;
+  Plan(t).cpu(wait + transfer).call(
+      [](Task& task, int32_t o) {
+        int64_t busy = sdBusyAfter((SdOp)o);
+        if (now + busy > sd.busyUntil) {
+          sd.busyUntil = now + busy;
+          sd.busyTask = task.name;
+          sd.busyOp = (SdOp)o;
+        }
+      },
+      op);
+}
+
+// One SD operation under the volume lock; ok tells how it went
+static Plan& sdOp(Plan& p, SdOp op, int32_t bytes = 0) {
+  return p.lock(sdLock).call(sdBegin, op | (bytes << 4)).unlock(sdLock);
+}
+
+// ============================================================================
+// I2C bus
+// ============================================================================
+enum I2cDevice : uint8_t { I2C_OLED, I2C_BH1750 };
+static const char* const I2C_NAMES[] = {"OLED", "BH1750"};
+static uint64_t i2cTransactions = 0;
+
+// One transaction of arg bytes; the device is in the upper byte
+static void i2cTransfer(Task& t, int32_t arg) {
+  int bytes = arg & 0xFFFF;
+  I2cDevice dev = (I2cDevice)(arg >> 16);
+  i2cTransactions++;
+  char line[96];
+  if (rngI2c.chance(I2C_STUCK_CHANCE)) {
+    snprintf(line, sizeof(line), "%s: bus stuck, timeout and recovery",
+             I2C_NAMES[dev]);
+    i2cErrors.add(line);
+    t.ok = false;
+    Plan(t).sleep(I2C_TIMEOUT_US);
+    return;
+  }
+  t.ok = !rngI2c.chance(I2C_NACK_CHANCE);
+  if (!t.ok) {
+    snprintf(line, sizeof(line), "%s: NACK", I2C_NAMES[dev]);
+    i2cErrors.add(line);
+  }
+  Plan(t).sleep(30 + (int64_t)(bytes + 1) * 9 * 1000000LL / I2C_HZ);
+}
+
+static Plan& i2cOp(Plan& p, I2cDevice dev, int bytes) {
+  return p.lock(i2cLock).call(i2cTransfer, (dev << 16) | bytes).unlock(i2cLock);
+}
+
+// ============================================================================
+// Audio: decode task, output task, playback commands
+// ============================================================================
+struct Audio {
+  bool playing = false;   // isPlaying
+  bool draining = false;
+  bool downloading = false;
+  int64_t trackFrames = 0, decodedFrames = 0;
+  int32_t inputBytes = 0;  // Decoder's unread input
+  bool awaitingFirst = false;
+  int64_t requestUs = 0;
+  int64_t lastResumeSaveUs = 0;
+  uint32_t dmaFrames = 8 * I2S_DMA_BUF_FRAMES;  // Capacity
+  double dmaLevel = 0;
+  int64_t dmaUs = 0;
+  bool audible = false;  // Track frames reached the DMA
+  bool dry = false;
+  float volume = 0.6f;
+
+  uint32_t plays = 0, playFailures = 0, finished = 0, cutShort = 0;
+  uint32_t gaps = 0;
+  double gapFrames = 0;
+  int64_t playingUs = 0;
+  Samples firstAudioUs;
+} audio;
+
+static void publishAudioState(AudioState state) {
+  AudioStateEvent e = {state, audio.volume};
+  eventBus.publish(e);
+}
+
+static size_t pcmJson(char* buf, size_t len) {
+  return pcmRing.toJson(buf, len, RATE_HZ);
+}
+
+static void applyLatencyProfile() {
+  const LatencyProfileSpec& spec = latencyProfileSpec(latencyGovernor.active());
+  pcmRing.setDepth(spec.ringFrames);
+  audio.dmaFrames = spec.dmaBuffers * I2S_DMA_BUF_FRAMES;
+}
+
+// playFile() from a handler or a rule action: open the file, read its
+// header and seek index, start the decoder
+static void playFile(Task& t, int32_t seconds) {
+  Plan p(t);
+  p.lock(audioMutex);
+  sdOp(p, SD_OPEN);
+  sdOp(p, SD_READ, 4096);  // ID3 skip, first frame
+  sdOp(p, SD_OPEN);        // Seek index
+  sdOp(p, SD_READ, 4096);
+  p.cpu(jitter(PLAY_SETUP_US, 0.2)).call(
+      [](Task& task, int32_t secs) {
+        if (!task.ok) {
+          audio.playFailures++;
+          give(audioMutex);
+          Plan(task).publish(MQTT_TOPIC_AUDIO_STATUS, "fallback");
+          return;
+        }
+        if (audio.playing && !audio.draining) audio.cutShort++;
+        audio.plays++;
+        audio.playing = true;
+        audio.draining = false;
+        audio.trackFrames = (int64_t)secs * RATE_HZ;
+        audio.decodedFrames = 0;
+        audio.inputBytes = 4096 - 600;
+        audio.awaitingFirst = true;
+        audio.audible = false;
+        audio.lastResumeSaveUs = now;
+        pcmRing.flush();
+        publishAudioState(AUDIO_STATE_PLAYING);
+        give(audioMutex);
+        Plan(task).publish(MQTT_TOPIC_AUDIO_STATUS, "playing");
+      },
+      seconds);
+}
+
+static void decodeBurstDone(Task& t, int32_t frames);
+
+// One MP3 frame of a burst, reading ahead from SD when the input runs out
+static void decodeFrame(Task& t, int32_t burstFrames) {
+  if (!t.ok) {  // The read failed: the decoder stops
+    decodeBurstDone(t, burstFrames);
+    return;
+  }
+  Plan p(t);
+  if (audio.inputBytes < MP3_FRAME_BYTES) {
+    sdOp(p, SD_READ, 4096);
+    audio.inputBytes += 4096;
+  }
+  audio.inputBytes -= MP3_FRAME_BYTES;
+  p.cpu(jitter(MP3_DECODE_US, 0.15)).call(
+      [](Task& task, int32_t done) {
+        static int16_t pcm[MP3_FRAME_SAMPLES * 2];
+        uint32_t frames = (uint32_t)std::min<int64_t>(
+            MP3_FRAME_SAMPLES, audio.trackFrames - audio.decodedFrames);
+        frames = std::min(frames, pcmRing.space());
+        pcmRing.write(pcm, frames);
+        audio.decodedFrames += frames;
+        done += frames;
+        if (audio.awaitingFirst && frames > 0) {
+          audio.awaitingFirst = false;
+          audio.firstAudioUs.add(now - audio.requestUs);
+        }
+        if (task.ok && audio.decodedFrames < audio.trackFrames &&
+            pcmRing.space() >= MP3_FRAME_SAMPLES / 2) {
+          Plan(task).call(decodeFrame, done);
+        } else {
+          decodeBurstDone(task, done);
+        }
+      },
+      burstFrames);
+}
+
+static int64_t burstStartUs = 0;
+
+// lockTimedOut: no audioMutex within 5 ticks, so nothing was decoded
+static void decodeEnd(Task& t, int32_t lockTimedOut) {
+  deadlineMonitor.end(t.deadline);
+  int64_t stall = now - decodeIter.beginUs - decodeIter.sdUs;
+  bool starved = lockTimedOut && audio.playing && !audio.draining;
+  if (stall <= BUDGET_AUDIO_DECODE_US && !starved) return;
+  // Waits under a millisecond are the scheduler's, not the cause
+  if (decodeIter.waitUs < 1000) {
+    decodeStalls.add("decode and preemption");
+    return;
+  }
+  decodeStalls.add(decodeIter.why);
+  if (decodeIter.holder != decodeTask.name) decodeStallsByOthers++;
+}
+
+static void decodeBurstDone(Task& t, int32_t frames) {
+  pcmRing.noteBurst(frames, (uint32_t)(now - burstStartUs));
+  Plan p(t);
+  if (!t.ok || audio.decodedFrames >= audio.trackFrames) {
+    if (!t.ok) audio.cutShort++;
+    pcmRing.finish();
+    audio.draining = true;
+  } else if (now - audio.lastResumeSaveUs >= RESUME_SAVE_MS * 1000LL) {
+    // saveResumePoint(): writeFile() has no cool-down
+    audio.lastResumeSaveUs = now;
+    sdOp(p, SD_CREATE);
+    sdOp(p, SD_WRITE, 64);
+    sdOp(p, SD_CLOSE);
+  }
+  p.unlock(audioMutex).call(decodeEnd);
+}
+
+static void decodePass(Task& t, int32_t) {
+  int64_t lockUs = now - decodeIter.beginUs;
+  if (lockUs > decodeIter.waitUs) decodeIter.waitUs = lockUs;
+  if (!t.ok) {  // No audioMutex within 5 ticks
+    decodeEnd(t, 1);
+    return;
+  }
+  if (latencyGovernor.update(pcmRing.underruns(), (uint32_t)(now / 1000))) {
+    applyLatencyProfile();
+  }
+  Plan p(t);
+  if (audio.playing && !audio.draining) {
+    if (pcmRing.fill() < pcmRing.refillMark()) {
+      burstStartUs = now;
+      p.cpu(DECODE_PASS_US).call(decodeFrame, 0);
+      return;  // decodeBurstDone() unlocks
+    }
+  } else if (audio.draining && pcmRing.fill() == 0) {
+    // Playback finished: the status goes out through the outbox
+    audio.playing = false;
+    audio.draining = false;
+    audio.finished++;
+    sdOp(p, SD_REMOVE);
+    publishAudioState(AUDIO_STATE_IDLE);
+    p.publish(MQTT_TOPIC_AUDIO_STATUS, "finished");
+  }
+  p.cpu(DECODE_PASS_US).unlock(audioMutex).call(decodeEnd);
+}
+
+static void planDecode(Task& t) {
+  deadlineMonitor.begin(t.deadline);
+  decodeIter.beginUs = now;
+  decodeIter.sdUs = 0;
+  decodeIter.waitUs = 0;
+  decodeIter.holder = audioMutex.owner ? audioMutex.owner->name : "nobody";
+  snprintf(decodeIter.why, sizeof(decodeIter.why), "audioMutex held by %s",
+           decodeIter.holder);
+  Plan(t).lock(audioMutex, 5 * TICK_US).call(decodePass);
+}
+
+// What kept the decoder from refilling when the output ran dry
+static const char* gapCause() {
+  static char why[96];
+  if (sd.waiter == &decodeTask && now < sd.waitEndUs + 250000) {
+    return sd.waitWhy;
+  }
+  if (decodeTask.state == TASK_BLOCKED) {
+    Task* owner = decodeTask.blockedOn->owner;
+    snprintf(why, sizeof(why), "AudioDecode blocked on %s held by %s",
+             decodeTask.blockedOn->name, owner ? owner->name : "nobody");
+    return why;
+  }
+  return "AudioDecode fell behind";
+}
+
+// The DAC plays the DMA buffers at the sample rate whatever the tasks do
+static void advanceDma() {
+  double played = (now - audio.dmaUs) * (RATE_HZ / 1e6);
+  audio.dmaUs = now;
+  if (played <= audio.dmaLevel) {
+    audio.dmaLevel -= played;
+    audio.dry = false;
+    return;
+  }
+  if (audio.audible) {
+    if (!audio.dry) {
+      audio.gaps++;
+      outputGaps.add(gapCause());
+    }
+    audio.gapFrames += played - audio.dmaLevel;
+    audio.dry = true;
+  }
+  audio.dmaLevel = 0;
+}
+
+static void outputPass(Task& t, int32_t) {
+  advanceDma();
+  // A smaller profile leaves the DMA over its new capacity for a while
+  uint32_t level = (uint32_t)audio.dmaLevel;
+  uint32_t space = level < audio.dmaFrames ? audio.dmaFrames - level : 0;
+  uint32_t moved = 0;
+  for (int pass = 0; pass < 2 && moved < space; pass++) {
+    const uint32_t* frames;
+    uint32_t n = std::min(pcmRing.peek(&frames), space - moved);
+    if (n == 0) break;
+    pcmRing.consume(n);
+    moved += n;
+  }
+  const uint32_t* frames;
+  if (moved < space && pcmRing.peek(&frames) == 0) pcmRing.noteStarved();
+  audio.dmaLevel += moved;
+  if (moved > 0 && audio.playing) audio.audible = true;
+  if (audio.playing) audio.playingUs += PERIOD_AUDIO_OUTPUT_MS * 1000;
+  if (audio.draining && pcmRing.fill() == 0) audio.audible = false;
+  int64_t cost = moved ? OUTPUT_PASS_US + moved * OUTPUT_FRAME_NS / 1000
+                       : OUTPUT_IDLE_US;
+  Plan(t).cpu(cost).call(
+      [](Task& task, int32_t) { deadlineMonitor.end(task.deadline); });
+}
+
+static void planOutput(Task& t) {
+  deadlineMonitor.begin(t.deadline);
+  Plan(t).call(outputPass);
+}
+
+// ============================================================================
+// Download: AudioManager::downloadFile() in the job task
+// ============================================================================
+struct Download {
+  int32_t pending = 0;  // Size queued by the handler, 0 when none
+  int32_t size = 0, done = 0, sinceFlush = 0;
+  int64_t rateBps = 0;
+  int64_t startUs = 0;
+  uint8_t* block = nullptr;
+
+  uint32_t started = 0, ok = 0, failed = 0, refused = 0;
+  uint64_t bytes = 0;
+  int64_t busyUs = 0;
+  Samples kbs;
+} download;
+
+// Exact index scan queued by a download for the job task
+struct IndexJob {
+  int32_t size = 0;  // Of the queued MP3, 0 when nothing is queued
+  uint32_t requests = 0, running = 0;
+  uint8_t* index = nullptr;
+  uint8_t* scratch = nullptr;
+  uint32_t scans = 0;
+} indexJob;
+
+static void downloadFinish(Task& t, int32_t success);
+
+static void downloadBlock(Task& t, int32_t) {
+  if (!t.ok) {  // writeChunk() failed
+    downloadFinish(t, 0);
+    return;
+  }
+  Plan p(t);
+  if (download.done >= download.size) {
+    // closeFile() with its cool-down, then the sidecars; the index scan
+    // is queued for the job task
+    t.doing = "download:close";
+    sdOp(p, SD_CLOSE);
+    p.sleep(SD_COOLDOWN_MS * 1000LL).call([](Task& task, int32_t) {
+      bufferPool.release(download.block);
+      download.block = nullptr;
+      audio.downloading = false;
+      publishAudioState(AUDIO_STATE_IDLE);
+      task.doing = "download:sidecars";
+      Plan q(task);
+      sdOp(q, SD_REMOVE);  // Decoded sidecar
+      sdOp(q, SD_REMOVE);  // Compact sidecar
+      q.lock(audioMutex).cpu(10).call([](Task& t2, int32_t) {
+        indexJob.size = download.size;  // queueIndex()
+        indexJob.requests++;
+        give(audioMutex);
+        downloadFinish(t2, 1);
+      });
+    });
+    return;
+  }
+  // Socket reads until the block is full, delay(1) between polls
+  int32_t n = std::min<int32_t>(DOWNLOAD_BLOCK, download.size - download.done);
+  int64_t net = (int64_t)n * 1000000 / download.rateBps;
+  net = jitter(net, 0.3);
+  if (rngNet.chance(0.005)) net += rngNet.between(200000, 2000000);
+  if (!broker.networkUp) {
+    p.sleep(HTTP_TIMEOUT_MS * 1000LL).call(downloadFinish, 0);
+    return;
+  }
+  download.done += n;
+  download.sinceFlush += n;
+  bufferPool.noteTransfer(download.block);
+  p.sleep(net).cpu(100 + n / 40);
+  sdOp(p, SD_WRITE, n);
+  if (download.sinceFlush >= SD_FLUSH_BYTES) {
+    download.sinceFlush = 0;
+    sdOp(p, SD_FLUSH);
+  }
+  p.call(downloadBlock);
+}
+
+static void downloadFinish(Task& t, int32_t success) {
+  Plan p(t);
+  if (success) {
+    download.ok++;
+    download.bytes += download.size;
+    int64_t us = now - download.startUs;
+    download.kbs.add((int64_t)download.size * 1000 / us);
+  } else {
+    download.failed++;
+    if (download.block && audio.downloading) {
+      bufferPool.release(download.block);
+      sdOp(p, SD_CLOSE);
+      p.sleep(SD_COOLDOWN_MS * 1000LL);
+    }
+    if (audio.downloading) publishAudioState(AUDIO_STATE_IDLE);
+    audio.downloading = false;
+  }
+  download.block = nullptr;
+  // backgroundJobs() clears the request, then reports through the outbox
+  p.lock(audioMutex).cpu(10).call([](Task& task, int32_t) {
+    download.pending = 0;
+    give(audioMutex);
+    download.busyUs += now - download.startUs;
+    task.doing = "";
+  });
+  p.publish("esp32/audio/status",
+            success ? "download_success" : "download_failed");
+}
+
+static void downloadFile(Task& t, int32_t size) {
+  download.started++;
+  download.size = size;
+  download.done = 0;
+  download.sinceFlush = 0;
+  download.rateBps = rngNet.between(60000, 400000);
+  download.startUs = now;
+  download.block = nullptr;
+  t.doing = "download:get";
+  Plan p(t);
+  p.lock(audioMutex).cpu(50).call([](Task& task, int32_t) {
+    audio.downloading = true;
+    give(audioMutex);
+    publishAudioState(AUDIO_STATE_DOWNLOADING);
+    int64_t get = rngNet.between(80000, 600000);
+    bool timeout = !broker.networkUp || rngNet.chance(0.02);
+    Plan q(task);
+    if (timeout) {
+      q.sleep(HTTP_TIMEOUT_MS * 1000LL).call(downloadFinish, 0);
+      return;
+    }
+    q.sleep(get).call([](Task& t2, int32_t) {
+      download.block = bufferPool.acquire();
+      if (!download.block) {
+        downloadFinish(t2, 0);
+        return;
+      }
+      Plan r(t2);
+      sdOp(r, SD_CREATE);
+      r.call([](Task& t3, int32_t) {
+        if (!t3.ok) {
+          bufferPool.release(download.block);
+          download.block = nullptr;
+          downloadFinish(t3, 0);
+          return;
+        }
+        t3.doing = "download:stream";
+        Plan(t3).call(downloadBlock);
+      });
+    });
+  });
+}
+
+// ============================================================================
+// Audio jobs: AudioManager::backgroundJobs() in its priority 1 task
+// ============================================================================
+static void planJobs(Task& t) {
+  Plan p(t);
+  p.lock(audioMutex).cpu(10).call([](Task& task, int32_t) {
+    // A queued download first; the scan it queues runs on the next pass
+    int32_t size = download.pending;
+    if (size > 0) {
+      give(audioMutex);
+      Plan(task).call(downloadFile, size);
+      return;
+    }
+    bool start = indexJob.size > 0 && !audio.downloading &&
+                 indexJob.running != indexJob.requests;
+    give(audioMutex);
+    if (!start) return;
+    // indexFile(): a full scan reads the file once, without audioMutex
+    indexJob.running = indexJob.requests;
+    indexJob.index = bufferPool.acquire();
+    indexJob.scratch = bufferPool.acquire();
+    task.doing = "jobs:index";
+    Plan q(task);
+    sdOp(q, SD_OPEN);
+    for (int32_t at = 0; at < indexJob.size; at += 4096) {
+      sdOp(q, SD_READ, 4096);
+      q.cpu(200);
+    }
+    sdOp(q, SD_CREATE);
+    sdOp(q, SD_WRITE, 4096);
+    sdOp(q, SD_CLOSE);
+    sdOp(q, SD_OPEN);  // Read back
+    sdOp(q, SD_READ, 4096);
+    q.lock(audioMutex).cpu(10).call([](Task& t2, int32_t) {
+      bufferPool.release(indexJob.scratch);
+      bufferPool.release(indexJob.index);
+      indexJob.scans++;
+      if (indexJob.running == indexJob.requests) indexJob.size = 0;
+      give(audioMutex);
+      t2.doing = "";
+    });
+  });
+  p.sleep(PERIOD_AUDIO_JOBS_MS * 1000LL);
+}
+
+// ============================================================================
+// MQTT task
+// ============================================================================
+static SensorSampleEvent remoteSample;  // Latest polled by the MQTT task
+static float lastLux = 0.0f;  // localSensors.getLightIntensity()
+static int64_t lastSensorPublishUs = 0;
+static int mqttSensorSub, displaySub;
+static NetworkStateEvent networkState = {false, false, 0};
+
+static size_t fmtFloat(char* buf, size_t len, float v) {
+  int n = snprintf(buf, len, "%.2f", v);
+  return n > 0 && (size_t)n < len ? n : 0;
+}
+
+// publishRemoteSensorData()
+static void publishRemote(Plan& p) {
+  if (!broker.connected) return;
+  p.publish(MQTT_TOPIC_REMOTE_TEMP, [](char* b, size_t n) {
+    return fmtFloat(b, n, remoteSample.data.temperature);
+  });
+  p.publish(MQTT_TOPIC_REMOTE_HUMIDITY, [](char* b, size_t n) {
+    return fmtFloat(b, n, remoteSample.data.humidity);
+  });
+  p.publish(MQTT_TOPIC_REMOTE_PRESSURE, [](char* b, size_t n) {
+    return fmtFloat(b, n, remoteSample.data.pressure);
+  });
+  p.publish(MQTT_TOPIC_REMOTE_UV, [](char* b, size_t n) {
+    return fmtFloat(b, n, remoteSample.data.uvIndex);
+  });
+  p.publish(MQTT_TOPIC_REMOTE_BATTERY, [](char* b, size_t n) {
+    int k = snprintf(b, n, "%d", remoteSample.data.batteryLevel);
+    return (size_t)k;
+  });
+  p.publish(MQTT_TOPIC_REMOTE_STATUS, [](char* b, size_t n) {
+    int k = snprintf(b, n, "%s online", remoteSample.data.deviceName);
+    return (size_t)k;
+  });
+  p.cpu(300);  // Analytics snapshot
+  p.publish(MQTT_TOPIC_REMOTE_ANALYTICS, [](char* b, size_t n) {
+    const SensorAnalytics* a = remoteAnalytics.find(remoteSample.node);
+    return a ? a->toJson(b, n) : 0;
+  });
+}
+
+// publishGatewayAnalytics()
+static void publishGatewayAnalytics(Plan& p) {
+  if (!broker.connected) return;
+  p.cpu(200);  // Analytics snapshot
+  p.publish(MQTT_TOPIC_GATEWAY_ANALYTICS, [](char* b, size_t n) {
+    return sensorAnalytics.toJson(b, n);
+  });
+}
+
+static void drainViolations(Task& t, int32_t) {
+  DeadlineViolation v;
+  if (!deadlineMonitor.pollViolation(v)) return;
+  if (deadlineMonitor.violationToJson(v, t.scratch, sizeof(t.scratch)) > 0 &&
+      broker.connected) {
+    Plan(t).publish(MQTT_TOPIC_DEADLINES, t.scratch).call(drainViolations);
+  } else {
+    Plan(t).call(drainViolations);
+  }
+}
+
+static void handleCommand(Task& t, const Command& c) {
+  broker.commandUs.add(now - c.sentUs);
+  Plan p(t);
+  p.cpu(MQTT_DISPATCH_US);
+  switch (c.type) {
+    case CMD_PLAY:
+      audio.requestUs = c.sentUs;
+      p.call(playFile, c.arg);
+      break;
+    case CMD_DOWNLOAD:
+      // Queued for the job task; one transfer at a time
+      p.lock(audioMutex).cpu(20).call(
+          [](Task& task, int32_t size) {
+            bool busy = download.pending > 0 || audio.downloading;
+            if (!busy) download.pending = size;
+            give(audioMutex);
+            if (busy) {
+              download.refused++;
+              Plan(task).publish("esp32/audio/status", "download_failed");
+            }
+          },
+          c.arg);
+      break;
+    case CMD_STATUS:
+      p.cpu(300);
+      if (c.arg == 0) {
+        p.publish(MQTT_TOPIC_DEADLINES, [](char* b, size_t n) {
+          return deadlineMonitor.toJson(b, n < 896 ? n : 896);
+        });
+      } else if (c.arg == 1) {
+        p.publish("smartalarm/status/pcm", pcmJson);
+      } else {
+        p.publish("smartalarm/status/buffers", [](char* b, size_t n) {
+          return bufferPool.toJson(b, n < 192 ? n : 192);
+        });
+      }
+      break;
+  }
+}
+
+// mqtt.loop(): reconnect every 5 s while down, otherwise read one packet
+// and run its handler with the client still held
+static void mqttLoop(Task& t, int32_t) {
+  brokerCheckKeepalive();
+  outbox.connected = broker.connected;
+  Plan p(t);
+  if (!broker.connected) {
+    if (now - broker.lastReconnectUs <= MQTT_RECONNECT_MS * 1000LL) return;
+    broker.lastReconnectUs = now;
+    t.doing = "reconnect";
+    if (!broker.networkUp) {
+      broker.reconnectFailures++;
+      p.cpu(500).sleep(TCP_CONNECT_TIMEOUT_MS * 1000LL);
+      return;
+    }
+    p.cpu(2000).sleep(rngNet.between(30000, 150000)).call([](Task& task,
+                                                           int32_t) {
+      if (!broker.networkUp) return;
+      broker.connected = true;
+      broker.reconnects++;
+      broker.lastFromClientUs = now;
+      task.doing = "loop";
+    });
+    p.publish(MQTT_TOPIC_STATUS, "online").cpu(1500);  // And resubscribe
+    return;
+  }
+  t.doing = "loop";
+  p.enter("loop").cpu(MQTT_LOOP_US);
+  if (now - broker.lastFromClientUs > MQTT_KEEPALIVE_MS * 1000LL) {
+    brokerHeard();  // PINGREQ
+    p.sleep(socketWriteUs());
+  }
+  if (!broker.inbox.empty()) {
+    Command c = broker.inbox.front();
+    broker.inbox.pop_front();
+    p.call(
+        [](Task& task, int32_t) {
+          // The handler was queued with its command in scratch
+          Command cmd;
+          memcpy(&cmd, task.scratch, sizeof(cmd));
+          handleCommand(task, cmd);
+        },
+        0);
+    memcpy(t.scratch, &c, sizeof(c));
+  }
+  p.leave();
+}
+
+// flushOutbox(): one queued publish at a time, dropped while disconnected
+static void flushOutbox(Task& t, int32_t) {
+  if (outbox.queue.empty()) return;
+  outbox.sending = outbox.queue.front();
+  outbox.queue.pop_front();
+  Plan p(t);
+  p.cpu(10);  // xQueueReceive()
+  if (broker.connected) {
+    p.publish(outbox.sending.topic, outbox.sending.payload);
+  } else {
+    outbox.dropped++;  // Stale by the time the broker is back
+  }
+  p.call(flushOutbox);
+}
+
+static void mqttAfterLoop(Task& t, int32_t) {
+  Plan p(t);
+  bool newSample = false;
+  Event e;
+  while (eventBus.poll(mqttSensorSub, e)) {
+    if (const SensorSampleEvent* s = e.as<SensorSampleEvent>()) {
+      remoteSample = *s;
+      newSample = true;
+    }
+  }
+  if (newSample) {
+    p.context("remote_sensors");
+    publishRemote(p);
+  }
+  // Gateway readings, from this task only
+  if (now - lastSensorPublishUs >= SENSOR_PUBLISH_INTERVAL_MS * 1000LL) {
+    lastSensorPublishUs = now;
+    if (broker.connected) {
+      p.context("gateway_sensors");
+      p.publish(MQTT_TOPIC_GATEWAY_LIGHT, [](char* b, size_t n) {
+        return fmtFloat(b, n, lastLux);
+      });
+      p.publish(MQTT_TOPIC_GATEWAY_NOISE, "31.2");
+      publishGatewayAnalytics(p);
+      p.publish(MQTT_TOPIC_MESH_STATS, "{}");
+    }
+  }
+  p.context(nullptr).call([](Task& task, int32_t) {
+    bool up = broker.networkUp;
+    if (up != networkState.wifiConnected ||
+        broker.connected != networkState.mqttConnected) {
+      networkState.wifiConnected = up;
+      networkState.mqttConnected = broker.connected;
+      networkState.rssi = up ? -60 : 0;
+      eventBus.publish(networkState);
+    }
+    deadlineMonitor.end(task.deadline);
+    Plan(task).call(drainViolations);
+  });
+}
+
+static void planMqtt(Task& t) {
+  deadlineMonitor.begin(t.deadline);
+  Plan(t)
+      .context("loop")
+      .call(mqttLoop)
+      .context("outbox")
+      .call(flushOutbox)
+      .call(mqttAfterLoop);
+}
+
+// ============================================================================
+// Sensor, display, rule, loop() and WiFi tasks
+// ============================================================================
+static int64_t lastLightReadUs = 0;
+static int64_t noiseWindowUs = 0;
+static uint32_t ruleQueueDrops = 0, ruleEvents = 0, rulesFired = 0;
+
+struct RuleInputEvent {
+  RuleInput input;
+  float value;
+};
+static std::deque<RuleInputEvent> ruleQueue;
+
+static void rulePost(RuleInput input, float value) {
+  if (ruleQueue.size() >= RULE_QUEUE_LEN) {
+    ruleQueueDrops++;
+    return;
+  }
+  ruleQueue.push_back({input, value});
+  notify(ruleTask);
+}
+
+static double dayFraction() { return (now % 86400000000LL) / 86400e6; }
+
+static float lightLux() {
+  double h = dayFraction() * 24.0;
+  if (h < 6.0 || h > 20.0) return 0.5f;
+  return (float)(600.0 * sin(M_PI * (h - 6.0) / 14.0) *
+                 (0.7 + 0.3 * rngI2c.uniform()));
+}
+
+static void sensorRead(Task& t, int32_t) {
+  if (!t.ok) return;  // isLightValid() is false
+  float lux = lightLux();
+  lastLux = lux;
+  sensorAnalytics.update(SensorAnalytics::SIG_LIGHT, lux);
+  rulePost(RULE_IN_LIGHT, lux);
+}
+
+static void planSensors(Task& t) {
+  deadlineMonitor.begin(t.deadline);
+  Plan p(t);
+  p.cpu(SENSOR_PASS_US);
+  int64_t start = now;
+  if (start - lastLightReadUs >= SENSOR_READ_INTERVAL_MS * 1000LL) {
+    lastLightReadUs = start;
+    p.context("read");
+    i2cOp(p, I2C_BH1750, 2).call(sensorRead);
+  }
+  // Noise monitor: a window every NOISE_PERIOD_MS
+  p.context("noise");
+  int64_t into = start - noiseWindowUs;
+  if (into >= 10000000LL) noiseWindowUs = start, into = 0;
+  if (into < NOISE_MEASURE_MS * 1000LL) {
+    p.cpu(jitter(NOISE_POLL_US, 0.3));
+    if (into + PERIOD_SENSOR_MS * 1000LL >= NOISE_MEASURE_MS * 1000LL) {
+      p.call([](Task&, int32_t) {
+        float db = 28.0f + 6.0f * (float)rngI2c.uniform();
+        sensorAnalytics.update(SensorAnalytics::SIG_NOISE, db);
+        rulePost(RULE_IN_NOISE, db);
+      });
+    }
+  } else {
+    p.cpu(20);
+  }
+  p.context(nullptr).call(
+      [](Task& task, int32_t) { deadlineMonitor.end(task.deadline); });
+}
+
+static int displayPageCounter = 0;
+
+static void planDisplay(Task& t) {
+  deadlineMonitor.begin(t.deadline);
+  Plan p(t);
+  Event e;
+  while (eventBus.poll(displaySub, e)) {
+  }
+  p.cpu(jitter(DISPLAY_DRAW_US, 0.3));
+  for (int sent = 0; sent < OLED_FRAME_BYTES; sent += I2C_CHUNK) {
+    i2cOp(p, I2C_OLED, I2C_CHUNK);
+  }
+  if (++displayPageCounter >= 25) displayPageCounter = 0;
+  p.call([](Task& task, int32_t) { deadlineMonitor.end(task.deadline); });
+}
+
+static bool fading = false;
+static int64_t fadeEndUs = 0, lastRuleTickUs = 0;
+static Task* actingTask = nullptr;
+
+static void onRuleAction(const Rule& rule, void*) {
+  rulesFired++;
+  Plan p(*actingTask);
+  switch (rule.action) {
+    case RULE_ACTION_FADEIN:
+      fading = true;
+      fadeEndUs = now + (int64_t)(rule.actionValue * 1e6);
+      // fall through
+    case RULE_ACTION_PLAY:
+      audio.requestUs = now;
+      p.call(playFile, 180);
+      break;
+    default:
+      break;
+  }
+  if (broker.connected) {
+    snprintf(actingTask->scratch, sizeof(actingTask->scratch), "%s%s%s",
+             rule.name, rule.action == RULE_ACTION_PUBLISH ? "|" : "",
+             rule.action == RULE_ACTION_PUBLISH ? rule.actionArg : "");
+    p.publish("smartalarm/rules/fired", actingTask->scratch);
+  }
+}
+
+static void ruleApply(Task& t, int32_t) {
+  RuleInputEvent e = ruleQueue.front();
+  ruleQueue.pop_front();
+  ruleEvents++;
+  actingTask = &t;
+  ruleEngine.setInput(e.input, e.value);
+  ruleEngine.evaluate();
+}
+
+static void planRules(Task& t) {
+  Plan p(t);
+  t.notified = false;
+  size_t n = ruleQueue.size();
+  for (size_t i = 0; i < n; i++) p.cpu(RULE_EVAL_US).call(ruleApply);
+  if (fading) {
+    p.cpu(20);  // setVolume()
+    if (now >= fadeEndUs) fading = false;
+  }
+  if (now - lastRuleTickUs >= RULE_TICK_MS * 1000LL) {
+    lastRuleTickUs = now;
+    p.call([](Task&, int32_t) {
+      int64_t minutes = now / 60000000LL;
+      rulePost(RULE_IN_TIME, (float)(minutes % 1440));
+      rulePost(RULE_IN_WEEKDAY, (float)((1 + minutes / 1440) % 7));
+    });
+    // audio.playing() takes the audio mutex
+    p.lock(audioMutex).cpu(5).call([](Task&, int32_t) {
+      give(audioMutex);
+      rulePost(RULE_IN_PLAYING, audio.playing ? 1.0f : 0.0f);
+    });
+  }
+  p.wait((fading ? RULE_FADE_STEP_MS : RULE_TICK_MS) * 1000LL);
+}
+
+static void planLoop(Task& t) {
+  Plan(t).cpu(jitter(LOOP_US, 0.3)).sleep(LOOP_PERIOD_MS * 1000LL);
+}
+
+// ESP-NOW frames as the radio hands them to onESPNowDataReceived()
+struct Frame {
+  uint8_t origin;
+  uint16_t seq;
+  SensorData data;
+};
+static std::deque<Frame> radio;
+static uint32_t framesAccepted = 0, framesDuplicate = 0;
+
+static void acceptFrame(Task&, int32_t) {
+  Frame f = radio.front();
+  radio.pop_front();
+  if (meshDedup.checkAndInsert(f.origin, f.seq)) {
+    framesDuplicate++;
+    return;
+  }
+  framesAccepted++;
+  SensorAnalytics& analytics =
+      remoteAnalytics.forNode(f.origin, (uint32_t)(now / 1000));
+  analytics.updateRemote(f.data, (uint32_t)(now / 1000));
+  rulePost(RULE_IN_OUTSIDE_TEMP, f.data.temperature);
+  rulePost(RULE_IN_OUTSIDE_HUMIDITY, f.data.humidity);
+  rulePost(RULE_IN_UV, f.data.uvIndex);
+  rulePost(RULE_IN_DEW_POINT, analytics.getDewPoint());
+  rulePost(RULE_IN_PRESSURE, f.data.pressure);
+  SensorSampleEvent e;
+  e.data = f.data;
+  e.node = f.origin;
+  eventBus.publish(e);
+}
+
+static void planWifi(Task& t) {
+  Plan p(t);
+  t.notified = false;
+  for (size_t i = 0; i < radio.size(); i++) {
+    p.cpu(jitter(ESPNOW_RX_US, 0.3)).call(acceptFrame);
+  }
+  p.wait(NEVER);
+}
+
+// ============================================================================
+// Step execution
+// ============================================================================
+static void executeStep(Task& t, const Step& s) {
+  switch (s.kind) {
+    case STEP_CPU:
+      t.left = s.us;
+      break;
+    case STEP_SLEEP:
+      if (s.us <= 0) break;
+      t.state = TASK_DELAYED;
+      t.wakeUs = now + s.us;
+      break;
+    case STEP_LOCK:
+      if (!s.mutex->owner) {
+        take(*s.mutex, t);
+        t.ok = true;
+      } else if (s.mutex->owner == &t) {
+        s.mutex->depth++;  // Recursive
+        t.ok = true;
+      } else {
+        t.state = TASK_BLOCKED;
+        t.blockedOn = s.mutex;
+        t.wakeUs = s.us < 0 ? NEVER : now + s.us;
+        blockedCount++;
+      }
+      break;
+    case STEP_UNLOCK:
+      if (s.mutex->owner == &t) give(*s.mutex);
+      break;
+    case STEP_WAIT:
+      if (t.notified) break;
+      t.state = TASK_WAITING;
+      t.wakeUs = s.us == NEVER ? NEVER : now + s.us;
+      break;
+    case STEP_CALL:
+      s.fn(t, s.arg);
+      break;
+    case STEP_PUBLISH:
+      doPublish(t, s);
+      break;
+    case STEP_ENTER:
+      clientEnter(t, s.text);
+      break;
+    case STEP_LEAVE:
+      clientLeave(t);
+      break;
+    case STEP_CONTEXT:
+      deadlineMonitor.setContext(t.deadline, s.text);
+      break;
+  }
+}
+
+// ============================================================================
+// Peers: scheduled events outside the gateway
+// ============================================================================
+enum PeerEventType : uint8_t {
+  PEER_NODE_SEND,   // a: node
+  PEER_FRAME,       // Frame reaches the gateway's radio; a: radio index
+  PEER_COMMAND,     // A command reaches the client's socket
+  PEER_OUTAGE,      // Network down
+  PEER_RESTORE,     // Network back
+  PEER_MONITOR,     // Dashboard poll
+  PEER_USER_PLAY,
+  PEER_USER_DOWNLOAD,
+};
+
+struct PeerEvent {
+  int64_t at;
+  uint64_t seq;
+  PeerEventType type;
+  int32_t a;
+  Frame frame;
+  Command command;
+  bool operator<(const PeerEvent& o) const {
+    return at != o.at ? at > o.at : seq > o.seq;  // Min-heap
+  }
+};
+
+static std::vector<PeerEvent> peerQueue;
+static uint64_t peerSeq = 0;
+
+static PeerEvent& schedule(int64_t at, PeerEventType type, int32_t a = 0) {
+  PeerEvent e;
+  memset(&e, 0, sizeof(e));
+  e.at = at;
+  e.seq = peerSeq++;
+  e.type = type;
+  e.a = a;
+  peerQueue.push_back(e);
+  std::push_heap(peerQueue.begin(), peerQueue.end());
+  return peerQueue.back();  // Valid until the next schedule()
+}
+
+static void sendCommand(CommandType type, int32_t arg) {
+  Command c = {type, arg, now};
+  PeerEvent e;
+  memset(&e, 0, sizeof(e));
+  e.at = now + rngNet.between(2000, 30000);  // Broker and WiFi
+  e.seq = peerSeq++;
+  e.type = PEER_COMMAND;
+  e.command = c;
+  peerQueue.push_back(e);
+  std::push_heap(peerQueue.begin(), peerQueue.end());
+}
+
+static uint16_t nodeSeq[NODE_COUNT];
+static uint32_t framesLost = 0;
+
+static void deliverFrame(const Frame& f, int64_t delayUs) {
+  PeerEvent e;
+  memset(&e, 0, sizeof(e));
+  e.at = now + delayUs;
+  e.seq = peerSeq++;
+  e.type = PEER_FRAME;
+  e.frame = f;
+  peerQueue.push_back(e);
+  std::push_heap(peerQueue.begin(), peerQueue.end());
+}
+
+static void nodeSend(int node) {
+  double day = dayFraction();
+  float diurnal = (float)sin(2.0 * M_PI * (day - 0.25));
+  Frame f;
+  memset(&f, 0, sizeof(f));
+  f.origin = (uint8_t)(node + 1);
+  f.seq = ++nodeSeq[node];
+  f.data.timestamp = (uint32_t)(now / 1000);
+  f.data.temperature = 8.0f + 7.0f * diurnal + (float)rngNodes.uniform() * 0.4f;
+  f.data.humidity = 70.0f - 18.0f * diurnal + (float)rngNodes.uniform();
+  f.data.pressure = 1008.0f + 6.0f * (float)sin(now / 3.0e10);
+  f.data.uvIndex = diurnal > 0 ? 6.0f * diurnal : 0.0f;
+  f.data.batteryLevel = 90;
+  f.data.sensorId = f.origin;
+  snprintf(f.data.deviceName, sizeof(f.data.deviceName), "Node%d", node + 1);
+  if (rngNodes.chance(0.02)) {
+    framesLost++;
+  } else if (node == NODE_COUNT - 1) {  // Behind a relay
+    int64_t hop = rngNodes.between(5000, 40000);
+    deliverFrame(f, hop);
+    if (rngNodes.chance(0.05)) {
+      deliverFrame(f, hop + rngNodes.between(1000, 20000));
+    }
+  } else {
+    deliverFrame(f, rngNodes.between(500, 3000));
+  }
+  schedule(now + NODE_SEND_MS * 1000LL + rngNodes.between(-20000, 20000),
+           PEER_NODE_SEND, node);
+}
+
+static void handlePeer(const PeerEvent& e) {
+  switch (e.type) {
+    case PEER_NODE_SEND:
+      nodeSend(e.a);
+      break;
+    case PEER_FRAME:
+      radio.push_back(e.frame);
+      notify(wifiTask);
+      break;
+    case PEER_COMMAND:
+      brokerCheckKeepalive();
+      if (broker.connected && broker.networkUp) {
+        broker.inbox.push_back(e.command);
+      } else {
+        broker.commandsLost++;
+      }
+      break;
+    case PEER_OUTAGE:
+      broker.networkUp = false;
+      broker.connected = false;
+      broker.outages++;
+      schedule(now + rngNet.between(10, 180) * 1000000LL, PEER_RESTORE);
+      break;
+    case PEER_RESTORE:
+      broker.networkUp = true;
+      schedule(now + rngNet.exponential(8 * 3600e6), PEER_OUTAGE);
+      break;
+    case PEER_MONITOR:
+      for (int i = 0; i < 3; i++) sendCommand(CMD_STATUS, i);
+      schedule(now + MONITOR_POLL_MS * 1000LL, PEER_MONITOR);
+      break;
+    case PEER_USER_PLAY:
+      sendCommand(CMD_PLAY, (int32_t)rngUser.between(60, 240));
+      schedule(now + rngUser.exponential(2 * 3600e6), PEER_USER_PLAY);
+      break;
+    case PEER_USER_DOWNLOAD:
+      sendCommand(CMD_DOWNLOAD, (int32_t)rngUser.between(500000, 6000000));
+      schedule(now + rngUser.exponential(2 * 3600e6), PEER_USER_DOWNLOAD);
+      break;
+  }
+}
+
+// ============================================================================
+// Main loop
+// ============================================================================
+static const char* RULES =
+    "dawn: light > 50 && time >= 06:30 && time < 08:00 -> fadein /wake.mp3 "
+    "30\n"
+    "frost: outside_temp < 2 -> publish frost\n"
+    "muggy: dew_point > 18 && outside_humidity > 70 -> publish muggy\n"
+    "uv: uv > 5 -> publish uv_high\n";
+
+static void run(int64_t endUs) {
+  int64_t nextReport = 6 * 3600000000LL;
+  for (;;) {
+    // Run instantaneous steps until every core has a CPU step or is idle
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int core = 0; core < 2; core++) {
+        Task* r = pick(core);
+        running[core] = r;
+        if (r && r->left == 0) {
+          stepTask(*r);
+          changed = true;
+        }
+      }
+    }
+
+    int64_t next = endUs;
+    if (!peerQueue.empty()) next = std::min(next, peerQueue.front().at);
+    for (int i = 0; i < taskCount; i++) {
+      if (tasks[i]->state != TASK_READY) {
+        next = std::min(next, tasks[i]->wakeUs);
+      }
+    }
+    for (int core = 0; core < 2; core++) {
+      Task* r = running[core];
+      if (!r) continue;
+      next = std::min(next, now + r->left);
+      if (sharesSlice(r)) next = std::min(next, (now / TICK_US + 1) * TICK_US);
+    }
+    if (next <= now && next == endUs) break;
+
+    int64_t dt = next - now;
+    for (int core = 0; core < 2; core++) {
+      Task* r = running[core];
+      if (!r) continue;
+      r->left -= dt;
+      r->cpuUs += dt;
+    }
+    now = next;
+    if (now >= endUs) break;
+
+    // Time slice over: the next task of the same priority
+    if (now % TICK_US == 0) {
+      for (int core = 0; core < 2; core++) {
+        Task* r = running[core];
+        if (r && r->left > 0 && sharesSlice(r)) r->rr = ++rrCounter;
+      }
+    }
+    for (int i = 0; i < taskCount; i++) {
+      Task* t = tasks[i];
+      if (t->state == TASK_READY || t->wakeUs > now) continue;
+      if (t->state == TASK_BLOCKED) t->ok = false;  // Lock timed out
+      makeReady(*t);
+    }
+    while (!peerQueue.empty() && peerQueue.front().at <= now) {
+      std::pop_heap(peerQueue.begin(), peerQueue.end());
+      PeerEvent e = peerQueue.back();
+      peerQueue.pop_back();
+      handlePeer(e);
+    }
+
+    if (now >= nextReport) {
+      printf("  %s  plays %u  downloads %u/%u  publishes %u  overlaps %u  "
+             "select failed %u\n",
+             clockText(now), audio.plays, download.ok, download.started,
+             broker.publishes, clientOverlaps.total, selectFailures.total);
+      nextReport += 6 * 3600000000LL;
+    }
+  }
+}
+
+static void setup(uint64_t seed) {
+  rngCpu.seed(seed, 1);
+  rngSd.seed(seed, 2);
+  rngI2c.seed(seed, 3);
+  rngNet.seed(seed, 4);
+  rngNodes.seed(seed, 5);
+  rngUser.seed(seed, 6);
+
+  bufferPool.begin();
+  applyLatencyProfile();
+  char err[64];
+  ruleEngine.setActionCallback(onRuleAction, nullptr);
+  if (!ruleEngine.load(RULES, err, sizeof(err))) {
+    printf("rule load failed: %s\n", err);
+    exit(1);
+  }
+  mqttSensorSub = eventBus.subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE));
+  displaySub = eventBus.subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE) |
+                                  EVENT_MASK(EVENT_AUDIO_STATE) |
+                                  EVENT_MASK(EVENT_NETWORK_STATE));
+
+  // Same order as startRTOSTasks()
+  addTask(outputTask, "AudioOutput", 1, PRIORITY_AUDIO_OUTPUT,
+          PERIOD_AUDIO_OUTPUT_MS * 1000LL, planOutput);
+  addTask(decodeTask, "AudioDecode", 1, PRIORITY_AUDIO_DECODE,
+          PERIOD_AUDIO_DECODE_MS * 1000LL, planDecode);
+  addTask(jobTask, "AudioJobs", 1, PRIORITY_AUDIO_JOBS, 0, planJobs);
+  addTask(sensorTask, "Sensors", 1, PRIORITY_SENSOR_READ,
+          PERIOD_SENSOR_MS * 1000LL, planSensors);
+  addTask(displayTask, "Display", 1, PRIORITY_DISPLAY,
+          PERIOD_DISPLAY_MS * 1000LL, planDisplay);
+  addTask(mqttTask, "MQTT", 0, PRIORITY_MQTT, PERIOD_MQTT_MS * 1000LL,
+          planMqtt);
+  addTask(ruleTask, "Rules", 1, 1, 0, planRules);
+  addTask(loopTask, "loopTask", 1, 1, 0, planLoop);
+  addTask(wifiTask, "wifi", 0, 23, 0, planWifi);
+  outputTask.deadline = deadlineMonitor.registerTask(
+      "AudioOutput", PERIOD_AUDIO_OUTPUT_MS * 1000, BUDGET_AUDIO_OUTPUT_US);
+  decodeTask.deadline = deadlineMonitor.registerTask(
+      "AudioDecode", PERIOD_AUDIO_DECODE_MS * 1000, BUDGET_AUDIO_DECODE_US);
+  mqttTask.deadline = deadlineMonitor.registerTask(
+      "MQTT", PERIOD_MQTT_MS * 1000, BUDGET_MQTT_US);
+  sensorTask.deadline = deadlineMonitor.registerTask(
+      "Sensors", PERIOD_SENSOR_MS * 1000, BUDGET_SENSOR_US);
+  displayTask.deadline = deadlineMonitor.registerTask(
+      "Display", PERIOD_DISPLAY_MS * 1000, BUDGET_DISPLAY_US);
+
+  for (int n = 0; n < NODE_COUNT; n++) {
+    schedule(rngNodes.between(0, NODE_SEND_MS * 1000LL), PEER_NODE_SEND, n);
+  }
+  schedule(rngNet.exponential(8 * 3600e6), PEER_OUTAGE);
+  schedule(MONITOR_POLL_MS * 1000LL, PEER_MONITOR);
+  schedule(rngUser.exponential(2 * 3600e6), PEER_USER_PLAY);
+  schedule(rngUser.exponential(2 * 3600e6), PEER_USER_DOWNLOAD);
+}
+
+int main(int argc, char** argv) {
+  uint64_t seed = 1;
+  double hours = 24.0;
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (positional++ == 0) {
+      seed = strtoull(argv[i], nullptr, 10);
+    } else {
+      hours = atof(argv[i]);
+    }
+  }
+  int64_t endUs = (int64_t)(hours * 3600e6);
+
+  printf("Gateway simulation: seed %llu, %.1f virtual hours\n",
+         (unsigned long long)seed, hours);
+  setup(seed);
+  run(endUs);
+
+  // ===== Report =====
+  printf("\nTasks                core prio  iterations  overruns  misses  "
+         "exec max   wcrt max   cpu\n");
+  for (int i = 0; i < taskCount; i++) {
+    Task* t = tasks[i];
+    printf("  %-18s %4d %4d", t->name, t->core, t->prio);
+    if (t->deadline >= 0) {
+      DeadlineTaskStats s = deadlineMonitor.stats(t->deadline);
+      printf("  %10u  %8u  %6u  %6.1f ms  %6.1f ms", s.iterations, s.overruns,
+             s.deadlineMisses, s.execMaxUs / 1000.0, s.responseMaxUs / 1000.0);
+    } else {
+      printf("  %10s  %8s  %6s  %9s  %9s", "-", "-", "-", "-", "-");
+    }
+    printf("  %4.1f%%\n", 100.0 * t->cpuUs / now);
+  }
+
+  double playingH = audio.playingUs / 3600e6;
+  printf("\nAudio: %u plays (%u failed, %u cut short), %.1f min played\n",
+         audio.plays, audio.playFailures, audio.cutShort, playingH * 60);
+  printf("  first audio after the request: p50 %.0f ms, p99 %.0f ms\n",
+         audio.firstAudioUs.pct(0.5) / 1000.0,
+         audio.firstAudioUs.pct(0.99) / 1000.0);
+  printf("  output ran dry %u times (%.0f ms), ring underruns %u, "
+         "profile %s after %u switches\n",
+         audio.gaps, audio.gapFrames * 1000.0 / RATE_HZ, pcmRing.underruns(),
+         latencyProfileSpec(latencyGovernor.active()).name,
+         latencyGovernor.switches());
+
+  double meanKbs = 0;
+  for (int64_t k : download.kbs.v) meanKbs += k;
+  if (download.kbs.size()) meanKbs /= download.kbs.size();
+  printf("\nDownloads: %u started, %u done, %u failed, %u refused, %.1f MB, "
+         "mean %.0f KB/s, job task busy %.0f s, %u indexed\n",
+         download.started, download.ok, download.failed, download.refused,
+         download.bytes / 1e6, meanKbs / 1.024, download.busyUs / 1e6,
+         indexJob.scans);
+
+  printf("\nMQTT: %u publishes, %u while disconnected, %u socket stalls\n",
+         broker.publishes, broker.publishFailed, broker.socketStalls);
+  printf("  outbox: %u queued by other tasks, %u dropped (%u while "
+         "connected)\n",
+         outbox.queued, outbox.dropped, outbox.droppedConnected);
+  printf("  commands: %zu handled, %u lost; broker to handler p50 %.0f ms, "
+         "p99 %.0f ms, max %.0f ms\n",
+         broker.commandUs.size(), broker.commandsLost,
+         broker.commandUs.pct(0.5) / 1000.0,
+         broker.commandUs.pct(0.99) / 1000.0, broker.commandUs.max() / 1000.0);
+  printf("  outages %u, keepalive expiries %u, reconnects %u (%u attempts "
+         "timed out), longest silence survived %.1f s\n",
+         broker.outages, broker.keepaliveDrops, broker.reconnects,
+         broker.reconnectFailures, broker.silentMaxUs / 1e6);
+
+  printf("\nSD: %llu operations, %.1f MB, longest busy wait %.0f ms\n",
+         (unsigned long long)sd.ops, sd.bytes / 1e6, sd.waitMaxUs / 1000.0);
+  printf("I2C: %llu transactions, %u errors\n",
+         (unsigned long long)i2cTransactions, i2cErrors.total);
+  printf("ESP-NOW: %u samples accepted, %u duplicates dropped, %u lost on "
+         "air\n",
+         framesAccepted, framesDuplicate, framesLost);
+  printf("Rules: %u inputs evaluated, %u fired, %u dropped (queue full)\n",
+         ruleEvents, rulesFired, ruleQueueDrops);
+
+  printf("\nMQTT client used by two tasks at once: %u\n", clientOverlaps.total);
+  clientOverlaps.print("  ");
+  printf("AudioDecode over budget beyond its own SD reads: %u (%u waiting "
+         "for another task)\n",
+         decodeStalls.total, decodeStallsByOthers);
+  decodeStalls.print("  ");
+  printf("Output ran dry during playback: %u\n", outputGaps.total);
+  outputGaps.print("  ");
+  printf("Select Failed: %u\n", selectFailures.total);
+  selectFailures.print("  ");
+  printf("I2C errors: %u\n", i2cErrors.total);
+  i2cErrors.print("  ");
+
+  printf("\nLast metrics as published:\n");
+  for (int i = 0; METRIC_TOPICS[i]; i++) {
+    if (lastMetric[i]) printf("  %s %s\n", lastMetric[i], lastMetricJson[i]);
+  }
+  printf("\nTrace digest: %016llx\n", (unsigned long long)digest);
+
+  // ===== Criteria =====
+  bool pass = true;
+  DeadlineTaskStats out = deadlineMonitor.stats(outputTask.deadline);
+  double gapsPerHour = playingH > 0 ? audio.gaps / playingH : 0;
+  if (out.deadlineMisses > 0) {
+    printf("FAIL: AudioOutput missed %u deadlines\n", out.deadlineMisses);
+    pass = false;
+  }
+  if (gapsPerHour > MAX_GAPS_PER_HOUR) {
+    printf("FAIL: output ran dry %.1f times per hour of playback\n",
+           gapsPerHour);
+    pass = false;
+  }
+  if (audio.firstAudioUs.pct(0.99) > MAX_FIRST_AUDIO_MS * 1000LL) {
+    printf("FAIL: first audio p99 above %d ms\n", MAX_FIRST_AUDIO_MS);
+    pass = false;
+  }
+  if (download.kbs.size() && meanKbs / 1.024 < MIN_DOWNLOAD_KBS) {
+    printf("FAIL: downloads below %d KB/s\n", MIN_DOWNLOAD_KBS);
+    pass = false;
+  }
+  if (broker.commandUs.pct(0.99) > MAX_COMMAND_MS * 1000LL) {
+    printf("FAIL: command latency p99 above %d ms\n", MAX_COMMAND_MS);
+    pass = false;
+  }
+  double stallsPerHour = playingH > 0 ? decodeStallsByOthers / playingH : 0;
+  if (stallsPerHour > MAX_DECODE_STALLS_PER_HOUR) {
+    printf("FAIL: AudioDecode waited for another task %.1f times per hour "
+           "of playback\n",
+           stallsPerHour);
+    pass = false;
+  }
+  // Hard limits: PubSubClient has no lock, and an expiry drops commands
+  if (clientOverlaps.total > 0) {
+    printf("FAIL: MQTT client used by two tasks at once\n");
+    pass = false;
+  }
+  if (broker.keepaliveDrops > 0) {
+    printf("FAIL: broker dropped the client %u times on keepalive\n",
+           broker.keepaliveDrops);
+    pass = false;
+  }
+  printf("\nResult: %s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+// Host benchmark of how the gateway reaches the first audio frame of an MP3
+// behind an ID3v2 tag, for tags of 0, 50 KB and 500 KB (album art).
+//
+// Three ways to get there, each against an in-memory file that counts the
+// read/seek calls and SD sectors touched:
+//   byte-wise - the tag walked frame by frame through 1-byte reads, as
+//               ESP8266Audio's AudioFileSourceID3 does (what playMP3 used)
+//   first     - first play of an unindexed file: 10-byte header, seek past
+//               the tag, quick Mp3Indexer build (title/artist only), decode
+//   indexed   - the <file>.mp3.idx sidecar read, then one seek to the first
+//               frame
+// The SD card is modelled from the gateway's 4 MHz SPI bus: a fixed cost
+// per library call plus the transfer of every 512-byte sector touched.
+// Sectors already in the FAT driver's one-sector cache are free.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/id3_skip_bench
+//       scripts/id3_skip_bench.cpp src/gateway_esp32/mp3_index.cpp
+//   /tmp/id3_skip_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "include/gateway_esp32/mp3_index.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define SD_SECTOR 512
+#define SD_US_PER_SECTOR 1250.0  // 512 B at ~400 KB/s over SPI
+#define SD_US_PER_CALL 12.0      // VFS + FatFs bookkeeping per read/seek
+#define DECODER_READ 1600        // libmad input buffer refill
+#define RUNS 200
+
+// ============================================================================
+// SYNTHETIC FILES
+// ============================================================================
+static void put32(std::vector<uint8_t>& d, uint32_t v) {
+  d.push_back(v >> 24), d.push_back(v >> 16), d.push_back(v >> 8),
+      d.push_back(v);
+}
+
+static void putFrame(std::vector<uint8_t>& d, const char* id,
+                     const std::vector<uint8_t>& body) {
+  d.insert(d.end(), id, id + 4);
+  put32(d, (uint32_t)body.size());
+  d.push_back(0), d.push_back(0);
+  d.insert(d.end(), body.begin(), body.end());
+}
+
+static std::vector<uint8_t> textFrame(const char* text) {
+  std::vector<uint8_t> b(1, 0);  // ISO-8859-1
+  b.insert(b.end(), text, text + strlen(text));
+  return b;
+}
+
+// ID3v2.3 tag of about tagBytes (0: none) followed by 1 MB of CBR frames
+static std::vector<uint8_t> makeFile(size_t tagBytes) {
+  std::mt19937 rng(89);
+  std::vector<uint8_t> d;
+  if (tagBytes) {
+    std::vector<uint8_t> body;
+    putFrame(body, "TIT2", textFrame("Morning Birds"));
+    putFrame(body, "TPE1", textFrame("Field Recordings"));
+    putFrame(body, "TALB", textFrame("Alarm Tones Vol. 2"));
+    putFrame(body, "COMM", textFrame("eng\0Recorded at dawn"));
+    // Album art fills the rest, then a little padding
+    std::vector<uint8_t> art = {0, 'i', 'm', 'a', 'g', 'e', '/', 'j',
+                                'p', 'e', 'g', 0,   3,   0};
+    size_t fill = tagBytes > body.size() + 10 + 10 + 256
+                      ? tagBytes - body.size() - 10 - 10 - 256
+                      : 0;
+    while (art.size() < fill) art.push_back((uint8_t)rng());
+    if (fill) putFrame(body, "APIC", art);
+    body.resize(body.size() + 256, 0);
+
+    uint32_t n = (uint32_t)body.size();
+    const uint8_t hdr[] = {'I', 'D', '3', 3, 0, 0};
+    d.assign(hdr, hdr + sizeof(hdr));
+    d.push_back((n >> 21) & 0x7F), d.push_back((n >> 14) & 0x7F),
+        d.push_back((n >> 7) & 0x7F), d.push_back(n & 0x7F);
+    d.insert(d.end(), body.begin(), body.end());
+  }
+
+  // 128 kbps, 44.1 kHz: 417/418-byte frames
+  uint32_t rem = 0;
+  size_t audio = d.size();
+  while (d.size() - audio < 1048576) {
+    rem += 144 * 128000 % 44100;
+    bool pad = rem >= 44100;
+    if (pad) rem -= 44100;
+    size_t len = 144 * 128000 / 44100 + (pad ? 1 : 0);
+    size_t at = d.size();
+    d.resize(at + len);
+    d[at] = 0xFF, d[at + 1] = 0xFB, d[at + 2] = 0x90 | (pad ? 2 : 0),
+    d[at + 3] = 0x44;
+    for (size_t i = 4; i < len; i++) {
+      uint8_t b = (uint8_t)rng();
+      d[at + i] = b == 0xFF ? 0xFE : b;
+    }
+  }
+  return d;
+}
+
+// ============================================================================
+// SIMULATED SD FILE
+// ============================================================================
+struct SdFile {
+  const std::vector<uint8_t>* data;
+  uint32_t pos;
+  uint32_t calls;
+  uint32_t sectors;
+  int64_t cached;  // Sector in the driver's cache, -1 for none
+
+  explicit SdFile(const std::vector<uint8_t>* d)
+      : data(d), pos(0), calls(0), sectors(0), cached(-1) {}
+
+  void touch(uint32_t from, uint32_t to) {
+    for (int64_t s = from / SD_SECTOR; s <= (int64_t)(to - 1) / SD_SECTOR;
+         s++) {
+      if (s != cached) sectors++;
+      cached = s;
+    }
+  }
+  size_t read(uint8_t* buf, size_t len) {
+    calls++;
+    if (pos >= data->size()) return 0;
+    size_t n = std::min(len, data->size() - pos);
+    memcpy(buf, data->data() + pos, n);
+    touch(pos, pos + (uint32_t)n);
+    pos += (uint32_t)n;
+    return n;
+  }
+  void seek(uint32_t to) {
+    calls++;
+    pos = to;
+  }
+  double sdUs() const {
+    return calls * SD_US_PER_CALL + sectors * SD_US_PER_SECTOR;
+  }
+};
+
+static size_t sdRead(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  SdFile* f = (SdFile*)ctx;
+  f->seek(offset);
+  return f->read(buf, len);
+}
+
+// ============================================================================
+// STRATEGIES - each returns the offset of the first audio frame
+// ============================================================================
+static uint8_t getByte(SdFile& f) {
+  uint8_t b = 0;
+  f.read(&b, 1);
+  return b;
+}
+
+// AudioFileSourceID3: header, then every frame header and body byte by byte
+static uint32_t byteWise(SdFile& f) {
+  uint8_t hdr[10];
+  f.read(hdr, 10);
+  uint32_t tag = id3v2TagSize(hdr);
+  if (tag) {
+    uint32_t end = tag;
+    while (f.pos + 10 <= end) {
+      uint8_t fh[10];
+      for (int i = 0; i < 10; i++) fh[i] = getByte(f);
+      if (fh[0] == 0) {  // Padding: consumed up to the end of the tag
+        while (f.pos < end) getByte(f);
+        break;
+      }
+      uint32_t size = (uint32_t)fh[4] << 24 | (uint32_t)fh[5] << 16 |
+                      (uint32_t)fh[6] << 8 | fh[7];
+      for (uint32_t i = 0; i < size && f.pos < end; i++) getByte(f);
+    }
+  } else {
+    f.seek(0);
+  }
+  uint8_t first[DECODER_READ];
+  uint32_t at = f.pos;
+  f.read(first, sizeof(first));
+  return at;
+}
+
+static uint8_t scratch[4096];
+
+static uint32_t firstPlay(SdFile& f, Mp3Index& index) {
+  Mp3Indexer indexer(sdRead, &f, (uint32_t)f.data->size(), scratch,
+                     sizeof(scratch));
+  if (!indexer.build(index, false)) return UINT32_MAX;
+  uint8_t first[DECODER_READ];
+  f.seek(index.h.audioStart);
+  f.read(first, sizeof(first));
+  return index.h.audioStart;
+}
+
+static uint32_t indexed(SdFile& f, SdFile& sidecar, Mp3Index& index) {
+  sidecar.read((uint8_t*)&index, sizeof(index));
+  uint8_t first[DECODER_READ];
+  f.seek(index.h.audioStart);
+  f.read(first, sizeof(first));
+  return index.h.audioStart;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+static void report(const char* name, const SdFile& f, double hostUs,
+                   uint32_t at, uint32_t expect) {
+  printf("  %-9s %7u calls %5u sectors  SD ~%8.1f ms  host %8.2f us  %s\n",
+         name, (unsigned)f.calls, (unsigned)f.sectors, f.sdUs() / 1000,
+         hostUs, at == expect ? "ok" : "WRONG OFFSET");
+}
+
+int main() {
+  const size_t tags[] = {0, 50 * 1024, 500 * 1024};
+  bool ok = true;
+
+  for (size_t tagBytes : tags) {
+    std::vector<uint8_t> file = makeFile(tagBytes);
+    uint32_t expect = id3v2TagSize(file.data());
+    printf("Tag %zu KB (first frame at byte %u)\n", tagBytes / 1024,
+           (unsigned)expect);
+
+    static Mp3Index index;
+    SdFile a(&file), b(&file), c(&file);
+    uint32_t atA = 0, atB = 0, atC = 0;
+
+    auto t0 = Clock::now();
+    for (int r = 0; r < RUNS; r++) {
+      a = SdFile(&file);
+      atA = byteWise(a);
+    }
+    double usA =
+        std::chrono::duration<double, std::micro>(Clock::now() - t0).count() /
+        RUNS;
+
+    t0 = Clock::now();
+    for (int r = 0; r < RUNS; r++) {
+      b = SdFile(&file);
+      atB = firstPlay(b, index);
+    }
+    double usB =
+        std::chrono::duration<double, std::micro>(Clock::now() - t0).count() /
+        RUNS;
+
+    // Sidecar as the gateway stores it
+    std::vector<uint8_t> idx((uint8_t*)&index,
+                             (uint8_t*)&index + index.storedSize());
+    SdFile side(&idx);
+    t0 = Clock::now();
+    for (int r = 0; r < RUNS; r++) {
+      c = SdFile(&file);
+      side = SdFile(&idx);
+      atC = indexed(c, side, index);
+    }
+    double usC =
+        std::chrono::duration<double, std::micro>(Clock::now() - t0).count() /
+        RUNS;
+    c.calls += side.calls;
+    c.sectors += side.sectors;
+
+    report("byte-wise", a, usA, atA, expect);
+    report("first", b, usB, atB, expect);
+    report("indexed", c, usC, atC, expect);
+    if (tagBytes) {
+      printf("  tags: title \"%s\", artist \"%s\"\n", index.h.title,
+             index.h.artist);
+      ok &= !strcmp(index.h.title, "Morning Birds") &&
+            !strcmp(index.h.artist, "Field Recordings");
+    }
+    ok &= atA == expect && atB == expect && atC == expect;
+    printf("\n");
+  }
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+// Host simulation of the gateway's I2S latency profiles
+// (include/gateway_esp32/latency_profile.h).
+//
+// Plays a playlist of 30 s tracks through the real PcmRing and
+// LatencyGovernor in virtual time (100 us ticks, deterministic):
+//   output task - every 5 ms (late by up to the scenario's jitter), moves
+//                 frames from the ring into the I2S DMA, which drains at
+//                 44.1 kHz
+//   decode task - every 10 ms, when the ring is below its refill mark,
+//                 decodes MP3 frames (4.5 ms of CPU each: libmad plus the
+//                 resampler and DSP chain) until the ring is full
+//   load        - a higher-priority CPU hog in bursts (WiFi, MQTT, display)
+//                 that the decode task cannot run through, and SD card
+//                 stalls that block it outright (30-120 ms, as in
+//                 pcm_ring_sim.cpp)
+// For each load scenario it runs every profile fixed, and "auto": the low
+// profile with automatic switching, which deepens the ring at once and the
+// DMA buffers with the next track, as on the device. Prints the audio
+// buffered between decoder and DAC (the latency a live stream would see),
+// audible DMA underruns per minute and silence.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/latency_sim scripts/latency_profile_sim.cpp
+//       src/gateway_esp32/latency_profile.cpp src/gateway_esp32/pcm_ring.cpp
+//   /tmp/latency_sim [minutes]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "include/gateway_esp32/latency_profile.h"
+#include "include/gateway_esp32/pcm_ring.h"
+
+#define RATE_HZ 44100
+#define TICK_US 100
+#define MP3_FRAME 1152
+#define DECODE_US 4500  // CPU per MP3 frame, decoder + resampler + DSP
+#define OUTPUT_PERIOD_US 5000
+#define DECODE_PERIOD_US 10000
+#define TRACK_S 30
+#define GAP_S 1
+
+struct Scenario {
+  const char* name;
+  double duty;       // Share of the CPU the hog takes
+  double burstMs;    // Mean length of one hog burst
+  double stallRate;  // SD stalls per MP3 frame
+  int stallMinMs, stallMaxMs;
+  int jitterMs;  // Output task released up to this late
+};
+
+static const Scenario kScenarios[] = {
+    {"idle", 0.0, 0, 0, 0, 0, 0},
+    {"busy", 0.4, 4, 0, 0, 0, 1},
+    {"wifi_heavy", 0.5, 10, 1.0 / 80, 30, 120, 3},
+};
+
+// Deterministic across hosts and standard libraries
+class Rng {
+ public:
+  explicit Rng(uint64_t seed) : s(seed) {}
+  double uniform() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return (s >> 11) * (1.0 / 9007199254740992.0);
+  }
+  double exponential(double mean) { return -mean * log(1.0 - uniform()); }
+
+ private:
+  uint64_t s;
+};
+
+struct Result {
+  double bufferedMeanMs;
+  double bufferedP99Ms;
+  uint32_t underruns;
+  double silenceMs;
+  double minutes;
+  uint32_t switches;
+  LatencyProfile finalProfile;
+};
+
+static PcmRing ring;
+
+static Result run(const Scenario& sc, LatencyProfile profile, bool automatic,
+                  double minutes) {
+  Rng rng(0x5eed1234);
+  LatencyGovernor governor;
+  governor.configure(profile, automatic);
+  ring.flush();
+  ring.setDepth(latencyProfileSpec(governor.active()).ringFrames);
+  uint32_t dmaFrames =
+      latencyProfileSpec(governor.active()).dmaBuffers * I2S_DMA_BUF_FRAMES;
+
+  const uint64_t totalTicks = (uint64_t)(minutes * 60e6 / TICK_US);
+  const uint64_t trackTicks = (uint64_t)TRACK_S * 1000000 / TICK_US;
+  const uint64_t cycleTicks = trackTicks + (uint64_t)GAP_S * 1000000 / TICK_US;
+  const double framesPerTick = RATE_HZ * TICK_US / 1e6;
+
+  double dmaQueued = 0;
+  bool dry = false;
+  bool primed = false;  // The track's first audio reached the DAC
+  uint32_t underruns = 0;
+  double silenceMs = 0;
+
+  // Hog: alternating busy and idle spells
+  bool hogBusy = false;
+  double hogLeftUs = sc.duty > 0 ? rng.exponential(sc.burstMs * 1000) : 1e18;
+  // Decode task
+  bool bursting = false;
+  uint32_t pending = 0;      // Decoded frames not yet in the ring
+  double decodeLeftUs = 0;   // CPU still needed by the frame being decoded
+  double stallLeftUs = 0;    // SD stall blocking the task
+  uint64_t framesLeft = 0;   // Audio frames of the track still to decode
+  // Output task
+  uint64_t nextOutputTick = 0;
+
+  std::vector<uint32_t> histogram(2000, 0);  // Buffered audio, 1 ms bins
+  double bufferedSum = 0;
+  uint64_t streamingTicks = 0;
+  bool streaming = false;
+
+  for (uint64_t t = 0; t < totalTicks; t++) {
+    uint64_t inCycle = t % cycleTicks;
+    uint32_t nowMs = (uint32_t)(t * TICK_US / 1000);
+
+    // Track boundaries: the device applies new DMA buffers between tracks
+    if (inCycle == 0) {
+      uint32_t want =
+          latencyProfileSpec(governor.active()).dmaBuffers * I2S_DMA_BUF_FRAMES;
+      if (want != dmaFrames) {
+        dmaFrames = want;
+        dmaQueued = 0;
+      }
+      ring.flush();  // cleanup() before every play
+      framesLeft = (uint64_t)TRACK_S * RATE_HZ;
+      pending = 0;
+      decodeLeftUs = 0;
+      bursting = false;
+      streaming = true;
+      primed = false;
+    }
+
+    // Hog
+    hogLeftUs -= TICK_US;
+    if (hogLeftUs <= 0) {
+      hogBusy = !hogBusy;
+      double mean = hogBusy ? sc.burstMs * 1000
+                            : sc.burstMs * 1000 * (1 - sc.duty) / sc.duty;
+      hogLeftUs += rng.exponential(mean);
+    }
+
+    // Decode task: released every period, bursts while the ring has room
+    if (t % (DECODE_PERIOD_US / TICK_US) == 0) {
+      if (automatic && governor.update(ring.underruns(), nowMs)) {
+        ring.setDepth(latencyProfileSpec(governor.active()).ringFrames);
+      }
+      if (!bursting && (framesLeft || pending || decodeLeftUs > 0) &&
+          ring.fill() < ring.refillMark()) {
+        bursting = true;
+      }
+    }
+    if (bursting) {
+      if (stallLeftUs > 0) {
+        stallLeftUs -= TICK_US;
+      } else if (decodeLeftUs > 0) {
+        if (!hogBusy) {
+          decodeLeftUs -= TICK_US;
+          if (decodeLeftUs <= 0) pending = MP3_FRAME;
+        }
+      } else {
+        static int16_t silence[2 * MP3_FRAME];
+        if (pending) pending -= ring.write(silence, pending);
+        if (pending) {
+          bursting = false;  // Ring full: the burst ends
+        } else if (framesLeft) {
+          uint32_t n = framesLeft < MP3_FRAME ? (uint32_t)framesLeft : MP3_FRAME;
+          framesLeft -= n;
+          decodeLeftUs = DECODE_US * n / MP3_FRAME;
+          if (sc.stallRate > 0 && rng.uniform() < sc.stallRate) {
+            stallLeftUs = (sc.stallMinMs + rng.uniform() * (sc.stallMaxMs -
+                                                            sc.stallMinMs)) *
+                          1000;
+          }
+        } else {
+          bursting = false;
+          ring.finish();  // Track decoded: what is left plays out
+        }
+      }
+    }
+
+    // Output task: highest priority, only ISR jitter delays it
+    if (t >= nextOutputTick) {
+      uint32_t space = dmaFrames - (uint32_t)ceil(dmaQueued);
+      static int16_t chunk[2 * 16 * I2S_DMA_BUF_FRAMES];
+      uint32_t n = ring.read(chunk, space);
+      dmaQueued += n;
+      if (n < space) ring.noteStarved();
+      uint64_t period = OUTPUT_PERIOD_US / TICK_US;
+      nextOutputTick = (t / period + 1) * period;
+      if (sc.jitterMs) {
+        nextOutputTick += (uint64_t)(rng.uniform() * sc.jitterMs * 1000 /
+                                     TICK_US);
+      }
+    }
+
+    // DAC
+    bool playing = inCycle < trackTicks && (framesLeft || pending ||
+                                            decodeLeftUs > 0 || ring.fill());
+    if (dmaQueued >= framesPerTick) {
+      dmaQueued -= framesPerTick;
+      dry = false;
+      primed = true;
+    } else {
+      if (playing && primed) {
+        silenceMs += (framesPerTick - dmaQueued) * 1000.0 / RATE_HZ;
+        if (!dry) underruns++;
+        dry = true;
+      }
+      dmaQueued = 0;
+    }
+    if (!playing && streaming && inCycle >= trackTicks) streaming = false;
+
+    if (streaming && playing && primed) {
+      double ms = (ring.fill() + dmaQueued) * 1000.0 / RATE_HZ;
+      bufferedSum += ms;
+      histogram[std::min<size_t>((size_t)ms, histogram.size() - 1)]++;
+      streamingTicks++;
+    }
+  }
+
+  Result r;
+  r.bufferedMeanMs = streamingTicks ? bufferedSum / streamingTicks : 0;
+  uint64_t acc = 0;
+  r.bufferedP99Ms = 0;
+  for (size_t i = 0; i < histogram.size(); i++) {
+    acc += histogram[i];
+    if (acc >= streamingTicks * 99 / 100) {
+      r.bufferedP99Ms = (double)i + 1;
+      break;
+    }
+  }
+  r.underruns = underruns;
+  r.silenceMs = silenceMs;
+  r.minutes = minutes;
+  r.switches = governor.switches();
+  r.finalProfile = governor.active();
+  return r;
+}
+
+int main(int argc, char** argv) {
+  double minutes = argc > 1 ? atof(argv[1]) : 10.0;
+  bool ok = true;
+
+  printf("Profiles (DMA %u-frame buffers + ring, full):\n", I2S_DMA_BUF_FRAMES);
+  for (int p = 0; p < LATENCY_PROFILE_COUNT; p++) {
+    const LatencyProfileSpec& s = latencyProfileSpec((LatencyProfile)p);
+    printf("  %-8s %2u DMA + %4u ring frames = %3u ms\n", s.name,
+           (unsigned)s.dmaBuffers, (unsigned)s.ringFrames,
+           (unsigned)latencyProfileMs((LatencyProfile)p, RATE_HZ));
+  }
+  printf("\n%.0f virtual minutes per run, %d s tracks\n", minutes, TRACK_S);
+
+  for (const Scenario& sc : kScenarios) {
+    printf("\n%s (hog %.0f%% in %.0f ms bursts, SD stalls %s, output jitter "
+           "%d ms):\n",
+           sc.name, sc.duty * 100, sc.burstMs,
+           sc.stallRate > 0 ? "30-120 ms" : "none", sc.jitterMs);
+    printf("  %-8s %9s %9s %11s %10s  %s\n", "profile", "buf mean", "buf p99",
+           "underr/min", "silence", "auto");
+    Result fixed[LATENCY_PROFILE_COUNT];
+    for (int p = 0; p <= LATENCY_PROFILE_COUNT; p++) {
+      bool automatic = p == LATENCY_PROFILE_COUNT;
+      Result r = run(sc, automatic ? LATENCY_LOW : (LatencyProfile)p, automatic,
+                     minutes);
+      printf("  %-8s %6.1f ms %6.0f ms %11.2f %7.0f ms",
+             automatic ? "auto" : latencyProfileSpec((LatencyProfile)p).name,
+             r.bufferedMeanMs, r.bufferedP99Ms, r.underruns / r.minutes,
+             r.silenceMs);
+      if (automatic) {
+        printf("  %u switches, ends %s", (unsigned)r.switches,
+               latencyProfileSpec(r.finalProfile).name);
+      } else {
+        fixed[p] = r;
+        // Buffering never exceeds what the profile provides
+        ok &= r.bufferedP99Ms <=
+              latencyProfileMs((LatencyProfile)p, RATE_HZ) + 1;
+      }
+      printf("\n");
+      if (automatic) {
+        // Most of the low profile's gaps gone, and the steps back towards
+        // it back off instead of flapping
+        ok &= r.underruns * 10 <= fixed[LATENCY_LOW].underruns &&
+              r.switches <= 2 + (uint32_t)(minutes * 60000 / LATENCY_RELAX_MS);
+      }
+    }
+    // Deeper buffers trade latency for fewer gaps
+    for (int p = 1; p < LATENCY_PROFILE_COUNT; p++) {
+      ok &= fixed[p].bufferedMeanMs > fixed[p - 1].bufferedMeanMs &&
+            fixed[p].underruns <= fixed[p - 1].underruns;
+    }
+    // Without SD stalls only the low profile may break up; idle, none
+    if (sc.stallRate == 0) {
+      ok &= fixed[LATENCY_BALANCED].underruns == 0 &&
+            fixed[LATENCY_ROBUST].underruns == 0;
+    }
+    if (sc.duty == 0) ok &= fixed[LATENCY_LOW].underruns == 0;
+  }
+
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
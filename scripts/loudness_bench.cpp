@@ -0,0 +1,121 @@
+// Host benchmark of the gateway's streaming loudness meter
+// (include/gateway_esp32/loudness.h).
+//
+// Checks the meter against the EBU Tech 3341 integrated-loudness cases
+// (stereo 1 kHz sines at set levels, including the gating cases). Then it
+// measures its real-time factor at 44.1 kHz on a 3-minute noise track,
+// feeding MP3-frame-sized bursts as the gateway's background pass does.
+// It also prints the gain that would be stored in the audio index and the
+// meter's fixed memory footprint.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/loudness_bench
+//       scripts/loudness_bench.cpp src/gateway_esp32/loudness.cpp
+//   /tmp/loudness_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "include/gateway_esp32/loudness.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define RATE 48000      // Tech 3341 signals are specified at 48 kHz
+#define MP3_FRAME 1152  // Samples per decoded MP3 frame
+
+struct Segment {
+  float dbfs;
+  float seconds;
+};
+
+// Stereo 1 kHz sine, both channels, at each segment's level
+static std::vector<int16_t> sines(const std::vector<Segment>& segments) {
+  std::vector<int16_t> pcm;
+  double phase = 0;
+  for (const Segment& s : segments) {
+    double amp = pow(10.0, s.dbfs / 20.0) * 32767.0;
+    size_t n = (size_t)(s.seconds * RATE);
+    for (size_t i = 0; i < n; i++) {
+      int16_t v = (int16_t)lrint(amp * sin(phase));
+      pcm.push_back(v);
+      pcm.push_back(v);
+      phase += 2 * M_PI * 1000.0 / RATE;
+    }
+  }
+  return pcm;
+}
+
+static void feed(LoudnessMeter& meter, const std::vector<int16_t>& pcm) {
+  uint32_t frames = (uint32_t)(pcm.size() / 2);
+  for (uint32_t i = 0; i < frames; i += MP3_FRAME) {
+    uint32_t n = frames - i < MP3_FRAME ? frames - i : MP3_FRAME;
+    meter.add(&pcm[2 * i], n);
+  }
+}
+
+int main() {
+  struct Case {
+    const char* name;
+    std::vector<Segment> segments;
+    float expect;
+  } cases[] = {
+      {"3341 #1  -23 dBFS", {{-23, 20}}, -23},
+      {"3341 #2  -33 dBFS", {{-33, 20}}, -33},
+      {"3341 #3  -36/-23/-36", {{-36, 10}, {-23, 60}, {-36, 10}}, -23},
+      {"3341 #4  -72/-36/-23/-36/-72",
+       {{-72, 10}, {-36, 10}, {-23, 60}, {-36, 10}, {-72, 10}},
+       -23},
+      {"3341 #5  -26/-20/-26", {{-26, 20}, {-20, 20.1f}, {-26, 20}}, -23},
+  };
+
+  static LoudnessMeter meter;
+  bool ok = true;
+  printf("Tech 3341 conformance (tolerance +/-0.1 LU):\n");
+  for (const Case& c : cases) {
+    meter.reset();
+    meter.setRate(RATE);
+    feed(meter, sines(c.segments));
+    float lufs = meter.integratedLufs();
+    bool pass = fabsf(lufs - c.expect) <= 0.1f;
+    ok &= pass;
+    printf("  %-30s %7.2f LUFS (expect %.1f)  %s\n", c.name, lufs, c.expect,
+           pass ? "ok" : "FAIL");
+  }
+
+  // 3 minutes of pink-ish noise at 44.1 kHz, as a decoded track would come
+  const uint32_t rate = 44100, seconds = 180;
+  std::vector<int16_t> pcm((size_t)rate * seconds * 2);
+  std::mt19937 rng(90);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  float lp = 0;
+  for (size_t i = 0; i < pcm.size(); i += 2) {
+    lp = 0.97f * lp + 0.03f * noise(rng);
+    float v = lp * 0.9f * 32767.0f / 2.0f;
+    v = v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+    pcm[i] = pcm[i + 1] = (int16_t)v;
+  }
+
+  meter.reset();
+  meter.setRate(rate);
+  auto t0 = Clock::now();
+  feed(meter, pcm);
+  float lufs = meter.integratedLufs();
+  double cpu = std::chrono::duration<double>(Clock::now() - t0).count();
+  double ns = cpu * 1e9 / ((double)rate * seconds);
+
+  printf("\nStreaming, %u s at %u Hz in %u-frame bursts:\n",
+         (unsigned)seconds, (unsigned)rate, MP3_FRAME);
+  printf("  %.2f LUFS, peak %.3f, %u blocks -> gain %+.2f dB to %.0f LUFS\n",
+         lufs, meter.peak(), (unsigned)meter.blocks(),
+         meter.gainDb(LOUDNESS_TARGET_LUFS), LOUDNESS_TARGET_LUFS);
+  printf("  %.1f ms CPU, %.1f ns per stereo frame, real-time factor %.0fx\n",
+         cpu * 1000, ns, 1e9 / (ns * rate));
+  printf("  memory: %zu bytes, independent of track length\n",
+         sizeof(LoudnessMeter));
+
+  printf("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
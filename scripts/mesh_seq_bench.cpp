@@ -0,0 +1,153 @@
+// Host check of the gateway's per-origin loss accounting (meshSeqLost() in
+// include/shared/espnow_mesh.h, used by MeshStats).
+//
+// Fixed cases first: frames in order, gaps, a frame overtaken by its
+// successor on a faster relay path, duplicates, the uint16 wrap, a node
+// reboot. Then a random stream per seed: three origins, 2% of frames lost
+// on air, a share of them sent over a slower relay path so they arrive
+// behind later frames, and relayed duplicates, all through MeshDedupCache
+// as in the gateway's receive callback. A late frame has already been
+// counted when its successor arrived, so the loss counted must be exactly
+// the frames lost plus the frames that arrived late. For comparison the
+// stream is also counted the old way, which moved the last sequence back
+// on every late frame and counted its successors a second time.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/mesh_seq_bench scripts/mesh_seq_bench.cpp
+//   /tmp/mesh_seq_bench [seed]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "include/shared/espnow_mesh.h"
+
+#define ORIGINS 3
+#define FRAMES 20000  // Per origin, so the sequence wraps
+#define LOSS 0.02
+#define SLOW_PATH 0.10  // Frames taking the slower relay path
+#define DUPLICATES 0.05
+
+// ============================================================================
+// FIXED CASES
+// ============================================================================
+struct Case {
+  const char* name;
+  std::vector<uint16_t> seqs;
+  uint32_t lost;
+};
+
+static uint32_t countLost(const std::vector<uint16_t>& seqs) {
+  uint16_t last = seqs[0];
+  uint32_t lost = 0;
+  for (size_t i = 1; i < seqs.size(); i++) lost += meshSeqLost(&last, seqs[i]);
+  return lost;
+}
+
+static bool runCases() {
+  const Case cases[] = {
+      {"in order", {1, 2, 3, 4, 5}, 0},
+      {"gap of two", {1, 2, 5, 6}, 2},
+      {"overtaken frame", {1, 2, 4, 3, 5, 6}, 1},
+      {"two overtaken", {10, 13, 11, 12, 14}, 2},
+      {"repeat", {7, 8, 8, 9}, 0},
+      {"wrap", {65533, 65534, 65535, 0, 1}, 0},
+      {"overtaken at wrap", {65534, 0, 65535, 1}, 1},
+      {"reboot", {4000, 4001, 0, 1, 2}, 0},
+      {"reboot to a low seq", {100, 101, 0, 1, 3}, 1},
+      {"jump ahead", {5, 6, 3000, 3001}, 0},
+  };
+  bool ok = true;
+  printf("%-22s %8s %8s\n", "case", "lost", "expect");
+  for (const Case& c : cases) {
+    uint32_t lost = countLost(c.seqs);
+    bool pass = lost == c.lost;
+    printf("%-22s %8u %8u%s\n", c.name, lost, c.lost, pass ? "" : "  FAIL");
+    ok &= pass;
+  }
+  return ok;
+}
+
+// ============================================================================
+// RANDOM STREAM
+// ============================================================================
+struct Arrival {
+  uint32_t atMs;
+  uint8_t origin;
+  uint16_t seq;
+  bool operator<(const Arrival& o) const {
+    return atMs != o.atMs ? atMs < o.atMs : origin < o.origin;
+  }
+};
+
+int main(int argc, char** argv) {
+  unsigned seed = argc > 1 ? (unsigned)strtoul(argv[1], nullptr, 10) : 1;
+  bool ok = runCases();
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  std::vector<Arrival> air;
+  uint32_t sent = 0, lostOnAir = 0;
+  for (int o = 0; o < ORIGINS; o++) {
+    uint16_t seq = (uint16_t)(60000 + 1000 * o);  // Wraps within the run
+    for (int i = 0; i < FRAMES; i++, seq++) {
+      sent++;
+      // The first frame of each origin arrives first, as the baseline, and
+      // the last one arrives, so every loss is followed by a frame
+      bool first = i == 0;
+      if (!first && i < FRAMES - 1 && u(rng) < LOSS) {
+        lostOnAir++;
+        continue;
+      }
+      // Every 5 s; the slow path holds a frame up to 12 s in a relay queue
+      uint32_t at = 5000u * i + 200 * o + (uint32_t)(u(rng) * 50);
+      if (!first && u(rng) < SLOW_PATH) {
+        at += 2000 + (uint32_t)(u(rng) * 10000);
+      }
+      air.push_back({at, (uint8_t)(o + 1), seq});
+      if (u(rng) < DUPLICATES) {
+        air.push_back({at + 20 + (uint32_t)(u(rng) * 500), (uint8_t)(o + 1),
+                       seq});
+      }
+    }
+  }
+  std::sort(air.begin(), air.end());
+
+  MeshDedupCache dedup;
+  uint16_t last[ORIGINS + 1], oldLast[ORIGINS + 1];
+  bool seen[ORIGINS + 1] = {};
+  uint32_t counted = 0, oldCounted = 0, late = 0, duplicates = 0;
+  for (const Arrival& a : air) {
+    if (dedup.checkAndInsert(a.origin, a.seq)) {
+      duplicates++;
+      continue;
+    }
+    if (!seen[a.origin]) {
+      seen[a.origin] = true;
+      last[a.origin] = oldLast[a.origin] = a.seq;
+      continue;
+    }
+    if ((int16_t)(a.seq - last[a.origin]) < 0) late++;
+    counted += meshSeqLost(&last[a.origin], a.seq);
+
+    uint16_t gap = (uint16_t)(a.seq - oldLast[a.origin] - 1);
+    if (gap < 1000) oldCounted += gap;
+    oldLast[a.origin] = a.seq;
+  }
+
+  uint32_t expect = lostOnAir + late;
+  bool streamOk = counted == expect;
+  printf("\nStream (seed %u): %u frames sent, %u lost on air, %u arrived late, "
+         "%u duplicates dropped\n",
+         seed, sent, lostOnAir, late, duplicates);
+  printf("  counted lost: %u (expected %u)%s\n", counted, expect,
+         streamOk ? "" : "  FAIL");
+  printf("  old accounting: %u (%.1fx the frames lost or late)\n", oldCounted,
+         expect ? (double)oldCounted / expect : 0.0);
+  ok &= streamOk;
+
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
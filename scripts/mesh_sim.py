@@ -0,0 +1,312 @@
+#!/usr/bin/env python3
+"""
+ESP-NOW Mesh Simulation
+Host-side model of the sensor node relay protocol (include/shared/espnow_mesh.h)
+
+Places N nodes around a gateway, runs beacons, ETX/RSSI parent selection,
+store-and-forward relaying with a hop limit and (node, seq) duplicate
+suppression, then prints the per-hop latency and loss the gateway would see.
+
+Usage:
+    python mesh_sim.py                      # 50 nodes, 1 hour
+    python mesh_sim.py --nodes 20 --relays 0.3 --hours 6 --seed 7
+"""
+
+import argparse
+import math
+import random
+from collections import defaultdict
+
+# Mirrors the constants in include/shared/espnow_mesh.h
+MAX_HOPS = 4
+DEDUP_SLOTS = 32
+SEQ_REORDER = 32
+SEQ_REBOOT = 1000
+BEACON_INTERVAL_MS = 10000
+NEIGHBOR_TIMEOUT_MS = 35000
+MIN_RSSI = -88
+ETX_SCALE = 100
+ETX_UNREACHABLE = 0xFFFF
+
+SENSOR_INTERVAL_MS = 5000
+RELAY_MAX_HOLD_MS = 30000
+RELAY_QUEUE_SIZE = 8
+MAC_RETRIES = 3          # ESP-NOW unicast retransmissions before failure
+AIRTIME_MS = 1           # 50-byte frame at 1 Mbps plus ack, rounded up
+LOOP_PERIOD_MS = 10      # Node loop() cadence (delay(10))
+
+
+def rssi_at(distance_m, shadow_db):
+    """Log-distance path loss, 20 dBm TX, exponent 3."""
+    d = max(distance_m, 1.0)
+    return 20 - 40 - 30 * math.log10(d) + shadow_db
+
+
+def prr_from_rssi(rssi):
+    """Per-attempt reception probability, logistic around -85 dBm."""
+    return 1.0 / (1.0 + math.exp(-(rssi + 85) / 2.0))
+
+
+class Neighbor:
+    def __init__(self, node_id, last_seq):
+        self.node_id = node_id
+        self.hops = 0
+        self.path_etx = ETX_UNREACHABLE
+        self.last_seq = last_seq
+        self.prr = 192
+        self.rssi = 0
+        self.last_heard = 0
+
+    def update(self, ok):
+        target = 255 if ok else 0
+        self.prr = self.prr + int((target - self.prr) / 8)
+
+    def link_etx(self):
+        if self.prr < 16:
+            return ETX_UNREACHABLE
+        return min(ETX_SCALE * 255 * 255 // (self.prr * self.prr), 0xFFFE)
+
+    def path_cost(self):
+        if self.path_etx == ETX_UNREACHABLE or self.hops + 1 > MAX_HOPS:
+            return ETX_UNREACHABLE
+        if self.rssi != 0 and self.rssi < MIN_RSSI:
+            return ETX_UNREACHABLE
+        link = self.link_etx()
+        if link == ETX_UNREACHABLE:
+            return ETX_UNREACHABLE
+        return min(self.path_etx + link, ETX_UNREACHABLE - 1)
+
+
+class Node:
+    def __init__(self, node_id, x, y, relay):
+        self.id = node_id
+        self.x, self.y = x, y
+        self.relay = relay
+        self.neighbors = {}
+        self.parent = None
+        self.seq = 0
+        self.beacon_seq = 0
+        self.dedup = []
+        self.queue = []  # (frame, enqueued_at)
+
+    def best_parent(self):
+        best, best_cost = None, ETX_UNREACHABLE
+        for n in self.neighbors.values():
+            cost = n.path_cost()
+            if cost == ETX_UNREACHABLE:
+                continue
+            if best is None or cost + 10 < best_cost:
+                best, best_cost = n, cost
+            elif abs(cost - best_cost) <= 10 and n.rssi > best.rssi:
+                best, best_cost = n, cost
+        return best
+
+    def seen(self, origin, seq):
+        key = (origin, seq)
+        if key in self.dedup:
+            return True
+        self.dedup.append(key)
+        if len(self.dedup) > DEDUP_SLOTS:
+            self.dedup.pop(0)
+        return False
+
+
+class Network:
+    def __init__(self, nodes, relay_fraction, radius, seed):
+        self.rng = random.Random(seed)
+        self.nodes = {}
+        for i in range(1, nodes + 1):
+            r = radius * math.sqrt(self.rng.random())
+            a = self.rng.uniform(0, 2 * math.pi)
+            relay = self.rng.random() < relay_fraction
+            self.nodes[i] = Node(i, r * math.cos(a), r * math.sin(a), relay)
+        self.pos = {0: (0.0, 0.0)}
+        for n in self.nodes.values():
+            self.pos[n.id] = (n.x, n.y)
+        # Static shadowing per link, symmetric
+        self.shadow = {}
+        self.gw_dedup = []
+        self.gw_last_seq = {}
+        self.stats = defaultdict(lambda: {"rx": 0, "lost": 0, "delay": []})
+        self.generated = 0
+        self.delivered = 0
+        self.duplicates = 0
+
+    def rssi(self, a, b):
+        key = (min(a, b), max(a, b))
+        if key not in self.shadow:
+            self.shadow[key] = self.rng.gauss(0, 4)
+        (ax, ay), (bx, by) = self.pos[a], self.pos[b]
+        return rssi_at(math.hypot(ax - bx, ay - by), self.shadow[key])
+
+    def attempt(self, a, b):
+        return self.rng.random() < prr_from_rssi(self.rssi(a, b))
+
+    def unicast(self, a, b):
+        """Returns (delivered, acked, attempts)."""
+        for attempt in range(1, MAC_RETRIES + 2):
+            if self.attempt(a, b):
+                # Ack can be lost: receiver has it, sender retries anyway
+                if self.attempt(b, a):
+                    return True, True, attempt
+                return True, False, attempt
+        return False, False, MAC_RETRIES + 1
+
+    def broadcast_beacon(self, sender_id, path_etx, hops, seq, now):
+        for node in self.nodes.values():
+            if node.id == sender_id or not self.attempt(sender_id, node.id):
+                continue
+            n = node.neighbors.get(sender_id)
+            if n is None:
+                n = Neighbor(sender_id, (seq - 1) & 0xFFFF)
+                node.neighbors[sender_id] = n
+            missed = min((seq - n.last_seq - 1) & 0xFFFF, 8)
+            for _ in range(missed):
+                n.update(False)
+            n.update(True)
+            n.hops, n.path_etx, n.last_seq, n.last_heard = hops, path_etx, seq, now
+            # Only the gateway link has a known RSSI (Soft AP association)
+            if sender_id == 0:
+                n.rssi = int(self.rssi(0, node.id))
+
+    def gateway_receive(self, frame):
+        origin, seq, hop, delay = frame
+        key = (origin, seq)
+        if key in self.gw_dedup:
+            self.duplicates += 1
+            return
+        self.gw_dedup.append(key)
+        if len(self.gw_dedup) > DEDUP_SLOTS:
+            self.gw_dedup.pop(0)
+        s = self.stats[hop]
+        s["rx"] += 1
+        last = self.gw_last_seq.get(origin)
+        if last is None:
+            self.gw_last_seq[origin] = seq
+        else:
+            # meshSeqLost(): a late frame neither counts nor rewinds the mark
+            ahead = (seq - last + 0x8000) % 0x10000 - 0x8000
+            if not -SEQ_REORDER < ahead <= 0:
+                self.gw_last_seq[origin] = seq
+                if 0 < ahead < SEQ_REBOOT:
+                    s["lost"] += ahead - 1
+        if hop > 1:
+            s["delay"].append(delay / (hop - 1))
+        self.delivered += 1
+
+    def send(self, node, frame, now):
+        """Transmit a frame to the node's parent. Returns False to retry."""
+        target = node.parent.node_id if node.parent else 0
+        ok, acked, attempts = self.unicast(node.id, target)
+        if node.parent:
+            node.parent.update(acked)
+        if not ok:
+            return acked
+        if target == 0:
+            self.gateway_receive(frame)
+        else:
+            relay = self.nodes[target]
+            origin, seq, hop, delay = frame
+            if relay.relay and origin != relay.id and not relay.seen(origin, seq):
+                if hop < MAX_HOPS and len(relay.queue) < RELAY_QUEUE_SIZE:
+                    relay.queue.append(((origin, seq, hop, delay), now))
+        return True
+
+    def run(self, duration_ms):
+        phases = {n.id: self.rng.randrange(SENSOR_INTERVAL_MS) for n in self.nodes.values()}
+        beacon_phase = {n.id: self.rng.randrange(BEACON_INTERVAL_MS) for n in self.nodes.values()}
+        gw_beacon_seq = 0
+        step = LOOP_PERIOD_MS * 10  # 100 ms resolution keeps 50 nodes fast
+
+        for now in range(0, duration_ms, step):
+            if now % BEACON_INTERVAL_MS == 0:
+                self.broadcast_beacon(0, 0, 0, gw_beacon_seq, now)
+                gw_beacon_seq = (gw_beacon_seq + 1) & 0xFFFF
+
+            for node in self.nodes.values():
+                for nid in [k for k, n in node.neighbors.items()
+                            if now - n.last_heard > NEIGHBOR_TIMEOUT_MS]:
+                    del node.neighbors[nid]
+                best = node.best_parent()
+                if best is not None:
+                    node.parent = best
+                elif node.parent and node.parent.node_id not in node.neighbors:
+                    node.parent = None
+
+                if node.relay and node.parent and \
+                        (now - beacon_phase[node.id]) % BEACON_INTERVAL_MS < step:
+                    cost = node.parent.path_cost()
+                    if cost != ETX_UNREACHABLE:
+                        self.broadcast_beacon(node.id, cost, node.parent.hops + 1,
+                                              node.beacon_seq, now)
+                        node.beacon_seq = (node.beacon_seq + 1) & 0xFFFF
+
+                # Store-and-forward queue
+                while node.queue:
+                    (origin, seq, hop, delay), t0 = node.queue[0]
+                    held = now - t0
+                    if held > RELAY_MAX_HOLD_MS:
+                        node.queue.pop(0)
+                        continue
+                    frame = (origin, seq, hop + 1, delay + held + LOOP_PERIOD_MS)
+                    if not self.send(node, frame, now):
+                        break
+                    node.queue.pop(0)
+
+                if (now - phases[node.id]) % SENSOR_INTERVAL_MS < step:
+                    frame = (node.id, node.seq, 1, 0)
+                    node.seq = (node.seq + 1) & 0xFFFF
+                    self.generated += 1
+                    self.send(node, frame, now)
+
+    def report(self, duration_ms):
+        relays = sum(1 for n in self.nodes.values() if n.relay)
+        print(f"Nodes: {len(self.nodes)} ({relays} relays), "
+              f"simulated {duration_ms / 3600000:.1f} h")
+        print(f"Generated {self.generated}, delivered {self.delivered} "
+              f"({100.0 * self.delivered / max(self.generated, 1):.1f}%), "
+              f"duplicates suppressed at gateway {self.duplicates}")
+        print()
+        print(f"{'hop':>4} {'rx':>8} {'lost':>8} {'loss%':>7} "
+              f"{'avg ms':>8} {'p95 ms':>8} {'max ms':>8}")
+        for hop in range(1, MAX_HOPS + 1):
+            s = self.stats.get(hop)
+            if not s:
+                continue
+            total = s["rx"] + s["lost"]
+            d = sorted(s["delay"])
+            avg = sum(d) / len(d) if d else 0
+            p95 = d[int(0.95 * (len(d) - 1))] if d else 0
+            mx = d[-1] if d else 0
+            print(f"{hop:>4} {s['rx']:>8} {s['lost']:>8} "
+                  f"{100.0 * s['lost'] / max(total, 1):>7.1f} "
+                  f"{avg:>8.1f} {p95:>8.1f} {mx:>8.1f}")
+
+        depth = defaultdict(int)
+        for n in self.nodes.values():
+            depth[n.parent.hops + 1 if n.parent else 0] += 1
+        print()
+        print("Route depth: " + ", ".join(
+            f"{k} hop{'s' if k != 1 else ''}: {v}" if k else f"no route: {v}"
+            for k, v in sorted(depth.items())))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the ESP-NOW relay mesh")
+    parser.add_argument("--nodes", type=int, default=50)
+    parser.add_argument("--relays", type=float, default=0.4,
+                        help="fraction of nodes with NODE_RELAY_ENABLED")
+    parser.add_argument("--radius", type=float, default=250.0,
+                        help="deployment radius in metres")
+    parser.add_argument("--hours", type=float, default=1.0)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    net = Network(args.nodes, args.relays, args.radius, args.seed)
+    duration = int(args.hours * 3600000)
+    net.run(duration)
+    net.report(duration)
+
+
+if __name__ == "__main__":
+    main()
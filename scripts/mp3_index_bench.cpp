@@ -0,0 +1,306 @@
+// Host benchmark for the gateway's MP3 frame indexer
+// (include/gateway_esp32/mp3_index.h).
+//
+// Synthesizes MP3 streams in memory with valid Layer III frame headers and
+// random payload: CBR 128 kbps, VBR with a Xing TOC, and VBR with a VBRI
+// table, each behind a 4 KB ID3v2 tag. The true frame offsets are kept
+// alongside. For each stream it builds the index twice:
+//   scan  - every frame header visited (what a download or first play does)
+//   quick - first frame only: Xing/VBRI/CBR estimate
+// and reports build time per MB, bytes read (with the time that would take
+// over the gateway's 4 MHz SPI SD card), duration error, and the latency,
+// read volume and accuracy of random seeks.
+//
+// Each seek offset is checked against a linear walk of the frame headers
+// from the end of the tag. Every index must give the exact duration and
+// land each seek on a frame start (or the end of the audio, for a late
+// estimate near the end). The scan, CBR and an unscaled VBRI table must
+// land on the walked offset of the frame asked for; a Xing TOC may be off
+// by one TOC step, a scaled VBRI table by one frame. Any other result
+// fails the run (exit 1).
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/mp3_index_bench
+//       scripts/mp3_index_bench.cpp src/gateway_esp32/mp3_index.cpp
+//   /tmp/mp3_index_bench [megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "include/gateway_esp32/mp3_index.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define SD_BYTES_PER_SEC (400.0 * 1024)  // 4 MHz SPI, after protocol overhead
+#define SEEKS 20000
+
+struct Stream {
+  const char* name;
+  std::vector<uint8_t> data;
+  std::vector<uint32_t> frames;  // True offset of every audio frame
+  uint32_t quickErrorMs;         // Seek error the quick index may have
+};
+
+static const uint16_t kBitrates[] = {96, 112, 128, 160, 192, 224, 256, 320};
+
+// MPEG-1 Layer III, 44.1 kHz, joint stereo
+static void putHeader(uint8_t* p, int bitrateIndex, bool padding) {
+  p[0] = 0xFF;
+  p[1] = 0xFB;
+  p[2] = (uint8_t)(bitrateIndex << 4 | (padding ? 2 : 0));
+  p[3] = 0x44;
+}
+
+static int bitrateIndexOf(int kbps) {
+  static const int table[] = {0,   32,  40,  48,  56,  64,  80,  96,
+                              112, 128, 160, 192, 224, 256, 320};
+  for (int i = 1; i < 15; i++) {
+    if (table[i] == kbps) return i;
+  }
+  return 9;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v >> 24, p[1] = v >> 16, p[2] = v >> 8, p[3] = v;
+}
+static void put16(uint8_t* p, uint16_t v) { p[0] = v >> 8, p[1] = v; }
+
+enum Kind { CBR, XING, VBRI };
+
+static Stream makeStream(const char* name, Kind kind, size_t bytes) {
+  Stream s;
+  s.name = name;
+  std::mt19937 rng(88);
+  auto& d = s.data;
+
+  // 4 KB ID3v2.3 tag
+  uint32_t tagBody = 4096 - 10;
+  const uint8_t id3[] = {'I', 'D', '3', 3, 0, 0};
+  d.assign(id3, id3 + sizeof(id3));
+  d.push_back((tagBody >> 21) & 0x7F);
+  d.push_back((tagBody >> 14) & 0x7F);
+  d.push_back((tagBody >> 7) & 0x7F);
+  d.push_back(tagBody & 0x7F);
+  d.resize(4096, 0);
+
+  // Info frame placeholder, filled in once the stream is known
+  size_t infoAt = d.size();
+  if (kind != CBR) d.resize(d.size() + 417, 0);
+
+  size_t audioStart = d.size();
+  uint64_t rem = 0;
+  while (d.size() - audioStart < bytes) {
+    int kbps = kind == CBR ? 128 : kBitrates[rng() % 8];
+    // Padding whenever the fractional frame length accumulates a byte
+    uint64_t num = 144ULL * kbps * 1000;
+    rem += num % 44100;
+    bool pad = rem >= 44100;
+    if (pad) rem -= 44100;
+    size_t len = num / 44100 + (pad ? 1 : 0);
+
+    s.frames.push_back((uint32_t)d.size());
+    size_t at = d.size();
+    d.resize(at + len);
+    putHeader(&d[at], bitrateIndexOf(kbps), pad);
+    for (size_t i = 4; i < len; i++) {
+      uint8_t b = (uint8_t)rng();
+      d[at + i] = b == 0xFF ? 0xFE : b;  // Keep payload free of sync words
+    }
+  }
+  uint32_t total = (uint32_t)s.frames.size();
+  uint32_t streamBytes = (uint32_t)(d.size() - infoAt);
+  s.quickErrorMs = 0;
+
+  if (kind == XING) {
+    uint8_t* f = &d[infoAt];
+    putHeader(f, 9, false);
+    uint8_t* x = f + 4 + 32;
+    memcpy(x, "Xing", 4);
+    put32(x + 4, 0x7);
+    put32(x + 8, total);
+    put32(x + 12, streamBytes);
+    for (int p = 0; p < 100; p++) {
+      uint32_t off = s.frames[(size_t)total * p / 100] - (uint32_t)infoAt;
+      x[16 + p] = (uint8_t)((uint64_t)off * 256 / streamBytes);
+    }
+    // One step of the 100-point TOC
+    s.quickErrorMs = (uint32_t)((uint64_t)total * 1152 * 10 / 44100);
+  } else if (kind == VBRI) {
+    uint8_t* f = &d[infoAt];
+    putHeader(f, 9, false);
+    uint8_t* v = f + 4 + 32;
+    const uint16_t fpe = 64;
+    uint16_t entries = (uint16_t)((total + fpe - 1) / fpe);
+    if (36 + 26 + entries * 2 > 417) entries = (417 - 36 - 26) / 2;
+    uint16_t perEntry = (uint16_t)((total + entries - 1) / entries);
+    entries = (uint16_t)((total + perEntry - 1) / perEntry);  // None empty
+    std::vector<uint32_t> sizes;
+    for (uint16_t i = 0; i < entries; i++) {
+      size_t a = (size_t)i * perEntry;
+      size_t b = std::min<size_t>(a + perEntry, total);
+      uint32_t end = b < total ? s.frames[b] : (uint32_t)d.size();
+      sizes.push_back(end - s.frames[a]);
+    }
+    // Entries hold 16 bits; large runs are stored in units of the scale
+    uint32_t largest = *std::max_element(sizes.begin(), sizes.end());
+    uint16_t scale = (uint16_t)((largest + 65534) / 65535);
+    memcpy(v, "VBRI", 4);
+    put16(v + 4, 1);
+    put32(v + 10, streamBytes);
+    put32(v + 14, total);
+    put16(v + 18, entries);
+    put16(v + 20, scale);
+    put16(v + 22, 2);  // Entry size
+    put16(v + 24, perEntry);
+    for (uint16_t i = 0; i < entries; i++) {
+      put16(v + 26 + i * 2, (uint16_t)((sizes[i] + scale / 2) / scale));
+    }
+    // Rounded to the scale, a boundary may resync to the next frame
+    if (scale > 1) s.quickErrorMs = 1152 * 1000 / 44100 + 1;
+  }
+  return s;
+}
+
+struct MemFile {
+  const Stream* s;
+  uint32_t calls;
+};
+
+static size_t memRead(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  MemFile* f = (MemFile*)ctx;
+  f->calls++;
+  const auto& d = f->s->data;
+  if (offset >= d.size()) return 0;
+  size_t n = std::min(len, d.size() - offset);
+  memcpy(buf, &d[offset], n);
+  return n;
+}
+
+// ============================================================================
+// REFERENCE: LINEAR WALK
+// ============================================================================
+static const int kBitrateTable[] = {0,   32,  40,  48,  56,  64,  80,  96,
+                                    112, 128, 160, 192, 224, 256, 320};
+
+static size_t frameLength(const uint8_t* p) {
+  int kbps = kBitrateTable[p[2] >> 4];
+  return 144 * kbps * 1000 / 44100 + ((p[2] & 2) ? 1 : 0);
+}
+
+// Offsets of the audio frames, header by header from the end of the ID3v2
+// tag, stepping over a Xing/VBRI info frame
+static std::vector<uint32_t> walkFrames(const std::vector<uint8_t>& d) {
+  std::vector<uint32_t> offsets;
+  size_t at = 10 + ((size_t)d[6] << 21 | (size_t)d[7] << 14 |
+                    (size_t)d[8] << 7 | d[9]);
+  if (at + 40 <= d.size() && (memcmp(&d[at + 36], "Xing", 4) == 0 ||
+                              memcmp(&d[at + 36], "VBRI", 4) == 0)) {
+    at += frameLength(&d[at]);
+  }
+  while (at + 4 <= d.size() && d[at] == 0xFF && (d[at + 1] & 0xE0) == 0xE0) {
+    offsets.push_back((uint32_t)at);
+    at += frameLength(&d[at]);
+  }
+  return offsets;
+}
+
+// ============================================================================
+// BENCHMARK
+// ============================================================================
+static double msSince(Clock::time_point t) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+static bool run(const Stream& s) {
+  static uint8_t scratch[4096];
+  double mb = s.data.size() / 1048576.0;
+  uint32_t total = (uint32_t)s.frames.size();
+  uint32_t trueMs = (uint32_t)((uint64_t)total * 1152 * 1000 / 44100);
+  printf("%s: %.1f MB, %u frames, %u.%03u s\n", s.name, mb, total,
+         trueMs / 1000, trueMs % 1000);
+
+  std::vector<uint32_t> walked = walkFrames(s.data);
+  bool ok = walked == s.frames;
+  if (!ok) printf("  linear walk found %zu frames  FAIL\n", walked.size());
+
+  for (int full = 1; full >= 0; full--) {
+    MemFile file = {&s, 0};
+    Mp3Indexer indexer(memRead, &file, (uint32_t)s.data.size(), scratch,
+                       sizeof(scratch));
+    static Mp3Index index;
+    auto t0 = Clock::now();
+    bool built = indexer.build(index, full);
+    double buildMs = msSince(t0);
+    if (!built) {
+      printf("  %-5s build FAILED\n", full ? "scan" : "quick");
+      ok = false;
+      continue;
+    }
+    uint32_t read = indexer.bytesRead();
+    printf("  %-5s build %7.3f ms (%6.3f ms/MB), read %7u KB (SD ~%6.0f ms)"
+           ", duration %+d ms, %u entries x %u frames, %u B stored\n",
+           full ? "scan" : "quick", buildMs, buildMs / mb, read / 1024,
+           read / SD_BYTES_PER_SEC * 1000,
+           (int)index.durationMs() - (int)trueMs, index.h.entries,
+           index.h.framesPerEntry, (unsigned)index.storedSize());
+
+    // Random seek-to-time
+    std::mt19937 rng(89);
+    uint32_t before = indexer.bytesRead(), calls = file.calls, exact = 0;
+    uint32_t offFrame = 0;  // Seeks that missed every frame start and the end
+    uint64_t errFrames = 0, errMax = 0;
+    t0 = Clock::now();
+    for (int i = 0; i < SEEKS; i++) {
+      uint32_t ms = rng() % index.durationMs();
+      uint32_t frame = index.frameForMs(ms);
+      uint32_t off = indexer.frameOffset(index, frame);
+      // Which frame did we land on?
+      auto it = std::lower_bound(s.frames.begin(), s.frames.end(), off);
+      uint32_t landed = (uint32_t)(it - s.frames.begin());
+      bool atEnd = it == s.frames.end() && off == s.data.size();
+      if (!atEnd && (it == s.frames.end() || *it != off)) offFrame++;
+      if (frame < walked.size() && walked[frame] == off) exact++;
+      uint64_t err = landed > frame ? landed - frame : frame - landed;
+      errFrames += err;
+      errMax = std::max(errMax, err);
+    }
+    double seekUs = msSince(t0) * 1000 / SEEKS;
+    double kbPerSeek = (indexer.bytesRead() - before) / 1024.0 / SEEKS;
+    printf("  %-5s seek %6.2f us, %.1f reads / %.2f KB per seek (SD ~%.1f ms)"
+           ", exact %5.1f%%, error avg %.1f / max %llu ms\n",
+           "", seekUs, (double)(file.calls - calls) / SEEKS, kbPerSeek,
+           kbPerSeek * 1024 / SD_BYTES_PER_SEC * 1000, 100.0 * exact / SEEKS,
+           errFrames * 1152000.0 / 44100 / SEEKS,
+           (unsigned long long)(errMax * 1152000 / 44100));
+
+    uint32_t allowedMs = full ? 0 : s.quickErrorMs;
+    bool pass = index.durationMs() == trueMs && offFrame == 0 &&
+                (allowedMs ? errMax * 1152000 / 44100 <= allowedMs
+                           : exact == SEEKS);
+    if (!pass) {
+      printf("  %-5s %u seeks off a frame start, %u/%u on the walked offset"
+             "  FAIL\n",
+             "", offFrame, exact, SEEKS);
+    }
+    ok &= pass;
+  }
+  printf("\n");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  double mb = argc > 1 ? atof(argv[1]) : 8.0;
+  size_t bytes = (size_t)(mb * 1048576);
+
+  bool ok = run(makeStream("CBR 128k", CBR, bytes));
+  ok &= run(makeStream("VBR + Xing", XING, bytes));
+  ok &= run(makeStream("VBR + VBRI", VBRI, bytes));
+
+  printf("Result: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
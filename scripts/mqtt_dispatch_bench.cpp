@@ -0,0 +1,471 @@
+// Host benchmark for MQTT dispatch with the per-message arena
+// (include/gateway_esp32/message_arena.h).
+//
+// Replays a mix of gateway messages (commands, playback, downloads, rule
+// updates, OTA) through two copies of the dispatch path:
+//   before - topic matching and handlers built on heap strings, the way
+//            MQTTManager and the handlers used Arduino String
+//   after  - allocation-free topic matching and handlers using the arena
+// and reports heap allocations per message and dispatch time. std::string
+// stands in for Arduino String; its small-string buffer makes the "before"
+// numbers an underestimate of what String costs on the device.
+//
+// Both paths are checked first: the arena matcher against MQTT's matching
+// rules and against the String matcher on every handler pattern, and what
+// each message publishes must be the same through both paths. The run
+// fails (exit 1) on any difference.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/dispatch_bench
+//       scripts/mqtt_dispatch_bench.cpp src/gateway_esp32/message_arena.cpp
+//   /tmp/dispatch_bench [messages]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "include/gateway_esp32/message_arena.h"
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+static uint64_t allocCount = 0;
+
+void* operator new(size_t size) {
+  allocCount++;
+  void* p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Keep results alive so the work is not optimized away; the checks record
+// what is published
+static volatile size_t sink = 0;
+static std::string* published = nullptr;
+static void publish(const char* topic, const char* msg) {
+  sink += strlen(topic) + strlen(msg);
+  if (published) *published += std::string(topic) + " " + msg + "\n";
+}
+static void publish(const std::string& topic, const std::string& msg) {
+  publish(topic.c_str(), msg.c_str());
+}
+
+// String(float) prints two decimals
+static std::string floatString(float value) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%.2f", value);
+  return buf;
+}
+
+static const char* PATTERNS[] = {
+    "esp32/audio_chunk",       "smartalarm/play_audio",
+    "esp32/audio_download_cmd", "smartalarm/commands",
+    "smartalarm/node_ota",     "smartalarm/gateway/ota",
+    "smartalarm/rules",        "smartalarm/+/config",
+};
+static const int PATTERN_COUNT = sizeof(PATTERNS) / sizeof(PATTERNS[0]);
+
+struct Message {
+  const char* topic;
+  const char* payload;
+};
+
+static const Message MIX[] = {
+    {"smartalarm/commands", "status"},
+    {"smartalarm/commands", "volume=0.65"},
+    {"smartalarm/commands", "play:morning.mp3"},
+    {"smartalarm/commands", "stop_audio"},
+    {"smartalarm/play_audio", "birds.mp3"},
+    {"esp32/audio_download_cmd", "http://192.168.1.100:8000/file.mp3|101"},
+    {"smartalarm/rules", "status"},
+    {"smartalarm/rules",
+     "early: time >= 06:20 && outside_temp < 5 -> play /alarm.mp3\n"
+     "sunrise: light > 200 && time >= 06:00 -> fadein /birds.mp3 30"},
+    {"smartalarm/gateway/ota",
+     " http://host/update.sadl|"
+     "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff "},
+    {"smartalarm/node_ota", "node_fw.bin"},
+};
+static const int MIX_COUNT = sizeof(MIX) / sizeof(MIX[0]);
+
+// ============================================================================
+// Before: heap strings
+// ============================================================================
+static bool matchBefore(const std::string& pattern, const std::string& topic) {
+  if (pattern == topic) return true;
+  if (pattern.find('+') == std::string::npos &&
+      pattern.find('#') == std::string::npos) {
+    return false;
+  }
+  size_t pi = 0, ti = 0;
+  while (pi < pattern.size() && ti < topic.size()) {
+    if (pattern[pi] == '#') return true;
+    size_t ps = pattern.find('/', pi), ts = topic.find('/', ti);
+    if (ps == std::string::npos) ps = pattern.size();
+    if (ts == std::string::npos) ts = topic.size();
+    std::string pl = pattern.substr(pi, ps - pi);
+    std::string tl = topic.substr(ti, ts - ti);
+    if (pl != "+" && pl != tl) return false;
+    pi = ps + 1;
+    ti = ts + 1;
+  }
+  return pi >= pattern.size() && ti >= topic.size();
+}
+
+static void handleBefore(int handler, const char* payload, size_t length) {
+  std::string text(payload, length);
+  switch (handler) {
+    case 1: {
+      std::string filename = text;
+      if (filename[0] != '/') filename = "/" + filename;
+      publish("smartalarm/audio/status", filename);
+      break;
+    }
+    case 2: {
+      size_t sep = text.find('|');
+      std::string url = text.substr(0, sep);
+      std::string id = text.substr(sep + 1);
+      std::string filename = "/sound_" + id + ".mp3";
+      publish(url, filename);
+      break;
+    }
+    case 3: {
+      std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+      if (text.rfind("volume=", 0) == 0) {
+        float vol = std::stof(text.substr(7));
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%.2f", vol);
+        publish("smartalarm/status", "volume:" + std::string(buf));
+      } else if (text.rfind("play:", 0) == 0) {
+        std::string filename = text.substr(5);
+        if (filename[0] != '/') filename = "/" + filename;
+        publish("smartalarm/status", filename);
+      } else if (text == "status") {
+        std::string status = "online|audio:";
+        status += "stopped";
+        status += "|volume:" + floatString(0.5f);
+        status += "|wifi:" + std::to_string(-61) + "dBm";
+        publish("smartalarm/status", status);
+      } else {
+        publish("smartalarm/status", text);
+      }
+      break;
+    }
+    case 4: {
+      std::string filename = text;
+      if (filename[0] != '/') filename = "/" + filename;
+      publish("smartalarm/node_ota/status", filename);
+      break;
+    }
+    case 5: {
+      size_t b = text.find_first_not_of(' ');
+      size_t e = text.find_last_not_of(' ');
+      text = text.substr(b, e - b + 1);
+      size_t sep = text.find('|');
+      std::string sha = text.substr(sep + 1);
+      text = text.substr(0, sep);
+      publish(text, sha);
+      break;
+    }
+    case 6:
+      publish("smartalarm/rules/status", text);
+      break;
+  }
+}
+
+static void dispatchBefore(const char* topic, const char* payload) {
+  std::string topicStr(topic);
+  for (int i = 0; i < PATTERN_COUNT; i++) {
+    // Handler patterns are Strings owned by MQTTHandler
+    static std::vector<std::string> patterns(PATTERNS,
+                                             PATTERNS + PATTERN_COUNT);
+    if (matchBefore(patterns[i], topicStr)) {
+      handleBefore(i, payload, strlen(payload));
+      return;
+    }
+  }
+}
+
+// ============================================================================
+// After: arena (mirrors MQTTManager::topicMatches and the handlers)
+// ============================================================================
+static const char* levelEnd(const char* s) {
+  while (*s && *s != '/') s++;
+  return s;
+}
+
+static bool matchAfter(const char* pattern, const char* topic) {
+  if (strcmp(pattern, topic) == 0) return true;
+  if (!strpbrk(pattern, "+#")) return false;
+  const char* p = pattern;
+  const char* t = topic;
+  for (;;) {
+    if (p[0] == '#' && (p[1] == '\0' || p[1] == '/')) return true;
+    const char* pEnd = levelEnd(p);
+    const char* tEnd = levelEnd(t);
+    size_t pLen = pEnd - p, tLen = tEnd - t;
+    bool wildcard = pLen == 1 && p[0] == '+';
+    if (!wildcard && (pLen != tLen || strncmp(p, t, pLen) != 0)) return false;
+    if (!*tEnd) return !*pEnd || strcmp(pEnd, "/#") == 0;
+    if (!*pEnd) return false;
+    p = pEnd + 1;
+    t = tEnd + 1;
+  }
+}
+
+static void handleAfter(MessageArena& arena, int handler, const char* payload,
+                        size_t length) {
+  switch (handler) {
+    case 1:
+    case 4: {
+      const char* filename =
+          length > 0 && payload[0] == '/'
+              ? arena.copy(payload, length)
+              : arena.format("/%.*s", (int)length, payload);
+      publish(handler == 1 ? "smartalarm/audio/status"
+                           : "smartalarm/node_ota/status",
+              filename);
+      break;
+    }
+    case 2: {
+      char* url = arena.copy(payload, length);
+      char* sep = strchr(url, '|');
+      *sep = '\0';
+      publish(url, arena.format("/sound_%s.mp3", sep + 1));
+      break;
+    }
+    case 3: {
+      char* text = arena.copy(payload, length);
+      for (char* c = text; *c; c++) *c = tolower(*c);
+      if (strncmp(text, "volume=", 7) == 0) {
+        publish("smartalarm/status",
+                arena.format("volume:%.2f", atof(text + 7)));
+      } else if (strncmp(text, "play:", 5) == 0) {
+        const char* filename = text + 5;
+        if (filename[0] != '/') filename = arena.format("/%s", filename);
+        publish("smartalarm/status", filename);
+      } else if (strcmp(text, "status") == 0) {
+        publish("smartalarm/status",
+                arena.format("online|audio:%s|volume:%.2f|wifi:%ddBm",
+                             "stopped", 0.5f, -61));
+      } else {
+        publish("smartalarm/status", text);
+      }
+      break;
+    }
+    case 5: {
+      char* cmd = arena.copy(payload, length);
+      while (*cmd == ' ') cmd++;
+      for (char* e = cmd + strlen(cmd); e > cmd && e[-1] == ' '; e--) {
+        e[-1] = '\0';
+      }
+      char* sep = strchr(cmd, '|');
+      *sep = '\0';
+      publish(cmd, sep + 1);
+      break;
+    }
+    case 6:
+      publish("smartalarm/rules/status", arena.copy(payload, length));
+      break;
+  }
+}
+
+static void dispatchAfter(MessageArena& arena, const char* topic,
+                          const char* payload) {
+  for (int i = 0; i < PATTERN_COUNT; i++) {
+    if (matchAfter(PATTERNS[i], topic)) {
+      handleAfter(arena, i, payload, strlen(payload));
+      break;
+    }
+  }
+  arena.reset();
+}
+
+// ============================================================================
+// Checks
+// ============================================================================
+struct MatchCase {
+  const char* pattern;
+  const char* topic;
+  bool match;
+};
+
+// MQTT 3.1.1 section 4.7: '+' is one whole level (empty levels included),
+// '#' the rest of the topic including its parent level
+static const MatchCase MATCH_CASES[] = {
+    {"smartalarm/commands", "smartalarm/commands", true},
+    {"smartalarm/commands", "smartalarm/command", false},
+    {"smartalarm/+/config", "smartalarm/node1/config", true},
+    {"smartalarm/+/config", "smartalarm//config", true},
+    {"smartalarm/+/config", "smartalarm/node1", false},
+    {"smartalarm/+/config", "smartalarm/node1/config/x", false},
+    {"smartalarm/+/config", "smartalarm/node1/config/", false},
+    {"smartalarm/+/config", "smartalarm/a/b/config", false},
+    {"smartalarm/#", "smartalarm/gateway/ota", true},
+    {"smartalarm/#", "smartalarm/", true},
+    {"smartalarm/#", "smartalarm", true},
+    {"smartalarm/#", "other/gateway", false},
+    {"+/+", "a/b", true},
+    {"+/+", "a/b/c", false},
+    {"+", "a", true},
+    {"a/+b", "a/xb", false},  // Not a wildcard inside a level
+};
+
+static bool checkMatchers() {
+  bool ok = true;
+  int baselineDiffers = 0;
+  for (const MatchCase& c : MATCH_CASES) {
+    bool after = matchAfter(c.pattern, c.topic);
+    if (after != c.match) {
+      printf("  %s vs %s: %s, expected %s  FAIL\n", c.pattern, c.topic,
+             after ? "match" : "no match", c.match ? "match" : "no match");
+      ok = false;
+    }
+    if (matchBefore(c.pattern, c.topic) != c.match) {
+      printf("  %s vs %s: String matcher %s\n", c.pattern, c.topic,
+             c.match ? "misses it" : "matches");
+      baselineDiffers++;
+    }
+  }
+
+  // The device's topics, and their neighbours, against every pattern
+  std::vector<std::string> topics;
+  for (int i = 0; i < MIX_COUNT; i++) topics.push_back(MIX[i].topic);
+  for (int i = 0; i < PATTERN_COUNT; i++) topics.push_back(PATTERNS[i]);
+  const char* extra[] = {"smartalarm/node1/config", "smartalarm/x/y/config",
+                         "smartalarm", "smartalarm/rules/status", "esp32",
+                         "smartalarm/commands/x", ""};
+  for (const char* t : extra) topics.push_back(t);
+  int pairs = 0;
+  for (int i = 0; i < PATTERN_COUNT; i++) {
+    for (const std::string& t : topics) {
+      pairs++;
+      if (matchAfter(PATTERNS[i], t.c_str()) != matchBefore(PATTERNS[i], t)) {
+        printf("  %s vs %s: matchers differ  FAIL\n", PATTERNS[i],
+               t.c_str());
+        ok = false;
+      }
+    }
+  }
+  printf("matching: %zu rule cases, %d pattern/topic pairs against the "
+         "String matcher%s\n",
+         sizeof(MATCH_CASES) / sizeof(MATCH_CASES[0]), pairs,
+         ok ? "" : "  FAIL");
+  if (baselineDiffers) {
+    printf("  (the String matcher breaks the rules in %d case%s)\n",
+           baselineDiffers, baselineDiffers == 1 ? "" : "s");
+  }
+  return ok;
+}
+
+static bool checkHandlers(MessageArena& arena) {
+  bool ok = true;
+  std::string before, after;
+  for (int i = 0; i < MIX_COUNT; i++) {
+    before.clear();
+    after.clear();
+    published = &before;
+    dispatchBefore(MIX[i].topic, MIX[i].payload);
+    published = &after;
+    dispatchAfter(arena, MIX[i].topic, MIX[i].payload);
+    published = nullptr;
+    if (before != after) {
+      printf("  %s: before published\n%s  after published\n%s  FAIL\n",
+             MIX[i].topic, before.c_str(), after.c_str());
+      ok = false;
+    }
+  }
+  printf("handlers: %d messages publish the same through both paths%s\n\n",
+         MIX_COUNT, ok ? "" : "  FAIL");
+  return ok;
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+typedef std::chrono::steady_clock Clock;
+
+int main(int argc, char** argv) {
+  long messages = argc > 1 ? atol(argv[1]) : 1000000;
+  static MessageArena arena;
+
+  bool ok = checkMatchers();
+  ok &= checkHandlers(arena);
+
+  // Warm up (builds the static pattern table of the "before" path)
+  for (int i = 0; i < MIX_COUNT; i++) {
+    dispatchBefore(MIX[i].topic, MIX[i].payload);
+    dispatchAfter(arena, MIX[i].topic, MIX[i].payload);
+  }
+
+  printf("%-28s %12s %12s %12s\n", "message", "allocs before",
+         "allocs after", "arena bytes");
+  for (int i = 0; i < MIX_COUNT; i++) {
+    uint64_t a0 = allocCount;
+    dispatchBefore(MIX[i].topic, MIX[i].payload);
+    uint64_t a1 = allocCount;
+    uint32_t f1 = arena.fallbacks();
+    for (int k = 0; k < PATTERN_COUNT; k++) {
+      if (matchAfter(PATTERNS[k], MIX[i].topic)) {
+        handleAfter(arena, k, MIX[i].payload, strlen(MIX[i].payload));
+        break;
+      }
+    }
+    size_t used = arena.used();
+    arena.reset();
+    // Arena overflow goes to malloc directly, count it with the rest
+    uint64_t a2 = allocCount + (arena.fallbacks() - f1);
+    printf("%-28s %12llu %12llu %12zu\n", MIX[i].topic,
+           (unsigned long long)(a1 - a0), (unsigned long long)(a2 - a1),
+           used);
+  }
+
+  // A rule set larger than the arena spills to the heap and is counted
+  std::string big;
+  while (big.size() < 2 * MESSAGE_ARENA_SIZE) {
+    big += "frost: outside_temp < 2 -> publish frost\n";
+  }
+  uint32_t spilled = arena.fallbacks();
+  dispatchAfter(arena, "smartalarm/rules", big.c_str());
+  printf("%-28s %12s %12u %12s\n", "rules (2 KB payload)", "-",
+         arena.fallbacks() - spilled, "overflow");
+
+  uint64_t allocs0 = allocCount;
+  auto t0 = Clock::now();
+  for (long n = 0; n < messages; n++) {
+    const Message& m = MIX[n % MIX_COUNT];
+    dispatchBefore(m.topic, m.payload);
+  }
+  auto t1 = Clock::now();
+  uint64_t allocs1 = allocCount;
+  uint32_t fallbacks1 = arena.fallbacks();
+  for (long n = 0; n < messages; n++) {
+    const Message& m = MIX[n % MIX_COUNT];
+    dispatchAfter(arena, m.topic, m.payload);
+  }
+  auto t2 = Clock::now();
+  uint64_t allocs2 = allocCount + (arena.fallbacks() - fallbacks1);
+
+  double beforeNs =
+      std::chrono::duration<double, std::nano>(t1 - t0).count() / messages;
+  double afterNs =
+      std::chrono::duration<double, std::nano>(t2 - t1).count() / messages;
+  printf("\n%ld messages\n", messages);
+  printf("before: %6.2f allocs/msg  %7.1f ns/dispatch\n",
+         (double)(allocs1 - allocs0) / messages, beforeNs);
+  printf("after:  %6.2f allocs/msg  %7.1f ns/dispatch  (arena peak %zu/%d B, "
+         "%u fallbacks)\n",
+         (double)(allocs2 - allocs1) / messages, afterNs, arena.highWater(),
+         MESSAGE_ARENA_SIZE, arena.fallbacks());
+
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+Node OTA Transfer Simulation
+Host-side model of the ESP-NOW firmware distribution protocol
+(include/shared/node_ota.h, NodeOtaManager on the gateway)
+
+Estimates how long the windowed, selective-ack broadcast takes for 1 versus
+10 nodes, and compares it with updating the same nodes one after another.
+
+Usage:
+    python node_ota_sim.py
+    python node_ota_sim.py --image-kb 380 --loss 0.02 0.15 --runs 20
+"""
+
+import argparse
+import random
+import statistics
+
+# Mirrors include/shared/node_ota.h and include/gateway_esp32/node_ota_manager.h
+CHUNK_SIZE = 240
+WINDOW = 16
+CHUNK_GAP_MS = 3
+POLL_WAIT_MS = 150
+JOIN_WAIT_MS = 1500
+MAX_SILENT = 10
+COMMIT_MS = 3 * 500 + 1500
+FLASH_WRITE_MS = 6  # Updater write + SHA-256 of one full window on the ESP8266
+
+
+def transfer(image_size, node_loss, rng):
+    """Simulate one session. node_loss: per-node frame loss probabilities.
+
+    Returns (elapsed_ms, chunks_sent, dropped_nodes).
+    """
+    chunk_count = (image_size + CHUNK_SIZE - 1) // CHUNK_SIZE
+    elapsed = JOIN_WAIT_MS
+    sent = 0
+    alive = list(range(len(node_loss)))
+    dropped = 0
+
+    for w in range(0, chunk_count, WINDOW):
+        count = min(WINDOW, chunk_count - w)
+        have = {n: set() for n in alive}
+        pending = set(range(count))
+        silent = {n: 0 for n in alive}
+
+        while pending and alive:
+            for i in sorted(pending):
+                elapsed += CHUNK_GAP_MS
+                sent += 1
+                for n in alive:
+                    if rng.random() >= node_loss[n]:
+                        have[n].add(i)
+
+            # Poll until every node answered or a resend is needed
+            while True:
+                elapsed += POLL_WAIT_MS
+                missing, quiet = set(), 0
+                for n in list(alive):
+                    # Poll and status both have to get through
+                    if rng.random() < node_loss[n] or rng.random() < node_loss[n]:
+                        silent[n] += 1
+                        if silent[n] >= MAX_SILENT:
+                            alive.remove(n)
+                            dropped += 1
+                        else:
+                            quiet += 1
+                        continue
+                    silent[n] = 0
+                    missing |= set(range(count)) - have[n]
+                if missing or quiet == 0:
+                    break
+            pending = missing
+
+        elapsed += FLASH_WRITE_MS
+
+    return elapsed + COMMIT_MS, sent, dropped
+
+
+def run(label, image_size, losses, runs, rng):
+    times, overheads = [], []
+    chunk_count = (image_size + CHUNK_SIZE - 1) // CHUNK_SIZE
+    for _ in range(runs):
+        ms, sent, _ = transfer(image_size, losses, rng)
+        times.append(ms / 1000.0)
+        overheads.append(sent / chunk_count)
+    print(f"{label:<34} {statistics.mean(times):>8.1f} s "
+          f"{max(times):>8.1f} s {statistics.mean(overheads):>8.2f}x")
+    return statistics.mean(times)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate node OTA over ESP-NOW")
+    parser.add_argument("--image-kb", type=int, default=350,
+                        help="firmware image size in KB")
+    parser.add_argument("--loss", type=float, nargs=2, default=[0.01, 0.10],
+                        metavar=("MIN", "MAX"),
+                        help="per-node frame loss range")
+    parser.add_argument("--runs", type=int, default=10)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    image_size = args.image_kb * 1024
+    losses10 = [rng.uniform(*args.loss) for _ in range(10)]
+
+    print(f"Image {args.image_kb} KB, {(image_size + CHUNK_SIZE - 1) // CHUNK_SIZE} "
+          f"chunks of {CHUNK_SIZE} B, window {WINDOW}, "
+          f"loss {args.loss[0]:.0%}-{args.loss[1]:.0%}")
+    print(f"{'scenario':<34} {'mean':>10} {'worst':>10} {'chunks':>9}")
+
+    one = run("1 node (median loss)", image_size,
+              [statistics.median(losses10)], args.runs, rng)
+    many = run("10 nodes, one broadcast session", image_size, losses10,
+               args.runs, rng)
+
+    sequential = 0.0
+    for loss in losses10:
+        sequential += statistics.mean(
+            transfer(image_size, [loss], rng)[0] / 1000.0 for _ in range(args.runs))
+    print(f"{'10 nodes, one at a time':<34} {sequential:>8.1f} s")
+    print()
+    print(f"Broadcast to 10 nodes costs {many / one:.2f}x a single node "
+          f"and saves {sequential - many:.0f} s over sequential updates.")
+
+
+if __name__ == "__main__":
+    main()
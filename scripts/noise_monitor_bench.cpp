@@ -0,0 +1,332 @@
+// Host benchmark of the gateway's ambient noise monitor
+// (include/gateway_esp32/noise_monitor.h).
+//
+// Accuracy: synthetic 24-bit signals of known level (sines in each band,
+// white noise from a loud room down to a quiet bedroom, a click in
+// silence) go through NoiseAnalyzer for one measurement window. RMS and
+// peak are checked against the exact values in double, the band levels
+// against a double-precision DFT of the same Hann-windowed blocks, and
+// each sine must land in its own band. Then the cost of one block and one
+// window, in ns and TSC cycles and as a share of a 240 MHz core at one
+// window per NOISE_PERIOD_MS. Finally NoiseMonitor runs a night in virtual
+// time: polled every 50 ms like the sensor task, against a fake microphone
+// that only produces samples while powered and whose DMA (8 x 256 samples)
+// drops the oldest when nobody reads. It reports windows, the microphone
+// duty cycle and the CPU time spent in poll().
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/noise_monitor_bench
+//       scripts/noise_monitor_bench.cpp src/gateway_esp32/noise_monitor.cpp
+//       src/gateway_esp32/spectrum.cpp
+//   /tmp/noise_monitor_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "include/gateway_esp32/noise_monitor.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define RATE NOISE_RATE_HZ
+#define N NOISE_BLOCK
+#define FULL_SCALE 8388607.0  // 24-bit
+#define POLL_MS 50            // Sensor task period
+#define NIGHT_H 8
+#define DMA_SAMPLES (8 * 256)
+#define MAX_LEVEL_ERROR_DB 0.5
+#define MAX_BAND_ERROR_DB 1.0
+#define MIN_BAND_LEAD_DB 20.0  // A sine's band over every other band
+#define MAX_MIC_DUTY 0.05
+#define RUNS 200
+
+static const int kBandStart[NOISE_BANDS + 1] = {1, 4, 16, 64, N / 2 - 1};
+
+// ============================================================================
+// SIGNALS
+// ============================================================================
+static std::vector<int32_t> sine(double hz, double dbfs) {
+  std::vector<int32_t> x(NOISE_WINDOW_FRAMES);
+  double a = pow(10.0, dbfs / 20.0) * FULL_SCALE;
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = (int32_t)lrint(a * sin(2 * M_PI * hz * i / RATE + 0.3));
+  }
+  return x;
+}
+
+// Gaussian white noise; dbfs is its RMS against a full-scale sine
+static std::vector<int32_t> noise(double dbfs, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> g(0.0, 1.0);
+  std::vector<int32_t> x(NOISE_WINDOW_FRAMES);
+  double sigma = pow(10.0, dbfs / 20.0) * FULL_SCALE / sqrt(2.0);
+  for (int32_t& v : x) {
+    double s = sigma * g(rng);
+    if (s > FULL_SCALE) s = FULL_SCALE;
+    if (s < -FULL_SCALE) s = -FULL_SCALE;
+    v = (int32_t)lrint(s);
+  }
+  return x;
+}
+
+// ============================================================================
+// REFERENCE
+// ============================================================================
+struct Reference {
+  double rmsDb, peakDb, bandDb[NOISE_BANDS];
+};
+
+static double toDb(double meanSq) {
+  return 10 * log10((meanSq > 0 ? meanSq : 1) / (FULL_SCALE * FULL_SCALE / 2));
+}
+
+// Same definition as the analyzer, in double: band shares of each block's
+// Hann-windowed spectrum times the block's energy
+static Reference reference(const std::vector<int32_t>& x) {
+  Reference r;
+  double energy = 0, peak = 0, band[NOISE_BANDS] = {};
+  for (size_t at = 0; at + N <= x.size(); at += N) {
+    double e = 0, power[N / 2] = {};
+    for (int i = 0; i < N; i++) {
+      double s = x[at + i];
+      e += s * s;
+      peak = fmax(peak, fabs(s));
+    }
+    for (int k = 1; k < N / 2 - 1; k++) {
+      double re = 0, im = 0;
+      for (int i = 0; i < N; i++) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * i / N);
+        re += x[at + i] * w * cos(2 * M_PI * k * i / N);
+        im -= x[at + i] * w * sin(2 * M_PI * k * i / N);
+      }
+      power[k] = re * re + im * im;
+    }
+    double b[NOISE_BANDS] = {}, total = 0;
+    for (int j = 0; j < NOISE_BANDS; j++) {
+      for (int k = kBandStart[j]; k < kBandStart[j + 1]; k++) b[j] += power[k];
+      total += b[j];
+    }
+    energy += e;
+    for (int j = 0; j < NOISE_BANDS && total > 0; j++) {
+      band[j] += e * b[j] / total;
+    }
+  }
+  r.rmsDb = toDb(energy / x.size());
+  r.peakDb = 20 * log10((peak > 0 ? peak : 1) / FULL_SCALE);
+  for (int j = 0; j < NOISE_BANDS; j++) r.bandDb[j] = toDb(band[j] / x.size());
+  return r;
+}
+
+// ============================================================================
+// ACCURACY
+// ============================================================================
+struct Case {
+  const char* name;
+  std::vector<int32_t> x;
+  int band;  // The band a sine must dominate, -1 for broadband
+};
+
+static bool accuracy() {
+  std::vector<Case> cases;
+  cases.push_back({"100 Hz hum, -50 dBFS", sine(100, -50), 0});
+  cases.push_back({"500 Hz, -70 dBFS", sine(500, -70), 1});
+  cases.push_back({"1.5 kHz, -30 dBFS", sine(1500, -30), 2});
+  cases.push_back({"6 kHz, -40 dBFS", sine(6000, -40), 3});
+  cases.push_back({"white noise, -3 dBFS", noise(-3, 1), -1});
+  cases.push_back({"white noise, -60 dBFS", noise(-60, 2), -1});
+  cases.push_back({"bedroom, -95 dBFS", noise(-95, 3), -1});
+  Case click = {"click in silence", noise(-100, 4), -1};
+  click.x[N * 5 + 17] = (int32_t)(FULL_SCALE / 2);  // -6 dBFS peak
+  cases.push_back(click);
+
+  printf("Accuracy, one %d ms window (analyzer - reference, dB):\n",
+         NOISE_WINDOW_FRAMES * 1000 / RATE);
+  printf("  %-22s %7s %6s %6s %6s  %s\n", "signal", "rms", "err", "peak",
+         "err", "bands (dB SPL)");
+  bool ok = true;
+  NoiseAnalyzer a;
+  for (const Case& c : cases) {
+    a.reset();
+    a.add(c.x.data(), c.x.size());
+    NoiseLevels l = a.levels();
+    Reference r = reference(c.x);
+    double rmsErr = l.rmsDb8 / 8.0 - r.rmsDb;
+    double peakErr = l.peakDb8 / 8.0 - r.peakDb;
+    bool pass = fabs(rmsErr) <= MAX_LEVEL_ERROR_DB &&
+                fabs(peakErr) <= MAX_LEVEL_ERROR_DB;
+    printf("  %-22s %7.1f %+6.2f %6.1f %+6.2f ", c.name, l.rmsDb8 / 8.0,
+           rmsErr, l.peakDb8 / 8.0, peakErr);
+    for (int b = 0; b < NOISE_BANDS; b++) {
+      printf(" %5.1f", l.bandDb8[b] / 8.0 + NOISE_SPL_OFFSET_DB);
+      // Bands within 30 dB of the total must match the reference
+      if (r.bandDb[b] > r.rmsDb - 30) {
+        pass &= fabs(l.bandDb8[b] / 8.0 - r.bandDb[b]) <= MAX_BAND_ERROR_DB;
+      }
+      if (c.band >= 0 && b != c.band) {
+        pass &= l.bandDb8[c.band] - l.bandDb8[b] >= MIN_BAND_LEAD_DB * 8;
+      }
+    }
+    printf("  %s\n", pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+  return ok;
+}
+
+// ============================================================================
+// COST
+// ============================================================================
+static void cost() {
+  std::vector<int32_t> x = noise(-50, 5);
+  NoiseAnalyzer a;
+  double ns = 0;
+#ifdef HAVE_TSC
+  uint64_t cycles = 0;
+#endif
+  for (int r = 0; r < RUNS; r++) {
+    a.reset();
+    auto t0 = Clock::now();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    a.add(x.data(), x.size());
+    volatile int32_t sink = a.levels().rmsDb8;
+    (void)sink;
+#ifdef HAVE_TSC
+    cycles += __rdtsc() - c0;
+#endif
+    ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+  }
+  const int blocks = NOISE_WINDOW_FRAMES / N;
+  printf("\nAnalysis: %.0f ns per block, %.0f ns per window", ns / RUNS / blocks,
+         ns / RUNS);
+#ifdef HAVE_TSC
+  double perWindow = (double)cycles / RUNS;
+  printf(" (%.0f TSC cycles); one window per %d s is %.4f%% of a 240 MHz "
+         "core",
+         perWindow, NOISE_PERIOD_MS / 1000,
+         100.0 * perWindow / (240e6 * NOISE_PERIOD_MS / 1000.0));
+#endif
+  printf("\nstate: %zu bytes (NoiseMonitor)\n", sizeof(NoiseMonitor));
+}
+
+// ============================================================================
+// NIGHT
+// ============================================================================
+// I2S RX with the microphone behind it, in virtual time
+struct FakeMic {
+  bool on = false;
+  uint64_t produced = 0;  // Samples since power-up
+  uint32_t onMs = 0;
+  uint32_t powerCycles = 0;
+  uint32_t overruns = 0;
+  std::deque<int32_t> dma;
+  std::vector<int32_t> room;  // Looped ambient signal
+
+  void advance(uint32_t nowMs) {
+    if (!on) return;
+    uint64_t due = (uint64_t)(nowMs - onMs) * RATE / 1000;
+    for (; produced < due; produced++) {
+      if (dma.size() == DMA_SAMPLES) {
+        dma.pop_front();
+        overruns++;
+      }
+      dma.push_back(room[produced % room.size()]);
+    }
+  }
+};
+
+static FakeMic mic;
+static uint32_t virtualMs;
+
+static size_t micRead(void* ctx, int32_t* samples, size_t max) {
+  FakeMic* m = (FakeMic*)ctx;
+  size_t n = 0;
+  while (n < max && !m->dma.empty()) {
+    samples[n++] = m->dma.front();
+    m->dma.pop_front();
+  }
+  return n;
+}
+
+static void micPower(void* ctx, bool on) {
+  FakeMic* m = (FakeMic*)ctx;
+  if (on && !m->on) {
+    m->onMs = virtualMs;
+    m->produced = 0;
+    m->powerCycles++;
+  }
+  if (!on) m->dma.clear();
+  m->on = on;
+}
+
+static uint32_t hostUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+static bool night() {
+  mic.room = noise(-80, 6);  // 40 dB SPL
+  NoiseMonitor monitor(micRead, micPower, hostUs, &mic);
+  const uint32_t endMs = NIGHT_H * 3600u * 1000u;
+  uint32_t polls = 0, windows = 0;
+  double ns = 0, worstNs = 0;
+  bool levelsOk = true;
+  for (virtualMs = 0; virtualMs < endMs; virtualMs += POLL_MS) {
+    mic.advance(virtualMs);
+    auto t0 = Clock::now();
+    bool done = monitor.poll(virtualMs);
+    double d =
+        std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    ns += d;
+    if (d > worstNs) worstNs = d;
+    polls++;
+    if (done) {
+      windows++;
+      const NoiseLevels& l = monitor.levels();
+      levelsOk &= l.frames == NOISE_WINDOW_FRAMES &&
+                  fabs(l.rmsDb8 / 8.0 + 80) <= MAX_LEVEL_ERROR_DB;
+    }
+  }
+  char json[192];
+  monitor.toJson(json, sizeof(json), virtualMs);
+  double micDuty = monitor.micDuty(virtualMs);
+  uint32_t expected = endMs / NOISE_PERIOD_MS;
+
+  printf("\nNight of %d h, polled every %d ms (%u polls):\n", NIGHT_H, POLL_MS,
+         polls);
+  printf("  windows: %u (expected %u), microphone power cycles: %u\n",
+         windows, expected, mic.powerCycles);
+  printf("  microphone on: %.2f%% of the time (%.0f ms per %d s window)\n",
+         micDuty * 100, micDuty * NOISE_PERIOD_MS, NOISE_PERIOD_MS / 1000);
+  printf("  poll(): %.0f ns mean, %.0f ns worst; CPU duty on this host "
+         "%.5f%%\n",
+         ns / polls, worstNs, 100.0 * ns / ((double)endMs * 1e6));
+  printf("  DMA overruns while measuring: %u samples\n", mic.overruns);
+  printf("  last report: %s\n", json);
+
+  bool ok = levelsOk && windows + 1 >= expected && windows <= expected &&
+            micDuty <= MAX_MIC_DUTY;
+  printf("  %s\n", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+int main() {
+  bool ok = accuracy();
+  cost();
+  ok &= night();
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
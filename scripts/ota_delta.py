@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Gateway OTA Delta Tool
+Creates and applies "SADL" delta images for the ESP32 gateway
+(format documented in include/gateway_esp32/delta_patch.h)
+
+A delta rebuilds the new firmware from the image already running on the
+gateway plus literal bytes, so only what changed is downloaded.
+
+Usage:
+    python ota_delta.py make old.bin new.bin update.sadl
+    python ota_delta.py apply old.bin update.sadl rebuilt.bin
+    python ota_delta.py bench old.bin new.bin
+    python ota_delta.py selftest            # synthetic images, no files needed
+"""
+
+import hashlib
+import random
+import struct
+import sys
+import time
+
+MAGIC = b"SADL"
+VERSION = 1
+HEADER = struct.Struct("<4sB3xII32s32s")  # 80 bytes
+OP_END, OP_COPY, OP_INSERT = 0, 1, 2
+
+BLOCK = 32          # Match granularity when indexing the old image
+MIN_MATCH = 24      # Shorter matches cost more as ops than as literals
+COPY_BUFFER = 512   # DELTA_COPY_BUFFER on the device
+
+
+def make_delta(old, new):
+    """Greedy block matcher: index old by BLOCK-sized aligned blocks, scan new
+    byte by byte and extend every hit in both directions."""
+    index = {}
+    for off in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(old[off:off + BLOCK], off)
+
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(old), len(new),
+                                hashlib.sha256(old).digest(),
+                                hashlib.sha256(new).digest()))
+    literal_start = 0
+    i = 0
+    while i + BLOCK <= len(new):
+        src = index.get(new[i:i + BLOCK])
+        if src is None:
+            i += 1
+            continue
+        # Extend backwards into pending literals, then forwards
+        start, s = i, src
+        while start > literal_start and s > 0 and new[start - 1] == old[s - 1]:
+            start -= 1
+            s -= 1
+        end, e = i + BLOCK, src + BLOCK
+        while end < len(new) and e < len(old) and new[end] == old[e]:
+            end += 1
+            e += 1
+        if end - start < MIN_MATCH:
+            i += 1
+            continue
+        if start > literal_start:
+            out += struct.pack("<BI", OP_INSERT, start - literal_start)
+            out += new[literal_start:start]
+        out += struct.pack("<BII", OP_COPY, s, end - start)
+        literal_start = i = end
+
+    if literal_start < len(new):
+        out += struct.pack("<BI", OP_INSERT, len(new) - literal_start)
+        out += new[literal_start:]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def apply_delta(old, delta):
+    """Reference applier, same checks as DeltaPatcher::feed()."""
+    magic, version, src_size, dst_size, src_sha, dst_sha = HEADER.unpack_from(delta)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a SADL v1 delta")
+    if src_size != len(old) or hashlib.sha256(old).digest() != src_sha:
+        raise ValueError("delta was made against a different source image")
+
+    out = bytearray()
+    pos = HEADER.size
+    while True:
+        op = delta[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            off, length = struct.unpack_from("<II", delta, pos)
+            pos += 8
+            if off + length > src_size:
+                raise ValueError("copy outside source")
+            # Bounded copy, like the device
+            for c in range(off, off + length, COPY_BUFFER):
+                out += old[c:min(c + COPY_BUFFER, off + length)]
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", delta, pos)
+            pos += 4
+            out += delta[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"bad opcode {op}")
+        if len(out) > dst_size:
+            raise ValueError("target overflow")
+
+    if len(out) != dst_size or hashlib.sha256(out).digest() != dst_sha:
+        raise ValueError("target hash mismatch")
+    return bytes(out)
+
+
+def bench(old, new, label=""):
+    t0 = time.perf_counter()
+    delta = make_delta(old, new)
+    t1 = time.perf_counter()
+    rebuilt = apply_delta(old, delta)
+    t2 = time.perf_counter()
+    assert rebuilt == new
+    # Device estimate: flash write ~ 100 KB/s erase+program, copy reads are free
+    # next to that, so apply time is dominated by the target size.
+    device_s = len(new) / (100 * 1024)
+    print(f"{label:<22} full {len(new) / 1024:>8.1f} KB  delta {len(delta) / 1024:>8.1f} KB "
+          f"({100.0 * len(delta) / len(new):5.1f}%)  make {t1 - t0:6.2f} s  "
+          f"apply {1000 * (t2 - t1):7.1f} ms host, ~{device_s:.1f} s device")
+    return delta
+
+
+def synthetic_pair(rng, size, edits):
+    """Firmware-like pair: repetitive code, some shifted insertions/patches."""
+    words = [rng.randbytes(4) for _ in range(2048)]
+    old = bytearray(b"".join(rng.choice(words) for _ in range(size // 4)))
+    new = bytearray(old)
+    for _ in range(edits):
+        pos = rng.randrange(len(new))
+        kind = rng.random()
+        if kind < 0.4:
+            new[pos:pos] = rng.randbytes(rng.randrange(4, 256))    # insertion
+        elif kind < 0.7:
+            del new[pos:pos + rng.randrange(4, 256)]               # deletion
+        else:
+            n = rng.randrange(1, 64)
+            new[pos:pos + n] = rng.randbytes(n)                    # patch
+    return bytes(old), bytes(new)
+
+
+def selftest():
+    rng = random.Random(78)
+    print("Synthetic 1.2 MB images:")
+    for edits in (0, 10, 100, 1000):
+        old, new = synthetic_pair(rng, 1200 * 1024, edits)
+        bench(old, new, f"{edits} edits")
+    old, new = synthetic_pair(rng, 64 * 1024, 20)
+    delta = bytearray(make_delta(old, new))
+    delta[-2] ^= 0xFF
+    try:
+        apply_delta(old, bytes(delta))
+        raise SystemExit("corrupted delta was accepted")
+    except ValueError:
+        print("Corrupted delta rejected: OK")
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    cmd = sys.argv[1]
+    read = lambda p: open(p, "rb").read()
+    if cmd == "make" and len(sys.argv) == 5:
+        delta = bench(read(sys.argv[2]), read(sys.argv[3]), "make")
+        open(sys.argv[4], "wb").write(delta)
+    elif cmd == "apply" and len(sys.argv) == 5:
+        open(sys.argv[4], "wb").write(apply_delta(read(sys.argv[2]), read(sys.argv[3])))
+    elif cmd == "bench" and len(sys.argv) == 4:
+        bench(read(sys.argv[2]), read(sys.argv[3]), "bench")
+    elif cmd == "selftest":
+        selftest()
+    else:
+        print(__doc__)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+// Host simulation of the gateway's decode-ahead PCM ring
+// (include/gateway_esp32/pcm_ring.h).
+//
+// A simulated I2S DMA (8 x 128 frames, ~23 ms) drains at 44.1 kHz in
+// virtual time (100 us ticks, deterministic), and two variants play the
+// same stream:
+//   lockstep - the decode task writes straight into the DMA every 10 ms,
+//              as AudioGeneratorMP3::loop() does with AudioOutputI2S
+//   ring     - the decode task refills the PCM ring in bursts below the
+//              refill mark, and the output task every 5 ms moves frames
+//              from the ring into the DMA
+// Decoding an MP3 frame costs 0.4 ms of CPU, and every 23rd frame stalls
+// for 30-120 ms first (SD card contention with an upload, a WiFi burst).
+// Prints DMA underruns (audible gaps), starved time, and the ring's fill
+// and burst statistics.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/pcm_sim
+//       scripts/pcm_ring_sim.cpp src/gateway_esp32/pcm_ring.cpp
+//   /tmp/pcm_sim [seconds]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "include/gateway_esp32/pcm_ring.h"
+
+#define RATE_HZ 44100
+#define TICK_US 100
+#define MP3_FRAME 1152
+#define DMA_FRAMES (8 * 128)
+#define DECODE_US 400
+#define OUTPUT_PERIOD_US 5000
+#define DECODE_PERIOD_US 10000
+
+// I2S DMA: a fixed number of frames that the codec drains at RATE_HZ
+struct SimDma {
+  double queued = 0;
+  bool streaming = false;  // From the first frame until the stream ends
+  bool dry = false;
+  uint32_t underruns = 0;
+  double starvedMs = 0;
+
+  uint32_t space() const { return DMA_FRAMES - (uint32_t)ceil(queued); }
+  void push(uint32_t frames) {
+    queued += frames;
+    streaming = true;
+  }
+  void tick() {
+    const double frames = RATE_HZ * TICK_US / 1e6;
+    if (frames <= queued) {
+      queued -= frames;
+      dry = false;
+      return;
+    }
+    if (streaming) {
+      starvedMs += (frames - queued) * 1000.0 / RATE_HZ;
+      if (!dry) underruns++;
+      dry = true;
+    }
+    queued = 0;
+  }
+};
+
+// Ticks the decode task is blocked on an MP3 frame before its CPU time
+static uint32_t stallTicks(uint32_t index) {
+  static const int stalls[] = {30, 60, 120, 45, 90, 100};
+  if (index % 23 != 11) return 0;
+  return stalls[(index / 23) % 6] * 1000 / TICK_US;
+}
+
+static void decodeFrame(uint32_t index, int16_t* pcm) {
+  for (int i = 0; i < MP3_FRAME; i++) {
+    pcm[2 * i] = (int16_t)(index + i);
+    pcm[2 * i + 1] = (int16_t)(index - i);
+  }
+}
+
+// Decode task state shared by both variants
+struct Decoder {
+  uint32_t total;
+  uint32_t index = 0;        // Next MP3 frame to decode
+  uint32_t pos = MP3_FRAME;  // Frames of pcm already handed on
+  uint32_t busyTicks = 0;    // Stall and CPU left on the current frame
+  bool bursting = false;
+  int16_t pcm[2 * MP3_FRAME];
+
+  explicit Decoder(uint32_t frames) : total(frames) {}
+  bool done() const { return index == total && pos == MP3_FRAME; }
+
+  // One tick of work; true when a decoded frame is ready in pcm
+  bool step() {
+    if (busyTicks == 0) {
+      if (index == total) return false;
+      busyTicks = stallTicks(index) + DECODE_US / TICK_US;
+    }
+    if (--busyTicks > 0) return false;
+    decodeFrame(index++, pcm);
+    pos = 0;
+    return true;
+  }
+};
+
+struct Result {
+  uint32_t underruns;
+  double starvedMs;
+};
+
+static Result runLockstep(uint32_t totalFrames) {
+  SimDma dma;
+  Decoder dec(totalFrames);
+
+  for (uint64_t t = 0; !dec.done(); t++) {
+    // One loop() per period: push until the DMA is full, decoding as needed
+    if (t % (DECODE_PERIOD_US / TICK_US) == 0 && !dec.done()) {
+      dec.bursting = true;
+    }
+    while (dec.bursting) {
+      if (dec.pos == MP3_FRAME) {
+        if (!dec.step()) break;  // Still decoding; continues next tick
+      }
+      uint32_t n = MP3_FRAME - dec.pos;
+      if (n > dma.space()) n = dma.space();
+      dma.push(n);
+      dec.pos += n;
+      if (dec.pos < MP3_FRAME || dec.done()) dec.bursting = false;
+    }
+    if (dec.done()) dma.streaming = false;  // The rest plays out
+    dma.tick();
+  }
+  return {dma.underruns, dma.starvedMs};
+}
+
+static PcmRing ring;
+
+static Result runRing(uint32_t totalFrames) {
+  SimDma dma;
+  Decoder dec(totalFrames);
+  uint32_t burstStartFrames = 0;
+  uint64_t burstStartTick = 0;
+  bool finished = false;
+
+  for (uint64_t t = 0; !finished || ring.fill() > 0; t++) {
+    // Decoder: released every 10 ms, one burst when below the refill mark
+    if (t % (DECODE_PERIOD_US / TICK_US) == 0 && !dec.bursting && !finished &&
+        ring.fill() < ring.refillMark()) {
+      dec.bursting = true;
+      burstStartFrames = ring.written();
+      burstStartTick = t;
+    }
+    while (dec.bursting) {
+      bool end = false;
+      if (dec.pos == MP3_FRAME) {
+        if (dec.done()) {
+          ring.finish();  // What is buffered plays out
+          finished = true;
+          end = true;
+        } else if (!dec.step()) {
+          break;  // Still decoding; continues next tick
+        }
+      }
+      if (!end) {
+        dec.pos += ring.write(dec.pcm + 2 * dec.pos, MP3_FRAME - dec.pos);
+        end = dec.pos < MP3_FRAME;  // Ring full
+      }
+      if (end) {
+        dec.bursting = false;
+        ring.noteBurst(ring.written() - burstStartFrames,
+                       (uint32_t)((t - burstStartTick) * TICK_US));
+      }
+    }
+
+    // Output task: higher priority, ring -> DMA until the DMA is full
+    if (t % (OUTPUT_PERIOD_US / TICK_US) == 0) {
+      static int16_t chunk[2 * DMA_FRAMES];
+      uint32_t space = dma.space();
+      uint32_t n = ring.read(chunk, space);
+      if (n) dma.push(n);
+      if (n < space) ring.noteStarved();
+    }
+    if (finished && ring.fill() == 0) dma.streaming = false;
+    dma.tick();
+  }
+  return {dma.underruns, dma.starvedMs};
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 8.0;
+  uint32_t frames = (uint32_t)(seconds * RATE_HZ / MP3_FRAME);
+
+  printf("Playing %.1f s (%u MP3 frames), DMA %.0f ms, ring %.0f ms\n\n",
+         seconds, frames, DMA_FRAMES * 1000.0 / RATE_HZ,
+         PCM_RING_FRAMES * 1000.0 / RATE_HZ);
+
+  Result l = runLockstep(frames);
+  printf("lockstep: %3u underruns, %7.1f ms of silence\n", l.underruns,
+         l.starvedMs);
+
+  Result r = runRing(frames);
+  printf("ring:     %3u underruns, %7.1f ms of silence, ring ran dry %u "
+         "times\n",
+         r.underruns, r.starvedMs, ring.underruns());
+
+  char json[256];
+  ring.toJson(json, sizeof(json), RATE_HZ);
+  printf("\n%s\n", json);
+
+  bool ok = r.underruns == 0 && ring.underruns() == 0;
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""
+Gateway RAM Report
+Prints the static RAM (.data + .bss) each gateway source file links in, next
+to its RAM_BUDGET_* line in include/gateway_esp32/memory_map.h.
+
+Runs automatically after every gateway build (extra_scripts in
+platformio.ini) and fails the build when a file is over budget. It can also
+be run by hand against an existing build directory:
+
+Usage:
+    python ram_report.py [.pio/build/env_gateway_esp32] [--nm xtensa-esp32-elf-nm]
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+try:
+    ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+except NameError:  # SCons does not set __file__, it runs from the project
+    ROOT = os.getcwd()
+MEMORY_MAP = os.path.join(ROOT, "include", "gateway_esp32", "memory_map.h")
+DEFAULT_BUILD = os.path.join(ROOT, ".pio", "build", "env_gateway_esp32")
+RAM_TYPES = "bBdDsSvV"  # nm symbol types that occupy RAM (.bss/.data)
+
+
+def read_budgets():
+    """RAM_BUDGET_AUDIO_MANAGER (34 * 1024) -> {"audio_manager": 34816}"""
+    budgets = {}
+    pattern = re.compile(r"#define\s+RAM_BUDGET_(\w+)\s+\(([^)]*)\)")
+    with open(MEMORY_MAP) as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                expr = m.group(2)
+                if not re.fullmatch(r"[\d\s*+]+", expr):
+                    continue
+                budgets[m.group(1).lower()] = eval(expr)
+    return budgets
+
+
+def object_ram(nm, obj):
+    """Sum of sized RAM symbols defined in one object file"""
+    out = subprocess.run([nm, "-S", "--defined-only", obj],
+                         capture_output=True, text=True, check=True).stdout
+    total = 0
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in RAM_TYPES:
+            total += int(parts[1], 16)
+    return total
+
+
+def collect(build_dir, nm):
+    """{"audio_manager": bytes, ...} for every gateway object file"""
+    src_dir = os.path.join(build_dir, "src", "gateway_esp32")
+    sizes = {}
+    for name in sorted(os.listdir(src_dir)):
+        if name.endswith(".o"):
+            key = name.split(".")[0]
+            sizes[key] = object_ram(nm, os.path.join(src_dir, name))
+    return sizes
+
+
+def report(build_dir, nm):
+    budgets = read_budgets()
+    sizes = collect(build_dir, nm)
+
+    print("\n[RAM] Static RAM per source file (.data + .bss)")
+    print(f"  {'file':<26}{'bytes':>9}{'budget':>9}{'use':>7}")
+    over = []
+    for key in sorted(sizes, key=sizes.get, reverse=True):
+        used = sizes[key]
+        budget = budgets.get(key)
+        if budget:
+            pct = f"{100 * used / budget:.0f}%"
+            mark = "✗" if used > budget else "✓"
+            if used > budget:
+                over.append(key)
+            print(f"  {key:<26}{used:>9}{budget:>9}{pct:>7} {mark}")
+        elif used:
+            print(f"  {key:<26}{used:>9}{'-':>9}")
+    print(f"  {'total':<26}{sum(sizes.values()):>9}"
+          f"{sum(budgets.values()):>9}")
+
+    if over:
+        print(f"[RAM] ✗ Over budget: {', '.join(over)}")
+    return not over
+
+
+def find_nm(env=None):
+    """Toolchain nm: $NM if the platform sets it, else next to $CC"""
+    if env is not None:
+        nm = env.subst("$NM")
+        if nm and nm != "nm":
+            return nm
+        cc = env.subst("$CC")
+        if cc.endswith("gcc"):
+            return cc[:-3] + "nm"
+    return "xtensa-esp32-elf-nm"
+
+
+# ============================================================================
+# PlatformIO hook: post-action on the firmware ELF
+# ============================================================================
+try:
+    Import("env")  # noqa: F821 - provided by SCons when run as extra_script
+
+    def _post_build(source, target, env):
+        if not report(env.subst("$BUILD_DIR"), find_nm(env)):
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", _post_build)  # noqa: F821
+except NameError:
+    pass
+
+
+def main():
+    args = sys.argv[1:]
+    nm = find_nm()
+    if "--nm" in args:
+        i = args.index("--nm")
+        nm = args[i + 1]
+        del args[i:i + 2]
+    build_dir = args[0] if args else DEFAULT_BUILD
+    if not os.path.isdir(os.path.join(build_dir, "src", "gateway_esp32")):
+        print(f"No gateway objects under {build_dir}, build first")
+        return 1
+    return 0 if report(build_dir, nm) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
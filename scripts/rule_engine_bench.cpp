@@ -0,0 +1,140 @@
+// Host benchmark for the gateway's local rule engine
+// (include/gateway_esp32/rule_engine.h).
+//
+// Replays one simulated day of gateway inputs (remote samples every 5 s,
+// light every 2 s, clock every minute, playback state every second) through
+// a set of rules and compares incremental evaluation, where only rules that
+// read a changed input run, with evaluating every rule on every event.
+// Also reports the time from an input change to the action callback.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/rule_bench
+//       scripts/rule_engine_bench.cpp src/gateway_esp32/rule_engine.cpp
+//   /tmp/rule_bench [days]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "include/gateway_esp32/rule_engine.h"
+
+static const char* RULES =
+    "early:    time >= 06:20 && time < 06:30 && outside_temp < 5 -> play "
+    "/alarm.mp3\n"
+    "sunrise:  light > 200 && time >= 06:00 && time < 07:00 && !playing -> "
+    "fadein /birds.mp3 30\n"
+    "quiet:    time >= 22:00 || time < 06:00 -> volume 0.2\n"
+    "day:      time >= 07:00 && time < 22:00 -> volume 0.6\n"
+    "frost:    outside_temp < 0 -> publish frost\n"
+    "muggy:    dew_point > 18 && outside_temp > 25 -> publish muggy\n"
+    "uv:       uv >= 6 -> publish uv_high\n"
+    "storm:    pressure < 995 -> publish storm\n"
+    "dry:      outside_humidity < 30 -> publish dry_air\n"
+    "dark:     light < 5 && time >= 17:00 -> publish lights_on\n"
+    "weekend:  (weekday == 0 || weekday == 6) && time == 09:00 -> play "
+    "/weekend.mp3\n"
+    "silence:  playing && time >= 23:00 -> stop\n";
+
+struct Event {
+  RuleInput input;
+  float value;
+};
+
+static uint32_t fired = 0;
+static std::chrono::steady_clock::time_point eventStart;
+static std::vector<double> latencies;
+
+static void onAction(const Rule&, void*) {
+  fired++;
+  latencies.push_back(std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - eventStart)
+                          .count());
+}
+
+static std::vector<Event> simulate(int days) {
+  std::mt19937 rng(3);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  std::vector<Event> events;
+  bool playing = false;
+
+  for (int s = 0; s < days * 86400; s++) {
+    float hour = (s % 86400) / 3600.0f;
+    float daylight = std::max(0.0f, sinf((hour - 6.0f) / 12.0f * 3.14159f));
+    if (s % 5 == 0) {
+      float temp = 8.0f + 8.0f * daylight + 0.3f * noise(rng);
+      events.push_back({RULE_IN_OUTSIDE_TEMP, temp});
+      events.push_back({RULE_IN_OUTSIDE_HUMIDITY, 70.0f - 20.0f * daylight});
+      events.push_back({RULE_IN_PRESSURE, 1005.0f + 0.2f * noise(rng)});
+      events.push_back({RULE_IN_UV, 7.0f * daylight});
+      events.push_back({RULE_IN_DEW_POINT, temp - 6.0f});
+    }
+    if (s % 2 == 0) {
+      events.push_back({RULE_IN_LIGHT, 800.0f * daylight + 2.0f});
+    }
+    if (s % 60 == 0) {
+      events.push_back({RULE_IN_TIME, (float)((s % 86400) / 60)});
+      events.push_back({RULE_IN_WEEKDAY, (float)((s / 86400) % 7)});
+    }
+    if (s % 3600 == 0) playing = !playing && hour > 6 && hour < 7;
+    events.push_back({RULE_IN_PLAYING, playing ? 1.0f : 0.0f});
+  }
+  return events;
+}
+
+static double run(const std::vector<Event>& events, bool incremental,
+                  uint64_t* evaluated) {
+  RuleEngine engine;
+  char err[64];
+  if (!engine.load(RULES, err, sizeof(err))) {
+    fprintf(stderr, "rule error: %s\n", err);
+    exit(1);
+  }
+  engine.setActionCallback(onAction, nullptr);
+
+  *evaluated = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const Event& e : events) {
+    eventStart = std::chrono::steady_clock::now();
+    engine.setInput(e.input, e.value);
+    *evaluated += incremental ? engine.evaluate() : engine.evaluateAll();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+  int days = argc > 1 ? atoi(argv[1]) : 7;
+  std::vector<Event> events = simulate(days);
+
+  RuleEngine probe;
+  char err[64];
+  probe.load(RULES, err, sizeof(err));
+  printf("Rules:       %d (%d bytes of bytecode, %zu bytes engine state)\n",
+         probe.ruleCount(), probe.codeSize(), sizeof(RuleEngine));
+  printf("Events:      %zu over %d days\n\n", events.size(), days);
+
+  printf("%-12s %12s %12s %10s\n", "mode", "ns/event", "rules/event",
+         "fired");
+  std::vector<double> incrementalLatencies;
+  for (int incremental = 1; incremental >= 0; incremental--) {
+    uint64_t evaluated;
+    fired = 0;
+    latencies.clear();
+    double ns = run(events, incremental, &evaluated);
+    printf("%-12s %12.1f %12.2f %10u\n", incremental ? "incremental" : "full",
+           ns / events.size(), (double)evaluated / events.size(), fired);
+    if (incremental) incrementalLatencies.swap(latencies);
+  }
+
+  std::vector<double>& l = incrementalLatencies;
+  std::sort(l.begin(), l.end());
+  if (!l.empty()) {
+    printf("\nInput change to action: median %.0f ns, max %.0f ns\n",
+           l[l.size() / 2], l.back());
+  }
+  return 0;
+}
@@ -0,0 +1,205 @@
+// Host soak test of the gateway's portable per-sample data path.
+//
+// Replays 72 hours of virtual time through the portable pieces the gateway
+// runs for every remote sample: mesh duplicate suppression, the event bus,
+// sensor analytics with its JSON snapshot, and the rule engine (including an
+// hourly rule reload, as an MQTT "smartalarm/rules" update would cause).
+// Calls to global operator new are counted, the live malloc heap is sampled
+// and printed every 6 virtual hours. Once setup is done the heap must stay
+// flat: any growth or steady allocation rate fails the run.
+//
+// It says nothing about the task stacks, queues and decoder storage budgeted
+// in include/gateway_esp32/memory_map.h, which need the device: their
+// static_asserts and scripts/ram_report.py check them on a firmware build.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/soak_bench scripts/soak_bench.cpp
+//       src/gateway_esp32/event_bus.cpp src/gateway_esp32/rule_engine.cpp
+//       src/gateway_esp32/sensor_analytics.cpp
+//   /tmp/soak_bench [hours]
+
+#include <malloc.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "include/gateway_esp32/event_bus.h"
+#include "include/gateway_esp32/rule_engine.h"
+#include "include/gateway_esp32/sensor_analytics.h"
+#include "include/shared/espnow_mesh.h"
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+static uint64_t allocCount = 0;
+static uint64_t freeCount = 0;
+
+void* operator new(size_t size) {
+  allocCount++;
+  void* p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  if (p) freeCount++;
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+static size_t liveHeap() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#else
+  return (size_t)mallinfo().uordblks;
+#endif
+}
+
+// ============================================================================
+// Simulated gateway
+// ============================================================================
+#define NODES 4
+#define SAMPLE_PERIOD_MS 10000  // Per node, as SENSOR_SEND_INTERVAL
+#define LIGHT_PERIOD_MS 2000    // SENSOR_READ_INTERVAL on the gateway
+#define RELOAD_PERIOD_MS 3600000
+#define REPORT_PERIOD_MS (6 * 3600000ULL)
+
+static const char* RULES =
+    "frost: outside_temp < 2 -> publish frost\n"
+    "muggy: dew_point > 18 && outside_humidity > 70 -> publish muggy\n"
+    "dawn: light > 50 && time >= 06:30 && time < 08:00 -> fadein /wake.mp3 "
+    "30\n"
+    "storm: pressure < 997 -> play /storm.mp3\n"
+    "uv: uv > 6 -> publish uv_high\n";
+
+static uint32_t fired = 0;
+static void onAction(const Rule&, void*) { fired++; }
+
+int main(int argc, char** argv) {
+  double hours = argc > 1 ? atof(argv[1]) : 72.0;
+  uint64_t endMs = (uint64_t)(hours * 3600000.0);
+
+  // Everything below is sized at compile time; construct it up front the
+  // way the firmware's globals are
+  static EventBus bus;
+  static SensorAnalytics analytics;
+  static RuleEngine engine, staging;
+  static MeshDedupCache dedup;
+  char err[64];
+  char json[512];
+
+  engine.setActionCallback(onAction, nullptr);
+  staging.setActionCallback(onAction, nullptr);
+  if (!engine.load(RULES, err, sizeof(err))) {
+    printf("rule load failed: %s\n", err);
+    return 1;
+  }
+  int mqttSub = bus.subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE));
+  int displaySub = bus.subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE) |
+                                 EVENT_MASK(EVENT_AUDIO_STATE));
+
+  std::mt19937 rng(83);
+  std::normal_distribution<float> noise(0.0f, 0.2f);
+  std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+
+  uint64_t samples = 0, duplicates = 0, published = 0;
+  uint16_t seq[NODES] = {0};
+
+  printf("Soak: %.0f virtual hours, %d nodes every %d s\n", hours, NODES,
+         SAMPLE_PERIOD_MS / 1000);
+  printf("%8s %10s %10s %10s %8s %8s\n", "hour", "samples", "live_heap",
+         "delta", "allocs", "fired");
+
+  // Baseline after stdio has set up its buffers
+  uint64_t setupAllocs = allocCount;
+  size_t baseHeap = liveHeap();
+
+  for (uint64_t t = 0; t <= endMs; t += 1000) {
+    float day = (float)(t % 86400000ULL) / 86400000.0f;
+    float diurnal = sinf(2.0f * (float)M_PI * (day - 0.25f));
+
+    // Remote nodes, with the odd relayed duplicate
+    for (int n = 0; n < NODES; n++) {
+      if ((t / 1000 + n * 3) % (SAMPLE_PERIOD_MS / 1000) != 0) continue;
+      uint16_t s = ++seq[n];
+      int copies = uni(rng) < 0.05f ? 2 : 1;
+      for (int c = 0; c < copies; c++) {
+        if (dedup.checkAndInsert((uint8_t)(n + 1), s)) {
+          duplicates++;
+          continue;
+        }
+        SensorSampleEvent ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.data.timestamp = (uint32_t)t;
+        ev.data.temperature = 12.0f + 8.0f * diurnal + noise(rng);
+        ev.data.humidity = 65.0f - 20.0f * diurnal + noise(rng);
+        ev.data.pressure = 1005.0f + 10.0f * sinf((float)t / 9.0e7f);
+        ev.data.uvIndex = diurnal > 0 ? 8.0f * diurnal : 0.0f;
+        ev.data.sensorId = (uint8_t)(n + 1);
+        bus.publish(ev);
+        samples++;
+      }
+    }
+
+    // MQTT task: analytics and rule inputs per sample
+    Event e;
+    while (bus.poll(mqttSub, e)) {
+      const SensorData& d = e.as<SensorSampleEvent>()->data;
+      analytics.updateRemote(d, (uint32_t)t);
+      engine.setInput(RULE_IN_OUTSIDE_TEMP, d.temperature);
+      engine.setInput(RULE_IN_OUTSIDE_HUMIDITY, d.humidity);
+      engine.setInput(RULE_IN_PRESSURE, d.pressure);
+      engine.setInput(RULE_IN_UV, d.uvIndex);
+      engine.setInput(RULE_IN_DEW_POINT, analytics.getDewPoint());
+      engine.evaluate();
+      if (analytics.toJson(json, sizeof(json)) > 0) published++;
+    }
+    while (bus.poll(displaySub, e)) {
+    }
+
+    // Local light sensor and clock
+    if (t % LIGHT_PERIOD_MS == 0) {
+      float lux = diurnal > 0 ? 400.0f * diurnal : 0.5f;
+      analytics.update(SensorAnalytics::SIG_LIGHT, lux);
+      engine.setInput(RULE_IN_LIGHT, lux);
+      engine.setInput(RULE_IN_TIME, floorf(day * 1440.0f));
+      engine.evaluate();
+    }
+
+    // Rule update over MQTT: compile off to the side, then swap
+    if (t > 0 && t % RELOAD_PERIOD_MS == 0) {
+      if (staging.load(RULES, err, sizeof(err))) {
+        for (int i = 0; i < RULE_IN_COUNT; i++) {
+          staging.setInput((RuleInput)i, engine.getInput((RuleInput)i));
+        }
+        staging.prime();
+        memcpy((void*)&engine, (const void*)&staging, sizeof(RuleEngine));
+      }
+    }
+
+    if (t % REPORT_PERIOD_MS == 0) {
+      long delta = (long)liveHeap() - (long)baseHeap;
+      printf("%8.0f %10llu %10zu %+10ld %8llu %8u\n", t / 3600000.0,
+             (unsigned long long)samples, liveHeap(), delta,
+             (unsigned long long)(allocCount - setupAllocs), fired);
+    }
+  }
+
+  uint64_t steadyAllocs = allocCount - setupAllocs;
+  long growth = (long)liveHeap() - (long)baseHeap;
+  printf("\nsamples %llu, duplicates dropped %llu, snapshots %llu\n",
+         (unsigned long long)samples, (unsigned long long)duplicates,
+         (unsigned long long)published);
+  printf("bus dropped (mqtt/display): %u/%u\n", bus.dropped(mqttSub),
+         bus.dropped(displaySub));
+  printf("steady-state allocations: %llu, heap growth: %ld bytes\n",
+         (unsigned long long)steadyAllocs, growth);
+
+  bool flat = steadyAllocs == 0 && growth == 0;
+  printf("%s\n", flat ? "PASS: heap flat" : "FAIL: heap not flat");
+  return flat ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// Host test and benchmark of the gateway's spectrum display
+// (include/gateway_esp32/spectrum.h).
+//
+// Checks the fixed-point 256-point real FFT against a double-precision DFT
+// of the same windowed input: silence, DC, an impulse, sines from the
+// first bin to near Nyquist at 0 and -40 dBFS, white noise and a
+// full-scale square wave (the overflow case). The error of every bin is
+// taken relative to a full-scale bin and must stay below -60 dB, the
+// display's whole range. Then a sine per bar has to light that bar the
+// most, and the update() cost is measured: per call in ns and TSC cycles,
+// and as a share of the ESP32 at 240 MHz when the display runs it 5 times
+// a second.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/spectrum_bench
+//       scripts/spectrum_bench.cpp src/gateway_esp32/spectrum.cpp
+//   /tmp/spectrum_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "include/gateway_esp32/spectrum.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define N SPECTRUM_FFT_SIZE
+#define RATE 44100
+#define ERROR_LIMIT_DB -60.0
+#define UPDATES_PER_SECOND 5  // PERIOD_DISPLAY_MS 200
+#define RUNS 20000
+
+static int16_t twiddle[N], window[N];
+
+// ============================================================================
+// REFERENCE
+// ============================================================================
+// Worst bin error of spectrumFft against a double DFT, in dB relative to a
+// full-scale bin (32768 after the 1/N scaling)
+static double fftError(const int16_t* x) {
+  int32_t re[SPECTRUM_BINS], im[SPECTRUM_BINS];
+  spectrumFft(x, twiddle, re, im);
+  double worst = 0;
+  for (int k = 0; k < SPECTRUM_BINS; k++) {
+    double rr = 0, ri = 0;
+    for (int n = 0; n < N; n++) {
+      rr += x[n] * cos(2 * M_PI * k * n / N);
+      ri -= x[n] * sin(2 * M_PI * k * n / N);
+    }
+    double e = hypot(re[k] - rr / N, im[k] - ri / N);
+    if (e > worst) worst = e;
+  }
+  return worst > 0 ? 20.0 * log10(worst / 32768.0) : -200.0;
+}
+
+static void windowed(const std::vector<double>& v, int16_t* out) {
+  for (int i = 0; i < N; i++) {
+    int32_t s = (int32_t)lrint(v[i] * 32767.0);
+    s = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+    out[i] = (int16_t)((s * window[i] + 0x4000) >> 15);
+  }
+}
+
+static bool checkFft() {
+  struct Case {
+    char name[40];
+    std::vector<double> v;
+  };
+  std::vector<Case> cases;
+  cases.push_back({"silence", std::vector<double>(N, 0.0)});
+  cases.push_back({"DC full scale", std::vector<double>(N, 1.0)});
+  std::vector<double> imp(N, 0.0);
+  imp[N / 2] = 1.0;
+  cases.push_back({"impulse", imp});
+  const double bins[] = {1, 7.5, 31, 64, 100.3, 127};
+  for (double dbfs : {0.0, -40.0}) {
+    for (double b : bins) {
+      Case c;
+      snprintf(c.name, sizeof(c.name), "sine bin %.1f, %.0f dBFS", b, dbfs);
+      double a = pow(10.0, dbfs / 20.0);
+      for (int i = 0; i < N; i++) c.v.push_back(a * sin(2 * M_PI * b * i / N));
+      cases.push_back(c);
+    }
+  }
+  std::mt19937 rng(93);
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  Case noise = {"white noise", {}};
+  for (int i = 0; i < N; i++) noise.v.push_back(u(rng));
+  cases.push_back(noise);
+  Case square = {"square full scale", {}};
+  for (int i = 0; i < N; i++) square.v.push_back((i / 16) & 1 ? -1.0 : 1.0);
+  cases.push_back(square);
+
+  bool ok = true;
+  printf("FFT vs double DFT (worst bin error re full scale):\n");
+  for (const Case& c : cases) {
+    int16_t x[N];
+    windowed(c.v, x);  // As the display path feeds the FFT
+    double e = fftError(x);
+    bool pass = e < ERROR_LIMIT_DB;
+    printf("  %-26s %7.1f dB %s\n", c.name, e, pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+  return ok;
+}
+
+// ============================================================================
+// BARS
+// ============================================================================
+// Feed packed frames as the I2S writer does, in 220-frame spans
+static bool feed(Spectrum& s, double hz, double dbfs, uint32_t& phase) {
+  uint32_t frames[220];
+  double a = pow(10.0, dbfs / 20.0) * 32767.0;
+  for (int round = 0; round < 4 && s.capturing(); round++) {
+    for (int i = 0; i < 220; i++, phase++) {
+      int16_t v = (int16_t)lrint(a * sin(2 * M_PI * hz * phase / RATE));
+      frames[i] = (uint16_t)v | (uint32_t)(uint16_t)v << 16;
+    }
+    s.capture(frames, 220);
+  }
+  return !s.capturing();
+}
+
+static bool checkBars() {
+  bool ok = true;
+  printf("\nBars (one sine per bar, -6 dBFS):\n");
+  for (int bar = 0; bar < SPECTRUM_BARS; bar++) {
+    Spectrum s;
+    uint8_t levels[SPECTRUM_BARS];
+    s.update(levels);  // Arms the first capture
+    uint32_t phase = 0;
+    // Middle of the bar, in Hz
+    double lo = Spectrum::bandStart(bar), hi = Spectrum::bandStart(bar + 1);
+    double hz = (lo + hi - 1) / 2.0 * RATE / N;
+    if (!feed(s, hz, -6.0, phase) || !s.update(levels)) {
+      printf("  capture did not complete\n");
+      return false;
+    }
+    int top = 0;
+    for (int b = 1; b < SPECTRUM_BARS; b++) {
+      if (levels[b] > levels[top]) top = b;
+    }
+    printf("  %6.0f Hz:", hz);
+    for (int b = 0; b < SPECTRUM_BARS; b++) printf(" %3u", levels[b]);
+    printf("  %s\n", top == bar ? "ok" : "FAIL");
+    ok &= top == bar;
+  }
+  return ok;
+}
+
+// ============================================================================
+// COST
+// ============================================================================
+static void cost() {
+  Spectrum s;
+  uint8_t levels[SPECTRUM_BARS];
+  s.update(levels);
+  uint32_t phase = 0;
+  double ns = 0;
+#ifdef HAVE_TSC
+  uint64_t cycles = 0;
+#endif
+  for (int r = 0; r < RUNS; r++) {
+    feed(s, 1000.0 + r % 500, -12.0, phase);
+    auto t0 = Clock::now();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    s.update(levels);
+#ifdef HAVE_TSC
+    cycles += __rdtsc() - c0;
+#endif
+    ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+  }
+  printf("\nupdate(): %.0f ns per call", ns / RUNS);
+#ifdef HAVE_TSC
+  double perCall = (double)cycles / RUNS;
+  printf(", %.0f TSC cycles; at %d per second that is %.4f%% of a 240 MHz "
+         "core",
+         perCall, UPDATES_PER_SECOND,
+         100.0 * perCall * UPDATES_PER_SECOND / 240e6);
+#endif
+  printf("\ncapture(): %d sample copies per update in the I2S writer\n", N);
+  printf("state: %zu bytes\n", sizeof(Spectrum));
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+int main() {
+  spectrumTables(twiddle, window);
+  bool ok = checkFft();
+  ok &= checkBars();
+  cost();
+  printf("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,545 @@
+// Host simulation of synchronized multi-room playback
+// (include/gateway_esp32/sync_playback.h).
+//
+// Four gateways with their own crystals (-20..+20 ppm, which also clocks
+// their I2S), boot times, SNTP errors (+-10 ms, re-synced hourly) and
+// latency profiles run the real SyncClock and SyncPlayout in virtual time
+// (deterministic, 100 us ticks):
+//   main loop   - SyncClock::tick() every 100 ms; the master's beacons reach
+//                 the others SYNC_AIR_US (+-50 us) later, a third of them
+//                 queued behind WiFi traffic for another 0-30 ms, 5% lost,
+//                 each stamped 20-100 us after it arrived
+//   output task - every 5 ms (up to 1 ms late), the I2S writer: silence,
+//                 skips, copies and trims into the DMA buffers as
+//                 SyncPlayout plans them; the blocking write at alignment
+//                 returns 20-80 us after the buffer boundary
+//   decoder     - fills the PCM ring at 8x real time up to its depth
+// A "play_at" for 1.5 s ahead reaches each gateway after its own MQTT
+// delay (one gets it 2 s late and has to join in step), and the track
+// starts after a 30-250 ms file open. Then, while the track plays: the
+// master loses power at 40 min (another takes over) and comes back at
+// 70 min, one gateway's decoder stalls for 300 ms at 90 min (an SD retry),
+// and a second play_at at 100 min starts all four again.
+//
+// Every 10 ms the sim compares the track position each DAC is playing.
+// It prints the spread across gateways at each start and in steady play
+// (median, p99 and maximum), the recovery after the stall, and each
+// gateway's clock and trim statistics. For comparison it also prints the
+// spread when each gateway simply starts on arrival of the MQTT message
+// and plays at its crystal's rate.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/sync_sim scripts/sync_playback_sim.cpp
+//       src/gateway_esp32/sync_playback.cpp
+//       src/gateway_esp32/latency_profile.cpp
+//   /tmp/sync_sim [seed]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <vector>
+
+#include "include/gateway_esp32/latency_profile.h"
+#include "include/gateway_esp32/sync_playback.h"
+
+#define GATEWAYS 4
+#define RATE 44100
+#define BUF I2S_DMA_BUF_FRAMES
+#define TICK_US 100
+#define LOOP_US 100000  // loop() of main.cpp
+#define OUTPUT_PERIOD_US 5000
+#define MEASURE_US 10000
+#define DECODE_SPEED 8  // Real time
+#define SIM_MIN 150
+#define EPOCH_US 1700000000000000LL  // UTC of virtual time 0
+#define LEAD_MS 1500
+#define MIN(m) ((int64_t)(m) * 60000000LL)
+
+// Events
+#define PLAY1_T (MIN(2))
+#define MASTER_OFF_T (MIN(40))
+#define MASTER_ON_T (MIN(70))
+#define STALL_T (MIN(90))
+#define STALL_US 300000
+#define PLAY2_T (MIN(100))
+#define SETTLE_US 3000000  // Excluded from steady play after an event
+
+#define MAX_STEADY_SPREAD_US 300
+#define MAX_START_SPREAD_US 200
+#define MAX_RECOVERY_MS 3000
+
+// Deterministic across hosts and standard libraries
+class Rng {
+ public:
+  explicit Rng(uint64_t seed) : s(seed) {}
+  double uniform() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return (s >> 11) * (1.0 / 9007199254740992.0);
+  }
+  double range(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+  double exponential(double mean) { return -mean * log(1.0 - uniform()); }
+
+ private:
+  uint64_t s;
+};
+
+static Rng rng(1);
+
+// ============================================================================
+// GATEWAY
+// ============================================================================
+// What a run of written frames holds: track frames from `track` on, or
+// silence (track < 0)
+struct Segment {
+  int64_t pos;
+  int64_t len;
+  int64_t track;
+};
+
+struct Gateway {
+  uint8_t mac[6];
+  double ppm;
+  double bootT;   // Virtual time the local clock read 0
+  bool on;
+  int dmaBuffers;
+  int ringDepth;
+
+  bool sntpSet;
+  double sntpAt;    // Last SNTP sync, and its error
+  double sntpErr;
+  double nextSntp;
+
+  SyncClock clock;
+  SyncPlayout playout;
+
+  // Command and output
+  double commandT;  // Arrival of a play_at, < 0 when none is pending
+  int64_t startUs;
+  double beginT;    // I2S output begins (file open done)
+  bool output;
+  double dacT;      // Virtual time the DAC started frame 0
+  int64_t written;  // Frames handed to the DMA
+  std::deque<Segment> segments;
+  double ring;      // Frames in the PCM ring
+  int64_t trackNext;
+  double lastDecodeT;
+  double stallUntil;
+
+  double nextLoop, nextOutput;
+
+  int64_t local(double t) const {
+    return (int64_t)llround((t - bootT) * (1 + ppm * 1e-6));
+  }
+  int64_t utc(double t) const {
+    return EPOCH_US + (int64_t)llround(t + sntpErr +
+                                       (t - sntpAt) * ppm * 1e-6);
+  }
+  double dacPos(double t) const {
+    return (t - dacT) * RATE * (1 + ppm * 1e-6) / 1e6;
+  }
+  // Virtual time the DAC reaches frame pos
+  double dacTime(double pos) const {
+    return dacT + pos * 1e6 / (RATE * (1 + ppm * 1e-6));
+  }
+  int64_t space(double t) const {
+    int64_t k = (int64_t)floor(dacPos(t) / BUF);
+    return (k + dmaBuffers) * BUF - written;
+  }
+  void write(int64_t frames, int64_t track) {
+    if (frames <= 0) return;
+    if (!segments.empty() && segments.back().track < 0 && track < 0) {
+      segments.back().len += frames;
+    } else {
+      segments.push_back({written, frames, track});
+    }
+    written += frames;
+  }
+  // Track time the DAC plays at t, false in silence
+  bool position(double t, double* seconds) {
+    if (!output) return false;
+    double p = dacPos(t);
+    while (!segments.empty() &&
+           segments.front().pos + segments.front().len <= (int64_t)p) {
+      segments.pop_front();
+    }
+    if (segments.empty() || segments.front().pos > (int64_t)p ||
+        segments.front().track < 0) {
+      return false;
+    }
+    const Segment& s = segments.front();
+    *seconds = (s.track + (p - s.pos)) / RATE;
+    return true;
+  }
+};
+
+static Gateway gw[GATEWAYS];
+
+static void boot(Gateway& g, double t) {
+  g.on = true;
+  g.bootT = t;
+  g.clock = SyncClock();
+  g.clock.begin(g.mac);
+  g.playout.disarm();
+  g.commandT = -1;
+  g.output = false;
+  g.nextLoop = t;
+  g.nextOutput = t;
+  g.sntpSet = false;
+  g.sntpAt = 0;
+  g.sntpErr = 0;
+  g.nextSntp = t + rng.range(2e6, 5e6);  // After WiFi comes up
+}
+
+// ============================================================================
+// BEACONS
+// ============================================================================
+struct Delivery {
+  double t;
+  int to;
+  int from;
+  SyncBeacon beacon;
+  bool operator>(const Delivery& o) const { return t > o.t; }
+};
+
+static std::priority_queue<Delivery, std::vector<Delivery>,
+                           std::greater<Delivery>>
+    air;
+
+static void broadcast(int from, const SyncBeacon& b, double t) {
+  for (int i = 0; i < GATEWAYS; i++) {
+    if (i == from || rng.uniform() < 0.05) continue;
+    double delay = SYNC_AIR_US + rng.range(-50, 50);
+    if (rng.uniform() < 0.33) delay += rng.range(0, 30000);
+    air.push({t + delay, i, from, b});
+  }
+}
+
+// ============================================================================
+// OUTPUT TASK
+// ============================================================================
+static void decode(Gateway& g, double t) {
+  if (t >= g.stallUntil) {
+    g.ring += (t - g.lastDecodeT) * RATE * DECODE_SPEED / 1e6;
+    if (g.ring > g.ringDepth) g.ring = g.ringDepth;
+  }
+  g.lastDecodeT = t;
+}
+
+// Runs SyncPlayout's plan against the DMA and the ring; returns the time
+// the writer is done (later than t after a blocking alignment)
+static double writer(Gateway& g, double t) {
+  decode(g, t);
+  // Dry DMA: the next write lands in the next buffer
+  double p = g.dacPos(t);
+  if (g.written < (int64_t)ceil(p)) {
+    int64_t next = ((int64_t)floor(p) / BUF + 1) * BUF;
+    g.write(next - g.written, -1);
+  }
+
+  if (g.playout.prerolling()) {
+    g.write(g.space(t), -1);
+    int64_t local = g.local(t);
+    if (!g.playout.alignDue(g.clock.toShared(local))) return t;
+    // Blocking writes of a buffer each, back at a buffer boundary
+    for (;;) {
+      int64_t k = (int64_t)floor(g.dacPos(t) / BUF);
+      t = g.dacTime((k + 1) * BUF) + rng.range(20, 80);
+      g.write(g.space(t), -1);
+      local = g.local(t);
+      if (g.playout.align(g.clock.toShared(local), local)) break;
+    }
+    decode(g, t);
+  }
+
+  int64_t local = g.local(t);
+  g.playout.update(g.clock.toShared(local), local, g.clock.skewPpb());
+  for (;;) {
+    uint32_t n;
+    SyncAction a = g.playout.next(&n);
+    int64_t space = g.space(t);
+    int64_t avail = (int64_t)g.ring;
+    int64_t done = 0;
+    switch (a) {
+      case SYNC_SILENCE:
+        done = std::min<int64_t>(n, space);
+        g.write(done, -1);
+        break;
+      case SYNC_SKIP:
+        done = std::min<int64_t>(n, avail);
+        g.trackNext += done;
+        g.ring -= done;
+        break;
+      case SYNC_COPY:
+        done = std::min<int64_t>(std::min<int64_t>(n, space), avail);
+        g.write(done, g.trackNext);
+        g.trackNext += done;
+        g.ring -= done;
+        break;
+      case SYNC_REPEAT:
+        done = space && avail ? 1 : 0;
+        g.write(done, g.trackNext);
+        break;
+      case SYNC_DROP:
+        done = avail ? 1 : 0;
+        g.trackNext += done;
+        g.ring -= done;
+        break;
+      case SYNC_WAIT:
+        return t;
+    }
+    if (done) g.playout.done(a, (uint32_t)done);
+    if (done < (int64_t)n || !done) break;
+  }
+  return t;
+}
+
+static void beginOutput(Gateway& g, double t) {
+  g.output = true;
+  g.dacT = t;
+  g.written = 0;
+  g.segments.clear();
+  g.ring = 0;
+  g.trackNext = 0;
+  g.lastDecodeT = t;
+  g.stallUntil = 0;
+  g.playout.arm(g.startUs, RATE, BUF, g.dmaBuffers * BUF);
+}
+
+// ============================================================================
+// MEASUREMENT
+// ============================================================================
+struct Window {
+  const char* name;
+  double from, to;
+  double limitUs;
+  std::vector<double> spreads;
+};
+
+static double percentile(std::vector<double> v, double q) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+static void command(double t, double* arrivals) {
+  // The controller schedules by its own SNTP time
+  int64_t at = EPOCH_US + (int64_t)(t + rng.range(-5000, 5000)) +
+               LEAD_MS * 1000LL;
+  for (int i = 0; i < GATEWAYS; i++) {
+    double delay = rng.range(20e3, 300e3);
+    if (i == 3 && t < PLAY2_T) delay = 2.0e6;  // Joins late
+    arrivals[i] = t + delay;
+    if (!gw[i].on) continue;
+    gw[i].commandT = t + delay;
+    gw[i].startUs = at;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1;
+  rng = Rng(seed * 2654435761u + 1);
+
+  static const LatencyProfile profiles[GATEWAYS] = {
+      LATENCY_BALANCED, LATENCY_LOW, LATENCY_ROBUST, LATENCY_BALANCED};
+  for (int i = 0; i < GATEWAYS; i++) {
+    Gateway& g = gw[i];
+    for (int b = 0; b < 6; b++) g.mac[b] = (uint8_t)(rng.uniform() * 256);
+    g.ppm = i == 0 ? 20 : i == 1 ? -20 : rng.range(-20, 20);
+    const LatencyProfileSpec& spec = latencyProfileSpec(profiles[i]);
+    g.dmaBuffers = spec.dmaBuffers;
+    g.ringDepth = spec.ringFrames;
+    boot(g, rng.range(0, 2e6));
+    g.on = false;  // Until its boot time
+  }
+
+  std::vector<Window> windows = {
+      {"first start", PLAY1_T, PLAY1_T + SETTLE_US, MAX_START_SPREAD_US, {}},
+      {"steady, one master", PLAY1_T + SETTLE_US, MASTER_OFF_T,
+       MAX_STEADY_SPREAD_US, {}},
+      {"master lost", MASTER_OFF_T, MASTER_OFF_T + SETTLE_US,
+       MAX_STEADY_SPREAD_US, {}},
+      {"steady, new master", MASTER_OFF_T + SETTLE_US, STALL_T,
+       MAX_STEADY_SPREAD_US, {}},
+      {"second start", PLAY2_T, PLAY2_T + SETTLE_US, MAX_START_SPREAD_US, {}},
+      {"steady, all four", PLAY2_T + SETTLE_US, MIN(SIM_MIN),
+       MAX_STEADY_SPREAD_US, {}},
+  };
+  double arrivals1[GATEWAYS], arrivals2[GATEWAYS];
+  bool commanded1 = false, commanded2 = false;
+  int masterLost = -1;
+  double stallRecovered = -1;
+  int stalled = -1;  // One still playing after the master came back
+  double stallPlayingEnd = -1;
+
+  for (double t = 0; t < MIN(SIM_MIN); t += TICK_US) {
+    // Power
+    for (int i = 0; i < GATEWAYS; i++) {
+      Gateway& g = gw[i];
+      if (!g.on && masterLost != i && t >= g.bootT) g.on = true;
+    }
+    if (masterLost < 0 && t >= MASTER_OFF_T) {
+      for (int i = 0; i < GATEWAYS; i++) {
+        if (gw[i].clock.isMaster()) masterLost = i;
+      }
+      gw[masterLost].on = false;
+      gw[masterLost].output = false;
+      stalled = (masterLost + 2) % GATEWAYS;
+    }
+    if (masterLost >= 0 && !gw[masterLost].on && t >= MASTER_ON_T) {
+      boot(gw[masterLost], t);
+    }
+
+    // Commands
+    if (!commanded1 && t >= PLAY1_T) {
+      command(t, arrivals1);
+      commanded1 = true;
+    }
+    if (!commanded2 && t >= PLAY2_T) {
+      command(t, arrivals2);
+      commanded2 = true;
+    }
+
+    // Beacons in flight
+    while (!air.empty() && air.top().t <= t) {
+      Delivery d = air.top();
+      air.pop();
+      Gateway& g = gw[d.to];
+      if (!g.on) continue;
+      double rx = d.t + rng.range(20, 100);  // Into the receive callback
+      g.clock.onBeacon(gw[d.from].mac, d.beacon, g.local(rx));
+    }
+
+    for (int i = 0; i < GATEWAYS; i++) {
+      Gateway& g = gw[i];
+      if (!g.on) continue;
+      // SNTP, hourly
+      if (t >= g.nextSntp) {
+        g.sntpSet = true;
+        g.sntpAt = t;
+        g.sntpErr = rng.range(-10000, 10000);
+        g.nextSntp = t + MIN(60);
+      }
+      if (t >= g.nextLoop) {
+        SyncBeacon b;
+        if (g.clock.tick(g.local(t), g.sntpSet ? g.utc(t) : 0, &b)) {
+          broadcast(i, b, t);
+        }
+        g.nextLoop = t + LOOP_US;
+      }
+      if (g.commandT >= 0 && t >= g.commandT) {
+        g.commandT = -1;
+        g.output = false;
+        g.playout.disarm();
+        g.beginT = t + rng.range(30e3, 250e3);
+      }
+      if (!g.output && g.beginT > 0 && t >= g.beginT) {
+        beginOutput(g, t);
+        g.beginT = 0;
+      }
+      if (i == stalled && t >= STALL_T && g.stallUntil < STALL_T) {
+        g.stallUntil = STALL_T + STALL_US;
+      }
+      if (g.output && t >= g.nextOutput) {
+        double done = writer(g, t);
+        g.nextOutput = done + OUTPUT_PERIOD_US + rng.range(0, 1000);
+      } else if (!g.output && t >= g.nextOutput) {
+        g.nextOutput = t + OUTPUT_PERIOD_US;
+      }
+    }
+
+    // Positions
+    if (fmod(t, MEASURE_US) != 0) continue;
+    double pos[GATEWAYS];
+    bool plays[GATEWAYS];
+    int playing = 0;
+    double lo = 1e18, hi = -1e18;
+    for (int i = 0; i < GATEWAYS; i++) {
+      plays[i] = gw[i].on && gw[i].position(t, &pos[i]);
+      if (!plays[i]) continue;
+      playing++;
+      lo = std::min(lo, pos[i]);
+      hi = std::max(hi, pos[i]);
+    }
+    if (playing < 2) continue;
+    double spreadUs = (hi - lo) * 1e6;
+    for (Window& w : windows) {
+      if (t >= w.from && t < w.to) w.spreads.push_back(spreadUs);
+    }
+    // Stall: playing again, no further from the others than in steady play
+    if (t > STALL_T + STALL_US && stallRecovered < 0 && plays[stalled] &&
+        spreadUs <= MAX_STEADY_SPREAD_US) {
+      stallRecovered = t;
+    }
+    if (t >= STALL_T && stallPlayingEnd < 0 && gw[stalled].output) {
+      double p;
+      if (!gw[stalled].position(t, &p)) stallPlayingEnd = t;
+    }
+  }
+
+  // ==========================================================================
+  // REPORT
+  // ==========================================================================
+  printf("Gateways at the end (seed %llu), playout of the second track:\n",
+         (unsigned long long)seed);
+  printf("  %-3s %-17s %6s %-9s %-8s %10s %8s %7s %6s %6s %6s\n", "#",
+         "MAC", "ppm", "profile", "role", "skew ppm", "err us", "late",
+         "rep", "drop", "resync");
+  for (int i = 0; i < GATEWAYS; i++) {
+    Gateway& g = gw[i];
+    char clockJson[256], playJson[256];
+    g.clock.toJson(clockJson, sizeof(clockJson));
+    g.playout.toJson(playJson, sizeof(playJson));
+    int late = 0, rep = 0, drop = 0, resync = 0;
+    sscanf(strstr(playJson, "\"late_frames\":") + 14, "%d", &late);
+    sscanf(strstr(playJson, "\"repeats\":") + 10, "%d", &rep);
+    sscanf(strstr(playJson, "\"drops\":") + 8, "%d", &drop);
+    sscanf(strstr(playJson, "\"resyncs\":") + 10, "%d", &resync);
+    printf("  %-3d %02X:%02X:%02X:%02X:%02X:%02X %+6.1f %-9s %-8s %+10.2f "
+           "%8d %7d %6d %6d %6d\n",
+           i, g.mac[0], g.mac[1], g.mac[2], g.mac[3], g.mac[4], g.mac[5],
+           g.ppm, latencyProfileSpec(profiles[i]).name,
+           g.clock.isMaster() ? "master" : "follower",
+           g.clock.skewPpb() / 1000.0, (int)g.clock.lastErrorUs(), late, rep,
+           drop, resync);
+  }
+  printf("  gateway %d was master until 40 min\n", masterLost);
+
+  bool ok = true;
+  printf("\nSpread of the track position across gateways (us):\n");
+  printf("  %-20s %8s %8s %8s %8s\n", "", "samples", "median", "p99", "max");
+  for (const Window& w : windows) {
+    double max = percentile(w.spreads, 1.0);
+    printf("  %-20s %8zu %8.0f %8.0f %8.0f\n", w.name, w.spreads.size(),
+           percentile(w.spreads, 0.5), percentile(w.spreads, 0.99), max);
+    ok &= !w.spreads.empty() && max <= w.limitUs;
+  }
+  double recoveryMs = (stallRecovered - (STALL_T + STALL_US)) / 1000;
+  printf("  decoder stall on gateway %d: silent from %.0f ms into it, back in "
+         "step %.0f ms after it\n",
+         stalled, (stallPlayingEnd - STALL_T) / 1000, recoveryMs);
+  ok &= stallRecovered > 0 && recoveryMs <= MAX_RECOVERY_MS;
+
+  // Without synchronization: each starts on arrival, at its crystal's rate
+  double lo = 1e18, hi = -1e18, lo1 = 1e18, hi1 = -1e18;
+  for (int i = 0; i < GATEWAYS; i++) {
+    double start = arrivals1[i] + 140e3;  // Mean file open
+    lo = std::min(lo, start);
+    hi = std::max(hi, start);
+    // Track time after an hour
+    double pos = (MIN(60) - start) * (1 + gw[i].ppm * 1e-6);
+    lo1 = std::min(lo1, pos);
+    hi1 = std::max(hi1, pos);
+  }
+  printf("\nUnsynchronized (start on arrival): %.0f ms apart at the start, "
+         "%.0f ms after an hour\n",
+         (hi - lo) / 1000, (hi1 - lo1) / 1000);
+
+  printf("\nResult: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
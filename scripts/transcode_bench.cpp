@@ -0,0 +1,381 @@
+// Host test and benchmark of the gateway's background transcoding
+// (include/gateway_esp32/transcode.h).
+//
+// Encodes test signals (a square-wave alarm, a chime of decaying partials,
+// band-limited noise as a stand-in for music) into IMA ADPCM and PCM
+// sidecars and decodes them again: PCM must come back bit-exact, ADPCM
+// above a minimum SNR. A job interrupted at a block boundary and resumed
+// (framesDone plus the last block written) must produce the same bytes as
+// one that ran through. Headers must parse back, and a short last block
+// must decode to exactly the frames in the fact chunk. The resume search
+// for an MP3 frame that needs no bit reservoir is checked on a synthetic
+// stream.
+//
+// Then it reports what playback of each variant costs: decode time per
+// second of audio (ns and TSC cycles, and as a share of a 240 MHz core)
+// and storage per minute. The MP3 decoder (libmad) only exists on the
+// device; there `decode` on smartalarm/commands publishes the decode
+// task's CPU share for the playing track and which variant it is.
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=c++17 -I. -o /tmp/transcode_bench
+//       scripts/transcode_bench.cpp src/gateway_esp32/transcode.cpp
+//       src/gateway_esp32/mp3_index.cpp
+//   /tmp/transcode_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "include/gateway_esp32/mp3_index.h"
+#include "include/gateway_esp32/transcode.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define RATE 44100
+#define SECONDS 20
+// IMA ADPCM floors. The square-wave alarm, with odd harmonics up to
+// 18 kHz at full swing, is the codec's worst case: 4 bits cannot follow the
+// edges, which is why tracks up to TRANSCODE_PCM_MAX_MS stay PCM.
+#define MIN_SNR_ALARM_DB 14.0
+#define MIN_SNR_DB 20.0  // Chime, noise and mono
+#define COST_RUNS 5
+
+typedef std::vector<int16_t> Pcm;  // Interleaved stereo
+
+// ============================================================================
+// SIGNALS
+// ============================================================================
+static int16_t clip(double v) {
+  long s = lrint(v * 32767.0);
+  return (int16_t)(s > 32767 ? 32767 : s < -32768 ? -32768 : s);
+}
+
+// Band-limited square beeps at 2 kHz, 4 per second
+static Pcm alarm(uint32_t frames) {
+  Pcm p(2 * frames);
+  for (uint32_t i = 0; i < frames; i++) {
+    double t = (double)i / RATE, v = 0;
+    if (fmod(t, 0.25) < 0.125) {
+      for (int h = 1; h <= 9; h += 2) v += sin(2 * M_PI * 2000 * h * t) / h;
+    }
+    p[2 * i] = p[2 * i + 1] = clip(0.5 * v);
+  }
+  return p;
+}
+
+// Struck partials every 0.6 s, different in each channel
+static Pcm chime(uint32_t frames) {
+  Pcm p(2 * frames);
+  const double partials[] = {523.25, 659.25, 783.99, 1046.5, 2093.0};
+  for (uint32_t i = 0; i < frames; i++) {
+    double t = fmod((double)i / RATE, 0.6), l = 0, r = 0;
+    for (int k = 0; k < 5; k++) {
+      double a = exp(-t * (3 + k)) * 0.15;
+      l += a * sin(2 * M_PI * partials[k] * t);
+      r += a * sin(2 * M_PI * partials[k] * 1.003 * t + k);
+    }
+    p[2 * i] = clip(l);
+    p[2 * i + 1] = clip(r);
+  }
+  return p;
+}
+
+// Noise through a one-pole low-pass: dense like a full mix
+static Pcm noise(uint32_t frames) {
+  Pcm p(2 * frames);
+  std::mt19937 rng(95);
+  std::normal_distribution<double> g(0.0, 0.25);
+  double l = 0, r = 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    l += 0.2 * (g(rng) - l);
+    r += 0.2 * (g(rng) - r);
+    p[2 * i] = clip(l);
+    p[2 * i + 1] = clip(r);
+  }
+  return p;
+}
+
+// ============================================================================
+// ENCODE / DECODE
+// ============================================================================
+// A whole sidecar: header, then blocks as the gateway writes them. stopAt
+// interrupts after that many whole blocks and resumes like the gateway:
+// a new encoder continued from the file so far.
+static std::vector<uint8_t> encode(const Pcm& in, uint16_t format,
+                                   uint16_t channels, uint32_t stopAt = 0) {
+  TranscodeInfo info;
+  transcodeSetup(info, format, channels, RATE, 123456);
+  std::vector<uint8_t> file(TRANSCODE_HEADER_MAX);
+  file.resize(transcodeHeader(info, file.data()));
+
+  uint8_t block[TRANSCODE_BLOCK_BYTES];
+  TranscodeEncoder enc;
+  enc.begin(info, block);
+  uint32_t frames = (uint32_t)(in.size() / 2), blocks = 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    if (!enc.add(in[2 * i], in[2 * i + 1])) {
+      file.insert(file.end(), block, block + enc.ready());
+      enc.next();
+      if (++blocks == stopAt) {
+        TranscodeEncoder resumed;
+        uint32_t done = blocks * info.samplesPerBlock;
+        resumed.begin(info, block, done,
+                      &file[file.size() - info.blockBytes]);
+        enc = resumed;
+        i = done;  // The frame that did not fit is offered again
+      }
+      enc.add(in[2 * i], in[2 * i + 1]);
+    }
+  }
+  size_t n = enc.finish();
+  file.insert(file.end(), block, block + n);
+
+  TranscodeInfo done = enc.written();
+  transcodeHeader(done, file.data());
+  return file;
+}
+
+static Pcm decode(const std::vector<uint8_t>& file, TranscodeInfo& info) {
+  Pcm out;
+  if (!transcodeParse(file.data(), file.size(), info)) return out;
+  TranscodeDecoder dec;
+  dec.begin(info);
+  for (uint32_t o = info.dataStart; o < file.size(); o += info.blockBytes) {
+    size_t n = file.size() - o < info.blockBytes ? file.size() - o
+                                                 : info.blockBytes;
+    dec.block(&file[o], n);
+    int16_t l, r;
+    while (out.size() / 2 < info.frames && dec.next(&l, &r)) {
+      out.push_back(l);
+      out.push_back(r);
+    }
+  }
+  return out;
+}
+
+static double snrDb(const Pcm& ref, const Pcm& got) {
+  double s = 0, e = 0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    s += (double)ref[i] * ref[i];
+    double d = (double)ref[i] - got[i];
+    e += d * d;
+  }
+  return e > 0 ? 10 * log10(s / e) : 200.0;
+}
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+static bool checkCodec() {
+  struct Signal {
+    const char* name;
+    Pcm pcm;
+    double minSnr;  // IMA ADPCM
+  };
+  const uint32_t frames = SECONDS * RATE + 777;  // Ends mid-block
+  Signal signals[] = {{"alarm", alarm(frames), MIN_SNR_ALARM_DB},
+                      {"chime", chime(frames), MIN_SNR_DB},
+                      {"noise", noise(frames), MIN_SNR_DB}};
+  bool ok = true;
+  printf("Round trip (%u frames per signal):\n", frames);
+  for (const Signal& s : signals) {
+    for (uint16_t format : {TRANSCODE_PCM, TRANSCODE_IMA_ADPCM}) {
+      std::vector<uint8_t> file = encode(s.pcm, format, 2);
+      TranscodeInfo info;
+      Pcm got = decode(file, info);
+      bool lengthOk = got.size() == s.pcm.size() && info.frames == frames;
+      double snr = lengthOk ? snrDb(s.pcm, got) : 0;
+      bool pass = lengthOk && (format == TRANSCODE_PCM ? snr >= 200.0
+                                                       : snr >= s.minSnr);
+      // Resumed after a third of the blocks: same bytes
+      uint32_t blocks = frames / info.samplesPerBlock;
+      bool resumeOk = encode(s.pcm, format, 2, blocks / 3) == file;
+      printf("  %-5s %-9s %8zu B  SNR %6.1f dB  %s  resume %s\n", s.name,
+             transcodeFormatName(format), file.size(), snr,
+             pass ? "ok" : "FAIL", resumeOk ? "ok" : "FAIL");
+      ok &= pass && resumeOk;
+    }
+  }
+
+  // Mono: the mix of both channels
+  Pcm mono = chime(RATE);
+  for (size_t i = 0; i < mono.size(); i += 2) mono[i + 1] = mono[i];
+  for (uint16_t format : {TRANSCODE_PCM, TRANSCODE_IMA_ADPCM}) {
+    TranscodeInfo info;
+    Pcm got = decode(encode(mono, format, 1), info);
+    bool pass = info.channels == 1 && got.size() == mono.size() &&
+                snrDb(mono, got) >= MIN_SNR_DB;
+    printf("  mono  %-9s %s\n", transcodeFormatName(format),
+           pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+  return ok;
+}
+
+static bool checkHeader() {
+  bool ok = true;
+  printf("\nHeaders:\n");
+  for (uint16_t format : {TRANSCODE_PCM, TRANSCODE_IMA_ADPCM}) {
+    for (uint16_t ch = 1; ch <= 2; ch++) {
+      TranscodeInfo a, b;
+      transcodeSetup(a, format, ch, 22050, 3456789);
+      a.frames = 1234567;
+      a.dataBytes = 987654;
+      uint8_t h[TRANSCODE_HEADER_MAX];
+      size_t n = transcodeHeader(a, h);
+      bool pass = transcodeParse(h, n, b) && memcmp(&a, &b, sizeof(a)) == 0 &&
+                  !transcodeParse(h, n - 9, b);  // Truncated: rejected
+      printf("  %-9s %u ch: %2zu B  %s\n", transcodeFormatName(format), ch, n,
+             pass ? "ok" : "FAIL");
+      ok &= pass;
+    }
+  }
+  return ok;
+}
+
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz, no CRC: 417-byte frames whose
+// first side info bits are main_data_begin
+static size_t memRead(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  const std::vector<uint8_t>* d = (const std::vector<uint8_t>*)ctx;
+  if (offset >= d->size()) return 0;
+  size_t n = d->size() - offset < len ? d->size() - offset : len;
+  memcpy(buf, d->data() + offset, n);
+  return n;
+}
+
+static bool checkResumeFrame() {
+  const int frames = 400;
+  std::vector<uint8_t> mp3;
+  std::vector<uint32_t> offsets;
+  std::vector<bool> clean;
+  std::mt19937 rng(96);
+  for (int f = 0; f < frames; f++) {
+    offsets.push_back((uint32_t)mp3.size());
+    uint8_t frame[417];
+    memset(frame, 0x55, sizeof(frame));
+    frame[0] = 0xFF, frame[1] = 0xFB, frame[2] = 0x90, frame[3] = 0x44;
+    uint32_t mdb = f == 0 || rng() % 23 == 0 ? 0 : 1 + rng() % 511;
+    frame[4] = (uint8_t)(mdb >> 1);
+    frame[5] = (uint8_t)((mdb & 1) << 7);
+    clean.push_back(mdb == 0);
+    mp3.insert(mp3.end(), frame, frame + sizeof(frame));
+  }
+
+  static uint8_t scratch[4096];
+  static Mp3Index index;
+  Mp3Indexer indexer(memRead, &mp3, (uint32_t)mp3.size(), scratch,
+                     sizeof(scratch));
+  bool ok = indexer.build(index, true);
+  int wrong = 0, searched = 0;
+  for (int f = 0; ok && f < frames; f += 7) {
+    const uint32_t maxBack = 64;
+    int expect = -1;
+    for (int g = f; g >= 0 && f - g <= (int)maxBack; g--) {
+      if (clean[g]) {
+        expect = g;
+        break;
+      }
+    }
+    uint32_t offset = 0;
+    uint32_t got = indexer.selfContainedFrame(index, f, maxBack, &offset);
+    bool right = expect < 0 ? got == UINT32_MAX
+                            : got == (uint32_t)expect &&
+                                  offset == offsets[expect];
+    wrong += !right;
+    searched++;
+  }
+  printf("\nResume frame search: %d positions, %d wrong  %s\n", searched,
+         wrong, ok && !wrong ? "ok" : "FAIL");
+  return ok && !wrong;
+}
+
+// ============================================================================
+// COST
+// ============================================================================
+static void cost() {
+  const uint32_t frames = SECONDS * RATE;
+  Pcm pcm = noise(frames);
+  printf("\nPlayback cost per second of audio (44.1 kHz stereo):\n");
+  for (uint16_t format : {TRANSCODE_PCM, TRANSCODE_IMA_ADPCM}) {
+    std::vector<uint8_t> file = encode(pcm, format, 2);
+    TranscodeInfo info;
+    if (!transcodeParse(file.data(), file.size(), info)) continue;
+
+    double ns = 0;
+    uint64_t cycles = 0;
+    volatile int32_t sink = 0;
+    for (int run = 0; run < COST_RUNS; run++) {
+      TranscodeDecoder dec;
+      dec.begin(info);
+      int32_t acc = 0;
+      auto t0 = Clock::now();
+#ifdef HAVE_TSC
+      uint64_t c0 = __rdtsc();
+#endif
+      for (uint32_t o = info.dataStart; o < file.size(); o += info.blockBytes) {
+        size_t n = file.size() - o < info.blockBytes ? file.size() - o
+                                                     : info.blockBytes;
+        dec.block(&file[o], n);
+        int16_t l, r;
+        while (dec.next(&l, &r)) acc += l ^ r;
+      }
+#ifdef HAVE_TSC
+      cycles += __rdtsc() - c0;
+#endif
+      ns += std::chrono::duration<double, std::nano>(Clock::now() - t0)
+                .count();
+      sink = acc;
+    }
+    (void)sink;
+    double perSecond = ns / COST_RUNS / SECONDS;
+    printf("  %-9s decode %8.0f ns", transcodeFormatName(format), perSecond);
+#ifdef HAVE_TSC
+    double c = (double)cycles / COST_RUNS / SECONDS;
+    printf(", %9.0f TSC cycles (%.2f%% of a 240 MHz core)", c,
+           100.0 * c / 240e6);
+#endif
+    printf(", %5.2f MB per minute\n",
+           (double)(file.size() - info.dataStart) / SECONDS * 60 / 1048576);
+  }
+
+  // The background job's own work besides the MP3 decode
+  TranscodeInfo info;
+  transcodeSetup(info, TRANSCODE_IMA_ADPCM, 2, RATE, 0);
+  uint8_t block[TRANSCODE_BLOCK_BYTES];
+  TranscodeEncoder enc;
+  enc.begin(info, block);
+  auto t0 = Clock::now();
+  for (uint32_t i = 0; i < frames; i++) {
+    if (!enc.add(pcm[2 * i], pcm[2 * i + 1])) {
+      enc.next();
+      enc.add(pcm[2 * i], pcm[2 * i + 1]);
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0)
+                  .count();
+  printf("  ima_adpcm encode %8.0f ns per second of audio (background job)\n",
+         ns / SECONDS);
+  printf("  mp3 128k: 0.92 MB per minute; decode cost is measured on the "
+         "device (\"decode\" command)\n");
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+int main() {
+  bool ok = checkCodec();
+  ok &= checkHeader();
+  ok &= checkResumeFrame();
+  cost();
+  printf("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+#include "../../include/gateway_esp32/alarm_synth.h"
+
+#include <string.h>
+
+#define TABLE_SIZE (1 << SYNTH_TABLE_BITS)
+#define FRAC_BITS 15  // Interpolation between table entries
+
+// ============================================================================
+// COMPILE-TIME TABLES
+// ============================================================================
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double cSin(double x) {
+  while (x > kPi) x -= 2 * kPi;
+  while (x < -kPi) x += 2 * kPi;
+  double term = x, sum = x;
+  for (int n = 1; n < 14; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// One cycle plus a guard entry, so interpolation never wraps
+struct Table {
+  int16_t v[TABLE_SIZE + 1];
+};
+
+// Band-limited at the highest alarm note: the top harmonic stays below
+// Nyquist up to ~3 kHz fundamentals
+template <int Wave>
+constexpr Table makeTable() {
+  double v[TABLE_SIZE] = {};
+  double peak = 0;
+  for (int i = 0; i < TABLE_SIZE; i++) {
+    double x = 2 * kPi * i / TABLE_SIZE;
+    if (Wave == SYNTH_SINE) {
+      v[i] = cSin(x);
+    } else if (Wave == SYNTH_SOFT_SQUARE) {
+      v[i] = cSin(x) + cSin(3 * x) / 3 + cSin(5 * x) / 5 + cSin(7 * x) / 7;
+    } else {
+      v[i] = cSin(x) + 0.5 * cSin(2 * x) + 0.25 * cSin(4 * x);
+    }
+    double a = v[i] < 0 ? -v[i] : v[i];
+    if (a > peak) peak = a;
+  }
+  Table t{};
+  for (int i = 0; i < TABLE_SIZE; i++) {
+    double s = v[i] / peak * 32767.0;
+    t.v[i] = (int16_t)(s >= 0 ? s + 0.5 : s - 0.5);
+  }
+  t.v[TABLE_SIZE] = t.v[0];
+  return t;
+}
+
+// Phase increment per frame of every MIDI note, equal temperament at A4 =
+// 440 Hz
+struct Pitches {
+  uint32_t step[128];
+};
+
+constexpr uint32_t toStep(double hz) {
+  return (uint32_t)(hz / SYNTH_RATE * 4294967296.0 + 0.5);
+}
+
+constexpr Pitches makePitches() {
+  Pitches p{};
+  const double semitone = 1.0594630943592953;  // 2^(1/12)
+  double hz = 440.0;
+  for (int n = 69; n < 128; n++, hz *= semitone) p.step[n] = toStep(hz);
+  hz = 440.0;
+  for (int n = 68; n >= 0; n--) {
+    hz /= semitone;
+    p.step[n] = toStep(hz);
+  }
+  return p;
+}
+
+constexpr Table kSine = makeTable<SYNTH_SINE>();
+constexpr Table kSoftSquare = makeTable<SYNTH_SOFT_SQUARE>();
+constexpr Table kOrgan = makeTable<SYNTH_ORGAN>();
+constexpr Pitches kPitches = makePitches();
+
+static_assert(kPitches.step[69] == toStep(440.0), "A4 must be 440 Hz");
+
+}  // namespace
+
+// ============================================================================
+// TUNES
+// ============================================================================
+// Classic clock alarm: four 2 kHz beeps, then a pause
+static const SynthNote kBeep[] = {{95, 1}, {0, 1}, {95, 1}, {0, 1},
+                                  {95, 1}, {0, 1}, {95, 1}, {0, 7}};
+// Rising C major arpeggio on a struck sine, closing on a chord
+static const SynthNote kChime[] = {{84, 1}, {88, 1}, {91, 1}, {96, 2},
+                                   {84, 0}, {91, 2}, {0, 4}};
+// Slow organ thirds, for a gentle wake-up
+static const SynthNote kRise[] = {{72, 0}, {76, 2}, {74, 0}, {79, 2},
+                                  {76, 0}, {81, 3}, {0, 2}};
+
+const SynthTune synthTunes[] = {
+    {"beep", SYNTH_SOFT_SQUARE, 70, 90, 3, 0, 100, 8, 14000, kBeep,
+     sizeof(kBeep) / sizeof(kBeep[0])},
+    {"chime", SYNTH_SINE, 180, 100, 4, 900, 0, 300, 12000, kChime,
+     sizeof(kChime) / sizeof(kChime[0])},
+    {"rise", SYNTH_ORGAN, 400, 80, 150, 300, 60, 400, 10000, kRise,
+     sizeof(kRise) / sizeof(kRise[0])},
+};
+const uint8_t synthTuneCount = sizeof(synthTunes) / sizeof(synthTunes[0]);
+
+const SynthTune* synthTune(const char* name) {
+  for (uint8_t i = 0; i < synthTuneCount; i++) {
+    if (strcmp(synthTunes[i].name, name) == 0) return &synthTunes[i];
+  }
+  return nullptr;
+}
+
+// ============================================================================
+// SYNTH
+// ============================================================================
+static inline uint32_t msToFrames(uint32_t ms) {
+  return (uint32_t)((uint64_t)ms * SYNTH_RATE / 1000);
+}
+
+AlarmSynth::AlarmSynth() : tune(nullptr), table(kSine.v), frameCount(0) {
+  memset(voices, 0, sizeof(voices));
+}
+
+void AlarmSynth::start(const SynthTune* t, uint32_t maxMs) {
+  memset(voices, 0, sizeof(voices));
+  tune = t;
+  if (!tune) return;
+  table = tune->wave == SYNTH_SOFT_SQUARE ? kSoftSquare.v
+          : tune->wave == SYNTH_ORGAN     ? kOrgan.v
+                                          : kSine.v;
+  next = 0;
+  stepLeft = 0;
+  ending = false;
+  frameCount = 0;
+  maxFrames = maxMs ? msToFrames(maxMs) : 0;
+
+  uint32_t attack = msToFrames(tune->attackMs);
+  uint32_t decay = msToFrames(tune->decayMs);
+  sustain = (int32_t)((int64_t)SYNTH_ENV_ONE * tune->sustainPct / 100);
+  attackStep = SYNTH_ENV_ONE / (int32_t)(attack ? attack : 1);
+  decayStep = (SYNTH_ENV_ONE - sustain) / (int32_t)(decay ? decay : 1);
+  releaseFrames = msToFrames(tune->releaseMs);
+  if (!releaseFrames) releaseFrames = 1;
+}
+
+void AlarmSynth::stop() {
+  if (!tune) return;
+  ending = true;
+  for (int i = 0; i < SYNTH_VOICES; i++) {
+    Voice& v = voices[i];
+    if (v.stage == OFF || v.stage == RELEASE) continue;
+    v.stage = RELEASE;
+    v.envStep = v.env / (int32_t)releaseFrames + 1;
+    v.gateLeft = 0;
+  }
+}
+
+// Trigger the notes of the next step (a chord and its closing note start
+// together) and time the step. At the end of the tune it loops, unless
+// maxMs has passed.
+void AlarmSynth::nextStep() {
+  const uint32_t stepFrames = msToFrames(tune->stepMs);
+  uint8_t chord[SYNTH_VOICES];
+  uint8_t held = 0;
+  for (uint8_t guard = 0; guard <= tune->count; guard++) {
+    if (next == tune->count) {
+      next = 0;
+      if (maxFrames && frameCount >= maxFrames) {
+        ending = true;
+        return;
+      }
+    }
+    const SynthNote& n = tune->notes[next++];
+    if (n.note && held < SYNTH_VOICES) chord[held++] = n.note;
+    if (n.steps == 0) continue;
+
+    stepLeft = n.steps * stepFrames;
+    uint32_t gate = stepLeft / 100 * tune->gatePct;
+    for (uint8_t i = 0; i < held; i++) noteOn(chord[i], gate);
+    return;
+  }
+  ending = true;  // A tune of chords only never advances
+}
+
+// A free voice, or the quietest one
+void AlarmSynth::noteOn(uint8_t note, uint32_t gate) {
+  Voice* v = &voices[0];
+  for (int i = 0; i < SYNTH_VOICES; i++) {
+    if (voices[i].stage == OFF) {
+      v = &voices[i];
+      break;
+    }
+    if (voices[i].env < v->env) v = &voices[i];
+  }
+  v->phase = 0;  // Envelope starts at 0 too: no click
+  v->step = kPitches.step[note & 0x7F];
+  v->env = 0;
+  v->envStep = attackStep;
+  v->gateLeft = gate ? gate : 1;
+  v->stage = ATTACK;
+}
+
+inline int32_t AlarmSynth::voiceSample(Voice& v) {
+  switch (v.stage) {
+    case ATTACK:
+      v.env += v.envStep;
+      if (v.env >= SYNTH_ENV_ONE) {
+        v.env = SYNTH_ENV_ONE;
+        v.stage = DECAY;
+        v.envStep = decayStep;
+      }
+      break;
+    case DECAY:
+      v.env -= v.envStep;
+      if (v.env <= sustain) {
+        v.env = sustain;
+        v.stage = sustain ? SUSTAIN : OFF;
+      }
+      break;
+    case RELEASE:
+      v.env -= v.envStep;
+      if (v.env <= 0) {
+        v.env = 0;
+        v.stage = OFF;
+      }
+      break;
+    default:
+      break;
+  }
+  if (v.gateLeft && --v.gateLeft == 0 && v.stage != OFF) {
+    v.stage = RELEASE;
+    v.envStep = v.env / (int32_t)releaseFrames + 1;
+  }
+
+  uint32_t i = v.phase >> (32 - SYNTH_TABLE_BITS);
+  int32_t frac = (v.phase >> (32 - SYNTH_TABLE_BITS - FRAC_BITS)) &
+                 ((1 << FRAC_BITS) - 1);
+  int32_t a = table[i], b = table[i + 1];
+  int32_t wave = a + (((b - a) * frac) >> FRAC_BITS);
+  v.phase += v.step;
+  return (wave * (v.env >> 9)) >> 15;  // Q24 envelope as Q15
+}
+
+uint32_t AlarmSynth::render(int16_t* stereo, uint32_t frames) {
+  uint32_t done = 0;
+  if (!tune) return 0;
+  const int32_t level = tune->level >> 2;  // Q13: four voices fit in int32
+
+  for (; done < frames; done++) {
+    if (!ending && stepLeft == 0) nextStep();
+    if (ending) {
+      bool silent = true;
+      for (int v = 0; v < SYNTH_VOICES; v++) silent &= voices[v].stage == OFF;
+      if (silent) {
+        tune = nullptr;
+        break;
+      }
+    } else {
+      stepLeft--;
+    }
+
+    int32_t mix = 0;
+    for (int v = 0; v < SYNTH_VOICES; v++) {
+      if (voices[v].stage != OFF) mix += voiceSample(voices[v]);
+    }
+    int32_t s = (mix * level) >> 13;
+    if (s > 32767) s = 32767;
+    if (s < -32768) s = -32768;
+    stereo[2 * done] = (int16_t)s;
+    stereo[2 * done + 1] = (int16_t)s;
+    frameCount++;
+  }
+  return done;
+}
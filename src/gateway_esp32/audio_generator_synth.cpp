@@ -0,0 +1,52 @@
+#include "../../include/gateway_esp32/audio_generator_synth.h"
+
+#include "../../include/gateway_esp32/resampler.h"
+
+// Rendered at the ring's rate: the resampler stays a pass-through
+static_assert(SYNTH_RATE == RESAMPLER_OUTPUT_RATE,
+              "Synth must render at the I2S rate");
+
+AudioGeneratorSynth::AudioGeneratorSynth(AlarmSynth* synth)
+    : synth(synth), pos(0), count(0) {
+  running = false;
+  file = nullptr;
+  output = nullptr;
+}
+
+bool AudioGeneratorSynth::begin(AudioFileSource* source, AudioOutput* out) {
+  (void)source;
+  if (!out || !synth->running()) return false;
+  output = out;
+  pos = count = 0;
+  output->SetRate(SYNTH_RATE);
+  output->SetBitsPerSample(16);
+  output->SetChannels(2);
+  if (!output->begin()) return false;
+  running = true;
+  return true;
+}
+
+bool AudioGeneratorSynth::loop() {
+  if (!running) return false;
+  for (uint32_t offered = 0; offered < SYNTH_LOOP_FRAMES; offered++) {
+    if (pos == count) {
+      count = synth->render(buf, SYNTH_RENDER_FRAMES);
+      pos = 0;
+      if (!count) {
+        running = false;  // Tune over, tails faded
+        return false;
+      }
+    }
+    lastSample[0] = buf[2 * pos];
+    lastSample[1] = buf[2 * pos + 1];
+    // Refused: the same frame is offered again on the next loop()
+    if (!output->ConsumeSample(lastSample)) break;
+    pos++;
+  }
+  return true;
+}
+
+bool AudioGeneratorSynth::stop() {
+  running = false;
+  return output ? output->stop() : true;
+}
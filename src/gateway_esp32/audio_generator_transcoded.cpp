@@ -0,0 +1,87 @@
+#include "../../include/gateway_esp32/audio_generator_transcoded.h"
+
+AudioGeneratorTranscoded::AudioGeneratorTranscoded(const TranscodeInfo& info,
+                                                   uint32_t startFrame,
+                                                   uint8_t* buffer, size_t len)
+    : info(info),
+      buffer(buffer),
+      len(len),
+      startFrame(startFrame),
+      frame(0),
+      nextBlock(0),
+      pending(false) {
+  running = false;
+  file = nullptr;
+  output = nullptr;
+}
+
+bool AudioGeneratorTranscoded::begin(AudioFileSource* source,
+                                     AudioOutput* out) {
+  if (!source || !out || len < info.blockBytes || startFrame >= info.frames) {
+    return false;
+  }
+  file = source;
+  output = out;
+
+  // Straight to the block holding startFrame, then decode up to it
+  nextBlock = startFrame / info.samplesPerBlock;
+  frame = nextBlock * info.samplesPerBlock;
+  pending = false;
+  decoder.begin(info);
+  if (!readBlock()) return false;
+  int16_t l, r;
+  for (; frame < startFrame; frame++) {
+    if (!decoder.next(&l, &r)) return false;
+  }
+
+  output->SetRate(info.rate);
+  output->SetBitsPerSample(16);
+  output->SetChannels(2);
+  if (!output->begin()) return false;
+  running = true;
+  return true;
+}
+
+bool AudioGeneratorTranscoded::readBlock() {
+  uint32_t offset = nextBlock * info.blockBytes;
+  if (offset >= info.dataBytes) return false;
+  uint32_t want = info.dataBytes - offset;
+  if (want > info.blockBytes) want = info.blockBytes;
+  if (!file->seek(info.dataStart + offset, SEEK_SET)) return false;
+
+  uint32_t got = 0;
+  while (got < want) {
+    uint32_t n = file->read(buffer + got, want - got);
+    if (!n) break;
+    got += n;
+  }
+  if (!got) return false;
+  decoder.block(buffer, got);
+  nextBlock++;
+  return true;
+}
+
+bool AudioGeneratorTranscoded::loop() {
+  if (!running) return false;
+  for (uint32_t offered = 0; offered < TRANSCODED_LOOP_FRAMES; offered++) {
+    if (!pending) {
+      if (frame >= info.frames ||
+          (!decoder.next(&lastSample[0], &lastSample[1]) &&
+           !(readBlock() && decoder.next(&lastSample[0], &lastSample[1])))) {
+        running = false;  // End of the fact chunk, or of the file
+        return false;
+      }
+      pending = true;
+    }
+    // Refused: the same frame is offered again on the next loop()
+    if (!output->ConsumeSample(lastSample)) break;
+    pending = false;
+    frame++;
+  }
+  return true;
+}
+
+bool AudioGeneratorTranscoded::stop() {
+  running = false;
+  return output ? output->stop() : true;
+}
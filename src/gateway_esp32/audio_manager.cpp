@@ -4,7 +4,13 @@
 #include <SD.h>
 #include <SPI.h>
 #include <WiFi.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
 
+#include <atomic>
+#include <new>
+
+#include "../../include/gateway_esp32/memory_map.h"
 #include "../../include/gateway_esp32/mqtt_manager.h"
 #include "../../include/gateway_esp32/sd_manager.h"
 
@@ -19,20 +25,109 @@
 
 File fsFile;
 
+// ============================================================================
+// STATIC STORAGE - The decoder chain is rebuilt in place for every track
+// ============================================================================
+static StaticSlot<AudioOutputI2S> outSlot;
+static StaticSlot<AudioOutputRing> ringOutSlot;
+static StaticSlot<AudioFileSourceSD> fileSlot;
+static StaticSlot<AudioGeneratorMP3> mp3Slot;
+// libmad stream/frame/synth state, otherwise malloc'd by every begin(),
+// and the decode-ahead PCM between the decoder and the I2S writer task.
+// About 60 KB together, so begin() takes them from the heap once instead
+// of .bss (see memory_map.h); nullptr until then.
+static constexpr size_t MP3_WORKSPACE_BYTES =
+    AudioGeneratorMP3::preAllocSize();
+static uint8_t* mp3Workspace = nullptr;
+static PcmRing* pcmRing = nullptr;
+// Every track to the one I2S rate on its way into the ring
+static Resampler resampler;
+// Gain, speaker high-pass, EQ and limiter after the resampler
+static uint32_t dspCycles() { return ESP.getCycleCount(); }
+static DspChain dspChain(dspCycles);
+// Display bars: the I2S writer copies what it sends, the display transforms
+static Spectrum spectrum;
+// Seek table of the current track
+static Mp3Index trackIndex;
+// Built-in alarm tones, rendered into the same chain as a decoder
+static AlarmSynth alarmSynth;
+static StaticSlot<AudioGeneratorSynth> synthSlot;
+// Background loudness pass (decodes through the same chain when idle)
+static StaticSlot<AudioOutputLoudness> meterOutSlot;
+static LoudnessMeter loudnessMeter;
+// Transcoded sidecars: their player, and the background job's encoder
+static StaticSlot<AudioGeneratorTranscoded> transcodedSlot;
+static StaticSlot<AudioOutputTranscode> transcodeOutSlot;
+static TranscodeEncoder transcodeEncoder;
+// Output buffering profile, and the output task's hands-off flag while the
+// I2S output is rebuilt with other DMA buffers
+static LatencyGovernor latencyGovernor;
+static std::atomic<bool> outputHold(false);
+static std::atomic<bool> pumpBusy(false);
+// Scheduled start and trimming of playFileAt(), and the one DMA buffer of
+// silence whose blocking write finds a buffer boundary
+static SyncPlayout syncPlayout;
+static int16_t syncSilence[I2S_DMA_BUF_FRAMES * 2];
+
+static_assert(sizeof(outSlot) + sizeof(ringOutSlot) + sizeof(fileSlot) +
+                      sizeof(mp3Slot) + sizeof(resampler) + sizeof(dspChain) +
+                      sizeof(spectrum) +
+                      sizeof(trackIndex) + sizeof(alarmSynth) +
+                      sizeof(synthSlot) + sizeof(meterOutSlot) +
+                      sizeof(loudnessMeter) + sizeof(transcodedSlot) +
+                      sizeof(transcodeOutSlot) + sizeof(transcodeEncoder) +
+                      sizeof(latencyGovernor) + sizeof(syncPlayout) +
+                      sizeof(syncSilence) <=
+                  RAM_BUDGET_AUDIO_MANAGER,
+              "Audio storage exceeds RAM_BUDGET_AUDIO_MANAGER");
+// Indexes of other files (downloads, file_info) are built in a pool block
+static_assert(sizeof(Mp3Index) <= BUFFER_POOL_BLOCK_SIZE,
+              "Mp3Index must fit a transfer buffer");
+// The job encodes into a pool block; playback reads into the MP3 workspace
+static_assert(TRANSCODE_BLOCK_BYTES <= BUFFER_POOL_BLOCK_SIZE &&
+                  TRANSCODE_BLOCK_BYTES <= MP3_WORKSPACE_BYTES,
+              "Transcode block must fit a transfer buffer");
+
 AudioManager::AudioManager()
     : out{nullptr},
+      dmaBuffers{0},
+      ringOut{nullptr},
+      meterOut{nullptr},
+      transcodeOut{nullptr},
       file{nullptr},
-      id3{nullptr},
       mp3{nullptr},
+      synth{nullptr},
+      transcoded{nullptr},
+      generator{nullptr},
       initialized{false},
       isPlaying{false},
+      draining{false},
       currentVolume{0.5},
+      trackGain{1.0f},
       mqttManager{nullptr},
       sdManager{nullptr},
+      eventBus{nullptr},
+      bufferPool{nullptr},
+      syncClock{nullptr},
+      syncClockLock{nullptr},
       receivingFile{false},
       expectedSize{0},
       receivedSize{0},
       lastChunkTime{0},
+      indexed{false},
+      playStartMs{0},
+      playBase{0},
+      lastResumeSave{0},
+      playRequestUs{0},
+      awaitingFirstFrame{false},
+      decodeVariant{"mp3"},
+      decodeUs{0},
+      decodeFrames{0},
+      indexRequests{0},
+      analyzing{false},
+      transcoding{false},
+      transcodeBlock{nullptr},
+      transcodeStartMs{0},
       downloadingInProgress{false} {
   // Create Recursive Mutex
   audioMutex = xSemaphoreCreateRecursiveMutex();
@@ -45,23 +140,41 @@ AudioManager::~AudioManager() {
 
 // cleanup() is private helper, assumes caller holds lock!
 void AudioManager::cleanup() {
+  interruptLoudness();   // Starts over once the player is idle again
+  interruptTranscode();  // Continues from its .part once idle again
+  releaseDecoder();
+  disarmSync();
+  // Buffered audio of the old track must not play out
+  if (pcmRing) pcmRing->flush();
+  draining = false;
+  isPlaying = false;
+}
+
+// Tears down the decoder chain only; the PCM ring keeps playing
+void AudioManager::releaseDecoder() {
   if (mp3) {
     if (mp3->isRunning()) mp3->stop();
-    delete mp3;
+    mp3->~AudioGeneratorMP3();
     mp3 = nullptr;
   }
 
-  if (id3) {
-    delete id3;
-    id3 = nullptr;
+  if (synth) {
+    if (synth->isRunning()) synth->stop();
+    synth->~AudioGeneratorSynth();
+    synth = nullptr;
+  }
+
+  if (transcoded) {
+    if (transcoded->isRunning()) transcoded->stop();
+    transcoded->~AudioGeneratorTranscoded();
+    transcoded = nullptr;
   }
+  generator = nullptr;
 
   if (file) {
-    delete file;
+    file->~AudioFileSourceSD();
     file = nullptr;
   }
-
-  isPlaying = false;
 }
 
 bool AudioManager::begin() {
@@ -69,11 +182,31 @@ bool AudioManager::begin() {
     return true;
   }
 
+  // Allocated at boot, before the heap fragments, and kept across end()
+  if (!mp3Workspace) {
+    mp3Workspace = (uint8_t*)heap_caps_malloc(
+        MP3_WORKSPACE_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (!pcmRing) {
+    void* ring = heap_caps_malloc(sizeof(PcmRing),
+                                  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ring) pcmRing = new (ring) PcmRing();
+  }
+  if (!mp3Workspace || !pcmRing) {
+    Serial.println("[Audio] ✗ No memory for the decoder and PCM ring");
+    return false;
+  }
+
   // Initialize I2S output
   Serial.println("[Audio] Initializing I2S output...");
-  out = new AudioOutputI2S();
-  out->SetPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
-  out->SetGain(currentVolume);
+  createOutput(RESAMPLER_OUTPUT_RATE);  // Fixed from here on
+  pcmRing->setDepth(latencyProfileSpec(latencyGovernor.active()).ringFrames);
+  ringOut = new (ringOutSlot.get())
+      AudioOutputRing(pcmRing, &resampler, &dspChain, out);
+  meterOut = new (meterOutSlot.get()) AudioOutputLoudness(&loudnessMeter);
+  transcodeOut = new (transcodeOutSlot.get())
+      AudioOutputTranscode(&transcodeEncoder);
+  applyGain();
 
   initialized = true;
   Serial.println("[Audio] Audio system initialized");
@@ -81,11 +214,107 @@ bool AudioManager::begin() {
   return true;
 }
 
+void AudioManager::createOutput(uint32_t rate) {
+  dmaBuffers = latencyProfileSpec(latencyGovernor.active()).dmaBuffers;
+  out = new (outSlot.get())
+      AudioOutputI2S(0, AudioOutputI2S::EXTERNAL_I2S, dmaBuffers);
+  out->SetPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
+  out->SetRate(rate);
+  out->SetGain(1.0f);  // Volume is applied by the DSP chain, before its limiter
+}
+
+// Keeps the output task off the I2S output and the playout state until
+// releaseOutput()
+void AudioManager::holdOutput() {
+  outputHold.store(true);
+  while (pumpBusy.load()) vTaskDelay(1);
+}
+
+void AudioManager::releaseOutput() { outputHold.store(false); }
+
+// The DMA buffers are the I2S driver's, so another count needs a new
+// output. The output task keeps off it meanwhile; the next track's begin()
+// installs the driver again.
+void AudioManager::rebuildOutput() {
+  holdOutput();
+  uint8_t before = dmaBuffers;
+  out->stop();
+  out->~AudioOutputI2S();
+  createOutput(ringOut->rate());
+  releaseOutput();
+  Serial.printf("[Audio] I2S DMA buffers: %u -> %u\n", (unsigned)before,
+                (unsigned)dmaBuffers);
+}
+
+// Only between tracks: a new driver would cut into the audio
+void AudioManager::syncDmaBuffers() {
+  if (initialized && !isPlaying &&
+      dmaBuffers != latencyProfileSpec(latencyGovernor.active()).dmaBuffers) {
+    rebuildOutput();
+  }
+}
+
+void AudioManager::applyLatencyProfile() {
+  LatencyProfile active = latencyGovernor.active();
+  pcmRing->setDepth(latencyProfileSpec(active).ringFrames);
+  Serial.printf("[Audio] Latency profile %s (%u ms)%s\n",
+                latencyProfileSpec(active).name,
+                (unsigned)latencyProfileMs(active, RESAMPLER_OUTPUT_RATE),
+                active != latencyGovernor.requested() ? " after underruns"
+                                                      : "");
+  syncDmaBuffers();
+}
+
+void AudioManager::setLatencyProfile(LatencyProfile profile, bool automatic) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  latencyGovernor.configure(profile, automatic);
+  if (initialized) applyLatencyProfile();
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+}
+
+size_t AudioManager::latencyStatsJson(char* buf, size_t len) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  LatencyProfile active = latencyGovernor.active();
+  uint32_t ringFrames = pcmRing ? pcmRing->capacity() : 0;
+  int n = snprintf(
+      buf, len,
+      "{\"profile\":\"%s\",\"requested\":\"%s\",\"auto\":%s,"
+      "\"switches\":%u,\"dma_buffers\":%u,\"dma_ms\":%u,\"ring_ms\":%u,"
+      "\"latency_ms\":%u,\"underruns\":%u}",
+      latencyProfileSpec(active).name,
+      latencyProfileSpec(latencyGovernor.requested()).name,
+      latencyGovernor.automatic() ? "true" : "false",
+      (unsigned)latencyGovernor.switches(), (unsigned)dmaBuffers,
+      (unsigned)(dmaBuffers * I2S_DMA_BUF_FRAMES * 1000 /
+                 RESAMPLER_OUTPUT_RATE),
+      (unsigned)(ringFrames * 1000 / RESAMPLER_OUTPUT_RATE),
+      (unsigned)((dmaBuffers * I2S_DMA_BUF_FRAMES + ringFrames) * 1000 /
+                 RESAMPLER_OUTPUT_RATE),
+      (unsigned)pcmUnderruns());
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return n > 0 && (size_t)n < len ? n : 0;
+}
+
 void AudioManager::end() {
   cleanup();
 
+  if (ringOut) {
+    ringOut->~AudioOutputRing();
+    ringOut = nullptr;
+  }
+
+  if (meterOut) {
+    meterOut->~AudioOutputLoudness();
+    meterOut = nullptr;
+  }
+
+  if (transcodeOut) {
+    transcodeOut->~AudioOutputTranscode();
+    transcodeOut = nullptr;
+  }
+
   if (out) {
-    delete out;
+    out->~AudioOutputI2S();
     out = nullptr;
   }
 
@@ -94,7 +323,7 @@ void AudioManager::end() {
   Serial.println("[Audio] Audio system stopped");
 }
 
-bool AudioManager::playFile(const char* filename) {
+bool AudioManager::playFile(const char* filename, uint32_t startMs) {
   // LOCK
   xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);
 
@@ -104,51 +333,151 @@ bool AudioManager::playFile(const char* filename) {
     return false;
   }
 
-  // Check if SD manager is ready
-  if (!sdManager || !sdManager->isReady()) {
-    Serial.println("[Audio] SD manager not ready!");
+  // "tone:<name>", with or without the leading '/' of a file path
+  const char* tone = filename[0] == '/' ? filename + 1 : filename;
+  if (strncmp(tone, AUDIO_TONE_PREFIX, strlen(AUDIO_TONE_PREFIX)) == 0) {
+    bool result = playTone(tone + strlen(AUDIO_TONE_PREFIX));
     xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
-    return false;
+    return result;
   }
 
-  // Stop any currently playing audio
-  stop();
+  bool result = false;
+  if (!sdManager || !sdManager->isReady()) {
+    Serial.println("[Audio] ✗ SD manager not ready!");
+  } else {
+    // Stop any currently playing audio
+    stop();
+
+    // Determine file type by extension
+    String fname = String(filename);
+    fname.toLowerCase();
 
-  // Check if file exists
-  if (!sdManager->exists(filename)) {
-    Serial.printf("[Audio] File not found: %s\n", filename);
-    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
-    return false;
+    if (!sdManager->exists(filename)) {
+      Serial.printf("[Audio] ✗ File not found: %s\n", filename);
+    } else if (!fname.endsWith(".mp3")) {
+      Serial.println("[Audio] ✗ Unsupported file format. Use .mp3");
+    } else {
+      result = playMP3(filename, startMs);
+    }
   }
 
-  // Determine file type by extension
-  String fname = String(filename);
-  fname.toLowerCase();
+  // Whatever went wrong with the file, the alarm still sounds
+  if (!result && playTone(AUDIO_FALLBACK_TONE)) {
+    Serial.printf("[Audio] Falling back to tone '%s'\n", AUDIO_FALLBACK_TONE);
+    if (mqttManager) mqttManager->publish(TOPIC_STATUS, "fallback");
+    result = true;
+  }
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return result;
+}
 
-  if (fname.endsWith(".mp3")) {
-    bool result = playMP3(filename);
-    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
-    return result;
-  } else {
-    Serial.println("[Audio] Unsupported file format. Use .mp3");
-    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
-    return false;
+// Without an index: ID3v2 tags at the start, stepped over by their 10-byte
+// headers alone
+static uint32_t id3v2End(AudioFileSourceSD* file) {
+  uint32_t pos = 0;
+  uint8_t header[10];
+  while (file->seek(pos, SEEK_SET) &&
+         file->read(header, sizeof(header)) == sizeof(header)) {
+    uint32_t tag = id3v2TagSize(header);
+    if (!tag) break;
+    pos += tag;
   }
+  return pos;
+}
+
+// "/sound_1.mp3" -> "/sound_1.mp3.wav", or ".wav.part" while it is written
+static bool transcodePath(const char* filename, bool part, char* out,
+                          size_t len) {
+  int n = snprintf(out, len, "%s%s%s", filename, TRANSCODE_SUFFIX,
+                   part ? TRANSCODE_PART_SUFFIX : "");
+  return n > 0 && (size_t)n < len;
 }
 
-bool AudioManager::playMP3(const char* filename) {
+bool AudioManager::playMP3(const char* filename, uint32_t startMs) {
   xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  playRequestUs = micros();
 
   cleanup();  // Safe to call now
+  syncDmaBuffers();  // A pending latency profile change starts with the track
 
-  Serial.printf("[Audio] Playing MP3: %s\n", filename);
+  // Seek table from the sidecar, or a quick one from the first frames
+  if (currentFile != filename || !indexed) {
+    indexed = loadIndex(filename, trackIndex) ||
+              buildIndex(filename, trackIndex, false);
+    currentFile = filename;
+  }
 
-  file = new AudioFileSourceSD(filename);
-  id3 = new AudioFileSourceID3(file);
-  mp3 = new AudioGeneratorMP3();
+  // Normalized in the output's gain stage, at no cost per sample
+  bool measured = indexed && (trackIndex.h.flags & MP3_INDEX_LOUDNESS);
+  trackGain = measured ? powf(10.0f, trackIndex.h.gain / 2000.0f) : 1.0f;
+  applyGain();
+  if (indexed && !measured && loudnessFile.length() == 0) {
+    loudnessFile = filename;  // Measured the next time the player is idle
+  }
 
-  if (mp3->begin(id3, out)) {
+  // The transcoded sidecar when there is one: a fraction of the CPU, and
+  // seeks are sample accurate
+  TranscodeInfo sidecar;
+  char path[96];
+  if (loadTranscoded(filename, sidecar) &&
+      transcodePath(filename, false, path, sizeof(path))) {
+    uint32_t startFrame = (uint32_t)((uint64_t)startMs * sidecar.rate / 1000);
+    if (startFrame >= sidecar.frames) startFrame = startMs = 0;
+    file = new (fileSlot.get()) AudioFileSourceSD(path);
+    transcoded = new (transcodedSlot.get()) AudioGeneratorTranscoded(
+        sidecar, startFrame, mp3Workspace, MP3_WORKSPACE_BYTES);
+    if (transcoded->begin(file, ringOut)) {
+      generator = transcoded;
+      decodeVariant = transcodeFormatName(sidecar.format);
+      Serial.printf("[Audio] Playing MP3: %s (%s sidecar)", filename,
+                    decodeVariant);
+      if (startMs) Serial.printf(" from %u ms", startMs);
+      Serial.println();
+    } else {
+      Serial.printf("[Audio] ✗ Unreadable sidecar %s, decoding the MP3\n",
+                    path);
+      releaseDecoder();
+    }
+  } else if (indexed && transcodeFile.length() == 0) {
+    transcodeFile = filename;  // Transcoded the next time the player is idle
+  }
+
+  if (!generator) {
+    uint32_t offset = 0;
+    if (startMs && indexed && startMs < trackIndex.durationMs()) {
+      uint32_t frame = trackIndex.frameForMs(startMs);
+      offset = frameOffset(filename, trackIndex, frame);
+      startMs = offset ? trackIndex.msForFrame(frame) : 0;
+    } else {
+      startMs = 0;
+    }
+
+    Serial.printf("[Audio] Playing MP3: %s", filename);
+    if (offset) Serial.printf(" from %u ms (byte %u)", startMs, offset);
+    Serial.println();
+
+    // The decoder starts on the first audio frame: tags are stepped over by
+    // their declared size, never read through
+    file = new (fileSlot.get()) AudioFileSourceSD(filename);
+    if (!offset) offset = indexed ? trackIndex.h.audioStart : id3v2End(file);
+    file->seek(offset, SEEK_SET);
+    mp3 = new (mp3Slot.get())
+        AudioGeneratorMP3(mp3Workspace, MP3_WORKSPACE_BYTES);
+    if (mp3->begin(file, ringOut)) {
+      generator = mp3;
+      decodeVariant = "mp3";
+    }
+  }
+
+  if (generator) {
     isPlaying = true;
+    playStartMs = startMs;
+    playBase = pcmRing->written();  // Where flush() cut the old track
+    lastResumeSave = millis();
+    awaitingFirstFrame = true;
+    decodeUs = 0;
+    decodeFrames = 0;
+    publishState(AUDIO_STATE_PLAYING);
     // Publish playing status
     if (mqttManager) {
       mqttManager->publish(TOPIC_STATUS, "playing");
@@ -164,9 +493,54 @@ bool AudioManager::playMP3(const char* filename) {
   }
 }
 
+bool AudioManager::playTone(const char* name) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  const SynthTune* tune = synthTune(name);
+  if (!initialized || !tune) {
+    Serial.printf("[Audio] ✗ Unknown tone: %s\n", name);
+    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+    return false;
+  }
+  playRequestUs = micros();
+  if (isPlaying && !draining) saveResumePoint();
+  cleanup();
+  syncDmaBuffers();
+
+  // Nothing to resume, seek or normalize
+  currentFile = "";
+  indexed = false;
+  trackGain = 1.0f;
+  applyGain();
+
+  alarmSynth.start(tune, AUDIO_TONE_MAX_MS);
+  synth = new (synthSlot.get()) AudioGeneratorSynth(&alarmSynth);
+  if (!synth->begin(nullptr, ringOut)) {
+    Serial.println("[Audio] ✗ Failed to start tone");
+    cleanup();
+    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+    return false;
+  }
+  generator = synth;
+  decodeVariant = "tone";
+  decodeUs = 0;
+  decodeFrames = 0;
+  isPlaying = true;
+  playStartMs = 0;
+  playBase = pcmRing->written();
+  lastResumeSave = millis();
+  awaitingFirstFrame = true;
+  Serial.printf("[Audio] Playing tone: %s\n", name);
+  publishState(AUDIO_STATE_PLAYING);
+  if (mqttManager) mqttManager->publish(TOPIC_STATUS, "playing");
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return true;
+}
+
 void AudioManager::stop() {
   xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  if (isPlaying && !draining) saveResumePoint();
   cleanup();
+  publishState(AUDIO_STATE_IDLE);
   Serial.println("[Audio] Stopped");
   xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
 }
@@ -176,11 +550,62 @@ void AudioManager::loop() {
   // We grab the lock. If Core 0 is busy setting up a song (playFile),
   // we wait here instead of crashing on a bad pointer.
   if (xSemaphoreTakeRecursive(audioMutex, 5) == pdTRUE) {  // Wait max 5 ticks
+    // Underruns move to a deeper profile, a quiet spell back
+    if (initialized && latencyGovernor.update(pcmRing->underruns(), millis())) {
+      applyLatencyProfile();
+    }
 
-    if (initialized && isPlaying && mp3 && mp3->isRunning()) {
-      if (!mp3->loop()) {
-        Serial.println("[Audio] MP3 playback finished");
-        cleanup();  // Safe
+    if (initialized && isPlaying && generator && generator->isRunning()) {
+      // Decode in bursts: refill to full once the writer has drained the
+      // ring below the mark, otherwise leave the CPU to everyone else
+      if (pcmRing->fill() < pcmRing->refillMark()) {
+        uint32_t before = pcmRing->written();
+        uint32_t start = micros();
+        bool running = generator->loop();
+        uint32_t elapsed = micros() - start;
+        pcmRing->noteBurst(pcmRing->written() - before, elapsed);
+        decodeUs += elapsed;
+        decodeFrames += pcmRing->written() - before;
+
+        if (awaitingFirstFrame && pcmRing->written() != before) {
+          awaitingFirstFrame = false;
+          Serial.printf("[Audio] First audio %u ms after play request\n",
+                        (unsigned)((micros() - playRequestUs) / 1000));
+        }
+
+        // Right after a burst the ring is at its fullest, so the SD write
+        // has the most audio to hide behind
+        if (running && millis() - lastResumeSave >= RESUME_SAVE_INTERVAL_MS) {
+          saveResumePoint();
+        }
+
+        if (!running) {
+          Serial.println("[Audio] Decode finished, draining PCM ring");
+          ringOut->drain();
+          pcmRing->finish();
+          releaseDecoder();
+          draining = true;
+        }
+      }
+    } else if (!draining &&
+               (analyzing || (!transcoding && loudnessFile.length() > 0 &&
+                              indexQueue.length() == 0))) {
+      loudnessPass();
+    } else if (!draining &&
+               (transcoding || (transcodeFile.length() > 0 &&
+                                indexQueue.length() == 0))) {
+      transcodePass();  // A started job keeps the chain until it is done
+    } else if (draining) {
+      if (pcmRing->fill() == 0) {
+        Serial.println("[Audio] Playback finished");
+        draining = false;
+        isPlaying = false;
+        disarmSync();
+        // Played to the end: nothing to resume (a tone never had anything)
+        if (sdManager && currentFile.length() > 0) {
+          sdManager->remove(RESUME_FILE);
+        }
+        publishState(AUDIO_STATE_IDLE);
         // Publish finished status
         if (mqttManager) {
           mqttManager->publish(TOPIC_STATUS, "finished");
@@ -189,22 +614,362 @@ void AudioManager::loop() {
       }
     } else {
       isPlaying = false;
+      syncDmaBuffers();
     }
 
     xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
   }
 }
 
-void AudioManager::setVolume(float volume) {
+// CRITICAL: Runs in the high-priority output task on Core 1. Only touches
+// the ring (lock-free) and the I2S output, which lives until end().
+void AudioManager::pumpOutput() {
+  if (!out) return;
+  // Announce before checking, so rebuildOutput() either sees us busy or we
+  // see its hold
+  pumpBusy.store(true);
+  if (!outputHold.load()) {
+    if (syncPlayout.active()) {
+      pumpSynced();
+    } else {
+      pumpRing();
+    }
+  }
+  pumpBusy.store(false);
+}
+
+void AudioManager::pumpRing() {
+  pumpFrames(UINT32_MAX);
+  const uint32_t* frames;
+  if (pcmRing->peek(&frames) == 0) {
+    // Empty while the decoder should be ahead of us: audible gap
+    pcmRing->noteStarved();
+  }
+}
+
+// Up to max frames from the ring into the DMA buffers, in up to two spans:
+// before and after the ring wraps
+uint32_t AudioManager::pumpFrames(uint32_t max) {
+  uint32_t total = 0;
+  for (int pass = 0; pass < 2 && total < max; pass++) {
+    const uint32_t* frames;
+    uint32_t n = pcmRing->peek(&frames);
+    if (n > max - total) n = max - total;
+
+    uint32_t sent = 0;
+    while (sent < n) {
+      int16_t sample[2] = {(int16_t)(frames[sent] & 0xFFFF),
+                           (int16_t)(frames[sent] >> 16)};
+      if (!out->ConsumeSample(sample)) break;  // DMA buffers full
+      sent++;
+    }
+    if (spectrum.capturing()) spectrum.capture(frames, sent);
+    pcmRing->consume(sent);
+    total += sent;
+    if (n == 0 || sent < n) break;
+  }
+  return total;
+}
+
+// Up to max frames dropped from the ring
+uint32_t AudioManager::skipFrames(uint32_t max) {
+  uint32_t total = 0;
+  for (int pass = 0; pass < 2 && total < max; pass++) {
+    const uint32_t* frames;
+    uint32_t n = pcmRing->peek(&frames);
+    if (n > max - total) n = max - total;
+    pcmRing->consume(n);
+    total += n;
+    if (n == 0) break;
+  }
+  return total;
+}
+
+int64_t AudioManager::sharedTimeUs(int64_t localUs, int32_t* skewPpb) {
+  portENTER_CRITICAL(syncClockLock);
+  int64_t shared = syncClock->toShared(localUs);
+  *skewPpb = syncClock->skewPpb();
+  portEXIT_CRITICAL(syncClockLock);
+  return shared;
+}
+
+// playFileAt(): the writer carries out SyncPlayout's plan. Pre-roll keeps
+// the DMA full of silence; close to the start, blocking writes of one
+// buffer each return right after the DMA moved to the next buffer. That
+// blocks the output task for up to SYNC_ALIGN_BUFFERS + 1 buffer periods,
+// once per scheduled start.
+void AudioManager::pumpSynced() {
+  int16_t silence[2] = {0, 0};
+  int64_t local = esp_timer_get_time();
+  int32_t skew;
+  int64_t shared = sharedTimeUs(local, &skew);
+
+  if (syncPlayout.prerolling()) {
+    while (out->ConsumeSample(silence)) {
+    }
+    if (!syncPlayout.alignDue(shared)) return;
+    do {
+      size_t bytes;
+      // The output's port (createOutput() builds it on port 0)
+      i2s_write(I2S_NUM_0, syncSilence, sizeof(syncSilence), &bytes,
+                portMAX_DELAY);
+      local = esp_timer_get_time();
+      shared = sharedTimeUs(local, &skew);
+    } while (!syncPlayout.align(shared, local));
+  }
+
+  syncPlayout.update(shared, local, skew);
+  for (;;) {
+    uint32_t n;
+    SyncAction action = syncPlayout.next(&n);
+    uint32_t done = 0;
+    const uint32_t* frames;
+    switch (action) {
+      case SYNC_COPY:
+        done = pumpFrames(n);
+        break;
+      case SYNC_SILENCE:
+        while (done < n && out->ConsumeSample(silence)) done++;
+        break;
+      case SYNC_SKIP:
+        done = skipFrames(n);
+        break;
+      case SYNC_REPEAT:
+        if (pcmRing->peek(&frames)) {
+          int16_t sample[2] = {(int16_t)(frames[0] & 0xFFFF),
+                               (int16_t)(frames[0] >> 16)};
+          done = out->ConsumeSample(sample) ? 1 : 0;
+        }
+        break;
+      case SYNC_DROP:
+        done = skipFrames(1);
+        break;
+      case SYNC_WAIT:
+        return;
+    }
+    if (done) syncPlayout.done(action, done);
+    if (done < n) break;  // DMA full or ring empty
+  }
+}
+
+void AudioManager::disarmSync() {
+  if (!syncPlayout.active()) return;
+  holdOutput();
+  syncPlayout.disarm();
+  releaseOutput();
+}
+
+bool AudioManager::playFileAt(const char* filename, int64_t startUnixMs) {
+  if (!syncClock) {
+    Serial.println("[Audio] ✗ No shared clock for a scheduled start");
+    return false;
+  }
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+
+  portENTER_CRITICAL(syncClockLock);
+  bool synced = syncClock->synced();
+  portEXIT_CRITICAL(syncClockLock);
+  int32_t skew;
+  int64_t startUs = startUnixMs * 1000;
+  int64_t lateUs = sharedTimeUs(esp_timer_get_time(), &skew) - startUs;
+  uint32_t offsetMs =
+      lateUs > 0 ? (uint32_t)(lateUs / 1000) + AUDIO_SYNC_JOIN_MS : 0;
+
+  // Nothing reaches the ring before loop() decodes, which waits for the
+  // lock, so the playout is armed before the first frame is there
+  bool result = playFile(filename, offsetMs);
+  if (result) {
+    holdOutput();
+    syncPlayout.arm(startUs + (int64_t)offsetMs * 1000, RESAMPLER_OUTPUT_RATE,
+                    I2S_DMA_BUF_FRAMES, dmaBuffers * I2S_DMA_BUF_FRAMES);
+    releaseOutput();
+    if (offsetMs) {
+      Serial.printf("[Audio] Joining %u ms late\n", (unsigned)(lateUs / 1000));
+    } else {
+      Serial.printf("[Audio] Starting in %u ms\n",
+                    (unsigned)(-lateUs / 1000));
+    }
+    if (!synced) {
+      Serial.println("[Audio] ⚠ Shared clock not locked yet, SNTP time only");
+    }
+  }
+
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return result;
+}
+
+size_t AudioManager::syncStatsJson(char* buf, size_t len) {
+  if (!syncClock) return 0;
+  // Copies, so the lock and the output hold last no longer than that
+  portENTER_CRITICAL(syncClockLock);
+  SyncClock clock = *syncClock;
+  portEXIT_CRITICAL(syncClockLock);
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  holdOutput();
+  SyncPlayout playout = syncPlayout;
+  releaseOutput();
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+
+  char clockJson[192];
+  char playoutJson[192];
+  if (!clock.toJson(clockJson, sizeof(clockJson)) ||
+      !playout.toJson(playoutJson, sizeof(playoutJson))) {
+    return 0;
+  }
+  int n = snprintf(buf, len, "{\"clock\":%s,\"playout\":%s}", clockJson,
+                   playoutJson);
+  return n > 0 && (size_t)n < len ? n : 0;
+}
+
+size_t AudioManager::pcmStatsJson(char* buf, size_t len) {
+  if (!pcmRing) return 0;
+  return pcmRing->toJson(buf, len, ringOut ? ringOut->rate() : 0);
+}
+
+uint32_t AudioManager::pcmUnderruns() {
+  return pcmRing ? pcmRing->underruns() : 0;
+}
+
+bool AudioManager::spectrumLevels(uint8_t* levels) {
+  return spectrum.update(levels);
+}
+
+void AudioManager::setVolume(float volume, bool quiet) {
   currentVolume = constrain(volume, 0.0, 1.0);
-  if (out) {
-    out->SetGain(currentVolume);
+  applyGain();
+  if (!quiet) {
+    Serial.printf("[Audio] Volume set to %.2f\n", currentVolume);
   }
-  Serial.printf("[Audio] Volume set to %.2f\n", currentVolume);
 }
 
 float AudioManager::getVolume() { return currentVolume; }
 
+void AudioManager::applyGain() {
+  // Ahead of the limiter, so a boosted track cannot clip after EQ
+  dspChain.setGain(currentVolume * trackGain);
+}
+
+// ============================================================================
+// OUTPUT DSP (gain, high-pass, EQ, limiter)
+// ============================================================================
+
+void AudioManager::setHighPass(float hz) {
+  dspChain.setHighPass(hz);
+  Serial.printf("[Audio] High-pass %s %.0f Hz\n", hz > 0 ? "at" : "off,", hz);
+}
+
+bool AudioManager::setEqBand(int band, DspBandType type, float hz,
+                             float gainDb, float q) {
+  if (!dspChain.setBand(band, type, hz, gainDb, q)) {
+    Serial.printf("[Audio] ✗ Invalid EQ band %d\n", band);
+    return false;
+  }
+  Serial.printf("[Audio] EQ band %d: type %d, %.0f Hz, %+.1f dB, Q %.2f\n",
+                band, (int)type, hz, gainDb, q);
+  return true;
+}
+
+void AudioManager::setLimiter(float ceilingDbfs) {
+  dspChain.setLimiter(ceilingDbfs);
+  Serial.printf("[Audio] Limiter ceiling %.1f dBFS\n", ceilingDbfs);
+}
+
+size_t AudioManager::dspStatsJson(char* buf, size_t len) {
+  return dspChain.toJson(buf, len, getCpuFrequencyMhz() * 1000000);
+}
+
+// ============================================================================
+// BACKGROUND LOUDNESS PASS
+// ============================================================================
+
+void AudioManager::queueLoudness(const char* filename) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  if (loudnessFile.length() > 0 && loudnessFile != filename) {
+    interruptLoudness();
+    loudnessAfter = loudnessFile;  // Not lost, measured after this one
+  }
+  loudnessFile = filename;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+}
+
+// Lock held. Gives the decoder chain back; loudnessFile stays queued.
+void AudioManager::interruptLoudness() {
+  if (!analyzing) return;
+  Serial.println("[Audio] Loudness pass interrupted");
+  releaseDecoder();
+  analyzing = false;
+}
+
+// Lock held
+void AudioManager::nextLoudnessFile() {
+  loudnessFile = loudnessAfter;
+  loudnessAfter = "";
+}
+
+// From loop() with the lock held, while nothing plays. One MP3 frame per
+// decode period keeps each pass iteration as short as a playback burst.
+void AudioManager::loudnessPass() {
+  if (!initialized || downloadingInProgress) return;
+  if (!analyzing) {
+    startLoudnessPass();
+    return;
+  }
+  meterOut->setQuota(LOUDNESS_BURST_SAMPLES);
+  if (!mp3->loop()) finishLoudnessPass();
+}
+
+void AudioManager::startLoudnessPass() {
+  String filename = loudnessFile;
+  if (!sdManager || !sdManager->exists(filename.c_str())) {
+    nextLoudnessFile();
+    return;
+  }
+
+  loudnessMeter.reset();
+  file = new (fileSlot.get()) AudioFileSourceSD(filename.c_str());
+  file->seek(id3v2End(file), SEEK_SET);
+  mp3 = new (mp3Slot.get())
+      AudioGeneratorMP3(mp3Workspace, MP3_WORKSPACE_BYTES);
+  if (!mp3->begin(file, meterOut)) {
+    Serial.printf("[Audio] ✗ Loudness pass cannot decode %s\n",
+                  filename.c_str());
+    releaseDecoder();
+    nextLoudnessFile();
+    return;
+  }
+  analyzing = true;
+  Serial.printf("[Audio] Loudness pass started: %s\n", filename.c_str());
+}
+
+void AudioManager::finishLoudnessPass() {
+  releaseDecoder();
+  analyzing = false;
+  String filename = loudnessFile;
+  nextLoudnessFile();
+
+  float lufs = loudnessMeter.integratedLufs();
+  float gain = loudnessMeter.gainDb(LOUDNESS_TARGET_LUFS);
+  Serial.printf("[Audio] ✓ Loudness of %s: %.1f LUFS, peak %.2f, gain %+.1f "
+                "dB\n",
+                filename.c_str(), lufs, loudnessMeter.peak(), gain);
+
+  Mp3Index* index = bufferPool ? (Mp3Index*)bufferPool->acquire() : nullptr;
+  if (!index) return;
+  if (loadIndex(filename.c_str(), *index) ||
+      buildIndex(filename.c_str(), *index, false)) {
+    index->h.loudness = (int16_t)lroundf(lufs * 100);
+    index->h.gain = (int16_t)lroundf(gain * 100);
+    index->h.flags |= MP3_INDEX_LOUDNESS;
+    saveIndex(filename.c_str(), *index);
+    if (indexed && currentFile == filename) {
+      trackIndex.h.loudness = index->h.loudness;
+      trackIndex.h.gain = index->h.gain;
+      trackIndex.h.flags |= MP3_INDEX_LOUDNESS;
+    }
+  }
+  bufferPool->release((uint8_t*)index);
+}
+
 bool AudioManager::playing() {
   xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
 
@@ -213,7 +978,7 @@ bool AudioManager::playing() {
     return false;
   }
 
-  if (mp3 && mp3->isRunning()) {
+  if ((generator && generator->isRunning()) || draining) {
     xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
     return true;
   }
@@ -245,6 +1010,511 @@ void AudioManager::printSDInfo() {
   // Note: SD library doesn't provide total/used bytes like LittleFS
 }
 
+// ============================================================================
+// SEEK INDEX AND RESUME
+// ============================================================================
+
+// Mp3Indexer reader over an SD File
+static size_t readSdFile(void* ctx, uint32_t offset, uint8_t* buf,
+                         size_t len) {
+  File* f = static_cast<File*>(ctx);
+  if (!f->seek(offset)) return 0;
+  return f->read(buf, len);
+}
+
+// "/sound_1.mp3" -> "/sound_1.mp3.idx"
+static bool indexPath(const char* filename, char* out, size_t len) {
+  int n = snprintf(out, len, "%s%s", filename, MP3_INDEX_SUFFIX);
+  return n > 0 && (size_t)n < len;
+}
+
+bool AudioManager::loadIndex(const char* filename, Mp3Index& out) {
+  char path[96];
+  if (!sdManager || !indexPath(filename, path, sizeof(path))) return false;
+
+  File f = sdManager->openForRead(path);
+  if (!f) return false;
+  size_t n = f.read((uint8_t*)&out, sizeof(out));
+  f.close();
+
+  // Stale when the MP3 was replaced after indexing
+  return n >= sizeof(out.h) && out.valid() && n == out.storedSize() &&
+         out.h.fileSize == sdManager->getFileSize(filename);
+}
+
+bool AudioManager::buildIndex(const char* filename, Mp3Index& out,
+                              bool fullScan) {
+  if (!sdManager || !bufferPool) return false;
+  File f = sdManager->openForRead(filename);
+  if (!f) return false;
+  uint8_t* scratch = bufferPool->acquire();
+  if (!scratch) {
+    f.close();
+    return false;
+  }
+
+  uint32_t start = millis();
+  Mp3Indexer indexer(readSdFile, &f, f.size(), scratch,
+                     BUFFER_POOL_BLOCK_SIZE);
+  bool ok = indexer.build(out, fullScan);
+  uint32_t elapsed = millis() - start;
+  bufferPool->release(scratch);
+  f.close();
+
+  if (!ok) {
+    Serial.printf("[Audio] ✗ No MP3 frames found in %s\n", filename);
+    return false;
+  }
+  Serial.printf("[Audio] ✓ Indexed %s: %u frames, %u ms, %s, %u KB read in "
+                "%u ms\n",
+                filename, (unsigned)out.h.totalFrames,
+                (unsigned)out.durationMs(), fullScan ? "exact" : "estimated",
+                (unsigned)(indexer.bytesRead() / 1024), (unsigned)elapsed);
+
+  saveIndex(filename, out);
+  return true;
+}
+
+bool AudioManager::saveIndex(const char* filename, const Mp3Index& index) {
+  char path[96];
+  if (!sdManager || !indexPath(filename, path, sizeof(path))) return false;
+  if (!sdManager->writeFile(path, (const uint8_t*)&index,
+                            index.storedSize())) {
+    Serial.printf("[Audio] ✗ Could not save %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+uint32_t AudioManager::frameOffset(const char* filename, const Mp3Index& index,
+                                   uint32_t frame) {
+  if (!sdManager || !bufferPool) return 0;
+  File f = sdManager->openForRead(filename);
+  if (!f) return 0;
+  uint8_t* scratch = bufferPool->acquire();
+  if (!scratch) {
+    f.close();
+    return 0;
+  }
+
+  Mp3Indexer indexer(readSdFile, &f, f.size(), scratch,
+                     BUFFER_POOL_BLOCK_SIZE);
+  uint32_t offset = indexer.frameOffset(index, frame);
+  bufferPool->release(scratch);
+  f.close();
+  return offset;
+}
+
+void AudioManager::saveResumePoint() {
+  lastResumeSave = millis();
+  if (!sdManager || currentFile.length() == 0) return;
+
+  char line[128];
+  int n = snprintf(line, sizeof(line), "%s|%u", currentFile.c_str(),
+                   (unsigned)positionMs());
+  if (n > 0 && (size_t)n < sizeof(line)) {
+    sdManager->writeFile(RESUME_FILE, (const uint8_t*)line, n);
+  }
+}
+
+bool AudioManager::seek(uint32_t ms) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  bool ok = false;
+  if (isPlaying && currentFile.length() > 0) {
+    String filename = currentFile;  // playFile() reassigns it
+    ok = playFile(filename.c_str(), ms);
+  }
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return ok;
+}
+
+bool AudioManager::resume() {
+  if (!sdManager) return false;
+  File f = sdManager->openForRead(RESUME_FILE);
+  if (!f) {
+    Serial.println("[Audio] Nothing to resume");
+    return false;
+  }
+  char line[128];
+  size_t n = f.readBytes(line, sizeof(line) - 1);
+  f.close();
+  line[n] = '\0';
+
+  char* separator = strchr(line, '|');
+  if (!separator) return false;
+  *separator = '\0';
+  uint32_t ms = strtoul(separator + 1, nullptr, 10);
+
+  Serial.printf("[Audio] Resuming %s at %u ms\n", line, (unsigned)ms);
+  return playFile(line, ms);
+}
+
+uint32_t AudioManager::positionMs() {
+  if (!isPlaying) return 0;
+  uint32_t rate = ringOut ? ringOut->rate() : 0;
+  if (!rate) rate = indexed ? trackIndex.h.sampleRate : 44100;
+  // Frames the output took since the track started (before the flush of
+  // the previous track is applied, the difference is negative)
+  int32_t heard = (int32_t)(pcmRing->consumed() - playBase);
+  return playStartMs + (heard > 0 ? (uint32_t)((uint64_t)heard * 1000 / rate)
+                                  : 0);
+}
+
+uint32_t AudioManager::durationMs() {
+  return indexed && isPlaying ? trackIndex.durationMs() : 0;
+}
+
+bool AudioManager::indexFile(const char* filename) {
+  if (!bufferPool) return false;
+  Mp3Index* index = (Mp3Index*)bufferPool->acquire();
+  if (!index) return false;
+  // The transcode job reads the exact index back from the card
+  bool ok = buildIndex(filename, *index, true) && loadIndex(filename, *index);
+  bufferPool->release((uint8_t*)index);
+
+  // A replaced file must not keep the table of its predecessor
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  if (currentFile == filename) indexed = false;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return ok;
+}
+
+void AudioManager::queueIndex(const char* filename) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  indexQueue = filename;
+  indexRequests++;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+}
+
+// The scan holds the FATFS lock one block at a time and never audioMutex,
+// so playFile()/playTone() and the decoder only ever wait for one read
+void AudioManager::backgroundJobs() {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  String url = downloadUrl;
+  String target = downloadTarget;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  if (url.length() > 0) {
+    // Runs here rather than in the MQTT handler, which would keep the
+    // client from the broker for the whole transfer
+    bool success = downloadFile(url.c_str(), target.c_str());
+    xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+    downloadUrl = "";
+    downloadTarget = "";
+    xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+
+    if (success) {
+      Serial.println("[Audio] Download completed successfully");
+    } else {
+      Serial.println("[Audio] Download failed");
+    }
+    // Goes out through the MQTT task's outbox
+    if (mqttManager) {
+      mqttManager->publish("esp32/audio/status",
+                           success ? "download_success" : "download_failed");
+    }
+    return;  // The scan it queued runs on the next pass
+  }
+
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  String filename = indexQueue;
+  uint32_t request = indexRequests;
+  bool idle = initialized && !downloadingInProgress;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  if (!idle || filename.length() == 0) return;
+
+  bool ok = indexFile(filename.c_str());
+
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  if (indexRequests == request) {
+    indexQueue = "";
+    if (!ok && transcodeFile == filename) {
+      Serial.printf("[Audio] ✗ Cannot transcode %s\n", filename.c_str());
+      transcodeFile = "";
+    }
+  }
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+}
+
+size_t AudioManager::fileInfoJson(const char* filename, char* buf,
+                                  size_t len) {
+  if (!bufferPool) return 0;
+  Mp3Index* index = (Mp3Index*)bufferPool->acquire();
+  if (!index) return 0;
+
+  size_t written = 0;
+  if (loadIndex(filename, *index) || buildIndex(filename, *index, false)) {
+    const Mp3IndexHeader& h = index->h;
+    char loudness[48] = "null,\"gain_db\":null";
+    if (h.flags & MP3_INDEX_LOUDNESS) {
+      snprintf(loudness, sizeof(loudness), "%.1f,\"gain_db\":%.1f",
+               h.loudness / 100.0f, h.gain / 100.0f);
+    }
+    int n = snprintf(
+        buf, len,
+        "{\"file\":\"%s\",\"duration_ms\":%u,\"frames\":%u,"
+        "\"sample_rate\":%u,\"bitrate\":%u,\"vbr\":%s,\"exact\":%s,"
+        "\"seek_points\":%u,\"title\":\"%s\",\"artist\":\"%s\","
+        "\"loudness_lufs\":%s}",
+        filename, (unsigned)index->durationMs(), (unsigned)h.totalFrames,
+        (unsigned)h.sampleRate, (unsigned)h.bitrate,
+        (h.flags & MP3_INDEX_VBR) ? "true" : "false",
+        (h.flags & MP3_INDEX_EXACT) ? "true" : "false", (unsigned)h.entries,
+        h.title, h.artist, loudness);
+    if (n > 0 && (size_t)n < len) written = n;
+  }
+  bufferPool->release((uint8_t*)index);
+  return written;
+}
+
+// ============================================================================
+// BACKGROUND TRANSCODING
+// ============================================================================
+
+bool AudioManager::loadTranscoded(const char* filename, TranscodeInfo& out) {
+  char path[96];
+  if (!sdManager || !transcodePath(filename, false, path, sizeof(path))) {
+    return false;
+  }
+  File f = sdManager->openForRead(path);
+  if (!f) return false;
+  uint8_t header[TRANSCODE_HEADER_MAX];
+  size_t n = f.read(header, sizeof(header));
+  size_t size = f.size();
+  f.close();
+
+  // Stale when the MP3 was replaced after transcoding
+  return transcodeParse(header, n, out) && out.frames &&
+         out.dataStart + out.dataBytes <= size &&
+         out.sourceBytes == sdManager->getFileSize(filename);
+}
+
+void AudioManager::queueTranscode(const char* filename) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  if (transcoding && transcodeFile != filename) interruptTranscode();
+  transcodeFile = filename;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+}
+
+// The whole blocks written so far stay in the .part for the next start
+void AudioManager::interruptTranscode() {
+  if (!transcoding) return;
+  Serial.println("[Audio] Transcoding paused");
+  transcodeDst.close();
+  releaseDecoder();
+  if (bufferPool) bufferPool->release(transcodeBlock);
+  transcodeBlock = nullptr;
+  transcoding = false;
+}
+
+// From loop() with the lock held, while nothing plays. One MP3 frame per
+// decode period like the loudness pass; a filled block goes to the card
+// right after it.
+void AudioManager::transcodePass() {
+  if (!initialized || downloadingInProgress) return;
+  if (!transcoding) {
+    startTranscodePass();
+    return;
+  }
+  transcodeOut->setQuota(TRANSCODE_BURST_FRAMES);
+  bool running = mp3->loop();
+
+  size_t ready = transcodeEncoder.ready();
+  if (ready) {
+    if (transcodeDst.write(transcodeBlock, ready) != ready) {
+      Serial.printf("[Audio] ✗ Transcoding %s: SD write failed\n",
+                    transcodeFile.c_str());
+      interruptTranscode();
+      transcodeFile = "";
+      return;
+    }
+    transcodeEncoder.next();
+  }
+  if (!running) finishTranscodePass();
+}
+
+void AudioManager::startTranscodePass() {
+  String filename = transcodeFile;
+  const char* name = filename.c_str();
+  char part[96];
+  if (!sdManager || !bufferPool || !sdManager->exists(name) ||
+      !transcodePath(name, true, part, sizeof(part))) {
+    transcodeFile = "";
+    return;
+  }
+
+  // Exact index: the duration picks the format, and a resume needs the
+  // offset of every frame
+  Mp3Index* index = (Mp3Index*)bufferPool->acquire();
+  if (!index) return;  // Pool busy: tried again next period
+  if (!(loadIndex(name, *index) && (index->h.flags & MP3_INDEX_EXACT))) {
+    // Scanned by the job task; loop() starts the pass again after it
+    bufferPool->release((uint8_t*)index);
+    indexQueue = filename;
+    indexRequests++;
+    return;
+  }
+
+  uint32_t sourceBytes = sdManager->getFileSize(name);
+  TranscodeInfo info;
+  transcodeSetup(info,
+                 index->durationMs() <= TRANSCODE_PCM_MAX_MS
+                     ? TRANSCODE_PCM
+                     : TRANSCODE_IMA_ADPCM,
+                 index->h.channels, index->h.sampleRate, sourceBytes);
+  uint8_t header[TRANSCODE_HEADER_MAX];
+  size_t headerLen = transcodeHeader(info, header);
+
+  // Whole blocks of an earlier run of the same job. The decoder restarts
+  // at a frame that needs no bit reservoir, at least one frame early so
+  // its synthesis filter has settled, and drops what was written already.
+  File dst = sdManager->openForUpdate(part);
+  if (!dst) {
+    bufferPool->release((uint8_t*)index);
+    transcodeFile = "";
+    return;
+  }
+  uint32_t blocks = 0, done = 0, skip = 0;
+  uint32_t offset = index->h.audioStart;
+  uint8_t old[TRANSCODE_HEADER_MAX];
+  TranscodeInfo previous;
+  size_t n = dst.read(old, sizeof(old));
+  if (transcodeParse(old, n, previous) && previous.format == info.format &&
+      previous.channels == info.channels && previous.rate == info.rate &&
+      previous.sourceBytes == sourceBytes && previous.dataStart == headerLen &&
+      dst.size() > headerLen) {
+    blocks = (dst.size() - headerLen) / info.blockBytes;
+    done = blocks * info.samplesPerBlock;
+  }
+  uint32_t frame = done / index->h.samplesPerFrame;
+  if (frame > 0) {
+    File src = sdManager->openForRead(name);
+    uint8_t* scratch = bufferPool->acquire();
+    uint32_t clean = UINT32_MAX;
+    if (src && scratch) {
+      Mp3Indexer indexer(readSdFile, &src, src.size(), scratch,
+                         BUFFER_POOL_BLOCK_SIZE);
+      clean = indexer.selfContainedFrame(*index, frame - 1,
+                                         TRANSCODE_RESUME_MAX_BACK, &offset);
+    }
+    if (scratch) bufferPool->release(scratch);
+    src.close();
+    if (clean == UINT32_MAX) {
+      blocks = done = 0;  // Nowhere to restart: from the top
+      offset = index->h.audioStart;
+    } else {
+      skip = done - clean * index->h.samplesPerFrame;
+    }
+  } else {
+    blocks = done = 0;
+  }
+  bufferPool->release((uint8_t*)index);
+
+  transcodeBlock = bufferPool->acquire();
+  if (!transcodeBlock) {
+    dst.close();
+    return;
+  }
+  if (done) {
+    // Its step sizes carry on into the next block
+    dst.seek(headerLen + (blocks - 1) * info.blockBytes);
+    dst.read(transcodeBlock, info.blockBytes);
+  } else {
+    dst.close();
+    sdManager->remove(part);
+    dst = sdManager->openForUpdate(part);
+    if (!dst || dst.write(header, headerLen) != headerLen) {
+      Serial.printf("[Audio] ✗ Cannot write %s\n", part);
+      dst.close();
+      bufferPool->release(transcodeBlock);
+      transcodeBlock = nullptr;
+      transcodeFile = "";
+      return;
+    }
+  }
+  transcodeEncoder.begin(info, transcodeBlock, done,
+                         done ? transcodeBlock : nullptr);
+  dst.seek(headerLen + blocks * info.blockBytes);
+
+  file = new (fileSlot.get()) AudioFileSourceSD(name);
+  file->seek(offset, SEEK_SET);
+  mp3 = new (mp3Slot.get())
+      AudioGeneratorMP3(mp3Workspace, MP3_WORKSPACE_BYTES);
+  transcodeOut->setQuota(0);
+  transcodeOut->setSkip(skip);
+  if (!mp3->begin(file, transcodeOut)) {
+    Serial.printf("[Audio] ✗ Transcoding cannot decode %s\n", name);
+    releaseDecoder();
+    dst.close();
+    bufferPool->release(transcodeBlock);
+    transcodeBlock = nullptr;
+    transcodeFile = "";
+    return;
+  }
+  transcodeDst = dst;
+  transcoding = true;
+  transcodeStartMs = millis();
+  Serial.printf("[Audio] Transcoding %s to %s", name,
+                transcodeFormatName(info.format));
+  if (done) Serial.printf(", resumed at %u ms", (unsigned)((uint64_t)done *
+                                                           1000 / info.rate));
+  Serial.println();
+}
+
+void AudioManager::finishTranscodePass() {
+  String filename = transcodeFile;
+  transcodeFile = "";
+
+  size_t tail = transcodeEncoder.finish();
+  bool ok = !tail || transcodeDst.write(transcodeBlock, tail) == tail;
+  // Now the frame count and data size are known
+  TranscodeInfo info = transcodeEncoder.written();
+  uint8_t header[TRANSCODE_HEADER_MAX];
+  size_t headerLen = transcodeHeader(info, header);
+  ok = ok && transcodeDst.seek(0) &&
+       transcodeDst.write(header, headerLen) == headerLen;
+  transcodeDst.close();
+  releaseDecoder();
+  bufferPool->release(transcodeBlock);
+  transcodeBlock = nullptr;
+  transcoding = false;
+
+  char part[96], path[96];
+  ok = ok && info.frames &&
+       transcodePath(filename.c_str(), true, part, sizeof(part)) &&
+       transcodePath(filename.c_str(), false, path, sizeof(path)) &&
+       sdManager->rename(part, path);
+  if (!ok) {
+    Serial.printf("[Audio] ✗ Transcoding %s failed\n", filename.c_str());
+    if (transcodePath(filename.c_str(), true, part, sizeof(part))) {
+      sdManager->remove(part);
+    }
+    return;
+  }
+  Serial.printf("[Audio] ✓ Transcoded %s: %s, %u ms, %u KB, took %u s\n",
+                filename.c_str(), transcodeFormatName(info.format),
+                (unsigned)((uint64_t)info.frames * 1000 / info.rate),
+                (unsigned)((info.dataStart + info.dataBytes) / 1024),
+                (unsigned)((millis() - transcodeStartMs) / 1000));
+}
+
+size_t AudioManager::decodeStatsJson(char* buf, size_t len) {
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  uint32_t audioMs =
+      (uint32_t)((uint64_t)decodeFrames * 1000 / RESAMPLER_OUTPUT_RATE);
+  // Microseconds of decoding per millisecond of audio, in percent
+  float cpu = audioMs ? decodeUs / (audioMs * 10.0f) : 0.0f;
+  int n = snprintf(
+      buf, len,
+      "{\"file\":\"%s\",\"variant\":\"%s\",\"audio_ms\":%u,"
+      "\"decode_ms\":%u,\"cpu_pct\":%.2f,\"transcode\":\"%s\","
+      "\"transcoding\":%s}",
+      currentFile.c_str(), isPlaying ? decodeVariant : "none",
+      (unsigned)audioMs, (unsigned)(decodeUs / 1000), cpu,
+      transcodeFile.c_str(), transcoding ? "true" : "false");
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  return n > 0 && (size_t)n < len ? n : 0;
+}
+
 // Helper: parse numeric substring from payload
 static int parseNumberFromPayload(const byte* payload, int start, int end) {
   char buf[16];
@@ -296,8 +1566,9 @@ bool AudioManager::handleAudioRequest(MQTTManager& mqtt, byte* payload,
     }
 
     // Send response: FREE:<freeSpace>:<currentAudioSize>
-    String reply = "FREE:" + String(freeSpace) + ":" + String(currentAudioSize);
-    mqtt.publish(TOPIC_RESPONSE, reply);
+    const char* reply = mqtt.scratch().format(
+        "FREE:%u:%u", (unsigned)freeSpace, (unsigned)currentAudioSize);
+    if (reply) mqtt.publish(TOPIC_RESPONSE, reply);
     Serial.printf("[Audio] Responded - Free: %u bytes, Current: %u bytes\n",
                   freeSpace, currentAudioSize);
     return true;
@@ -311,36 +1582,41 @@ bool AudioManager::handleAudioRequest(MQTTManager& mqtt, byte* payload,
 
 bool AudioManager::handleDownloadCommand(MQTTManager& mqtt, byte* payload,
                                          unsigned int length) {
-  String payloadStr = String((char*)payload, length);
-  Serial.printf("[Audio] Received download command: %s\n", payloadStr.c_str());
-
-  // Parse payload: "http://192.168.1.100:8000/file.mp3|101"
-  int separatorIndex = payloadStr.indexOf('|');
-  if (separatorIndex == -1) {
+  MessageArena& arena = mqtt.scratch();
+  char* url = arena.copy((const char*)payload, length);
+  if (!url) return true;
+  Serial.printf("[Audio] Received download command: %s\n", url);
+
+  // Parse payload: "http://192.168.1.100:8000/file.mp3|101", split in place
+  char* separator = strchr(url, '|');
+  if (!separator) {
     Serial.println("[Audio] ERROR: Invalid payload format");
     mqtt.publish("esp32/audio/status", "download_failed");
     return true;
   }
-
-  String url = payloadStr.substring(0, separatorIndex);
-  String idStr = payloadStr.substring(separatorIndex + 1);
+  *separator = '\0';
+  const char* idStr = separator + 1;
 
   // Construct filename: /sound_{id}.mp3
-  String filename = "/sound_" + idStr + ".mp3";
-
-  Serial.printf("[Audio] Downloading from URL: %s to file: %s\n", url.c_str(),
-                filename.c_str());
+  const char* filename = arena.format("/sound_%s.mp3", idStr);
+  if (!filename) return true;
 
-  // Call downloadFile
-  bool success = downloadFile(url.c_str(), filename.c_str());
+  // One transfer at a time; the job task takes it from here
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  bool busy = downloadUrl.length() > 0 || downloadingInProgress;
+  if (!busy) {
+    downloadUrl = url;
+    downloadTarget = filename;
+  }
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
 
-  // Publish status
-  if (success) {
-    mqtt.publish("esp32/audio/status", "download_success");
-    Serial.println("[Audio] Download completed successfully");
-  } else {
+  if (busy) {
+    Serial.printf("[Audio] ✗ Download of %s refused: another is running\n",
+                  filename);
     mqtt.publish("esp32/audio/status", "download_failed");
-    Serial.println("[Audio] Download failed");
+  } else {
+    Serial.printf("[Audio] Queued download from URL: %s to file: %s\n", url,
+                  filename);
   }
 
   return true;
@@ -356,6 +1632,15 @@ bool AudioManager::downloadFile(const char* url, const char* filename) {
     return false;
   }
 
+  // The background jobs give their decoder and pool block back first and
+  // wait until the download is over; both pick up again after it
+  xSemaphoreTakeRecursive(audioMutex, portMAX_DELAY);  // LOCK
+  interruptLoudness();
+  interruptTranscode();
+  downloadingInProgress = true;
+  xSemaphoreGiveRecursive(audioMutex);  // UNLOCK
+  publishState(AUDIO_STATE_DOWNLOADING);
+
   HTTPClient http;
 
   // 1. INCREASE TIMEOUT (Add this line)
@@ -367,51 +1652,60 @@ bool AudioManager::downloadFile(const char* url, const char* filename) {
   if (httpCode != HTTP_CODE_OK) {
     Serial.printf("[Audio] HTTP GET failed, code: %d\n", httpCode);
     http.end();
+    downloadingInProgress = false;
+    publishState(AUDIO_STATE_IDLE);
     return false;
   }
 
-  // Open file for writing
-  if (!sdManager->openForWrite(filename)) {
-    Serial.println("[Audio] ERROR: Could not open file for writing");
+  // Socket reads land in a pool block that goes to the SD card as is
+  uint8_t* buffer = bufferPool ? bufferPool->acquire() : nullptr;
+  if (!buffer) {
+    Serial.println("[Audio] ERROR: No transfer buffer available");
     http.end();
+    downloadingInProgress = false;
+    publishState(AUDIO_STATE_IDLE);
     return false;
   }
+  const size_t bufferSize = BUFFER_POOL_BLOCK_SIZE;
 
-  // Allocate buffer
-  const size_t bufferSize = 1024;
-  uint8_t* buffer = (uint8_t*)malloc(bufferSize);
-  if (!buffer) {
-    Serial.println("[Audio] ERROR: Memory allocation failed");
-    sdManager->closeFile();
+  // Open file for writing
+  if (!sdManager->openForWrite(filename)) {
+    Serial.println("[Audio] ERROR: Could not open file for writing");
+    bufferPool->release(buffer);
     http.end();
+    downloadingInProgress = false;
+    publishState(AUDIO_STATE_IDLE);
     return false;
   }
 
   WiFiClient* stream = http.getStreamPtr();
   int len = http.getSize();  // Get content length
   size_t totalBytes = 0;
+  size_t fill = 0;
+  size_t lastReport = 0;
+  bool writeFailed = false;
 
-  downloadingInProgress = true;
-
-  // Read and write in loop
+  // Read and write in loop; the SD card only sees full blocks (eight
+  // sectors) except for the tail
   while (http.connected() && (len > 0 || len == -1)) {
     size_t size = stream->available();
     if (size) {
-      int c =
-          stream->readBytes(buffer, ((size > bufferSize) ? bufferSize : size));
-      if (!sdManager->writeChunk(buffer, c)) {
-        Serial.println("[Audio] ERROR: Write to SD failed");
-        free(buffer);
-        sdManager->closeFile();
-        http.end();
-        downloadingInProgress = false;
-        return false;
-      }
-
+      size_t want = bufferSize - fill;
+      int c = stream->readBytes(buffer + fill, (size > want) ? want : size);
+      fill += c;
       if (len > 0) len -= c;
       totalBytes += c;
 
-      if (totalBytes % 1000 == 0) {
+      if (fill == bufferSize) {
+        if (!sdManager->writeChunk(buffer, fill)) {
+          writeFailed = true;
+          break;
+        }
+        fill = 0;
+      }
+
+      if (totalBytes - lastReport >= 16384) {
+        lastReport = totalBytes;
         Serial.printf("[Audio] Downloaded %d bytes\n", totalBytes);
       }
     }
@@ -420,11 +1714,25 @@ bool AudioManager::downloadFile(const char* url, const char* filename) {
     delay(1);
   }
 
+  if (!writeFailed && fill > 0 && !sdManager->writeChunk(buffer, fill)) {
+    writeFailed = true;
+  }
+  bufferPool->release(buffer);
+
+  if (writeFailed) {
+    Serial.println("[Audio] ERROR: Write to SD failed");
+    sdManager->closeFile();
+    http.end();
+    downloadingInProgress = false;
+    publishState(AUDIO_STATE_IDLE);
+    return false;
+  }
+
   // Cleanup
-  free(buffer);
   sdManager->closeFile();
   http.end();
   downloadingInProgress = false;
+  publishState(AUDIO_STATE_IDLE);
 
   // 3. VERIFY FILE SIZE (Optional but recommended check)
   if (totalBytes == 0) {
@@ -434,6 +1742,21 @@ bool AudioManager::downloadFile(const char* url, const char* filename) {
 
   Serial.printf("[Audio] Download complete: %u bytes written to %s\n",
                 totalBytes, filename);
+
+  // A replaced MP3 must not keep the sidecar of its predecessor
+  char sidecar[96];
+  if (transcodePath(filename, false, sidecar, sizeof(sidecar))) {
+    sdManager->remove(sidecar);
+  }
+  if (transcodePath(filename, true, sidecar, sizeof(sidecar))) {
+    sdManager->remove(sidecar);
+  }
+
+  // The scan makes first play and seeks exact; loudness and the
+  // transcoded sidecar follow once it is done and the player is idle
+  queueIndex(filename);
+  queueLoudness(filename);
+  queueTranscode(filename);
   return true;
 }
 
@@ -449,6 +1772,21 @@ void AudioManager::setMQTTManager(MQTTManager* mqtt) { mqttManager = mqtt; }
 
 void AudioManager::setSDManager(SDManager* sd) { sdManager = sd; }
 
+void AudioManager::setEventBus(EventBus* bus) { eventBus = bus; }
+
+void AudioManager::setBufferPool(BufferPool* pool) { bufferPool = pool; }
+
+void AudioManager::setSyncClock(SyncClock* clock, portMUX_TYPE* lock) {
+  syncClock = clock;
+  syncClockLock = lock;
+}
+
+void AudioManager::publishState(AudioState state) {
+  if (!eventBus) return;
+  AudioStateEvent event = {state, currentVolume};
+  eventBus->publish(event);
+}
+
 bool AudioManager::isDownloading() { return downloadingInProgress; }
 
 float AudioManager::getDownloadProgress() const {
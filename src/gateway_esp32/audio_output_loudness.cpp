@@ -0,0 +1,25 @@
+#include "../../include/gateway_esp32/audio_output_loudness.h"
+
+AudioOutputLoudness::AudioOutputLoudness(LoudnessMeter* meter)
+    : meter(meter), quota(0) {
+  hertz = 44100;
+  bps = 16;
+  channels = 2;
+}
+
+bool AudioOutputLoudness::SetRate(int hz) {
+  hertz = hz;
+  meter->setRate(hz);
+  return true;
+}
+
+bool AudioOutputLoudness::begin() { return true; }
+
+bool AudioOutputLoudness::ConsumeSample(int16_t sample[2]) {
+  if (!quota) return false;
+  quota--;
+  meter->addFrame(sample[LEFTCHANNEL], sample[RIGHTCHANNEL]);
+  return true;
+}
+
+bool AudioOutputLoudness::stop() { return true; }
@@ -0,0 +1,93 @@
+#include "../../include/gateway_esp32/audio_output_ring.h"
+
+// A block can be at most one push short of full before it is processed
+static_assert(DSP_BLOCK_FRAMES + RESAMPLER_MAX_OUT - 1 <= DSP_MAX_FRAMES,
+              "DSP block does not hold a full resampler burst");
+static_assert(DSP_LOOKAHEAD_FRAMES <= DSP_MAX_FRAMES,
+              "Limiter tail does not fit the block buffer");
+// The shallowest ring still takes a block, a resampler burst and the tail
+static_assert(DSP_MAX_FRAMES + RESAMPLER_MAX_OUT + DSP_LOOKAHEAD_FRAMES <=
+                  PCM_RING_MIN_DEPTH,
+              "PCM_RING_MIN_DEPTH below the decoder side's headroom");
+
+AudioOutputRing::AudioOutputRing(PcmRing* ring, Resampler* resampler,
+                                 DspChain* dsp, AudioOutput* sink)
+    : ring(ring),
+      resampler(resampler),
+      dsp(dsp),
+      sink(sink),
+      sinkRate(RESAMPLER_OUTPUT_RATE),
+      staged(0) {
+  hertz = RESAMPLER_OUTPUT_RATE;
+  bps = 16;
+  channels = 2;
+}
+
+bool AudioOutputRing::SetRate(int hz) {
+  hertz = hz;
+  uint32_t want = RESAMPLER_OUTPUT_RATE;
+  if (!resampler->setInputRate(hz)) {
+    resampler->setInputRate(RESAMPLER_OUTPUT_RATE);  // Pass through
+    want = hz;
+  }
+  if (want == sinkRate) return true;
+  sinkRate = want;
+  dsp->setRate(want);
+  return sink->SetRate(want);
+}
+
+bool AudioOutputRing::SetBitsPerSample(int bits) {
+  bps = bits;
+  return sink->SetBitsPerSample(bits);
+}
+
+bool AudioOutputRing::SetChannels(int chan) {
+  channels = chan;
+  return sink->SetChannels(chan);
+}
+
+bool AudioOutputRing::begin() {
+  // No filter history or staged audio from the previous track
+  resampler->reset();
+  dsp->reset();
+  staged = 0;
+  return sink->begin();
+}
+
+bool AudioOutputRing::ConsumeSample(int16_t sample[2]) {
+  // Everything this input produces must fit along with the staged block
+  // and the limiter tail, or the decoder offers it again on its next loop()
+  if (ring->space() <
+      staged + resampler->maxOutputs() + DSP_LOOKAHEAD_FRAMES) {
+    return false;
+  }
+  int16_t* at = block + 2 * staged;
+  if (resampler->passthrough()) {
+    at[0] = sample[LEFTCHANNEL];
+    at[1] = sample[RIGHTCHANNEL];
+    staged++;
+  } else {
+    staged += resampler->push(sample[LEFTCHANNEL], sample[RIGHTCHANNEL], at);
+  }
+  if (staged >= DSP_BLOCK_FRAMES) flushBlock();
+  return true;
+}
+
+void AudioOutputRing::flushBlock() {
+  dsp->process(block, staged);
+  ring->write(block, staged);
+  staged = 0;
+}
+
+void AudioOutputRing::drain() {
+  if (staged) flushBlock();
+  ring->write(block, dsp->tail(block));
+}
+
+bool AudioOutputRing::stop() {
+  // Explicit stop: what is still buffered must not play out
+  ring->flush();
+  dsp->reset();
+  staged = 0;
+  return sink->stop();
+}
@@ -0,0 +1,29 @@
+#include "../../include/gateway_esp32/audio_output_transcode.h"
+
+AudioOutputTranscode::AudioOutputTranscode(TranscodeEncoder* encoder)
+    : encoder(encoder), quota(0), skip(0) {
+  hertz = 44100;
+  bps = 16;
+  channels = 2;
+}
+
+// The sidecar's rate comes from the index; the decoder's agrees with it
+bool AudioOutputTranscode::SetRate(int hz) {
+  hertz = hz;
+  return true;
+}
+
+bool AudioOutputTranscode::begin() { return true; }
+
+bool AudioOutputTranscode::ConsumeSample(int16_t sample[2]) {
+  if (!quota) return false;
+  if (skip) {
+    skip--;
+  } else if (!encoder->add(sample[LEFTCHANNEL], sample[RIGHTCHANNEL])) {
+    return false;  // Block full
+  }
+  quota--;
+  return true;
+}
+
+bool AudioOutputTranscode::stop() { return true; }
@@ -0,0 +1,129 @@
+#include "../../include/gateway_esp32/buffer_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+#endif
+
+#define ALL_FREE \
+  (BUFFER_POOL_BLOCKS == 32 ? 0xFFFFFFFFu : (1u << BUFFER_POOL_BLOCKS) - 1)
+
+BufferPool::BufferPool()
+    : region(nullptr),
+      freeMask(0),
+      peak(0),
+      exhaustedCount(0),
+      transferCount(0),
+      bounceCount(0) {}
+
+bool BufferPool::begin() {
+  if (region) return true;
+
+  size_t size = (size_t)BUFFER_POOL_BLOCKS * BUFFER_POOL_BLOCK_SIZE;
+#ifdef ESP_PLATFORM
+  region = (uint8_t*)heap_caps_aligned_alloc(
+      BUFFER_POOL_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+#else
+  region = (uint8_t*)aligned_alloc(BUFFER_POOL_ALIGN, size);
+#endif
+  if (!region) return false;
+
+  freeMask.store(ALL_FREE, std::memory_order_release);
+  return true;
+}
+
+uint8_t* BufferPool::acquire() {
+  uint32_t mask = freeMask.load(std::memory_order_relaxed);
+  while (mask) {
+    uint32_t bit = mask & (~mask + 1);  // Lowest free block
+    if (freeMask.compare_exchange_weak(mask, mask & ~bit,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      updatePeak();
+      return region + (size_t)__builtin_ctz(bit) * BUFFER_POOL_BLOCK_SIZE;
+    }
+  }
+  exhaustedCount++;
+  return nullptr;
+}
+
+bool BufferPool::acquire(uint8_t** blocks, int n) {
+  uint32_t mask = freeMask.load(std::memory_order_relaxed);
+  for (;;) {
+    if (__builtin_popcount(mask) < n) {
+      exhaustedCount++;
+      return false;
+    }
+    uint32_t take = 0;
+    uint32_t rest = mask;
+    for (int i = 0; i < n; i++) {
+      uint32_t bit = rest & (~rest + 1);
+      take |= bit;
+      rest &= ~bit;
+    }
+    if (freeMask.compare_exchange_weak(mask, rest, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      for (int i = 0; i < n; i++) {
+        uint32_t bit = take & (~take + 1);
+        take &= ~bit;
+        blocks[i] = region + (size_t)__builtin_ctz(bit) * BUFFER_POOL_BLOCK_SIZE;
+      }
+      updatePeak();
+      return true;
+    }
+  }
+}
+
+void BufferPool::release(uint8_t* block) {
+  if (!owns(block)) return;
+  size_t index = (size_t)(block - region) / BUFFER_POOL_BLOCK_SIZE;
+  freeMask.fetch_or(1u << index, std::memory_order_release);
+}
+
+bool BufferPool::owns(const void* p) const {
+  const uint8_t* b = (const uint8_t*)p;
+  return region && b >= region &&
+         b < region + (size_t)BUFFER_POOL_BLOCKS * BUFFER_POOL_BLOCK_SIZE;
+}
+
+bool BufferPool::isDmaCapable(const void* p) const {
+#ifdef ESP_PLATFORM
+  // SPI and SDMMC drivers copy anything outside DMA RAM or not word aligned
+  return esp_ptr_dma_capable(p) && ((uintptr_t)p & 3) == 0;
+#else
+  return owns(p);
+#endif
+}
+
+void BufferPool::noteTransfer(const void* p) {
+  transferCount++;
+  if (!isDmaCapable(p)) bounceCount++;
+}
+
+int BufferPool::inUse() const {
+  if (!region) return 0;
+  uint32_t mask = freeMask.load(std::memory_order_relaxed);
+  return BUFFER_POOL_BLOCKS - __builtin_popcount(mask);
+}
+
+void BufferPool::updatePeak() {
+  int used = inUse();
+  int prev = peak.load(std::memory_order_relaxed);
+  while (used > prev &&
+         !peak.compare_exchange_weak(prev, used, std::memory_order_relaxed)) {
+  }
+}
+
+size_t BufferPool::toJson(char* buf, size_t len) const {
+  int n = snprintf(buf, len,
+                   "{\"blocks\":%d,\"block_size\":%d,\"in_use\":%d,"
+                   "\"peak\":%d,\"exhausted\":%u,\"transfers\":%u,"
+                   "\"bounce_copies\":%u}",
+                   BUFFER_POOL_BLOCKS, BUFFER_POOL_BLOCK_SIZE, inUse(),
+                   peakInUse(), (unsigned)exhaustedCount,
+                   (unsigned)transferCount, (unsigned)bounceCount);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
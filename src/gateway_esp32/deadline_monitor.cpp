@@ -0,0 +1,212 @@
+#include "../../include/gateway_esp32/deadline_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+DeadlineMonitor::DeadlineMonitor(ClockFn clock, ContextFn context)
+    : clock(clock), contextHook(context), count(0), lost(0) {
+  for (int i = 0; i < DEADLINE_MAX_TASKS; i++) {
+    memset(&tasks[i].s, 0, sizeof(tasks[i].s));
+    tasks[i].releaseUs = 0;
+    tasks[i].startUs = 0;
+    tasks[i].lastEndUs = 0;
+    tasks[i].running = false;
+    tasks[i].started = false;
+    tasks[i].context = nullptr;
+    tasks[i].lastContext = nullptr;
+    tasks[i].logHead.store(0, std::memory_order_relaxed);
+    tasks[i].logTail.store(0, std::memory_order_relaxed);
+  }
+}
+
+int DeadlineMonitor::registerTask(const char* name, uint32_t periodUs,
+                                  uint32_t budgetUs) {
+  if (count >= DEADLINE_MAX_TASKS || periodUs == 0) return -1;
+  Task& t = tasks[count];
+  t.s.name = name;
+  t.s.periodUs = periodUs;
+  t.s.budgetUs = budgetUs ? budgetUs : periodUs;
+  return count++;
+}
+
+// ============================================================================
+// ITERATION TRACKING - Called by the monitored task only
+// ============================================================================
+void DeadlineMonitor::begin(int id) {
+  if (id < 0 || id >= count) return;
+  Task& t = tasks[id];
+  uint32_t now = clock();
+
+  if (!t.started) {
+    t.releaseUs = now;
+    t.started = true;
+  } else {
+    // Next release on the ideal grid; whole periods that passed without an
+    // iteration are skipped releases, not a growing backlog
+    t.releaseUs += t.s.periodUs;
+    uint32_t late = now - t.releaseUs;
+    if ((int32_t)late >= (int32_t)t.s.periodUs) {
+      uint32_t skipped = late / t.s.periodUs;
+      t.s.skippedReleases += skipped;
+      t.releaseUs += skipped * t.s.periodUs;
+    } else if ((int32_t)late < 0) {
+      // Woke early (tick rounding), the release is when it actually ran
+      t.releaseUs = now;
+    }
+  }
+
+  t.startUs = now;
+  t.lastContext = t.context;
+  t.running = true;
+}
+
+void DeadlineMonitor::end(int id) {
+  if (id < 0 || id >= count) return;
+  Task& t = tasks[id];
+  uint32_t now = clock();
+  uint32_t exec = now - t.startUs;
+  uint32_t response = now - t.releaseUs;
+
+  t.s.iterations++;
+  t.s.lastExecUs = exec;
+  if (exec > t.s.execMaxUs) t.s.execMaxUs = exec;
+  if (response > t.s.responseMaxUs) t.s.responseMaxUs = response;
+
+  bool overrun = exec > t.s.budgetUs;
+  bool missed = response > t.s.periodUs;
+  if (overrun) t.s.overruns++;
+  if (missed) t.s.deadlineMisses++;
+  if (overrun || missed) {
+    record(id, exec, response, t.startUs - t.releaseUs);
+  }
+
+  t.lastEndUs = now;
+  t.running = false;
+}
+
+void DeadlineMonitor::setContext(int id, const char* context) {
+  if (id < 0 || id >= count) return;
+  tasks[id].context = context;
+  if (context) tasks[id].lastContext = context;
+}
+
+void DeadlineMonitor::record(int id, uint32_t execUs, uint32_t responseUs,
+                             uint32_t lateUs) {
+  Task& t = tasks[id];
+  uint32_t head = t.logHead.load(std::memory_order_relaxed);
+  uint32_t tail = t.logTail.load(std::memory_order_acquire);
+  if (head - tail >= DEADLINE_LOG_PER_TASK) {
+    lost++;  // Publisher is behind; keep the older entries intact
+    return;
+  }
+
+  DeadlineViolation& v = t.log[head % DEADLINE_LOG_PER_TASK];
+  v.task = (uint8_t)id;
+  v.startUs = t.startUs;
+  v.execUs = execUs;
+  v.responseUs = responseUs;
+  v.lateUs = lateUs;
+
+  // Monitored tasks that were mid-iteration, or finished one, since this
+  // iteration was released
+  size_t used = 0;
+  v.others[0] = '\0';
+  for (int j = 0; j < count; j++) {
+    if (j == id || !tasks[j].started) continue;
+    bool overlapped =
+        tasks[j].running || (int32_t)(tasks[j].lastEndUs - t.releaseUs) > 0;
+    if (!overlapped) continue;
+    const char* ctx = tasks[j].lastContext;
+    int n = snprintf(v.others + used, sizeof(v.others) - used, "%s%s%s%s",
+                     used ? "," : "", tasks[j].s.name, ctx ? ":" : "",
+                     ctx ? ctx : "");
+    if (n < 0 || used + n >= sizeof(v.others)) break;
+    used += n;
+  }
+  if (contextHook && used + 2 < sizeof(v.others)) {
+    if (used) v.others[used++] = ',';
+    v.others[used] = '\0';
+    contextHook(id, v.others + used, sizeof(v.others) - used);
+    // Drop a dangling separator if the hook had nothing to add
+    if (used && v.others[used] == '\0') v.others[used - 1] = '\0';
+  }
+
+  t.logHead.store(head + 1, std::memory_order_release);
+}
+
+// ============================================================================
+// REPORTING - Called from the publishing task
+// ============================================================================
+bool DeadlineMonitor::pollViolation(DeadlineViolation& out) {
+  // Oldest pending entry across tasks, by age relative to now so the
+  // comparison survives the 32-bit microsecond wrap
+  uint32_t now = clock();
+  int pick = -1;
+  uint32_t oldest = 0;
+  for (int i = 0; i < count; i++) {
+    uint32_t tail = tasks[i].logTail.load(std::memory_order_relaxed);
+    if (tail == tasks[i].logHead.load(std::memory_order_acquire)) continue;
+    uint32_t age = now - tasks[i].log[tail % DEADLINE_LOG_PER_TASK].startUs;
+    if (pick < 0 || age > oldest) {
+      pick = i;
+      oldest = age;
+    }
+  }
+  if (pick < 0) return false;
+
+  Task& t = tasks[pick];
+  uint32_t tail = t.logTail.load(std::memory_order_relaxed);
+  out = t.log[tail % DEADLINE_LOG_PER_TASK];
+  t.logTail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+DeadlineTaskStats DeadlineMonitor::stats(int id) const {
+  DeadlineTaskStats s;
+  if (id < 0 || id >= count) {
+    memset(&s, 0, sizeof(s));
+    return s;
+  }
+  return tasks[id].s;
+}
+
+size_t DeadlineMonitor::toJson(char* buf, size_t len) const {
+  size_t used = 0;
+  int n = snprintf(buf, len, "{\"lost\":%u,\"tasks\":[", (unsigned)lost);
+  if (n < 0 || (size_t)n >= len) return 0;
+  used = n;
+
+  for (int i = 0; i < count; i++) {
+    const DeadlineTaskStats& s = tasks[i].s;
+    n = snprintf(buf + used, len - used,
+                 "%s{\"name\":\"%s\",\"period_us\":%u,\"budget_us\":%u,"
+                 "\"iterations\":%u,\"overruns\":%u,\"misses\":%u,"
+                 "\"skipped\":%u,\"exec_max_us\":%u,\"wcrt_us\":%u,"
+                 "\"last_exec_us\":%u}",
+                 i ? "," : "", s.name, (unsigned)s.periodUs,
+                 (unsigned)s.budgetUs, (unsigned)s.iterations,
+                 (unsigned)s.overruns, (unsigned)s.deadlineMisses,
+                 (unsigned)s.skippedReleases, (unsigned)s.execMaxUs,
+                 (unsigned)s.responseMaxUs, (unsigned)s.lastExecUs);
+    if (n < 0 || used + n >= len) return 0;
+    used += n;
+  }
+
+  n = snprintf(buf + used, len - used, "]}");
+  if (n < 0 || used + n >= len) return 0;
+  return used + n;
+}
+
+size_t DeadlineMonitor::violationToJson(const DeadlineViolation& v, char* buf,
+                                        size_t len) const {
+  if (v.task >= count) return 0;
+  const DeadlineTaskStats& s = tasks[v.task].s;
+  int n = snprintf(buf, len,
+                   "{\"task\":\"%s\",\"start_us\":%u,\"exec_us\":%u,"
+                   "\"response_us\":%u,\"late_us\":%u,\"period_us\":%u,"
+                   "\"budget_us\":%u,\"others\":\"%s\"}",
+                   s.name, (unsigned)v.startUs, (unsigned)v.execUs,
+                   (unsigned)v.responseUs, (unsigned)v.lateUs,
+                   (unsigned)s.periodUs, (unsigned)s.budgetUs, v.others);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
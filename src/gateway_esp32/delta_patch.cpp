@@ -0,0 +1,131 @@
+#include "../../include/gateway_esp32/delta_patch.h"
+
+#include <string.h>
+
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+DeltaPatcher::DeltaPatcher(ReadFn read, WriteFn write, void* context)
+    : readSource(read), writeTarget(write), ctx(context) {
+  reset();
+}
+
+void DeltaPatcher::reset() {
+  state = STATE_HEADER;
+  pendingLen = 0;
+  pendingNeed = DELTA_HEADER_SIZE;
+  op = DELTA_OP_END;
+  insertRemaining = 0;
+  outputBytes = 0;
+  errorMsg = nullptr;
+  memset(&hdr, 0, sizeof(hdr));
+}
+
+bool DeltaPatcher::isDelta(const uint8_t* data, size_t len) {
+  return len >= 4 && memcmp(data, DELTA_MAGIC, 4) == 0;
+}
+
+bool DeltaPatcher::fail(const char* msg) {
+  errorMsg = msg;
+  state = STATE_ERROR;
+  return false;
+}
+
+bool DeltaPatcher::parseHeader() {
+  if (!isDelta(pending, pendingLen)) return fail("bad magic");
+  hdr.version = pending[4];
+  if (hdr.version != DELTA_VERSION) return fail("unsupported version");
+  hdr.sourceSize = readLE32(pending + 8);
+  hdr.targetSize = readLE32(pending + 12);
+  memcpy(hdr.sourceSha256, pending + 16, 32);
+  memcpy(hdr.targetSha256, pending + 48, 32);
+  return true;
+}
+
+bool DeltaPatcher::runCopy(uint32_t offset, uint32_t length) {
+  if (offset > hdr.sourceSize || length > hdr.sourceSize - offset) {
+    return fail("copy outside source");
+  }
+  if (length > hdr.targetSize - outputBytes) return fail("target overflow");
+
+  while (length > 0) {
+    size_t n = length < DELTA_COPY_BUFFER ? length : DELTA_COPY_BUFFER;
+    if (!readSource(ctx, offset, copyBuf, n)) return fail("source read");
+    if (!writeTarget(ctx, copyBuf, n)) return fail("target write");
+    offset += n;
+    length -= n;
+    outputBytes += n;
+  }
+  return true;
+}
+
+bool DeltaPatcher::feed(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    switch (state) {
+      case STATE_HEADER:
+      case STATE_ARGS: {
+        // Collect a fixed-size record that may be split across slices
+        size_t take = pendingNeed - pendingLen;
+        if (take > len) take = len;
+        memcpy(pending + pendingLen, data, take);
+        pendingLen += take;
+        data += take;
+        len -= take;
+        if (pendingLen < pendingNeed) return true;
+
+        if (state == STATE_HEADER) {
+          if (!parseHeader()) return false;
+          state = STATE_OPCODE;
+        } else if (op == DELTA_OP_COPY) {
+          if (!runCopy(readLE32(pending), readLE32(pending + 4))) return false;
+          state = STATE_OPCODE;
+        } else {
+          insertRemaining = readLE32(pending);
+          if (insertRemaining > hdr.targetSize - outputBytes) {
+            return fail("target overflow");
+          }
+          state = insertRemaining ? STATE_INSERT : STATE_OPCODE;
+        }
+        pendingLen = 0;
+        break;
+      }
+
+      case STATE_OPCODE:
+        op = *data++;
+        len--;
+        if (op == DELTA_OP_END) {
+          if (outputBytes != hdr.targetSize) return fail("short target");
+          state = STATE_DONE;
+        } else if (op == DELTA_OP_COPY) {
+          pendingNeed = 8;
+          state = STATE_ARGS;
+        } else if (op == DELTA_OP_INSERT) {
+          pendingNeed = 4;
+          state = STATE_ARGS;
+        } else {
+          return fail("bad opcode");
+        }
+        break;
+
+      case STATE_INSERT: {
+        size_t n = len < insertRemaining ? len : insertRemaining;
+        if (!writeTarget(ctx, data, n)) return fail("target write");
+        data += n;
+        len -= n;
+        insertRemaining -= n;
+        outputBytes += n;
+        if (insertRemaining == 0) state = STATE_OPCODE;
+        break;
+      }
+
+      case STATE_DONE:
+        return len == 0 ? true : fail("data after end");
+
+      case STATE_ERROR:
+        return false;
+    }
+  }
+  return true;
+}
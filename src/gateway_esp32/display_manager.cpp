@@ -14,7 +14,14 @@ DisplayManager::DisplayManager()
       sensorManager(nullptr),
       sdManager(nullptr),
       audioManager(nullptr),
-      remoteSensorData(nullptr) {}
+      eventBus(nullptr),
+      subscriberId(-1),
+      remoteDataValid(false),
+      audioState(AUDIO_STATE_IDLE) {
+  memset(&remoteData, 0, sizeof(remoteData));
+  memset(&networkState, 0, sizeof(networkState));
+  memset(spectrumBars, 0, sizeof(spectrumBars));
+}
 
 bool DisplayManager::begin(TCA9548A* tca) {
   tcaMultiplexer = tca;
@@ -38,6 +45,8 @@ bool DisplayManager::begin(TCA9548A* tca) {
 void DisplayManager::update() {
   if (!tcaMultiplexer) return;
 
+  drainEvents();
+
   tcaMultiplexer->openChannel(TCA_CHANNEL_OLED);
 
   display.clearDisplay();
@@ -77,8 +86,27 @@ void DisplayManager::setAudioManager(AudioManager* audioMgr) {
   audioManager = audioMgr;
 }
 
-void DisplayManager::setRemoteSensorData(SensorData* remoteData) {
-  remoteSensorData = remoteData;
+void DisplayManager::setEventBus(EventBus* bus) {
+  eventBus = bus;
+  subscriberId = bus->subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE) |
+                                EVENT_MASK(EVENT_AUDIO_STATE) |
+                                EVENT_MASK(EVENT_NETWORK_STATE));
+}
+
+void DisplayManager::drainEvents() {
+  if (!eventBus) return;
+
+  Event event;
+  while (eventBus->poll(subscriberId, event)) {
+    if (const SensorSampleEvent* s = event.as<SensorSampleEvent>()) {
+      remoteData = s->data;
+      remoteDataValid = true;
+    } else if (const AudioStateEvent* a = event.as<AudioStateEvent>()) {
+      audioState = a->state;
+    } else if (const NetworkStateEvent* n = event.as<NetworkStateEvent>()) {
+      networkState = *n;
+    }
+  }
 }
 
 void DisplayManager::showStartup() {
@@ -117,10 +145,10 @@ void DisplayManager::drawPageSensors() {
 
   display.println();
 
-  if (remoteSensorData) {
-    display.printf("Remote: %.1fC %.1f%%\n", remoteSensorData->temperature,
-                   remoteSensorData->humidity);
-    display.printf("Battery: %d%%\n", remoteSensorData->batteryLevel);
+  if (remoteDataValid) {
+    display.printf("Remote: %.1fC %.1f%%\n", remoteData.temperature,
+                   remoteData.humidity);
+    display.printf("Battery: %d%%\n", remoteData.batteryLevel);
   } else {
     display.println("Remote: No Data");
   }
@@ -133,6 +161,7 @@ void DisplayManager::drawPageNetwork() {
   display.printf("IP: %s\n", WiFi.localIP().toString().c_str());
   display.printf("RSSI: %d dBm\n", WiFi.RSSI());
   display.printf("MAC: %s\n", WiFi.macAddress().c_str());
+  display.printf("MQTT: %s\n", networkState.mqttConnected ? "OK" : "--");
 }
 
 void DisplayManager::drawPageStatus() {
@@ -145,7 +174,7 @@ void DisplayManager::drawPageStatus() {
   }
 
   if (audioManager) {
-    if (audioManager->playing()) {
+    if (audioState == AUDIO_STATE_PLAYING) {
       display.println("Audio: PLAYING");
     } else {
       display.println("Audio: IDLE");
@@ -162,7 +191,7 @@ void DisplayManager::drawPageAudio() {
   drawHeader("Audio");
 
   if (audioManager) {
-    if (audioManager->isDownloading()) {
+    if (audioState == AUDIO_STATE_DOWNLOADING) {
       display.println("RECEIVING...");
       float progress = audioManager->getDownloadProgress();
       if (progress >= 0.0f) {
@@ -177,11 +206,13 @@ void DisplayManager::drawPageAudio() {
       } else {
         display.println("Starting...");
       }
-    } else if (audioManager->playing()) {
+    } else if (audioState == AUDIO_STATE_PLAYING) {
       display.println("PLAYING");
-      // Simple visualizer bars
-      for (int i = 0; i < 8; i++) {
-        int height = random(5, 20);
+      // Spectrum of what is playing, one FFT per refresh (at our priority,
+      // below the decoder)
+      audioManager->spectrumLevels(spectrumBars);
+      for (int i = 0; i < SPECTRUM_BARS; i++) {
+        int height = 1 + spectrumBars[i] * 19 / 255;
         display.fillRect(i * 16, SCREEN_HEIGHT - height, 10, height,
                          SSD1306_WHITE);
       }
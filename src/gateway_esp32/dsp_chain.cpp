@@ -0,0 +1,299 @@
+#include "../../include/gateway_esp32/dsp_chain.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM) && !defined(DSP_NO_ESP_DSP) && \
+    __has_include(<esp_dsp.h>)
+#include <esp_dsp.h>
+#define DSP_ESP_DSP 1
+#else
+#define DSP_ESP_DSP 0
+#endif
+
+// ============================================================================
+// BIQUAD KERNEL
+// ============================================================================
+#if DSP_ESP_DSP
+void dspBiquad(const float* in, float* out, int len, const float* coef,
+               float* w) {
+  dsps_biquad_f32((float*)in, out, len, (float*)coef, w);
+}
+#else
+__attribute__((optimize("fp-contract=off"))) void dspBiquad(
+    const float* in, float* out, int len, const float* coef, float* w) {
+  for (int i = 0; i < len; i++) {
+    float d0 = in[i] - coef[3] * w[0] - coef[4] * w[1];
+    out[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+    w[1] = w[0];
+    w[0] = d0;
+  }
+}
+#endif
+
+// ============================================================================
+// COEFFICIENTS (RBJ audio EQ cookbook)
+// ============================================================================
+static void normalize(float* c, double b0, double b1, double b2, double a0,
+                      double a1, double a2) {
+  c[0] = (float)(b0 / a0);
+  c[1] = (float)(b1 / a0);
+  c[2] = (float)(b2 / a0);
+  c[3] = (float)(a1 / a0);
+  c[4] = (float)(a2 / a0);
+}
+
+static void highPass(float* c, double fs, double hz) {
+  double w0 = 2.0 * M_PI * hz / fs;
+  double cw = cos(w0), alpha = sin(w0) / (2.0 * M_SQRT1_2);  // Butterworth
+  normalize(c, (1 + cw) / 2, -(1 + cw), (1 + cw) / 2, 1 + alpha, -2 * cw,
+            1 - alpha);
+}
+
+static void band(float* c, double fs, DspBandType type, double hz,
+                 double gainDb, double q) {
+  double a = pow(10.0, gainDb / 40.0);
+  double w0 = 2.0 * M_PI * hz / fs;
+  double cw = cos(w0), alpha = sin(w0) / (2.0 * q);
+  double sa = 2.0 * sqrt(a) * alpha;
+  switch (type) {
+    case DSP_BAND_PEAK:
+      normalize(c, 1 + alpha * a, -2 * cw, 1 - alpha * a, 1 + alpha / a,
+                -2 * cw, 1 - alpha / a);
+      break;
+    case DSP_BAND_LOW_SHELF:
+      normalize(c, a * ((a + 1) - (a - 1) * cw + sa),
+                2 * a * ((a - 1) - (a + 1) * cw),
+                a * ((a + 1) - (a - 1) * cw - sa), (a + 1) + (a - 1) * cw + sa,
+                -2 * ((a - 1) + (a + 1) * cw), (a + 1) + (a - 1) * cw - sa);
+      break;
+    case DSP_BAND_HIGH_SHELF:
+      normalize(c, a * ((a + 1) + (a - 1) * cw + sa),
+                -2 * a * ((a - 1) + (a + 1) * cw),
+                a * ((a + 1) + (a - 1) * cw - sa), (a + 1) - (a - 1) * cw + sa,
+                2 * ((a - 1) - (a + 1) * cw), (a + 1) - (a - 1) * cw - sa);
+      break;
+    default:
+      normalize(c, 1, 0, 0, 1, 0, 0);
+      break;
+  }
+}
+
+// ============================================================================
+// SETTINGS
+// ============================================================================
+DspChain::DspChain(CycleFn cycles)
+    : cycles(cycles), rate(44100), dirty(true) {
+  cfg.gain = 1.0f;
+  cfg.hpfHz = DSP_DEFAULT_HPF_HZ;
+  cfg.ceiling = powf(10.0f, DSP_DEFAULT_LIMIT_DBFS / 20.0f);
+  for (int i = 0; i < DSP_BANDS; i++) cfg.bands[i] = {DSP_BAND_OFF, 0, 0, 0};
+  memset(cyclesTotal, 0, sizeof(cyclesTotal));
+  frameCount = 0;
+  limitedFrames = 0;
+  limiterMin = 1.0f;
+  applyConfig();
+  reset();
+}
+
+// Setters only touch cfg; the audio task rebuilds its coefficients from it
+// at the next block. A block that races a second setter sees the update at
+// the block after, so the chain always settles on the last settings.
+void DspChain::setRate(uint32_t hz) {
+  if (!hz) return;
+  rate = hz;
+  dirty.store(true, std::memory_order_release);
+}
+
+void DspChain::setGain(float linear) {
+  cfg.gain = linear < 0 ? 0 : linear;
+  dirty.store(true, std::memory_order_release);
+}
+
+void DspChain::setHighPass(float hz) {
+  cfg.hpfHz = hz < 0 ? 0 : hz;
+  dirty.store(true, std::memory_order_release);
+}
+
+bool DspChain::setBand(int index, DspBandType type, float hz, float gainDb,
+                       float q) {
+  if (index < 0 || index >= DSP_BANDS) return false;
+  if (type != DSP_BAND_OFF &&
+      (hz <= 0 || hz >= rate / 2 || q <= 0 || fabsf(gainDb) > 24.0f)) {
+    return false;
+  }
+  cfg.bands[index] = {type, hz, gainDb, q};
+  dirty.store(true, std::memory_order_release);
+  return true;
+}
+
+void DspChain::setLimiter(float ceilingDbfs) {
+  if (ceilingDbfs > 0) ceilingDbfs = 0;
+  cfg.ceiling = powf(10.0f, ceilingDbfs / 20.0f);
+  dirty.store(true, std::memory_order_release);
+}
+
+void DspChain::applyConfig() {
+  gainNow = cfg.gain;
+  hpfOn = cfg.hpfHz > 0 && cfg.hpfHz < rate / 2;
+  if (hpfOn) highPass(hpf, rate, cfg.hpfHz);
+
+  // Only bands doing something are run; the rest cost nothing
+  eqCount = 0;
+  for (int i = 0; i < DSP_BANDS; i++) {
+    const Band& b = cfg.bands[i];
+    if (b.type == DSP_BAND_OFF || b.gainDb == 0) continue;
+    band(eq[eqCount++], rate, b.type, b.hz, b.gainDb, b.q);
+  }
+  ceilingNow = cfg.ceiling;
+  releaseStep = 1.0f / (DSP_RELEASE_MS * 0.001f * rate);
+}
+
+// ============================================================================
+// PROCESSING
+// ============================================================================
+static inline int16_t toPcm(float x) {
+  x *= 32768.0f;
+  if (x >= 32767.0f) return 32767;
+  if (x <= -32768.0f) return -32768;
+  return (int16_t)(x + (x >= 0 ? 0.5f : -0.5f));  // Round to nearest
+}
+
+void DspChain::reset() {
+  memset(w, 0, sizeof(w));
+  memset(delay, 0, sizeof(delay));
+  for (int i = 0; i < DSP_LOOKAHEAD_FRAMES; i++) avg[i] = 1.0f;
+  avgSum = DSP_LOOKAHEAD_FRAMES;
+  minHead = 0;
+  minCount = 0;
+  held = 1.0f;
+  pos = 0;
+  n = 0;
+}
+
+void DspChain::process(int16_t* stereo, uint32_t frames) {
+  if (frames > DSP_MAX_FRAMES) frames = DSP_MAX_FRAMES;
+  if (dirty.exchange(false, std::memory_order_acquire)) applyConfig();
+
+  uint32_t t0 = cycles ? cycles() : 0;
+  const float scale = gainNow * (1.0f / 32768.0f);
+  for (uint32_t i = 0; i < frames; i++) {
+    left[i] = stereo[2 * i] * scale;
+    right[i] = stereo[2 * i + 1] * scale;
+  }
+  uint32_t t1 = cycles ? cycles() : 0;
+
+  if (hpfOn) {
+    dspBiquad(left, left, frames, hpf, w[0][0]);
+    dspBiquad(right, right, frames, hpf, w[1][0]);
+  }
+  uint32_t t2 = cycles ? cycles() : 0;
+
+  for (int b = 0; b < eqCount; b++) {
+    dspBiquad(left, left, frames, eq[b], w[0][1 + b]);
+    dspBiquad(right, right, frames, eq[b], w[1][1 + b]);
+  }
+  uint32_t t3 = cycles ? cycles() : 0;
+
+  limit(frames);
+  for (uint32_t i = 0; i < frames; i++) {
+    stereo[2 * i] = toPcm(left[i]);
+    stereo[2 * i + 1] = toPcm(right[i]);
+  }
+
+  if (cycles) {
+    uint32_t t4 = cycles();
+    cyclesTotal[DSP_STAGE_GAIN] += t1 - t0;
+    cyclesTotal[DSP_STAGE_HIGH_PASS] += t2 - t1;
+    cyclesTotal[DSP_STAGE_EQ] += t3 - t2;
+    cyclesTotal[DSP_STAGE_LIMITER] += t4 - t3;
+  }
+  frameCount += frames;
+}
+
+// Gain each frame needs to stay under the ceiling, its minimum over the
+// look-ahead, then averaged over the look-ahead again. The frame leaving
+// the delay line lies inside every minimum window being averaged, so the
+// gain it gets never exceeds what it needs: no overshoot, and the gain
+// ramps down over the look-ahead instead of stepping. Recovery after a
+// peak is limited to DSP_RELEASE_MS from full reduction back to unity.
+void DspChain::limit(uint32_t frames) {
+  const uint32_t window = DSP_LOOKAHEAD_FRAMES + 1;
+  for (uint32_t i = 0; i < frames; i++, n++) {
+    float l = left[i], r = right[i];
+    float peak = fmaxf(fabsf(l), fabsf(r));
+    float need = peak > ceilingNow ? ceilingNow / peak : 1.0f;
+
+    // Monotonic queue: values rise from head to tail
+    while (minCount &&
+           minValue[(minHead + minCount - 1) % window] >= need) {
+      minCount--;
+    }
+    uint32_t tail = (minHead + minCount++) % window;
+    minValue[tail] = need;
+    minIndex[tail] = n;
+    if (n - minIndex[minHead] >= window) {
+      minHead = (minHead + 1) % window;
+      minCount--;
+    }
+    float m = minValue[minHead];
+
+    held = fminf(m, held + releaseStep);
+    avgSum += held - avg[pos];
+    avg[pos] = held;
+    float g = avgSum * (1.0f / DSP_LOOKAHEAD_FRAMES);
+    if (g > 1.0f) g = 1.0f;
+
+    left[i] = delay[0][pos] * g;
+    right[i] = delay[1][pos] * g;
+    delay[0][pos] = l;
+    delay[1][pos] = r;
+    if (g < 1.0f) {
+      limitedFrames++;
+      if (g < limiterMin) limiterMin = g;
+    }
+
+    if (++pos == DSP_LOOKAHEAD_FRAMES) {
+      // Resum once per lap so float error cannot build up
+      pos = 0;
+      avgSum = 0;
+      for (int k = 0; k < DSP_LOOKAHEAD_FRAMES; k++) avgSum += avg[k];
+    }
+  }
+}
+
+uint32_t DspChain::tail(int16_t* stereo) {
+  memset(stereo, 0, DSP_LOOKAHEAD_FRAMES * 2 * sizeof(int16_t));
+  process(stereo, DSP_LOOKAHEAD_FRAMES);
+  return DSP_LOOKAHEAD_FRAMES;
+}
+
+// ============================================================================
+// STATUS
+// ============================================================================
+size_t DspChain::toJson(char* buf, size_t len, uint32_t cpuHz) const {
+  static const char* names[DSP_STAGE_COUNT] = {"gain", "high_pass", "eq",
+                                               "limiter"};
+  uint64_t frames = frameCount ? frameCount : 1;
+  double total = 0;
+  int at = snprintf(buf, len, "{\"rate\":%u,\"bands\":%d,\"cycles_per_frame\":{",
+                    (unsigned)rate, eqCount);
+  for (int s = 0; s < DSP_STAGE_COUNT && at > 0 && (size_t)at < len; s++) {
+    double c = (double)cyclesTotal[s] / frames;
+    total += c;
+    at += snprintf(buf + at, len - at, "%s\"%s\":%.1f", s ? "," : "",
+                   names[s], c);
+  }
+  if (at <= 0 || (size_t)at >= len) return 0;
+
+  // Share of one core the chain takes at the output rate
+  double load = cpuHz ? total * rate / cpuHz * 100.0 : 0;
+  at += snprintf(buf + at, len - at,
+                 "},\"total\":%.1f,\"cpu_pct\":%.2f,\"frames\":%llu,"
+                 "\"limited_frames\":%u,\"max_reduction_db\":%.1f}",
+                 total, load, (unsigned long long)frameCount,
+                 (unsigned)limitedFrames,
+                 limiterMin < 1.0f ? -20.0f * log10f(limiterMin) : 0.0f);
+  return at > 0 && (size_t)at < len ? at : 0;
+}
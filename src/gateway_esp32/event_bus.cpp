@@ -0,0 +1,64 @@
+#include "../../include/gateway_esp32/event_bus.h"
+
+EventBus::EventBus() : head(0), nextSubscriber(0) {
+  for (int i = 0; i < EVENT_BUS_CAPACITY; i++) {
+    // Sequence that no position matches until the slot is first written
+    slots[i].seq.store(0xFFFFFFFF, std::memory_order_relaxed);
+    memset((void*)&slots[i].event, 0, sizeof(Event));
+  }
+  for (int i = 0; i < EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+    subscribers[i].cursor = 0;
+    subscribers[i].mask = 0;
+    subscribers[i].dropped = 0;
+    subscribers[i].active.store(false, std::memory_order_relaxed);
+  }
+}
+
+int EventBus::subscribe(uint32_t typeMask) {
+  uint8_t id = nextSubscriber.fetch_add(1, std::memory_order_relaxed);
+  if (id >= EVENT_BUS_MAX_SUBSCRIBERS) return -1;
+
+  subscribers[id].cursor = head.load(std::memory_order_acquire);
+  subscribers[id].mask = typeMask;
+  subscribers[id].dropped = 0;
+  subscribers[id].active.store(true, std::memory_order_release);
+  return id;
+}
+
+bool EventBus::poll(int subscriber, Event& out) {
+  if (subscriber < 0 || subscriber >= EVENT_BUS_MAX_SUBSCRIBERS) return false;
+  Subscriber& s = subscribers[subscriber];
+  if (!s.active.load(std::memory_order_acquire)) return false;
+
+  for (;;) {
+    uint32_t pos = s.cursor;
+    Slot& slot = slots[pos & (EVENT_BUS_CAPACITY - 1)];
+    uint32_t seq = slot.seq.load(std::memory_order_acquire);
+
+    if (seq == 2 * pos + 2) {
+      // Copy out, then confirm no publisher reused the slot meanwhile
+      memcpy(&out, (const void*)&slot.event, sizeof(Event));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == seq) {
+        s.cursor = pos + 1;
+        if (s.mask & EVENT_MASK(out.type)) return true;
+        continue;
+      }
+    }
+
+    // Either not published yet, or overwritten because we fell behind
+    uint32_t h = head.load(std::memory_order_acquire);
+    if ((int32_t)(h - pos) > EVENT_BUS_CAPACITY) {
+      uint32_t oldest = h - EVENT_BUS_CAPACITY;
+      s.dropped += oldest - pos;
+      s.cursor = oldest;
+      continue;
+    }
+    return false;
+  }
+}
+
+uint32_t EventBus::dropped(int subscriber) const {
+  if (subscriber < 0 || subscriber >= EVENT_BUS_MAX_SUBSCRIBERS) return 0;
+  return subscribers[subscriber].dropped;
+}
@@ -0,0 +1,86 @@
+#include "../../include/gateway_esp32/latency_profile.h"
+
+#include <string.h>
+
+#include "../../include/gateway_esp32/pcm_ring.h"
+
+// Low: ~35 ms, balanced: ~116 ms, robust: ~232 ms at 44.1 kHz
+static const LatencyProfileSpec kProfiles[LATENCY_PROFILE_COUNT] = {
+    {"low", 4, 1024},
+    {"balanced", 8, 4096},
+    {"robust", 16, 8192},
+};
+
+static_assert(8192 <= PCM_RING_FRAMES, "Robust profile exceeds the PCM ring");
+
+const LatencyProfileSpec& latencyProfileSpec(LatencyProfile profile) {
+  return kProfiles[profile < LATENCY_PROFILE_COUNT ? profile
+                                                   : LATENCY_BALANCED];
+}
+
+bool latencyProfileByName(const char* name, LatencyProfile* out) {
+  for (int p = 0; p < LATENCY_PROFILE_COUNT; p++) {
+    if (strcmp(name, kProfiles[p].name) == 0) {
+      *out = (LatencyProfile)p;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t latencyProfileMs(LatencyProfile profile, uint32_t rateHz) {
+  const LatencyProfileSpec& s = latencyProfileSpec(profile);
+  uint32_t frames = s.dmaBuffers * I2S_DMA_BUF_FRAMES + s.ringFrames;
+  return (uint32_t)((uint64_t)frames * 1000 / (rateHz ? rateHz : 44100));
+}
+
+LatencyGovernor::LatencyGovernor()
+    : floor(LATENCY_BALANCED),
+      current(LATENCY_BALANCED),
+      autoSwitch(true),
+      started(false),
+      relaxed(false),
+      relaxMs(LATENCY_RELAX_MS),
+      lastUnderruns(0),
+      lastSwitchMs(0),
+      lastUnderrunMs(0),
+      switchCount(0) {}
+
+void LatencyGovernor::configure(LatencyProfile requested, bool automatic) {
+  floor = requested < LATENCY_PROFILE_COUNT ? requested : LATENCY_BALANCED;
+  autoSwitch = automatic;
+  current = floor;
+  started = false;
+  relaxed = false;
+  relaxMs = LATENCY_RELAX_MS;
+}
+
+bool LatencyGovernor::update(uint32_t underruns, uint32_t nowMs) {
+  if (!started) {
+    started = true;
+    lastUnderruns = underruns;
+    lastUnderrunMs = nowMs;
+    lastSwitchMs = nowMs - LATENCY_SWITCH_HOLD_MS;  // First step at once
+  }
+  LatencyProfile before = current;
+  if (underruns != lastUnderruns) {
+    lastUnderruns = underruns;
+    lastUnderrunMs = nowMs;
+    if (autoSwitch && current + 1 < LATENCY_PROFILE_COUNT &&
+        nowMs - lastSwitchMs >= LATENCY_SWITCH_HOLD_MS) {
+      // The shallower profile still does not hold: stay deep for longer
+      if (relaxed && relaxMs < LATENCY_RELAX_MAX_MS) relaxMs *= 2;
+      relaxed = false;
+      current = (LatencyProfile)(current + 1);
+    }
+  } else if (autoSwitch && current > floor &&
+             nowMs - lastUnderrunMs >= relaxMs &&
+             nowMs - lastSwitchMs >= relaxMs) {
+    relaxed = true;
+    current = (LatencyProfile)(current - 1);
+  }
+  if (current == before) return false;
+  lastSwitchMs = nowMs;
+  switchCount++;
+  return true;
+}
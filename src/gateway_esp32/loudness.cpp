@@ -0,0 +1,136 @@
+#include "../../include/gateway_esp32/loudness.h"
+
+#include <math.h>
+#include <string.h>
+
+#define BIN_FLOOR LOUDNESS_FLOOR_LUFS
+
+static float energyToLufs(float energy) {
+  return energy > 0 ? -0.691f + 10.0f * log10f(energy) : -INFINITY;
+}
+
+LoudnessMeter::LoudnessMeter() : rate(0), hopFrames(0) { reset(); }
+
+void LoudnessMeter::reset() {
+  memset(state, 0, sizeof(state));
+  memset(binCount, 0, sizeof(binCount));
+  memset(binEnergy, 0, sizeof(binEnergy));
+  memset(hops, 0, sizeof(hops));
+  hopFill = 0;
+  hopEnergy = 0;
+  hopTotal = 0;
+  blockCount = 0;
+  frameCount = 0;
+  samplePeak = 0;
+  setRate(rate ? rate : 44100);
+}
+
+// K-weighting for any rate, from the analog prototypes of BS.1770
+void LoudnessMeter::setRate(uint32_t rateHz) {
+  if (rateHz == 0 || (rateHz == rate && hopFrames)) return;
+  rate = rateHz;
+  hopFrames = rate / 10;
+
+  double fs = rate;
+  double f0 = 1681.974450955533, g = 3.999843853973347;
+  double q = 0.7071752369554196;
+  double k = tan(M_PI * f0 / fs);
+  double vh = pow(10.0, g / 20.0);
+  double vb = pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  shelf.b0 = (float)((vh + vb * k / q + k * k) / a0);
+  shelf.b1 = (float)(2.0 * (k * k - vh) / a0);
+  shelf.b2 = (float)((vh - vb * k / q + k * k) / a0);
+  shelf.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+  shelf.a2 = (float)((1.0 - k / q + k * k) / a0);
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = tan(M_PI * f0 / fs);
+  a0 = 1.0 + k / q + k * k;
+  highPass.b0 = 1.0f;
+  highPass.b1 = -2.0f;
+  highPass.b2 = 1.0f;
+  highPass.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+  highPass.a2 = (float)((1.0 - k / q + k * k) / a0);
+}
+
+inline float LoudnessMeter::filter(int channel, float x) {
+  float* s = state[channel];
+  float y = shelf.b0 * x + s[0];
+  s[0] = shelf.b1 * x - shelf.a1 * y + s[1];
+  s[1] = shelf.b2 * x - shelf.a2 * y;
+  float z = highPass.b0 * y + s[2];
+  s[2] = highPass.b1 * y - highPass.a1 * z + s[3];
+  s[3] = highPass.b2 * y - highPass.a2 * z;
+  return z;
+}
+
+void LoudnessMeter::addFrame(int16_t left, int16_t right) {
+  const float scale = 1.0f / 32768.0f;
+  float l = left * scale, r = right * scale;
+  float al = fabsf(l), ar = fabsf(r);
+  if (al > samplePeak) samplePeak = al;
+  if (ar > samplePeak) samplePeak = ar;
+
+  float kl = filter(0, l), kr = filter(1, r);
+  hopEnergy += kl * kl + kr * kr;
+  frameCount++;
+  if (++hopFill >= hopFrames) endHop();
+}
+
+void LoudnessMeter::add(const int16_t* stereo, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    addFrame(stereo[2 * i], stereo[2 * i + 1]);
+  }
+}
+
+// A 400 ms block ends every 100 ms once four hops are in
+void LoudnessMeter::endHop() {
+  hops[hopTotal++ & 3] = hopEnergy / hopFill;
+  hopEnergy = 0;
+  hopFill = 0;
+  if (hopTotal < 4) return;
+
+  float energy = (hops[0] + hops[1] + hops[2] + hops[3]) * 0.25f;
+  float lufs = energyToLufs(energy);
+  if (!(lufs > BIN_FLOOR)) return;  // Absolute gate
+
+  int bin = (int)((lufs - BIN_FLOOR) / LOUDNESS_BIN_LU);
+  if (bin >= LOUDNESS_BINS) bin = LOUDNESS_BINS - 1;
+  binCount[bin]++;
+  binEnergy[bin] += energy;
+  blockCount++;
+}
+
+float LoudnessMeter::integratedLufs() const {
+  if (!blockCount) return LOUDNESS_FLOOR_LUFS;
+
+  double total = 0;
+  for (int i = 0; i < LOUDNESS_BINS; i++) total += binEnergy[i];
+  float relativeGate = energyToLufs((float)(total / blockCount)) - 10.0f;
+
+  // Blocks of the bin holding the gate are split by their mean level
+  double sum = 0;
+  uint32_t count = 0;
+  for (int i = 0; i < LOUDNESS_BINS; i++) {
+    if (!binCount[i]) continue;
+    float mean = energyToLufs(binEnergy[i] / binCount[i]);
+    if (mean > relativeGate) {
+      sum += binEnergy[i];
+      count += binCount[i];
+    }
+  }
+  if (!count) return LOUDNESS_FLOOR_LUFS;
+  return energyToLufs((float)(sum / count));
+}
+
+float LoudnessMeter::gainDb(float targetLufs) const {
+  if (!blockCount || samplePeak <= 0) return 0;
+  float gain = targetLufs - integratedLufs();
+  float headroom = -20.0f * log10f(samplePeak);
+  if (gain > headroom) gain = headroom;
+  if (gain > LOUDNESS_MAX_GAIN_DB) gain = LOUDNESS_MAX_GAIN_DB;
+  if (gain < LOUDNESS_MIN_GAIN_DB) gain = LOUDNESS_MIN_GAIN_DB;
+  return gain;
+}
@@ -12,10 +12,16 @@
 #include <soc/soc.h>
 
 #include "../../include/gateway_esp32/audio_manager.h"
+#include "../../include/gateway_esp32/buffer_pool.h"
 #include "../../include/gateway_esp32/display_manager.h"
+#include "../../include/gateway_esp32/event_bus.h"
+#include "../../include/gateway_esp32/memory_map.h"
 #include "../../include/gateway_esp32/mqtt_manager.h"
 #include "../../include/gateway_esp32/mqtt_setup.h"
+#include "../../include/gateway_esp32/node_ota_manager.h"
+#include "../../include/gateway_esp32/ota_manager.h"
 #include "../../include/gateway_esp32/rtos_tasks.h"
+#include "../../include/gateway_esp32/rule_manager.h"
 #include "../../include/gateway_esp32/sd_manager.h"
 #include "../../include/gateway_esp32/sensor_manager.h"
 #include "../../include/gateway_esp32/wifi_espnow_manager.h"
@@ -63,20 +69,40 @@ MQTTManager mqtt;
 AudioManager audio;
 SDManager sdManager;
 DisplayManager displayManager;
+NodeOtaManager nodeOta;
+OtaManager gatewayOta;
+RuleManager ruleManager;
+EventBus eventBus;
+BufferPool bufferPool;
+
+static_assert(sizeof(localSensors) + sizeof(tca) + sizeof(wifiClient) +
+                      sizeof(mqttClient) + sizeof(mqtt) + sizeof(audio) +
+                      sizeof(sdManager) + sizeof(displayManager) +
+                      sizeof(nodeOta) + sizeof(gatewayOta) +
+                      sizeof(ruleManager) + sizeof(eventBus) +
+                      sizeof(bufferPool) <=
+                  RAM_BUDGET_MAIN,
+              "Global managers exceed RAM_BUDGET_MAIN");
 
 // ============================================================================
 // Global Variables
 // ============================================================================
 
 // Remote sensor data (from NodeMCU via ESP-NOW)
-SensorData remoteSensorData;
-bool remoteSensorDataAvailable = false;
 unsigned long lastRemoteDataReceived = 0;
 
+// Playback time base, kept by ESP-NOW beacons (wifi_espnow_manager.cpp)
+extern SyncClock syncClock;
+extern portMUX_TYPE syncClockLock;
+
 // ============================================================================
 // Function Declarations
 // ============================================================================
 
+// Keep the Arduino core from marking a freshly updated image valid at boot;
+// OtaManager::bootHealthTick() confirms it once MQTT is connected
+extern "C" bool verifyRollbackLater() { return true; }
+
 // ============================================================================
 // Arduino Setup
 // ============================================================================
@@ -98,9 +124,16 @@ void setup() {
 
   // Initialize components
   localSensors.begin(&tca, true);
+  localSensors.beginNoise();
   displayManager.begin(&tca);
   displayManager.showStartup();
 
+  // Transfer buffers, before the heap gets fragmented
+  if (!bufferPool.begin()) {
+    Serial.println("[System] ✗ Buffer pool allocation failed!");
+  }
+  sdManager.setBufferPool(&bufferPool);
+
   // Initialize SD card first
   if (!sdManager.begin(5)) {
     Serial.println("[System] SD Manager initialization failed!");
@@ -110,12 +143,22 @@ void setup() {
   audio.begin();
   audio.setSDManager(&sdManager);
   audio.setMQTTManager(&mqtt);
+  audio.setEventBus(&eventBus);
+  audio.setBufferPool(&bufferPool);
+  audio.setSyncClock(&syncClock, &syncClockLock);
+  nodeOta.setSDManager(&sdManager);
+  nodeOta.setMQTTManager(&mqtt);
+  gatewayOta.setMQTTManager(&mqtt);
+  gatewayOta.setBufferPool(&bufferPool);
+  ruleManager.setSDManager(&sdManager);
+  ruleManager.setMQTTManager(&mqtt);
+  ruleManager.setAudioManager(&audio);
 
   // Set display manager dependencies
   displayManager.setSensorManager(&localSensors);
   displayManager.setSDManager(&sdManager);
   displayManager.setAudioManager(&audio);
-  displayManager.setRemoteSensorData(&remoteSensorData);
+  displayManager.setEventBus(&eventBus);
 
   // Setup WiFi and MQTT
   setupWiFi();
@@ -124,6 +167,9 @@ void setup() {
   // Setup ESP-NOW (after WiFi for channel sync)
   setupESPNow();
 
+  // Local automations (needs the network stack for NTP)
+  ruleManager.begin();
+
   Serial.println("\n[System] Setup complete!\n");
 
   // Initialize and start FreeRTOS tasks
@@ -142,6 +188,8 @@ void setup() {
 void loop() {
   // WiFi maintenance (everything else runs in FreeRTOS tasks)
   maintainWiFi();
+  meshBeaconTick();
+  syncBeaconTick();
 
   // Small delay to prevent watchdog issues
   vTaskDelay(pdMS_TO_TICKS(100));
@@ -0,0 +1,81 @@
+#include "../../include/gateway_esp32/mesh_stats.h"
+
+MeshStats::MeshStats() : lock(portMUX_INITIALIZER_UNLOCKED) { reset(); }
+
+void MeshStats::reset() {
+  portENTER_CRITICAL(&lock);
+  memset(hops, 0, sizeof(hops));
+  memset(lastSeq, 0, sizeof(lastSeq));
+  memset(seenOrigin, 0, sizeof(seenOrigin));
+  duplicates = 0;
+  legacyFrames = 0;
+  portEXIT_CRITICAL(&lock);
+}
+
+void MeshStats::record(const MeshHeader& header) {
+  uint8_t hop = header.hopCount;
+  if (hop == 0 || hop > MESH_MAX_HOPS) return;
+
+  portENTER_CRITICAL(&lock);
+  MeshHopStats& s = hops[hop];
+  s.received++;
+
+  // Gaps in the origin's sequence are charged to the bucket of the frame that
+  // revealed them; a node keeps the same route most of the time.
+  if (header.originId < MESH_STATS_MAX_ORIGINS) {
+    uint8_t id = header.originId;
+    if (seenOrigin[id]) {
+      s.lost += meshSeqLost(&lastSeq[id], header.seq);
+    } else {
+      seenOrigin[id] = true;
+      lastSeq[id] = header.seq;
+    }
+  }
+
+  // Per-hop latency: residence time is split evenly across the relays
+  if (hop > 1) {
+    uint16_t perHop = header.relayDelayMs / (hop - 1);
+    s.delaySumMs += perHop;
+    if (perHop > s.delayMaxMs) s.delayMaxMs = perHop;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void MeshStats::recordDuplicate() {
+  portENTER_CRITICAL(&lock);
+  duplicates++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void MeshStats::recordLegacy() {
+  portENTER_CRITICAL(&lock);
+  legacyFrames++;
+  portEXIT_CRITICAL(&lock);
+}
+
+size_t MeshStats::toJson(char* buf, size_t len) {
+  MeshHopStats snap[MESH_MAX_HOPS + 1];
+  uint32_t dup, legacy;
+
+  portENTER_CRITICAL(&lock);
+  memcpy(snap, hops, sizeof(snap));
+  dup = duplicates;
+  legacy = legacyFrames;
+  portEXIT_CRITICAL(&lock);
+
+  size_t pos = snprintf(buf, len, "{\"dup\":%u,\"legacy\":%u,\"hops\":[",
+                        dup, legacy);
+  for (int h = 1; h <= MESH_MAX_HOPS && pos < len; h++) {
+    const MeshHopStats& s = snap[h];
+    uint32_t total = s.received + s.lost;
+    float lossPct = total ? 100.0f * s.lost / total : 0.0f;
+    uint32_t avgMs = (h > 1 && s.received) ? s.delaySumMs / s.received : 0;
+    pos += snprintf(buf + pos, len - pos,
+                    "%s{\"hop\":%d,\"rx\":%u,\"lost\":%u,\"loss\":%.1f,"
+                    "\"avg_ms\":%u,\"max_ms\":%u}",
+                    h > 1 ? "," : "", h, s.received, s.lost, lossPct, avgMs,
+                    s.delayMaxMs);
+  }
+  if (pos < len) pos += snprintf(buf + pos, len - pos, "]}");
+  return pos < len ? pos : 0;
+}
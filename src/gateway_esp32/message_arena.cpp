@@ -0,0 +1,74 @@
+#include "../../include/gateway_esp32/message_arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+MessageArena::MessageArena()
+    : offset(0), peak(0), fallbackList(nullptr), fallbackCount(0) {}
+
+MessageArena::~MessageArena() { reset(); }
+
+void* MessageArena::alloc(size_t size) {
+  size_t start = (offset + MESSAGE_ARENA_ALIGN - 1) & ~(MESSAGE_ARENA_ALIGN - 1);
+  if (start + size <= MESSAGE_ARENA_SIZE) {
+    offset = start + size;
+    if (offset > peak) peak = offset;
+    return buffer + start;
+  }
+
+  // Overflow: heap block with a link header so reset() can free it
+  Fallback* block = (Fallback*)malloc(sizeof(Fallback) + size);
+  if (!block) return nullptr;
+  block->next = fallbackList;
+  fallbackList = block;
+  fallbackCount++;
+  return block + 1;
+}
+
+char* MessageArena::copy(const char* data, size_t len) {
+  char* out = (char*)alloc(len + 1);
+  if (!out) return nullptr;
+  memcpy(out, data, len);
+  out[len] = '\0';
+  return out;
+}
+
+char* MessageArena::format(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  char* out = vformat(fmt, args);
+  va_end(args);
+  return out;
+}
+
+char* MessageArena::vformat(const char* fmt, va_list args) {
+  // Format straight into the free tail; only measure and retry if it is short
+  size_t start = offset;
+  size_t room = MESSAGE_ARENA_SIZE - start;
+  va_list copyArgs;
+  va_copy(copyArgs, args);
+  int n = vsnprintf((char*)buffer + start, room, fmt, copyArgs);
+  va_end(copyArgs);
+  if (n < 0) return nullptr;
+
+  if ((size_t)n < room) {
+    offset = start + n + 1;
+    if (offset > peak) peak = offset;
+    return (char*)buffer + start;
+  }
+
+  char* out = (char*)alloc(n + 1);
+  if (!out) return nullptr;
+  vsnprintf(out, n + 1, fmt, args);
+  return out;
+}
+
+void MessageArena::reset() {
+  while (fallbackList) {
+    Fallback* next = fallbackList->next;
+    free(fallbackList);
+    fallbackList = next;
+  }
+  offset = 0;
+}
@@ -0,0 +1,526 @@
+#include "../../include/gateway_esp32/mp3_index.h"
+
+#include <string.h>
+
+#define SYNC_SEARCH_BYTES 65536  // How far past the tag the first frame may be
+#define RESYNC_BYTES 4096        // Garbage tolerated between frames
+
+// ============================================================================
+// HEADER PARSING
+// ============================================================================
+static const uint16_t kBitrateV1[16] = {0,   32,  40,  48,  56,  64,
+                                        80,  96,  112, 128, 160, 192,
+                                        224, 256, 320, 0};
+static const uint16_t kBitrateV2[16] = {0,  8,  16, 24,  32,  40,  48,  56,
+                                        64, 80, 96, 112, 128, 144, 160, 0};
+static const uint32_t kRateV1[3] = {44100, 48000, 32000};
+
+bool parseMp3Header(const uint8_t* h, Mp3FrameHeader& out) {
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+  uint8_t version = (h[1] >> 3) & 3;  // 0: 2.5, 1: reserved, 2: 2, 3: 1
+  uint8_t layer = (h[1] >> 1) & 3;    // 1: Layer III
+  uint8_t bitrateIndex = h[2] >> 4;
+  uint8_t rateIndex = (h[2] >> 2) & 3;
+  if (version == 1 || layer != 1 || bitrateIndex == 0 ||
+      bitrateIndex == 15 || rateIndex == 3) {
+    return false;
+  }
+
+  bool mpeg1 = version == 3;
+  uint32_t rate = kRateV1[rateIndex];
+  if (version == 2) rate /= 2;
+  if (version == 0) rate /= 4;
+  uint32_t kbps = mpeg1 ? kBitrateV1[bitrateIndex] : kBitrateV2[bitrateIndex];
+  uint16_t spf = mpeg1 ? 1152 : 576;
+  uint32_t padding = (h[2] >> 1) & 1;
+
+  out.sampleRate = rate;
+  out.bitrate = kbps * 1000;
+  out.samplesPerFrame = spf;
+  out.frameBytes = (uint16_t)(spf / 8 * out.bitrate / rate + padding);
+  out.channels = (h[3] >> 6) == 3 ? 1 : 2;
+  out.mpeg1 = mpeg1;
+  return true;
+}
+
+uint32_t id3v2TagSize(const uint8_t* h) {
+  if (h[0] != 'I' || h[1] != 'D' || h[2] != '3') return 0;
+  if (h[3] == 0xFF || h[4] == 0xFF) return 0;
+  if ((h[6] | h[7] | h[8] | h[9]) & 0x80) return 0;  // Not syncsafe
+  uint32_t size = ((uint32_t)h[6] << 21) | ((uint32_t)h[7] << 14) |
+                  ((uint32_t)h[8] << 7) | h[9];
+  return 10 + size + ((h[5] & 0x10) ? 10 : 0);  // Header, body, footer
+}
+
+static uint32_t be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t be16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+static uint32_t syncsafe32(const uint8_t* p) {
+  return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+         ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// Appends one character as UTF-8; false once dst is full. Quotes,
+// backslashes and control characters are replaced so the text can go
+// into JSON as is.
+static bool putUtf8(char* dst, size_t& n, uint32_t c) {
+  if (c < 0x20) c = ' ';
+  if (c == '"') c = '\'';
+  if (c == '\\') c = '/';
+  char tmp[3];
+  size_t len;
+  if (c < 0x80) {
+    tmp[0] = (char)c, len = 1;
+  } else if (c < 0x800) {
+    tmp[0] = (char)(0xC0 | c >> 6), tmp[1] = (char)(0x80 | (c & 0x3F)),
+    len = 2;
+  } else {
+    tmp[0] = (char)(0xE0 | c >> 12), tmp[1] = (char)(0x80 | ((c >> 6) & 0x3F)),
+    tmp[2] = (char)(0x80 | (c & 0x3F)), len = 3;
+  }
+  if (n + len >= MP3_TAG_TEXT_LEN) return false;
+  memcpy(dst + n, tmp, len);
+  n += len;
+  dst[n] = '\0';
+  return true;
+}
+
+// Body of an ID3v2 text frame (encoding byte first) into dst as UTF-8
+static void copyTagText(const uint8_t* t, size_t len, char* dst) {
+  size_t n = 0;
+  dst[0] = '\0';
+  if (len < 2) return;
+  uint8_t enc = t[0];
+  const uint8_t* p = t + 1;
+  const uint8_t* end = t + len;
+
+  if (enc == 1 || enc == 2) {  // UTF-16 with BOM, UTF-16BE
+    bool le = false;
+    if (enc == 1 && p + 2 <= end && p[0] == 0xFF && p[1] == 0xFE) {
+      le = true, p += 2;
+    } else if (enc == 1 && p + 2 <= end && p[0] == 0xFE && p[1] == 0xFF) {
+      p += 2;
+    }
+    for (; p + 2 <= end; p += 2) {
+      uint32_t c = le ? (p[0] | p[1] << 8) : (p[0] << 8 | p[1]);
+      if (c == 0) break;
+      if (c >= 0xD800 && c <= 0xDFFF) c = '?';  // Outside the BMP
+      if (!putUtf8(dst, n, c)) break;
+    }
+  } else if (enc == 3) {  // UTF-8, cut on a character boundary
+    size_t take = 0;
+    while (p + take < end && p[take] && take < MP3_TAG_TEXT_LEN - 1) take++;
+    if (p + take < end && p[take] && take == MP3_TAG_TEXT_LEN - 1) {
+      while (take && (p[take] & 0xC0) == 0x80) take--;
+    }
+    for (size_t i = 0; i < take; i++) {
+      uint8_t c = p[i];
+      if (c < 0x80) {
+        putUtf8(dst, n, c);
+      } else {
+        dst[n++] = (char)c, dst[n] = '\0';
+      }
+    }
+  } else {  // ISO-8859-1
+    for (; p < end && *p; p++) {
+      if (!putUtf8(dst, n, *p)) break;
+    }
+  }
+}
+
+// ============================================================================
+// INDEX QUERIES
+// ============================================================================
+bool Mp3Index::valid() const {
+  return h.magic == MP3_INDEX_MAGIC && h.version == MP3_INDEX_VERSION &&
+         h.entries > 0 && h.entries <= MP3_INDEX_ENTRIES &&
+         h.framesPerEntry > 0 && h.sampleRate > 0 && h.samplesPerFrame > 0;
+}
+
+uint32_t Mp3Index::durationMs() const { return msForFrame(h.totalFrames); }
+
+uint32_t Mp3Index::frameForMs(uint32_t ms) const {
+  if (!h.sampleRate) return 0;
+  uint64_t frame = (uint64_t)ms * h.sampleRate / (1000ULL * h.samplesPerFrame);
+  return frame < h.totalFrames ? (uint32_t)frame : h.totalFrames;
+}
+
+uint32_t Mp3Index::msForFrame(uint32_t frame) const {
+  if (!h.sampleRate) return 0;
+  return (uint32_t)((uint64_t)frame * h.samplesPerFrame * 1000 / h.sampleRate);
+}
+
+uint32_t Mp3Index::msForOffset(uint32_t offset) const {
+  if (!h.entries || offset <= offsets[0]) return 0;
+  if (offset >= h.audioEnd) return durationMs();
+
+  // Last entry at or before offset
+  uint32_t lo = 0, hi = h.entries - 1;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi + 1) / 2;
+    if (offsets[mid] <= offset) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  uint32_t first = lo * h.framesPerEntry;
+  uint32_t end = lo + 1 < h.entries ? offsets[lo + 1] : h.audioEnd;
+  uint32_t frames = lo + 1 < h.entries ? h.framesPerEntry
+                                       : h.totalFrames - first;
+  uint32_t span = end > offsets[lo] ? end - offsets[lo] : 1;
+  return msForFrame(first +
+                    (uint32_t)((uint64_t)(offset - offsets[lo]) * frames / span));
+}
+
+size_t Mp3Index::storedSize() const {
+  return sizeof(h) + (size_t)h.entries * sizeof(offsets[0]);
+}
+
+// ============================================================================
+// INDEXER
+// ============================================================================
+Mp3Indexer::Mp3Indexer(ReadFn read, void* ctx, uint32_t fileSize,
+                       uint8_t* scratch, size_t scratchLen)
+    : readFn(read),
+      ctx(ctx),
+      fileSize(fileSize),
+      buf(scratch),
+      cap(scratchLen),
+      base(0),
+      len(0),
+      readBytes(0) {}
+
+// n bytes at offset through the scratch window, refilled from offset on a
+// miss; nullptr past the end of the file
+const uint8_t* Mp3Indexer::at(uint32_t offset, size_t n) {
+  if (offset >= base && offset + n <= base + len) return buf + (offset - base);
+  if (n > cap || offset >= fileSize) return nullptr;
+  size_t want = fileSize - offset < cap ? fileSize - offset : cap;
+  len = readFn(ctx, offset, buf, want);
+  base = offset;
+  readBytes += len;
+  return len >= n ? buf : nullptr;
+}
+
+bool Mp3Indexer::headerAt(uint32_t offset, Mp3FrameHeader& out) {
+  const uint8_t* p = at(offset, 4);
+  return p && parseMp3Header(p, out);
+}
+
+// First offset in [offset, limit) holding a header whose successor is a
+// header too (or the end of the file); UINT32_MAX if there is none
+uint32_t Mp3Indexer::sync(uint32_t offset, uint32_t limit,
+                          Mp3FrameHeader& out) {
+  if (limit > fileSize) limit = fileSize;
+  for (uint32_t o = offset; o + 4 <= limit; o++) {
+    const uint8_t* p = at(o, 4);
+    if (!p) break;
+    if (p[0] != 0xFF || !parseMp3Header(p, out)) continue;
+    uint32_t next = o + out.frameBytes;
+    Mp3FrameHeader nh;
+    if (next == fileSize || (next + 4 <= fileSize && headerAt(next, nh))) {
+      return o;
+    }
+  }
+  return UINT32_MAX;
+}
+
+bool Mp3Indexer::build(Mp3Index& out, bool fullScan) {
+  memset(&out, 0, sizeof(out));
+  out.h.magic = MP3_INDEX_MAGIC;
+  out.h.version = MP3_INDEX_VERSION;
+  out.h.fileSize = fileSize;
+
+  // Skip ID3v2 tags by their declared size
+  uint32_t pos = 0;
+  for (;;) {
+    const uint8_t* p = at(pos, 10);
+    uint32_t tag = p ? id3v2TagSize(p) : 0;
+    if (!tag) break;
+    readTags(pos, tag, out.h);
+    pos += tag;
+  }
+
+  Mp3FrameHeader fh;
+  uint32_t first = sync(pos, pos + SYNC_SEARCH_BYTES, fh);
+  if (first == UINT32_MAX) return false;
+  out.h.sampleRate = fh.sampleRate;
+  out.h.samplesPerFrame = fh.samplesPerFrame;
+  out.h.channels = fh.channels;
+  out.h.audioStart = first;
+
+  // Xing/Info or VBRI in the first frame: that frame carries no audio
+  VbrInfo v;
+  memset(&v, 0, sizeof(v));
+  const uint8_t* f = at(first, fh.frameBytes);
+  if (f) {
+    uint32_t side = fh.mpeg1 ? (fh.channels == 1 ? 17 : 32)
+                             : (fh.channels == 1 ? 9 : 17);
+    const uint8_t* x = f + 4 + side;
+    const uint8_t* vb = f + 4 + 32;
+    if (4 + side + 8 <= fh.frameBytes &&
+        (!memcmp(x, "Xing", 4) || !memcmp(x, "Info", 4))) {
+      out.h.flags |= MP3_INDEX_XING;
+      if (!memcmp(x, "Xing", 4)) out.h.flags |= MP3_INDEX_VBR;
+      uint32_t flags = be32(x + 4);
+      const uint8_t* q = x + 8;
+      const uint8_t* end = f + fh.frameBytes;
+      if ((flags & 1) && q + 4 <= end) v.frames = be32(q), q += 4;
+      if ((flags & 2) && q + 4 <= end) v.bytes = be32(q), q += 4;
+      if ((flags & 4) && q + 100 <= end) {
+        memcpy(v.toc, q, 100);
+        v.xingToc = true;
+      }
+    } else if (4 + 32 + 26 <= fh.frameBytes && !memcmp(vb, "VBRI", 4)) {
+      out.h.flags |= MP3_INDEX_VBRI | MP3_INDEX_VBR;
+      v.bytes = be32(vb + 10);
+      v.frames = be32(vb + 14);
+      v.vbriEntries = be16(vb + 18);
+      v.vbriScale = be16(vb + 20);
+      v.vbriEntrySize = be16(vb + 22);
+      v.vbriFramesPerEntry = be16(vb + 24);
+    }
+    if (out.h.flags & (MP3_INDEX_XING | MP3_INDEX_VBRI)) {
+      out.h.audioStart = first + fh.frameBytes;
+    }
+  }
+
+  if (fullScan) {
+    scan(out.h.audioStart, out);
+  } else {
+    estimate(first, fh, v, out);
+  }
+
+  if (!out.h.totalFrames || !out.h.entries) return false;
+  uint64_t bits = (uint64_t)(out.h.audioEnd - out.h.audioStart) * 8;
+  out.h.bitrate =
+      (uint32_t)(bits * out.h.sampleRate /
+                 ((uint64_t)out.h.totalFrames * out.h.samplesPerFrame));
+  return true;
+}
+
+// Title and artist of an ID3v2.2-2.4 tag. Frame headers are visited by
+// their sizes, so album art and other large frames are never read.
+void Mp3Indexer::readTags(uint32_t tag, uint32_t tagLen, Mp3IndexHeader& h) {
+  const uint8_t* p = at(tag, 10);
+  if (!p) return;
+  uint8_t major = p[3];
+  uint8_t flags = p[5];
+  // Tag-wide unsynchronisation would need every byte: leave the text out
+  if (major < 2 || major > 4 || (flags & 0x80)) return;
+
+  uint32_t end = tag + tagLen - ((flags & 0x10) ? 10 : 0);
+  uint32_t pos = tag + 10;
+  if ((flags & 0x40) && major >= 3) {  // Extended header
+    const uint8_t* e = at(pos, 4);
+    if (!e) return;
+    pos += major == 4 ? syncsafe32(e) : be32(e) + 4;
+  }
+
+  uint32_t frameHeader = major == 2 ? 6 : 10;
+  while (pos + frameHeader <= end && !(h.title[0] && h.artist[0])) {
+    const uint8_t* f = at(pos, frameHeader);
+    if (!f || f[0] == 0) break;  // Padding
+
+    uint32_t size;
+    char* dst = nullptr;
+    if (major == 2) {
+      size = (uint32_t)f[3] << 16 | (uint32_t)f[4] << 8 | f[5];
+      if (!memcmp(f, "TT2", 3)) dst = h.title;
+      if (!memcmp(f, "TP1", 3)) dst = h.artist;
+    } else {
+      size = major == 4 ? syncsafe32(f + 4) : be32(f + 4);
+      if (!memcmp(f, "TIT2", 4)) dst = h.title;
+      if (!memcmp(f, "TPE1", 4)) dst = h.artist;
+      // Compressed, encrypted or grouped frames are not plain text
+      if (f[9] & (major == 4 ? 0x4F : 0xE0)) dst = nullptr;
+    }
+
+    uint32_t body = pos + frameHeader;
+    if (size > end - body) break;
+    if (dst && !dst[0]) {
+      // UTF-16 needs up to two bytes per character, plus encoding and BOM
+      size_t n = size < MP3_TAG_TEXT_LEN * 2 + 3 ? size
+                                                 : MP3_TAG_TEXT_LEN * 2 + 3;
+      const uint8_t* t = at(body, n);
+      if (t) copyTagText(t, n, dst);
+    }
+    pos = body + size;
+  }
+}
+
+// Exact table: hop from header to header through the whole file
+void Mp3Indexer::scan(uint32_t start, Mp3Index& out) {
+  uint32_t fpe = 1, entries = 0, frames = 0, firstBitrate = 0;
+  uint32_t pos = start;
+  Mp3FrameHeader fh;
+
+  while (pos + 4 <= fileSize) {
+    if (!headerAt(pos, fh)) {
+      // Lost sync: junk between frames, or a trailing ID3v1/APE tag
+      uint32_t next = sync(pos + 1, pos + RESYNC_BYTES, fh);
+      if (next == UINT32_MAX) break;
+      pos = next;
+    }
+    if (pos + fh.frameBytes > fileSize) break;  // Truncated last frame
+
+    if (frames % fpe == 0) {
+      if (entries == MP3_INDEX_ENTRIES) {
+        // Full: keep every other seek point, twice the frames per entry
+        for (uint32_t i = 0; i < MP3_INDEX_ENTRIES / 2; i++) {
+          out.offsets[i] = out.offsets[2 * i];
+        }
+        entries = MP3_INDEX_ENTRIES / 2;
+        fpe *= 2;
+      }
+      if (frames % fpe == 0) out.offsets[entries++] = pos;
+    }
+
+    if (!firstBitrate) firstBitrate = fh.bitrate;
+    if (fh.bitrate != firstBitrate) out.h.flags |= MP3_INDEX_VBR;
+    frames++;
+    pos += fh.frameBytes;
+  }
+
+  out.h.totalFrames = frames;
+  out.h.framesPerEntry = fpe;
+  out.h.entries = (uint16_t)entries;
+  out.h.audioEnd = pos;
+  out.h.flags |= MP3_INDEX_EXACT;
+}
+
+// Approximate table from the first frame only: VBRI segment sizes, the
+// Xing percentage TOC, or the constant frame size of a CBR file
+void Mp3Indexer::estimate(uint32_t first, const Mp3FrameHeader& fh,
+                          const VbrInfo& v, Mp3Index& out) {
+  uint32_t start = out.h.audioStart;
+  uint32_t end = fileSize;
+  const uint8_t* tail = fileSize >= 128 ? at(fileSize - 128, 3) : nullptr;
+  if (tail && !memcmp(tail, "TAG", 3)) end -= 128;  // ID3v1
+
+  // CBR: frame length is spf / 8 * bitrate / rate with padding spreading
+  // the fraction, so frame n starts at n times the exact mean length
+  uint64_t cbrNum = (uint64_t)fh.samplesPerFrame * fh.bitrate;
+  uint64_t cbrDen = 8ULL * fh.sampleRate;
+
+  uint32_t total;
+  if (v.frames) {
+    total = v.frames;
+    if (v.bytes && first + v.bytes <= end) end = first + v.bytes;
+  } else {
+    total = (uint32_t)(((uint64_t)(end - start) * cbrDen + cbrNum / 2) /
+                       cbrNum);
+  }
+  if (!total || end <= start) return;
+
+  // VBRI segment table, read once into the scratch window
+  const uint8_t* vt = nullptr;
+  if (v.vbriEntries && v.vbriFramesPerEntry && v.vbriEntrySize &&
+      v.vbriEntrySize <= 4) {
+    vt = at(first + 4 + 32 + 26, (size_t)v.vbriEntries * v.vbriEntrySize);
+  }
+
+  // With VBRI, seek points fall on segment boundaries, where it is exact
+  uint32_t fpe = (total + MP3_INDEX_ENTRIES - 1) / MP3_INDEX_ENTRIES;
+  if (vt) {
+    uint32_t segs = (fpe + v.vbriFramesPerEntry - 1) / v.vbriFramesPerEntry;
+    fpe = segs * v.vbriFramesPerEntry;
+  }
+  uint32_t entries = (total + fpe - 1) / fpe;
+  uint32_t span = end - start;
+
+  for (uint32_t i = 0; i < entries; i++) {
+    uint32_t frame = i * fpe;
+    uint64_t offset;
+    if (vt) {
+      // Walk segments up to the one holding this frame
+      uint32_t seg = frame / v.vbriFramesPerEntry;
+      uint64_t acc = 0;
+      uint32_t j = 0;
+      for (; j < seg && j < v.vbriEntries; j++) {
+        uint32_t val = 0;
+        for (int b = 0; b < v.vbriEntrySize; b++) {
+          val = val << 8 | vt[j * v.vbriEntrySize + b];
+        }
+        acc += (uint64_t)val * v.vbriScale;
+      }
+      offset = start + acc;
+    } else if (v.xingToc) {
+      // TOC: byte position (1/256ths) at each whole percent of duration
+      uint64_t pct1000 = (uint64_t)frame * 100000 / total;  // 0.001 %
+      uint32_t p = (uint32_t)(pct1000 / 1000);
+      uint32_t a = v.toc[p > 99 ? 99 : p];
+      uint32_t b = p < 99 ? v.toc[p + 1] : 256;
+      uint64_t pos256 = a * 1000 + (b - a) * (pct1000 % 1000);
+      offset = first + pos256 * (end - first) / 256000;
+      if (offset < start) offset = start;
+    } else if (v.frames) {
+      offset = start + (uint64_t)frame * span / total;
+    } else {
+      offset = start + (uint64_t)frame * cbrNum / cbrDen;
+    }
+    out.offsets[i] = (uint32_t)(offset < end ? offset : end);
+  }
+
+  out.h.totalFrames = total;
+  out.h.framesPerEntry = fpe;
+  out.h.entries = (uint16_t)entries;
+  out.h.audioEnd = end;
+}
+
+uint32_t Mp3Indexer::frameOffset(const Mp3Index& index, uint32_t frame) {
+  if (!index.h.entries) return 0;
+  if (frame >= index.h.totalFrames) return index.h.audioEnd;
+
+  uint32_t entry = frame / index.h.framesPerEntry;
+  if (entry >= index.h.entries) entry = index.h.entries - 1;
+  uint32_t pos = index.offsets[entry];
+  uint32_t f = entry * index.h.framesPerEntry;
+
+  // Estimated points may fall inside a frame: move to the next real one
+  Mp3FrameHeader fh;
+  if (!(index.h.flags & MP3_INDEX_EXACT)) {
+    uint32_t synced = sync(pos, pos + RESYNC_BYTES, fh);
+    if (synced == UINT32_MAX) return pos;
+    pos = synced;
+  }
+
+  while (f < frame) {
+    if (!headerAt(pos, fh)) {
+      uint32_t next = sync(pos + 1, pos + RESYNC_BYTES, fh);
+      if (next == UINT32_MAX) break;
+      pos = next;
+    }
+    pos += fh.frameBytes;
+    f++;
+  }
+  return pos;
+}
+
+uint32_t Mp3Indexer::selfContainedFrame(const Mp3Index& index, uint32_t frame,
+                                        uint32_t maxBack, uint32_t* offset) {
+  if (frame >= index.h.totalFrames) return UINT32_MAX;
+  uint32_t f = frame > maxBack ? frame - maxBack : 0;
+  uint32_t pos = frameOffset(index, f);
+  uint32_t found = UINT32_MAX;
+  Mp3FrameHeader fh;
+  for (; f <= frame; f++) {
+    // Header, CRC if the protection bit is clear, first side info bytes
+    const uint8_t* p = at(pos, 8);
+    if (!p || !parseMp3Header(p, fh)) break;
+    const uint8_t* side = p + ((p[1] & 1) ? 4 : 6);
+    uint32_t mainDataBegin = fh.mpeg1 ? (side[0] << 1 | side[1] >> 7) : side[0];
+    if (mainDataBegin == 0) {
+      found = f;
+      *offset = pos;
+    }
+    pos += fh.frameBytes;
+  }
+  return found;
+}
@@ -1,11 +1,22 @@
 #include "../../include/gateway_esp32/mqtt_manager.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 MQTTManager* MQTTManager::instance = nullptr;
 
 MQTTManager::MQTTManager()
-    : client(nullptr), firstConnection(true), lastReconnectAttempt(0) {
+    : client(nullptr),
+      firstConnection(true),
+      lastReconnectAttempt(0),
+      dispatchCount(0),
+      dispatchUsTotal(0),
+      dispatchUsMax(0),
+      owner(NULL),
+      connectedState(false),
+      outbox(NULL),
+      outboxDrops(0) {
   instance = this;
 }
 
@@ -18,6 +29,10 @@ void MQTTManager::begin(PubSubClient* mqttClient, const String& clientID,
   clientId = clientID;
   this->statusTopic = statusTopic;
   firstConnection = true;
+  if (!outbox) {
+    outbox = xQueueCreateStatic(MQTT_OUTBOX_SLOTS, sizeof(MqttOutboxMessage),
+                                outboxStorage, &outboxStruct);
+  }
   Serial.println("[MQTTManager] Initialized");
 }
 
@@ -58,64 +73,59 @@ void MQTTManager::unregisterHandler(const String& topicPattern) {
   }
 }
 
-bool MQTTManager::topicMatches(const String& pattern, const String& topic) {
+// End of the topic level starting at s (the next '/' or the terminator)
+static const char* levelEnd(const char* s) {
+  while (*s && *s != '/') s++;
+  return s;
+}
+
+bool MQTTManager::topicMatches(const char* pattern, const char* topic) {
   // MQTT wildcard matching
   // + = single level wildcard (e.g., "smartalarm/+/temp")
   // # = multi-level wildcard (e.g., "smartalarm/#")
+  // Works on the raw strings level by level, nothing is copied
 
   // Exact match - fast path
-  if (pattern == topic) return true;
+  if (strcmp(pattern, topic) == 0) return true;
 
   // No wildcards - exact match only
-  if (pattern.indexOf('+') == -1 && pattern.indexOf('#') == -1) {
-    return false;
-  }
-
-  // Split by '/' and compare level by level
-  int patternIdx = 0, topicIdx = 0;
-  int patternLen = pattern.length(), topicLen = topic.length();
-
-  while (patternIdx < patternLen && topicIdx < topicLen) {
-    // Check for multi-level wildcard
-    if (pattern[patternIdx] == '#') {
-      // # must be last character or followed by '/'
-      if (patternIdx == patternLen - 1 || pattern[patternIdx + 1] == '/') {
-        return true;  // # matches everything remaining
-      }
+  if (!strpbrk(pattern, "+#")) return false;
+
+  const char* p = pattern;
+  const char* t = topic;
+  for (;;) {
+    // # must be last character or followed by '/'
+    if (p[0] == '#' && (p[1] == '\0' || p[1] == '/')) {
+      return true;  // # matches everything remaining
     }
 
     // Find next separator
-    int patternSep = pattern.indexOf('/', patternIdx);
-    int topicSep = topic.indexOf('/', topicIdx);
-
-    if (patternSep == -1) patternSep = patternLen;
-    if (topicSep == -1) topicSep = topicLen;
-
-    String patternLevel = pattern.substring(patternIdx, patternSep);
-    String topicLevel = topic.substring(topicIdx, topicSep);
-
-    // Single level wildcard
-    if (patternLevel == "+") {
-      // Matches any single level
-    }
-    // Exact match required
-    else if (patternLevel != topicLevel) {
+    const char* pEnd = levelEnd(p);
+    const char* tEnd = levelEnd(t);
+    size_t pLen = pEnd - p;
+    size_t tLen = tEnd - t;
+
+    // Single level wildcard matches any level, otherwise exact match
+    bool wildcard = pLen == 1 && p[0] == '+';
+    if (!wildcard && (pLen != tLen || strncmp(p, t, pLen) != 0)) {
       return false;
     }
 
-    // Move to next level
-    patternIdx = patternSep + 1;
-    topicIdx = topicSep + 1;
-  }
+    // Topic consumed: a trailing "/#" also matches its parent level
+    if (!*tEnd) return !*pEnd || strcmp(pEnd, "/#") == 0;
+    if (!*pEnd) return false;
 
-  // Both should be fully consumed
-  return patternIdx >= patternLen && topicIdx >= topicLen;
+    // Move to next level (possibly an empty one after a trailing '/')
+    p = pEnd + 1;
+    t = tEnd + 1;
+  }
 }
 
 void MQTTManager::dispatch(const char* topic, byte* payload,
                            unsigned int length) {
   // Serial.printf... (Optional: Comment out to save CPU during high speed
   // transfer)
+  uint32_t startUs = micros();
 
   // --- FAST PATH OPTIMIZATION START ---
   // Check for high-frequency audio topic using raw C-string comparison.
@@ -125,18 +135,18 @@ void MQTTManager::dispatch(const char* topic, byte* payload,
     for (auto& handler : handlers) {
       if (handler.topicPattern.equals("esp32/audio_chunk")) {
         handler.callback(*this, topic, payload, length);
+        finishDispatch(startUs);
         return;  // Done! No Strings created.
       }
     }
   }
   // --- FAST PATH OPTIMIZATION END ---
 
-  String topicStr = String(topic);
   bool handled = false;
 
   // Try each handler in priority order
   for (auto& handler : handlers) {
-    if (topicMatches(handler.topicPattern, topicStr)) {
+    if (topicMatches(handler.topicPattern.c_str(), topic)) {
       // Debug only for non-audio topics to keep logs clean
       if (length < 100) {
         Serial.printf("[MQTTManager] → Match: '%s'\n", handler.name.c_str());
@@ -150,9 +160,20 @@ void MQTTManager::dispatch(const char* topic, byte* payload,
   }
 
   if (!handled) {
-    Serial.printf("[MQTTManager] ⚠ No handler processed topic: %s\n",
-                  topicStr.c_str());
+    Serial.printf("[MQTTManager] ⚠ No handler processed topic: %s\n", topic);
   }
+
+  finishDispatch(startUs);
+}
+
+void MQTTManager::finishDispatch(uint32_t startUs) {
+  // Everything the handlers took from the arena dies with the message
+  arena.reset();
+
+  uint32_t us = micros() - startUs;
+  dispatchCount++;
+  dispatchUsTotal += us;
+  if (us > dispatchUsMax) dispatchUsMax = us;
 }
 
 void MQTTManager::globalCallback(char* topic, byte* payload,
@@ -210,21 +231,31 @@ bool MQTTManager::publish(const String& topic, const String& message,
 
 bool MQTTManager::publish(const String& topic, const char* message,
                           bool retain) {
+  return publish(topic.c_str(), message, retain);
+}
+
+bool MQTTManager::publish(const char* topic, const char* message,
+                          bool retain) {
+  if (!ownsClient()) {
+    return enqueue(topic, (const byte*)message, strlen(message), retain);
+  }
   if (client && client->connected()) {
-    bool result = client->publish(topic.c_str(), message, retain);
+    bool result = client->publish(topic, message, retain);
     if (!result) {
-      Serial.printf("[MQTTManager] ✗ Failed to publish to '%s'\n",
-                    topic.c_str());
+      Serial.printf("[MQTTManager] ✗ Failed to publish to '%s'\n", topic);
     }
     return result;
   }
   Serial.printf("[MQTTManager] Cannot publish to '%s': not connected\n",
-                topic.c_str());
+                topic);
   return false;
 }
 
 bool MQTTManager::publish(const String& topic, byte* payload,
                           unsigned int length, bool retain) {
+  if (!ownsClient()) {
+    return enqueue(topic.c_str(), payload, length, retain);
+  }
   if (client && client->connected()) {
     bool result = client->publish(topic.c_str(), payload, length, retain);
     if (!result) {
@@ -238,7 +269,72 @@ bool MQTTManager::publish(const String& topic, byte* payload,
   return false;
 }
 
-bool MQTTManager::isConnected() const { return client && client->connected(); }
+bool MQTTManager::isConnected() const {
+  if (!ownsClient()) return connectedState;
+  return client && client->connected();
+}
+
+// ============================================================================
+// Outbox - Publishes from tasks other than the client's owner
+// ============================================================================
+
+void MQTTManager::claimClient() {
+  owner = xTaskGetCurrentTaskHandle();
+  Serial.printf("[MQTTManager] Client owned by task '%s'\n",
+                pcTaskGetName(owner));
+}
+
+bool MQTTManager::ownsClient() const {
+  // Before claimClient() only setup() runs, so it may use the client
+  return owner == NULL || owner == xTaskGetCurrentTaskHandle();
+}
+
+bool MQTTManager::enqueue(const char* topic, const byte* payload,
+                          unsigned int length, bool retain) {
+  // Same answer as a direct publish while the broker is away, rather than
+  // filling the outbox with messages that would go out stale
+  if (!outbox || !connectedState) {
+    outboxDrops++;
+    Serial.printf("[MQTTManager] ⚠ Dropped publish to '%s'\n", topic);
+    return false;
+  }
+  if (strlen(topic) >= MQTT_OUTBOX_TOPIC_SIZE ||
+      length > MQTT_OUTBOX_PAYLOAD_SIZE) {
+    outboxDrops++;
+    Serial.printf("[MQTTManager] ✗ Publish to '%s' too large for the outbox "
+                  "(%u bytes)\n",
+                  topic, length);
+    return false;
+  }
+
+  MqttOutboxMessage msg;
+  strcpy(msg.topic, topic);
+  memcpy(msg.payload, payload, length);
+  msg.length = (uint16_t)length;
+  msg.retain = retain;
+  if (xQueueSend(outbox, &msg, 0) != pdTRUE) {
+    outboxDrops++;
+    Serial.printf("[MQTTManager] ⚠ Outbox full, dropped '%s'\n", topic);
+    return false;
+  }
+  return true;
+}
+
+void MQTTManager::flushOutbox() {
+  if (!outbox) return;
+  MqttOutboxMessage msg;
+  while (xQueueReceive(outbox, &msg, 0) == pdTRUE) {
+    if (!client || !client->connected()) {
+      outboxDrops++;  // Stale by the time the broker is back
+      continue;
+    }
+    if (!client->publish(msg.topic, (const uint8_t*)msg.payload, msg.length,
+                         msg.retain)) {
+      outboxDrops++;
+      Serial.printf("[MQTTManager] ✗ Failed to publish to '%s'\n", msg.topic);
+    }
+  }
+}
 
 // ============================================================================
 // Connection Management
@@ -316,4 +412,5 @@ void MQTTManager::loop() {
     // Process MQTT messages
     client->loop();
   }
+  connectedState = client->connected();
 }
@@ -4,7 +4,14 @@
 #include <WiFi.h>
 
 #include "../../include/gateway_esp32/audio_manager.h"
+#include "../../include/gateway_esp32/buffer_pool.h"
+#include "../../include/gateway_esp32/mesh_stats.h"
 #include "../../include/gateway_esp32/mqtt_manager.h"
+#include "../../include/gateway_esp32/node_ota_manager.h"
+#include "../../include/gateway_esp32/ota_manager.h"
+#include "../../include/gateway_esp32/rtos_tasks.h"
+#include "../../include/gateway_esp32/rule_manager.h"
+#include "../../include/gateway_esp32/sensor_analytics.h"
 #include "../../include/shared/config.h"
 #include "../../include/shared/sensor_data.h"
 
@@ -13,8 +20,14 @@ extern WiFiClient wifiClient;
 extern PubSubClient mqttClient;
 extern MQTTManager mqtt;
 extern AudioManager audio;
-extern SensorData remoteSensorData;
-extern bool remoteSensorDataAvailable;
+extern BufferPool bufferPool;
+extern NodeOtaManager nodeOta;
+extern OtaManager gatewayOta;
+extern RuleManager ruleManager;
+extern MeshStats meshStats;
+extern SensorAnalytics sensorAnalytics;
+extern NodeAnalyticsTable remoteAnalytics;
+extern portMUX_TYPE sensorAnalyticsLock;
 
 // MQTT Topics are now included via config.h
 
@@ -41,12 +54,13 @@ void setupMQTTHandlers() {
       "smartalarm/play_audio",
       [](MQTTManager& mqtt, const char* topic, byte* payload,
          unsigned int length) -> bool {
-        String filename((char*)payload, length);
-        if (!filename.startsWith("/")) {
-          filename = "/" + filename;
-        }
+        MessageArena& arena = mqtt.scratch();
+        const char* filename =
+            length > 0 && payload[0] == '/'
+                ? arena.copy((const char*)payload, length)
+                : arena.format("/%.*s", (int)length, (const char*)payload);
 
-        bool success = audio.playFile(filename.c_str());
+        bool success = filename && audio.playFile(filename);
         mqtt.publish("smartalarm/audio/status", success ? "playing" : "error");
 
         return true;
@@ -61,14 +75,16 @@ void setupMQTTHandlers() {
       "smartalarm/commands",
       [](MQTTManager& mqtt, const char* topic, byte* payload,
          unsigned int length) -> bool {
-        String message((char*)payload, length);
-        message.toLowerCase();
+        MessageArena& arena = mqtt.scratch();
+        char* message = arena.copy((const char*)payload, length);
+        if (!message) return false;
+        for (char* c = message; *c; c++) *c = tolower(*c);
 
-        if (message == "stop_audio") {
+        if (strcmp(message, "stop_audio") == 0) {
           audio.stop();
           mqtt.publish("smartalarm/status", "audio_stopped");
           return true;
-        } else if (message == "list_files") {
+        } else if (strcmp(message, "list_files") == 0) {
           String fileList = audio.getFileList();
           if (fileList.length() > 0) {
             mqtt.publish("smartalarm/files", fileList);
@@ -77,29 +93,170 @@ void setupMQTTHandlers() {
             mqtt.publish("smartalarm/status", "no_files");
           }
           return true;
-        } else if (message.startsWith("volume=")) {
-          float vol = message.substring(7).toFloat();
+        } else if (strncmp(message, "volume=", 7) == 0) {
+          float vol = atof(message + 7);
           audio.setVolume(vol);
-          mqtt.publish("smartalarm/status", "volume:" + String(vol, 2));
+          mqtt.publish("smartalarm/status", arena.format("volume:%.2f", vol));
           return true;
-        } else if (message.startsWith("play:")) {
-          String filename = message.substring(5);
-          if (!filename.startsWith("/")) {
-            filename = "/" + filename;
-          }
-          bool success = audio.playFile(filename.c_str());
+        } else if (strncmp(message, "hpf=", 4) == 0) {
+          // Speaker protection high-pass corner, 0 turns it off
+          float hz = atof(message + 4);
+          audio.setHighPass(hz);
+          mqtt.publish("smartalarm/status", arena.format("hpf:%.0f", hz));
+          return true;
+        } else if (strncmp(message, "eq=", 3) == 0) {
+          // eq=<band>,<peak|low|high|off>,<hz>,<gain_db>,<q>
+          int band = -1;
+          char kind[8] = "";
+          float hz = 0, gainDb = 0, q = 0.707f;
+          sscanf(message + 3, "%d,%7[a-z],%f,%f,%f", &band, kind, &hz, &gainDb,
+                 &q);
+          DspBandType type = strcmp(kind, "peak") == 0   ? DSP_BAND_PEAK
+                             : strcmp(kind, "low") == 0  ? DSP_BAND_LOW_SHELF
+                             : strcmp(kind, "high") == 0 ? DSP_BAND_HIGH_SHELF
+                                                         : DSP_BAND_OFF;
+          bool success = (type != DSP_BAND_OFF || strcmp(kind, "off") == 0) &&
+                         audio.setEqBand(band, type, hz, gainDb, q);
+          mqtt.publish("smartalarm/status",
+                       success ? arena.format("eq:%d", band) : "error");
+          return true;
+        } else if (strncmp(message, "limit=", 6) == 0) {
+          // Limiter ceiling in dBFS (0 or below)
+          float dbfs = atof(message + 6);
+          audio.setLimiter(dbfs);
+          mqtt.publish("smartalarm/status", arena.format("limit:%.1f", dbfs));
+          return true;
+        } else if (strncmp(message, "latency=", 8) == 0) {
+          // latency=<low|balanced|robust>[,fixed]: output buffering, and
+          // whether underruns may switch to deeper profiles
+          char* name = message + 8;
+          char* option = strchr(name, ',');
+          if (option) *option++ = '\0';
+          LatencyProfile profile;
+          bool success = latencyProfileByName(name, &profile) &&
+                         (!option || strcmp(option, "fixed") == 0);
+          if (success) audio.setLatencyProfile(profile, !option);
+          mqtt.publish("smartalarm/status",
+                       success ? arena.format("latency:%s", name) : "error");
+          return true;
+        } else if (strncmp(message, "play:", 5) == 0) {
+          const char* filename = message + 5;
+          if (filename[0] != '/') filename = arena.format("/%s", filename);
+          bool success = filename && audio.playFile(filename);
           mqtt.publish("smartalarm/status", success ? "playing" : "error");
           return true;
-        } else if (message == "status") {
-          String status = "online|audio:";
-          if (audio.playing()) {
-            status += "playing";
+        } else if (strncmp(message, "play_at=", 8) == 0) {
+          // play_at=<unix_ms>,<file>: every gateway that gets it starts the
+          // file at that instant on the shared clock, to the sample
+          char* filename = strchr(message + 8, ',');
+          if (filename) *filename++ = '\0';
+          int64_t startMs = strtoll(message + 8, nullptr, 10);
+          if (filename && filename[0] != '/') {
+            filename = arena.format("/%s", filename);
+          }
+          bool success = filename && startMs > 0 &&
+                         audio.playFileAt(filename, startMs);
+          mqtt.publish("smartalarm/status", success ? "scheduled" : "error");
+          return true;
+        } else if (strncmp(message, "seek=", 5) == 0) {
+          // Restart the current track at the given second
+          uint32_t ms = (uint32_t)(atof(message + 5) * 1000);
+          bool success = audio.seek(ms);
+          mqtt.publish("smartalarm/status",
+                       success ? arena.format("seek:%u", (unsigned)ms)
+                               : "error");
+          return true;
+        } else if (strcmp(message, "resume") == 0) {
+          // Track stopped by snooze, stop_audio or a power loss
+          bool success = audio.resume();
+          mqtt.publish("smartalarm/status", success ? "playing" : "no_resume");
+          return true;
+        } else if (strncmp(message, "loudness:", 9) == 0) {
+          // (Re)measure a file's loudness in the background
+          const char* filename = message + 9;
+          if (filename[0] != '/') filename = arena.format("/%s", filename);
+          if (filename) audio.queueLoudness(filename);
+          mqtt.publish("smartalarm/status",
+                       filename ? "loudness_queued" : "error");
+          return true;
+        } else if (strncmp(message, "transcode:", 10) == 0) {
+          // (Re)make a file's low-CPU sidecar in the background
+          const char* filename = message + 10;
+          if (filename[0] != '/') filename = arena.format("/%s", filename);
+          if (filename) audio.queueTranscode(filename);
+          mqtt.publish("smartalarm/status",
+                       filename ? "transcode_queued" : "error");
+          return true;
+        } else if (strncmp(message, "file_info:", 10) == 0) {
+          // Duration and seek index of one file
+          const char* filename = message + 10;
+          if (filename[0] != '/') filename = arena.format("/%s", filename);
+          char* json = (char*)arena.alloc(384);
+          if (filename && json && audio.fileInfoJson(filename, json, 384) > 0) {
+            mqtt.publish("smartalarm/files/info", json);
           } else {
-            status += "stopped";
+            mqtt.publish("smartalarm/status", "error");
+          }
+          return true;
+        } else if (strcmp(message, "status") == 0) {
+          const char* status = arena.format(
+              "online|audio:%s|volume:%.2f|wifi:%ddBm|dispatch:%u/%uus|"
+              "arena:%u/%uB,%u_fallbacks|outbox_drops:%u",
+              audio.playing() ? "playing" : "stopped", audio.getVolume(),
+              WiFi.RSSI(), (unsigned)mqtt.getDispatchAvgUs(),
+              (unsigned)mqtt.getDispatchMaxUs(), (unsigned)arena.highWater(),
+              (unsigned)MESSAGE_ARENA_SIZE, (unsigned)arena.fallbacks(),
+              (unsigned)mqtt.getOutboxDrops());
+          mqtt.publish("smartalarm/status", status ? status : "online");
+          return true;
+        } else if (strcmp(message, "buffers") == 0) {
+          // Transfer pool occupancy and bounce copies
+          char* json = (char*)arena.alloc(192);
+          if (json && bufferPool.toJson(json, 192) > 0) {
+            mqtt.publish("smartalarm/status/buffers", json);
+          }
+          return true;
+        } else if (strcmp(message, "pcm") == 0) {
+          // Decode-ahead ring fill level, underruns and decode bursts
+          char* json = (char*)arena.alloc(256);
+          if (json && audio.pcmStatsJson(json, 256) > 0) {
+            mqtt.publish("smartalarm/status/pcm", json);
+          }
+          return true;
+        } else if (strcmp(message, "decode") == 0) {
+          // Variant of the playing track (MP3 or sidecar) and its CPU share
+          char* json = (char*)arena.alloc(256);
+          if (json && audio.decodeStatsJson(json, 256) > 0) {
+            mqtt.publish("smartalarm/status/decode", json);
+          }
+          return true;
+        } else if (strcmp(message, "latency") == 0) {
+          // Active latency profile, DMA and ring depth, automatic switches
+          char* json = (char*)arena.alloc(256);
+          if (json && audio.latencyStatsJson(json, 256) > 0) {
+            mqtt.publish("smartalarm/status/latency", json);
+          }
+          return true;
+        } else if (strcmp(message, "sync") == 0) {
+          // Shared clock (role, beacon error, skew) and scheduled playout
+          char* json = (char*)arena.alloc(384);
+          if (json && audio.syncStatsJson(json, 384) > 0) {
+            mqtt.publish("smartalarm/status/sync", json);
+          }
+          return true;
+        } else if (strcmp(message, "dsp") == 0) {
+          // Cycles per frame of each output DSP stage and CPU headroom
+          char* json = (char*)arena.alloc(320);
+          if (json && audio.dspStatsJson(json, 320) > 0) {
+            mqtt.publish("smartalarm/status/dsp", json);
+          }
+          return true;
+        } else if (strcmp(message, "deadlines") == 0) {
+          // Per-task iteration counts, overruns and worst-case response
+          char* json = (char*)arena.alloc(896);
+          if (json && deadlineMonitor.toJson(json, 896) > 0) {
+            mqtt.publish(MQTT_TOPIC_DEADLINES, json);
           }
-          status += "|volume:" + String(audio.getVolume(), 2);
-          status += "|wifi:" + String(WiFi.RSSI()) + "dBm";
-          mqtt.publish("smartalarm/status", status);
           return true;
         }
 
@@ -110,11 +267,20 @@ void setupMQTTHandlers() {
   // Register AudioManager's own handlers
   audio.registerMQTTHandlers(mqtt);
 
+  // Sensor node firmware distribution over ESP-NOW
+  nodeOta.registerMQTTHandlers(mqtt);
+
+  // Gateway firmware updates (full image or delta)
+  gatewayOta.registerMQTTHandlers(mqtt);
+
+  // Local automation rules
+  ruleManager.registerMQTTHandlers(mqtt);
+
   Serial.println("[MQTT] Handler registration complete\n");
 }
 
-void publishRemoteSensorData() {
-  if (!mqtt.isConnected() || !remoteSensorDataAvailable) {
+void publishRemoteSensorData(const SensorData& data, uint8_t nodeId) {
+  if (!mqtt.isConnected()) {
     return;
   }
 
@@ -124,11 +290,11 @@ void publishRemoteSensorData() {
   char uvStr[10];
   char battStr[5];
 
-  dtostrf(remoteSensorData.temperature, 6, 2, tempStr);
-  dtostrf(remoteSensorData.humidity, 6, 2, humStr);
-  dtostrf(remoteSensorData.pressure, 7, 2, pressStr);
-  dtostrf(remoteSensorData.uvIndex, 5, 2, uvStr);
-  snprintf(battStr, sizeof(battStr), "%d", remoteSensorData.batteryLevel);
+  dtostrf(data.temperature, 6, 2, tempStr);
+  dtostrf(data.humidity, 6, 2, humStr);
+  dtostrf(data.pressure, 7, 2, pressStr);
+  dtostrf(data.uvIndex, 5, 2, uvStr);
+  snprintf(battStr, sizeof(battStr), "%d", data.batteryLevel);
 
   mqtt.publish(MQTT_TOPIC_REMOTE_TEMP, tempStr);
   mqtt.publish(MQTT_TOPIC_REMOTE_HUMIDITY, humStr);
@@ -137,8 +303,50 @@ void publishRemoteSensorData() {
   mqtt.publish(MQTT_TOPIC_REMOTE_BATTERY, battStr);
 
   // Publish status with device name
-  String statusMsg = String(remoteSensorData.deviceName) + " online";
+  String statusMsg = String(data.deviceName) + " online";
   mqtt.publish(MQTT_TOPIC_REMOTE_STATUS, statusMsg);
 
+  // Derived metrics of the node that sent the sample, from a snapshot so
+  // the ESP-NOW callback is not held up while formatting
+  SensorAnalytics snapshot;
+  bool found = false;
+  char json[640];
+  portENTER_CRITICAL(&sensorAnalyticsLock);
+  const SensorAnalytics* node = remoteAnalytics.find(nodeId);
+  if (node) {
+    snapshot = *node;
+    found = true;
+  }
+  portEXIT_CRITICAL(&sensorAnalyticsLock);
+  if (found && snapshot.toJson(json, sizeof(json)) > 0) {
+    mqtt.publish(MQTT_TOPIC_REMOTE_ANALYTICS, json);
+  }
+
   Serial.println("[MQTT] → Remote sensor data forwarded to MQTT broker");
-}
\ No newline at end of file
+}
+
+void publishGatewayAnalytics() {
+  if (!mqtt.isConnected()) {
+    return;
+  }
+
+  SensorAnalytics snapshot;
+  char json[384];
+  portENTER_CRITICAL(&sensorAnalyticsLock);
+  snapshot = sensorAnalytics;
+  portEXIT_CRITICAL(&sensorAnalyticsLock);
+  if (snapshot.toJson(json, sizeof(json)) > 0) {
+    mqtt.publish(MQTT_TOPIC_GATEWAY_ANALYTICS, json);
+  }
+}
+
+void publishMeshStats() {
+  if (!mqtt.isConnected()) {
+    return;
+  }
+
+  char json[384];
+  if (meshStats.toJson(json, sizeof(json)) > 0) {
+    mqtt.publish(MQTT_TOPIC_MESH_STATS, json);
+  }
+}
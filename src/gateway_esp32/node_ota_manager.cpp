@@ -0,0 +1,365 @@
+#include "../../include/gateway_esp32/node_ota_manager.h"
+
+#include <esp_now.h>
+#include <mbedtls/sha256.h>
+#include <stdarg.h>
+
+#define TOPIC_NODE_OTA "smartalarm/node_ota"
+#define TOPIC_NODE_OTA_STATUS "smartalarm/node_ota/status"
+#define NODE_OTA_REPORT_SIZE 128  // report() lines, from the node OTA task
+
+static_assert(NODE_OTA_REPORT_SIZE <= MQTT_OUTBOX_PAYLOAD_SIZE,
+              "Node OTA reports must fit an MQTT outbox slot");
+
+static const uint8_t otaBroadcastAddress[] = {0xFF, 0xFF, 0xFF,
+                                              0xFF, 0xFF, 0xFF};
+
+NodeOtaManager::NodeOtaManager()
+    : sdManager(nullptr),
+      mqttManager(nullptr),
+      active(false),
+      sessionId(0),
+      imageSize(0),
+      chunkCount(0),
+      lock(portMUX_INITIALIZER_UNLOCKED) {
+  memset(imageHash, 0, sizeof(imageHash));
+  memset(nodes, 0, sizeof(nodes));
+}
+
+void NodeOtaManager::setSDManager(SDManager* sd) { sdManager = sd; }
+
+void NodeOtaManager::setMQTTManager(MQTTManager* mqtt) { mqttManager = mqtt; }
+
+void NodeOtaManager::registerMQTTHandlers(MQTTManager& mqtt) {
+  mqtt.registerHandler(
+      TOPIC_NODE_OTA,
+      [this](MQTTManager& mqtt, const char* topic, byte* payload,
+             unsigned int length) -> bool {
+        MessageArena& arena = mqtt.scratch();
+        const char* filename =
+            length > 0 && payload[0] == '/'
+                ? arena.copy((const char*)payload, length)
+                : arena.format("/%.*s", (int)length, (const char*)payload);
+        if (!filename || !start(filename)) {
+          mqtt.publish(TOPIC_NODE_OTA_STATUS, "busy");
+        }
+        return true;
+      },
+      "NodeOTA", 120);
+}
+
+// ============================================================================
+// Session Control
+// ============================================================================
+
+bool NodeOtaManager::start(const char* filename) {
+  if (active) {
+    Serial.println("[NodeOTA] Transfer already in progress");
+    return false;
+  }
+  if (!sdManager || !sdManager->isReady()) {
+    Serial.println("[NodeOTA] SD manager not ready");
+    return false;
+  }
+
+  imagePath = filename;
+  active = true;
+
+  // Core 0 next to the WiFi stack, below MQTT so the broker link stays alive
+  if (xTaskCreatePinnedToCore(taskEntry, "NodeOTA", NODE_OTA_STACK_SIZE, this,
+                              tskIDLE_PRIORITY + 1, NULL, 0) != pdPASS) {
+    Serial.println("[NodeOTA] ✗ Failed to create transfer task");
+    active = false;
+    return false;
+  }
+  return true;
+}
+
+void NodeOtaManager::taskEntry(void* parameter) {
+  NodeOtaManager* self = static_cast<NodeOtaManager*>(parameter);
+  self->run();
+  self->active = false;
+  vTaskDelete(NULL);
+}
+
+void NodeOtaManager::run() {
+  File f = sdManager->openForRead(imagePath.c_str());
+  if (!f) {
+    report("error:not_found:%s", imagePath.c_str());
+    return;
+  }
+
+  imageSize = f.size();
+  chunkCount = nodeOtaChunkCount(imageSize);
+  if (imageSize == 0 || !hashImage(f)) {
+    f.close();
+    report("error:read_failed");
+    return;
+  }
+
+  portENTER_CRITICAL(&lock);
+  memset(nodes, 0, sizeof(nodes));
+  sessionId = (uint8_t)(esp_random() | 1);
+  portEXIT_CRITICAL(&lock);
+
+  Serial.printf("[NodeOTA] %s: %u bytes, %u chunks, session %u\n",
+                imagePath.c_str(), imageSize, chunkCount, sessionId);
+
+  // Announce a few times; every node that accepts answers with a status
+  for (int i = 0; i < 3; i++) {
+    sendControl(NODE_OTA_ANNOUNCE);
+    vTaskDelay(pdMS_TO_TICKS(NODE_OTA_JOIN_WAIT_MS / 3));
+  }
+
+  int joined = countNodes(NODE_OTA_RECEIVING);
+  if (joined == 0) {
+    f.close();
+    report("error:no_nodes");
+    return;
+  }
+  report("started:%d_nodes", joined);
+
+  unsigned long startMs = millis();
+  uint32_t chunksSent = 0;
+  int lastPct = 0;
+
+  uint16_t w = 0;
+  while (w < chunkCount) {
+    uint16_t mask = nodeOtaWindowMask(w, chunkCount);
+    uint16_t behind = w;
+    int rounds = 0;
+
+    while (mask && countNodes(NODE_OTA_RECEIVING) > 0) {
+      if (!sendChunks(f, w, mask)) {
+        f.close();
+        sendAbort();
+        report("error:read_failed");
+        return;
+      }
+      chunksSent += __builtin_popcount(mask);
+      mask = pollWindow(w, &behind);
+      if (behind < w) break;
+
+      if (++rounds > 50) {
+        f.close();
+        sendAbort();
+        report("error:window_%u_stalled", w);
+        return;
+      }
+    }
+
+    if (countNodes(NODE_OTA_RECEIVING) == 0) break;
+
+    // A node still in an earlier window drops every chunk of this one, so
+    // go back to its window; nodes further on ignore the repeats
+    if (behind < w) {
+      Serial.printf("[NodeOTA] ⚠ A node is behind at chunk %u, resending\n",
+                    behind);
+      w = behind;
+      continue;
+    }
+
+    // Progress roughly every 10%
+    uint32_t done = min((uint32_t)w + NODE_OTA_WINDOW, (uint32_t)chunkCount);
+    int pct = 100 * done / chunkCount;
+    if (pct >= lastPct + 10 && done < chunkCount) {
+      report("progress:%d", pct);
+      lastPct = pct;
+    }
+    w += NODE_OTA_WINDOW;
+  }
+  f.close();
+
+  // Nodes verify the hash before switching images and report the result
+  for (int i = 0; i < 3; i++) {
+    sendControl(NODE_OTA_COMMIT);
+    vTaskDelay(pdMS_TO_TICKS(500));
+  }
+  vTaskDelay(pdMS_TO_TICKS(1500));
+
+  unsigned long elapsed = millis() - startMs;
+  report("done:verified=%d,failed=%d,ms=%lu,chunks=%u,overhead=%.2f",
+         countNodes(NODE_OTA_VERIFIED), countNodes(NODE_OTA_FAILED) +
+             countNodes(NODE_OTA_RECEIVING),
+         elapsed, chunksSent, (float)chunksSent / chunkCount);
+}
+
+bool NodeOtaManager::hashImage(File& f) {
+  uint8_t buf[512];
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts_ret(&ctx, 0);
+
+  f.seek(0);
+  size_t total = 0;
+  while (total < imageSize) {
+    int n = f.read(buf, sizeof(buf));
+    if (n <= 0) break;
+    mbedtls_sha256_update_ret(&ctx, buf, n);
+    total += n;
+  }
+  mbedtls_sha256_finish_ret(&ctx, imageHash);
+  mbedtls_sha256_free(&ctx);
+  return total == imageSize;
+}
+
+// ============================================================================
+// Frames
+// ============================================================================
+
+static void sendWithRetry(const uint8_t* data, size_t len) {
+  // Broadcasts are not acked; the only failure here is a full tx queue
+  for (int attempt = 0; attempt < 5; attempt++) {
+    if (esp_now_send(otaBroadcastAddress, data, len) == ESP_OK) return;
+    vTaskDelay(1);
+  }
+}
+
+void NodeOtaManager::sendControl(NodeOtaFrameType type, uint16_t windowStart) {
+  if (type == NODE_OTA_ANNOUNCE) {
+    NodeOtaAnnounce a;
+    a.header = {NODE_OTA_MAGIC, type, sessionId, 0};
+    a.imageSize = imageSize;
+    a.chunkCount = chunkCount;
+    memcpy(a.sha256, imageHash, sizeof(a.sha256));
+    sendWithRetry((const uint8_t*)&a, sizeof(a));
+  } else if (type == NODE_OTA_POLL) {
+    NodeOtaPoll p;
+    p.header = {NODE_OTA_MAGIC, type, sessionId, 0};
+    p.windowStart = windowStart;
+    sendWithRetry((const uint8_t*)&p, sizeof(p));
+  } else {
+    NodeOtaHeader h = {NODE_OTA_MAGIC, type, sessionId, 0};
+    sendWithRetry((const uint8_t*)&h, sizeof(h));
+  }
+}
+
+// sendWithRetry() only covers a full tx queue, so a lost ABORT would leave
+// nodes waiting for their silence timeout
+void NodeOtaManager::sendAbort() {
+  for (int i = 0; i < NODE_OTA_ABORT_REPEATS; i++) {
+    sendControl(NODE_OTA_ABORT);
+    vTaskDelay(pdMS_TO_TICKS(50));
+  }
+}
+
+bool NodeOtaManager::sendChunks(File& f, uint16_t windowStart, uint16_t mask) {
+  NodeOtaChunk chunk;
+  chunk.header = {NODE_OTA_MAGIC, NODE_OTA_CHUNK, sessionId, 0};
+  chunk.reserved = 0;
+
+  for (int i = 0; i < NODE_OTA_WINDOW; i++) {
+    if (!(mask & (1u << i))) continue;
+
+    uint16_t index = windowStart + i;
+    uint32_t offset = (uint32_t)index * NODE_OTA_CHUNK_SIZE;
+    size_t len = min((uint32_t)NODE_OTA_CHUNK_SIZE, imageSize - offset);
+
+    if (!f.seek(offset) || f.read(chunk.data, len) != (int)len) {
+      return false;
+    }
+    chunk.index = index;
+    chunk.length = len;
+
+    sendWithRetry((const uint8_t*)&chunk, sizeof(chunk));
+    vTaskDelay(pdMS_TO_TICKS(NODE_OTA_CHUNK_GAP_MS));
+  }
+  return true;
+}
+
+// Returns the union of chunks still missing in the window across all nodes.
+// Nodes that stay silent are polled again rather than triggering a resend,
+// and dropped after NODE_OTA_MAX_SILENT polls. *behind is set to the
+// earliest window a node reports below this one (windowStart if none).
+uint16_t NodeOtaManager::pollWindow(uint16_t windowStart, uint16_t* behind) {
+  uint16_t windowMask = nodeOtaWindowMask(windowStart, chunkCount);
+
+  for (int attempt = 0; attempt < NODE_OTA_MAX_SILENT; attempt++) {
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < NODE_OTA_MAX_NODES; i++) nodes[i].replied = false;
+    portEXIT_CRITICAL(&lock);
+
+    sendControl(NODE_OTA_POLL, windowStart);
+    vTaskDelay(pdMS_TO_TICKS(NODE_OTA_POLL_WAIT_MS));
+
+    uint16_t missing = 0;
+    int silent = 0;
+    *behind = windowStart;
+
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < NODE_OTA_MAX_NODES; i++) {
+      Participant& n = nodes[i];
+      if (!n.used || n.state != NODE_OTA_RECEIVING) continue;
+
+      if (n.replied) {
+        n.silentPolls = 0;
+        if (n.windowStart == windowStart) missing |= n.missingMask;
+        if (n.windowStart < *behind) *behind = n.windowStart;
+      } else if (++n.silentPolls >= NODE_OTA_MAX_SILENT) {
+        n.state = NODE_OTA_FAILED;
+      } else {
+        silent++;
+      }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (missing || silent == 0 || *behind < windowStart) {
+      return missing & windowMask;
+    }
+  }
+  return 0;
+}
+
+void NodeOtaManager::onStatus(const uint8_t* mac, const NodeOtaStatus& status) {
+  if (!active || status.header.sessionId != sessionId) return;
+
+  portENTER_CRITICAL(&lock);
+  Participant* slot = nullptr;
+  for (int i = 0; i < NODE_OTA_MAX_NODES; i++) {
+    if (nodes[i].used && memcmp(nodes[i].mac, mac, 6) == 0) {
+      slot = &nodes[i];
+      break;
+    }
+  }
+  if (!slot) {
+    for (int i = 0; i < NODE_OTA_MAX_NODES; i++) {
+      if (!nodes[i].used) {
+        slot = &nodes[i];
+        memcpy(slot->mac, mac, 6);
+        slot->used = true;
+        break;
+      }
+    }
+  }
+  if (slot && slot->state != NODE_OTA_FAILED) {
+    slot->nodeId = status.nodeId;
+    slot->state = status.state;
+    slot->windowStart = status.windowStart;
+    slot->missingMask = status.missingMask;
+    slot->replied = true;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+int NodeOtaManager::countNodes(uint8_t state) {
+  int count = 0;
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < NODE_OTA_MAX_NODES; i++) {
+    if (nodes[i].used && nodes[i].state == state) count++;
+  }
+  portEXIT_CRITICAL(&lock);
+  return count;
+}
+
+void NodeOtaManager::report(const char* fmt, ...) {
+  char msg[NODE_OTA_REPORT_SIZE];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, args);
+  va_end(args);
+
+  Serial.printf("[NodeOTA] %s\n", msg);
+  if (mqttManager) {
+    mqttManager->publish(TOPIC_NODE_OTA_STATUS, msg);
+  }
+}
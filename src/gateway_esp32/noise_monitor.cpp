@@ -0,0 +1,205 @@
+#include "../../include/gateway_esp32/noise_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FULL_SCALE_MEAN_SQ (1ull << 45)  // 24-bit full-scale sine
+#define FULL_SCALE_PEAK_SQ (1ull << 46)
+#define BAND_SHARE_BITS 12  // Q12 share of a block's energy per band
+
+static_assert(NOISE_BANDS == 4, "toJson() prints four bands");
+
+// Band edges in bins of 62.5 Hz
+static const uint8_t kBandStart[NOISE_BANDS + 1] = {1, 4, 16, 64,
+                                                    SPECTRUM_BINS - 1};
+
+static int32_t levelDb8(uint64_t power, uint64_t reference) {
+  return spectrumPowerDb8(power ? power : 1) - spectrumPowerDb8(reference);
+}
+
+// ============================================================================
+// ANALYZER
+// ============================================================================
+NoiseAnalyzer::NoiseAnalyzer() {
+  spectrumTables(twiddle, window);
+  reset();
+}
+
+void NoiseAnalyzer::reset() {
+  fill = 0;
+  energy = 0;
+  memset(bandEnergy, 0, sizeof(bandEnergy));
+  peak = 0;
+  frames = 0;
+}
+
+void NoiseAnalyzer::add(const int32_t* samples, uint32_t count) {
+  while (count) {
+    uint32_t n = NOISE_BLOCK - fill;
+    if (count < n) n = count;
+    memcpy(block + fill, samples, n * sizeof(int32_t));
+    fill += n;
+    samples += n;
+    count -= n;
+    if (fill == NOISE_BLOCK) {
+      analyzeBlock();
+      fill = 0;
+    }
+  }
+}
+
+void NoiseAnalyzer::analyzeBlock() {
+  uint64_t e = 0;
+  int32_t top = 0;
+  for (int i = 0; i < NOISE_BLOCK; i++) {
+    int32_t s = block[i];
+    e += (uint64_t)((int64_t)s * s);
+    int32_t a = s < 0 ? -s : s;
+    if (a > top) top = a;
+  }
+  energy += e;
+  frames += NOISE_BLOCK;
+  if (top > peak) peak = top;
+  if (!top) return;
+
+  // Windowed at full precision, then block-scaled to the FFT's 16 bits by
+  // the windowed peak (a click at a block edge is mostly windowed away)
+  int32_t wtop = 0;
+  for (int i = 0; i < NOISE_BLOCK; i++) {
+    int32_t w = (int32_t)(((int64_t)block[i] * window[i] + 0x4000) >> 15);
+    block[i] = w;
+    int32_t a = w < 0 ? -w : w;
+    if (a > wtop) wtop = a;
+  }
+  int down = 0, up = 0;
+  while ((wtop >> down) > 32767) down++;
+  while (!down && up < 15 && (wtop << (up + 1)) < 32768) up++;
+  for (int i = 0; i < NOISE_BLOCK; i++) {
+    scaled[i] = (int16_t)(down ? block[i] >> down : block[i] * (1 << up));
+  }
+  spectrumFft(scaled, twiddle, re, im);
+
+  uint64_t band[NOISE_BANDS];
+  uint64_t total = 0;
+  for (int b = 0; b < NOISE_BANDS; b++) {
+    band[b] = 0;
+    for (int k = kBandStart[b]; k < kBandStart[b + 1]; k++) {
+      band[b] += (uint64_t)((int64_t)re[k] * re[k] + (int64_t)im[k] * im[k]);
+    }
+    total += band[b];
+  }
+  if (!total) return;
+  // Each band's share of the spectrum, applied to the block's exact energy
+  for (int b = 0; b < NOISE_BANDS; b++) {
+    uint64_t share = (band[b] << BAND_SHARE_BITS) / total;
+    bandEnergy[b] += ((e >> 4) * share) >> (BAND_SHARE_BITS - 4);
+  }
+}
+
+NoiseLevels NoiseAnalyzer::levels() const {
+  NoiseLevels l;
+  uint32_t n = frames ? frames : 1;
+  l.rmsDb8 = levelDb8(energy / n, FULL_SCALE_MEAN_SQ);
+  l.peakDb8 = levelDb8((uint64_t)((int64_t)peak * peak), FULL_SCALE_PEAK_SQ);
+  for (int b = 0; b < NOISE_BANDS; b++) {
+    l.bandDb8[b] = levelDb8(bandEnergy[b] / n, FULL_SCALE_MEAN_SQ);
+  }
+  l.frames = frames;
+  return l;
+}
+
+// ============================================================================
+// DUTY CYCLE
+// ============================================================================
+NoiseMonitor::NoiseMonitor(ReadFn read, PowerFn power, ClockFn clockUs,
+                           void* ctx)
+    : readFn(read),
+      powerFn(power),
+      clockFn(clockUs),
+      ctx(ctx),
+      state(IDLE),
+      started(false),
+      firstMs(0),
+      windowStartMs(0),
+      phaseStartMs(0),
+      windowCount(0),
+      busyUs(0),
+      micOnMs(0) {
+  memset(&last, 0, sizeof(last));
+}
+
+bool NoiseMonitor::poll(uint32_t nowMs) {
+  if (!started) {
+    started = true;
+    firstMs = nowMs;
+    windowStartMs = nowMs - NOISE_PERIOD_MS;  // First window right away
+  }
+  // Between windows: nothing but this comparison
+  if (state == IDLE && nowMs - windowStartMs < NOISE_PERIOD_MS) return false;
+
+  uint32_t startUs = clockFn();
+  bool done = false;
+  switch (state) {
+    case IDLE:
+      powerFn(ctx, true);
+      windowStartMs = phaseStartMs = nowMs;
+      state = SETTLING;
+      break;
+
+    case SETTLING:
+      // Wake-up output of the microphone is dropped
+      while (readFn(ctx, chunk, NOISE_BLOCK)) {
+      }
+      if (nowMs - phaseStartMs >= NOISE_SETTLE_MS) {
+        analyzer.reset();
+        state = MEASURING;
+      }
+      break;
+
+    case MEASURING: {
+      uint32_t left = NOISE_WINDOW_FRAMES - analyzer.count();
+      size_t n;
+      while (left &&
+             (n = readFn(ctx, chunk, left < NOISE_BLOCK ? left : NOISE_BLOCK))) {
+        analyzer.add(chunk, n);
+        left -= n;
+      }
+      if (!left) {
+        powerFn(ctx, false);
+        last = analyzer.levels();
+        micOnMs += nowMs - windowStartMs;
+        windowCount++;
+        state = IDLE;
+        done = true;
+      }
+      break;
+    }
+  }
+  busyUs += clockFn() - startUs;
+  return done;
+}
+
+float NoiseMonitor::cpuDuty(uint32_t nowMs) const {
+  uint32_t elapsed = nowMs - firstMs;
+  return elapsed ? (float)busyUs / (elapsed * 1000.0f) : 0.0f;
+}
+
+float NoiseMonitor::micDuty(uint32_t nowMs) const {
+  uint32_t elapsed = nowMs - firstMs;
+  uint64_t on = micOnMs + (state != IDLE ? nowMs - windowStartMs : 0);
+  return elapsed ? (float)on / elapsed : 0.0f;
+}
+
+size_t NoiseMonitor::toJson(char* buf, size_t len, uint32_t nowMs) const {
+  const float spl = NOISE_SPL_OFFSET_DB;
+  int n = snprintf(buf, len,
+                   "{\"rms_db\":%.1f,\"peak_db\":%.1f,\"bands_db\":[%.1f,%.1f,"
+                   "%.1f,%.1f],\"windows\":%u,\"cpu_duty_pct\":%.3f,"
+                   "\"mic_duty_pct\":%.2f}",
+                   last.rmsDb8 / 8.0f + spl, last.peakDb8 / 8.0f + spl,
+                   last.bandDb8[0] / 8.0f + spl, last.bandDb8[1] / 8.0f + spl,
+                   last.bandDb8[2] / 8.0f + spl, last.bandDb8[3] / 8.0f + spl,
+                   (unsigned)windowCount, cpuDuty(nowMs) * 100.0f,
+                   micDuty(nowMs) * 100.0f);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,499 @@
+#include "../../include/gateway_esp32/ota_manager.h"
+
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <esp_image_format.h>
+#include <stdarg.h>
+
+#include "../../include/gateway_esp32/memory_map.h"
+
+#define TOPIC_OTA "smartalarm/gateway/ota"
+#define TOPIC_OTA_STATUS "smartalarm/gateway/ota/status"
+#define OTA_REPORT_SIZE 160  // report() lines, published from the OTA task
+
+static_assert(OTA_REPORT_SIZE <= MQTT_OUTBOX_PAYLOAD_SIZE,
+              "OTA reports must fit an MQTT outbox slot");
+
+// Special values sent through fullBlocks instead of a block index
+#define RING_END 0xFF
+#define RING_ABORT 0xFE
+
+uint8_t OtaManager::freeBlocksStorage[OTA_RING_BLOCKS];
+uint8_t OtaManager::fullBlocksStorage[OTA_RING_BLOCKS + 1];
+StaticQueue_t OtaManager::freeBlocksStruct;
+StaticQueue_t OtaManager::fullBlocksStruct;
+
+OtaManager::OtaManager()
+    : mqttManager(nullptr),
+      bufferPool(nullptr),
+      active(false),
+      bootChecked(false),
+      haveExpectedSha(false),
+      freeBlocks(NULL),
+      fullBlocks(NULL),
+      running(nullptr),
+      target(nullptr),
+      otaHandle(0),
+      isDelta(false),
+      writerStarted(false),
+      writerFailed(false),
+      patcher(readSourceCb, writeTargetCb, this),
+      contentLength(0),
+      downloaded(0),
+      imageBytes(0),
+      startMs(0),
+      downloadMs(0),
+      applyMs(0),
+      lastPct(0) {
+  memset(expectedSha, 0, sizeof(expectedSha));
+  memset(ring, 0, sizeof(ring));
+  memset(ringLen, 0, sizeof(ringLen));
+}
+
+void OtaManager::setMQTTManager(MQTTManager* mqtt) { mqttManager = mqtt; }
+
+void OtaManager::setBufferPool(BufferPool* pool) { bufferPool = pool; }
+
+static bool parseHex(const char* hex, uint8_t* out, size_t len) {
+  if (strlen(hex) != len * 2) return false;
+  for (size_t i = 0; i < len; i++) {
+    char byteStr[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    char* end;
+    out[i] = (uint8_t)strtoul(byteStr, &end, 16);
+    if (*end != '\0') return false;
+  }
+  return true;
+}
+
+void OtaManager::registerMQTTHandlers(MQTTManager& mqtt) {
+  mqtt.registerHandler(
+      TOPIC_OTA,
+      [this](MQTTManager& mqtt, const char* topic, byte* payload,
+             unsigned int length) -> bool {
+        char* cmd = mqtt.scratch().copy((const char*)payload, length);
+        if (!cmd) return true;
+
+        // Trim surrounding whitespace in place
+        while (isspace((unsigned char)*cmd)) cmd++;
+        for (char* end = cmd + strlen(cmd);
+             end > cmd && isspace((unsigned char)end[-1]); end--) {
+          end[-1] = '\0';
+        }
+
+        // "http://host/gateway.bin" or "http://host/update.sadl|<sha256>"
+        char* sep = strchr(cmd, '|');
+        uint8_t sha[32];
+        bool haveSha = false;
+        if (sep) {
+          *sep = '\0';
+          haveSha = parseHex(sep + 1, sha, sizeof(sha));
+          if (!haveSha) {
+            mqtt.publish(TOPIC_OTA_STATUS, "error:bad_sha256");
+            return true;
+          }
+        }
+
+        if (!start(cmd, haveSha ? sha : nullptr)) {
+          mqtt.publish(TOPIC_OTA_STATUS, "busy");
+        }
+        return true;
+      },
+      "GatewayOTA", 120);
+}
+
+// ============================================================================
+// Session Control
+// ============================================================================
+
+bool OtaManager::start(const char* imageUrl, const uint8_t* expectedSha256) {
+  if (active) return false;
+
+  static_assert(sizeof(freeBlocksStorage) + sizeof(fullBlocksStorage) +
+                        sizeof(freeBlocksStruct) + sizeof(fullBlocksStruct) <=
+                    RAM_BUDGET_OTA_MANAGER,
+                "OTA queues exceed RAM_BUDGET_OTA_MANAGER");
+
+  if (!bufferPool || !bufferPool->acquire(ring, OTA_RING_BLOCKS)) {
+    Serial.println("[OTA] ✗ Transfer buffers in use");
+    return false;
+  }
+
+  if (!freeBlocks) {
+    freeBlocks = xQueueCreateStatic(OTA_RING_BLOCKS, sizeof(uint8_t),
+                                    freeBlocksStorage, &freeBlocksStruct);
+    fullBlocks = xQueueCreateStatic(OTA_RING_BLOCKS + 1, sizeof(uint8_t),
+                                    fullBlocksStorage, &fullBlocksStruct);
+  }
+  xQueueReset(freeBlocks);
+  xQueueReset(fullBlocks);
+  for (uint8_t i = 0; i < OTA_RING_BLOCKS; i++) {
+    xQueueSend(freeBlocks, &i, 0);
+  }
+
+  url = imageUrl;
+  haveExpectedSha = expectedSha256 != nullptr;
+  if (haveExpectedSha) memcpy(expectedSha, expectedSha256, 32);
+
+  writerFailed = false;
+  writerStarted = false;
+  downloaded = 0;
+  imageBytes = 0;
+  applyMs = 0;
+  lastPct = 0;
+  startMs = millis();
+  active = true;
+
+  // Writer first so it is waiting when the first block arrives
+  if (xTaskCreatePinnedToCore(writerTaskEntry, "OtaWrite", OTA_STACK_SIZE,
+                              this, tskIDLE_PRIORITY + 1, NULL,
+                              0) != pdPASS ||
+      xTaskCreatePinnedToCore(downloadTaskEntry, "OtaFetch", OTA_STACK_SIZE,
+                              this, tskIDLE_PRIORITY + 1, NULL,
+                              0) != pdPASS) {
+    Serial.println("[OTA] ✗ Failed to create update tasks");
+    releaseRing();
+    active = false;
+    return false;
+  }
+
+  Serial.printf("[OTA] Update started from %s\n", url.c_str());
+  return true;
+}
+
+void OtaManager::releaseRing() {
+  for (int i = 0; i < OTA_RING_BLOCKS; i++) {
+    bufferPool->release(ring[i]);
+    ring[i] = nullptr;
+  }
+}
+
+void OtaManager::downloadTaskEntry(void* parameter) {
+  static_cast<OtaManager*>(parameter)->downloadLoop();
+  vTaskDelete(NULL);
+}
+
+void OtaManager::writerTaskEntry(void* parameter) {
+  OtaManager* self = static_cast<OtaManager*>(parameter);
+  bool ok = self->writerLoop();
+
+  // The download stage sends its end marker last, so the ring is idle now
+  self->releaseRing();
+  self->active = false;
+
+  if (ok) {
+    self->report("rebooting");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP.restart();
+  }
+  vTaskDelete(NULL);
+}
+
+// ============================================================================
+// Download Stage (HTTP -> ring)
+// ============================================================================
+
+void OtaManager::downloadLoop() {
+  uint8_t marker = RING_ABORT;
+  HTTPClient http;
+  http.setTimeout(10000);
+  http.begin(url);
+
+  int httpCode = http.GET();
+  if (httpCode != HTTP_CODE_OK) {
+    report("error:http_%d", httpCode);
+    http.end();
+    xQueueSend(fullBlocks, &marker, portMAX_DELAY);
+    return;
+  }
+
+  WiFiClient* stream = http.getStreamPtr();
+  contentLength = http.getSize();
+  int32_t remaining = contentLength;
+  bool timedOut = false;
+
+  while (!writerFailed && http.connected() &&
+         (remaining > 0 || remaining == -1)) {
+    uint8_t idx;
+    if (xQueueReceive(freeBlocks, &idx, pdMS_TO_TICKS(30000)) != pdTRUE) {
+      timedOut = true;  // Writer stuck
+      break;
+    }
+
+    // Fill whole blocks so every flash write is a full 4 KB sector
+    size_t fill = 0;
+    unsigned long lastData = millis();
+    while (fill < OTA_RING_BLOCK_SIZE && (remaining > 0 || remaining == -1) &&
+           http.connected()) {
+      size_t avail = stream->available();
+      if (avail) {
+        size_t want = OTA_RING_BLOCK_SIZE - fill;
+        if (avail < want) want = avail;
+        if (remaining > 0 && (int32_t)want > remaining) want = remaining;
+        int n = stream->readBytes(ring[idx] + fill, want);
+        fill += n;
+        if (remaining > 0) remaining -= n;
+        lastData = millis();
+      } else if (millis() - lastData > 10000) {
+        timedOut = true;
+        break;
+      } else {
+        vTaskDelay(1);
+      }
+    }
+
+    ringLen[idx] = fill;
+    downloaded += fill;
+    if (fill > 0) {
+      xQueueSend(fullBlocks, &idx, portMAX_DELAY);
+    } else {
+      xQueueSend(freeBlocks, &idx, 0);
+    }
+    if (timedOut) break;
+  }
+
+  http.end();
+  downloadMs = millis() - startMs;
+
+  bool complete = !timedOut && !writerFailed &&
+                  (contentLength == -1 || remaining == 0);
+  if (!complete && !writerFailed) {
+    report("error:download_interrupted_at_%u", downloaded);
+  }
+  marker = complete ? RING_END : RING_ABORT;
+  xQueueSend(fullBlocks, &marker, portMAX_DELAY);
+}
+
+// ============================================================================
+// Writer Stage (ring -> delta patcher -> esp_ota_write)
+// ============================================================================
+
+bool OtaManager::writerLoop() {
+  for (;;) {
+    uint8_t idx;
+    xQueueReceive(fullBlocks, &idx, portMAX_DELAY);
+
+    if (idx == RING_END) {
+      if (writerFailed) return false;
+      return finishImage();
+    }
+    if (idx == RING_ABORT) {
+      abortImage();
+      return false;
+    }
+
+    if (!writerFailed) {
+      unsigned long t0 = millis();
+      const uint8_t* data = ring[idx];
+      size_t len = ringLen[idx];
+      bool ok = true;
+
+      if (!writerStarted) {
+        ok = beginImage(data, len);
+        if (ok && isDelta) {
+          // beginImage() consumed the header; make sure it targets our image
+          ok = verifySource(patcher.header());
+          data += DELTA_HEADER_SIZE;
+          len -= DELTA_HEADER_SIZE;
+        }
+      }
+      if (ok) ok = isDelta ? patcher.feed(data, len) : writeImage(data, len);
+      if (!ok && isDelta && patcher.failed()) {
+        report("error:delta_%s", patcher.error());
+      }
+      applyMs += millis() - t0;
+
+      if (!ok) {
+        // Keep draining so the download stage can finish and exit
+        writerFailed = true;
+        abortImage();
+      } else {
+        uint32_t total =
+            isDelta ? patcher.header().targetSize : (uint32_t)contentLength;
+        if (total > 0 && total != (uint32_t)-1) {
+          int pct = (int)(100ULL * imageBytes / total);
+          if (pct >= lastPct + 10) {
+            lastPct = pct;
+            report("progress:%d", pct);
+          }
+        }
+      }
+    }
+
+    xQueueSend(freeBlocks, &idx, 0);
+  }
+}
+
+bool OtaManager::beginImage(const uint8_t* first, size_t len) {
+  isDelta = DeltaPatcher::isDelta(first, len);
+
+  if (isDelta) {
+    patcher.reset();
+    if (len < DELTA_HEADER_SIZE || !patcher.feed(first, DELTA_HEADER_SIZE)) {
+      report("error:bad_delta_header");
+      return false;
+    }
+  } else if (first[0] != ESP_IMAGE_HEADER_MAGIC) {
+    report("error:not_a_firmware_image");
+    return false;
+  }
+
+  running = esp_ota_get_running_partition();
+  target = esp_ota_get_next_update_partition(NULL);
+  if (!target) {
+    report("error:no_ota_partition");
+    return false;
+  }
+
+  // Sequential mode erases sector by sector as data arrives instead of
+  // blocking for seconds to erase the whole partition up front
+  esp_err_t err = esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &otaHandle);
+  if (err != ESP_OK) {
+    report("error:ota_begin_%s", esp_err_to_name(err));
+    return false;
+  }
+
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+  writerStarted = true;
+
+  report("writing:%s:%s", isDelta ? "delta" : "full", target->label);
+  return true;
+}
+
+bool OtaManager::verifySource(const DeltaHeader& header) {
+  if (header.sourceSize > running->size) {
+    report("error:delta_source_too_large");
+    return false;
+  }
+
+  uint8_t buf[512];
+  uint8_t digest[32];
+  mbedtls_sha256_context src;
+  mbedtls_sha256_init(&src);
+  mbedtls_sha256_starts_ret(&src, 0);
+  for (uint32_t off = 0; off < header.sourceSize; off += sizeof(buf)) {
+    size_t n = min((uint32_t)sizeof(buf), header.sourceSize - off);
+    if (esp_partition_read(running, off, buf, n) != ESP_OK) {
+      mbedtls_sha256_free(&src);
+      report("error:source_read");
+      return false;
+    }
+    mbedtls_sha256_update_ret(&src, buf, n);
+  }
+  mbedtls_sha256_finish_ret(&src, digest);
+  mbedtls_sha256_free(&src);
+
+  if (memcmp(digest, header.sourceSha256, 32) != 0) {
+    report("error:delta_made_for_other_image");
+    return false;
+  }
+  return true;
+}
+
+bool OtaManager::writeImage(const uint8_t* data, size_t len) {
+  if (esp_ota_write(otaHandle, data, len) != ESP_OK) {
+    report("error:flash_write");
+    return false;
+  }
+  mbedtls_sha256_update_ret(&sha, data, len);
+  imageBytes += len;
+  return true;
+}
+
+bool OtaManager::finishImage() {
+  if (!writerStarted) {
+    report("error:empty_download");
+    return false;
+  }
+  if (isDelta && !patcher.finished()) {
+    report("error:delta_truncated");
+    abortImage();
+    return false;
+  }
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish_ret(&sha, digest);
+  mbedtls_sha256_free(&sha);
+
+  const uint8_t* expected = isDelta ? patcher.header().targetSha256
+                                    : (haveExpectedSha ? expectedSha : nullptr);
+  if (expected && memcmp(digest, expected, 32) != 0) {
+    report("error:image_hash_mismatch");
+    esp_ota_abort(otaHandle);
+    writerStarted = false;
+    return false;
+  }
+
+  // esp_ota_end also validates the image structure and its appended SHA-256
+  esp_err_t err = esp_ota_end(otaHandle);
+  writerStarted = false;
+  if (err == ESP_OK) err = esp_ota_set_boot_partition(target);
+  if (err != ESP_OK) {
+    report("error:ota_end_%s", esp_err_to_name(err));
+    return false;
+  }
+
+  report("done:mode=%s,download=%u,image=%u,ratio=%.3f,download_ms=%lu,"
+         "write_ms=%lu",
+         isDelta ? "delta" : "full", downloaded, imageBytes,
+         imageBytes ? (float)downloaded / imageBytes : 0.0f, downloadMs,
+         applyMs);
+  return true;
+}
+
+void OtaManager::abortImage() {
+  if (writerStarted) {
+    esp_ota_abort(otaHandle);
+    mbedtls_sha256_free(&sha);
+    writerStarted = false;
+  }
+}
+
+bool OtaManager::readSourceCb(void* ctx, uint32_t offset, uint8_t* dst,
+                              size_t len) {
+  OtaManager* self = static_cast<OtaManager*>(ctx);
+  return esp_partition_read(self->running, offset, dst, len) == ESP_OK;
+}
+
+bool OtaManager::writeTargetCb(void* ctx, const uint8_t* data, size_t len) {
+  return static_cast<OtaManager*>(ctx)->writeImage(data, len);
+}
+
+// ============================================================================
+// Boot Confirmation / Rollback
+// ============================================================================
+
+void OtaManager::bootHealthTick(bool healthy) {
+  if (bootChecked) return;
+
+  // Only images booted for the first time after an update are pending
+  esp_ota_img_states_t state;
+  const esp_partition_t* part = esp_ota_get_running_partition();
+  if (esp_ota_get_state_partition(part, &state) != ESP_OK ||
+      state != ESP_OTA_IMG_PENDING_VERIFY) {
+    bootChecked = true;
+    return;
+  }
+
+  if (healthy) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    bootChecked = true;
+    report("boot_confirmed:%s", part->label);
+  } else if (millis() > OTA_BOOT_CONFIRM_TIMEOUT_MS) {
+    Serial.println("[OTA] ✗ New image never became healthy, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+}
+
+void OtaManager::report(const char* fmt, ...) {
+  char msg[OTA_REPORT_SIZE];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, args);
+  va_end(args);
+
+  Serial.printf("[OTA] %s\n", msg);
+  if (mqttManager) {
+    mqttManager->publish(TOPIC_OTA_STATUS, msg);
+  }
+}
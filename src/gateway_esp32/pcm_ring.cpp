@@ -0,0 +1,172 @@
+#include "../../include/gateway_esp32/pcm_ring.h"
+
+#include <stdio.h>
+
+#define RING_MASK (PCM_RING_FRAMES - 1)
+
+PcmRing::PcmRing()
+    : head(0),
+      tail(0),
+      discardTo(0),
+      discard(false),
+      depth(PCM_RING_FRAMES),
+      primed(false),
+      draining(false),
+      starved(false),
+      lowWater(PCM_RING_FRAMES),
+      underrunCount(0),
+      burstCount(0),
+      burstFramesPeak(0),
+      burstUsPeak(0),
+      burstUsTotal(0) {}
+
+// ============================================================================
+// PRODUCER
+// ============================================================================
+bool PcmRing::writeFrame(int16_t left, int16_t right) {
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= depth) {
+    return false;
+  }
+  frames[h & RING_MASK] = (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+  head.store(h + 1, std::memory_order_release);
+  if (!primed && fill() >= refillMark()) {
+    primed = true;
+    draining = false;
+  }
+  return true;
+}
+
+uint32_t PcmRing::write(const int16_t* stereo, uint32_t count) {
+  uint32_t h = head.load(std::memory_order_relaxed);
+  uint32_t level = h - tail.load(std::memory_order_acquire);
+  uint32_t space = level < depth ? depth - level : 0;
+  if (count > space) count = space;
+  for (uint32_t i = 0; i < count; i++) {
+    frames[(h + i) & RING_MASK] =
+        (uint16_t)stereo[2 * i] | ((uint32_t)(uint16_t)stereo[2 * i + 1] << 16);
+  }
+  head.store(h + count, std::memory_order_release);
+  if (!primed && fill() >= refillMark()) {
+    primed = true;
+    draining = false;
+  }
+  return count;
+}
+
+void PcmRing::setDepth(uint32_t frames) {
+  if (frames < PCM_RING_MIN_DEPTH) frames = PCM_RING_MIN_DEPTH;
+  if (frames > PCM_RING_FRAMES) frames = PCM_RING_FRAMES;
+  depth = frames;
+}
+
+uint32_t PcmRing::space() const {
+  uint32_t level = fill();
+  return level < depth ? depth - level : 0;
+}
+
+void PcmRing::noteBurst(uint32_t count, uint32_t us) {
+  burstCount++;
+  burstUsTotal += us;
+  if (count > burstFramesPeak) burstFramesPeak = count;
+  if (us > burstUsPeak) burstUsPeak = us;
+}
+
+void PcmRing::flush() {
+  primed = false;
+  draining = false;
+  discardTo.store(head.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+  discard.store(true, std::memory_order_release);
+}
+
+void PcmRing::finish() {
+  primed = false;
+  draining = true;
+}
+
+// ============================================================================
+// CONSUMER
+// ============================================================================
+void PcmRing::applyDiscard() {
+  if (!discard.load(std::memory_order_acquire)) return;
+  discard.store(false, std::memory_order_relaxed);
+  uint32_t to = discardTo.load(std::memory_order_relaxed);
+  // Never move backwards past frames already consumed
+  if ((int32_t)(to - tail.load(std::memory_order_relaxed)) > 0) {
+    tail.store(to, std::memory_order_release);
+  }
+  starved = false;
+  lowWater = PCM_RING_FRAMES;
+}
+
+uint32_t PcmRing::peek(const uint32_t** out) {
+  applyDiscard();
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  uint32_t avail = head.load(std::memory_order_acquire) - t;
+  if (!primed && !draining) avail = 0;  // Prefilling
+  uint32_t toWrap = PCM_RING_FRAMES - (t & RING_MASK);
+  *out = &frames[t & RING_MASK];
+  return avail < toWrap ? avail : toWrap;
+}
+
+void PcmRing::consume(uint32_t count) {
+  if (!count) return;
+  uint32_t t = tail.load(std::memory_order_relaxed) + count;
+  tail.store(t, std::memory_order_release);
+  starved = false;
+  uint32_t level = head.load(std::memory_order_acquire) - t;
+  if (primed && level < lowWater) lowWater = level;
+}
+
+uint32_t PcmRing::read(int16_t* stereo, uint32_t count) {
+  uint32_t done = 0;
+  while (done < count) {
+    const uint32_t* span;
+    uint32_t n = peek(&span);
+    if (n == 0) break;
+    if (n > count - done) n = count - done;
+    for (uint32_t i = 0; i < n; i++) {
+      stereo[2 * (done + i)] = (int16_t)(span[i] & 0xFFFF);
+      stereo[2 * (done + i) + 1] = (int16_t)(span[i] >> 16);
+    }
+    consume(n);
+    done += n;
+  }
+  return done;
+}
+
+void PcmRing::noteStarved() {
+  if (!primed || starved) return;
+  starved = true;
+  underrunCount++;
+}
+
+// ============================================================================
+// STATUS
+// ============================================================================
+uint32_t PcmRing::fill() const {
+  return head.load(std::memory_order_acquire) -
+         tail.load(std::memory_order_acquire);
+}
+
+uint32_t PcmRing::burstUsAvg() const {
+  return burstCount ? (uint32_t)(burstUsTotal / burstCount) : 0;
+}
+
+size_t PcmRing::toJson(char* buf, size_t len, uint32_t rateHz) const {
+  uint32_t rate = rateHz ? rateHz : 44100;
+  uint32_t level = fill();
+  int n = snprintf(buf, len,
+                   "{\"fill\":%u,\"fill_ms\":%u,\"capacity_ms\":%u,"
+                   "\"fill_min_ms\":%u,\"underruns\":%u,\"bursts\":%u,"
+                   "\"burst_frames_max\":%u,\"burst_us_avg\":%u,"
+                   "\"burst_us_max\":%u}",
+                   (unsigned)level, (unsigned)(level * 1000ULL / rate),
+                   (unsigned)(depth * 1000ULL / rate),
+                   (unsigned)(lowWater * 1000ULL / rate),
+                   (unsigned)underrunCount, (unsigned)burstCount,
+                   (unsigned)burstFramesPeak, (unsigned)burstUsAvg(),
+                   (unsigned)burstUsPeak);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,211 @@
+#include "../../include/gateway_esp32/resampler.h"
+
+#include <string.h>
+
+#define TAPS RESAMPLER_TAPS
+#define KAISER_BETA 7.5  // ~75 dB stopband
+#define CUTOFF 0.88      // Passband edge, fraction of the narrower Nyquist
+
+static_assert(RESAMPLER_OUTPUT_RATE == 44100,
+              "coefficient tables are designed for a 44.1 kHz output");
+
+// ============================================================================
+// COMPILE-TIME FILTER DESIGN
+// ============================================================================
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double cSin(double x) {
+  while (x > kPi) x -= 2 * kPi;
+  while (x < -kPi) x += 2 * kPi;
+  double term = x, sum = x;
+  for (int n = 1; n < 14; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cSqrt(double x) {
+  if (x <= 0) return 0;
+  double r = x > 1 ? x : 1;
+  for (int i = 0; i < 40; i++) r = 0.5 * (r + x / r);
+  return r;
+}
+
+// Modified Bessel function of the first kind, order 0 (Kaiser window)
+constexpr double besselI0(double x) {
+  double term = 1, sum = 1;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / 2) / k;
+    sum += term * term;
+  }
+  return sum;
+}
+
+template <int Up>
+struct Bank {
+  int16_t c[Up][TAPS];
+};
+
+// Up branches of a Kaiser-windowed sinc of Up * TAPS taps, designed at Up
+// times the input rate. The cutoff sits below the narrower of the input
+// and output Nyquist: 1/Up of the upsampled band when interpolating,
+// 1/Down when decimating. Each branch is scaled to a DC gain of exactly 1.
+template <int Up, int Down>
+constexpr Bank<Up> design() {
+  Bank<Up> bank{};
+  const int n = Up * TAPS;
+  const double fc = CUTOFF / (Up > Down ? Up : Down);
+  const double center = (n - 1) / 2.0;
+  const double i0Beta = besselI0(KAISER_BETA);
+
+  for (int p = 0; p < Up; p++) {
+    double taps[TAPS] = {};
+    double sum = 0;
+    for (int j = 0; j < TAPS; j++) {
+      int k = p + j * Up;
+      double t = k - center;
+      double x = kPi * fc * t;
+      double sinc = t == 0 ? 1.0 : cSin(x) / x;
+      double r = 2.0 * k / (n - 1) - 1;
+      taps[j] = sinc * besselI0(KAISER_BETA * cSqrt(1 - r * r)) / i0Beta;
+      sum += taps[j];
+    }
+
+    // Q15, oldest input first (tap j multiplies the input j frames back);
+    // the rounding error goes to the largest tap so DC stays exact
+    int total = 0, largest = 0;
+    for (int j = 0; j < TAPS; j++) {
+      double v = taps[j] / sum * 32768.0;
+      int q = (int)(v + (v >= 0 ? 0.5 : -0.5));
+      bank.c[p][TAPS - 1 - j] = (int16_t)q;
+      total += q;
+      if (q > bank.c[p][largest]) largest = TAPS - 1 - j;
+    }
+    bank.c[p][largest] = (int16_t)(bank.c[p][largest] + (32768 - total));
+  }
+  return bank;
+}
+
+// Worst-case sum of |taps| of any branch: int32 accumulation of 16-bit
+// samples cannot overflow while it stays below 2.0 in Q15
+template <int Up>
+constexpr bool accumulatorSafe(const Bank<Up>& bank) {
+  for (int p = 0; p < Up; p++) {
+    int32_t sum = 0;
+    for (int j = 0; j < TAPS; j++) {
+      sum += bank.c[p][j] < 0 ? -bank.c[p][j] : bank.c[p][j];
+    }
+    if (sum >= 65536) return false;
+  }
+  return true;
+}
+
+// One table per distinct filter: ratios sharing Up and the narrower band
+// share coefficients (8/16/32 kHz all interpolate by 441)
+constexpr Bank<2> kUp2 = design<2, 1>();          // 22.05 kHz
+constexpr Bank<4> kUp4 = design<4, 1>();          // 11.025 kHz
+constexpr Bank<147> kUp147 = design<147, 80>();   // 12, 24 kHz
+constexpr Bank<147> kDown160 = design<147, 160>();  // 48 kHz
+constexpr Bank<441> kUp441 = design<441, 320>();  // 8, 16, 32 kHz
+
+static_assert(accumulatorSafe(kUp2) && accumulatorSafe(kUp4) &&
+                  accumulatorSafe(kUp147) && accumulatorSafe(kDown160) &&
+                  accumulatorSafe(kUp441),
+              "a polyphase branch could overflow the accumulator");
+
+struct Ratio {
+  uint32_t rate;
+  uint16_t up;
+  uint16_t down;
+  const int16_t* coefs;
+};
+
+// Every MPEG-1/2/2.5 rate except the output rate itself
+const Ratio kRatios[] = {
+    {8000, 441, 80, &kUp441.c[0][0]},    {11025, 4, 1, &kUp4.c[0][0]},
+    {12000, 147, 40, &kUp147.c[0][0]},   {16000, 441, 160, &kUp441.c[0][0]},
+    {22050, 2, 1, &kUp2.c[0][0]},        {24000, 147, 80, &kUp147.c[0][0]},
+    {32000, 441, 320, &kUp441.c[0][0]},  {48000, 147, 160, &kDown160.c[0][0]},
+};
+
+}  // namespace
+
+// ============================================================================
+// RESAMPLER
+// ============================================================================
+Resampler::Resampler()
+    : coefs(nullptr),
+      inRate(RESAMPLER_OUTPUT_RATE),
+      up(1),
+      down(1),
+      phase(0),
+      pos(0) {
+  memset(history, 0, sizeof(history));
+}
+
+bool Resampler::setInputRate(uint32_t hz) {
+  if (hz == inRate) return true;
+
+  if (hz == RESAMPLER_OUTPUT_RATE) {
+    coefs = nullptr;
+    up = down = 1;
+    inRate = hz;
+    reset();
+    return true;
+  }
+  for (const Ratio& r : kRatios) {
+    if (r.rate == hz) {
+      coefs = r.coefs;
+      up = r.up;
+      down = r.down;
+      inRate = hz;
+      reset();
+      return true;
+    }
+  }
+  return false;
+}
+
+void Resampler::reset() {
+  memset(history, 0, sizeof(history));
+  phase = 0;
+  pos = 0;
+}
+
+static inline int16_t saturate(int32_t v) {
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
+
+uint32_t Resampler::push(int16_t left, int16_t right, int16_t* out) {
+  if (!coefs) {
+    out[0] = left;
+    out[1] = right;
+    return 1;
+  }
+
+  history[0][pos] = history[0][pos + TAPS] = left;
+  history[1][pos] = history[1][pos + TAPS] = right;
+  const int16_t* wl = &history[0][pos + 1];
+  const int16_t* wr = &history[1][pos + 1];
+  pos = pos + 1 == TAPS ? 0 : pos + 1;
+
+  // Every output whose position falls before the next input
+  uint32_t n = 0;
+  while (phase < up) {
+    const int16_t* c = coefs + (uint32_t)phase * TAPS;
+    int32_t accL = 1 << 14, accR = 1 << 14;
+    for (int j = 0; j < TAPS; j++) {
+      accL += c[j] * wl[j];
+      accR += c[j] * wr[j];
+    }
+    out[2 * n] = saturate(accL >> 15);
+    out[2 * n + 1] = saturate(accR >> 15);
+    n++;
+    phase += down;
+  }
+  phase -= up;
+  return n;
+}
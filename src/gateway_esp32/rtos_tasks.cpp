@@ -1,8 +1,16 @@
 #include "../../include/gateway_esp32/rtos_tasks.h"
 
+#include <WiFi.h>
+#include <esp_timer.h>
+
 #include "../../include/gateway_esp32/audio_manager.h"
 #include "../../include/gateway_esp32/display_manager.h"
+#include "../../include/gateway_esp32/event_bus.h"
+#include "../../include/gateway_esp32/memory_map.h"
 #include "../../include/gateway_esp32/mqtt_manager.h"
+#include "../../include/gateway_esp32/ota_manager.h"
+#include "../../include/gateway_esp32/rule_manager.h"
+#include "../../include/gateway_esp32/sensor_analytics.h"
 #include "../../include/gateway_esp32/sensor_manager.h"
 #include "../../include/shared/config.h"
 
@@ -11,11 +19,20 @@ extern AudioManager audio;
 extern MQTTManager mqtt;
 extern SensorManager localSensors;
 extern DisplayManager displayManager;
-extern void publishRemoteSensorData();
+extern OtaManager gatewayOta;
+extern RuleManager ruleManager;
+extern EventBus eventBus;
+extern SensorAnalytics sensorAnalytics;
+extern portMUX_TYPE sensorAnalyticsLock;
+extern void publishRemoteSensorData(const SensorData& data, uint8_t nodeId);
+extern void publishGatewayAnalytics();
+extern void publishMeshStats();
 
 // Task handles
+TaskHandle_t audioOutputTaskHandle = NULL;
 TaskHandle_t audioDecodeTaskHandle = NULL;
 TaskHandle_t audioEncodeTaskHandle = NULL;
+TaskHandle_t audioJobTaskHandle = NULL;
 TaskHandle_t websocketTaskHandle = NULL;
 TaskHandle_t mqttTaskHandle = NULL;
 TaskHandle_t sensorTaskHandle = NULL;
@@ -27,15 +44,111 @@ QueueHandle_t audioRxQueue = NULL;
 QueueHandle_t mqttQueue = NULL;
 
 // ============================================================================
-// AUDIO DECODE TASK - Handle audio playback
+// DEADLINE MONITOR - Iteration timing of the periodic tasks
+// ============================================================================
+static uint32_t monitorClockUs() { return (uint32_t)esp_timer_get_time(); }
+
+// Whatever runs on the other core right now; the same-core preemptors show
+// up through their own begin()/end() in the monitor. The hook runs in the
+// violating task's end(), so its core is the caller's and the task id the
+// monitor passes is not needed.
+static void monitorContext(int, char* buf, size_t len) {
+  BaseType_t other = xPortGetCoreID() ? 0 : 1;
+  TaskHandle_t h = xTaskGetCurrentTaskHandleForCPU(other);
+  snprintf(buf, len, "core%d:%s", (int)other, h ? pcTaskGetName(h) : "?");
+}
+
+DeadlineMonitor deadlineMonitor(monitorClockUs, monitorContext);
+static int audioOutputDeadline = -1;
+static int audioDeadline = -1;
+static int mqttDeadline = -1;
+static int sensorDeadline = -1;
+static int displayDeadline = -1;
+
+// Drain recorded violations to MQTT, called from the MQTT task
+static void publishDeadlineViolations() {
+  DeadlineViolation v;
+  char json[256];
+  while (deadlineMonitor.pollViolation(v)) {
+    if (deadlineMonitor.violationToJson(v, json, sizeof(json)) == 0) continue;
+    Serial.printf("[Deadline] ✗ %s\n", json);
+    if (mqtt.isConnected()) mqtt.publish(MQTT_TOPIC_DEADLINES, json);
+  }
+}
+
+// ============================================================================
+// STATIC STORAGE - Stacks, TCBs and queue buffers never come from the heap
+// ============================================================================
+static StackType_t audioOutputStack[STACK_SIZE_AUDIO_OUTPUT];
+static StackType_t audioDecodeStack[STACK_SIZE_AUDIO];
+static StackType_t audioJobStack[STACK_SIZE_AUDIO_JOBS];
+static StackType_t sensorStack[STACK_SIZE_SENSOR];
+static StackType_t displayStack[STACK_SIZE_DISPLAY];
+static StackType_t mqttStack[STACK_SIZE_NETWORK];
+static StaticTask_t audioOutputTcb, audioDecodeTcb, audioJobTcb, sensorTcb,
+    displayTcb, mqttTcb;
+
+static uint8_t audioTxQueueStorage[AUDIO_TX_QUEUE_SIZE * RTOS_QUEUE_ITEM_SIZE];
+static uint8_t audioRxQueueStorage[AUDIO_RX_QUEUE_SIZE * RTOS_QUEUE_ITEM_SIZE];
+static uint8_t mqttQueueStorage[MQTT_QUEUE_SIZE * RTOS_QUEUE_ITEM_SIZE];
+static StaticQueue_t audioTxQueueStruct, audioRxQueueStruct, mqttQueueStruct;
+
+static_assert(sizeof(audioOutputStack) + sizeof(audioDecodeStack) +
+                      sizeof(audioJobStack) + sizeof(sensorStack) +
+                      sizeof(displayStack) + sizeof(mqttStack) +
+                      6 * sizeof(StaticTask_t) +
+                      sizeof(audioTxQueueStorage) +
+                      sizeof(audioRxQueueStorage) + sizeof(mqttQueueStorage) +
+                      3 * sizeof(StaticQueue_t) + sizeof(deadlineMonitor) <=
+                  RAM_BUDGET_RTOS_TASKS,
+              "RTOS task storage exceeds RAM_BUDGET_RTOS_TASKS");
+
+// ============================================================================
+// AUDIO OUTPUT TASK - Keep the I2S DMA buffers fed from the PCM ring
+// ============================================================================
+void audioOutputTask(void* parameter) {
+  Serial.println("[RTOS] Audio Output Task started on Core 1");
+
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    deadlineMonitor.begin(audioOutputDeadline);
+    audio.pumpOutput();
+    deadlineMonitor.end(audioOutputDeadline);
+
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_AUDIO_OUTPUT_MS));
+  }
+}
+
+// ============================================================================
+// AUDIO DECODE TASK - Decode MP3 into the PCM ring
 // ============================================================================
 void audioDecodeTask(void* parameter) {
   Serial.println("[RTOS] Audio Decode Task started on Core 1");
 
+  TickType_t lastWake = xTaskGetTickCount();
   for (;;) {
     // Handle MP3 playback
+    deadlineMonitor.begin(audioDeadline);
     audio.loop();
-    vTaskDelay(pdMS_TO_TICKS(10));  // 10ms for MP3 playback
+    deadlineMonitor.end(audioDeadline);
+
+    // Fixed 10ms release grid; each pass decodes at most one burst
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_AUDIO_DECODE_MS));
+  }
+}
+
+// ============================================================================
+// AUDIO JOB TASK - Downloads and exact index scans, below playback on Core 1
+// ============================================================================
+void audioJobTask(void* parameter) {
+  Serial.println("[RTOS] Audio Job Task started on Core 1");
+
+  for (;;) {
+    // A download or a scan takes seconds; the decoder and the output task
+    // preempt it, and it takes no lock they need for longer than one SD
+    // write or read
+    audio.backgroundJobs();
+    vTaskDelay(pdMS_TO_TICKS(PERIOD_AUDIO_JOBS_MS));
   }
 }
 
@@ -45,7 +158,10 @@ void audioDecodeTask(void* parameter) {
 void audioEncodeTask(void* parameter) {
   Serial.println("[RTOS] Audio Encode Task started on Core 1");
 
-  // Reserved for future INMP441 Microphone implementation
+  // Reserved for future INMP441 Microphone implementation: 20 ms frames at
+  // 16 kHz go through VoiceActivity (voice_activity.h) first, and only
+  // VAD_SPEECH / VAD_HANGOVER frames are encoded into audioTxQueue; silence
+  // costs a comfort noise descriptor now and then
   vTaskDelete(NULL);
 }
 
@@ -54,13 +170,75 @@ void audioEncodeTask(void* parameter) {
 // ============================================================================
 void mqttTask(void* parameter) {
   Serial.println("[RTOS] MQTT Task started on Core 0");
+  mqtt.claimClient();
+
+  int sensorEvents = eventBus.subscribe(EVENT_MASK(EVENT_SENSOR_SAMPLE));
+  NetworkStateEvent network = {false, false, 0};
+  Event event;
 
+  const TickType_t publishInterval =
+      pdMS_TO_TICKS(SENSOR_PUBLISH_INTERVAL_MS);
+  TickType_t lastPublish = xTaskGetTickCount();
+
+  TickType_t lastWake = xTaskGetTickCount();
   for (;;) {
+    deadlineMonitor.begin(mqttDeadline);
+
     // Process MQTT messages
+    deadlineMonitor.setContext(mqttDeadline, "loop");
     mqtt.loop();
 
+    // Publishes queued by the audio, rule and OTA tasks
+    deadlineMonitor.setContext(mqttDeadline, "outbox");
+    mqtt.flushOutbox();
+
+    // Forward remote samples as they arrive (latest value wins)
+    SensorSampleEvent sample;
+    bool newSample = false;
+    while (eventBus.poll(sensorEvents, event)) {
+      if (const SensorSampleEvent* s = event.as<SensorSampleEvent>()) {
+        sample = *s;
+        newSample = true;
+      }
+    }
+    if (newSample) {
+      deadlineMonitor.setContext(mqttDeadline, "remote_sensors");
+      publishRemoteSensorData(sample.data, sample.node);
+    }
+
+    // Gateway readings every 10 seconds. Only this task uses the client
+    // (PubSubClient has no lock); the others go through the outbox.
+    TickType_t now = xTaskGetTickCount();
+    if ((now - lastPublish) >= publishInterval) {
+      deadlineMonitor.setContext(mqttDeadline, "gateway_sensors");
+      localSensors.publishToMQTT(mqtt, MQTT_TOPIC_GATEWAY_LIGHT);
+      localSensors.publishNoise(mqtt, MQTT_TOPIC_GATEWAY_NOISE);
+      publishGatewayAnalytics();
+      publishMeshStats();
+      lastPublish = now;
+    }
+    deadlineMonitor.setContext(mqttDeadline, nullptr);
+
+    // Connectivity changes go out as events instead of being polled
+    bool wifiUp = WiFi.status() == WL_CONNECTED;
+    bool mqttUp = mqtt.isConnected();
+    if (wifiUp != network.wifiConnected || mqttUp != network.mqttConnected) {
+      network.wifiConnected = wifiUp;
+      network.mqttConnected = mqttUp;
+      network.rssi = wifiUp ? WiFi.RSSI() : 0;
+      eventBus.publish(network);
+    }
+
+    // A new image counts as healthy once it reaches the broker
+    gatewayOta.bootHealthTick(mqtt.isConnected());
+
+    deadlineMonitor.end(mqttDeadline);
+
+    // Reported after end() so the publish is not charged to this iteration
+    publishDeadlineViolations();
+
     // Run at 10Hz (every 100ms) - reduced frequency to prevent watchdog
-    vTaskDelay(pdMS_TO_TICKS(100));
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_MQTT_MS));
   }
 }
 
@@ -70,39 +248,45 @@ void mqttTask(void* parameter) {
 void sensorTask(void* parameter) {
   Serial.println("[RTOS] Sensor Task started on Core 1");
 
-  const TickType_t sensorInterval = pdMS_TO_TICKS(2000);    // 2 seconds
-  const TickType_t publishInterval = pdMS_TO_TICKS(10000);  // 10 seconds
-
+  const TickType_t sensorInterval = pdMS_TO_TICKS(SENSOR_READ_INTERVAL_MS);
   TickType_t lastSensorRead = xTaskGetTickCount();
-  TickType_t lastPublish = xTaskGetTickCount();
 
+  TickType_t lastWake = xTaskGetTickCount();
   for (;;) {
+    deadlineMonitor.begin(sensorDeadline);
     TickType_t now = xTaskGetTickCount();
 
     // Read sensors every 2 seconds
     if ((now - lastSensorRead) >= sensorInterval) {
+      deadlineMonitor.setContext(sensorDeadline, "read");
       localSensors.readSensors();
+      if (localSensors.isLightValid()) {
+        portENTER_CRITICAL(&sensorAnalyticsLock);
+        sensorAnalytics.update(SensorAnalytics::SIG_LIGHT,
+                               localSensors.getLightIntensity());
+        portEXIT_CRITICAL(&sensorAnalyticsLock);
+        ruleManager.post(RULE_IN_LIGHT, localSensors.getLightIntensity());
+      }
       lastSensorRead = now;
     }
 
-    // Publish to MQTT every 10 seconds
-    if ((now - lastPublish) >= publishInterval) {
-      // If we are downloading audio, DO NOT publish sensors.
-      // This prevents Core 1 (Sensors) from fighting Core 0 (Network) for the
-      // MQTT client.
-      if (audio.isDownloading()) {
-        Serial.println(
-            "[Sensors] Skipping publish (Audio Download in progress)");
-      } else {
-        localSensors.publishToMQTT(mqtt, MQTT_TOPIC_GATEWAY_LIGHT);
-        publishRemoteSensorData();
-      }
-
-      lastPublish = now;
+    // Ambient noise: a comparison between windows, a few blocks of FFT
+    // while one is measured
+    deadlineMonitor.setContext(sensorDeadline, "noise");
+    if (localSensors.pollNoise(millis())) {
+      float noise = localSensors.getNoiseLevel();
+      portENTER_CRITICAL(&sensorAnalyticsLock);
+      sensorAnalytics.update(SensorAnalytics::SIG_NOISE, noise);
+      portEXIT_CRITICAL(&sensorAnalyticsLock);
+      ruleManager.post(RULE_IN_NOISE, noise);
     }
 
-    // Run at 100Hz (every 10ms)
-    vTaskDelay(pdMS_TO_TICKS(50));  // Increased from 10ms to 50ms to save power
+    // Readings go to the broker from mqttTask, the only user of the client
+    deadlineMonitor.setContext(sensorDeadline, nullptr);
+    deadlineMonitor.end(sensorDeadline);
+
+    // Run at 20Hz - increased from 10ms to 50ms to save power
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_SENSOR_MS));
   }
 }
 
@@ -115,8 +299,10 @@ void displayTask(void* parameter) {
   int pageCounter = 0;
   const int PAGE_SWITCH_INTERVAL = 25;  // 5 seconds (25 * 200ms)
 
+  TickType_t lastWake = xTaskGetTickCount();
   for (;;) {
     // Update display
+    deadlineMonitor.begin(displayDeadline);
     displayManager.update();
 
     // Cycle to next page every 5 seconds
@@ -125,9 +311,10 @@ void displayTask(void* parameter) {
       displayManager.nextPage();
       pageCounter = 0;
     }
+    deadlineMonitor.end(displayDeadline);
 
-    // Delay 200ms (5 FPS refresh rate)
-    vTaskDelay(pdMS_TO_TICKS(200));
+    // Every 200ms (5 FPS refresh rate)
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_DISPLAY_MS));
   }
 }
 
@@ -137,9 +324,15 @@ void displayTask(void* parameter) {
 void initRTOSTasks() {
   Serial.println("\n[RTOS] Initializing task queues...");
 
-  // Create queues for audio streaming
-  mqttQueue =
-      xQueueCreate(MQTT_QUEUE_SIZE, sizeof(void*));  // Pointer to message
+  // Create queues for audio streaming (static buffers, cannot fail)
+  audioTxQueue =
+      xQueueCreateStatic(AUDIO_TX_QUEUE_SIZE, RTOS_QUEUE_ITEM_SIZE,
+                         audioTxQueueStorage, &audioTxQueueStruct);
+  audioRxQueue =
+      xQueueCreateStatic(AUDIO_RX_QUEUE_SIZE, RTOS_QUEUE_ITEM_SIZE,
+                         audioRxQueueStorage, &audioRxQueueStruct);
+  mqttQueue = xQueueCreateStatic(MQTT_QUEUE_SIZE, RTOS_QUEUE_ITEM_SIZE,
+                                 mqttQueueStorage, &mqttQueueStruct);
 
   if (audioTxQueue == NULL || audioRxQueue == NULL || mqttQueue == NULL) {
     Serial.println("[RTOS] ERROR: Failed to create queues!");
@@ -152,37 +345,65 @@ void initRTOSTasks() {
 void startRTOSTasks() {
   Serial.println("\n[RTOS] Starting tasks...\n");
 
+  // Deadlines are registered before any task can call begin()
+  audioOutputDeadline = deadlineMonitor.registerTask(
+      "AudioOutput", PERIOD_AUDIO_OUTPUT_MS * 1000, BUDGET_AUDIO_OUTPUT_US);
+  audioDeadline =
+      deadlineMonitor.registerTask("AudioDecode", PERIOD_AUDIO_DECODE_MS * 1000,
+                                   BUDGET_AUDIO_DECODE_US);
+  mqttDeadline = deadlineMonitor.registerTask("MQTT", PERIOD_MQTT_MS * 1000,
+                                              BUDGET_MQTT_US);
+  sensorDeadline = deadlineMonitor.registerTask(
+      "Sensors", PERIOD_SENSOR_MS * 1000, BUDGET_SENSOR_US);
+  displayDeadline = deadlineMonitor.registerTask(
+      "Display", PERIOD_DISPLAY_MS * 1000, BUDGET_DISPLAY_US);
+
   // ========== CORE 1: Audio & Display ==========
 
+  // Audio output - highest priority on Core 1, preempts the decoder
+  audioOutputTaskHandle = xTaskCreateStaticPinnedToCore(
+      audioOutputTask, "AudioOutput", STACK_SIZE_AUDIO_OUTPUT, NULL,
+      PRIORITY_AUDIO_OUTPUT, audioOutputStack, &audioOutputTcb,
+      1  // Core 1
+  );
+
   // Audio decode - CRITICAL priority on Core 1
-  xTaskCreatePinnedToCore(audioDecodeTask, "AudioDecode", STACK_SIZE_AUDIO,
-                          NULL, PRIORITY_AUDIO_DECODE, &audioDecodeTaskHandle,
-                          1  // Core 1
+  audioDecodeTaskHandle = xTaskCreateStaticPinnedToCore(
+      audioDecodeTask, "AudioDecode", STACK_SIZE_AUDIO, NULL,
+      PRIORITY_AUDIO_DECODE, audioDecodeStack, &audioDecodeTcb,
+      1  // Core 1
   );
 
-  // Audio encode - CRITICAL priority on Core 1 (suspended until needed)
-  xTaskCreatePinnedToCore(audioEncodeTask, "AudioEncode", STACK_SIZE_AUDIO,
-                          NULL, PRIORITY_AUDIO_ENCODE, &audioEncodeTaskHandle,
-                          1  // Core 1
+  // Audio jobs - NORMAL priority on Core 1, below the decoder
+  audioJobTaskHandle = xTaskCreateStaticPinnedToCore(
+      audioJobTask, "AudioJobs", STACK_SIZE_AUDIO_JOBS, NULL,
+      PRIORITY_AUDIO_JOBS, audioJobStack, &audioJobTcb,
+      1  // Core 1
   );
 
+  // Audio encode is not created until the microphone pipeline exists; it
+  // would only delete itself. It gets a heap stack then, like the OTA tasks.
+
   // Sensor reading - NORMAL priority on Core 1
-  xTaskCreatePinnedToCore(sensorTask, "Sensors", STACK_SIZE_SENSOR, NULL,
-                          PRIORITY_SENSOR_READ, &sensorTaskHandle,
-                          1  // Core 1
+  sensorTaskHandle = xTaskCreateStaticPinnedToCore(
+      sensorTask, "Sensors", STACK_SIZE_SENSOR, NULL, PRIORITY_SENSOR_READ,
+      sensorStack, &sensorTcb,
+      1  // Core 1
   );
 
   // Display updates - NORMAL priority on Core 1
-  xTaskCreatePinnedToCore(displayTask, "Display", STACK_SIZE_DISPLAY, NULL,
-                          PRIORITY_DISPLAY, &displayTaskHandle,
-                          1  // Core 1
+  displayTaskHandle = xTaskCreateStaticPinnedToCore(
+      displayTask, "Display", STACK_SIZE_DISPLAY, NULL, PRIORITY_DISPLAY,
+      displayStack, &displayTcb,
+      1  // Core 1
   );
 
   // ========== CORE 0: Network & Communication ==========
 
   // MQTT - HIGH priority on Core 0
-  xTaskCreatePinnedToCore(mqttTask, "MQTT", STACK_SIZE_NETWORK, NULL,
-                          PRIORITY_MQTT, &mqttTaskHandle,
-                          0  // Core 0 (same core as WiFi stack)
+  mqttTaskHandle = xTaskCreateStaticPinnedToCore(
+      mqttTask, "MQTT", STACK_SIZE_NETWORK, NULL, PRIORITY_MQTT, mqttStack,
+      &mqttTcb,
+      0  // Core 0 (same core as WiFi stack)
   );
 }
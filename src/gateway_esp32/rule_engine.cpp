@@ -0,0 +1,474 @@
+#include "../../include/gateway_esp32/rule_engine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const inputNames[RULE_IN_COUNT] = {
+    "outside_temp", "outside_humidity", "pressure", "uv",     "dew_point",
+    "light",        "time",             "weekday",  "playing",
+    "noise"};
+
+// ============================================================================
+// Compiler
+// ============================================================================
+// Recursive descent over the condition text, emitting postfix bytecode:
+//
+//   or   := and ("||" and)*
+//   and  := not ("&&" not)*
+//   not  := "!" not | cmp
+//   cmp  := sum (("<" | "<=" | ">" | ">=" | "==" | "!=") sum)?
+//   sum  := term (("+" | "-") term)*
+//   term := unary (("*" | "/") unary)*
+//   unary:= "-" unary | number | HH:MM | input | "(" or ")"
+
+namespace {
+
+struct Compiler {
+  const char* p;
+  const char* end;
+  uint8_t* out;
+  uint16_t capacity;
+  uint16_t length;
+  uint8_t depth;
+  uint8_t maxDepth;
+  uint16_t inputMask;
+  const char* error;
+
+  void skipSpace() {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+  }
+
+  bool accept(const char* token) {
+    skipSpace();
+    size_t n = strlen(token);
+    if ((size_t)(end - p) >= n && strncmp(p, token, n) == 0) {
+      p += n;
+      return true;
+    }
+    return false;
+  }
+
+  void emit(uint8_t byte) {
+    if (length < capacity) {
+      out[length] = byte;
+    } else if (!error) {
+      error = "code space full";
+    }
+    length++;
+  }
+
+  void push() {
+    if (++depth > maxDepth) maxDepth = depth;
+    if (depth > RULE_STACK_DEPTH && !error) error = "expression too deep";
+  }
+
+  // Binary operators consume two values and leave one
+  void binary(RuleOp op) {
+    emit(op);
+    depth--;
+  }
+
+  void constant(float value) {
+    emit(RULE_OP_CONST);
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);
+    for (int i = 0; i < 4; i++) emit(bytes[i]);
+    push();
+  }
+
+  void parseOr() {
+    parseAnd();
+    while (!error && accept("||")) {
+      parseAnd();
+      binary(RULE_OP_OR);
+    }
+  }
+
+  void parseAnd() {
+    parseNot();
+    while (!error && accept("&&")) {
+      parseNot();
+      binary(RULE_OP_AND);
+    }
+  }
+
+  void parseNot() {
+    skipSpace();
+    if (p < end && *p == '!' && (p + 1 >= end || p[1] != '=')) {
+      p++;
+      parseNot();
+      emit(RULE_OP_NOT);
+      return;
+    }
+    parseCmp();
+  }
+
+  void parseCmp() {
+    parseSum();
+    RuleOp op;
+    if (accept("<=")) {
+      op = RULE_OP_LE;
+    } else if (accept(">=")) {
+      op = RULE_OP_GE;
+    } else if (accept("==")) {
+      op = RULE_OP_EQ;
+    } else if (accept("!=")) {
+      op = RULE_OP_NE;
+    } else if (accept("<")) {
+      op = RULE_OP_LT;
+    } else if (accept(">")) {
+      op = RULE_OP_GT;
+    } else {
+      return;
+    }
+    parseSum();
+    binary(op);
+  }
+
+  void parseSum() {
+    parseTerm();
+    while (!error) {
+      if (accept("+")) {
+        parseTerm();
+        binary(RULE_OP_ADD);
+      } else if (accept("-")) {
+        parseTerm();
+        binary(RULE_OP_SUB);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void parseTerm() {
+    parseUnary();
+    while (!error) {
+      if (accept("*")) {
+        parseUnary();
+        binary(RULE_OP_MUL);
+      } else if (accept("/")) {
+        parseUnary();
+        binary(RULE_OP_DIV);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void parseUnary() {
+    skipSpace();
+    if (p >= end) {
+      error = "unexpected end of condition";
+      return;
+    }
+
+    if (*p == '-') {
+      p++;
+      parseUnary();
+      emit(RULE_OP_NEG);
+      return;
+    }
+
+    if (*p == '(') {
+      p++;
+      parseOr();
+      if (!error && !accept(")")) error = "missing ')'";
+      return;
+    }
+
+    if ((*p >= '0' && *p <= '9') || *p == '.') {
+      char* numEnd;
+      float value = strtof(p, &numEnd);
+      // HH:MM literal, compared against the time input in minutes
+      if (numEnd < end && *numEnd == ':' && numEnd + 1 < end &&
+          numEnd[1] >= '0' && numEnd[1] <= '9') {
+        float minutes = strtof(numEnd + 1, &numEnd);
+        value = value * 60.0f + minutes;
+      }
+      p = numEnd;
+      constant(value);
+      return;
+    }
+
+    const char* start = p;
+    while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9') ||
+                       *p == '_')) {
+      p++;
+    }
+    int input = RuleEngine::inputFromName(start, p - start);
+    if (input < 0) {
+      error = p > start ? "unknown input" : "unexpected character";
+      return;
+    }
+    emit(RULE_OP_LOAD);
+    emit((uint8_t)input);
+    push();
+    inputMask |= (uint16_t)(1u << input);
+  }
+};
+
+void copyToken(char* dst, size_t len, const char* start, const char* end) {
+  while (start < end && (*start == ' ' || *start == '\t')) start++;
+  while (end > start && (end[-1] == ' ' || end[-1] == '\t' ||
+                         end[-1] == '\r')) {
+    end--;
+  }
+  size_t n = end - start;
+  if (n >= len) n = len - 1;
+  memcpy(dst, start, n);
+  dst[n] = '\0';
+}
+
+bool parseAction(Rule& r, const char* text, const char** error) {
+  char buf[RULE_ARG_LEN + 16];
+  copyToken(buf, sizeof(buf), text, text + strlen(text));
+
+  char* arg = strchr(buf, ' ');
+  if (arg) *arg++ = '\0';
+  while (arg && *arg == ' ') arg++;
+
+  r.actionValue = 0.0f;
+  r.actionArg[0] = '\0';
+
+  if (strcmp(buf, "stop") == 0) {
+    r.action = RULE_ACTION_STOP;
+    return true;
+  }
+  if (strcmp(buf, "play") != 0 && strcmp(buf, "fadein") != 0 &&
+      strcmp(buf, "volume") != 0 && strcmp(buf, "publish") != 0) {
+    *error = "unknown action";
+    return false;
+  }
+  if (!arg || !*arg) {
+    *error = "action needs an argument";
+    return false;
+  }
+
+  if (strcmp(buf, "play") == 0 || strcmp(buf, "fadein") == 0) {
+    r.action = buf[0] == 'p' ? RULE_ACTION_PLAY : RULE_ACTION_FADEIN;
+    char* seconds = strchr(arg, ' ');
+    if (seconds) *seconds++ = '\0';
+    copyToken(r.actionArg, sizeof(r.actionArg), arg, arg + strlen(arg));
+    if (r.action == RULE_ACTION_FADEIN) {
+      r.actionValue = seconds ? strtof(seconds, nullptr) : 0.0f;
+      if (r.actionValue <= 0.0f) {
+        *error = "fadein needs a duration in seconds";
+        return false;
+      }
+    }
+    return true;
+  }
+  if (strcmp(buf, "volume") == 0) {
+    r.action = RULE_ACTION_VOLUME;
+    r.actionValue = strtof(arg, nullptr);
+    return true;
+  }
+  r.action = RULE_ACTION_PUBLISH;
+  copyToken(r.actionArg, sizeof(r.actionArg), arg, arg + strlen(arg));
+  return true;
+}
+
+inline bool truthy(float v) { return v != 0.0f && !isnan(v); }
+
+}  // namespace
+
+// ============================================================================
+// RuleEngine
+// ============================================================================
+
+RuleEngine::RuleEngine() : callback(nullptr), callbackContext(nullptr) {
+  for (int i = 0; i < RULE_IN_COUNT; i++) inputs[i] = NAN;
+  clear();
+}
+
+void RuleEngine::clear() {
+  memset(rules, 0, sizeof(rules));
+  memset(dependents, 0, sizeof(dependents));
+  count = 0;
+  codeUsed = 0;
+  dirty = 0;
+}
+
+void RuleEngine::setActionCallback(ActionCallback cb, void* context) {
+  callback = cb;
+  callbackContext = context;
+}
+
+bool RuleEngine::addRule(const char* line, char* err, size_t errLen) {
+  if (count >= RULE_MAX_RULES) {
+    snprintf(err, errLen, "too many rules (max %d)", RULE_MAX_RULES);
+    return false;
+  }
+
+  const char* colon = strchr(line, ':');
+  const char* arrow = colon ? strstr(colon, "->") : nullptr;
+  if (!colon || !arrow) {
+    snprintf(err, errLen, "expected '<name>: <condition> -> <action>'");
+    return false;
+  }
+
+  Rule& r = rules[count];
+  memset(&r, 0, sizeof(Rule));
+  copyToken(r.name, sizeof(r.name), line, colon);
+
+  Compiler c;
+  c.p = colon + 1;
+  c.end = arrow;
+  c.out = code + codeUsed;
+  c.capacity = RULE_CODE_SIZE - codeUsed;
+  c.length = 0;
+  c.depth = 0;
+  c.maxDepth = 0;
+  c.inputMask = 0;
+  c.error = nullptr;
+
+  c.parseOr();
+  c.skipSpace();
+  if (!c.error && c.p != c.end) c.error = "unexpected text in condition";
+
+  const char* actionError = nullptr;
+  if (!c.error) parseAction(r, arrow + 2, &actionError);
+  if (c.error || actionError) {
+    snprintf(err, errLen, "%s: %s", r.name, c.error ? c.error : actionError);
+    return false;
+  }
+
+  r.codeOffset = codeUsed;
+  r.codeLength = c.length;
+  r.inputMask = c.inputMask;
+  codeUsed += c.length;
+
+  for (int i = 0; i < RULE_IN_COUNT; i++) {
+    if (r.inputMask & (1u << i)) dependents[i] |= (uint16_t)(1u << count);
+  }
+  dirty |= (uint16_t)(1u << count);
+  count++;
+  return true;
+}
+
+bool RuleEngine::load(const char* text, char* err, size_t errLen) {
+  clear();
+
+  char line[160];
+  while (*text) {
+    const char* eol = strchr(text, '\n');
+    if (!eol) eol = text + strlen(text);
+    copyToken(line, sizeof(line), text, eol);
+    text = *eol ? eol + 1 : eol;
+
+    if (line[0] == '\0' || line[0] == '#') continue;
+    if (!addRule(line, err, errLen)) {
+      clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void RuleEngine::setInput(RuleInput input, float value) {
+  float old = inputs[input];
+  if (old == value || (isnan(old) && isnan(value))) return;
+  inputs[input] = value;
+  dirty |= dependents[input];
+}
+
+bool RuleEngine::run(const Rule& r) const {
+  float stack[RULE_STACK_DEPTH];
+  int sp = 0;
+  const uint8_t* pc = code + r.codeOffset;
+  const uint8_t* end = pc + r.codeLength;
+
+  // Stack depth was checked by the compiler
+  while (pc < end) {
+    uint8_t op = *pc++;
+    switch (op) {
+      case RULE_OP_CONST:
+        memcpy(&stack[sp++], pc, 4);
+        pc += 4;
+        break;
+      case RULE_OP_LOAD:
+        stack[sp++] = inputs[*pc++];
+        break;
+      case RULE_OP_NEG:
+        stack[sp - 1] = -stack[sp - 1];
+        break;
+      case RULE_OP_NOT:
+        stack[sp - 1] = truthy(stack[sp - 1]) ? 0.0f : 1.0f;
+        break;
+      default: {
+        float b = stack[--sp];
+        float a = stack[sp - 1];
+        float v;
+        switch (op) {
+          case RULE_OP_ADD: v = a + b; break;
+          case RULE_OP_SUB: v = a - b; break;
+          case RULE_OP_MUL: v = a * b; break;
+          case RULE_OP_DIV: v = a / b; break;
+          case RULE_OP_LT: v = a < b; break;
+          case RULE_OP_LE: v = a <= b; break;
+          case RULE_OP_GT: v = a > b; break;
+          case RULE_OP_GE: v = a >= b; break;
+          case RULE_OP_EQ: v = a == b; break;
+          case RULE_OP_NE: v = a != b; break;
+          case RULE_OP_AND: v = truthy(a) && truthy(b); break;
+          case RULE_OP_OR: v = truthy(a) || truthy(b); break;
+          default: return false;
+        }
+        stack[sp - 1] = v;
+        break;
+      }
+    }
+  }
+  return sp == 1 && truthy(stack[0]);
+}
+
+void RuleEngine::evaluateRule(uint8_t index) {
+  Rule& r = rules[index];
+  bool result = run(r);
+  bool rising = result && !r.lastResult;
+  r.lastResult = result;
+  if (rising) {
+    r.fireCount++;
+    if (callback) callback(r, callbackContext);
+  }
+}
+
+int RuleEngine::evaluate() {
+  uint16_t pending = dirty;
+  dirty = 0;
+
+  int evaluated = 0;
+  while (pending) {
+    uint8_t index = __builtin_ctz(pending);
+    pending &= pending - 1;
+    evaluateRule(index);
+    evaluated++;
+  }
+  return evaluated;
+}
+
+int RuleEngine::evaluateAll() {
+  dirty = 0;
+  for (uint8_t i = 0; i < count; i++) evaluateRule(i);
+  return count;
+}
+
+void RuleEngine::prime() {
+  dirty = 0;
+  for (uint8_t i = 0; i < count; i++) rules[i].lastResult = run(rules[i]);
+}
+
+int RuleEngine::inputFromName(const char* name, size_t len) {
+  for (int i = 0; i < RULE_IN_COUNT; i++) {
+    if (strlen(inputNames[i]) == len && strncmp(inputNames[i], name, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char* RuleEngine::inputName(RuleInput input) {
+  return input < RULE_IN_COUNT ? inputNames[input] : "?";
+}
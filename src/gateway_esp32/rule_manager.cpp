@@ -0,0 +1,294 @@
+#include "../../include/gateway_esp32/rule_manager.h"
+
+#include <time.h>
+
+#include "../../include/gateway_esp32/memory_map.h"
+#include "../../include/shared/config.h"
+
+#define TOPIC_RULES "smartalarm/rules"
+#define TOPIC_RULES_STATUS "smartalarm/rules/status"
+#define TOPIC_RULES_FIRED "smartalarm/rules/fired"
+#define RULE_STATUS_SIZE 256  // publishStatus() JSON
+
+static_assert(RULE_STATUS_SIZE <= MQTT_OUTBOX_PAYLOAD_SIZE,
+              "Rule status must fit an MQTT outbox slot");
+static_assert(RULE_NAME_LEN + RULE_ARG_LEN <= MQTT_OUTBOX_PAYLOAD_SIZE,
+              "Fired rule messages must fit an MQTT outbox slot");
+
+StackType_t RuleManager::taskStack[RULE_STACK_SIZE];
+StaticTask_t RuleManager::taskTcb;
+uint8_t RuleManager::queueStorage[RULE_QUEUE_LENGTH * sizeof(InputEvent)];
+StaticQueue_t RuleManager::queueStruct;
+StaticSemaphore_t RuleManager::mutexStruct;
+
+RuleManager::RuleManager()
+    : sdManager(nullptr),
+      mqttManager(nullptr),
+      audioManager(nullptr),
+      engineMutex(NULL),
+      queue(NULL),
+      fading(false),
+      fadeTarget(0.0f),
+      fadeStartMs(0),
+      fadeDurationMs(0),
+      eventCount(0),
+      evaluatedCount(0),
+      firedCount(0),
+      droppedCount(0),
+      evalUsSum(0),
+      evalUsMax(0),
+      latencyUsLast(0),
+      latencyUsMax(0),
+      currentEventUs(0) {}
+
+void RuleManager::setSDManager(SDManager* sd) { sdManager = sd; }
+
+void RuleManager::setMQTTManager(MQTTManager* mqtt) { mqttManager = mqtt; }
+
+void RuleManager::setAudioManager(AudioManager* audio) {
+  audioManager = audio;
+}
+
+bool RuleManager::begin() {
+  static_assert(sizeof(taskStack) + sizeof(taskTcb) + sizeof(queueStorage) +
+                        sizeof(queueStruct) + sizeof(mutexStruct) <=
+                    RAM_BUDGET_RULE_MANAGER,
+                "Rule task storage exceeds RAM_BUDGET_RULE_MANAGER");
+
+  engineMutex = xSemaphoreCreateMutexStatic(&mutexStruct);
+  queue = xQueueCreateStatic(RULE_QUEUE_LENGTH, sizeof(InputEvent),
+                             queueStorage, &queueStruct);
+
+  engine.setActionCallback(onAction, this);
+
+  // Rules that use "time" or "weekday" stay false until the clock is set
+  configTzTime(TIMEZONE, NTP_SERVER);
+
+  if (sdManager && sdManager->isReady() && sdManager->exists(RULES_FILE)) {
+    File f = sdManager->openForRead(RULES_FILE);
+    if (f) {
+      String text = f.readString();
+      f.close();
+      loadRules(text.c_str(), false);
+    }
+  }
+
+  // Core 1 at sensor priority, next to the producers of most inputs
+  xTaskCreateStaticPinnedToCore(taskEntry, "Rules", RULE_STACK_SIZE, this,
+                                tskIDLE_PRIORITY + 1, taskStack, &taskTcb, 1);
+  return true;
+}
+
+void RuleManager::registerMQTTHandlers(MQTTManager& mqtt) {
+  mqtt.registerHandler(
+      TOPIC_RULES,
+      [this](MQTTManager& mqtt, const char* topic, byte* payload,
+             unsigned int length) -> bool {
+        const char* text = mqtt.scratch().copy((const char*)payload, length);
+        if (!text) return true;
+        if (strcmp(text, "status") == 0) {
+          publishStatus();
+        } else {
+          loadRules(text, true);
+        }
+        return true;
+      },
+      "Rules", 100);
+}
+
+void RuleManager::post(RuleInput input, float value) {
+  if (!queue) return;
+  InputEvent event = {input, value, (uint32_t)micros()};
+  if (xQueueSend(queue, &event, 0) != pdTRUE) {
+    droppedCount++;
+  }
+}
+
+// ============================================================================
+// Rule Task
+// ============================================================================
+
+void RuleManager::taskEntry(void* parameter) {
+  static_cast<RuleManager*>(parameter)->run();
+}
+
+void RuleManager::run() {
+  Serial.println("[Rules] Rule task started on Core 1");
+
+  uint32_t lastTick = 0;
+  InputEvent event;
+
+  for (;;) {
+    TickType_t wait = pdMS_TO_TICKS(fading ? RULE_FADE_STEP_MS : RULE_TICK_MS);
+    if (xQueueReceive(queue, &event, wait) == pdTRUE) {
+      apply(event);
+    }
+
+    if (fading) tickFade();
+
+    if (millis() - lastTick >= RULE_TICK_MS) {
+      lastTick = millis();
+      tick();
+    }
+  }
+}
+
+void RuleManager::apply(const InputEvent& event) {
+  xSemaphoreTake(engineMutex, portMAX_DELAY);
+  currentEventUs = event.postedUs;
+  uint32_t start = micros();
+  engine.setInput(event.input, event.value);
+  int evaluated = engine.evaluate();
+  uint32_t elapsed = micros() - start;
+  xSemaphoreGive(engineMutex);
+
+  eventCount++;
+  evaluatedCount += evaluated;
+  evalUsSum += elapsed;
+  if (elapsed > evalUsMax) evalUsMax = elapsed;
+}
+
+// Clock and playback state become inputs like any sensor value
+void RuleManager::tick() {
+  struct tm now;
+  if (getLocalTime(&now, 0)) {
+    post(RULE_IN_TIME, now.tm_hour * 60 + now.tm_min);
+    post(RULE_IN_WEEKDAY, now.tm_wday);
+  }
+  if (audioManager) {
+    post(RULE_IN_PLAYING, audioManager->playing() ? 1.0f : 0.0f);
+  }
+}
+
+void RuleManager::tickFade() {
+  if (!audioManager) {
+    fading = false;
+    return;
+  }
+  uint32_t elapsed = millis() - fadeStartMs;
+  if (elapsed >= fadeDurationMs) {
+    audioManager->setVolume(fadeTarget);
+    fading = false;
+    return;
+  }
+  audioManager->setVolume(fadeTarget * elapsed / fadeDurationMs, true);
+}
+
+// ============================================================================
+// Actions
+// ============================================================================
+
+void RuleManager::onAction(const Rule& rule, void* context) {
+  static_cast<RuleManager*>(context)->execute(rule);
+}
+
+// Runs in the rule task while it holds the engine mutex
+void RuleManager::execute(const Rule& rule) {
+  uint32_t latency = micros() - currentEventUs;
+  latencyUsLast = latency;
+  if (latency > latencyUsMax) latencyUsMax = latency;
+  firedCount++;
+
+  Serial.printf("[Rules] ✓ %s fired (%lu us after input)\n", rule.name,
+                (unsigned long)latency);
+
+  switch (rule.action) {
+    case RULE_ACTION_PLAY:
+      if (audioManager) audioManager->playFile(rule.actionArg);
+      break;
+    case RULE_ACTION_FADEIN:
+      if (audioManager) {
+        fadeTarget = audioManager->getVolume();
+        audioManager->setVolume(0.0f, true);
+        if (audioManager->playFile(rule.actionArg)) {
+          fading = true;
+          fadeStartMs = millis();
+          fadeDurationMs = (uint32_t)(rule.actionValue * 1000.0f);
+        } else {
+          audioManager->setVolume(fadeTarget, true);
+        }
+      }
+      break;
+    case RULE_ACTION_STOP:
+      fading = false;
+      if (audioManager) audioManager->stop();
+      break;
+    case RULE_ACTION_VOLUME:
+      fading = false;
+      if (audioManager) audioManager->setVolume(rule.actionValue);
+      break;
+    case RULE_ACTION_PUBLISH:
+      break;
+  }
+
+  if (mqttManager && mqttManager->isConnected()) {
+    String msg = rule.name;
+    if (rule.action == RULE_ACTION_PUBLISH) {
+      msg += "|";
+      msg += rule.actionArg;
+    }
+    mqttManager->publish(TOPIC_RULES_FIRED, msg);
+  }
+}
+
+// ============================================================================
+// Loading and Status
+// ============================================================================
+
+bool RuleManager::loadRules(const char* text, bool save) {
+  char err[64];
+  if (!staging.load(text, err, sizeof(err))) {
+    Serial.printf("[Rules] ✗ %s\n", err);
+    if (mqttManager) {
+      char msg[80];
+      snprintf(msg, sizeof(msg), "error: %s", err);
+      mqttManager->publish(TOPIC_RULES_STATUS, msg);
+    }
+    return false;
+  }
+
+  // Carry the current inputs over, and do not fire rules that are already
+  // true just because they were reloaded
+  xSemaphoreTake(engineMutex, portMAX_DELAY);
+  for (int i = 0; i < RULE_IN_COUNT; i++) {
+    staging.setInput((RuleInput)i, engine.getInput((RuleInput)i));
+  }
+  staging.prime();
+  engine = staging;
+  engine.setActionCallback(onAction, this);
+  xSemaphoreGive(engineMutex);
+
+  Serial.printf("[Rules] ✓ Loaded %d rules (%d bytes of bytecode)\n",
+                engine.ruleCount(), engine.codeSize());
+
+  if (save && sdManager && sdManager->isReady()) {
+    File f = SD.open(RULES_FILE, FILE_WRITE);
+    if (f) {
+      f.print(text);
+      f.close();
+    } else {
+      Serial.println("[Rules] ✗ Could not save " RULES_FILE);
+    }
+  }
+
+  publishStatus();
+  return true;
+}
+
+void RuleManager::publishStatus() {
+  if (!mqttManager || !mqttManager->isConnected()) return;
+
+  char json[RULE_STATUS_SIZE];
+  snprintf(json, sizeof(json),
+           "{\"rules\":%d,\"code\":%d,\"events\":%lu,\"evaluated\":%lu,"
+           "\"fired\":%lu,\"dropped\":%lu,\"eval_us_avg\":%lu,"
+           "\"eval_us_max\":%lu,\"latency_us_last\":%lu,"
+           "\"latency_us_max\":%lu}",
+           engine.ruleCount(), engine.codeSize(), (unsigned long)eventCount,
+           (unsigned long)evaluatedCount, (unsigned long)firedCount,
+           (unsigned long)droppedCount,
+           (unsigned long)(eventCount ? evalUsSum / eventCount : 0),
+           (unsigned long)evalUsMax, (unsigned long)latencyUsLast,
+           (unsigned long)latencyUsMax);
+  mqttManager->publish(TOPIC_RULES_STATUS, json);
+}
@@ -1,6 +1,10 @@
 #include "../../include/gateway_esp32/sd_manager.h"
 
-SDManager::SDManager() : _ready(false), _bytesSinceFlush(0) {}
+#include "../../include/gateway_esp32/transcode.h"
+
+SDManager::SDManager() : _ready(false), _pool(nullptr), _bytesSinceFlush(0) {}
+
+void SDManager::setBufferPool(BufferPool* pool) { _pool = pool; }
 
 bool SDManager::begin(int maxRetries) {
   if (_ready) return true;
@@ -76,6 +80,7 @@ bool SDManager::openForWrite(const char* filename) {
 bool SDManager::writeChunk(const uint8_t* data, size_t len) {
   if (!_ready || !_file) return false;
 
+  if (_pool) _pool->noteTransfer(data);
   size_t written = _file.write(data, len);
 
   // Safety Check
@@ -109,6 +114,35 @@ void SDManager::closeFile() {
   _bytesSinceFlush = 0;
 }
 
+// Independent of the streaming writer above, and without its cool-down,
+// so it can run while a download is open or right before playback
+bool SDManager::writeFile(const char* filename, const uint8_t* data,
+                          size_t len) {
+  if (!_ready) return false;
+  if (SD.exists(filename)) SD.remove(filename);
+
+  File f = SD.open(filename, FILE_WRITE);
+  if (!f) {
+    Serial.printf("[SD] Failed to open %s for writing\n", filename);
+    return false;
+  }
+  size_t written = f.write(data, len);
+  f.close();
+  return written == len;
+}
+
+// ================= FILE READING =================
+
+File SDManager::openForRead(const char* filename) {
+  if (!_ready || !SD.exists(filename)) return File();
+  return SD.open(filename, FILE_READ);
+}
+
+File SDManager::openForUpdate(const char* filename) {
+  if (!_ready) return File();
+  return SD.open(filename, SD.exists(filename) ? "r+" : "w+");
+}
+
 // ================= FILE MANAGEMENT =================
 
 String SDManager::listAudioFiles() {
@@ -122,7 +156,8 @@ String SDManager::listAudioFiles() {
   while (file) {
     if (!file.isDirectory()) {
       String n = file.name();
-      if (n.endsWith(".mp3") || n.endsWith(".wav")) {
+      if ((n.endsWith(".mp3") || n.endsWith(".wav")) &&
+          !n.endsWith(".mp3" TRANSCODE_SUFFIX)) {
         if (!first) result += ",";
         result += n;
         first = false;
@@ -142,6 +177,12 @@ void SDManager::remove(const char* filename) {
   if (_ready && SD.exists(filename)) SD.remove(filename);
 }
 
+bool SDManager::rename(const char* from, const char* to) {
+  if (!_ready || !SD.exists(from)) return false;
+  if (SD.exists(to)) SD.remove(to);
+  return SD.rename(from, to);
+}
+
 size_t SDManager::getFileSize(const char* filename) {
   if (!_ready || !SD.exists(filename)) return 0;
   File f = SD.open(filename, "r");
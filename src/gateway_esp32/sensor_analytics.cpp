@@ -0,0 +1,245 @@
+#include "../../include/gateway_esp32/sensor_analytics.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// SignalStats
+// ============================================================================
+
+float SignalStats::stddev() const { return sqrtf(variance()); }
+
+void SignalStats::update(float x) {
+  count++;
+  last = x;
+
+  // EWMA and Welford mean/variance
+  if (count == 1) {
+    ewma = mean = median = x;
+    m2 = mad = 0.0f;
+  } else {
+    ewma += ANALYTICS_EWMA_ALPHA * (x - ewma);
+    float delta = x - mean;
+    mean += delta / count;
+    m2 += delta * (x - mean);
+  }
+
+  if (count <= ANALYTICS_WARMUP) {
+    // Seed the robust estimators from the plain ones
+    median = mean;
+    mad = 0.6745f * stddev();
+    z = 0.0f;
+    anomaly = false;
+    return;
+  }
+
+  // Robust z-score against the state before this sample
+  float scale = mad > 1e-6f ? mad : 1e-6f;
+  z = 0.6745f * (x - median) / scale;
+  anomaly = fabsf(z) > ANALYTICS_Z_THRESHOLD;
+
+  // Stochastic-approximation median and MAD: each moves a small step
+  // proportional to the current spread towards the sample, which converges
+  // to the quantiles without keeping a window
+  float step = ANALYTICS_ROBUST_STEP * scale;
+  median += (x > median) ? step : (x < median ? -step : 0.0f);
+  float dev = fabsf(x - median);
+  mad *= (dev > mad) ? (1.0f + ANALYTICS_ROBUST_STEP)
+                     : (1.0f - ANALYTICS_ROBUST_STEP);
+  float floor = 1e-4f * fabsf(median) + 1e-4f;
+  if (mad < floor) mad = floor;
+}
+
+// ============================================================================
+// SensorAnalytics
+// ============================================================================
+
+SensorAnalytics::SensorAnalytics()
+    : dewPoint(NAN),
+      heatIndex(NAN),
+      slotHead(0),
+      slotsFilled(0),
+      bucketStartMs(0),
+      bucketSum(0.0f),
+      bucketCount(0) {
+  memset(signals, 0, sizeof(signals));
+  memset(pressureSlots, 0, sizeof(pressureSlots));
+}
+
+void SensorAnalytics::update(Signal signal, float value) {
+  if (isnan(value)) return;
+  signals[signal].update(value);
+}
+
+void SensorAnalytics::updateRemote(const SensorData& data, uint32_t nowMs) {
+  update(SIG_TEMPERATURE, data.temperature);
+  update(SIG_HUMIDITY, data.humidity);
+  update(SIG_UV, data.uvIndex);
+
+  // Nodes report 0 hPa when the BMP180 is missing
+  if (data.pressure > 300.0f) {
+    update(SIG_PRESSURE, data.pressure);
+    updatePressureHistory(data.pressure, nowMs);
+  }
+
+  dewPoint = computeDewPoint(data.temperature, data.humidity);
+  heatIndex = computeHeatIndex(data.temperature, data.humidity);
+}
+
+void SensorAnalytics::updatePressureHistory(float hpa, uint32_t nowMs) {
+  if (bucketCount == 0) bucketStartMs = nowMs;
+  bucketSum += hpa;
+  bucketCount++;
+
+  if (nowMs - bucketStartMs < PRESSURE_BUCKET_MS) return;
+
+  pressureSlots[slotHead] = bucketSum / bucketCount;
+  slotHead = (slotHead + 1) % PRESSURE_SLOTS;
+  if (slotsFilled < PRESSURE_SLOTS) slotsFilled++;
+  bucketSum = 0.0f;
+  bucketCount = 0;
+}
+
+PressureTendency SensorAnalytics::getTendency(float* deltaHpa) const {
+  if (slotsFilled < PRESSURE_SLOTS) return TENDENCY_UNKNOWN;
+
+  // slotHead is the oldest slot once the ring is full
+  float oldest = pressureSlots[slotHead];
+  float newest = pressureSlots[(slotHead + PRESSURE_SLOTS - 1) % PRESSURE_SLOTS];
+  float delta = newest - oldest;
+  if (deltaHpa) *deltaHpa = delta;
+
+  // hPa per 3 h, thresholds as used for barometric tendency reports
+  if (delta <= -3.5f) return TENDENCY_FALLING_FAST;
+  if (delta <= -1.0f) return TENDENCY_FALLING;
+  if (delta < 1.0f) return TENDENCY_STEADY;
+  if (delta < 3.5f) return TENDENCY_RISING;
+  return TENDENCY_RISING_FAST;
+}
+
+bool SensorAnalytics::anyAnomaly() const {
+  for (int i = 0; i < SIG_COUNT; i++) {
+    if (signals[i].anomaly) return true;
+  }
+  return false;
+}
+
+// Magnus formula (Sonntag 1990 constants), valid -45..60 °C
+float SensorAnalytics::computeDewPoint(float tempC, float humidity) {
+  if (isnan(tempC) || isnan(humidity) || humidity <= 0.0f) return NAN;
+  const float a = 17.62f, b = 243.12f;
+  float gamma = logf(humidity / 100.0f) + a * tempC / (b + tempC);
+  return b * gamma / (a - gamma);
+}
+
+// NOAA heat index (Rothfusz regression with the NWS adjustments)
+float SensorAnalytics::computeHeatIndex(float tempC, float humidity) {
+  if (isnan(tempC) || isnan(humidity)) return NAN;
+  float t = tempC * 1.8f + 32.0f;
+  float rh = humidity;
+
+  float hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+  if ((hi + t) / 2.0f >= 80.0f) {
+    hi = -42.379f + 2.04901523f * t + 10.14333127f * rh -
+         0.22475541f * t * rh - 0.00683783f * t * t -
+         0.05481717f * rh * rh + 0.00122874f * t * t * rh +
+         0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+    if (rh < 13.0f && t >= 80.0f && t <= 112.0f) {
+      hi -= ((13.0f - rh) / 4.0f) * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+    } else if (rh > 85.0f && t >= 80.0f && t <= 87.0f) {
+      hi += ((rh - 85.0f) / 10.0f) * ((87.0f - t) / 5.0f);
+    }
+  }
+  return (hi - 32.0f) / 1.8f;
+}
+
+const char* SensorAnalytics::tendencyName(PressureTendency t) {
+  switch (t) {
+    case TENDENCY_FALLING_FAST:
+      return "falling_fast";
+    case TENDENCY_FALLING:
+      return "falling";
+    case TENDENCY_STEADY:
+      return "steady";
+    case TENDENCY_RISING:
+      return "rising";
+    case TENDENCY_RISING_FAST:
+      return "rising_fast";
+    default:
+      return "unknown";
+  }
+}
+
+size_t SensorAnalytics::toJson(char* buf, size_t len) const {
+  static const char* names[SIG_COUNT] = {"temperature", "humidity",
+                                         "pressure", "uv", "light",
+                                         "noise"};
+  float delta = 0.0f;
+  PressureTendency tendency = getTendency(&delta);
+
+  int pos = snprintf(buf, len,
+                     "{\"dew_point\":%.2f,\"heat_index\":%.2f,"
+                     "\"pressure_3h\":%.2f,\"tendency\":\"%s\"",
+                     isnan(dewPoint) ? 0.0f : dewPoint,
+                     isnan(heatIndex) ? 0.0f : heatIndex, delta,
+                     tendencyName(tendency));
+
+  for (int i = 0; i < SIG_COUNT && pos > 0 && (size_t)pos < len; i++) {
+    const SignalStats& s = signals[i];
+    if (s.count == 0) continue;
+    pos += snprintf(buf + pos, len - pos,
+                    ",\"%s\":{\"ewma\":%.2f,\"mean\":%.2f,\"std\":%.3f,"
+                    "\"z\":%.2f,\"anomaly\":%s}",
+                    names[i], s.ewma, s.mean, s.stddev(), s.z,
+                    s.anomaly ? "true" : "false");
+  }
+  if (pos > 0 && (size_t)pos < len) pos += snprintf(buf + pos, len - pos, "}");
+  return (pos > 0 && (size_t)pos < len) ? pos : 0;
+}
+
+// ============================================================================
+// NodeAnalyticsTable
+// ============================================================================
+
+NodeAnalyticsTable::NodeAnalyticsTable() {
+  for (int i = 0; i < ANALYTICS_MAX_NODES; i++) {
+    slots[i].used = false;
+    slots[i].nodeId = 0;
+    slots[i].lastMs = 0;
+  }
+}
+
+SensorAnalytics& NodeAnalyticsTable::forNode(uint8_t nodeId, uint32_t nowMs) {
+  Slot* slot = nullptr;
+  for (int i = 0; i < ANALYTICS_MAX_NODES; i++) {
+    if (slots[i].used && slots[i].nodeId == nodeId) {
+      slot = &slots[i];
+      break;
+    }
+  }
+
+  if (!slot) {
+    slot = &slots[0];
+    for (int i = 0; i < ANALYTICS_MAX_NODES; i++) {
+      if (!slots[i].used) {
+        slot = &slots[i];
+        break;
+      }
+      if (nowMs - slots[i].lastMs > nowMs - slot->lastMs) slot = &slots[i];
+    }
+    slot->used = true;
+    slot->nodeId = nodeId;
+    slot->analytics = SensorAnalytics();
+  }
+
+  slot->lastMs = nowMs;
+  return slot->analytics;
+}
+
+const SensorAnalytics* NodeAnalyticsTable::find(uint8_t nodeId) const {
+  for (int i = 0; i < ANALYTICS_MAX_NODES; i++) {
+    if (slots[i].used && slots[i].nodeId == nodeId) return &slots[i].analytics;
+  }
+  return nullptr;
+}
@@ -1,6 +1,43 @@
 #include "../../include/gateway_esp32/sensor_manager.h"
 
+#include <driver/i2s.h>
+#include <esp_timer.h>
+
+#include "../../include/gateway_esp32/memory_map.h"
 #include "../../include/gateway_esp32/mqtt_manager.h"
+#include "../../include/gateway_esp32/noise_monitor.h"
+
+// ============================================================================
+// MICROPHONE
+// ============================================================================
+// Non-blocking read of what the DMA holds; the INMP441's 24 bits sit at the
+// top of each 32-bit slot
+static size_t micRead(void*, int32_t* samples, size_t max) {
+  size_t bytes = 0;
+  if (i2s_read(MIC_I2S_PORT, samples, max * sizeof(int32_t), &bytes, 0) !=
+      ESP_OK) {
+    return 0;
+  }
+  size_t n = bytes / sizeof(int32_t);
+  for (size_t i = 0; i < n; i++) samples[i] >>= 8;
+  return n;
+}
+
+// Without SCK the INMP441 sleeps (under 1 uA)
+static void micPower(void*, bool on) {
+  if (on) {
+    i2s_start(MIC_I2S_PORT);
+  } else {
+    i2s_stop(MIC_I2S_PORT);
+  }
+}
+
+static uint32_t micClockUs() { return (uint32_t)esp_timer_get_time(); }
+
+static NoiseMonitor noiseMonitor(micRead, micPower, micClockUs, nullptr);
+
+static_assert(sizeof(noiseMonitor) <= RAM_BUDGET_SENSOR_MANAGER,
+              "Noise monitor exceeds RAM_BUDGET_SENSOR_MANAGER");
 
 SensorManager::SensorManager(uint8_t bh1750Address)
     : lightSensor(bh1750Address),
@@ -8,6 +45,8 @@ SensorManager::SensorManager(uint8_t bh1750Address)
       currentLightIntensity(0.0),
       lastReadTime(0),
       lightValid(false),
+      micReady(false),
+      noiseValid(false),
       isQuiet(false) {}
 
 void SensorManager::begin(TCA9548A* tcaMultiplexer, bool quiet) {
@@ -93,3 +132,69 @@ void SensorManager::publishToMQTT(MQTTManager& mqtt, const char* lightTopic) {
     Serial.println("[SensorManager] Light data published to MQTT");
   }
 }
+
+// ============================================================================
+// AMBIENT NOISE
+// ============================================================================
+bool SensorManager::beginNoise() {
+  i2s_config_t config = {};
+  config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX);
+  config.sample_rate = NOISE_RATE_HZ;
+  config.bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT;
+  config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+  config.dma_buf_count = MIC_DMA_BUFFERS;
+  config.dma_buf_len = MIC_DMA_FRAMES;
+
+  i2s_pin_config_t pins = {};
+  pins.bck_io_num = MIC_SCK_PIN;
+  pins.ws_io_num = MIC_WS_PIN;
+  pins.data_out_num = I2S_PIN_NO_CHANGE;
+  pins.data_in_num = MIC_SD_PIN;
+
+  if (i2s_driver_install(MIC_I2S_PORT, &config, 0, nullptr) != ESP_OK) {
+    Serial.println("[SensorManager] ✗ Microphone I2S install failed");
+    return false;
+  }
+  if (i2s_set_pin(MIC_I2S_PORT, &pins) != ESP_OK) {
+    i2s_driver_uninstall(MIC_I2S_PORT);
+    Serial.println("[SensorManager] ✗ Microphone pins failed");
+    return false;
+  }
+  i2s_stop(MIC_I2S_PORT);  // Asleep until the first window
+  micReady = true;
+  Serial.printf("[SensorManager] ✓ Noise monitor: %d ms every %d s\n",
+                NOISE_WINDOW_FRAMES * 1000 / NOISE_RATE_HZ,
+                NOISE_PERIOD_MS / 1000);
+  return true;
+}
+
+bool SensorManager::pollNoise(uint32_t nowMs) {
+  if (!micReady || !noiseMonitor.poll(nowMs)) return false;
+  noiseValid = true;
+  if (!isQuiet) {
+    const NoiseLevels& l = noiseMonitor.levels();
+    Serial.printf("[SensorManager] Noise=%.1f dB SPL (peak %.1f)\n",
+                  l.rmsDb8 / 8.0f + NOISE_SPL_OFFSET_DB,
+                  l.peakDb8 / 8.0f + NOISE_SPL_OFFSET_DB);
+  }
+  return true;
+}
+
+bool SensorManager::isNoiseValid() const { return noiseValid; }
+
+float SensorManager::getNoiseLevel() const {
+  return noiseMonitor.levels().rmsDb8 / 8.0f + NOISE_SPL_OFFSET_DB;
+}
+
+void SensorManager::publishNoise(MQTTManager& mqtt, const char* noiseTopic) {
+  if (!mqtt.isConnected() || !noiseValid) {
+    return;
+  }
+
+  char json[192];
+  if (noiseMonitor.toJson(json, sizeof(json), millis()) > 0) {
+    mqtt.publish(noiseTopic, json);
+  }
+}
@@ -0,0 +1,159 @@
+#include "../../include/gateway_esp32/spectrum.h"
+
+#include <math.h>
+#include <string.h>
+
+#define HALF (SPECTRUM_FFT_SIZE / 2)  // Complex FFT size
+#define QUARTER (SPECTRUM_FFT_SIZE / 4)
+
+static_assert((SPECTRUM_FFT_SIZE & (SPECTRUM_FFT_SIZE - 1)) == 0,
+              "SPECTRUM_FFT_SIZE must be a power of two");
+
+// Q15 product, rounded. Callers only pass rotations of values below 2^16,
+// so the sums of two products stay inside int32.
+static inline int32_t mulQ15(int32_t a, int32_t b) {
+  return (a * b + 0x4000) >> 15;
+}
+
+// ============================================================================
+// TRANSFORM
+// ============================================================================
+void spectrumTables(int16_t* twiddle, int16_t* window) {
+  for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+    twiddle[i] =
+        (int16_t)lrint(32767.0 * sin(2.0 * M_PI * i / SPECTRUM_FFT_SIZE));
+    window[i] = (int16_t)lrint(
+        32767.0 * 0.5 * (1.0 - cos(2.0 * M_PI * i / SPECTRUM_FFT_SIZE)));
+  }
+}
+
+void spectrumFft(const int16_t* in, const int16_t* twiddle, int32_t* re,
+                 int32_t* im) {
+  // Even samples as real, odd as imaginary, in bit-reversed order
+  const int bits = __builtin_ctz(HALF);
+  for (uint32_t i = 0; i < HALF; i++) {
+    uint32_t r = 0;
+    for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+    re[r] = in[2 * i];
+    im[r] = in[2 * i + 1];
+  }
+
+  // Radix-2 butterflies, W = cos - j sin, halved every stage
+  for (uint32_t span = 1; span < HALF; span <<= 1) {
+    uint32_t step = SPECTRUM_FFT_SIZE / (2 * span);  // Twiddle stride
+    for (uint32_t j = 0; j < span; j++) {
+      int32_t s = twiddle[j * step];
+      int32_t c = twiddle[(j * step + QUARTER) & (SPECTRUM_FFT_SIZE - 1)];
+      for (uint32_t a = j; a < HALF; a += 2 * span) {
+        uint32_t b = a + span;
+        int32_t tr = mulQ15(re[b], c) + mulQ15(im[b], s);
+        int32_t ti = mulQ15(im[b], c) - mulQ15(re[b], s);
+        re[b] = (re[a] - tr) >> 1;
+        im[b] = (im[a] - ti) >> 1;
+        re[a] = (re[a] + tr) >> 1;
+        im[a] = (im[a] + ti) >> 1;
+      }
+    }
+  }
+
+  // Split: X[k] = E[k] + W^k (-j) O[k], with E and O from Z[k] and
+  // conj(Z[N/2 - k]). Bins k and N/2 - k come from the same pair, so both
+  // are done at once, in place.
+  int32_t zr = re[0], zi = im[0];
+  re[0] = (zr + zi) >> 1;
+  im[0] = 0;
+  re[HALF] = (zr - zi) >> 1;
+  im[HALF] = 0;
+  for (uint32_t k = 1; k <= HALF / 2; k++) {
+    uint32_t m = HALF - k;
+    int32_t er = (re[k] + re[m]) >> 1, ei = (im[k] - im[m]) >> 1;
+    int32_t odr = (re[k] - re[m]) >> 1, odi = (im[k] + im[m]) >> 1;
+    int32_t s = twiddle[k];
+    int32_t c = twiddle[k + QUARTER];
+    int32_t pr = mulQ15(odi, c) - mulQ15(odr, s);
+    int32_t pi = -mulQ15(odr, c) - mulQ15(odi, s);
+    re[k] = (er + pr) >> 1;
+    im[k] = (ei + pi) >> 1;
+    if (m != k) {
+      re[m] = (er - pr) >> 1;
+      im[m] = (-ei + pi) >> 1;
+    }
+  }
+}
+
+// ============================================================================
+// BARS
+// ============================================================================
+// Octave-wide bars from the second bin up; at 44.1 kHz a bin is 172 Hz, so
+// the first bars are single bins and the last spans the top octave
+uint32_t Spectrum::bandStart(int bar) {
+  static const uint8_t start[SPECTRUM_BARS + 1] = {1, 2, 3, 5, 9, 17, 33, 65,
+                                                   SPECTRUM_BINS};
+  return start[bar];
+}
+
+// Good enough for a 20-pixel bar, and for level decisions elsewhere
+int32_t spectrumPowerDb8(uint64_t p) {
+  if (!p) return INT32_MIN / 2;
+  int msb = 63 - __builtin_clzll(p);
+  uint32_t frac = msb >= 8 ? (uint32_t)(p >> (msb - 8)) & 0xFF
+                           : (uint32_t)(p << (8 - msb)) & 0xFF;
+  int32_t log2q8 = msb * 256 + (int32_t)frac;
+  return log2q8 * 6165 / 65536;  // 8 * 10 log10(2) / 256 = 6165/65536
+}
+
+Spectrum::Spectrum() : state(IDLE), fill(0) {
+  spectrumTables(twiddle, window);
+  memset(bars, 0, sizeof(bars));
+}
+
+void Spectrum::capture(const uint32_t* frames, uint32_t count) {
+  if (state.load(std::memory_order_acquire) != CAPTURING) return;
+  uint32_t n = SPECTRUM_FFT_SIZE - fill;
+  if (count < n) n = count;
+  for (uint32_t i = 0; i < n; i++) {
+    int32_t mid = (int16_t)(frames[i] & 0xFFFF) + (int16_t)(frames[i] >> 16);
+    samples[fill++] = (int16_t)(mid >> 1);
+  }
+  if (fill == SPECTRUM_FFT_SIZE) state.store(READY, std::memory_order_release);
+}
+
+bool Spectrum::update(uint8_t* levels) {
+  uint8_t now = state.load(std::memory_order_acquire);
+  bool fresh = now == READY;
+  int32_t level[SPECTRUM_BARS] = {0};
+  if (fresh) {
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+      samples[i] = (int16_t)mulQ15(samples[i], window[i]);
+    }
+    spectrumFft(samples, twiddle, re, im);
+
+    // A full-scale sine through the Hann window peaks at 32768 / 4 per bin:
+    // power 2^26 is 0 dB
+    const int32_t fullScale = spectrumPowerDb8(1ull << 26);
+    for (int b = 0; b < SPECTRUM_BARS; b++) {
+      uint64_t sum = 0;
+      for (uint32_t k = bandStart(b); k < bandStart(b + 1); k++) {
+        sum += (uint64_t)((int64_t)re[k] * re[k] + (int64_t)im[k] * im[k]);
+      }
+      int32_t db8 = spectrumPowerDb8(sum) - fullScale + SPECTRUM_RANGE_DB * 8;
+      if (db8 < 0) db8 = 0;
+      if (db8 > SPECTRUM_RANGE_DB * 8) db8 = SPECTRUM_RANGE_DB * 8;
+      level[b] = db8 * 255 / (SPECTRUM_RANGE_DB * 8);
+    }
+  }
+
+  // Rise at once, fall slowly so the bars are readable
+  for (int b = 0; b < SPECTRUM_BARS; b++) {
+    int32_t fallen = bars[b] > SPECTRUM_FALL ? bars[b] - SPECTRUM_FALL : 0;
+    bars[b] = (uint8_t)(level[b] > fallen ? level[b] : fallen);
+    levels[b] = bars[b];
+  }
+
+  // fill belongs to the writer while a capture runs
+  if (now != CAPTURING) {
+    fill = 0;
+    state.store(CAPTURING, std::memory_order_release);
+  }
+  return fresh;
+}
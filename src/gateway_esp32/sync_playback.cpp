@@ -0,0 +1,372 @@
+#include "../../include/gateway_esp32/sync_playback.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int32_t clampI32(int64_t v) {
+  if (v > INT32_MAX) return INT32_MAX;
+  if (v < INT32_MIN) return INT32_MIN;
+  return (int32_t)v;
+}
+
+static int64_t absI64(int64_t v) { return v < 0 ? -v : v; }
+
+// ============================================================================
+// SHARED CLOCK
+// ============================================================================
+SyncClock::SyncClock()
+    : role(ROLE_FREE),
+      started(false),
+      hasTime(false),
+      lockCount(0),
+      spikeCount(0),
+      spikeError(0),
+      anchorUs(0),
+      offsetUs(0),
+      skew(0),
+      slew(0),
+      lastBeaconUs(0),
+      lastTickUs(0),
+      lastUpdateUs(0),
+      seq(0),
+      filterCount(0),
+      filterBest(0),
+      filterBestUs(0),
+      lastError(0),
+      beaconCount(0),
+      stepCount(0) {
+  memset(mac, 0, sizeof(mac));
+  memset(masterMac, 0, sizeof(masterMac));
+}
+
+void SyncClock::begin(const uint8_t* ownMac) { memcpy(mac, ownMac, 6); }
+
+int64_t SyncClock::toShared(int64_t localUs) const {
+  return localUs + offsetUs + (localUs - anchorUs) * skew / 1000000000;
+}
+
+void SyncClock::reanchor(int64_t localUs) {
+  offsetUs += (localUs - anchorUs) * skew / 1000000000;
+  anchorUs = localUs;
+}
+
+bool SyncClock::synced() const {
+  if (role == ROLE_MASTER) return hasTime;
+  return role == ROLE_FOLLOWER && lockCount >= SYNC_LOCK_UPDATES;
+}
+
+bool SyncClock::tick(int64_t localUs, int64_t utcUs, SyncBeacon* out) {
+  if (!started) {
+    started = true;  // Listen for a master first
+    lastTickUs = lastBeaconUs = localUs;
+    return false;
+  }
+  if (localUs - lastTickUs < SYNC_BEACON_INTERVAL_MS * 1000LL) return false;
+  int64_t elapsed = localUs - lastTickUs;
+  lastTickUs = localUs;
+
+  // Nobody (left) to follow: this gateway keeps the time from now on
+  if (role != ROLE_MASTER &&
+      localUs - lastBeaconUs >= SYNC_MASTER_TIMEOUT_MS * 1000LL) {
+    role = ROLE_MASTER;
+    filterCount = 0;
+  }
+
+  // Without a master to follow, the shared time goes toward SNTP time
+  if (utcUs && role != ROLE_FOLLOWER) {
+    int64_t d = utcUs - toShared(localUs);
+    reanchor(localUs);
+    if (!hasTime || absI64(d) > SYNC_UTC_STEP_US) {
+      offsetUs += d;
+      hasTime = true;
+      slew = 0;
+    } else {
+      int64_t limit = elapsed * SYNC_UTC_SLEW_PPM / 1000000;
+      int64_t step = d > limit ? limit : d < -limit ? -limit : d;
+      offsetUs += step;
+      slew = (int32_t)(step * 1000000000 / elapsed);
+    }
+  }
+
+  if (role != ROLE_MASTER || !hasTime) return false;
+  out->magic = SYNC_MAGIC;
+  out->version = SYNC_VERSION;
+  out->seq = seq++;
+  out->sharedUs = toShared(localUs);
+  return true;
+}
+
+// A new master after a takeover keeps the time it followed: a locked loop
+// stays locked and only its filter starts over
+void SyncClock::follow(const uint8_t* master) {
+  memcpy(masterMac, master, 6);
+  role = ROLE_FOLLOWER;
+  slew = 0;
+  filterCount = 0;
+  spikeCount = 0;
+}
+
+void SyncClock::onBeacon(const uint8_t* from, const SyncBeacon& beacon,
+                         int64_t localUs) {
+  if (memcmp(from, mac, 6) == 0) return;
+  if (role != ROLE_FOLLOWER || memcmp(from, masterMac, 6) != 0) {
+    // The lowest MAC heard is master
+    if (role == ROLE_MASTER && memcmp(from, mac, 6) > 0) return;
+    if (role == ROLE_FOLLOWER && memcmp(from, masterMac, 6) > 0) return;
+    follow(from);
+  }
+  lastBeaconUs = localUs;
+  beaconCount++;
+
+  int64_t error = beacon.sharedUs + SYNC_AIR_US - toShared(localUs);
+  if (!lastUpdateUs) {
+    // Anything is closer than where it was
+    discipline(error, localUs, localUs);
+    filterCount = 0;
+    return;
+  }
+  if (!filterCount || error > filterBest) {
+    filterBest = clampI32(error);
+    filterBestUs = localUs;
+  }
+  if (++filterCount < SYNC_FILTER_BEACONS) return;
+  filterCount = 0;
+  // Every beacon of a group queued is rare, and queueing delays differ:
+  // SYNC_SPIKE_GROUPS in a row that agree, it is the mapping that is off
+  int32_t spike = lockCount >= SYNC_LOCK_UPDATES ? SYNC_SPIKE_US : SYNC_STEP_US;
+  if (absI64(filterBest) > spike) {
+    if (absI64((int64_t)filterBest - spikeError) > SYNC_SPIKE_US) {
+      spikeCount = 0;
+    }
+    spikeError = filterBest;
+    if (++spikeCount < SYNC_SPIKE_GROUPS) return;
+  }
+  spikeCount = 0;
+  discipline(filterBest, filterBestUs, localUs);
+}
+
+// errorUs as measured at localUs, by the group that ended at endUs. The
+// frequency is measured between group ends: the best beacons of two groups
+// in a row can be a second apart, too short to tell drift from jitter.
+void SyncClock::discipline(int64_t errorUs, int64_t localUs, int64_t endUs) {
+  lastError = clampI32(errorUs);
+  reanchor(localUs);
+  if (!lastUpdateUs || absI64(errorUs) > SYNC_STEP_US) {
+    offsetUs += errorUs;
+    hasTime = true;
+    lockCount = 0;
+    stepCount++;
+    lastUpdateUs = endUs;
+    return;
+  }
+  int64_t dt = endUs - lastUpdateUs;
+  lastUpdateUs = endUs;
+  if (dt <= 0) return;
+  // A step can be off by a queued beacon's delay: the first update after
+  // it only corrects the phase, the second measures the frequency, from
+  // then on a phase and frequency loop
+  int64_t drift = errorUs * 1000000000 / dt;
+  if (lockCount == 0) {
+    offsetUs += errorUs;
+  } else if (lockCount == 1) {
+    offsetUs += errorUs;
+    skew = clampI32(skew + drift);
+  } else {
+    offsetUs += errorUs / 2;
+    skew = clampI32(skew + drift / 8);
+  }
+  if (lockCount < SYNC_LOCK_UPDATES) lockCount++;
+}
+
+size_t SyncClock::toJson(char* buf, size_t len) const {
+  static const char* const roles[] = {"free", "follower", "master"};
+  const uint8_t* m = role == ROLE_FOLLOWER ? masterMac : mac;
+  int n = snprintf(buf, len,
+                   "{\"role\":\"%s\",\"master\":\"%02X:%02X:%02X:%02X:%02X:"
+                   "%02X\",\"synced\":%s,\"error_us\":%d,\"skew_ppb\":%d,"
+                   "\"beacons\":%u,\"steps\":%u}",
+                   roles[role], m[0], m[1], m[2], m[3], m[4], m[5],
+                   synced() ? "true" : "false", (int)lastError, (int)skew,
+                   (unsigned)beaconCount, (unsigned)stepCount);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
+
+// ============================================================================
+// PLAYOUT
+// ============================================================================
+SyncPlayout::SyncPlayout() { disarm(); }
+
+void SyncPlayout::disarm() {
+  state = IDLE;
+  startUs = 0;
+  rate = 0;
+  bufferFrames = 0;
+  queueFrames = 0;
+  refUs = 0;
+  written = 0;
+  track = 0;
+  silence = 0;
+  skip = 0;
+  error = 0;
+  trim = 0;
+  untilTrim = 0;
+  waiting = false;
+  lateFrames = 0;
+  dryFrames = 0;
+  repeats = 0;
+  drops = 0;
+  resyncs = 0;
+}
+
+void SyncPlayout::arm(int64_t start, uint32_t rateHz, uint32_t buffer,
+                      uint32_t queue) {
+  disarm();
+  state = PREROLL;
+  startUs = start;
+  rate = rateHz;
+  bufferFrames = buffer;
+  queueFrames = queue;
+}
+
+// Frames in us microseconds, rounded to nearest
+int64_t SyncPlayout::framesAt(int64_t us) const {
+  int64_t scaled = us * rate;
+  return (scaled + (scaled < 0 ? -500000 : 500000)) / 1000000;
+}
+
+bool SyncPlayout::alignDue(int64_t sharedUs) const {
+  int64_t lead = (int64_t)(queueFrames + SYNC_ALIGN_BUFFERS * bufferFrames) *
+                 1000000 / rate;
+  return state == PREROLL && startUs - sharedUs <= lead;
+}
+
+bool SyncPlayout::align(int64_t sharedUs, int64_t localUs) {
+  // At a buffer boundary the DAC starts the oldest queued frame, and the
+  // next frame written plays after all of them
+  int64_t gap = framesAt(startUs - sharedUs) - queueFrames;
+  if (gap >= bufferFrames) return false;
+  refUs = localUs;
+  written = queueFrames;
+  if (gap >= 0) {
+    silence = (uint32_t)gap;
+  } else {
+    skip = lateFrames = (uint32_t)-gap;  // Joined late: in step, not behind
+  }
+  state = PLAYING;
+  return true;
+}
+
+static uint32_t trimInterval(int32_t ppm) {
+  return 1000000 / (uint32_t)(ppm < 0 ? -ppm : ppm);
+}
+
+void SyncPlayout::update(int64_t sharedUs, int64_t localUs, int32_t skewPpb) {
+  if (state != PLAYING) return;
+  // Frames the DAC has taken: when more than were written, it played
+  // silence from an empty DMA (the I2S driver clears played buffers)
+  int64_t dac = framesAt(localUs - refUs);
+  bool dry = dac > (int64_t)written;
+  // With the DMA empty, or about to be, right at a boundary the DMA may or
+  // may not have moved on by the time the write lands: one buffer of doubt
+  int64_t into = dac % bufferFrames;
+  waiting = dac + SYNC_DRY_GUARD_FRAMES > (int64_t)written &&
+            (into < SYNC_DRY_GUARD_FRAMES ||
+             into > (int64_t)bufferFrames - SYNC_DRY_GUARD_FRAMES);
+  if (waiting) return;
+  if (dry) {
+    // What is written next plays from the buffer after the DAC's on
+    int64_t next = (dac / bufferFrames + 1) * bufferFrames;
+    dryFrames += (uint32_t)(next - (int64_t)written);
+    written = (uint64_t)next;
+  }
+  int64_t atDac = track - ((int64_t)written - dac);
+  int64_t err = atDac - framesAt(sharedUs - startUs);
+  error = clampI32(err);
+
+  // Silence or skipped frames put the next frame written in step: after an
+  // underrun, or when further off than trimming catches up with. A plan
+  // still being carried out is redone, the DAC may have run dry meanwhile.
+  const int64_t resync = (int64_t)rate * SYNC_RESYNC_MS / 1000;
+  bool planned = silence || skip;
+  if (planned || dry || err <= -resync || err >= resync) {
+    silence = err > 0 ? (uint32_t)err : 0;
+    skip = err < 0 ? (uint32_t)-err : 0;
+    trim = 0;
+    if (!planned) resyncs++;
+    return;
+  }
+
+  // The DAC runs on the local clock: the clock's skew, plus the error
+  // spread over the horizon
+  int64_t ppm = -skewPpb / 1000 +
+                err * 1000000 * 1000 / ((int64_t)rate * SYNC_TRIM_HORIZON_MS);
+  if (ppm > SYNC_TRIM_MAX_PPM) ppm = SYNC_TRIM_MAX_PPM;
+  if (ppm < -SYNC_TRIM_MAX_PPM) ppm = -SYNC_TRIM_MAX_PPM;
+  trim = (int32_t)ppm;
+  if (trim && (!untilTrim || untilTrim > trimInterval(trim))) {
+    untilTrim = trimInterval(trim);
+  }
+}
+
+SyncAction SyncPlayout::next(uint32_t* frames) const {
+  if (waiting) {
+    *frames = 0;
+    return SYNC_WAIT;
+  }
+  if (silence) {
+    *frames = silence;
+    return SYNC_SILENCE;
+  }
+  if (skip) {
+    *frames = skip;
+    return SYNC_SKIP;
+  }
+  if (trim && !untilTrim) {
+    *frames = 1;
+    return trim > 0 ? SYNC_REPEAT : SYNC_DROP;
+  }
+  *frames = trim ? untilTrim : UINT32_MAX;
+  return SYNC_COPY;
+}
+
+void SyncPlayout::done(SyncAction action, uint32_t frames) {
+  switch (action) {
+    case SYNC_COPY:
+      written += frames;
+      track += frames;
+      if (trim) untilTrim -= frames < untilTrim ? frames : untilTrim;
+      break;
+    case SYNC_SILENCE:
+      written += frames;
+      silence -= frames;
+      break;
+    case SYNC_SKIP:
+      track += frames;
+      skip -= frames;
+      break;
+    case SYNC_REPEAT:
+      written += frames;
+      repeats += frames;
+      untilTrim = trimInterval(trim);
+      break;
+    case SYNC_DROP:
+      track += frames;
+      drops += frames;
+      untilTrim = trimInterval(trim);
+      break;
+    case SYNC_WAIT:
+      break;
+  }
+}
+
+size_t SyncPlayout::toJson(char* buf, size_t len) const {
+  static const char* const states[] = {"idle", "preroll", "playing"};
+  int n = snprintf(buf, len,
+                   "{\"state\":\"%s\",\"error_frames\":%d,\"trim_ppm\":%d,"
+                   "\"late_frames\":%u,\"dry_frames\":%u,\"repeats\":%u,"
+                   "\"drops\":%u,\"resyncs\":%u}",
+                   states[state], (int)error, (int)trim, (unsigned)lateFrames,
+                   (unsigned)dryFrames, (unsigned)repeats, (unsigned)drops,
+                   (unsigned)resyncs);
+  return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,338 @@
+#include "../../include/gateway_esp32/transcode.h"
+
+#include <string.h>
+
+// ============================================================================
+// IMA ADPCM
+// ============================================================================
+static const int16_t kStep[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t kIndexStep[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// Apply one 4-bit code; the encoder runs the same step so both sides keep
+// the same predictor
+static inline int16_t imaDecode(ImaChannel& s, uint8_t code) {
+  int32_t step = kStep[s.index];
+  int32_t diff = step >> 3;
+  if (code & 4) diff += step;
+  if (code & 2) diff += step >> 1;
+  if (code & 1) diff += step >> 2;
+  s.predictor += (code & 8) ? -diff : diff;
+  if (s.predictor > 32767) s.predictor = 32767;
+  if (s.predictor < -32768) s.predictor = -32768;
+  s.index += kIndexStep[code & 7];
+  if (s.index < 0) s.index = 0;
+  if (s.index > 88) s.index = 88;
+  return (int16_t)s.predictor;
+}
+
+static inline uint8_t imaEncode(ImaChannel& s, int16_t sample) {
+  int32_t diff = sample - s.predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  int32_t step = kStep[s.index];
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) code |= 1;
+  imaDecode(s, code);
+  return code;
+}
+
+// Byte holding sample j (0-based after the header sample) of channel c:
+// per channel a 4-byte header, then 4 bytes (8 samples) of each channel
+// in turn, low nibble first
+static inline uint32_t imaByte(uint32_t channels, uint32_t c, uint32_t j) {
+  return 4 * channels + (j >> 3) * 4 * channels + c * 4 + ((j & 7) >> 1);
+}
+
+// ============================================================================
+// WAV HEADER
+// ============================================================================
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  put16(p, (uint16_t)v);
+  put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+static uint32_t get32(const uint8_t* p) {
+  return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+void transcodeSetup(TranscodeInfo& info, uint16_t format, uint16_t channels,
+                    uint32_t rate, uint32_t sourceBytes) {
+  memset(&info, 0, sizeof(info));
+  info.format = format;
+  info.channels = channels == 1 ? 1 : 2;
+  info.rate = rate;
+  info.blockBytes = TRANSCODE_BLOCK_BYTES;
+  // ADPCM: the header sample plus two per byte after the headers
+  info.samplesPerBlock =
+      format == TRANSCODE_IMA_ADPCM
+          ? (TRANSCODE_BLOCK_BYTES - 4 * info.channels) * 2 / info.channels + 1
+          : TRANSCODE_BLOCK_BYTES / (2 * info.channels);
+  info.sourceBytes = sourceBytes;
+}
+
+size_t transcodeHeader(TranscodeInfo& info, uint8_t* out) {
+  bool ima = info.format == TRANSCODE_IMA_ADPCM;
+  uint32_t fmtLen = ima ? 20 : 16;
+  uint32_t len = 12 + (8 + fmtLen) + 12 + 12 + 8;
+  uint16_t align = ima ? (uint16_t)info.blockBytes : (uint16_t)(2 * info.channels);
+  uint32_t byteRate =
+      ima ? (uint32_t)((uint64_t)info.rate * info.blockBytes /
+                       info.samplesPerBlock)
+          : info.rate * align;
+
+  memset(out, 0, len);
+  memcpy(out, "RIFF", 4);
+  put32(out + 4, len - 8 + info.dataBytes);
+  memcpy(out + 8, "WAVE", 4);
+  uint8_t* p = out + 12;
+  memcpy(p, "fmt ", 4);
+  put32(p + 4, fmtLen);
+  put16(p + 8, info.format);
+  put16(p + 10, info.channels);
+  put32(p + 12, info.rate);
+  put32(p + 16, byteRate);
+  put16(p + 20, align);
+  put16(p + 22, ima ? 4 : 16);
+  if (ima) {
+    put16(p + 24, 2);
+    put16(p + 26, (uint16_t)info.samplesPerBlock);
+  }
+  p += 8 + fmtLen;
+  memcpy(p, "fact", 4);
+  put32(p + 4, 4);
+  put32(p + 8, info.frames);
+  p += 12;
+  memcpy(p, "srcb", 4);
+  put32(p + 4, 4);
+  put32(p + 8, info.sourceBytes);
+  p += 12;
+  memcpy(p, "data", 4);
+  put32(p + 4, info.dataBytes);
+  info.dataStart = len;
+  return len;
+}
+
+bool transcodeParse(const uint8_t* buf, size_t len, TranscodeInfo& out) {
+  if (len < 12 || memcmp(buf, "RIFF", 4) != 0 ||
+      memcmp(buf + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool fmt = false, fact = false, src = false;
+  uint16_t format = 0, channels = 0, bits = 0, align = 0, spb = 0;
+  uint32_t rate = 0, frames = 0, source = 0;
+  for (size_t o = 12; o + 8 <= len;) {
+    const uint8_t* c = buf + o;
+    uint32_t size = get32(c + 4);
+    if (memcmp(c, "data", 4) == 0) {
+      if (!fmt || !fact || !src) return false;
+      transcodeSetup(out, format, channels, rate, source);
+      if (format == TRANSCODE_IMA_ADPCM &&
+          (bits != 4 || align != TRANSCODE_BLOCK_BYTES ||
+           spb != out.samplesPerBlock)) {
+        return false;
+      }
+      if (format == TRANSCODE_PCM && (bits != 16 || align != 2 * channels)) {
+        return false;
+      }
+      out.frames = frames;
+      out.dataStart = (uint32_t)o + 8;
+      out.dataBytes = size;
+      return true;
+    }
+    if (o + 8 + size > len) return false;  // Everything before data fits
+    if (memcmp(c, "fmt ", 4) == 0 && size >= 16) {
+      format = get16(c + 8);
+      channels = get16(c + 10);
+      rate = get32(c + 12);
+      align = get16(c + 20);
+      bits = get16(c + 22);
+      if (size >= 20) spb = get16(c + 26);
+      fmt = (format == TRANSCODE_PCM || format == TRANSCODE_IMA_ADPCM) &&
+            (channels == 1 || channels == 2) && rate;
+    } else if (memcmp(c, "fact", 4) == 0 && size >= 4) {
+      frames = get32(c + 8);
+      fact = true;
+    } else if (memcmp(c, "srcb", 4) == 0 && size >= 4) {
+      source = get32(c + 8);
+      src = true;
+    }
+    o += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+const char* transcodeFormatName(uint16_t format) {
+  return format == TRANSCODE_IMA_ADPCM ? "ima_adpcm"
+         : format == TRANSCODE_PCM     ? "pcm"
+                                       : "none";
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+TranscodeEncoder::TranscodeEncoder() : block(nullptr), pos(0) {
+  memset(&info, 0, sizeof(info));
+  memset(&infoOut, 0, sizeof(infoOut));
+  memset(state, 0, sizeof(state));
+}
+
+void TranscodeEncoder::begin(const TranscodeInfo& i, uint8_t* b,
+                             uint32_t framesDone, const uint8_t* previous) {
+  info = i;
+  block = b;
+  pos = 0;
+  memset(state, 0, sizeof(state));
+  uint32_t blocks = framesDone / info.samplesPerBlock;
+  infoOut = info;
+  infoOut.frames = blocks * info.samplesPerBlock;
+  infoOut.dataBytes = blocks * info.blockBytes;
+
+  // Step sizes where the previous block left them
+  if (previous && info.format == TRANSCODE_IMA_ADPCM) {
+    TranscodeDecoder d;
+    d.begin(info);
+    d.block(previous, info.blockBytes);
+    int16_t l, r;
+    while (d.next(&l, &r)) {
+    }
+    for (int c = 0; c < info.channels; c++) state[c].index = d.channel(c).index;
+  }
+}
+
+bool TranscodeEncoder::add(int16_t left, int16_t right) {
+  if (pos == info.samplesPerBlock) return false;
+  int16_t in[2] = {left, right};
+  if (info.channels == 1) in[0] = (int16_t)(((int32_t)left + right) >> 1);
+
+  if (info.format == TRANSCODE_PCM) {
+    uint8_t* p = block + pos * 2 * info.channels;
+    for (int c = 0; c < info.channels; c++) put16(p + 2 * c, (uint16_t)in[c]);
+  } else if (pos == 0) {
+    // Block header: the first sample exactly, and the step index
+    for (int c = 0; c < info.channels; c++) {
+      state[c].predictor = in[c];
+      put16(block + 4 * c, (uint16_t)in[c]);
+      block[4 * c + 2] = (uint8_t)state[c].index;
+      block[4 * c + 3] = 0;
+    }
+  } else {
+    uint32_t j = pos - 1;
+    for (int c = 0; c < info.channels; c++) {
+      uint8_t code = imaEncode(state[c], in[c]);
+      uint8_t& byte = block[imaByte(info.channels, c, j)];
+      byte = (j & 1) ? (uint8_t)(byte | code << 4) : code;
+    }
+  }
+  pos++;
+  return true;
+}
+
+void TranscodeEncoder::next() {
+  infoOut.frames += pos;
+  infoOut.dataBytes += info.blockBytes;
+  pos = 0;
+}
+
+size_t TranscodeEncoder::finish() {
+  if (!pos) return 0;
+  infoOut.frames += pos;
+  size_t bytes;
+  if (info.format == TRANSCODE_PCM) {
+    bytes = pos * 2 * info.channels;
+  } else {
+    // Silence to the end of the block; the fact chunk says where audio ends
+    for (; pos < info.samplesPerBlock; pos++) {
+      uint32_t j = pos - 1;
+      for (int c = 0; c < info.channels; c++) {
+        if (!(j & 1)) block[imaByte(info.channels, c, j)] = 0;
+      }
+    }
+    bytes = info.blockBytes;
+  }
+  infoOut.dataBytes += bytes;
+  pos = 0;
+  return bytes;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+TranscodeDecoder::TranscodeDecoder() : data(nullptr), frames(0), pos(0) {
+  memset(&info, 0, sizeof(info));
+  memset(state, 0, sizeof(state));
+}
+
+void TranscodeDecoder::begin(const TranscodeInfo& i) {
+  info = i;
+  data = nullptr;
+  frames = pos = 0;
+}
+
+void TranscodeDecoder::block(const uint8_t* d, size_t bytes) {
+  data = d;
+  pos = 0;
+  if (info.format == TRANSCODE_PCM) {
+    frames = (uint32_t)(bytes / (2 * info.channels));
+  } else if (bytes < 4 * info.channels) {
+    frames = 0;
+  } else {
+    // A short last block holds fewer 8-sample groups
+    uint32_t groups = (uint32_t)(bytes - 4 * info.channels) / (4 * info.channels);
+    frames = 1 + groups * 8;
+    if (frames > info.samplesPerBlock) frames = info.samplesPerBlock;
+  }
+}
+
+bool TranscodeDecoder::next(int16_t* left, int16_t* right) {
+  if (pos >= frames) return false;
+  int16_t out[2];
+  if (info.format == TRANSCODE_PCM) {
+    const uint8_t* p = data + pos * 2 * info.channels;
+    for (int c = 0; c < info.channels; c++) out[c] = (int16_t)get16(p + 2 * c);
+  } else if (pos == 0) {
+    for (int c = 0; c < info.channels; c++) {
+      state[c].predictor = (int16_t)get16(data + 4 * c);
+      state[c].index = data[4 * c + 2] > 88 ? 88 : data[4 * c + 2];
+      out[c] = (int16_t)state[c].predictor;
+    }
+  } else {
+    uint32_t j = pos - 1;
+    for (int c = 0; c < info.channels; c++) {
+      uint8_t byte = data[imaByte(info.channels, c, j)];
+      out[c] = imaDecode(state[c], (j & 1) ? byte >> 4 : byte & 0x0F);
+    }
+  }
+  pos++;
+  *left = out[0];
+  *right = info.channels == 2 ? out[1] : out[0];
+  return true;
+}
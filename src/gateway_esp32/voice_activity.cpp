@@ -0,0 +1,196 @@
+#include "../../include/gateway_esp32/voice_activity.h"
+
+#include <string.h>
+
+#define VAD_FFT_OFFSET ((VAD_FRAME_SAMPLES - SPECTRUM_FFT_SIZE) / 2)
+#define VAD_FLAT_FIRST 4  // Flatness over bins 4..63: 250 Hz..4 kHz
+#define VAD_FLAT_END 64
+#define VAD_NOISE_CREEP_FRAMES 16  // Floor rises 1/8 dB this often in speech
+
+static_assert(VAD_FRAME_SAMPLES >= SPECTRUM_FFT_SIZE,
+              "A VAD frame must cover one transform");
+
+static inline uint64_t binPower(int32_t re, int32_t im) {
+  return (uint64_t)((int64_t)re * re + (int64_t)im * im);
+}
+
+// Octave bands in bins of 62.5 Hz
+static const uint8_t kBandStart[VAD_BANDS + 1] = {1, 4, 8, 16, 32, 64,
+                                                  SPECTRUM_BINS - 1};
+
+VoiceActivity::VoiceActivity() {
+  spectrumTables(twiddle, window);
+  reset();
+}
+
+void VoiceActivity::reset() {
+  started = false;
+  lastActive = false;
+  frameDb8 = 0;
+  flatDb8 = 0;
+  bandSnrDb8 = 0;
+  memset(bandDb8, 0, sizeof(bandDb8));
+  noiseFloorDb8 = 0;
+  noiseFlatDb8 = 0;
+  memset(noiseBandDb8, 0, sizeof(noiseBandDb8));
+  run = 0;
+  loudRun = 0;
+  hangover = 0;
+  sinceSid = 0;
+  riseCount = 0;
+  sidNoiseDb8 = 0;
+  silent = false;
+}
+
+// ============================================================================
+// FEATURES
+// ============================================================================
+void VoiceActivity::analyze(const int16_t* pcm) {
+  // Level of the whole frame; 0 dBFS is a full-scale sine
+  uint64_t sumSq = 0;
+  for (int i = 0; i < VAD_FRAME_SAMPLES; i++) {
+    sumSq += (uint64_t)((int32_t)pcm[i] * pcm[i]);
+  }
+  uint64_t meanSq = sumSq / VAD_FRAME_SAMPLES;
+  frameDb8 = spectrumPowerDb8(meanSq ? meanSq : 1) -
+             spectrumPowerDb8(1ull << 29);
+
+  // Block scaling: the FFT halves every stage, so a quiet frame is shifted
+  // up to full scale first and the band levels shifted back down
+  const int16_t* x = pcm + VAD_FFT_OFFSET;
+  int32_t peak = 0;
+  for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+    int32_t a = x[i] < 0 ? -(int32_t)x[i] : x[i];
+    if (a > peak) peak = a;
+  }
+  int shift = 0;
+  while (shift < 15 && (peak << (shift + 1)) < 32768) shift++;
+  for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+    samples[i] = (int16_t)((x[i] * (1 << shift) * window[i] + 0x4000) >> 15);
+  }
+  spectrumFft(samples, twiddle, re, im);
+
+  // Spectral flatness: mean of the log powers against the log of the mean
+  // power, 0 dB for white noise and far below for harmonics
+  uint64_t sum = 0;
+  int32_t sumDb8 = 0;
+  for (int k = VAD_FLAT_FIRST; k < VAD_FLAT_END; k++) {
+    uint64_t p = binPower(re[k], im[k]) + 1;
+    sum += p;
+    sumDb8 += spectrumPowerDb8(p);
+  }
+  const int32_t bins = VAD_FLAT_END - VAD_FLAT_FIRST;
+  flatDb8 = sumDb8 / bins - spectrumPowerDb8(sum / bins);
+
+  // Band levels, back at the input's scale
+  const int32_t scaleDb8 = spectrumPowerDb8(1ull << (2 * shift));
+  for (int b = 0; b < VAD_BANDS; b++) {
+    uint64_t band = 1;
+    for (int k = kBandStart[b]; k < kBandStart[b + 1]; k++) {
+      band += binPower(re[k], im[k]);
+    }
+    bandDb8[b] = spectrumPowerDb8(band) - scaleDb8;
+  }
+}
+
+// ============================================================================
+// DECISION
+// ============================================================================
+// Moves v toward target: down by 1/2, up by 1/rise of the difference
+static inline void follow(int32_t& v, int32_t target, int32_t rise) {
+  int32_t d = target - v;
+  v += d < 0 ? d / 2 : d / rise;
+}
+
+VadDecision VoiceActivity::process(const int16_t* pcm) {
+  analyze(pcm);
+  if (!started || run >= VAD_MAX_RUN_FRAMES) {
+    // First frame, or "speech" that never pauses: take it as the noise
+    started = true;
+    run = 0;
+    noiseFloorDb8 = frameDb8;
+    noiseFlatDb8 = flatDb8;
+    memcpy(noiseBandDb8, bandDb8, sizeof(noiseBandDb8));
+  }
+
+  // Mean of the positive band SNRs: voice lifts some bands well above the
+  // noise, whatever the noise's spectrum
+  int32_t snr = 0;
+  for (int b = 0; b < VAD_BANDS; b++) {
+    int32_t d = bandDb8[b] - noiseBandDb8[b];
+    if (d > 0) snr += d;
+  }
+  bandSnrDb8 = snr / VAD_BANDS;
+  int32_t shape = flatDb8 - noiseFlatDb8;
+  if (shape < 0) shape = -shape;
+
+  loudRun = bandSnrDb8 > VAD_LOUD_DB * 8 ? loudRun + 1 : 0;
+  int32_t needDb =
+      shape > VAD_FLATNESS_DB * 8 ? VAD_SNR_DB : VAD_STEADY_SNR_DB;
+  bool voice = bandSnrDb8 > needDb * 8;
+  // Loud but noise-shaped (a knock, a door) needs two frames in a row
+  bool act = frameDb8 > VAD_FLOOR_DBFS * 8 && (voice || loudRun >= 2);
+  lastActive = act;
+
+  // Noise: follows noise-like frames within ~8 frames, the same noise
+  // louder (above the SNR but not voice) within ~32, and creeps under voice
+  if (voice) {
+    if (++riseCount >= VAD_NOISE_CREEP_FRAMES) {
+      riseCount = 0;
+      noiseFloorDb8++;
+      for (int b = 0; b < VAD_BANDS; b++) noiseBandDb8[b]++;
+    }
+  } else {
+    int32_t rise = bandSnrDb8 > VAD_SNR_DB * 8 ? 32 : 8;
+    follow(noiseFloorDb8, frameDb8, rise);
+    follow(noiseFlatDb8, flatDb8, 8);
+    for (int b = 0; b < VAD_BANDS; b++) {
+      follow(noiseBandDb8[b], bandDb8[b], rise);
+    }
+  }
+
+  if (act) {
+    run++;
+    uint32_t hold = run >= VAD_MIN_RUN_FRAMES ? VAD_HANGOVER_FRAMES
+                                              : VAD_BLIP_HANGOVER_FRAMES;
+    if (hold > hangover) hangover = hold;
+    silent = false;
+    return VAD_SPEECH;
+  }
+  run = 0;
+  if (hangover) {
+    hangover--;
+    return VAD_HANGOVER;
+  }
+
+  int32_t drift = noiseFloorDb8 - sidNoiseDb8;
+  if (drift < 0) drift = -drift;
+  if (!silent || ++sinceSid >= VAD_SID_INTERVAL_FRAMES ||
+      drift >= VAD_SID_DRIFT_DB * 8) {
+    silent = true;
+    sinceSid = 0;
+    sidNoiseDb8 = noiseFloorDb8;
+    return VAD_SID;
+  }
+  return VAD_SILENT;
+}
+
+// -dB in whole dB, clamped to the 7 bits RFC 3389 allows
+static uint8_t minusDb(int32_t db8) {
+  int32_t db = (-db8 + 4) / 8;
+  if (db < 0) db = 0;
+  if (db > 127) db = 127;
+  return (uint8_t)db;
+}
+
+size_t VoiceActivity::descriptor(uint8_t* out) const {
+  int32_t top = noiseBandDb8[0];
+  for (int b = 1; b < VAD_BANDS; b++) {
+    if (noiseBandDb8[b] > top) top = noiseBandDb8[b];
+  }
+  out[0] = minusDb(noiseFloorDb8);
+  for (int b = 0; b < VAD_BANDS; b++) {
+    out[1 + b] = minusDb(noiseBandDb8[b] - top);
+  }
+  return VAD_SID_BYTES;
+}
@@ -2,20 +2,103 @@
 
 #include <WiFi.h>
 #include <esp_now.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
+#include <sys/time.h>
 
+#include "../../include/gateway_esp32/event_bus.h"
+#include "../../include/gateway_esp32/memory_map.h"
+#include "../../include/gateway_esp32/mesh_stats.h"
+#include "../../include/gateway_esp32/node_ota_manager.h"
+#include "../../include/gateway_esp32/rule_manager.h"
+#include "../../include/gateway_esp32/sensor_analytics.h"
+#include "../../include/gateway_esp32/sync_playback.h"
 #include "../../include/shared/config.h"
+#include "../../include/shared/espnow_mesh.h"
 #include "../../include/shared/sensor_data.h"
 
 // External declarations
-extern SensorData remoteSensorData;
-extern bool remoteSensorDataAvailable;
 extern unsigned long lastRemoteDataReceived;
-extern void publishRemoteSensorData();
+extern EventBus eventBus;
+extern NodeOtaManager nodeOta;
+extern RuleManager ruleManager;
+
+// Mesh state (frames relayed by sensor nodes)
+MeshStats meshStats;
+static MeshDedupCache meshDedup;
+static uint16_t meshBeaconSeq = 0;
+static unsigned long lastMeshBeacon = 0;
+static const uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// Derived metrics: the gateway's own sensors, and each remote node's,
+// updated on every accepted sample
+SensorAnalytics sensorAnalytics;
+NodeAnalyticsTable remoteAnalytics;
+portMUX_TYPE sensorAnalyticsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Time base for synchronized playback, shared with the other gateways
+SyncClock syncClock;
+portMUX_TYPE syncClockLock = portMUX_INITIALIZER_UNLOCKED;
+
+static_assert(sizeof(meshStats) + sizeof(meshDedup) +
+                      sizeof(sensorAnalytics) + sizeof(remoteAnalytics) +
+                      sizeof(syncClock) <=
+                  RAM_BUDGET_WIFI_ESPNOW_MANAGER,
+              "ESP-NOW state exceeds RAM_BUDGET_WIFI_ESPNOW_MANAGER");
+
+static void acceptSensorData(const SensorData& data, uint8_t nodeId) {
+  lastRemoteDataReceived = millis();
+
+  portENTER_CRITICAL(&sensorAnalyticsLock);
+  SensorAnalytics& analytics =
+      remoteAnalytics.forNode(nodeId, lastRemoteDataReceived);
+  analytics.updateRemote(data, lastRemoteDataReceived);
+  bool anomaly = analytics.anyAnomaly();
+  float dewPoint = analytics.getDewPoint();
+  portEXIT_CRITICAL(&sensorAnalyticsLock);
+
+  ruleManager.post(RULE_IN_OUTSIDE_TEMP, data.temperature);
+  ruleManager.post(RULE_IN_OUTSIDE_HUMIDITY, data.humidity);
+  ruleManager.post(RULE_IN_UV, data.uvIndex);
+  ruleManager.post(RULE_IN_DEW_POINT, dewPoint);
+  if (data.pressure > 300.0f) {
+    ruleManager.post(RULE_IN_PRESSURE, data.pressure);
+  }
+
+  if (anomaly) {
+    Serial.println("[Analytics] ⚠ Anomalous reading from " +
+                   String(data.deviceName));
+  }
+
+  // Subscribers (MQTT forwarding, display) pick the sample up from the bus
+  SensorSampleEvent event;
+  event.data = data;
+  event.node = nodeId;
+  eventBus.publish(event);
+}
 
 // ESP-NOW callback
 void onESPNowDataReceived(const uint8_t* mac_addr, const uint8_t* data,
                           int data_len) {
+  int64_t arrivalUs = esp_timer_get_time();
+
+  // Clock beacons come every second from the master gateway, keep them
+  // quiet; stamped first thing, their arrival time is the measurement
+  if (syncIsBeacon(data, data_len)) {
+    portENTER_CRITICAL(&syncClockLock);
+    syncClock.onBeacon(mac_addr, *(const SyncBeacon*)data, arrivalUs);
+    portEXIT_CRITICAL(&syncClockLock);
+    return;
+  }
+
+  // Firmware update acks are frequent during a transfer, keep them quiet
+  if (nodeOtaIsFrame(data, data_len)) {
+    if (data_len == sizeof(NodeOtaStatus) && data[1] == NODE_OTA_STATUS) {
+      nodeOta.onStatus(mac_addr, *(const NodeOtaStatus*)data);
+    }
+    return;
+  }
+
   Serial.println("\n[ESP-NOW] ← Data received!");
   Serial.print("[ESP-NOW] From MAC: ");
   for (int i = 0; i < 6; i++) {
@@ -24,13 +107,24 @@ void onESPNowDataReceived(const uint8_t* mac_addr, const uint8_t* data,
   }
   Serial.printf(" | Size: %d bytes\n", data_len);
 
-  if (data_len == sizeof(SensorData)) {
-    memcpy(&remoteSensorData, data, sizeof(SensorData));
-    remoteSensorDataAvailable = true;
-    lastRemoteDataReceived = millis();
-
-    // Immediately publish to MQTT
-    publishRemoteSensorData();
+  if (meshIsValid(data, data_len)) {
+    const MeshHeader* header = (const MeshHeader*)data;
+    if (header->type != MESH_FRAME_DATA) {
+      return;  // Beacons from relays only matter to other nodes
+    }
+    if (meshDedup.checkAndInsert(header->originId, header->seq)) {
+      meshStats.recordDuplicate();
+      return;
+    }
+    meshStats.record(*header);
+    Serial.printf("[ESP-NOW] Mesh frame from node %d (seq %u, %d hop%s)\n",
+                  header->originId, header->seq, header->hopCount,
+                  header->hopCount == 1 ? "" : "s");
+    acceptSensorData(((const MeshDataFrame*)data)->data, header->originId);
+  } else if (data_len == sizeof(SensorData)) {
+    // Legacy direct frame from a node without mesh support
+    meshStats.recordLegacy();
+    acceptSensorData(*(const SensorData*)data, ANALYTICS_LEGACY_NODE);
   } else {
     Serial.printf("[ESP-NOW] ✗ Invalid data size! Expected %d, got %d\n",
                   sizeof(SensorData), data_len);
@@ -118,14 +212,59 @@ void setupESPNow() {
 
   Serial.println("[ESP-NOW] ✓ Initialized successfully");
 
+  // Beacons go out from the AP interface, so that is who we are to others
+  uint8_t mac[6];
+  esp_wifi_get_mac(WIFI_IF_AP, mac);
+  syncClock.begin(mac);
+
   // Register receive callback
   esp_now_register_recv_cb(onESPNowDataReceived);
 
+  // Broadcast peer for route beacons (hop 0, ETX 0)
+  esp_now_peer_info_t peer = {};
+  memcpy(peer.peer_addr, broadcastAddress, 6);
+  peer.channel = 0;  // Follow the current channel
+  peer.ifidx = WIFI_IF_AP;
+  peer.encrypt = false;
+  if (esp_now_add_peer(&peer) != ESP_OK) {
+    Serial.println("[ESP-NOW] ✗ Failed to add broadcast peer for beacons");
+  }
+
   Serial.printf("[DEBUG] SensorData struct size: %d bytes\n",
                 sizeof(SensorData));
   Serial.println("[ESP-NOW] ✓ Ready to receive data from sensor nodes");
 }
 
+void meshBeaconTick() {
+  unsigned long now = millis();
+  if (now - lastMeshBeacon < MESH_BEACON_INTERVAL) return;
+  lastMeshBeacon = now;
+
+  MeshBeaconFrame beacon;
+  meshInitHeader(beacon.header, MESH_FRAME_BEACON, MESH_GATEWAY_ID,
+                 meshBeaconSeq++);
+  beacon.pathEtx = 0;
+  beacon.hopsToGateway = 0;
+  esp_now_send(broadcastAddress, (const uint8_t*)&beacon, sizeof(beacon));
+}
+
+void syncBeaconTick() {
+  // SNTP time, once it is set (getLocalTime() takes years after 2016)
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  int64_t utcUs = tv.tv_sec > 1451606400
+                      ? (int64_t)tv.tv_sec * 1000000 + tv.tv_usec
+                      : 0;
+
+  SyncBeacon beacon;
+  portENTER_CRITICAL(&syncClockLock);
+  bool send = syncClock.tick(esp_timer_get_time(), utcUs, &beacon);
+  portEXIT_CRITICAL(&syncClockLock);
+  if (send) {
+    esp_now_send(broadcastAddress, (const uint8_t*)&beacon, sizeof(beacon));
+  }
+}
+
 void maintainWiFi() {
   // WiFi reconnection check
   if (WiFi.status() != WL_CONNECTED) {
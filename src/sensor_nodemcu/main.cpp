@@ -6,21 +6,21 @@ extern "C" {
 #include <user_interface.h>
 }
 
-#include <Adafruit_BMP085.h>
-#include <DHT.h>
 #include <Wire.h>
 
+#include "../../include/sensor_nodemcu/ota_receiver.h"
+#include "../../include/sensor_nodemcu/sensor_acquisition.h"
+#include "../../include/shared/espnow_mesh.h"
 #include "../../include/shared/sensor_data.h"
 
 // ============================================================================
 // Sensor Pin Definitions
 // ========================================== ==================================
-#define DHTPIN D4  // D4 (GPIO2)
-#define DHTTYPE DHT22
+#define DHTPIN D4  // D4 (GPIO2), DHT22
 #define UV_PIN A0  // GUVA-S12SD UV Sensor
 
-DHT dht(DHTPIN, DHTTYPE);
-Adafruit_BMP085 bmp;
+// DHT22 + BMP180 + UV sampled concurrently without blocking loop()
+SensorAcquisition acquisition;
 
 // ============================================================================
 // Soft AP Configuration
@@ -34,6 +34,25 @@ uint8_t gatewayAddress[] = {0x28, 0x56, 0x2F, 0x4A, 0x15, 0x0D};
 #define WIFI_CHANNEL 6
 #define SENSOR_READ_INTERVAL 5000  // 5 seconds
 
+// Without the AP the station would scan every channel and miss ESP-NOW on
+// WIFI_CHANNEL, so joining is only retried on this timer
+#define SOFT_AP_RETRY_MS 60000
+#define SOFT_AP_JOIN_MS 5000  // A retry gives up after this long
+
+// ============================================================================
+// Mesh Relay Configuration
+// ============================================================================
+// Relay nodes store-and-forward other nodes' frames towards the gateway and
+// advertise their own route in beacons. Enable per node with
+// -D NODE_RELAY_ENABLED=1 (and a unique -D SENSOR_NODE_ID).
+#ifndef NODE_RELAY_ENABLED
+#define NODE_RELAY_ENABLED 0
+#endif
+
+#define RELAY_QUEUE_SIZE 8       // Frames held while waiting for the radio
+#define RELAY_MAX_HOLD_MS 30000  // Drop frames nobody could forward in time
+#define RX_QUEUE_SIZE 8          // Frames handed over from the rx callback
+
 // ============================================================================
 // Global Variables
 // ============================================================================
@@ -44,14 +63,58 @@ unsigned long transmissionCount = 0;
 bool espNowInitialized = false;
 bool bmpInitialized = false;
 
+// Soft AP association, retried from loop()
+bool apConnected = false;
+bool apJoining = false;
+unsigned long lastApAttempt = 0;
+
+// Mesh state
+uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+uint8_t parentAddress[6];  // Next hop, the gateway until a beacon says better
+MeshNeighborTable neighbors;
+MeshDedupCache dedup;
+uint16_t dataSeq = 0;
+uint16_t beaconSeq = 0;
+unsigned long lastBeacon = 0;
+unsigned long relayedCount = 0;
+unsigned long relayDroppedCount = 0;
+
+// Firmware updates pushed by the gateway over ESP-NOW
+OtaReceiver ota;
+
+struct RelaySlot {
+  MeshDataFrame frame;
+  unsigned long enqueuedAt;
+};
+RelaySlot relayQueue[RELAY_QUEUE_SIZE];
+uint8_t relayHead = 0;
+uint8_t relayCount = 0;
+
+// Written by the ESP-NOW rx callback, drained by loop()
+struct RxSlot {
+  uint8_t mac[6];
+  uint8_t len;
+  uint8_t data[sizeof(MeshDataFrame)];
+};
+RxSlot rxQueue[RX_QUEUE_SIZE];
+volatile uint8_t rxHead = 0;
+volatile uint8_t rxTail = 0;
+
 // ============================================================================
 // Function Declarations
 // ============================================================================
 void connectToSoftAP();
+void stayOnChannel();
+void retrySoftAP(unsigned long now);
 void initESPNow();
-void readRealSensors();
+void applySample();
 void sendSensorData();
 void onDataSent(uint8_t* mac_addr, uint8_t sendStatus);
+void onDataReceived(uint8_t* mac_addr, uint8_t* data, uint8_t len);
+void processReceivedFrames();
+void updateParent();
+void drainRelayQueue();
+void sendBeacon();
 
 // ============================================================================
 // ESP-NOW Callback
@@ -64,6 +127,29 @@ void onDataSent(uint8_t* mac_addr, uint8_t sendStatus) {
   }
   Serial.print(" | Status: ");
   Serial.println(sendStatus == 0 ? "✓ Success" : "✗ Failed");
+
+  // MAC-level ack feeds the link estimate of the chosen parent
+  if (memcmp(mac_addr, broadcastAddress, 6) != 0) {
+    neighbors.onSendResult(mac_addr, sendStatus == 0);
+  }
+}
+
+// Runs in the WiFi task: copy the frame out and let loop() handle it
+void onDataReceived(uint8_t* mac_addr, uint8_t* data, uint8_t len) {
+  if (nodeOtaIsFrame(data, len)) {
+    ota.onFrame(data, len);
+    return;
+  }
+  if (!meshIsValid(data, len)) return;
+
+  uint8_t next = (rxHead + 1) % RX_QUEUE_SIZE;
+  if (next == rxTail) return;  // Full, the sender will see it as a loss
+
+  RxSlot& slot = rxQueue[rxHead];
+  memcpy(slot.mac, mac_addr, 6);
+  memcpy(slot.data, data, len);
+  slot.len = len;
+  rxHead = next;
 }
 
 // ============================================================================
@@ -72,7 +158,9 @@ void onDataSent(uint8_t* mac_addr, uint8_t sendStatus) {
 void connectToSoftAP() {
   Serial.println("\n[WiFi] Connecting to Soft AP...");
   WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);  // Retries are ours, see retrySoftAP()
   WiFi.begin(SOFT_AP_SSID, SOFT_AP_PASSWORD, WIFI_CHANNEL);
+  lastApAttempt = millis();
 
   int attempts = 0;
   while (WiFi.status() != WL_CONNECTED && attempts < 20) {
@@ -81,12 +169,54 @@ void connectToSoftAP() {
     attempts++;
   }
 
-  if (WiFi.status() == WL_CONNECTED) {
+  apConnected = WiFi.status() == WL_CONNECTED;
+  if (apConnected) {
     Serial.println("\n[WiFi] ✓ Connected!");
     Serial.print("[WiFi] IP: ");
     Serial.println(WiFi.localIP());
   } else {
     Serial.println("\n[WiFi] ✗ Failed to connect!");
+    stayOnChannel();
+  }
+}
+
+// Stop the station's scan and park the radio where the mesh is
+void stayOnChannel() {
+  WiFi.disconnect();
+  wifi_set_channel(WIFI_CHANNEL);
+  Serial.printf("[WiFi] ⚠ No AP, ESP-NOW stays on channel %d\n",
+                WIFI_CHANNEL);
+}
+
+// A lost or missing AP is joined again every SOFT_AP_RETRY_MS, for at most
+// SOFT_AP_JOIN_MS each time, without blocking loop()
+void retrySoftAP(unsigned long now) {
+  bool connected = WiFi.status() == WL_CONNECTED;
+  if (connected) {
+    if (!apConnected) Serial.println("[WiFi] ✓ Reconnected to Soft AP");
+    apConnected = true;
+    apJoining = false;
+    return;
+  }
+
+  if (apConnected) {
+    Serial.println("[WiFi] ✗ Soft AP lost");
+    apConnected = false;
+    lastApAttempt = now;
+    stayOnChannel();
+    return;
+  }
+
+  if (apJoining) {
+    if (now - lastApAttempt >= SOFT_AP_JOIN_MS) {
+      apJoining = false;
+      stayOnChannel();
+    }
+  } else if (now - lastApAttempt >= SOFT_AP_RETRY_MS) {
+    Serial.println("[WiFi] Retrying Soft AP...");
+    lastApAttempt = now;
+    apJoining = true;
+    WiFi.begin(SOFT_AP_SSID, SOFT_AP_PASSWORD, WIFI_CHANNEL);
   }
 }
 
@@ -103,10 +233,12 @@ void initESPNow() {
   }
   Serial.println("[ESP-NOW] ✓ Initialized");
 
-  esp_now_set_self_role(ESP_NOW_ROLE_CONTROLLER);
+  // COMBO: nodes both send their own data and listen for beacons/relays
+  esp_now_set_self_role(ESP_NOW_ROLE_COMBO);
   esp_now_register_send_cb(onDataSent);
+  esp_now_register_recv_cb(onDataReceived);
 
-  int addPeerResult = esp_now_add_peer(gatewayAddress, ESP_NOW_ROLE_SLAVE,
+  int addPeerResult = esp_now_add_peer(gatewayAddress, ESP_NOW_ROLE_COMBO,
                                        WIFI_CHANNEL, NULL, 0);
 
   if (addPeerResult == 0) {
@@ -116,6 +248,124 @@ void initESPNow() {
     Serial.printf("[ESP-NOW] ✗ Peer add failed! Code: %d\n", addPeerResult);
     espNowInitialized = false;
   }
+
+  esp_now_add_peer(broadcastAddress, ESP_NOW_ROLE_COMBO, WIFI_CHANNEL, NULL, 0);
+  memcpy(parentAddress, gatewayAddress, 6);
+  ota.begin(SENSOR_NODE_ID, gatewayAddress);
+
+  Serial.printf("[Mesh] Node %d, relay %s\n", SENSOR_NODE_ID,
+                NODE_RELAY_ENABLED ? "enabled" : "disabled");
+}
+
+// ============================================================================
+// Mesh Routing
+// ============================================================================
+void processReceivedFrames() {
+  while (rxTail != rxHead) {
+    RxSlot& slot = rxQueue[rxTail];
+    const MeshHeader* header = (const MeshHeader*)slot.data;
+
+    if (header->type == MESH_FRAME_BEACON) {
+      // ESP8266 ESP-NOW does not report RSSI; it is filled in for the
+      // gateway from the Soft AP association in updateParent()
+      neighbors.onBeacon(slot.mac, *(const MeshBeaconFrame*)slot.data, 0,
+                         millis());
+    } else if (NODE_RELAY_ENABLED && header->type == MESH_FRAME_DATA) {
+      MeshDataFrame frame;
+      memcpy(&frame, slot.data, sizeof(frame));
+
+      bool duplicate =
+          frame.header.originId == SENSOR_NODE_ID ||
+          dedup.checkAndInsert(frame.header.originId, frame.header.seq);
+
+      if (duplicate) {
+        // Already forwarded (or our own frame echoed back)
+      } else if (frame.header.hopCount >= frame.header.hopLimit) {
+        relayDroppedCount++;
+      } else if (relayCount == RELAY_QUEUE_SIZE) {
+        relayDroppedCount++;
+        Serial.println("[Mesh] ✗ Relay queue full, frame dropped");
+      } else {
+        RelaySlot& r = relayQueue[(relayHead + relayCount) % RELAY_QUEUE_SIZE];
+        r.frame = frame;
+        r.enqueuedAt = millis();
+        relayCount++;
+      }
+    }
+
+    rxTail = (rxTail + 1) % RX_QUEUE_SIZE;
+  }
+}
+
+void updateParent() {
+  unsigned long now = millis();
+  neighbors.expire(now);
+
+  if (WiFi.status() == WL_CONNECTED) {
+    neighbors.setRssi(gatewayAddress, (int8_t)WiFi.RSSI());
+  }
+
+  const MeshNeighbor* best = neighbors.bestParent(SENSOR_NODE_ID);
+  if (!best || memcmp(best->mac, parentAddress, 6) == 0) return;
+
+  // Keep the gateway peer, swap any previous relay peer for the new one
+  if (memcmp(parentAddress, gatewayAddress, 6) != 0) {
+    esp_now_del_peer(parentAddress);
+  }
+  if (memcmp(best->mac, gatewayAddress, 6) != 0 &&
+      !esp_now_is_peer_exist((uint8_t*)best->mac)) {
+    esp_now_add_peer((uint8_t*)best->mac, ESP_NOW_ROLE_COMBO, WIFI_CHANNEL,
+                     NULL, 0);
+  }
+  memcpy(parentAddress, best->mac, 6);
+
+  Serial.printf("[Mesh] Parent -> node %d (%d hops, ETX %.2f)\n", best->nodeId,
+                best->hopsToGateway + 1,
+                MeshNeighborTable::pathCost(*best) / (float)MESH_ETX_SCALE);
+}
+
+void drainRelayQueue() {
+  unsigned long now = millis();
+
+  while (relayCount > 0) {
+    RelaySlot& r = relayQueue[relayHead];
+    unsigned long held = now - r.enqueuedAt;
+
+    if (held > RELAY_MAX_HOLD_MS) {
+      relayDroppedCount++;
+    } else {
+      MeshHeader& h = r.frame.header;
+      uint32_t delay = (uint32_t)h.relayDelayMs + held;
+      h.relayDelayMs = delay > 0xFFFF ? 0xFFFF : (uint16_t)delay;
+      h.hopCount++;
+      h.senderId = SENSOR_NODE_ID;
+
+      if (esp_now_send(parentAddress, (uint8_t*)&r.frame, sizeof(r.frame)) !=
+          0) {
+        // Radio busy: restore the header and try again on the next loop
+        h.hopCount--;
+        return;
+      }
+      relayedCount++;
+    }
+
+    relayHead = (relayHead + 1) % RELAY_QUEUE_SIZE;
+    relayCount--;
+  }
+}
+
+void sendBeacon() {
+  const MeshNeighbor* parent = neighbors.find(parentAddress);
+  if (!parent) return;  // No route, stay silent so nobody picks us
+
+  MeshBeaconFrame beacon;
+  meshInitHeader(beacon.header, MESH_FRAME_BEACON, SENSOR_NODE_ID,
+                 beaconSeq++);
+  beacon.pathEtx = MeshNeighborTable::pathCost(*parent);
+  beacon.hopsToGateway = parent->hopsToGateway + 1;
+  if (beacon.pathEtx == MESH_ETX_UNREACHABLE) return;
+
+  esp_now_send(broadcastAddress, (uint8_t*)&beacon, sizeof(beacon));
 }
 
 // ============================================================================
@@ -127,11 +377,9 @@ void setup() {
 
   Serial.println("\n=== Smart Alarm - Sensor Node ===\n");
 
-  dht.begin();
-
   // Explicitly initialize I2C pins for ESP8266 (SDA=D2/GPIO4, SCL=D1/GPIO5)
   Wire.begin(D2, D1);
-  bmpInitialized = bmp.begin();
+  bmpInitialized = acquisition.begin(DHTPIN, UV_PIN);
   if (bmpInitialized) {
     Serial.println("[BMP] ✓ BMP initialized");
   } else {
@@ -155,62 +403,72 @@ void setup() {
 void loop() {
   unsigned long now = millis();
 
-  if (now - lastSensorRead >= SENSOR_READ_INTERVAL) {
+  // During a firmware transfer only the updater runs; sampling and relaying
+  // wait so no window of chunks is missed (a session that goes quiet is
+  // dropped after NODE_OTA_SILENCE_MS)
+  ota.loop();
+  if (ota.isActive()) {
+    delay(1);
+    return;
+  }
+
+  retrySoftAP(now);
+  processReceivedFrames();
+  updateParent();
+  drainRelayQueue();
+
+  if (NODE_RELAY_ENABLED && now - lastBeacon >= MESH_BEACON_INTERVAL) {
+    lastBeacon = now;
+    sendBeacon();
+  }
+
+  if (!acquisition.busy() && now - lastSensorRead >= SENSOR_READ_INTERVAL) {
     lastSensorRead = now;
-    readRealSensors();
-    sendSensorData();
+    acquisition.start();
+  }
+
+  if (acquisition.busy()) {
+    if (acquisition.poll()) {
+      applySample();
+      sendSensorData();
+    }
+    yield();  // Keep polling the conversions, only let WiFi run in between
+    return;
   }
 
   delay(10);
 }
 
 // ============================================================================
-// Real Sensor Reader
+// Sensor Sample
 // ============================================================================
-void readRealSensors() {
-  Serial.println("╔════════ REAL SENSOR DATA ═══════════════╗");
-
-  // -------- DHT22 --------
-  float h = dht.readHumidity();
-  float t = dht.readTemperature();
-
-  if (!isnan(t)) sensorData.temperature = t;
-  if (!isnan(h)) sensorData.humidity = h;
-
-  Serial.printf(" ║ Temp:       %6.2f °C                  ║\n",
-                sensorData.temperature);
-  Serial.printf(" ║ Humidity:   %6.2f %%                   ║\n",
-                sensorData.humidity);
-
-  // -------- BMP180 --------
-  if (bmpInitialized) {
-    sensorData.pressure = bmp.readPressure() / 100.0;
-  } else {
-    sensorData.pressure = 0.0;
+void applySample() {
+  // -------- DHT22 (keeps the last good value on a bad checksum) --------
+  if (acquisition.dhtValid()) {
+    sensorData.temperature = acquisition.getTemperature();
+    sensorData.humidity = acquisition.getHumidity();
   }
 
-  Serial.printf(" ║ Pressure:   %7.2f hPa                 ║\n",
-                sensorData.pressure);
+  // -------- BMP180 --------
+  sensorData.pressure = acquisition.bmpValid() ? acquisition.getPressure() : 0.0;
 
   // -------- GUVA-S12SD UV Sensor --------
-  int raw = analogRead(UV_PIN);
-  float voltage =
-      raw * (3.3 / 1023.0);  // ESP8266 ADC is 0–1V unless divider used
-
-  float uvIndex = voltage / 0.1;  // Approximated UVA → UV Index
+  float uvIndex = acquisition.getUvVoltage() / 0.1;  // Approx. UVA → UV Index
   sensorData.uvIndex = constrain(uvIndex, 0, 15);
 
-  Serial.printf(" ║ UV Index:   %6.2f                      ║\n",
-                sensorData.uvIndex);
-
   // -------- Battery Simulation --------
   sensorData.batteryLevel = 100 - (transmissionCount % 100);
 
-  Serial.printf(" ║ Battery:    %3d %%                      ║\n",
-                sensorData.batteryLevel);
-  Serial.println("╚═════════════════════════════════════════╝");
-
   sensorData.timestamp = millis();
+
+  // One compact line: values, then per-sensor completion times in ms
+  const AcquisitionTimings& t = acquisition.getTimings();
+  Serial.printf("[Sample] T=%.2f%s H=%.2f P=%.2f UV=%.2f B=%u | dht=%.1f "
+                "bmp=%.1f uv=%.1f awake=%.1fms\n",
+                sensorData.temperature, acquisition.dhtValid() ? "" : "?",
+                sensorData.humidity, sensorData.pressure, sensorData.uvIndex,
+                sensorData.batteryLevel, t.dhtUs / 1000.0f, t.bmpUs / 1000.0f,
+                t.uvUs / 1000.0f, t.totalUs / 1000.0f);
 }
 
 // ============================================================================
@@ -222,11 +480,15 @@ void sendSensorData() {
     return;
   }
 
-  uint8_t result =
-      esp_now_send(gatewayAddress, (uint8_t*)&sensorData, sizeof(sensorData));
+  MeshDataFrame frame;
+  meshInitHeader(frame.header, MESH_FRAME_DATA, SENSOR_NODE_ID, dataSeq++);
+  frame.data = sensorData;
+
+  uint8_t result = esp_now_send(parentAddress, (uint8_t*)&frame, sizeof(frame));
 
   if (result == 0) {
-    Serial.println("[ESP-NOW] ✓ Packet sent (queued)");
+    Serial.printf("[ESP-NOW] ✓ Packet sent (queued, seq %u)\n",
+                  frame.header.seq);
     transmissionCount++;
   } else {
     Serial.printf("[ESP-NOW] ✗ Send error: %d\n", result);
@@ -0,0 +1,246 @@
+#include "../../include/sensor_nodemcu/ota_receiver.h"
+
+#include <Updater.h>
+#include <espnow.h>
+
+OtaReceiver::OtaReceiver()
+    : nodeId(0),
+      state(NODE_OTA_IDLE),
+      session(0),
+      imageSize(0),
+      chunkCount(0),
+      lastFrameMs(0),
+      windowStart(0),
+      receivedMask(0),
+      announcePending(false),
+      pollPending(false),
+      pollWindow(0),
+      commitPending(false),
+      abortPending(false) {
+  memset(gateway, 0, sizeof(gateway));
+  memset(expectedHash, 0, sizeof(expectedHash));
+}
+
+void OtaReceiver::begin(uint8_t id, const uint8_t* gatewayMac) {
+  nodeId = id;
+  memcpy(gateway, gatewayMac, 6);
+}
+
+// ESP8266 runs ESP-NOW callbacks in the system context between loop()
+// iterations, so the callback and loop() never interleave; the flags only
+// need to survive until the next loop().
+void OtaReceiver::onFrame(const uint8_t* data, uint8_t len) {
+  const NodeOtaHeader* h = (const NodeOtaHeader*)data;
+  if (state == NODE_OTA_RECEIVING && h->sessionId == session) {
+    lastFrameMs = millis();
+  }
+
+  switch (h->type) {
+    case NODE_OTA_ANNOUNCE:
+      // A new session id means the gateway gave up on the running one
+      if (len == sizeof(NodeOtaAnnounce)) {
+        memcpy(&pendingAnnounce, data, sizeof(pendingAnnounce));
+        announcePending = true;
+      }
+      break;
+
+    case NODE_OTA_CHUNK: {
+      if (len != sizeof(NodeOtaChunk) || state != NODE_OTA_RECEIVING ||
+          h->sessionId != session) {
+        return;
+      }
+      const NodeOtaChunk* c = (const NodeOtaChunk*)data;
+      uint16_t offset = c->index - windowStart;
+      if (c->index < windowStart || offset >= NODE_OTA_WINDOW) return;
+      if (c->length > NODE_OTA_CHUNK_SIZE) return;
+      if (receivedMask & (1u << offset)) return;  // Repeat for another node
+      memcpy(window[offset], c->data, c->length);
+      receivedMask |= (1u << offset);
+      break;
+    }
+
+    case NODE_OTA_POLL:
+      if (len == sizeof(NodeOtaPoll) && h->sessionId == session &&
+          state != NODE_OTA_IDLE) {
+        pollWindow = ((const NodeOtaPoll*)data)->windowStart;
+        pollPending = true;
+      }
+      break;
+
+    case NODE_OTA_COMMIT:
+      if (h->sessionId == session) commitPending = true;
+      break;
+
+    case NODE_OTA_ABORT:
+      if (h->sessionId == session) abortPending = true;
+      break;
+  }
+}
+
+void OtaReceiver::loop() {
+  if (announcePending) {
+    announcePending = false;
+    handleAnnounce();
+  }
+
+  if (state == NODE_OTA_RECEIVING && windowStart < chunkCount &&
+      receivedMask == nodeOtaWindowMask(windowStart, chunkCount)) {
+    flushWindow();
+  }
+
+  if (pollPending) {
+    pollPending = false;
+    sendStatus();
+  }
+
+  if (commitPending) {
+    commitPending = false;
+    handleCommit();
+  }
+
+  if (abortPending) {
+    abortPending = false;
+    if (state == NODE_OTA_RECEIVING) abandon("aborted by gateway");
+  }
+
+  // A lost ABORT, a node the gateway dropped as silent or a gateway reboot
+  // all end in silence
+  if (state == NODE_OTA_RECEIVING &&
+      millis() - lastFrameMs > NODE_OTA_SILENCE_MS) {
+    abandon("gateway silent");
+  }
+}
+
+void OtaReceiver::handleAnnounce() {
+  const NodeOtaAnnounce& a = pendingAnnounce;
+
+  // Repeated announce for the running session: just answer again
+  if (state == NODE_OTA_RECEIVING && a.header.sessionId == session) {
+    sendStatus();
+    return;
+  }
+  if (state == NODE_OTA_RECEIVING) {
+    abandon("replaced by a new session");
+  }
+
+  session = a.header.sessionId;
+  imageSize = a.imageSize;
+  chunkCount = a.chunkCount;
+  memcpy(expectedHash, a.sha256, sizeof(expectedHash));
+
+  if (chunkCount != nodeOtaChunkCount(imageSize) ||
+      imageSize > ESP.getFreeSketchSpace()) {
+    Serial.printf("[OTA] ✗ Image of %u bytes does not fit\n", imageSize);
+    state = NODE_OTA_FAILED;
+    sendStatus();
+    return;
+  }
+
+  if (!Update.begin(imageSize)) {
+    Serial.printf("[OTA] ✗ Update.begin failed (error %u)\n",
+                  Update.getError());
+    state = NODE_OTA_FAILED;
+    sendStatus();
+    return;
+  }
+
+  br_sha256_init(&sha);
+  windowStart = 0;
+  receivedMask = 0;
+  lastFrameMs = millis();
+  state = NODE_OTA_RECEIVING;
+
+  Serial.printf("[OTA] Receiving %u bytes (%u chunks, session %u)\n",
+                imageSize, chunkCount, session);
+  sendStatus();
+}
+
+void OtaReceiver::flushWindow() {
+  uint16_t count = min((uint16_t)NODE_OTA_WINDOW,
+                       (uint16_t)(chunkCount - windowStart));
+
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t offset = (uint32_t)(windowStart + i) * NODE_OTA_CHUNK_SIZE;
+    size_t len = min((uint32_t)NODE_OTA_CHUNK_SIZE, imageSize - offset);
+
+    if (Update.write(window[i], len) != len) {
+      fail("flash write");
+      return;
+    }
+    br_sha256_update(&sha, window[i], len);
+  }
+
+  windowStart += count;
+  receivedMask = 0;
+
+  if (windowStart >= chunkCount) {
+    Serial.println("[OTA] All chunks received, waiting for commit");
+  }
+}
+
+void OtaReceiver::handleCommit() {
+  if (state != NODE_OTA_RECEIVING || windowStart < chunkCount) return;
+
+  uint8_t hash[NODE_OTA_HASH_SIZE];
+  br_sha256_out(&sha, hash);
+  if (memcmp(hash, expectedHash, sizeof(hash)) != 0) {
+    fail("hash mismatch");
+    return;
+  }
+
+  if (!Update.end()) {
+    fail("Update.end");
+    return;
+  }
+
+  state = NODE_OTA_VERIFIED;
+  Serial.println("[OTA] ✓ Hash verified, rebooting into new firmware");
+  for (int i = 0; i < 3; i++) {
+    sendStatus();
+    delay(50);
+  }
+  ESP.restart();
+}
+
+void OtaReceiver::sendStatus() {
+  NodeOtaStatus s;
+  s.header = {NODE_OTA_MAGIC, NODE_OTA_STATUS, session, 0};
+  s.nodeId = nodeId;
+  s.state = state;
+  s.windowStart = windowStart;
+  s.missingMask = 0;
+
+  if (state == NODE_OTA_RECEIVING && windowStart < chunkCount &&
+      pollWindow == windowStart) {
+    s.missingMask = nodeOtaWindowMask(windowStart, chunkCount) & ~receivedMask;
+  }
+
+  esp_now_send(gateway, (uint8_t*)&s, sizeof(s));
+}
+
+// Drop the running session and go back to sampling. Update.end() on an
+// unfinished image releases it without writing the boot command. A complete
+// image would be committed by end(), so that case reboots through fail().
+void OtaReceiver::abandon(const char* reason) {
+  if (windowStart >= chunkCount) {
+    fail(reason);
+    return;
+  }
+  Serial.printf("[OTA] ⚠ Session %u dropped: %s\n", session, reason);
+  Update.end();
+  windowStart = 0;
+  receivedMask = 0;
+  state = NODE_OTA_IDLE;
+}
+
+// After a flash error or a bad hash the whole image may be written, and
+// Updater can only commit it: report the failure, then reboot so the
+// written region is released. The boot command was never written, so the
+// node comes back on the image it was running.
+void OtaReceiver::fail(const char* reason) {
+  Serial.printf("[OTA] ✗ Update failed: %s\n", reason);
+  state = NODE_OTA_FAILED;
+  sendStatus();
+  delay(50);
+  ESP.restart();
+}
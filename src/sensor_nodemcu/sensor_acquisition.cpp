@@ -0,0 +1,281 @@
+#include "../../include/sensor_nodemcu/sensor_acquisition.h"
+
+#include <Wire.h>
+
+// Edge timestamps written by the pin-change interrupt
+static volatile uint32_t dhtEdges[DHT_MAX_EDGES];
+static volatile uint8_t dhtEdgeCount = 0;
+
+static void IRAM_ATTR onDhtEdge() {
+  uint8_t n = dhtEdgeCount;
+  if (n < DHT_MAX_EDGES) {
+    dhtEdges[n] = micros();
+    dhtEdgeCount = n + 1;
+  }
+}
+
+SensorAcquisition::SensorAcquisition()
+    : dhtPin(0),
+      uvPin(A0),
+      bmpPresent(false),
+      running(false),
+      startUs(0),
+      dhtState(DHT_IDLE),
+      dhtStateUs(0),
+      bmpState(BMP_IDLE),
+      bmpStateUs(0),
+      rawTemp(0),
+      uvCount(0),
+      uvSum(0),
+      uvLastUs(0),
+      dhtOk(false),
+      bmpOk(false),
+      temperature(NAN),
+      humidity(NAN),
+      pressure(0.0f),
+      uvVoltage(0.0f) {
+  memset(&timings, 0, sizeof(timings));
+}
+
+bool SensorAcquisition::begin(uint8_t dht, uint8_t uv) {
+  dhtPin = dht;
+  uvPin = uv;
+  pinMode(dhtPin, INPUT_PULLUP);
+
+  // BMP180: check the chip id, then read the calibration EEPROM once
+  uint8_t id = 0;
+  uint8_t cal[22];
+  bmpPresent = bmpRead(0xD0, &id, 1) && id == 0x55 && bmpRead(0xAA, cal, 22);
+  if (bmpPresent) {
+    ac1 = (cal[0] << 8) | cal[1];
+    ac2 = (cal[2] << 8) | cal[3];
+    ac3 = (cal[4] << 8) | cal[5];
+    ac4 = (cal[6] << 8) | cal[7];
+    ac5 = (cal[8] << 8) | cal[9];
+    ac6 = (cal[10] << 8) | cal[11];
+    b1 = (cal[12] << 8) | cal[13];
+    b2 = (cal[14] << 8) | cal[15];
+    mb = (cal[16] << 8) | cal[17];
+    mc = (cal[18] << 8) | cal[19];
+    md = (cal[20] << 8) | cal[21];
+  }
+  return bmpPresent;
+}
+
+void SensorAcquisition::start() {
+  if (running) return;
+
+  running = true;
+  startUs = micros();
+  memset(&timings, 0, sizeof(timings));
+
+  // DHT22 start signal: hold the line low, released in pollDht()
+  dhtEdgeCount = 0;
+  pinMode(dhtPin, OUTPUT);
+  digitalWrite(dhtPin, LOW);
+  dhtState = DHT_START_LOW;
+  dhtStateUs = startUs;
+
+  // BMP180 temperature conversion runs while the DHT start signal is held
+  if (bmpPresent && bmpWrite(0xF4, 0x2E)) {
+    bmpState = BMP_WAIT_TEMP;
+    bmpStateUs = startUs;
+  } else {
+    bmpState = BMP_DONE;
+    bmpOk = false;
+  }
+
+  uvCount = 0;
+  uvSum = 0;
+  uvLastUs = startUs - UV_SAMPLE_SPACING_US;
+}
+
+bool SensorAcquisition::poll() {
+  if (!running) return false;
+
+  uint32_t now = micros();
+  pollDht(now);
+  pollBmp(now);
+  pollUv(micros());
+
+  if (dhtState == DHT_DONE && bmpState == BMP_DONE &&
+      uvCount == UV_OVERSAMPLE) {
+    running = false;
+    timings.totalUs = micros() - startUs;
+    return true;
+  }
+  return false;
+}
+
+// ============================================================================
+// DHT22: interrupt-timed edge capture
+// ============================================================================
+
+void SensorAcquisition::pollDht(uint32_t now) {
+  switch (dhtState) {
+    case DHT_START_LOW:
+      if (now - dhtStateUs < DHT_START_LOW_US) return;
+      // Release the line and timestamp every edge of the sensor's reply
+      pinMode(dhtPin, INPUT_PULLUP);
+      attachInterrupt(digitalPinToInterrupt(dhtPin), onDhtEdge, CHANGE);
+      dhtState = DHT_CAPTURE;
+      dhtStateUs = micros();
+      break;
+
+    case DHT_CAPTURE: {
+      // Stop early once the falling edge of the last bit is in
+      uint8_t n = dhtEdgeCount;
+      int first = dhtFirstBitEdge(n);
+      bool complete = first >= 0 && n >= first + 80;
+      if (!complete && now - dhtStateUs < DHT_CAPTURE_TIMEOUT_US) return;
+      detachInterrupt(digitalPinToInterrupt(dhtPin));
+      dhtOk = decodeDht();
+      dhtState = DHT_DONE;
+      timings.dhtUs = micros() - startUs;
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+// Index of the rising edge that starts the first bit's high pulse, or -1
+// while the sensor's response has not been seen. The response is 80 us low
+// then 80 us high, and the first bit starts with a 50 us low, so its high
+// pulse is the first long interval followed by a short one. Locating it
+// keeps the host's release edge, or a response edge missed while attaching
+// the interrupt, from shifting the bits.
+int SensorAcquisition::dhtFirstBitEdge(uint8_t n) {
+  for (int i = 0; i + 2 < n; i++) {
+    uint32_t pulse = dhtEdges[i + 1] - dhtEdges[i];
+    uint32_t next = dhtEdges[i + 2] - dhtEdges[i + 1];
+    if (pulse >= DHT_RESPONSE_MIN_US && next < DHT_RESPONSE_MIN_US) {
+      return i + 2;
+    }
+  }
+  return -1;
+}
+
+bool SensorAcquisition::decodeDht() {
+  uint8_t n = dhtEdgeCount;
+  int first = dhtFirstBitEdge(n);
+  if (first < 0 || n < first + 80) return false;
+
+  // 80 (rising, falling) pairs follow, one per bit; a high pulse of ~70 us
+  // is a 1, ~27 us is a 0
+  uint8_t bytes[5] = {0, 0, 0, 0, 0};
+  for (uint8_t bit = 0; bit < 40; bit++) {
+    uint32_t high = dhtEdges[first + 2 * bit + 1] - dhtEdges[first + 2 * bit];
+    bytes[bit / 8] <<= 1;
+    if (high > 48) bytes[bit / 8] |= 1;
+  }
+
+  if ((uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]) != bytes[4]) {
+    return false;
+  }
+
+  humidity = ((bytes[0] << 8) | bytes[1]) * 0.1f;
+  temperature = (((bytes[2] & 0x7F) << 8) | bytes[3]) * 0.1f;
+  if (bytes[2] & 0x80) temperature = -temperature;
+  return true;
+}
+
+// ============================================================================
+// BMP180: conversions started, then collected when their time is up
+// ============================================================================
+
+void SensorAcquisition::pollBmp(uint32_t now) {
+  uint8_t buf[3];
+
+  switch (bmpState) {
+    case BMP_WAIT_TEMP:
+      if (now - bmpStateUs < BMP180_TEMP_WAIT_US) return;
+      if (!bmpRead(0xF6, buf, 2) || !bmpWrite(0xF4, 0x34 + (BMP180_OSS << 6))) {
+        bmpOk = false;
+        bmpState = BMP_DONE;
+        break;
+      }
+      rawTemp = (buf[0] << 8) | buf[1];
+      bmpState = BMP_WAIT_PRES;
+      bmpStateUs = micros();
+      break;
+
+    case BMP_WAIT_PRES:
+      if (now - bmpStateUs < BMP180_PRES_WAIT_US) return;
+      bmpOk = bmpRead(0xF6, buf, 3);
+      if (bmpOk) {
+        int32_t up = (((int32_t)buf[0] << 16) | ((int32_t)buf[1] << 8) |
+                      buf[2]) >>
+                     (8 - BMP180_OSS);
+        pressure = bmpCompensate(up);
+      }
+      bmpState = BMP_DONE;
+      timings.bmpUs = micros() - startUs;
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Integer compensation from the BMP180 datasheet, returns hPa
+float SensorAcquisition::bmpCompensate(int32_t up) {
+  int32_t x1 = ((rawTemp - (int32_t)ac6) * (int32_t)ac5) >> 15;
+  int32_t x2 = ((int32_t)mc << 11) / (x1 + md);
+  int32_t b5 = x1 + x2;
+
+  int32_t b6 = b5 - 4000;
+  x1 = (b2 * ((b6 * b6) >> 12)) >> 11;
+  x2 = (ac2 * b6) >> 11;
+  int32_t x3 = x1 + x2;
+  int32_t b3 = ((((int32_t)ac1 * 4 + x3) << BMP180_OSS) + 2) / 4;
+  x1 = (ac3 * b6) >> 13;
+  x2 = (b1 * ((b6 * b6) >> 12)) >> 16;
+  x3 = ((x1 + x2) + 2) >> 2;
+  uint32_t b4 = ((uint32_t)ac4 * (uint32_t)(x3 + 32768)) >> 15;
+  uint32_t b7 = ((uint32_t)up - b3) * (uint32_t)(50000UL >> BMP180_OSS);
+
+  int32_t p = b7 < 0x80000000 ? (b7 * 2) / b4 : (b7 / b4) * 2;
+  x1 = (p >> 8) * (p >> 8);
+  x1 = (x1 * 3038) >> 16;
+  x2 = (-7357 * p) >> 16;
+  p += (x1 + x2 + 3791) >> 4;
+
+  return p / 100.0f;
+}
+
+bool SensorAcquisition::bmpWrite(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(BMP180_ADDRESS);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0;
+}
+
+bool SensorAcquisition::bmpRead(uint8_t reg, uint8_t* buf, uint8_t len) {
+  Wire.beginTransmission(BMP180_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission() != 0) return false;
+  if (Wire.requestFrom((uint8_t)BMP180_ADDRESS, len) != len) return false;
+  for (uint8_t i = 0; i < len; i++) buf[i] = Wire.read();
+  return true;
+}
+
+// ============================================================================
+// UV: oversampled ADC, one read per poll
+// ============================================================================
+
+void SensorAcquisition::pollUv(uint32_t now) {
+  if (uvCount >= UV_OVERSAMPLE || now - uvLastUs < UV_SAMPLE_SPACING_US) {
+    return;
+  }
+
+  uvSum += analogRead(uvPin);
+  uvLastUs = now;
+
+  if (++uvCount == UV_OVERSAMPLE) {
+    // ESP8266 ADC is 0-1V unless a divider is used; same scale as before
+    uvVoltage = (uvSum / (float)UV_OVERSAMPLE) * (3.3f / 1023.0f);
+    timings.uvUs = micros() - startUs;
+  }
+}